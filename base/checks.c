@@ -257,7 +257,7 @@ int run_async_service_check(service *svc, int check_options, double latency, int
 	}
 
 	/* process any macros contained in the argument */
-	process_macros_r(&mac, raw_command, &processed_command, macro_options);
+	process_command_macros_r(&mac, raw_command, &processed_command, macro_options);
 	my_free(raw_command);
 	if (processed_command == NULL) {
 		clear_volatile_macros_r(&mac);
@@ -1568,6 +1568,7 @@ int handle_async_service_check_result(service *svc, check_result *cr)
 #endif
 
 	svc->has_been_checked = TRUE;
+	update_service_freshness_deadline(svc);
 	update_service_status(svc, FALSE);
 	update_service_performance_data(svc);
 
@@ -1901,56 +1902,182 @@ int check_service_dependencies(service *svc, int dependency_type)
 
 
 
-/* check for services that never returned from a check... */
-void check_for_orphaned_services(void)
+/*
+ * handles a service whose check job never came back from the workers.
+ * Called when the job's deadline passes, so all that's left is to
+ * forget about the job and try again
+ */
+void handle_orphaned_service_check(service *svc, time_t current_time)
 {
-	service *temp_service = NULL;
-	time_t current_time = 0L;
-	time_t expected_time = 0L;
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "handle_orphaned_service_check()\n");
 
+	/* the results may have come in some other way */
+	if (svc->is_executing == FALSE) {
+		return;
+	}
 
-	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_for_orphaned_services()\n");
+	/* log a warning */
+	logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: The check of service '%s' on host '%s' looks like it was orphaned (results never came back; last_check=%lu; next_check=%lu).  I'm scheduling an immediate check of the service...\n", svc->description, svc->host_name, svc->last_check, svc->next_check);
 
-	/* get the current time */
-	time(&current_time);
+	log_debug_info(DEBUGL_CHECKS, 1, "Service '%s' on host '%s' was orphaned, so we're scheduling an immediate check...\n", svc->description, svc->host_name);
+	log_debug_info(DEBUGL_CHECKS, 1, "  next_check=%lu (%s); last_check=%lu (%s);\n",
+				   svc->next_check, ctime(&svc->next_check),
+				   svc->last_check, ctime(&svc->last_check));
 
-	/* check all services... */
-	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
+	/* decrement the number of running service checks */
+	if (currently_running_service_checks > 0) {
+		currently_running_service_checks--;
+	}
 
-		/* skip services that are not currently executing */
-		if (temp_service->is_executing == FALSE) {
-			continue;
-		}
+	/* disable the executing flag */
+	svc->is_executing = FALSE;
+
+	/* schedule an immediate check of the service */
+	schedule_service_check(svc, current_time, CHECK_OPTION_ORPHAN_CHECK);
+}
 
-		/* determine the time at which the check results should have come in (allow 10 minutes slack time) */
-		expected_time = (time_t)(temp_service->next_check + temp_service->latency + service_check_timeout + check_reaper_interval + 600);
 
-		/* this service was supposed to have executed a while ago, but for some reason the results haven't come back in... */
-		if (expected_time < current_time) {
 
-			/* log a warning */
-			logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: The check of service '%s' on host '%s' looks like it was orphaned (results never came back; last_check=%lu; next_check=%lu).  I'm scheduling an immediate check of the service...\n", temp_service->description, temp_service->host_name, temp_service->last_check, temp_service->next_check);
+/******************************************************************************
+ ******* Freshness deadlines
+ *****************************************************************************/
+/*
+ * Objects with check_freshness set are kept in a scheduling queue,
+ * keyed by the earliest time their results can go stale. A freshness
+ * pass only looks at the ones that are due, and check results (and
+ * the few commands that can make a result go stale sooner) move the
+ * deadline. Deadlines are allowed to be early but never late, since
+ * a due object is always run through the full freshness test.
+ */
+static squeue_t *service_freshness_queue = NULL;
+static squeue_t *host_freshness_queue = NULL;
+static squeue_event **service_freshness_evt = NULL;
+static squeue_event **host_freshness_evt = NULL;
+
+static time_t service_freshness_expiration(service *, int *);
+static time_t host_freshness_expiration(host *, int *);
+
+static void arm_freshness_deadline(squeue_t *sq, squeue_event **evt, void *obj, time_t when)
+{
+	struct timeval tv;
 
-			log_debug_info(DEBUGL_CHECKS, 1, "Service '%s' on host '%s' was orphaned, so we're scheduling an immediate check...\n", temp_service->description, temp_service->host_name);
-			log_debug_info(DEBUGL_CHECKS, 1, "  next_check=%lu (%s); last_check=%lu (%s);\n",
-						   temp_service->next_check, ctime(&temp_service->next_check),
-						   temp_service->last_check, ctime(&temp_service->last_check));
+	if (*evt == NULL) {
+		*evt = squeue_add(sq, when, obj);
+		return;
+	}
+	tv.tv_sec = when;
+	tv.tv_usec = 0;
+	squeue_change_priority_tv(sq, *evt, &tv);
+}
 
-			/* decrement the number of running service checks */
-			if (currently_running_service_checks > 0) {
-				currently_running_service_checks--;
-			}
+/* pops the next object whose freshness deadline has passed */
+static void *pop_freshness_deadline(squeue_t *sq, squeue_event **evts, time_t current_time)
+{
+	void *obj;
+	unsigned int id;
 
-			/* disable the executing flag */
-			temp_service->is_executing = FALSE;
+	if (sq == NULL || (obj = squeue_peek(sq)) == NULL)
+		return NULL;
 
-			/* schedule an immediate check of the service */
-			schedule_service_check(temp_service, current_time, CHECK_OPTION_ORPHAN_CHECK);
-		}
+	id = (sq == service_freshness_queue) ? ((service *)obj)->id : ((host *)obj)->id;
+	if (squeue_event_runtime(evts[id])->tv_sec > current_time)
+		return NULL;
+
+	squeue_pop(sq);
+	evts[id] = NULL;
+	return obj;
+}
+
+void free_freshness_data(void)
+{
+	squeue_destroy(service_freshness_queue, 0);
+	squeue_destroy(host_freshness_queue, 0);
+	service_freshness_queue = host_freshness_queue = NULL;
+	my_free(service_freshness_evt);
+	my_free(host_freshness_evt);
+}
+
+/* (re)builds the freshness deadline index for the current objects */
+void init_freshness_data(void)
+{
+	unsigned int i, num_services = 0, num_hosts = 0;
 
+	free_freshness_data();
+
+	for (i = 0; i < num_objects.services; i++)
+		num_services += service_ary[i]->check_freshness == TRUE;
+	for (i = 0; i < num_objects.hosts; i++)
+		num_hosts += host_ary[i]->check_freshness == TRUE;
+
+	service_freshness_queue = squeue_create(num_services > 0 ? num_services : 1);
+	host_freshness_queue = squeue_create(num_hosts > 0 ? num_hosts : 1);
+	service_freshness_evt = calloc(num_objects.services + 1, sizeof(squeue_event *));
+	host_freshness_evt = calloc(num_objects.hosts + 1, sizeof(squeue_event *));
+	if (!service_freshness_queue || !host_freshness_queue || !service_freshness_evt || !host_freshness_evt) {
+		free_freshness_data();
+		return;
 	}
 
-	return;
+	for (i = 0; i < num_objects.services; i++)
+		update_service_freshness_deadline(service_ary[i]);
+	for (i = 0; i < num_objects.hosts; i++)
+		update_host_freshness_deadline(host_ary[i]);
+
+	log_debug_info(DEBUGL_CHECKS, 1, "Indexed freshness deadlines for %u services and %u hosts\n", num_services, num_hosts);
+}
+
+/*
+ * runs the freshness test on a service whose deadline has passed.
+ * Returns when it needs looking at again, or 0 if never
+ */
+static time_t check_service_freshness_deadline(service *temp_service, time_t current_time)
+{
+	time_t next_pass = current_time + service_freshness_check_interval;
+
+	/* skip services we shouldn't be checking for freshness */
+	if (temp_service->check_freshness == FALSE) {
+		return 0;
+	}
+
+	/* EXCEPTION */
+	/* don't check freshness of services without regular check intervals if we're using auto-freshness threshold */
+	if ((temp_service->check_interval == 0) && (temp_service->freshness_threshold == 0)) {
+		return 0;
+	}
+
+	/* skip services that are currently executing (problems here will be caught by orphaned service check) */
+	if (temp_service->is_executing == TRUE) {
+		return next_pass;
+	}
+
+	/* skip services that have both active and passive checks disabled */
+	if (temp_service->checks_enabled == FALSE && temp_service->accept_passive_checks == FALSE) {
+		return next_pass;
+	}
+
+	/* skip services that are already being freshened */
+	if (temp_service->is_being_freshened == TRUE) {
+		return next_pass;
+	}
+
+	/* see if the time is right... */
+	if (check_time_against_period(current_time, temp_service->check_period_ptr) == ERROR) {
+		return next_pass;
+	}
+
+	/* the results for the last check of this service are stale! */
+	if (is_service_result_fresh(temp_service, current_time, TRUE) == FALSE) {
+
+		/* set the freshen flag */
+		temp_service->is_being_freshened = TRUE;
+
+		/* schedule an immediate forced check of the service */
+		schedule_service_check(temp_service, current_time, CHECK_OPTION_FORCE_EXECUTION | CHECK_OPTION_FRESHNESS_CHECK);
+
+		return next_pass;
+	}
+
+	return service_freshness_expiration(temp_service, NULL) + 1;
 }
 
 
@@ -1960,6 +2087,7 @@ void check_service_result_freshness(void)
 {
 	service *temp_service = NULL;
 	time_t current_time = 0L;
+	time_t next_check = 0L;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_service_result_freshness()\n");
@@ -1974,72 +2102,37 @@ void check_service_result_freshness(void)
 	/* get the current time */
 	time(&current_time);
 
-	/* check all services... */
-	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
-
-		/* skip services we shouldn't be checking for freshness */
-		if (temp_service->check_freshness == FALSE) {
-			continue;
-		}
-
-		/* skip services that are currently executing (problems here will be caught by orphaned service check) */
-		if (temp_service->is_executing == TRUE) {
-			continue;
-		}
-
-		/* skip services that have both active and passive checks disabled */
-		if (temp_service->checks_enabled == FALSE && temp_service->accept_passive_checks == FALSE) {
-			continue;
-		}
-
-		/* skip services that are already being freshened */
-		if (temp_service->is_being_freshened == TRUE) {
-			continue;
-		}
+	/* check all services that may have gone stale... */
+	while ((temp_service = pop_freshness_deadline(service_freshness_queue, service_freshness_evt, current_time)) != NULL) {
 
-		/* see if the time is right... */
-		if (check_time_against_period(current_time, temp_service->check_period_ptr) == ERROR) {
-			continue;
-		}
-
-		/* EXCEPTION */
-		/* don't check freshness of services without regular check intervals if we're using auto-freshness threshold */
-		if ((temp_service->check_interval == 0) && (temp_service->freshness_threshold == 0)) {
-			continue;
+		next_check = check_service_freshness_deadline(temp_service, current_time);
+		if (next_check > 0) {
+			arm_freshness_deadline(service_freshness_queue, &service_freshness_evt[temp_service->id], temp_service, next_check > current_time ? next_check : current_time + 1);
 		}
+	}
 
-		/* the results for the last check of this service are stale! */
-		if (is_service_result_fresh(temp_service, current_time, TRUE) == FALSE) {
+	return;
+}
 
-			/* set the freshen flag */
-			temp_service->is_being_freshened = TRUE;
 
-			/* schedule an immediate forced check of the service */
-			schedule_service_check(temp_service, current_time, CHECK_OPTION_FORCE_EXECUTION | CHECK_OPTION_FRESHNESS_CHECK);
-		}
 
+/* moves a service's freshness deadline after something changed its expiration time */
+void update_service_freshness_deadline(service *svc)
+{
+	if (service_freshness_queue == NULL || svc->check_freshness == FALSE) {
+		return;
 	}
 
-	return;
+	arm_freshness_deadline(service_freshness_queue, &service_freshness_evt[svc->id], svc, service_freshness_expiration(svc, NULL) + 1);
 }
 
 
 
-/* tests whether or not a service's check results are fresh */
-int is_service_result_fresh(service *temp_service, time_t current_time, int log_this)
+/* calculates when a service's check results go stale */
+static time_t service_freshness_expiration(service *temp_service, int *threshold)
 {
 	int freshness_threshold = 0;
 	time_t expiration_time = 0L;
-	int days = 0;
-	int hours = 0;
-	int minutes = 0;
-	int seconds = 0;
-	int tdays = 0;
-	int thours = 0;
-	int tminutes = 0;
-	int tseconds = 0;
-
-	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of service '%s' on host '%s'...\n", temp_service->description, temp_service->host_name);
 
 	/* use user-supplied freshness threshold or auto-calculate a freshness threshold to use? */
 	if (temp_service->freshness_threshold == 0) {
@@ -2054,8 +2147,6 @@ int is_service_result_fresh(service *temp_service, time_t current_time, int log_
 		freshness_threshold = temp_service->freshness_threshold;
 	}
 
-	log_debug_info(DEBUGL_CHECKS, 2, "Freshness thresholds: service=%d, use=%d\n", temp_service->freshness_threshold, freshness_threshold);
-
 	/* calculate expiration time */
 	/*
 	 * CHANGED 11/10/05 EG -
@@ -2114,6 +2205,34 @@ int is_service_result_fresh(service *temp_service, time_t current_time, int log_
 
 		expiration_time = event_start + freshness_threshold;
 	}
+
+	if (threshold != NULL) {
+		*threshold = freshness_threshold;
+	}
+
+	return expiration_time;
+}
+
+
+/* tests whether or not a service's check results are fresh */
+int is_service_result_fresh(service *temp_service, time_t current_time, int log_this)
+{
+	int freshness_threshold = 0;
+	time_t expiration_time = 0L;
+	int days = 0;
+	int hours = 0;
+	int minutes = 0;
+	int seconds = 0;
+	int tdays = 0;
+	int thours = 0;
+	int tminutes = 0;
+	int tseconds = 0;
+
+	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of service '%s' on host '%s'...\n", temp_service->description, temp_service->host_name);
+
+	expiration_time = service_freshness_expiration(temp_service, &freshness_threshold);
+
+	log_debug_info(DEBUGL_CHECKS, 2, "Freshness thresholds: service=%d, use=%d\n", temp_service->freshness_threshold, freshness_threshold);
 	log_debug_info(DEBUGL_CHECKS, 2, "HBC: %d, PS: %lu, ES: %lu, LC: %lu, CT: %lu, ET: %lu\n", temp_service->has_been_checked, (unsigned long)program_start, (unsigned long)event_start, (unsigned long)temp_service->last_check, (unsigned long)current_time, (unsigned long)expiration_time);
 
 	/* the results for the last check of this service are stale */
@@ -2406,6 +2525,7 @@ int handle_async_host_check_result(host *hst, check_result *cr)
 #endif
 
 	hst->has_been_checked = TRUE;
+	update_host_freshness_deadline(hst);
 	update_host_status(hst, FALSE);
 	update_host_performance_data(hst);
 
@@ -2610,59 +2730,85 @@ int check_host_dependencies(host *hst, int dependency_type)
 
 
 
-/* check for hosts that never returned from a check... */
-void check_for_orphaned_hosts(void)
+/* handles a host whose check job never came back from the workers */
+void handle_orphaned_host_check(host *hst, time_t current_time)
 {
-	host *temp_host = NULL;
-	time_t current_time = 0L;
-	time_t expected_time = 0L;
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "handle_orphaned_host_check()\n");
 
+	/* the results may have come in some other way */
+	if (hst->is_executing == FALSE) {
+		return;
+	}
 
-	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_for_orphaned_hosts()\n");
+	/* log a warning */
+	logit(NSLOG_RUNTIME_WARNING, TRUE, 
+		"Warning: The check of host '%s' looks like it was orphaned (results never came back).  I'm scheduling an immediate check of the host...\n", 
+		hst->name);
 
-	/* get the current time */
-	time(&current_time);
+	log_debug_info(DEBUGL_CHECKS, 1, 
+		"Host '%s' was orphaned, so we're scheduling an immediate check...\n", 
+		hst->name);
 
-	/* check all hosts... */
-	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+	/* decrement the number of running host checks */
+	if (currently_running_host_checks > 0) {
+		currently_running_host_checks--;
+	}
 
-		/* skip hosts that don't have a set check interval (on-demand checks are missed by the orphan logic) */
-		if (temp_host->next_check == (time_t)0L) {
-			continue;
-		}
+	/* disable the executing flag */
+	hst->is_executing = FALSE;
 
-		/* skip hosts that are not currently executing */
-		if (temp_host->is_executing == FALSE) {
-			continue;
-		}
+	/* schedule an immediate check of the host */
+	schedule_host_check(hst, current_time, CHECK_OPTION_ORPHAN_CHECK);
+}
 
-		/* determine the time at which the check results should have come in (allow 10 minutes slack time) */
-		expected_time = (time_t)(temp_host->next_check + temp_host->latency + host_check_timeout + check_reaper_interval + 600);
 
-		/* this host was supposed to have executed a while ago, but for some reason the results haven't come back in... */
-		if (expected_time < current_time) {
 
-			/* log a warning */
-			logit(NSLOG_RUNTIME_WARNING, TRUE, 
-				"Warning: The check of host '%s' looks like it was orphaned (results never came back).  I'm scheduling an immediate check of the host...\n", 
-				temp_host->name);
+/*
+ * runs the freshness test on a host whose deadline has passed.
+ * Returns when it needs looking at again, or 0 if never
+ */
+static time_t check_host_freshness_deadline(host *temp_host, time_t current_time)
+{
+	time_t next_pass = current_time + host_freshness_check_interval;
 
-			log_debug_info(DEBUGL_CHECKS, 1, 
-				"Host '%s' was orphaned, so we're scheduling an immediate check...\n", 
-				temp_host->name);
+	/* skip hosts we shouldn't be checking for freshness */
+	if (temp_host->check_freshness == FALSE) {
+		return 0;
+	}
 
-			/* decrement the number of running host checks */
-			if (currently_running_host_checks > 0) {
-				currently_running_host_checks--;
-			}
+	/* skip hosts that have both active and passive checks disabled */
+	if (temp_host->checks_enabled == FALSE && temp_host->accept_passive_checks == FALSE) {
+		return next_pass;
+	}
+
+	/* skip hosts that are currently executing (problems here will be caught by orphaned host check) */
+	if (temp_host->is_executing == TRUE) {
+		return next_pass;
+	}
 
-			/* disable the executing flag */
-			temp_host->is_executing = FALSE;
+	/* skip hosts that are already being freshened */
+	if (temp_host->is_being_freshened == TRUE) {
+		return next_pass;
+	}
 
-			/* schedule an immediate check of the host */
-			schedule_host_check(temp_host, current_time, CHECK_OPTION_ORPHAN_CHECK);
-		}
+	/* see if the time is right... */
+	if (check_time_against_period(current_time, temp_host->check_period_ptr) == ERROR) {
+		return next_pass;
 	}
+
+	/* the results for the last check of this host are stale */
+	if (is_host_result_fresh(temp_host, current_time, TRUE) == FALSE) {
+
+		/* set the freshen flag */
+		temp_host->is_being_freshened = TRUE;
+
+		/* schedule an immediate forced check of the host */
+		schedule_host_check(temp_host, current_time, CHECK_OPTION_FORCE_EXECUTION | CHECK_OPTION_FRESHNESS_CHECK);
+
+		return next_pass;
+	}
+
+	return host_freshness_expiration(temp_host, NULL) + 1;
 }
 
 
@@ -2672,6 +2818,7 @@ void check_host_result_freshness(void)
 {
 	host *temp_host = NULL;
 	time_t current_time = 0L;
+	time_t next_check = 0L;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_host_result_freshness()\n");
 	log_debug_info(DEBUGL_CHECKS, 2, "Attempting to check the freshness of host check results...\n");
@@ -2685,65 +2832,37 @@ void check_host_result_freshness(void)
 	/* get the current time */
 	time(&current_time);
 
-	/* check all hosts... */
-	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+	/* check all hosts that may have gone stale... */
+	while ((temp_host = pop_freshness_deadline(host_freshness_queue, host_freshness_evt, current_time)) != NULL) {
 
-		/* skip hosts we shouldn't be checking for freshness */
-		if (temp_host->check_freshness == FALSE) {
-			continue;
-		}
-
-		/* skip hosts that have both active and passive checks disabled */
-		if (temp_host->checks_enabled == FALSE && temp_host->accept_passive_checks == FALSE) {
-			continue;
-		}
-
-		/* skip hosts that are currently executing (problems here will be caught by orphaned host check) */
-		if (temp_host->is_executing == TRUE) {
-			continue;
-		}
-
-		/* skip hosts that are already being freshened */
-		if (temp_host->is_being_freshened == TRUE) {
-			continue;
-		}
-
-		/* see if the time is right... */
-		if (check_time_against_period(current_time, temp_host->check_period_ptr) == ERROR) {
-			continue;
+		next_check = check_host_freshness_deadline(temp_host, current_time);
+		if (next_check > 0) {
+			arm_freshness_deadline(host_freshness_queue, &host_freshness_evt[temp_host->id], temp_host, next_check > current_time ? next_check : current_time + 1);
 		}
+	}
+}
 
-		/* the results for the last check of this host are stale */
-		if (is_host_result_fresh(temp_host, current_time, TRUE) == FALSE) {
 
-			/* set the freshen flag */
-			temp_host->is_being_freshened = TRUE;
 
-			/* schedule an immediate forced check of the host */
-			schedule_host_check(temp_host, current_time, CHECK_OPTION_FORCE_EXECUTION | CHECK_OPTION_FRESHNESS_CHECK);
-		}
+/* moves a host's freshness deadline after something changed its expiration time */
+void update_host_freshness_deadline(host *hst)
+{
+	if (host_freshness_queue == NULL || hst->check_freshness == FALSE) {
+		return;
 	}
+
+	arm_freshness_deadline(host_freshness_queue, &host_freshness_evt[hst->id], hst, host_freshness_expiration(hst, NULL) + 1);
 }
 
 
 
-/* checks to see if a hosts's check results are fresh */
-int is_host_result_fresh(host *temp_host, time_t current_time, int log_this)
+/* calculates when a host's check results go stale */
+static time_t host_freshness_expiration(host *temp_host, int *threshold)
 {
 	time_t expiration_time = 0L;
 	int freshness_threshold = 0;
-	int days = 0;
-	int hours = 0;
-	int minutes = 0;
-	int seconds = 0;
-	int tdays = 0;
-	int thours = 0;
-	int tminutes = 0;
-	int tseconds = 0;
 	double interval = 0;
 
-	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of host '%s'...\n", temp_host->name);
-
 	/* use user-supplied freshness threshold or auto-calculate a freshness threshold to use? */
 	if (temp_host->freshness_threshold == 0) {
 
@@ -2760,8 +2879,6 @@ int is_host_result_fresh(host *temp_host, time_t current_time, int log_this)
 		freshness_threshold = temp_host->freshness_threshold;
 	}
 
-	log_debug_info(DEBUGL_CHECKS, 2, "Freshness thresholds: host=%d, use=%d\n", temp_host->freshness_threshold, freshness_threshold);
-
 	/* calculate expiration time */
 	/*
 	 * CHANGED 11/10/05 EG:
@@ -2811,6 +2928,34 @@ int is_host_result_fresh(host *temp_host, time_t current_time, int log_this)
 		expiration_time = event_start + freshness_threshold;
 	}
 
+	if (threshold != NULL) {
+		*threshold = freshness_threshold;
+	}
+
+	return expiration_time;
+}
+
+
+/* checks to see if a hosts's check results are fresh */
+int is_host_result_fresh(host *temp_host, time_t current_time, int log_this)
+{
+	time_t expiration_time = 0L;
+	int freshness_threshold = 0;
+	int days = 0;
+	int hours = 0;
+	int minutes = 0;
+	int seconds = 0;
+	int tdays = 0;
+	int thours = 0;
+	int tminutes = 0;
+	int tseconds = 0;
+
+	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of host '%s'...\n", temp_host->name);
+
+	expiration_time = host_freshness_expiration(temp_host, &freshness_threshold);
+
+	log_debug_info(DEBUGL_CHECKS, 2, "Freshness thresholds: host=%d, use=%d\n", temp_host->freshness_threshold, freshness_threshold);
+
 	log_debug_info(DEBUGL_CHECKS, 2, 
 		"HBC: %d, PS: %lu, ES: %lu, LC: %lu, CT: %lu, ET: %lu\n", 
 		temp_host->has_been_checked, 
@@ -3057,7 +3202,7 @@ int run_async_host_check(host *hst, int check_options, double latency, int sched
 	}
 
 	/* process any macros contained in the argument */
-	process_macros_r(&mac, raw_command, &processed_command, macro_options);
+	process_command_macros_r(&mac, raw_command, &processed_command, macro_options);
 	my_free(raw_command);
 	if (processed_command == NULL) {
 		clear_volatile_macros_r(&mac);
@@ -48,6 +48,14 @@ static struct {
 	iocache *ioc;
 } command_worker = { "command file", "command file worker", 0, 0, NULL };
 
+/*
+ * The worker parses the lines it reads from the command file and
+ * sends them to us as binary key/value vectors, framed like binary
+ * worker messages. Everything it read in one go is sent in a single
+ * batch, no larger than this unless a single command is.
+ */
+#define COMMAND_BATCH_SIZE (256 * 1024)
+
 
 /******************************************************************/
 /************* EXTERNAL COMMAND WORKER CONTROLLERS ****************/
@@ -133,7 +141,43 @@ int shutdown_command_file_worker(void) {
 	}
 
 
+/* fills in an external command from a message sent by the worker */
+static int kvvec2external_command(struct kvvec *kvv, struct external_command *ec, int *error) {
+	int i;
+
+	memset(ec, 0, sizeof(*ec));
+	*error = CMD_ERROR_OK;
+	for (i = 0; i < kvv->kv_pairs; i++) {
+		struct key_value *kv = &kvv->kv[i];
+
+		if (!strcmp(kv->key, "error"))
+			*error = atoi(kv->value);
+		else if (!strcmp(kv->key, "id"))
+			ec->id = atoi(kv->value);
+		else if (!strcmp(kv->key, "entry_time"))
+			ec->entry_time = (time_t)strtoul(kv->value, NULL, 10);
+		else if (!strcmp(kv->key, "name"))
+			ec->name = kv->value;
+		else if (!strcmp(kv->key, "args"))
+			ec->args = kv->value;
+		else if (!strcmp(kv->key, "host_name"))
+			ec->host_name = kv->value;
+		else if (!strcmp(kv->key, "service_description"))
+			ec->service_description = kv->value;
+		else if (!strcmp(kv->key, "return_code"))
+			ec->return_code = atoi(kv->value);
+		else if (!strcmp(kv->key, "output"))
+			ec->output = kv->value;
+		}
+
+	if (*error == CMD_ERROR_OK && (!ec->name || !ec->args))
+		return -1;
+	return 0;
+	}
+
+
 static int command_input_handler(int sd, int events, void *discard) {
+	static struct kvvec kvv = KVVEC_INITIALIZER;
 	int ret, cmd_ret;
 	char *buf;
 	unsigned long size;
@@ -149,14 +193,19 @@ static int command_input_handler(int sd, int events, void *discard) {
 		launch_command_file_worker();
 		return 0;
 		}
-	while ((buf = iocache_use_delim(command_worker.ioc, "\n", 1, &size))) {
-		if (buf[0] == '[') {
-			/* raw external command */
-			buf[size] = 0;
-			log_debug_info(DEBUGL_COMMANDS, 1, "Read raw external command '%s'\n", buf);
+	while ((buf = worker_ioc2bmsg(command_worker.ioc, &size))) {
+		struct external_command ec;
+
+		if (bbuf2kvvec_prealloc(&kvv, buf, size, KVVEC_ASSIGN) < 0 || kvvec2external_command(&kvv, &ec, &cmd_ret) < 0) {
+			logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Failed to parse message from command file worker\n");
+			continue;
 			}
 
-		if ((cmd_ret = process_external_command1(buf)) != CMD_ERROR_OK) {
+		if (cmd_ret == CMD_ERROR_OK) {
+			log_debug_info(DEBUGL_COMMANDS, 1, "Read external command '%s;%s'\n", ec.name, ec.args);
+			cmd_ret = process_parsed_external_command(&ec);
+			}
+		if (cmd_ret != CMD_ERROR_OK) {
 			logit(NSLOG_EXTERNAL_COMMAND | NSLOG_RUNTIME_WARNING, TRUE, "External command error: %s\n", cmd_error_strerror(cmd_ret));
 			}
 
@@ -165,6 +214,72 @@ static int command_input_handler(int sd, int events, void *discard) {
 	}
 
 
+/* batch of commands the worker is about to send */
+static struct {
+	char *buf;
+	unsigned long len, size;
+} command_batch;
+
+/* adds a parsed external command, or the error parsing it, to the batch */
+static int add_to_batch(struct external_command *ec, int error) {
+	static struct kvvec kvv = KVVEC_INITIALIZER;
+	char id[16], entry_time[32], return_code[16], err[16];
+	unsigned long len;
+
+	kvvec_init(&kvv, 10);
+	if (error != CMD_ERROR_OK) {
+		snprintf(err, sizeof(err), "%d", error);
+		kvvec_addkv(&kvv, "error", err);
+		}
+	else {
+		snprintf(id, sizeof(id), "%d", ec->id);
+		snprintf(entry_time, sizeof(entry_time), "%lu", (unsigned long)ec->entry_time);
+		kvvec_addkv(&kvv, "id", id);
+		kvvec_addkv(&kvv, "entry_time", entry_time);
+		kvvec_addkv(&kvv, "name", ec->name);
+		kvvec_addkv(&kvv, "args", ec->args);
+		if (ec->output) {
+			snprintf(return_code, sizeof(return_code), "%d", ec->return_code);
+			kvvec_addkv(&kvv, "host_name", ec->host_name);
+			if (ec->service_description)
+				kvvec_addkv(&kvv, "service_description", ec->service_description);
+			kvvec_addkv(&kvv, "return_code", return_code);
+			kvvec_addkv(&kvv, "output", ec->output);
+			}
+		}
+
+	len = WORKER_FRAME_HDR_LEN + kvvec_bbuf_len(&kvv);
+	if (command_batch.len + len > command_batch.size) {
+		unsigned long size = command_batch.len + len;
+		char *buf;
+
+		if (size < COMMAND_BATCH_SIZE)
+			size = COMMAND_BATCH_SIZE;
+		if (!(buf = realloc(command_batch.buf, size)))
+			return -1;
+		command_batch.buf = buf;
+		command_batch.size = size;
+		}
+
+	if (!(len = worker_kvvec2bmsg(&kvv, command_batch.buf + command_batch.len, command_batch.size - command_batch.len)))
+		return -1;
+	command_batch.len += len;
+	return 0;
+	}
+
+/* sends the batch to the core, returning -1 if it's gone */
+static int send_batch(int sd) {
+	ssize_t ret;
+
+	if (!command_batch.len)
+		return 0;
+
+	ret = nwrite(sd, command_batch.buf, command_batch.len, NULL);
+	command_batch.len = 0;
+	return ret < 0 ? -1 : 0;
+	}
+
+
 /* main controller of command file helper process */
 static int command_file_worker(int sd) {
 	iocache *ioc;
@@ -216,14 +331,23 @@ static int command_file_worker(int sd) {
 			return EXIT_FAILURE;
 		}
 
-		size = iocache_available(ioc);
-		buf = iocache_use_size(ioc, size);
-		ret = write(sd, buf, size);
 		/*
-		 * @todo Add libio to get io_write_all(), which handles
-		 * EINTR and EAGAIN properly instead of just exiting.
+		 * parse everything we got, so the core only has to apply
+		 * it, and send it all in one batch
 		 */
-		if (ret < 0 && errno != EINTR)
+		while ((buf = iocache_use_delim(ioc, "\n", 1, &size))) {
+			struct external_command ec;
+
+			buf[size] = 0;
+			ret = parse_external_command(buf, &ec);
+			ret = add_to_batch(&ec, ret);
+			free(ec.split_args);
+			if (ret < 0)
+				return EXIT_FAILURE;
+			if (command_batch.len >= COMMAND_BATCH_SIZE && send_batch(sd) < 0)
+				return EXIT_FAILURE;
+			}
+		if (send_batch(sd) < 0)
 			return EXIT_FAILURE;
 		} /* while(1) */
 	}
@@ -372,14 +496,230 @@ int process_external_commands_from_file(char *fname, int delete_file) {
 
 
 
+/* maps external command names to their CMD_* ids */
+static const struct {
+	const char *name;
+	int id;
+} external_command_names[] = {
+	/* process commands */
+	{ "ENTER_STANDBY_MODE", CMD_DISABLE_NOTIFICATIONS },
+	{ "DISABLE_NOTIFICATIONS", CMD_DISABLE_NOTIFICATIONS },
+	{ "ENTER_ACTIVE_MODE", CMD_ENABLE_NOTIFICATIONS },
+	{ "ENABLE_NOTIFICATIONS", CMD_ENABLE_NOTIFICATIONS },
+	{ "SHUTDOWN_PROGRAM", CMD_SHUTDOWN_PROCESS },
+	{ "SHUTDOWN_PROCESS", CMD_SHUTDOWN_PROCESS },
+	{ "RESTART_PROGRAM", CMD_RESTART_PROCESS },
+	{ "RESTART_PROCESS", CMD_RESTART_PROCESS },
+	{ "SAVE_STATE_INFORMATION", CMD_SAVE_STATE_INFORMATION },
+	{ "READ_STATE_INFORMATION", CMD_READ_STATE_INFORMATION },
+	{ "ENABLE_EVENT_HANDLERS", CMD_ENABLE_EVENT_HANDLERS },
+	{ "DISABLE_EVENT_HANDLERS", CMD_DISABLE_EVENT_HANDLERS },
+	{ "ENABLE_PERFORMANCE_DATA", CMD_ENABLE_PERFORMANCE_DATA },
+	{ "DISABLE_PERFORMANCE_DATA", CMD_DISABLE_PERFORMANCE_DATA },
+	{ "START_EXECUTING_HOST_CHECKS", CMD_START_EXECUTING_HOST_CHECKS },
+	{ "STOP_EXECUTING_HOST_CHECKS", CMD_STOP_EXECUTING_HOST_CHECKS },
+	{ "START_EXECUTING_SVC_CHECKS", CMD_START_EXECUTING_SVC_CHECKS },
+	{ "STOP_EXECUTING_SVC_CHECKS", CMD_STOP_EXECUTING_SVC_CHECKS },
+	{ "START_ACCEPTING_PASSIVE_HOST_CHECKS", CMD_START_ACCEPTING_PASSIVE_HOST_CHECKS },
+	{ "STOP_ACCEPTING_PASSIVE_HOST_CHECKS", CMD_STOP_ACCEPTING_PASSIVE_HOST_CHECKS },
+	{ "START_ACCEPTING_PASSIVE_SVC_CHECKS", CMD_START_ACCEPTING_PASSIVE_SVC_CHECKS },
+	{ "STOP_ACCEPTING_PASSIVE_SVC_CHECKS", CMD_STOP_ACCEPTING_PASSIVE_SVC_CHECKS },
+	{ "START_OBSESSING_OVER_HOST_CHECKS", CMD_START_OBSESSING_OVER_HOST_CHECKS },
+	{ "STOP_OBSESSING_OVER_HOST_CHECKS", CMD_STOP_OBSESSING_OVER_HOST_CHECKS },
+	{ "START_OBSESSING_OVER_SVC_CHECKS", CMD_START_OBSESSING_OVER_SVC_CHECKS },
+	{ "STOP_OBSESSING_OVER_SVC_CHECKS", CMD_STOP_OBSESSING_OVER_SVC_CHECKS },
+	{ "ENABLE_FLAP_DETECTION", CMD_ENABLE_FLAP_DETECTION },
+	{ "DISABLE_FLAP_DETECTION", CMD_DISABLE_FLAP_DETECTION },
+	{ "CHANGE_GLOBAL_HOST_EVENT_HANDLER", CMD_CHANGE_GLOBAL_HOST_EVENT_HANDLER },
+	{ "CHANGE_GLOBAL_SVC_EVENT_HANDLER", CMD_CHANGE_GLOBAL_SVC_EVENT_HANDLER },
+	{ "ENABLE_SERVICE_FRESHNESS_CHECKS", CMD_ENABLE_SERVICE_FRESHNESS_CHECKS },
+	{ "DISABLE_SERVICE_FRESHNESS_CHECKS", CMD_DISABLE_SERVICE_FRESHNESS_CHECKS },
+	{ "ENABLE_HOST_FRESHNESS_CHECKS", CMD_ENABLE_HOST_FRESHNESS_CHECKS },
+	{ "DISABLE_HOST_FRESHNESS_CHECKS", CMD_DISABLE_HOST_FRESHNESS_CHECKS },
+
+	/* host-related commands */
+	{ "ADD_HOST_COMMENT", CMD_ADD_HOST_COMMENT },
+	{ "DEL_HOST_COMMENT", CMD_DEL_HOST_COMMENT },
+	{ "DEL_ALL_HOST_COMMENTS", CMD_DEL_ALL_HOST_COMMENTS },
+	{ "DELAY_HOST_NOTIFICATION", CMD_DELAY_HOST_NOTIFICATION },
+	{ "ENABLE_HOST_NOTIFICATIONS", CMD_ENABLE_HOST_NOTIFICATIONS },
+	{ "DISABLE_HOST_NOTIFICATIONS", CMD_DISABLE_HOST_NOTIFICATIONS },
+	{ "ENABLE_ALL_NOTIFICATIONS_BEYOND_HOST", CMD_ENABLE_ALL_NOTIFICATIONS_BEYOND_HOST },
+	{ "DISABLE_ALL_NOTIFICATIONS_BEYOND_HOST", CMD_DISABLE_ALL_NOTIFICATIONS_BEYOND_HOST },
+	{ "ENABLE_HOST_AND_CHILD_NOTIFICATIONS", CMD_ENABLE_HOST_AND_CHILD_NOTIFICATIONS },
+	{ "DISABLE_HOST_AND_CHILD_NOTIFICATIONS", CMD_DISABLE_HOST_AND_CHILD_NOTIFICATIONS },
+	{ "ENABLE_HOST_SVC_NOTIFICATIONS", CMD_ENABLE_HOST_SVC_NOTIFICATIONS },
+	{ "DISABLE_HOST_SVC_NOTIFICATIONS", CMD_DISABLE_HOST_SVC_NOTIFICATIONS },
+	{ "ENABLE_HOST_SVC_CHECKS", CMD_ENABLE_HOST_SVC_CHECKS },
+	{ "DISABLE_HOST_SVC_CHECKS", CMD_DISABLE_HOST_SVC_CHECKS },
+	{ "ENABLE_PASSIVE_HOST_CHECKS", CMD_ENABLE_PASSIVE_HOST_CHECKS },
+	{ "DISABLE_PASSIVE_HOST_CHECKS", CMD_DISABLE_PASSIVE_HOST_CHECKS },
+	{ "SCHEDULE_HOST_SVC_CHECKS", CMD_SCHEDULE_HOST_SVC_CHECKS },
+	{ "SCHEDULE_FORCED_HOST_SVC_CHECKS", CMD_SCHEDULE_FORCED_HOST_SVC_CHECKS },
+	{ "ACKNOWLEDGE_HOST_PROBLEM", CMD_ACKNOWLEDGE_HOST_PROBLEM },
+	{ "REMOVE_HOST_ACKNOWLEDGEMENT", CMD_REMOVE_HOST_ACKNOWLEDGEMENT },
+	{ "ENABLE_HOST_EVENT_HANDLER", CMD_ENABLE_HOST_EVENT_HANDLER },
+	{ "DISABLE_HOST_EVENT_HANDLER", CMD_DISABLE_HOST_EVENT_HANDLER },
+	{ "ENABLE_HOST_CHECK", CMD_ENABLE_HOST_CHECK },
+	{ "DISABLE_HOST_CHECK", CMD_DISABLE_HOST_CHECK },
+	{ "SCHEDULE_HOST_CHECK", CMD_SCHEDULE_HOST_CHECK },
+	{ "SCHEDULE_FORCED_HOST_CHECK", CMD_SCHEDULE_FORCED_HOST_CHECK },
+	{ "SCHEDULE_HOST_DOWNTIME", CMD_SCHEDULE_HOST_DOWNTIME },
+	{ "SCHEDULE_HOST_SVC_DOWNTIME", CMD_SCHEDULE_HOST_SVC_DOWNTIME },
+	{ "DEL_HOST_DOWNTIME", CMD_DEL_HOST_DOWNTIME },
+	{ "DEL_DOWNTIME_BY_HOST_NAME", CMD_DEL_DOWNTIME_BY_HOST_NAME },
+	{ "DEL_DOWNTIME_BY_HOSTGROUP_NAME", CMD_DEL_DOWNTIME_BY_HOSTGROUP_NAME },
+	{ "DEL_DOWNTIME_BY_START_TIME_COMMENT", CMD_DEL_DOWNTIME_BY_START_TIME_COMMENT },
+	{ "ENABLE_HOST_FLAP_DETECTION", CMD_ENABLE_HOST_FLAP_DETECTION },
+	{ "DISABLE_HOST_FLAP_DETECTION", CMD_DISABLE_HOST_FLAP_DETECTION },
+	{ "START_OBSESSING_OVER_HOST", CMD_START_OBSESSING_OVER_HOST },
+	{ "STOP_OBSESSING_OVER_HOST", CMD_STOP_OBSESSING_OVER_HOST },
+	{ "CHANGE_HOST_EVENT_HANDLER", CMD_CHANGE_HOST_EVENT_HANDLER },
+	{ "CHANGE_HOST_CHECK_COMMAND", CMD_CHANGE_HOST_CHECK_COMMAND },
+	{ "CHANGE_NORMAL_HOST_CHECK_INTERVAL", CMD_CHANGE_NORMAL_HOST_CHECK_INTERVAL },
+	{ "CHANGE_RETRY_HOST_CHECK_INTERVAL", CMD_CHANGE_RETRY_HOST_CHECK_INTERVAL },
+	{ "CHANGE_MAX_HOST_CHECK_ATTEMPTS", CMD_CHANGE_MAX_HOST_CHECK_ATTEMPTS },
+	{ "SCHEDULE_AND_PROPAGATE_TRIGGERED_HOST_DOWNTIME", CMD_SCHEDULE_AND_PROPAGATE_TRIGGERED_HOST_DOWNTIME },
+	{ "SCHEDULE_AND_PROPAGATE_HOST_DOWNTIME", CMD_SCHEDULE_AND_PROPAGATE_HOST_DOWNTIME },
+	{ "SET_HOST_NOTIFICATION_NUMBER", CMD_SET_HOST_NOTIFICATION_NUMBER },
+	{ "CHANGE_HOST_CHECK_TIMEPERIOD", CMD_CHANGE_HOST_CHECK_TIMEPERIOD },
+	{ "CHANGE_CUSTOM_HOST_VAR", CMD_CHANGE_CUSTOM_HOST_VAR },
+	{ "SEND_CUSTOM_HOST_NOTIFICATION", CMD_SEND_CUSTOM_HOST_NOTIFICATION },
+	{ "CHANGE_HOST_NOTIFICATION_TIMEPERIOD", CMD_CHANGE_HOST_NOTIFICATION_TIMEPERIOD },
+	{ "CHANGE_HOST_MODATTR", CMD_CHANGE_HOST_MODATTR },
+	{ "CLEAR_HOST_FLAPPING_STATE", CMD_CLEAR_HOST_FLAPPING_STATE },
+
+	/* hostgroup-related commands */
+	{ "ENABLE_HOSTGROUP_HOST_NOTIFICATIONS", CMD_ENABLE_HOSTGROUP_HOST_NOTIFICATIONS },
+	{ "DISABLE_HOSTGROUP_HOST_NOTIFICATIONS", CMD_DISABLE_HOSTGROUP_HOST_NOTIFICATIONS },
+	{ "ENABLE_HOSTGROUP_SVC_NOTIFICATIONS", CMD_ENABLE_HOSTGROUP_SVC_NOTIFICATIONS },
+	{ "DISABLE_HOSTGROUP_SVC_NOTIFICATIONS", CMD_DISABLE_HOSTGROUP_SVC_NOTIFICATIONS },
+	{ "ENABLE_HOSTGROUP_HOST_CHECKS", CMD_ENABLE_HOSTGROUP_HOST_CHECKS },
+	{ "DISABLE_HOSTGROUP_HOST_CHECKS", CMD_DISABLE_HOSTGROUP_HOST_CHECKS },
+	{ "ENABLE_HOSTGROUP_PASSIVE_HOST_CHECKS", CMD_ENABLE_HOSTGROUP_PASSIVE_HOST_CHECKS },
+	{ "DISABLE_HOSTGROUP_PASSIVE_HOST_CHECKS", CMD_DISABLE_HOSTGROUP_PASSIVE_HOST_CHECKS },
+	{ "ENABLE_HOSTGROUP_SVC_CHECKS", CMD_ENABLE_HOSTGROUP_SVC_CHECKS },
+	{ "DISABLE_HOSTGROUP_SVC_CHECKS", CMD_DISABLE_HOSTGROUP_SVC_CHECKS },
+	{ "ENABLE_HOSTGROUP_PASSIVE_SVC_CHECKS", CMD_ENABLE_HOSTGROUP_PASSIVE_SVC_CHECKS },
+	{ "DISABLE_HOSTGROUP_PASSIVE_SVC_CHECKS", CMD_DISABLE_HOSTGROUP_PASSIVE_SVC_CHECKS },
+	{ "SCHEDULE_HOSTGROUP_HOST_DOWNTIME", CMD_SCHEDULE_HOSTGROUP_HOST_DOWNTIME },
+	{ "SCHEDULE_HOSTGROUP_SVC_DOWNTIME", CMD_SCHEDULE_HOSTGROUP_SVC_DOWNTIME },
+
+	/* service-related commands */
+	{ "ADD_SVC_COMMENT", CMD_ADD_SVC_COMMENT },
+	{ "DEL_SVC_COMMENT", CMD_DEL_SVC_COMMENT },
+	{ "DEL_ALL_SVC_COMMENTS", CMD_DEL_ALL_SVC_COMMENTS },
+	{ "SCHEDULE_SVC_CHECK", CMD_SCHEDULE_SVC_CHECK },
+	{ "SCHEDULE_FORCED_SVC_CHECK", CMD_SCHEDULE_FORCED_SVC_CHECK },
+	{ "ENABLE_SVC_CHECK", CMD_ENABLE_SVC_CHECK },
+	{ "DISABLE_SVC_CHECK", CMD_DISABLE_SVC_CHECK },
+	{ "ENABLE_PASSIVE_SVC_CHECKS", CMD_ENABLE_PASSIVE_SVC_CHECKS },
+	{ "DISABLE_PASSIVE_SVC_CHECKS", CMD_DISABLE_PASSIVE_SVC_CHECKS },
+	{ "DELAY_SVC_NOTIFICATION", CMD_DELAY_SVC_NOTIFICATION },
+	{ "ENABLE_SVC_NOTIFICATIONS", CMD_ENABLE_SVC_NOTIFICATIONS },
+	{ "DISABLE_SVC_NOTIFICATIONS", CMD_DISABLE_SVC_NOTIFICATIONS },
+	{ "PROCESS_SERVICE_CHECK_RESULT", CMD_PROCESS_SERVICE_CHECK_RESULT },
+	{ "PROCESS_HOST_CHECK_RESULT", CMD_PROCESS_HOST_CHECK_RESULT },
+	{ "ENABLE_SVC_EVENT_HANDLER", CMD_ENABLE_SVC_EVENT_HANDLER },
+	{ "DISABLE_SVC_EVENT_HANDLER", CMD_DISABLE_SVC_EVENT_HANDLER },
+	{ "ENABLE_SVC_FLAP_DETECTION", CMD_ENABLE_SVC_FLAP_DETECTION },
+	{ "DISABLE_SVC_FLAP_DETECTION", CMD_DISABLE_SVC_FLAP_DETECTION },
+	{ "SCHEDULE_SVC_DOWNTIME", CMD_SCHEDULE_SVC_DOWNTIME },
+	{ "DEL_SVC_DOWNTIME", CMD_DEL_SVC_DOWNTIME },
+	{ "ACKNOWLEDGE_SVC_PROBLEM", CMD_ACKNOWLEDGE_SVC_PROBLEM },
+	{ "REMOVE_SVC_ACKNOWLEDGEMENT", CMD_REMOVE_SVC_ACKNOWLEDGEMENT },
+	{ "START_OBSESSING_OVER_SVC", CMD_START_OBSESSING_OVER_SVC },
+	{ "STOP_OBSESSING_OVER_SVC", CMD_STOP_OBSESSING_OVER_SVC },
+	{ "CHANGE_SVC_EVENT_HANDLER", CMD_CHANGE_SVC_EVENT_HANDLER },
+	{ "CHANGE_SVC_CHECK_COMMAND", CMD_CHANGE_SVC_CHECK_COMMAND },
+	{ "CHANGE_NORMAL_SVC_CHECK_INTERVAL", CMD_CHANGE_NORMAL_SVC_CHECK_INTERVAL },
+	{ "CHANGE_RETRY_SVC_CHECK_INTERVAL", CMD_CHANGE_RETRY_SVC_CHECK_INTERVAL },
+	{ "CHANGE_MAX_SVC_CHECK_ATTEMPTS", CMD_CHANGE_MAX_SVC_CHECK_ATTEMPTS },
+	{ "SET_SVC_NOTIFICATION_NUMBER", CMD_SET_SVC_NOTIFICATION_NUMBER },
+	{ "CHANGE_SVC_CHECK_TIMEPERIOD", CMD_CHANGE_SVC_CHECK_TIMEPERIOD },
+	{ "CHANGE_CUSTOM_SVC_VAR", CMD_CHANGE_CUSTOM_SVC_VAR },
+	{ "CHANGE_CUSTOM_CONTACT_VAR", CMD_CHANGE_CUSTOM_CONTACT_VAR },
+	{ "SEND_CUSTOM_SVC_NOTIFICATION", CMD_SEND_CUSTOM_SVC_NOTIFICATION },
+	{ "CHANGE_SVC_NOTIFICATION_TIMEPERIOD", CMD_CHANGE_SVC_NOTIFICATION_TIMEPERIOD },
+	{ "CHANGE_SVC_MODATTR", CMD_CHANGE_SVC_MODATTR },
+	{ "CLEAR_SVC_FLAPPING_STATE", CMD_CLEAR_SVC_FLAPPING_STATE },
+
+	/* servicegroup-related commands */
+	{ "ENABLE_SERVICEGROUP_HOST_NOTIFICATIONS", CMD_ENABLE_SERVICEGROUP_HOST_NOTIFICATIONS },
+	{ "DISABLE_SERVICEGROUP_HOST_NOTIFICATIONS", CMD_DISABLE_SERVICEGROUP_HOST_NOTIFICATIONS },
+	{ "ENABLE_SERVICEGROUP_SVC_NOTIFICATIONS", CMD_ENABLE_SERVICEGROUP_SVC_NOTIFICATIONS },
+	{ "DISABLE_SERVICEGROUP_SVC_NOTIFICATIONS", CMD_DISABLE_SERVICEGROUP_SVC_NOTIFICATIONS },
+	{ "ENABLE_SERVICEGROUP_HOST_CHECKS", CMD_ENABLE_SERVICEGROUP_HOST_CHECKS },
+	{ "DISABLE_SERVICEGROUP_HOST_CHECKS", CMD_DISABLE_SERVICEGROUP_HOST_CHECKS },
+	{ "ENABLE_SERVICEGROUP_PASSIVE_HOST_CHECKS", CMD_ENABLE_SERVICEGROUP_PASSIVE_HOST_CHECKS },
+	{ "DISABLE_SERVICEGROUP_PASSIVE_HOST_CHECKS", CMD_DISABLE_SERVICEGROUP_PASSIVE_HOST_CHECKS },
+	{ "ENABLE_SERVICEGROUP_SVC_CHECKS", CMD_ENABLE_SERVICEGROUP_SVC_CHECKS },
+	{ "DISABLE_SERVICEGROUP_SVC_CHECKS", CMD_DISABLE_SERVICEGROUP_SVC_CHECKS },
+	{ "ENABLE_SERVICEGROUP_PASSIVE_SVC_CHECKS", CMD_ENABLE_SERVICEGROUP_PASSIVE_SVC_CHECKS },
+	{ "DISABLE_SERVICEGROUP_PASSIVE_SVC_CHECKS", CMD_DISABLE_SERVICEGROUP_PASSIVE_SVC_CHECKS },
+	{ "SCHEDULE_SERVICEGROUP_HOST_DOWNTIME", CMD_SCHEDULE_SERVICEGROUP_HOST_DOWNTIME },
+	{ "SCHEDULE_SERVICEGROUP_SVC_DOWNTIME", CMD_SCHEDULE_SERVICEGROUP_SVC_DOWNTIME },
+
+	/* contact-related commands */
+	{ "ENABLE_CONTACT_HOST_NOTIFICATIONS", CMD_ENABLE_CONTACT_HOST_NOTIFICATIONS },
+	{ "DISABLE_CONTACT_HOST_NOTIFICATIONS", CMD_DISABLE_CONTACT_HOST_NOTIFICATIONS },
+	{ "ENABLE_CONTACT_SVC_NOTIFICATIONS", CMD_ENABLE_CONTACT_SVC_NOTIFICATIONS },
+	{ "DISABLE_CONTACT_SVC_NOTIFICATIONS", CMD_DISABLE_CONTACT_SVC_NOTIFICATIONS },
+	{ "CHANGE_CONTACT_HOST_NOTIFICATION_TIMEPERIOD", CMD_CHANGE_CONTACT_HOST_NOTIFICATION_TIMEPERIOD },
+	{ "CHANGE_CONTACT_SVC_NOTIFICATION_TIMEPERIOD", CMD_CHANGE_CONTACT_SVC_NOTIFICATION_TIMEPERIOD },
+	{ "CHANGE_CONTACT_MODATTR", CMD_CHANGE_CONTACT_MODATTR },
+	{ "CHANGE_CONTACT_MODHATTR", CMD_CHANGE_CONTACT_MODHATTR },
+	{ "CHANGE_CONTACT_MODSATTR", CMD_CHANGE_CONTACT_MODSATTR },
+
+	/* contactgroup-related commands */
+	{ "ENABLE_CONTACTGROUP_HOST_NOTIFICATIONS", CMD_ENABLE_CONTACTGROUP_HOST_NOTIFICATIONS },
+	{ "DISABLE_CONTACTGROUP_HOST_NOTIFICATIONS", CMD_DISABLE_CONTACTGROUP_HOST_NOTIFICATIONS },
+	{ "ENABLE_CONTACTGROUP_SVC_NOTIFICATIONS", CMD_ENABLE_CONTACTGROUP_SVC_NOTIFICATIONS },
+	{ "DISABLE_CONTACTGROUP_SVC_NOTIFICATIONS", CMD_DISABLE_CONTACTGROUP_SVC_NOTIFICATIONS },
+
+	/* misc commands */
+	{ "PROCESS_FILE", CMD_PROCESS_FILE },
+};
+
+static dkhash_table *external_command_table;
+
+/* returns the CMD_* id of the named external command, or CMD_NONE */
+int external_command_id(const char *name) {
+	char uname[64];
+	const int *id;
+	unsigned int i;
+
+	if(name == NULL)
+		return CMD_NONE;
+
+	/* custom commands aren't handled internally by Nagios, but may be by NEB modules */
+	if(name[0] == '_')
+		return CMD_CUSTOM_COMMAND;
+
+	if(external_command_table == NULL) {
+		unsigned int entries = sizeof(external_command_names) / sizeof(external_command_names[0]);
+		if((external_command_table = dkhash_create(entries * 2)) == NULL)
+			return CMD_NONE;
+		for(i = 0; i < entries; i++)
+			dkhash_insert(external_command_table, external_command_names[i].name, NULL, (void *)&external_command_names[i].id);
+		}
+
+	/* names are case-insensitive, but the table is keyed on upper case */
+	for(i = 0; name[i] && i < sizeof(uname) - 1; i++)
+		uname[i] = toupper((unsigned char)name[i]);
+	if(name[i])
+		return CMD_NONE;
+	uname[i] = 0;
+
+	if((id = dkhash_get(external_command_table, uname, NULL)) == NULL)
+		return CMD_NONE;
+	return *id;
+	}
+
+
 /* top-level external command processor */
 int process_external_command1(char *cmd) {
-	char *temp_buffer = NULL;
-	char *command_id = NULL;
-	char *args = NULL;
-	time_t entry_time = 0L;
-	int command_type = CMD_NONE;
-	char *temp_ptr = NULL;
+	struct external_command ec;
 	int external_command_ret = OK;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "process_external_command1()\n");
@@ -387,505 +727,113 @@ int process_external_command1(char *cmd) {
 	if(cmd == NULL)
 		return CMD_ERROR_MALFORMED_COMMAND;
 
-	/* strip the command of newlines and carriage returns */
-	strip(cmd);
-
 	log_debug_info(DEBUGL_EXTERNALCOMMANDS, 2, "Raw command entry: %s\n", cmd);
 
-	/* get the command entry time */
-	if((temp_ptr = my_strtok_with_free(cmd, "[", FALSE)) == NULL)
-		return CMD_ERROR_MALFORMED_COMMAND;
-	if((temp_ptr = my_strtok_with_free(NULL, "]", FALSE)) == NULL) {
-		temp_ptr = my_strtok_with_free(NULL, NULL, TRUE);
-		return CMD_ERROR_MALFORMED_COMMAND;
-		}
-	entry_time = (time_t)strtoul(temp_ptr, NULL, 10);
-
-	/* get the command identifier */
-	if((temp_ptr = my_strtok_with_free(NULL, ";", FALSE)) == NULL) {
-		temp_ptr = my_strtok_with_free(NULL, NULL, TRUE);
-		return CMD_ERROR_MALFORMED_COMMAND;
-		}
-	else if((command_id = (char *)strdup(temp_ptr + 1)) == NULL) {
-		temp_ptr = my_strtok_with_free(NULL, NULL, TRUE);
-		return CMD_ERROR_INTERNAL_ERROR;
-		}
-
-	/* get the command arguments */
-	if((temp_ptr = my_strtok_with_free(NULL, "\n", FALSE)) == NULL)
-		args = (char *)strdup("");
-	else
-		args = (char *)strdup(temp_ptr);
-
-	temp_ptr = my_strtok_with_free(NULL, NULL, TRUE);
-	if(args == NULL) {
-		my_free(command_id);
-		return CMD_ERROR_INTERNAL_ERROR;
-		}
-
-	/* decide what type of command this is... */
-
-	/**************************/
-	/**** PROCESS COMMANDS ****/
-	/**************************/
-
-	if(!strcasecmp(command_id, "ENTER_STANDBY_MODE") || !strcasecmp(command_id, "DISABLE_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "ENTER_ACTIVE_MODE") || !strcasecmp(command_id, "ENABLE_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_NOTIFICATIONS;
-
-	else if(!strcasecmp(command_id, "SHUTDOWN_PROGRAM") || !strcasecmp(command_id, "SHUTDOWN_PROCESS"))
-		command_type = CMD_SHUTDOWN_PROCESS;
-	else if(!strcasecmp(command_id, "RESTART_PROGRAM") || !strcasecmp(command_id, "RESTART_PROCESS"))
-		command_type = CMD_RESTART_PROCESS;
-
-	else if(!strcasecmp(command_id, "SAVE_STATE_INFORMATION"))
-		command_type = CMD_SAVE_STATE_INFORMATION;
-	else if(!strcasecmp(command_id, "READ_STATE_INFORMATION"))
-		command_type = CMD_READ_STATE_INFORMATION;
-
-	else if(!strcasecmp(command_id, "ENABLE_EVENT_HANDLERS"))
-		command_type = CMD_ENABLE_EVENT_HANDLERS;
-	else if(!strcasecmp(command_id, "DISABLE_EVENT_HANDLERS"))
-		command_type = CMD_DISABLE_EVENT_HANDLERS;
-
-	else if(!strcasecmp(command_id, "ENABLE_PERFORMANCE_DATA"))
-		command_type = CMD_ENABLE_PERFORMANCE_DATA;
-	else if(!strcasecmp(command_id, "DISABLE_PERFORMANCE_DATA"))
-		command_type = CMD_DISABLE_PERFORMANCE_DATA;
-
-	else if(!strcasecmp(command_id, "START_EXECUTING_HOST_CHECKS"))
-		command_type = CMD_START_EXECUTING_HOST_CHECKS;
-	else if(!strcasecmp(command_id, "STOP_EXECUTING_HOST_CHECKS"))
-		command_type = CMD_STOP_EXECUTING_HOST_CHECKS;
-
-	else if(!strcasecmp(command_id, "START_EXECUTING_SVC_CHECKS"))
-		command_type = CMD_START_EXECUTING_SVC_CHECKS;
-	else if(!strcasecmp(command_id, "STOP_EXECUTING_SVC_CHECKS"))
-		command_type = CMD_STOP_EXECUTING_SVC_CHECKS;
-
-	else if(!strcasecmp(command_id, "START_ACCEPTING_PASSIVE_HOST_CHECKS"))
-		command_type = CMD_START_ACCEPTING_PASSIVE_HOST_CHECKS;
-	else if(!strcasecmp(command_id, "STOP_ACCEPTING_PASSIVE_HOST_CHECKS"))
-		command_type = CMD_STOP_ACCEPTING_PASSIVE_HOST_CHECKS;
-
-	else if(!strcasecmp(command_id, "START_ACCEPTING_PASSIVE_SVC_CHECKS"))
-		command_type = CMD_START_ACCEPTING_PASSIVE_SVC_CHECKS;
-	else if(!strcasecmp(command_id, "STOP_ACCEPTING_PASSIVE_SVC_CHECKS"))
-		command_type = CMD_STOP_ACCEPTING_PASSIVE_SVC_CHECKS;
-
-	else if(!strcasecmp(command_id, "START_OBSESSING_OVER_HOST_CHECKS"))
-		command_type = CMD_START_OBSESSING_OVER_HOST_CHECKS;
-	else if(!strcasecmp(command_id, "STOP_OBSESSING_OVER_HOST_CHECKS"))
-		command_type = CMD_STOP_OBSESSING_OVER_HOST_CHECKS;
-
-	else if(!strcasecmp(command_id, "START_OBSESSING_OVER_SVC_CHECKS"))
-		command_type = CMD_START_OBSESSING_OVER_SVC_CHECKS;
-	else if(!strcasecmp(command_id, "STOP_OBSESSING_OVER_SVC_CHECKS"))
-		command_type = CMD_STOP_OBSESSING_OVER_SVC_CHECKS;
-
-	else if(!strcasecmp(command_id, "ENABLE_FLAP_DETECTION"))
-		command_type = CMD_ENABLE_FLAP_DETECTION;
-	else if(!strcasecmp(command_id, "DISABLE_FLAP_DETECTION"))
-		command_type = CMD_DISABLE_FLAP_DETECTION;
-
-	else if(!strcasecmp(command_id, "CHANGE_GLOBAL_HOST_EVENT_HANDLER"))
-		command_type = CMD_CHANGE_GLOBAL_HOST_EVENT_HANDLER;
-	else if(!strcasecmp(command_id, "CHANGE_GLOBAL_SVC_EVENT_HANDLER"))
-		command_type = CMD_CHANGE_GLOBAL_SVC_EVENT_HANDLER;
-
-	else if(!strcasecmp(command_id, "ENABLE_SERVICE_FRESHNESS_CHECKS"))
-		command_type = CMD_ENABLE_SERVICE_FRESHNESS_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_SERVICE_FRESHNESS_CHECKS"))
-		command_type = CMD_DISABLE_SERVICE_FRESHNESS_CHECKS;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOST_FRESHNESS_CHECKS"))
-		command_type = CMD_ENABLE_HOST_FRESHNESS_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_HOST_FRESHNESS_CHECKS"))
-		command_type = CMD_DISABLE_HOST_FRESHNESS_CHECKS;
-
-
-	/*******************************/
-	/**** HOST-RELATED COMMANDS ****/
-	/*******************************/
-
-	else if(!strcasecmp(command_id, "ADD_HOST_COMMENT"))
-		command_type = CMD_ADD_HOST_COMMENT;
-	else if(!strcasecmp(command_id, "DEL_HOST_COMMENT"))
-		command_type = CMD_DEL_HOST_COMMENT;
-	else if(!strcasecmp(command_id, "DEL_ALL_HOST_COMMENTS"))
-		command_type = CMD_DEL_ALL_HOST_COMMENTS;
-
-	else if(!strcasecmp(command_id, "DELAY_HOST_NOTIFICATION"))
-		command_type = CMD_DELAY_HOST_NOTIFICATION;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOST_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_HOST_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_HOST_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_HOST_NOTIFICATIONS;
-
-	else if(!strcasecmp(command_id, "ENABLE_ALL_NOTIFICATIONS_BEYOND_HOST"))
-		command_type = CMD_ENABLE_ALL_NOTIFICATIONS_BEYOND_HOST;
-	else if(!strcasecmp(command_id, "DISABLE_ALL_NOTIFICATIONS_BEYOND_HOST"))
-		command_type = CMD_DISABLE_ALL_NOTIFICATIONS_BEYOND_HOST;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOST_AND_CHILD_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_HOST_AND_CHILD_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_HOST_AND_CHILD_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_HOST_AND_CHILD_NOTIFICATIONS;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOST_SVC_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_HOST_SVC_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_HOST_SVC_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_HOST_SVC_NOTIFICATIONS;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOST_SVC_CHECKS"))
-		command_type = CMD_ENABLE_HOST_SVC_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_HOST_SVC_CHECKS"))
-		command_type = CMD_DISABLE_HOST_SVC_CHECKS;
-
-	else if(!strcasecmp(command_id, "ENABLE_PASSIVE_HOST_CHECKS"))
-		command_type = CMD_ENABLE_PASSIVE_HOST_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_PASSIVE_HOST_CHECKS"))
-		command_type = CMD_DISABLE_PASSIVE_HOST_CHECKS;
-
-	else if(!strcasecmp(command_id, "SCHEDULE_HOST_SVC_CHECKS"))
-		command_type = CMD_SCHEDULE_HOST_SVC_CHECKS;
-	else if(!strcasecmp(command_id, "SCHEDULE_FORCED_HOST_SVC_CHECKS"))
-		command_type = CMD_SCHEDULE_FORCED_HOST_SVC_CHECKS;
-
-	else if(!strcasecmp(command_id, "ACKNOWLEDGE_HOST_PROBLEM"))
-		command_type = CMD_ACKNOWLEDGE_HOST_PROBLEM;
-	else if(!strcasecmp(command_id, "REMOVE_HOST_ACKNOWLEDGEMENT"))
-		command_type = CMD_REMOVE_HOST_ACKNOWLEDGEMENT;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOST_EVENT_HANDLER"))
-		command_type = CMD_ENABLE_HOST_EVENT_HANDLER;
-	else if(!strcasecmp(command_id, "DISABLE_HOST_EVENT_HANDLER"))
-		command_type = CMD_DISABLE_HOST_EVENT_HANDLER;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOST_CHECK"))
-		command_type = CMD_ENABLE_HOST_CHECK;
-	else if(!strcasecmp(command_id, "DISABLE_HOST_CHECK"))
-		command_type = CMD_DISABLE_HOST_CHECK;
-
-	else if(!strcasecmp(command_id, "SCHEDULE_HOST_CHECK"))
-		command_type = CMD_SCHEDULE_HOST_CHECK;
-	else if(!strcasecmp(command_id, "SCHEDULE_FORCED_HOST_CHECK"))
-		command_type = CMD_SCHEDULE_FORCED_HOST_CHECK;
-
-	else if(!strcasecmp(command_id, "SCHEDULE_HOST_DOWNTIME"))
-		command_type = CMD_SCHEDULE_HOST_DOWNTIME;
-	else if(!strcasecmp(command_id, "SCHEDULE_HOST_SVC_DOWNTIME"))
-		command_type = CMD_SCHEDULE_HOST_SVC_DOWNTIME;
-	else if(!strcasecmp(command_id, "DEL_HOST_DOWNTIME"))
-		command_type = CMD_DEL_HOST_DOWNTIME;
-	else if(!strcasecmp(command_id, "DEL_DOWNTIME_BY_HOST_NAME"))
-		command_type = CMD_DEL_DOWNTIME_BY_HOST_NAME;
-	else if(!strcasecmp(command_id, "DEL_DOWNTIME_BY_HOSTGROUP_NAME"))
-		command_type = CMD_DEL_DOWNTIME_BY_HOSTGROUP_NAME;
-	else if(!strcasecmp(command_id, "DEL_DOWNTIME_BY_START_TIME_COMMENT"))
-		command_type = CMD_DEL_DOWNTIME_BY_START_TIME_COMMENT;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOST_FLAP_DETECTION"))
-		command_type = CMD_ENABLE_HOST_FLAP_DETECTION;
-	else if(!strcasecmp(command_id, "DISABLE_HOST_FLAP_DETECTION"))
-		command_type = CMD_DISABLE_HOST_FLAP_DETECTION;
-
-	else if(!strcasecmp(command_id, "START_OBSESSING_OVER_HOST"))
-		command_type = CMD_START_OBSESSING_OVER_HOST;
-	else if(!strcasecmp(command_id, "STOP_OBSESSING_OVER_HOST"))
-		command_type = CMD_STOP_OBSESSING_OVER_HOST;
-
-	else if(!strcasecmp(command_id, "CHANGE_HOST_EVENT_HANDLER"))
-		command_type = CMD_CHANGE_HOST_EVENT_HANDLER;
-	else if(!strcasecmp(command_id, "CHANGE_HOST_CHECK_COMMAND"))
-		command_type = CMD_CHANGE_HOST_CHECK_COMMAND;
-
-	else if(!strcasecmp(command_id, "CHANGE_NORMAL_HOST_CHECK_INTERVAL"))
-		command_type = CMD_CHANGE_NORMAL_HOST_CHECK_INTERVAL;
-	else if(!strcasecmp(command_id, "CHANGE_RETRY_HOST_CHECK_INTERVAL"))
-		command_type = CMD_CHANGE_RETRY_HOST_CHECK_INTERVAL;
-
-	else if(!strcasecmp(command_id, "CHANGE_MAX_HOST_CHECK_ATTEMPTS"))
-		command_type = CMD_CHANGE_MAX_HOST_CHECK_ATTEMPTS;
-
-	else if(!strcasecmp(command_id, "SCHEDULE_AND_PROPAGATE_TRIGGERED_HOST_DOWNTIME"))
-		command_type = CMD_SCHEDULE_AND_PROPAGATE_TRIGGERED_HOST_DOWNTIME;
-
-	else if(!strcasecmp(command_id, "SCHEDULE_AND_PROPAGATE_HOST_DOWNTIME"))
-		command_type = CMD_SCHEDULE_AND_PROPAGATE_HOST_DOWNTIME;
-
-	else if(!strcasecmp(command_id, "SET_HOST_NOTIFICATION_NUMBER"))
-		command_type = CMD_SET_HOST_NOTIFICATION_NUMBER;
-
-	else if(!strcasecmp(command_id, "CHANGE_HOST_CHECK_TIMEPERIOD"))
-		command_type = CMD_CHANGE_HOST_CHECK_TIMEPERIOD;
-
-	else if(!strcasecmp(command_id, "CHANGE_CUSTOM_HOST_VAR"))
-		command_type = CMD_CHANGE_CUSTOM_HOST_VAR;
-
-	else if(!strcasecmp(command_id, "SEND_CUSTOM_HOST_NOTIFICATION"))
-		command_type = CMD_SEND_CUSTOM_HOST_NOTIFICATION;
-
-	else if(!strcasecmp(command_id, "CHANGE_HOST_NOTIFICATION_TIMEPERIOD"))
-		command_type = CMD_CHANGE_HOST_NOTIFICATION_TIMEPERIOD;
-
-	else if(!strcasecmp(command_id, "CHANGE_HOST_MODATTR"))
-		command_type = CMD_CHANGE_HOST_MODATTR;
-
-	else if (!strcasecmp(command_id,"CLEAR_HOST_FLAPPING_STATE"))
-		command_type = CMD_CLEAR_HOST_FLAPPING_STATE;
-
-	/************************************/
-	/**** HOSTGROUP-RELATED COMMANDS ****/
-	/************************************/
-
-	else if(!strcasecmp(command_id, "ENABLE_HOSTGROUP_HOST_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_HOSTGROUP_HOST_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_HOSTGROUP_HOST_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_HOSTGROUP_HOST_NOTIFICATIONS;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOSTGROUP_SVC_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_HOSTGROUP_SVC_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_HOSTGROUP_SVC_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_HOSTGROUP_SVC_NOTIFICATIONS;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOSTGROUP_HOST_CHECKS"))
-		command_type = CMD_ENABLE_HOSTGROUP_HOST_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_HOSTGROUP_HOST_CHECKS"))
-		command_type = CMD_DISABLE_HOSTGROUP_HOST_CHECKS;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOSTGROUP_PASSIVE_HOST_CHECKS"))
-		command_type = CMD_ENABLE_HOSTGROUP_PASSIVE_HOST_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_HOSTGROUP_PASSIVE_HOST_CHECKS"))
-		command_type = CMD_DISABLE_HOSTGROUP_PASSIVE_HOST_CHECKS;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOSTGROUP_SVC_CHECKS"))
-		command_type = CMD_ENABLE_HOSTGROUP_SVC_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_HOSTGROUP_SVC_CHECKS"))
-		command_type = CMD_DISABLE_HOSTGROUP_SVC_CHECKS;
-
-	else if(!strcasecmp(command_id, "ENABLE_HOSTGROUP_PASSIVE_SVC_CHECKS"))
-		command_type = CMD_ENABLE_HOSTGROUP_PASSIVE_SVC_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_HOSTGROUP_PASSIVE_SVC_CHECKS"))
-		command_type = CMD_DISABLE_HOSTGROUP_PASSIVE_SVC_CHECKS;
-
-	else if(!strcasecmp(command_id, "SCHEDULE_HOSTGROUP_HOST_DOWNTIME"))
-		command_type = CMD_SCHEDULE_HOSTGROUP_HOST_DOWNTIME;
-	else if(!strcasecmp(command_id, "SCHEDULE_HOSTGROUP_SVC_DOWNTIME"))
-		command_type = CMD_SCHEDULE_HOSTGROUP_SVC_DOWNTIME;
-
-
-	/**********************************/
-	/**** SERVICE-RELATED COMMANDS ****/
-	/**********************************/
-
-	else if(!strcasecmp(command_id, "ADD_SVC_COMMENT"))
-		command_type = CMD_ADD_SVC_COMMENT;
-	else if(!strcasecmp(command_id, "DEL_SVC_COMMENT"))
-		command_type = CMD_DEL_SVC_COMMENT;
-	else if(!strcasecmp(command_id, "DEL_ALL_SVC_COMMENTS"))
-		command_type = CMD_DEL_ALL_SVC_COMMENTS;
-
-	else if(!strcasecmp(command_id, "SCHEDULE_SVC_CHECK"))
-		command_type = CMD_SCHEDULE_SVC_CHECK;
-	else if(!strcasecmp(command_id, "SCHEDULE_FORCED_SVC_CHECK"))
-		command_type = CMD_SCHEDULE_FORCED_SVC_CHECK;
-
-	else if(!strcasecmp(command_id, "ENABLE_SVC_CHECK"))
-		command_type = CMD_ENABLE_SVC_CHECK;
-	else if(!strcasecmp(command_id, "DISABLE_SVC_CHECK"))
-		command_type = CMD_DISABLE_SVC_CHECK;
-
-	else if(!strcasecmp(command_id, "ENABLE_PASSIVE_SVC_CHECKS"))
-		command_type = CMD_ENABLE_PASSIVE_SVC_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_PASSIVE_SVC_CHECKS"))
-		command_type = CMD_DISABLE_PASSIVE_SVC_CHECKS;
-
-	else if(!strcasecmp(command_id, "DELAY_SVC_NOTIFICATION"))
-		command_type = CMD_DELAY_SVC_NOTIFICATION;
-	else if(!strcasecmp(command_id, "ENABLE_SVC_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_SVC_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_SVC_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_SVC_NOTIFICATIONS;
-
-	else if(!strcasecmp(command_id, "PROCESS_SERVICE_CHECK_RESULT"))
-		command_type = CMD_PROCESS_SERVICE_CHECK_RESULT;
-	else if(!strcasecmp(command_id, "PROCESS_HOST_CHECK_RESULT"))
-		command_type = CMD_PROCESS_HOST_CHECK_RESULT;
-
-	else if(!strcasecmp(command_id, "ENABLE_SVC_EVENT_HANDLER"))
-		command_type = CMD_ENABLE_SVC_EVENT_HANDLER;
-	else if(!strcasecmp(command_id, "DISABLE_SVC_EVENT_HANDLER"))
-		command_type = CMD_DISABLE_SVC_EVENT_HANDLER;
-
-	else if(!strcasecmp(command_id, "ENABLE_SVC_FLAP_DETECTION"))
-		command_type = CMD_ENABLE_SVC_FLAP_DETECTION;
-	else if(!strcasecmp(command_id, "DISABLE_SVC_FLAP_DETECTION"))
-		command_type = CMD_DISABLE_SVC_FLAP_DETECTION;
-
-	else if(!strcasecmp(command_id, "SCHEDULE_SVC_DOWNTIME"))
-		command_type = CMD_SCHEDULE_SVC_DOWNTIME;
-	else if(!strcasecmp(command_id, "DEL_SVC_DOWNTIME"))
-		command_type = CMD_DEL_SVC_DOWNTIME;
-
-	else if(!strcasecmp(command_id, "ACKNOWLEDGE_SVC_PROBLEM"))
-		command_type = CMD_ACKNOWLEDGE_SVC_PROBLEM;
-	else if(!strcasecmp(command_id, "REMOVE_SVC_ACKNOWLEDGEMENT"))
-		command_type = CMD_REMOVE_SVC_ACKNOWLEDGEMENT;
-
-	else if(!strcasecmp(command_id, "START_OBSESSING_OVER_SVC"))
-		command_type = CMD_START_OBSESSING_OVER_SVC;
-	else if(!strcasecmp(command_id, "STOP_OBSESSING_OVER_SVC"))
-		command_type = CMD_STOP_OBSESSING_OVER_SVC;
-
-	else if(!strcasecmp(command_id, "CHANGE_SVC_EVENT_HANDLER"))
-		command_type = CMD_CHANGE_SVC_EVENT_HANDLER;
-	else if(!strcasecmp(command_id, "CHANGE_SVC_CHECK_COMMAND"))
-		command_type = CMD_CHANGE_SVC_CHECK_COMMAND;
-
-	else if(!strcasecmp(command_id, "CHANGE_NORMAL_SVC_CHECK_INTERVAL"))
-		command_type = CMD_CHANGE_NORMAL_SVC_CHECK_INTERVAL;
-	else if(!strcasecmp(command_id, "CHANGE_RETRY_SVC_CHECK_INTERVAL"))
-		command_type = CMD_CHANGE_RETRY_SVC_CHECK_INTERVAL;
-
-	else if(!strcasecmp(command_id, "CHANGE_MAX_SVC_CHECK_ATTEMPTS"))
-		command_type = CMD_CHANGE_MAX_SVC_CHECK_ATTEMPTS;
-
-	else if(!strcasecmp(command_id, "SET_SVC_NOTIFICATION_NUMBER"))
-		command_type = CMD_SET_SVC_NOTIFICATION_NUMBER;
-
-	else if(!strcasecmp(command_id, "CHANGE_SVC_CHECK_TIMEPERIOD"))
-		command_type = CMD_CHANGE_SVC_CHECK_TIMEPERIOD;
-
-	else if(!strcasecmp(command_id, "CHANGE_CUSTOM_SVC_VAR"))
-		command_type = CMD_CHANGE_CUSTOM_SVC_VAR;
-
-	else if(!strcasecmp(command_id, "CHANGE_CUSTOM_CONTACT_VAR"))
-		command_type = CMD_CHANGE_CUSTOM_CONTACT_VAR;
-
-	else if(!strcasecmp(command_id, "SEND_CUSTOM_SVC_NOTIFICATION"))
-		command_type = CMD_SEND_CUSTOM_SVC_NOTIFICATION;
-
-	else if(!strcasecmp(command_id, "CHANGE_SVC_NOTIFICATION_TIMEPERIOD"))
-		command_type = CMD_CHANGE_SVC_NOTIFICATION_TIMEPERIOD;
-
-	else if(!strcasecmp(command_id, "CHANGE_SVC_MODATTR"))
-		command_type = CMD_CHANGE_SVC_MODATTR;
-
-	else if (!strcasecmp(command_id,"CLEAR_SVC_FLAPPING_STATE"))
-		command_type = CMD_CLEAR_SVC_FLAPPING_STATE;
-
-	/***************************************/
-	/**** SERVICEGROUP-RELATED COMMANDS ****/
-	/***************************************/
-
-	else if(!strcasecmp(command_id, "ENABLE_SERVICEGROUP_HOST_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_SERVICEGROUP_HOST_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_SERVICEGROUP_HOST_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_SERVICEGROUP_HOST_NOTIFICATIONS;
-
-	else if(!strcasecmp(command_id, "ENABLE_SERVICEGROUP_SVC_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_SERVICEGROUP_SVC_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_SERVICEGROUP_SVC_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_SERVICEGROUP_SVC_NOTIFICATIONS;
+	if((external_command_ret = parse_external_command(cmd, &ec)) == CMD_ERROR_OK)
+		external_command_ret = process_parsed_external_command(&ec);
 
-	else if(!strcasecmp(command_id, "ENABLE_SERVICEGROUP_HOST_CHECKS"))
-		command_type = CMD_ENABLE_SERVICEGROUP_HOST_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_SERVICEGROUP_HOST_CHECKS"))
-		command_type = CMD_DISABLE_SERVICEGROUP_HOST_CHECKS;
-
-	else if(!strcasecmp(command_id, "ENABLE_SERVICEGROUP_PASSIVE_HOST_CHECKS"))
-		command_type = CMD_ENABLE_SERVICEGROUP_PASSIVE_HOST_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_SERVICEGROUP_PASSIVE_HOST_CHECKS"))
-		command_type = CMD_DISABLE_SERVICEGROUP_PASSIVE_HOST_CHECKS;
-
-	else if(!strcasecmp(command_id, "ENABLE_SERVICEGROUP_SVC_CHECKS"))
-		command_type = CMD_ENABLE_SERVICEGROUP_SVC_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_SERVICEGROUP_SVC_CHECKS"))
-		command_type = CMD_DISABLE_SERVICEGROUP_SVC_CHECKS;
-
-	else if(!strcasecmp(command_id, "ENABLE_SERVICEGROUP_PASSIVE_SVC_CHECKS"))
-		command_type = CMD_ENABLE_SERVICEGROUP_PASSIVE_SVC_CHECKS;
-	else if(!strcasecmp(command_id, "DISABLE_SERVICEGROUP_PASSIVE_SVC_CHECKS"))
-		command_type = CMD_DISABLE_SERVICEGROUP_PASSIVE_SVC_CHECKS;
-
-	else if(!strcasecmp(command_id, "SCHEDULE_SERVICEGROUP_HOST_DOWNTIME"))
-		command_type = CMD_SCHEDULE_SERVICEGROUP_HOST_DOWNTIME;
-	else if(!strcasecmp(command_id, "SCHEDULE_SERVICEGROUP_SVC_DOWNTIME"))
-		command_type = CMD_SCHEDULE_SERVICEGROUP_SVC_DOWNTIME;
+	/* free memory */
+	my_free(ec.split_args);
 
+	return external_command_ret;
+	}
 
-	/**********************************/
-	/**** CONTACT-RELATED COMMANDS ****/
-	/**********************************/
+/* returns the next ';'-separated field of a string, the way my_strtok() does */
+static char *next_field(char **str) {
+	char *field = *str, *end;
 
-	else if(!strcasecmp(command_id, "ENABLE_CONTACT_HOST_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_CONTACT_HOST_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_CONTACT_HOST_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_CONTACT_HOST_NOTIFICATIONS;
+	if(*field == '\0')
+		return NULL;
 
-	else if(!strcasecmp(command_id, "ENABLE_CONTACT_SVC_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_CONTACT_SVC_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_CONTACT_SVC_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_CONTACT_SVC_NOTIFICATIONS;
+	if((end = strchr(field, ';')) == NULL)
+		*str = field + strlen(field);
+	else {
+		*end = '\0';
+		*str = end + 1;
+		}
 
-	else if(!strcasecmp(command_id, "CHANGE_CONTACT_HOST_NOTIFICATION_TIMEPERIOD"))
-		command_type = CMD_CHANGE_CONTACT_HOST_NOTIFICATION_TIMEPERIOD;
+	return field;
+	}
 
-	else if(!strcasecmp(command_id, "CHANGE_CONTACT_SVC_NOTIFICATION_TIMEPERIOD"))
-		command_type = CMD_CHANGE_CONTACT_SVC_NOTIFICATION_TIMEPERIOD;
 
-	else if(!strcasecmp(command_id, "CHANGE_CONTACT_MODATTR"))
-		command_type = CMD_CHANGE_CONTACT_MODATTR;
-	else if(!strcasecmp(command_id, "CHANGE_CONTACT_MODHATTR"))
-		command_type = CMD_CHANGE_CONTACT_MODHATTR;
-	else if(!strcasecmp(command_id, "CHANGE_CONTACT_MODSATTR"))
-		command_type = CMD_CHANGE_CONTACT_MODSATTR;
+/* unescapes check result output in place, like unescape_check_result_output() */
+static void unescape_output(char *str) {
+	char *dest = str;
 
-	/***************************************/
-	/**** CONTACTGROUP-RELATED COMMANDS ****/
-	/***************************************/
+	for(; *str; str++) {
+		if(*str == '\\' && (str[1] == '\\' || str[1] == 'n'))
+			*dest++ = *++str == 'n' ? '\n' : '\\';
+		else
+			*dest++ = *str;
+		}
+	*dest = '\0';
+	}
 
-	else if(!strcasecmp(command_id, "ENABLE_CONTACTGROUP_HOST_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_CONTACTGROUP_HOST_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_CONTACTGROUP_HOST_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_CONTACTGROUP_HOST_NOTIFICATIONS;
 
-	else if(!strcasecmp(command_id, "ENABLE_CONTACTGROUP_SVC_NOTIFICATIONS"))
-		command_type = CMD_ENABLE_CONTACTGROUP_SVC_NOTIFICATIONS;
-	else if(!strcasecmp(command_id, "DISABLE_CONTACTGROUP_SVC_NOTIFICATIONS"))
-		command_type = CMD_DISABLE_CONTACTGROUP_SVC_NOTIFICATIONS;
+/*
+ * splits a raw "[time] NAME;args" external command line up in place.
+ * This doesn't touch any object data, so the command file worker can
+ * do it for us.
+ */
+int parse_external_command(char *line, struct external_command *ec) {
+	char *ptr, *end, *field;
 
+	memset(ec, 0, sizeof(*ec));
 
-	/**************************/
-	/****** MISC COMMANDS *****/
-	/**************************/
+	if(line == NULL)
+		return CMD_ERROR_MALFORMED_COMMAND;
 
-	else if(!strcasecmp(command_id, "PROCESS_FILE"))
-		command_type = CMD_PROCESS_FILE;
+	/* strip the command of newlines and carriage returns */
+	strip(line);
 
+	/* get the command entry time */
+	if((ptr = strchr(line, '[')) == NULL || (end = strchr(ptr + 1, ']')) == NULL)
+		return CMD_ERROR_MALFORMED_COMMAND;
+	ec->entry_time = (time_t)strtoul(ptr + 1, NULL, 10);
 
+	/* get the command identifier, skipping the space after the entry time */
+	if(*(ptr = end + 1) == '\0')
+		return CMD_ERROR_MALFORMED_COMMAND;
+	if((end = strchr(ptr, ';')) != NULL) {
+		*end = '\0';
+		ec->args = end + 1;
+		}
+	else
+		ec->args = ptr + strlen(ptr);
+	ec->name = *ptr ? ptr + 1 : ptr;
+	ec->id = external_command_id(ec->name);
 
-	/****************************/
-	/****** CUSTOM COMMANDS *****/
-	/****************************/
+	if(ec->id != CMD_PROCESS_SERVICE_CHECK_RESULT && ec->id != CMD_PROCESS_HOST_CHECK_RESULT)
+		return CMD_ERROR_OK;
 
-	else if(command_id[0] == '_')
-		command_type = CMD_CUSTOM_COMMAND;
+	/* passive check results are by far the most common commands, so split them up as well */
+	if((ec->split_args = strdup(ec->args)) == NULL)
+		return CMD_ERROR_INTERNAL_ERROR;
+	ptr = ec->split_args;
+	if((ec->host_name = next_field(&ptr)) == NULL)
+		return CMD_ERROR_OK;
+	if(ec->id == CMD_PROCESS_SERVICE_CHECK_RESULT && (ec->service_description = next_field(&ptr)) == NULL)
+		return CMD_ERROR_OK;
+	if((field = next_field(&ptr)) == NULL)
+		return CMD_ERROR_OK;
+	ec->return_code = atoi(field);
+
+	/* the plugin output is whatever remains, and may be empty */
+	unescape_output(ptr);
+	ec->output = ptr;
+
+	return CMD_ERROR_OK;
+	}
 
 
+/* processes an external command that has already been parsed */
+int process_parsed_external_command(struct external_command *ec) {
+	char *temp_buffer = NULL;
+	int ret;
 
-	/**** UNKNOWN COMMAND ****/
-	else {
+	if(ec->id == CMD_NONE) {
 		/* log the bad external command */
-		logit(NSLOG_EXTERNAL_COMMAND | NSLOG_RUNTIME_WARNING, TRUE, "Warning: Unrecognized external command -> %s;%s\n", command_id, args);
-
-		/* free memory */
-		my_free(command_id);
-		my_free(args);
-
+		logit(NSLOG_EXTERNAL_COMMAND | NSLOG_RUNTIME_WARNING, TRUE, "Warning: Unrecognized external command -> %s;%s\n", ec->name, ec->args);
 		return CMD_ERROR_UNKNOWN_COMMAND;
 		}
 
@@ -893,8 +841,8 @@ int process_external_command1(char *cmd) {
 	update_check_stats(EXTERNAL_COMMAND_STATS, time(NULL));
 
 	/* log the external command */
-	asprintf(&temp_buffer, "EXTERNAL COMMAND: %s;%s\n", command_id, args);
-	if(command_type == CMD_PROCESS_SERVICE_CHECK_RESULT || command_type == CMD_PROCESS_HOST_CHECK_RESULT) {
+	asprintf(&temp_buffer, "EXTERNAL COMMAND: %s;%s\n", ec->name, ec->args);
+	if(ec->id == CMD_PROCESS_SERVICE_CHECK_RESULT || ec->id == CMD_PROCESS_HOST_CHECK_RESULT) {
 		/* passive checks are logged in checks.c as well, as some my bypass external commands by getting dropped in checkresults dir */
 		if(log_passive_checks == TRUE)
 			write_to_all_logs(temp_buffer, NSLOG_PASSIVE_CHECK);
@@ -907,26 +855,28 @@ int process_external_command1(char *cmd) {
 
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker */
-	broker_external_command(NEBTYPE_EXTERNALCOMMAND_START, NEBFLAG_NONE, NEBATTR_NONE, command_type, entry_time, command_id, args, NULL);
+	broker_external_command(NEBTYPE_EXTERNALCOMMAND_START, NEBFLAG_NONE, NEBATTR_NONE, ec->id, ec->entry_time, ec->name, ec->args, NULL);
 #endif
 
-	/* process the command */
-	external_command_ret = (process_external_command2(command_type, entry_time, args) == OK) ? CMD_ERROR_OK : CMD_ERROR_FAILURE;
-	if (external_command_ret != CMD_ERROR_OK) {
-			logit(NSLOG_EXTERNAL_COMMAND | NSLOG_RUNTIME_WARNING, TRUE, "Error: External command failed -> %s;%s\n", command_id, args);
+	/* process the command, skipping the argument parsing if it's been done for us */
+	if(ec->id == CMD_PROCESS_SERVICE_CHECK_RESULT && ec->output != NULL)
+		ret = process_passive_service_check(ec->entry_time, ec->host_name, ec->service_description, ec->return_code, ec->output);
+	else if(ec->id == CMD_PROCESS_HOST_CHECK_RESULT && ec->output != NULL)
+		ret = process_passive_host_check(ec->entry_time, ec->host_name, ec->return_code, ec->output);
+	else
+		ret = process_external_command2(ec->id, ec->entry_time, ec->args);
+	ret = (ret == OK) ? CMD_ERROR_OK : CMD_ERROR_FAILURE;
+	if (ret != CMD_ERROR_OK) {
+			logit(NSLOG_EXTERNAL_COMMAND | NSLOG_RUNTIME_WARNING, TRUE, "Error: External command failed -> %s;%s\n", ec->name, ec->args);
 	}
 
 
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker */
-	broker_external_command(NEBTYPE_EXTERNALCOMMAND_END, NEBFLAG_NONE, NEBATTR_NONE, command_type, entry_time, command_id, args, NULL);
+	broker_external_command(NEBTYPE_EXTERNALCOMMAND_END, NEBFLAG_NONE, NEBATTR_NONE, ec->id, ec->entry_time, ec->name, ec->args, NULL);
 #endif
 
-	/* free memory */
-	my_free(command_id);
-	my_free(args);
-
-	return external_command_ret;
+	return ret;
 	}
 
 const char *cmd_error_strerror(int code) {
@@ -3231,6 +3181,9 @@ int cmd_change_object_int_var(int cmd, char *args) {
 			broker_adaptive_service_data(NEBTYPE_ADAPTIVESERVICE_UPDATE, NEBFLAG_NONE, NEBATTR_NONE, temp_service, cmd, attr, temp_service->modified_attributes, NULL);
 #endif
 
+			/* a shorter interval may make the last result go stale sooner */
+			update_service_freshness_deadline(temp_service);
+
 			/* update the status log with the service info */
 			update_service_status(temp_service, FALSE);
 
@@ -3252,6 +3205,9 @@ int cmd_change_object_int_var(int cmd, char *args) {
 			broker_adaptive_host_data(NEBTYPE_ADAPTIVEHOST_UPDATE, NEBFLAG_NONE, NEBATTR_NONE, temp_host, cmd, attr, temp_host->modified_attributes, NULL);
 #endif
 
+			/* a shorter interval may make the last result go stale sooner */
+			update_host_freshness_deadline(temp_host);
+
 			/* update the status log with the host info */
 			update_host_status(temp_host, FALSE);
 			break;
@@ -3288,6 +3244,9 @@ int cmd_change_object_int_var(int cmd, char *args) {
 			break;
 		}
 
+	/* the object changed, so its cached environment macros are stale */
+	invalidate_macro_environment_cache();
+
 	return OK;
 	}
 
@@ -3637,6 +3596,9 @@ int cmd_change_object_char_var(int cmd, char *args) {
 			break;
 		}
 
+	/* the object changed, so its cached environment macros are stale */
+	invalidate_macro_environment_cache();
+
 	return OK;
 	}
 
@@ -3766,6 +3728,8 @@ int cmd_change_object_custom_var(int cmd, char *args) {
 			break;
 		}
 
+	invalidate_macro_environment_cache();
+
 	return OK;
 	}
 
@@ -3821,6 +3785,9 @@ void disable_service_checks(service *svc) {
 	svc->checks_enabled = FALSE;
 	svc->should_be_scheduled = FALSE;
 
+	/* the grace period after a restart only applies to actively checked services */
+	update_service_freshness_deadline(svc);
+
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker */
 	broker_adaptive_service_data(NEBTYPE_ADAPTIVESERVICE_UPDATE, NEBFLAG_NONE, NEBATTR_NONE, svc, CMD_NONE, attr, svc->modified_attributes, NULL);
@@ -4848,6 +4815,9 @@ void disable_host_checks(host *hst) {
 	hst->checks_enabled = FALSE;
 	hst->should_be_scheduled = FALSE;
 
+	/* the grace period after a restart only applies to actively checked hosts */
+	update_host_freshness_deadline(hst);
+
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker */
 	broker_adaptive_host_data(NEBTYPE_ADAPTIVEHOST_UPDATE, NEBFLAG_NONE, NEBATTR_NONE, hst, CMD_NONE, attr, hst->modified_attributes, NULL);
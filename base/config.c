@@ -36,7 +36,7 @@
  * if we're unsuccessful, the buffer pointed to by 'name' is modified
  * to have only the real command name (everything up until the first '!')
  */
-static command *find_bang_command(char *name)
+command *find_bang_command(char *name)
 {
 	char *bang;
 	command *cmd;
@@ -189,6 +189,14 @@ int read_main_config_file(char *main_config_file) {
 			error = set_loadctl_options(value, strlen(value)) != OK;
 		else if(!strcmp(variable, "check_workers"))
 			num_check_workers = atoi(value);
+		else if(!strcmp(variable, "config_parser_threads")) {
+			config_parser_threads = atoi(value);
+			if(config_parser_threads < 0) {
+				asprintf(&error_message, "Illegal value for config_parser_threads");
+				error = TRUE;
+				break;
+				}
+			}
 		else if(!strcmp(variable, "query_socket")) {
 			my_free(qh_socket_path);
 			qh_socket_path = nspath_absolute(value, config_file_dir);
@@ -454,6 +462,17 @@ int read_main_config_file(char *main_config_file) {
 				}
 			}
 
+		else if(!strcmp(variable, "use_binary_retention_file")) {
+
+			if(strlen(value) != 1 || value[0] < '0' || value[0] > '1') {
+				asprintf(&error_message, "Illegal value for use_binary_retention_file");
+				error = TRUE;
+				break;
+				}
+
+			use_binary_retention_file = (atoi(value) > 0) ? TRUE : FALSE;
+			}
+
 		else if(!strcmp(variable, "use_retained_program_state")) {
 
 			if(strlen(value) != 1 || value[0] < '0' || value[0] > '1') {
@@ -941,6 +960,16 @@ int read_main_config_file(char *main_config_file) {
 				}
 			}
 
+		else if(!strcmp(variable, "status_snapshot_compaction_interval")) {
+
+			status_snapshot_compaction_interval = atoi(value);
+			if(status_snapshot_compaction_interval < 1) {
+				asprintf(&error_message, "Illegal value for status_snapshot_compaction_interval");
+				error = TRUE;
+				break;
+				}
+			}
+
 		else if(!strcmp(variable, "time_change_threshold")) {
 
 			time_change_threshold = atoi(value);
@@ -1076,6 +1105,63 @@ int read_main_config_file(char *main_config_file) {
 			use_large_installation_tweaks = (atoi(value) > 0) ? TRUE : FALSE;
 			}
 
+		else if(!strcmp(variable, "use_timing_wheel"))
+			use_timing_wheel = (atoi(value) > 0) ? TRUE : FALSE;
+
+		else if(!strcmp(variable, "worker_dispatch_policy")) {
+			if(!strcmp(value, "round-robin"))
+				worker_dispatch_policy = WPDISPATCH_ROUND_ROBIN;
+			else if(!strcmp(value, "least-jobs"))
+				worker_dispatch_policy = WPDISPATCH_LEAST_JOBS;
+			else if(!strcmp(value, "power-of-two"))
+				worker_dispatch_policy = WPDISPATCH_POWER_OF_TWO;
+			else if(!strcmp(value, "ewma-latency"))
+				worker_dispatch_policy = WPDISPATCH_EWMA_LATENCY;
+			else {
+				asprintf(&error_message, "Illegal value for worker_dispatch_policy");
+				error = TRUE;
+				break;
+				}
+			}
+
+		else if(!strcmp(variable, "use_binary_worker_framing"))
+			use_binary_worker_framing = (atoi(value) > 0) ? TRUE : FALSE;
+
+		else if(!strcmp(variable, "use_io_uring"))
+			use_io_uring = (atoi(value) > 0) ? TRUE : FALSE;
+
+		else if(!strcmp(variable, "use_incremental_reload"))
+			use_incremental_reload = (atoi(value) > 0) ? TRUE : FALSE;
+
+		else if(!strcmp(variable, "use_async_log_writer"))
+			use_async_log_writer = (atoi(value) > 0) ? TRUE : FALSE;
+
+		else if(!strcmp(variable, "async_log_buffer_size"))
+			async_log_buffer_size = strtoul(value, NULL, 0);
+
+		else if(!strcmp(variable, "worker_spawn_method")) {
+			if(!strcmp(value, "fork"))
+				worker_spawn_method = RUNCMD_SPAWN_FORK;
+			else if(!strcmp(value, "posix_spawn"))
+				worker_spawn_method = RUNCMD_SPAWN_POSIX;
+			else {
+				asprintf(&error_message, "Illegal value for worker_spawn_method");
+				error = TRUE;
+				break;
+				}
+			}
+
+		else if(!strcmp(variable, "max_event_batch_size")) {
+
+			max_event_batch_size = atoi(value);
+
+			if(max_event_batch_size < 1) {
+				asprintf(&error_message, "Illegal value for max_event_batch_size");
+				error = TRUE;
+				break;
+				}
+			}
+
 		else if(!strcmp(variable, "enable_environment_macros"))
 			enable_environment_macros = (atoi(value) > 0) ? TRUE : FALSE;
 
@@ -1108,6 +1194,10 @@ int read_main_config_file(char *main_config_file) {
 		/* BEGIN status data variables */
 		else if(!strcmp(variable, "status_file"))
 			status_file = nspath_absolute(value, config_file_dir);
+		else if(!strcmp(variable, "status_snapshot_file"))
+			status_snapshot_file = nspath_absolute(value, config_file_dir);
+		else if(!strcmp(variable, "status_shm_file"))
+			status_shm_file = nspath_absolute(value, config_file_dir);
 		else if(strstr(input, "state_retention_file=") == input)
 			retention_file = nspath_absolute(value, config_file_dir);
 		/* END status data variables */
@@ -1150,6 +1240,10 @@ int read_main_config_file(char *main_config_file) {
 			host_perfdata_file_processing_interval = strtoul(value, NULL, 0);
 		else if(!strcmp(variable, "service_perfdata_file_processing_interval"))
 			service_perfdata_file_processing_interval = strtoul(value, NULL, 0);
+		else if(!strcmp(variable, "perfdata_file_buffer_size"))
+			perfdata_file_buffer_size = strtoul(value, NULL, 0);
+		else if(!strcmp(variable, "perfdata_file_flush_interval"))
+			perfdata_file_flush_interval = strtoul(value, NULL, 0);
 		else if(!strcmp(variable, "host_perfdata_file_processing_command"))
 			host_perfdata_file_processing_command = (char *)strdup(value);
 		else if(!strcmp(variable, "service_perfdata_file_processing_command"))
@@ -1168,6 +1262,10 @@ int read_main_config_file(char *main_config_file) {
 			my_free(mac->x[MACRO_OBJECTCACHEFILE]);
 			mac->x[MACRO_OBJECTCACHEFILE] = strdup(object_cache_file);
 		}
+		else if(!strcmp(variable, "binary_object_cache_file")) {
+			my_free(binary_object_cache_file);
+			binary_object_cache_file = nspath_absolute(value, config_file_dir);
+			}
 		else if(strstr(input, "precached_object_file=") == input) {
 			my_free(object_precache_file);
 			object_precache_file = nspath_absolute(value, config_file_dir);
@@ -750,17 +750,36 @@ void display_scheduling_info(void) {
 
 /*
  * Create the event queue
- * We oversize it somewhat to avoid unnecessary growing
+ * We oversize the heap somewhat to avoid unnecessary growing. The
+ * timing wheel ticks in seconds, so it gets sized by how far ahead
+ * checks are scheduled instead
  */
 int init_event_queue(void)
 {
-	unsigned int size;
-
-	size = num_objects.hosts + num_objects.services;
-	if(size < 4096)
-		size = 4096;
+	unsigned int i, size;
+	double interval = 0;
+
+	if(use_timing_wheel == FALSE) {
+		size = num_objects.hosts + num_objects.services;
+		if(size < 4096)
+			size = 4096;
+		nagios_squeue = squeue_create(size);
+		return 0;
+		}
 
-	nagios_squeue = squeue_create(size);
+	for(i = 0; i < num_objects.hosts; i++) {
+		if(host_ary[i]->check_interval > interval)
+			interval = host_ary[i]->check_interval;
+		if(host_ary[i]->retry_interval > interval)
+			interval = host_ary[i]->retry_interval;
+		}
+	for(i = 0; i < num_objects.services; i++) {
+		if(service_ary[i]->check_interval > interval)
+			interval = service_ary[i]->check_interval;
+		if(service_ary[i]->retry_interval > interval)
+			interval = service_ary[i]->retry_interval;
+		}
+	nagios_squeue = squeue_create_backend((unsigned int)(interval * interval_length), SQUEUE_BACKEND_WHEEL);
 	return 0;
 }
 
@@ -1005,13 +1024,36 @@ static int should_run_event(timed_event *temp_event)
 	return run_event;
 }
 
+/*
+ * Polls for input, but serves worker results before anything else
+ * that's ready, so a busy query handler or NERD subscriber can't
+ * hold up check results. Sockets registered with IOBROKER_PRIORITY
+ * get handled in the first pass and everything else in the second.
+ */
+static int poll_for_input(int timeout) {
+	static iobroker_event ready[256];
+	int i, nfds, pass;
+
+	nfds = iobroker_poll_batch(nagios_iobs, timeout, ready, sizeof(ready) / sizeof(ready[0]));
+	for(pass = 0; pass < 2; pass++) {
+		for(i = 0; i < nfds; i++) {
+			if(!(ready[i].flags & IOBROKER_PRIORITY) == !pass)
+				continue;
+			iobroker_dispatch(nagios_iobs, &ready[i]);
+			}
+		}
+
+	return nfds;
+	}
+
 /* this is the main event handler loop */
 int event_execution_loop(void) {
-	timed_event *temp_event, *last_event = NULL;
+	timed_event *temp_event, *last_event = NULL, *batch_event;
 	time_t last_time = 0L;
 	time_t current_time = 0L;
 	time_t last_status_update = 0L;
 	int poll_time_ms;
+	int batched;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "event_execution_loop() start\n");
 
@@ -1078,7 +1120,7 @@ int event_execution_loop(void) {
 		log_debug_info(DEBUGL_SCHEDULING | DEBUGL_IPC, 1, "## Polling %dms; sockets=%d; events=%u; iobs=%p\n",
 		               poll_time_ms, iobroker_get_num_fds(nagios_iobs),
 		               squeue_size(nagios_squeue), nagios_iobs);
-		inputs = iobroker_poll(nagios_iobs, poll_time_ms);
+		inputs = poll_for_input(poll_time_ms);
 		if (inputs < 0 && errno != EINTR) {
 			logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Polling for input on %p failed: %s", nagios_iobs, iobroker_strerror(inputs));
 			break;
@@ -1102,27 +1144,48 @@ int event_execution_loop(void) {
 		if (tv_delta_msec(&now, event_runtime) > 5)
 			continue;
 
-		/* move on if we shouldn't run this event */
-		if(should_run_event(temp_event) == FALSE)
-			continue;
-
-		/* handle the event */
-		handle_timed_event(temp_event);
-
 		/*
-		 * we must remove the entry we've peeked, or
-		 * we'll keep getting the same one over and over.
-		 * This also maintains sync with broker modules.
+		 * Run the event we peeked. With max_event_batch_size > 1 we
+		 * then keep running whatever else is due within the same
+		 * allowance, without polling for input in between, until
+		 * the batch is full.
 		 */
-		remove_event(nagios_squeue, temp_event);
+		for (batched = 1;; batched++) {
+
+			/* handle the event unless we shouldn't run it */
+			if(should_run_event(temp_event) == TRUE) {
+				handle_timed_event(temp_event);
+
+				/*
+				 * we must remove the entry we've peeked, or
+				 * we'll keep getting the same one over and over.
+				 * This also maintains sync with broker modules.
+				 */
+				remove_event(nagios_squeue, temp_event);
+
+				/* reschedule the event if necessary */
+				if(temp_event->recurring == TRUE)
+					reschedule_event(nagios_squeue, temp_event);
+
+				/* else free memory associated with the event */
+				else
+					my_free(temp_event);
+				}
 
-		/* reschedule the event if necessary */
-		if(temp_event->recurring == TRUE)
-			reschedule_event(nagios_squeue, temp_event);
+			if(batched >= max_event_batch_size || sigshutdown == TRUE || sigrestart == TRUE)
+				break;
 
-		/* else free memory associated with the event */
-		else
-			my_free(temp_event);
+			/* an event we couldn't run stays first in line, so stop there */
+			batch_event = temp_event;
+			current_event = temp_event = (timed_event *)squeue_peek(nagios_squeue);
+			if(!temp_event || temp_event == batch_event)
+				break;
+			if(tv_delta_msec(&now, squeue_event_runtime(temp_event->sq_event)) > 5)
+				break;
+			}
+
+		if(batched > 1)
+			log_debug_info(DEBUGL_EVENTS, 1, "Handled a batch of %d events\n", batched);
 	}
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "event_execution_loop() end\n");
@@ -1223,11 +1286,8 @@ int handle_timed_event(timed_event *event) {
 
 			log_debug_info(DEBUGL_EVENTS, 0, "** Orphaned Host and Service Check Event. Latency: %.3fs\n", latency);
 
-			/* check for orphaned hosts and services */
-			if(check_orphaned_hosts == TRUE)
-				check_for_orphaned_hosts();
-			if(check_orphaned_services == TRUE)
-				check_for_orphaned_services();
+			/* check for orphaned hosts, services and other worker jobs */
+			wproc_reap_orphaned_jobs(time(NULL));
 			break;
 
 		case EVENT_RETENTION_SAVE:
@@ -1334,25 +1394,68 @@ int handle_timed_event(timed_event *event) {
 
 
 
-/* The squeue internal event type, declared again here so we can manipulate the
- * scheduling queue without a malloc/free for each add/remove.
- * @todo: Refactor this to not depend so heavily on the event queue
- * implementation, doing so efficiently may require a different scheduling queue
- * data structure. */
-struct squeue_event {
-	unsigned int pos;
-	pqueue_pri_t pri;
-	struct timeval when;
-	void *data;
+/* collects the check events adjust_check_scheduling() may move */
+struct sched_window {
+	time_t first_window_time;
+	time_t last_window_time;
+	unsigned int total_checks;
+	squeue_event **events;
 	};
 
+static int collect_reschedulable_event(squeue_event *sq_event, void *arg) {
+	struct sched_window *win = (struct sched_window *)arg;
+	timed_event *temp_event = squeue_event_data(sq_event);
+	service *temp_service = NULL;
+	host *temp_host = NULL;
+
+	/* We need a timed_event and event data. */
+	if (!temp_event || !temp_event->event_data)
+		return 0;
+
+	/* Skip events outside our window. */
+	if (temp_event->run_time < win->first_window_time || temp_event->run_time > win->last_window_time)
+		return 0;
+
+	switch (temp_event->event_type) {
+		case EVENT_HOST_CHECK:
+			temp_host = temp_event->event_data;
+			/* Leave forced checks. */
+			if (temp_host->check_options & CHECK_OPTION_FORCE_EXECUTION)
+				return 0;
+			break;
+
+		case EVENT_SERVICE_CHECK:
+			temp_service = temp_event->event_data;
+			/* Leave forced checks. */
+			if (temp_service->check_options & CHECK_OPTION_FORCE_EXECUTION)
+				return 0;
+			break;
+
+		default:
+			return 0;
+		}
+
+	win->events[win->total_checks++] = sq_event;
+	return 0;
+	}
+
+static int compare_squeue_event_runtime(const void *a, const void *b) {
+	const struct timeval *tv_a = squeue_event_runtime(*(squeue_event **)a);
+	const struct timeval *tv_b = squeue_event_runtime(*(squeue_event **)b);
+
+	if (tv_a->tv_sec != tv_b->tv_sec)
+		return tv_a->tv_sec < tv_b->tv_sec ? -1 : 1;
+	if (tv_a->tv_usec != tv_b->tv_usec)
+		return tv_a->tv_usec < tv_b->tv_usec ? -1 : 1;
+	return 0;
+	}
+
 /*
  * Adjusts scheduling of active, non-forced host and service checks.
  */
 void adjust_check_scheduling(void) {
-	pqueue_t *temp_pqueue; /* squeue_t is a typedef of pqueue_t. */
-	struct squeue_event *sq_event;
-	struct squeue_event **events_to_reschedule;
+	struct sched_window win;
+	squeue_event *sq_event;
 
 	timed_event *temp_event;
 	service *temp_service = NULL;
@@ -1362,9 +1465,6 @@ void adjust_check_scheduling(void) {
 	double inter_check_delay = 0.0;
 	double new_run_time_offset = 0.0;
 
-	time_t first_window_time;
-	time_t last_window_time;
-
 	struct timeval last_check_tv = { (time_t)0, (suseconds_t)0 };
 
 	int adjust_scheduling = FALSE;
@@ -1376,109 +1476,51 @@ void adjust_check_scheduling(void) {
 
 
 	/* Determine our adjustment window. */
-	first_window_time = time(NULL);
-	last_window_time = first_window_time + auto_rescheduling_window;
+	win.first_window_time = time(NULL);
+	win.last_window_time = win.first_window_time + auto_rescheduling_window;
+	win.total_checks = 0;
 
 	/* Nothing to do if the first event is after the reschedule window. */
-	sq_event = pqueue_peek(nagios_squeue);
-	temp_event = sq_event ? sq_event->data : NULL;
-	if (!temp_event || temp_event->run_time > last_window_time)
+	temp_event = squeue_peek(nagios_squeue);
+	if (!temp_event || temp_event->run_time > win.last_window_time)
 		return;
 
 
-	/* Get a sorted array of all check events to reschedule. First we need a
-	 * duplicate of nagios_squeue so we can get the events in-order without
-	 * having to remove them from the original queue. We will use
-	 * pqueue_change_priority() to move the check events in the original queue.
-	 * @note: This is horribly dependent on implementation details of squeue
-	 * and pqueue, but we don't have much choice to avoid a free/malloc of each
-	 * squeue_event from the head to last_window_time, or avoid paying the full
-	 * O(n lg n) penalty twice to drain and rebuild the queue. */
-	temp_pqueue = malloc(sizeof(*temp_pqueue));
-	if (!temp_pqueue) {
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Failed to allocate queue needed to adjust check scheduling.\n");
-		return;
-		}
-	*temp_pqueue = *nagios_squeue;
-
-	/* We need a separate copy of the underlying queue array. */
-	temp_pqueue->d = malloc(temp_pqueue->size * sizeof(void*));
-	if (!temp_pqueue->d) {
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Failed to allocate queue data needed to adjust check scheduling.\n");
-		free(temp_pqueue);
-		return;
-		}
-	memcpy(temp_pqueue->d, nagios_squeue->d, temp_pqueue->size * sizeof(void*));
-	temp_pqueue->avail = temp_pqueue->size;
-
-	/* Now allocate space for a sorted array of check events. We shouldn't need
-	 * space for all events, but we can't really calculate how many we'll need
-	 * without looking at all events. */
-	events_to_reschedule = malloc((temp_pqueue->size - 1) * sizeof(void*));
-	if (!events_to_reschedule) {
+	/* Get a sorted array of all check events to reschedule. Walking the
+	 * queue is O(n) regardless of the squeue backend, and sorting only
+	 * the events in the window is cheaper than draining a copy of the
+	 * queue. We use squeue_change_priority_tv() to move the check events
+	 * in the queue afterwards. We shouldn't need space for all events,
+	 * but we can't really calculate how many we'll need without looking
+	 * at all events. */
+	win.events = malloc((squeue_size(nagios_squeue) + 1) * sizeof(void*));
+	if (!win.events) {
 		logit(NSLOG_RUNTIME_ERROR, TRUE, "Failed to allocate memory needed to adjust check scheduling.\n");
-		pqueue_free(temp_pqueue); /* pqueue_free() to keep the events. */
 		return;
 		}
+	squeue_walk(nagios_squeue, collect_reschedulable_event, &win);
+	qsort(win.events, win.total_checks, sizeof(void*), compare_squeue_event_runtime);
+	total_checks = win.total_checks;
 
-	/* Now we get the events to reschedule and collect some scheduling info. */
-	while ((sq_event = pqueue_pop(temp_pqueue))) {
-
-		/* We need a timed_event and event data. */
-		temp_event = sq_event->data;
-		if (!temp_event || !temp_event->event_data)
-			continue;
-
-		/* Skip events before our current window. */
-		if (temp_event->run_time < first_window_time)
-			continue;
-		/* We're done once past the end of the window. */
-		if (temp_event->run_time > last_window_time)
-			break;
-
-		switch (temp_event->event_type) {
-			case EVENT_HOST_CHECK:
-				temp_host = temp_event->event_data;
-				/* Leave forced checks. */
-				if (temp_host->check_options & CHECK_OPTION_FORCE_EXECUTION)
-					continue;
-				break;
-
-			case EVENT_SERVICE_CHECK:
-				temp_service = temp_event->event_data;
-				/* Leave forced checks. */
-				if (temp_service->check_options & CHECK_OPTION_FORCE_EXECUTION)
-					continue;
-				break;
-
-			default:
-				continue;
-			}
+	/* Now collect some scheduling info. */
+	for (i = 0; i < total_checks; ++i) {
+		const struct timeval *when = squeue_event_runtime(win.events[i]);
 
 		/* Reschedule if the last check overlap into this one. */
-		if (last_check_tv.tv_sec > 0 && tv_delta_msec(&last_check_tv, &sq_event->when) < INTER_CHECK_RESCHEDULE_THRESHOLD * 1000) {
-/*			log_debug_info(DEBUGL_SCHEDULING, 2, "Rescheduling event %d: %.3fs delay.\n", total_checks, tv_delta_f(&last_check_tv, &sq_event->when));
+		if (last_check_tv.tv_sec > 0 && tv_delta_msec(&last_check_tv, when) < INTER_CHECK_RESCHEDULE_THRESHOLD * 1000) {
+/*			log_debug_info(DEBUGL_SCHEDULING, 2, "Rescheduling event %d: %.3fs delay.\n", i, tv_delta_f(&last_check_tv, when));
 */			adjust_scheduling = TRUE;
+			break;
 			}
 
-		last_check_tv = sq_event->when;
-		events_to_reschedule[total_checks++] = sq_event;
-		}
-
-	/* Removing squeue_events from temp_pqueue invalidates the positions of
-	 * those events in nagios_squeue, so we need to fix that up before we
-	 * return or change their priorities. Start at i=1 since i=0 is unused. */
-	for (i = 1; i < (int)nagios_squeue->size; ++i) {
-		if ((sq_event = nagios_squeue->d[i]))
-			sq_event->pos = i;
+		last_check_tv = *when;
 		}
 
 	/* No checks to reschedule, nothing to do... */
 	if (total_checks < 2 || !adjust_scheduling) {
 		log_debug_info(DEBUGL_SCHEDULING, 0, "No events need to be rescheduled (%d checks in %ds window).\n", total_checks, auto_rescheduling_window);
 
-		pqueue_free(temp_pqueue);
-		free(events_to_reschedule);
+		free(win.events);
 		return;
 		}
 
@@ -1493,13 +1535,13 @@ void adjust_check_scheduling(void) {
 	for (i = 0; i < total_checks; ++i, new_run_time_offset += inter_check_delay) {
 		struct timeval new_run_time;
 
-		/* All events_to_reschedule are valid squeue_events with data pointers
+		/* All win.events are valid squeue_events with data pointers
 		 * to timed_events for non-forced host or service checks. */
-		sq_event = events_to_reschedule[i];
-		temp_event = sq_event->data;
+		sq_event = win.events[i];
+		temp_event = squeue_event_data(sq_event);
 
 		/* Calculate and apply a new queue 'when' time. */
-		new_run_time.tv_sec = first_window_time + (time_t)floor(new_run_time_offset);
+		new_run_time.tv_sec = win.first_window_time + (time_t)floor(new_run_time_offset);
 		new_run_time.tv_usec = (suseconds_t)(fmod(new_run_time_offset, 1.0) * 1E6);
 
 /*		log_debug_info(DEBUGL_SCHEDULING, 2, "Check %d: offset %.3fs, new run time %lu.%06ld.\n", i, new_run_time_offset, (unsigned long)new_run_time.tv_sec, (long)new_run_time.tv_usec);
@@ -1533,8 +1575,7 @@ void adjust_check_scheduling(void) {
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "adjust_check_scheduling() end\n");
 
-	pqueue_free(temp_pqueue);
-	free(events_to_reschedule);
+	free(win.events);
 	return;
 	}
 
@@ -1547,7 +1588,7 @@ static void adjust_squeue_for_time_change(squeue_t **q, int delta) {
 	 * but it should be pretty rare that we have to adjust times
 	 * so we go with the well-tested codepath.
 	 */
-	sq_new = squeue_create(squeue_size(*q));
+	sq_new = squeue_create_backend(squeue_size(*q), squeue_backend(*q));
 	while ((event = squeue_pop(*q))) {
 		if (event->compensate_for_time_change == TRUE) {
 			if (event->timing_func) {
@@ -27,11 +27,50 @@
 #include "../include/nagios.h"
 #include "../include/broker.h"
 #include <fcntl.h>
+#include <pthread.h>
+#include <sys/uio.h>
 
 
 static FILE *debug_file_fp;
 static FILE *log_fp;
 
+/*
+ * The asynchronous log writer. The main thread is the only producer
+ * and the writer thread the only consumer, so the ring itself needs
+ * no locks; head and tail are free-running byte counters. Each entry
+ * is a header followed by the formatted "[time] message\n" line and
+ * a nul byte, padded to the header size. Entries never wrap; a
+ * padding entry fills the end of the ring instead.
+ * fd_lock serializes use of log_fp between the writer thread and
+ * rotation, and ring_lock only exists for sleeping and waking up.
+ */
+#define LW_LOG     (1 << 0) /* entry goes to the main log */
+#define LW_SYSLOG  (1 << 1) /* entry goes to syslog */
+#define LW_PAD     (1 << 2) /* skip to the start of the ring */
+#define LW_MAX_IOV 64
+
+struct lw_entry {
+	unsigned int size;     /* header plus padded text */
+	unsigned int text_len; /* length of the log line */
+	unsigned int msg_off;  /* where the message starts, for syslog */
+	unsigned int flags;
+};
+
+static struct {
+	char *buf;
+	unsigned long size, mask;
+	unsigned long head, tail;
+	int running, stop, idle, waiters, fork_locked;
+	pthread_t tid;
+	pthread_mutex_t fd_lock, ring_lock;
+	pthread_cond_t wake, drained;
+} lw = {
+	.fd_lock = PTHREAD_MUTEX_INITIALIZER,
+	.ring_lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.drained = PTHREAD_COND_INITIALIZER,
+};
+
 /******************************************************************/
 /************************ LOGGING FUNCTIONS ***********************/
 /******************************************************************/
@@ -166,14 +205,284 @@ int fix_log_file_owner(uid_t uid, gid_t gid)
 	return r1 < r2 ? r1 : r2;
 }
 
+/******************************************************************/
+/********************* ASYNCHRONOUS LOG WRITER ********************/
+/******************************************************************/
+
+/* wait until the writer thread has consumed everything up to pos */
+static void lw_wait_for(unsigned long pos)
+{
+	if((long)(__atomic_load_n(&lw.head, __ATOMIC_ACQUIRE) - pos) >= 0)
+		return;
+
+	pthread_mutex_lock(&lw.ring_lock);
+	__atomic_add_fetch(&lw.waiters, 1, __ATOMIC_SEQ_CST);
+	pthread_cond_signal(&lw.wake);
+	while((long)(__atomic_load_n(&lw.head, __ATOMIC_SEQ_CST) - pos) < 0)
+		pthread_cond_wait(&lw.drained, &lw.ring_lock);
+	__atomic_sub_fetch(&lw.waiters, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&lw.ring_lock);
+}
+
+/*
+ * wait until everything queued so far has been written. The ring
+ * is bounded, so this never waits for more than async_log_buffer_size
+ * bytes to hit the disk
+ */
+static void lw_flush(void)
+{
+	if(lw.running)
+		lw_wait_for(lw.tail);
+}
+
+/*
+ * queue a line for the writer thread. Returns -1 if it's too big
+ * for the ring, in which case the caller must flush and write it
+ * itself
+ */
+static int lw_enqueue(const char *buffer, time_t log_time, unsigned int flags)
+{
+	struct lw_entry *e;
+	char stamp[32], *text;
+	unsigned long off, pad = 0, need, tail = lw.tail;
+	size_t stamp_len, msg_len;
+
+	stamp_len = snprintf(stamp, sizeof(stamp), "[%llu] ", (unsigned long long)log_time);
+	msg_len = strlen(buffer);
+	need = sizeof(*e) + stamp_len + msg_len + 2;
+	need = (need + sizeof(*e) - 1) & ~(sizeof(*e) - 1);
+	if(need > lw.size / 2)
+		return -1;
+
+	off = tail & lw.mask;
+	if(lw.size - off < need)
+		pad = lw.size - off;
+
+	/* block until there's room, so nothing is ever dropped or reordered */
+	lw_wait_for(tail + pad + need - lw.size);
+
+	if(pad) {
+		e = (struct lw_entry *)(lw.buf + off);
+		e->size = pad;
+		e->text_len = e->msg_off = 0;
+		e->flags = LW_PAD;
+		off = 0;
+		}
+
+	e = (struct lw_entry *)(lw.buf + off);
+	e->size = need;
+	e->msg_off = stamp_len;
+	e->text_len = stamp_len + msg_len + 1;
+	e->flags = flags;
+	text = (char *)(e + 1);
+	memcpy(text, stamp, stamp_len);
+	memcpy(text + stamp_len, buffer, msg_len);
+	text[stamp_len + msg_len] = '\n';
+	text[stamp_len + msg_len + 1] = 0;
+
+	/* publish, then make sure the writer isn't sleeping through it */
+	__atomic_store_n(&lw.tail, tail + pad + need, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&lw.idle, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&lw.ring_lock);
+		pthread_cond_signal(&lw.wake);
+		pthread_mutex_unlock(&lw.ring_lock);
+		}
+
+	return 0;
+	}
+
+static void lw_writev(struct iovec *iov, int n)
+{
+	ssize_t wrote;
+
+	pthread_mutex_lock(&lw.fd_lock);
+	while(n > 0 && log_fp) {
+		wrote = writev(fileno(log_fp), iov, n);
+		if(wrote < 0) {
+			if(errno == EINTR)
+				continue;
+			break;
+			}
+		for(; n > 0 && (size_t)wrote >= iov->iov_len; iov++, n--)
+			wrote -= iov->iov_len;
+		if(n > 0) {
+			iov->iov_base = (char *)iov->iov_base + wrote;
+			iov->iov_len -= wrote;
+			}
+		}
+	pthread_mutex_unlock(&lw.fd_lock);
+	}
+
+static void *lw_thread(void *discard)
+{
+	struct iovec iov[LW_MAX_IOV];
+	struct lw_entry *e;
+	unsigned long head = lw.head, tail;
+	char *text;
+	int n;
+
+	for(;;) {
+		tail = __atomic_load_n(&lw.tail, __ATOMIC_ACQUIRE);
+		if(head == tail) {
+			if(__atomic_load_n(&lw.stop, __ATOMIC_ACQUIRE))
+				break;
+			pthread_mutex_lock(&lw.ring_lock);
+			__atomic_store_n(&lw.idle, 1, __ATOMIC_SEQ_CST);
+			while(__atomic_load_n(&lw.tail, __ATOMIC_SEQ_CST) == head && !lw.stop)
+				pthread_cond_wait(&lw.wake, &lw.ring_lock);
+			__atomic_store_n(&lw.idle, 0, __ATOMIC_SEQ_CST);
+			pthread_mutex_unlock(&lw.ring_lock);
+			continue;
+			}
+
+		/* take as many lines as we can in one go */
+		for(n = 0; head != tail && n < LW_MAX_IOV; head += e->size) {
+			e = (struct lw_entry *)(lw.buf + (head & lw.mask));
+			text = (char *)(e + 1);
+			if(e->flags & LW_SYSLOG)
+				syslog(LOG_USER | LOG_INFO, "%.*s", (int)(e->text_len - e->msg_off - 1), text + e->msg_off);
+			if(e->flags & LW_LOG) {
+				iov[n].iov_base = text;
+				iov[n++].iov_len = e->text_len;
+				}
+			}
+		if(n)
+			lw_writev(iov, n);
+
+		__atomic_store_n(&lw.head, head, __ATOMIC_SEQ_CST);
+		if(__atomic_load_n(&lw.waiters, __ATOMIC_SEQ_CST)) {
+			pthread_mutex_lock(&lw.ring_lock);
+			pthread_cond_broadcast(&lw.drained);
+			pthread_mutex_unlock(&lw.ring_lock);
+			}
+		}
+
+	return NULL;
+	}
+
+/*
+ * the writer thread doesn't survive fork(), so make sure the child
+ * doesn't inherit a held lock and goes back to writing directly
+ */
+static void lw_prefork(void)
+{
+	if(!lw.running)
+		return;
+	pthread_mutex_lock(&lw.fd_lock);
+	pthread_mutex_lock(&lw.ring_lock);
+	lw.fork_locked = TRUE;
+	}
+
+static void lw_postfork_parent(void)
+{
+	if(!lw.fork_locked)
+		return;
+	lw.fork_locked = FALSE;
+	pthread_mutex_unlock(&lw.ring_lock);
+	pthread_mutex_unlock(&lw.fd_lock);
+	}
+
+static void lw_postfork_child(void)
+{
+	if(!lw.fork_locked)
+		return;
+	lw.fork_locked = FALSE;
+	pthread_mutex_unlock(&lw.ring_lock);
+	pthread_mutex_unlock(&lw.fd_lock);
+	lw.running = FALSE;
+	my_free(lw.buf);
+	}
+
+/* start the asynchronous log writer, if configured */
+int start_log_writer(void)
+{
+	static int atfork_registered = FALSE;
+	sigset_t mask, omask;
+	unsigned long size;
+	int result;
+
+	if(lw.running || use_async_log_writer == FALSE)
+		return OK;
+	if(verify_config || test_scheduling == TRUE)
+		return OK;
+
+	for(size = 65536; size < async_log_buffer_size; size <<= 1)
+		;
+	if((lw.buf = malloc(size)) == NULL) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Failed to allocate %lu byte log buffer. Logging synchronously.\n", size);
+		return ERROR;
+		}
+	lw.size = size;
+	lw.mask = size - 1;
+	lw.head = lw.tail = 0;
+	lw.stop = lw.idle = lw.waiters = 0;
+
+	if(atfork_registered == FALSE) {
+		pthread_atfork(lw_prefork, lw_postfork_parent, lw_postfork_child);
+		atfork_registered = TRUE;
+		}
+
+	/* signals are for the main thread to handle */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, &omask);
+	result = pthread_create(&lw.tid, NULL, lw_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &omask, NULL);
+	if(result) {
+		my_free(lw.buf);
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Failed to start log writer thread: %s. Logging synchronously.\n", strerror(result));
+		return ERROR;
+		}
+
+	lw.running = TRUE;
+	return OK;
+	}
+
+/* write out everything that's queued and stop the log writer */
+int stop_log_writer(void)
+{
+	if(!lw.running)
+		return OK;
+
+	pthread_mutex_lock(&lw.ring_lock);
+	__atomic_store_n(&lw.stop, 1, __ATOMIC_RELEASE);
+	pthread_cond_signal(&lw.wake);
+	pthread_mutex_unlock(&lw.ring_lock);
+	pthread_join(lw.tid, NULL);
+
+	lw.running = FALSE;
+	my_free(lw.buf);
+	return OK;
+	}
+
+/* opens the main log, keeping the writer thread off log_fp meanwhile */
+static FILE *get_log_file(void)
+{
+	FILE *fp;
+
+	if(log_fp || !lw.running)
+		return open_log_file();
+
+	pthread_mutex_lock(&lw.fd_lock);
+	fp = open_log_file();
+	pthread_mutex_unlock(&lw.fd_lock);
+	return fp;
+	}
+
 int close_log_file(void)
 {
 	if(!log_fp)
 		return 0;
 
+	/* everything logged so far belongs in this file */
+	lw_flush();
+
+	if(lw.running)
+		pthread_mutex_lock(&lw.fd_lock);
 	fflush(log_fp);
 	fclose(log_fp);
 	log_fp = NULL;
+	if(lw.running)
+		pthread_mutex_unlock(&lw.fd_lock);
 	return 0;
 }
 
@@ -193,7 +502,7 @@ int write_to_log(char *buffer, unsigned long data_type, time_t *timestamp) {
 	if(!(data_type & logging_options))
 		return OK;
 
-	fp = open_log_file();
+	fp = get_log_file();
 	if (fp == NULL)
 		return ERROR;
 	/* what timestamp should we use? */
@@ -206,8 +515,15 @@ int write_to_log(char *buffer, unsigned long data_type, time_t *timestamp) {
 	strip(buffer);
 
 	/* write the buffer to the log file */
-	fprintf(fp, "[%llu] %s\n", (unsigned long long)log_time, buffer);
-	fflush(fp);
+	if(!lw.running || lw_enqueue(buffer, log_time, LW_LOG) < 0) {
+		lw_flush();
+		if(lw.running)
+			pthread_mutex_lock(&lw.fd_lock);
+		fprintf(fp, "[%llu] %s\n", (unsigned long long)log_time, buffer);
+		fflush(fp);
+		if(lw.running)
+			pthread_mutex_unlock(&lw.fd_lock);
+		}
 
 #ifdef USE_EVENT_BROKER
 	/* send data to the event broker */
@@ -237,7 +553,10 @@ int write_to_syslog(char *buffer, unsigned long data_type) {
 		return OK;
 
 	/* write the buffer to the syslog facility */
-	syslog(LOG_USER | LOG_INFO, "%s", buffer);
+	if(!lw.running || lw_enqueue(buffer, 0, LW_SYSLOG) < 0) {
+		lw_flush();
+		syslog(LOG_USER | LOG_INFO, "%s", buffer);
+		}
 
 	return OK;
 	}
@@ -420,8 +739,7 @@ int rotate_log_file(time_t rotation_time) {
 
 	/* rotate the log file */
 	rename_result = my_rename(log_file, log_archive);
-	log_fp = open_log_file();
-	if (log_fp == NULL)
+	if (get_log_file() == NULL)
 		return ERROR;
 
 	if(rename_result) {
@@ -147,7 +147,8 @@ static int test_path_access(const char *program, int mode)
 
 static int nagios_core_worker(const char *path)
 {
-	int sd, ret;
+	int sd, ret, i;
+	unsigned int len;
 	char response[128];
 
 	is_worker = 1;
@@ -161,23 +162,44 @@ static int nagios_core_worker(const char *path)
 		return 1;
 	}
 
-	ret = nsock_printf_nul(sd, "@wproc register name=Core Worker %ld;pid=%ld", (long)getpid(), (long)getpid());
+	ret = nsock_printf_nul(sd, "@wproc register name=Core Worker %ld;pid=%ld;framing=binary;argv=yes%s",
+	                       (long)getpid(), (long)getpid(),
+	                       runcmd_set_spawn_method(RUNCMD_SPAWN_POSIX) ? "" : ";spawn=posix_spawn");
+	runcmd_set_spawn_method(RUNCMD_SPAWN_FORK);
 	if (ret < 0) {
 		printf("Failed to register as worker.\n");
 		return 1;
 	}
 
-	ret = read(sd, response, 3);
-	if (ret != 3) {
-		printf("Failed to read response from wproc manager\n");
-		return 1;
+	/*
+	 * The response is nul-terminated and jobs may follow right
+	 * after it, so we mustn't read past the terminator here
+	 */
+	for (len = 0; len < sizeof(response) - 1; len++) {
+		ret = read(sd, response + len, 1);
+		if (ret != 1) {
+			printf("Failed to read response from wproc manager\n");
+			return 1;
+		}
+		if (!response[len])
+			break;
 	}
-	if (memcmp(response, "OK", 3)) {
-		read(sd, response + 3, sizeof(response) - 4);
-		response[sizeof(response) - 2] = 0;
+	response[len] = 0;
+	if (strncmp(response, "OK", 2) || (response[2] && response[2] != ' ')) {
 		printf("Failed to register with wproc manager: %s\n", response);
 		return 1;
 	}
+	if (response[2]) {
+		struct kvvec *opts = buf2kvvec(response + 3, len - 3, '=', ';', 0);
+		for (i = 0; opts && i < opts->kv_pairs; i++) {
+			struct key_value *kv = &opts->kv[i];
+			if (!strcmp(kv->key, "framing") && !strcmp(kv->value, "binary"))
+				worker_set_framing(WORKER_FRAMING_BINARY);
+			else if (!strcmp(kv->key, "spawn") && !strcmp(kv->value, "posix_spawn"))
+				runcmd_set_spawn_method(RUNCMD_SPAWN_POSIX);
+		}
+		kvvec_destroy(opts, 0);
+	}
 
 	enter_worker(sd, start_cmd);
 	free_worker_memory(WPROC_FORCE);
@@ -528,7 +550,7 @@ int main(int argc, char **argv) {
 			}
 
 		if(precache_objects) {
-			result = fcache_objects(object_precache_file);
+			result = fcache_binary_objects(object_precache_file);
 			timing_point("Done precaching objects\n");
 			if(result == OK) {
 				printf("Object precache file created:\n%s\n", object_precache_file);
@@ -602,6 +624,9 @@ int main(int argc, char **argv) {
 				}
 			timing_point("Main config file read\n");
 
+			/* so an incremental reload can tell if it's enough */
+			initialize_reload_data(config_file);
+
 			/* NOTE 11/06/07 EG moved to after we read config files, as user may have overridden timezone offset */
 			/* get program (re)start time and save as macro */
 			program_start = time(NULL);
@@ -646,6 +671,9 @@ int main(int argc, char **argv) {
 				exit(EXIT_FAILURE);
 				}
 
+			/* hand the main log over to its own thread, if so configured */
+			start_log_writer();
+
 			/* this must be logged after we read config data, as user may have changed location of main log file */
 			logit(NSLOG_PROCESS_INFO, TRUE, "Nagios %s starting... (PID=%d)\n", PROGRAM_VERSION, (int)getpid());
 
@@ -671,6 +699,21 @@ int main(int argc, char **argv) {
 			/* handle signals (interrupts) before we do any socket I/O */
 			setup_sighandler();
 
+			/* switch io broker backends while there's nothing registered */
+			if (iobroker_get_backend(nagios_iobs) != (use_io_uring ? IOBROKER_BACKEND_URING : IOBROKER_BACKEND_DEFAULT)
+				&& !iobroker_get_num_fds(nagios_iobs))
+			{
+				iobroker_set *iobs;
+				if ((iobs = iobroker_create_backend(use_io_uring ? IOBROKER_BACKEND_URING : IOBROKER_BACKEND_DEFAULT))) {
+					iobroker_destroy(nagios_iobs, 0);
+					nagios_iobs = iobs;
+				}
+				if (use_io_uring && iobroker_get_backend(nagios_iobs) != IOBROKER_BACKEND_URING)
+					logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: io_uring is not available. Using %s instead\n",
+						  iobroker_get_backend_name(nagios_iobs));
+			}
+			log_debug_info(DEBUGL_IPC, 0, "Using %s io broker\n", iobroker_get_backend_name(nagios_iobs));
+
 			/*
 			 * Initialize query handler and event subscription service.
 			 * This must be done before modules are initialized, so
@@ -765,8 +808,12 @@ int main(int argc, char **argv) {
 
 			/* write the objects.cache file */
 			fcache_objects(object_cache_file);
+			fcache_binary_objects(binary_object_cache_file);
 			timing_point("Objects cached\n");
 
+			prepare_commands();
+			timing_point("Command lines pre-parsed\n");
+
 			init_event_queue();
 			timing_point("Event queue initialized\n");
 
@@ -804,6 +851,10 @@ int main(int argc, char **argv) {
 			init_timing_loop();
 			timing_point("Event timing loop initialized\n");
 
+			/* index freshness deadlines now that retention data is in */
+			init_freshness_data();
+			timing_point("Freshness deadlines indexed\n");
+
 			/* initialize check statistics */
 			init_check_stats();
 			timing_point("check stats initialized\n");
@@ -843,6 +894,13 @@ int main(int argc, char **argv) {
 			/* (doesn't return until a restart or shutdown signal is encountered) */
 			event_execution_loop();
 
+			/* pick up object config changes in place for as long as we can */
+			while(sigrestart == TRUE && sigshutdown == FALSE && reload_object_config(config_file) != RELOAD_RESTART) {
+				sigrestart = FALSE;
+				caught_signal = FALSE;
+				event_execution_loop();
+				}
+
 			/*
 			 * immediately deinitialize the query handler so it
 			 * can remove modules that have stashed data with it
@@ -912,6 +970,9 @@ int main(int argc, char **argv) {
 			/* close debug log */
 			close_debug_log();
 
+			/* write out queued log messages; the new config may not want a writer thread */
+			stop_log_writer();
+
 			}
 		while(sigrestart == TRUE && sigshutdown == FALSE);
 
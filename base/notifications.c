@@ -774,7 +774,7 @@ int notify_contact_of_service(nagios_macros *mac, contact *cntct, service *svc,
 		log_debug_info(DEBUGL_NOTIFICATIONS, 2, "Raw notification command: %s\n", raw_command);
 
 		/* process any macros contained in the argument */
-		process_macros_r(mac, raw_command, &processed_command, macro_options);
+		process_command_macros_r(mac, raw_command, &processed_command, macro_options);
 		my_free(raw_command);
 		if(processed_command == NULL)
 			continue;
@@ -1676,7 +1676,7 @@ int notify_contact_of_host(nagios_macros *mac, contact *cntct, host *hst, int ty
 		log_debug_info(DEBUGL_NOTIFICATIONS, 2, "Raw notification command: %s\n", raw_command);
 
 		/* process any macros contained in the argument */
-		process_macros_r(mac, raw_command, &processed_command, macro_options);
+		process_command_macros_r(mac, raw_command, &processed_command, macro_options);
 		my_free(raw_command);
 		if(processed_command == NULL)
 			continue;
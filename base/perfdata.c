@@ -49,6 +49,13 @@ int cleanup_performance_data(void) {
 
 
 
+/* points performance data at the commands of a reloaded object configuration */
+int update_performance_data_commands(void) {
+	return xpddefault_update_performance_data_commands();
+	}
+
+
+
 /******************************************************************/
 /****************** PERFORMANCE DATA FUNCTIONS ********************/
 /******************************************************************/
@@ -18,6 +18,7 @@ struct query_handler {
 static struct query_handler *qhandlers;
 static int qh_listen_sock = -1; /* the listening socket */
 static unsigned int qh_running;
+static int qh_oneshot; /* the query being handled was sent with '#' */
 unsigned int qh_max_running = 0; /* defaults to unlimited */
 static dkhash_table *qh_table;
 
@@ -224,6 +225,7 @@ static int qh_input(int sd, int events, void *ioc_)
 		}
 
 		/* now pass the query to the handler */
+		qh_oneshot = *buf == '#';
 		result = qh->handler(sd, query, query_len);
 		if (result >= 100) {
 			nsock_printf_nul(sd, "%d: %s", result, qh_strerror(result));
@@ -469,6 +471,214 @@ static int qh_core(int sd, char *buf, unsigned int len)
 	return 404;
 }
 
+/*
+ * Check result streams. Clients that send "stream" get "OK" back once
+ * the socket has been handed over, and then send check results in
+ * the worker result format: key=value pairs separated by nul bytes,
+ * with each result terminated by the worker message delimiter, or
+ * length-prefixed binary key/value vectors after "stream
+ * framing=binary". The variables are the same as in check result
+ * spool files, except that output isn't escaped.
+ *
+ * Results are handled as soon as they're read, and we never read
+ * more than CR_STREAM_BUFSIZE bytes at a time, so a client sending
+ * faster than we can keep up blocks on a full socket buffer rather
+ * than having its results queue up in our memory.
+ */
+#define CR_STREAM_BUFSIZE (64 * 1024)
+#define CR_STREAM_MAX_MSG (1024 * 1024)
+
+struct cr_stream {
+	int sd;
+	int framing;
+	iocache *ioc;
+};
+
+static unsigned int cr_streams;
+static unsigned long cr_results, cr_rejected;
+
+static const char *cr_stream_source_name(const void *source)
+{
+	return "check result stream";
+}
+
+static struct check_engine nagios_stream_check_engine = {
+	"Check result stream",
+	cr_stream_source_name,
+	NULL,
+};
+
+static void cr_stream_close(struct cr_stream *s)
+{
+	iobroker_close(nagios_iobs, s->sd);
+	iocache_destroy(s->ioc);
+	free(s);
+	cr_streams--;
+}
+
+/* parses "<seconds>[.<microseconds>]" */
+static void cr_parse_timeval(struct timeval *tv, const char *val)
+{
+	char *dot;
+
+	tv->tv_sec = strtoul(val, &dot, 10);
+	tv->tv_usec = (*dot == '.') ? strtoul(dot + 1, NULL, 10) : 0;
+}
+
+/*
+ * Feeds one result to the core. Strings point straight into the
+ * stream's iocache, which stays put until we're done with it
+ */
+static int cr_stream_process(struct kvvec *kvv)
+{
+	check_result cr;
+	int i, result;
+
+	init_check_result(&cr);
+	cr.engine = &nagios_stream_check_engine;
+	gettimeofday(&cr.finish_time, NULL);
+	cr.start_time = cr.finish_time;
+
+	for (i = 0; i < kvv->kv_pairs; i++) {
+		char *key = kvv->kv[i].key, *val = kvv->kv[i].value;
+
+		if (!strcmp(key, "host_name"))
+			cr.host_name = val;
+		else if (!strcmp(key, "service_description")) {
+			cr.service_description = val;
+			cr.object_check_type = SERVICE_CHECK;
+		}
+		else if (!strcmp(key, "check_type"))
+			cr.check_type = atoi(val);
+		else if (!strcmp(key, "check_options"))
+			cr.check_options = atoi(val);
+		else if (!strcmp(key, "scheduled_check"))
+			cr.scheduled_check = atoi(val);
+		else if (!strcmp(key, "reschedule_check"))
+			cr.reschedule_check = atoi(val);
+		else if (!strcmp(key, "latency"))
+			cr.latency = strtod(val, NULL);
+		else if (!strcmp(key, "start_time"))
+			cr_parse_timeval(&cr.start_time, val);
+		else if (!strcmp(key, "finish_time"))
+			cr_parse_timeval(&cr.finish_time, val);
+		else if (!strcmp(key, "early_timeout"))
+			cr.early_timeout = atoi(val);
+		else if (!strcmp(key, "exited_ok"))
+			cr.exited_ok = atoi(val);
+		else if (!strcmp(key, "return_code"))
+			cr.return_code = atoi(val);
+		else if (!strcmp(key, "output"))
+			cr.output = val;
+	}
+
+	/* do we have the minimum amount of data? */
+	if (cr.host_name == NULL || cr.output == NULL) {
+		log_debug_info(DEBUGL_CHECKS, 1, "Minimum amount of data not present; Skipped streamed check result\n");
+		return ERROR;
+	}
+
+	result = process_check_result(&cr);
+
+	/* nothing here is ours to free */
+	cr.host_name = cr.service_description = cr.output = NULL;
+	free_check_result(&cr);
+
+	return result;
+}
+
+static int cr_stream_input(int sd, int events, void *arg)
+{
+	static struct kvvec kvv = KVVEC_INITIALIZER;
+	struct cr_stream *s = (struct cr_stream *)arg;
+	unsigned long size;
+	char *buf;
+	int ret;
+
+	ret = iocache_read(s->ioc, sd);
+	if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+		cr_stream_close(s);
+		return 0;
+	}
+
+	for (;;) {
+		if (s->framing == WORKER_FRAMING_BINARY) {
+			if (!(buf = worker_ioc2bmsg(s->ioc, &size)))
+				break;
+			ret = bbuf2kvvec_prealloc(&kvv, buf, size, KVVEC_ASSIGN);
+		} else {
+			if (!(buf = worker_ioc2msg(s->ioc, &size, 0)))
+				break;
+			ret = buf2kvvec_prealloc(&kvv, buf, size, '=', '\0', KVVEC_ASSIGN);
+		}
+
+		if (ret > 0 && cr_stream_process(&kvv) == OK)
+			cr_results++;
+		else
+			cr_rejected++;
+	}
+
+	/* whatever this is, it isn't a check result */
+	if (iocache_available(s->ioc) > CR_STREAM_MAX_MSG) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "qh: Closing check result stream with %lu bytes of unterminated input\n", iocache_available(s->ioc));
+		cr_stream_close(s);
+	}
+
+	return 0;
+}
+
+static int qh_checkresult(int sd, char *buf, unsigned int len)
+{
+	struct cr_stream *s;
+
+	if (*buf == 0 || !strcmp(buf, "help")) {
+
+		nsock_printf_nul(sd,
+			"Query handler for submitting check results.\n"
+			"Available commands:\n"
+			"  stream                  Turn this connection into a stream of check\n"
+			"                          results in the worker result format. Wait\n"
+			"                          for the OK before sending any. Can't be\n"
+			"                          sent as a one-shot (#) query.\n"
+			"  stream framing=binary   Same, with binary worker framing\n"
+			"  stats                   Print check result stream statistics\n"
+		);
+
+		return 0;
+	}
+
+	if (!strcmp(buf, "stats")) {
+		nsock_printf_nul(sd, "streams=%u;results=%lu;rejected=%lu", cr_streams, cr_results, cr_rejected);
+		return 0;
+	}
+
+	if (strcmp(buf, "stream") && strcmp(buf, "stream framing=binary"))
+		return 400;
+
+	/* a one-shot query's connection is closed as soon as we return */
+	if (qh_oneshot)
+		return 400;
+
+	if (!(s = calloc(1, sizeof(*s))) || !(s->ioc = iocache_create(CR_STREAM_BUFSIZE))) {
+		free(s);
+		return 500;
+	}
+	s->sd = sd;
+	s->framing = strcmp(buf, "stream") ? WORKER_FRAMING_BINARY : WORKER_FRAMING_TEXT;
+
+	iobroker_unregister(nagios_iobs, sd);
+	if (iobroker_register(nagios_iobs, sd, s, cr_stream_input) < 0) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "qh: Failed to register check result stream %d with I/O broker: %s\n", sd, strerror(errno));
+		iocache_destroy(s->ioc);
+		free(s);
+		return 500;
+	}
+	cr_streams++;
+	nsock_printf_nul(sd, "OK");
+
+	return QH_TAKEOVER;
+}
+
 int qh_init(const char *path)
 {
 	int result    = 0;
@@ -540,5 +750,10 @@ int qh_init(const char *path)
 		logit(NSLOG_INFO_MESSAGE, FALSE, "qh: help for the query handler registered\n");
 	}
 
+	result = qh_register_handler("checkresult", "Check result submission", 0, qh_checkresult);
+	if (result == OK) {
+		logit(NSLOG_INFO_MESSAGE, FALSE, "qh: checkresult query handler registered\n");
+	}
+
 	return 0;
 }
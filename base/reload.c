@@ -0,0 +1,753 @@
+/*****************************************************************************
+ *
+ * RELOAD.C - Incremental object configuration reload for Nagios
+ *
+ *
+ * License:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *****************************************************************************/
+
+/*
+ * A reload parses the object configuration into a fresh set of
+ * objects while the running set is put aside. Hosts, services and
+ * contacts that exist in both get the runtime state of their old
+ * self, including the check event that's already in the queue, and
+ * only objects that were added, removed or had their scheduling
+ * changed touch the event queue. Everything outside the object
+ * configuration (workers, the event queue, the query handler,
+ * comments and downtime of surviving objects) is left alone.
+ */
+
+/*********** COMMON HEADER FILES ***********/
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/objects.h"
+#include "../include/comments.h"
+#include "../include/downtime.h"
+#include "../include/statusdata.h"
+#include "../include/macros.h"
+#include "../include/perfdata.h"
+#include "../include/nagios.h"
+#include "../include/broker.h"
+#include "../include/nebmods.h"
+#include "../include/nebmodules.h"
+
+#define CHECKSUM_INIT 14695981039346656037ULL
+
+/* main config and resource files as they were when we last (re)started */
+static unsigned long long main_config_checksum;
+
+struct reload_stats {
+	unsigned int added;
+	unsigned int removed;
+	unsigned int kept;
+	unsigned int rescheduled;
+	};
+
+
+/******************************************************************/
+/*********************** CHECKSUM FUNCTIONS ***********************/
+/******************************************************************/
+
+/* FNV-1a, which is plenty to tell whether a file has changed */
+static unsigned long long checksum_update(unsigned long long sum, const char *buf, size_t len) {
+	size_t i;
+
+	for(i = 0; i < len; i++) {
+		sum ^= (unsigned char)buf[i];
+		sum *= 1099511628211ULL;
+		}
+
+	return sum;
+	}
+
+
+static unsigned long long checksum_file(unsigned long long sum, const char *path) {
+	char buf[8192];
+	size_t len;
+	FILE *fp;
+
+	/* a file we can't read still has to change the sum */
+	sum = checksum_update(sum, path, strlen(path) + 1);
+	if((fp = fopen(path, "r")) == NULL)
+		return checksum_update(sum, "", 1);
+
+	while((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+		sum = checksum_update(sum, buf, len);
+	fclose(fp);
+
+	return sum;
+	}
+
+
+/*
+ * Sums up everything in the main config file except the object
+ * config files and directories it names, which are what a reload
+ * picks up, plus the contents of all the resource files.
+ */
+static unsigned long long checksum_main_config(char *main_config_file) {
+	unsigned long long sum = CHECKSUM_INIT;
+	mmapfile *thefile = NULL;
+	char *input = NULL;
+	char *path = NULL;
+
+	if((thefile = mmap_fopen(main_config_file)) == NULL)
+		return 0;
+
+	while((input = mmap_fgets_multiline(thefile)) != NULL) {
+		strip(input);
+
+		if(input[0] != '\x0' && input[0] != '#' && strncmp(input, "cfg_file=", 9) && strncmp(input, "cfg_dir=", 8)) {
+			sum = checksum_update(sum, input, strlen(input) + 1);
+			if(!strncmp(input, "resource_file=", 14) && (path = nspath_absolute(input + 14, config_file_dir))) {
+				sum = checksum_file(sum, path);
+				my_free(path);
+				}
+			}
+
+		my_free(input);
+		}
+
+	mmap_fclose(thefile);
+
+	return sum;
+	}
+
+
+/* remembers the main config file we (re)started with */
+void initialize_reload_data(char *main_config_file) {
+	main_config_checksum = checksum_main_config(main_config_file);
+	}
+
+
+
+/******************************************************************/
+/********************* STATE TRANSFER FUNCTIONS *******************/
+/******************************************************************/
+
+/* hands a string from the old object to the new one */
+#define move_string(dst, src) do { my_free(dst); (dst) = (src); (src) = NULL; } while(0)
+
+static int strings_differ(const char *a, const char *b) {
+	if(a == NULL || b == NULL)
+		return a != b;
+	return strcmp(a, b);
+	}
+
+#define timeperiod_name(tp) ((tp) ? (tp)->name : NULL)
+
+
+/* keeps custom variables that were changed at runtime and are still defined */
+static void move_custom_variables(customvariablesmember *list, customvariablesmember *old_list) {
+	customvariablesmember *temp_customvariablesmember = NULL;
+
+	for(; old_list != NULL; old_list = old_list->next) {
+		if(old_list->has_been_modified == FALSE)
+			continue;
+		for(temp_customvariablesmember = list; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
+			if(!strcmp(temp_customvariablesmember->variable_name, old_list->variable_name)) {
+				move_string(temp_customvariablesmember->variable_value, old_list->variable_value);
+				temp_customvariablesmember->has_been_modified = TRUE;
+				break;
+				}
+			}
+		}
+	}
+
+
+/*
+ * Moves the runtime state of a host to its new definition. Attributes
+ * changed by external commands win over the new config, just like they
+ * do when they're read back from the retention file, as long as the
+ * commands and timeperiods they refer to still exist.
+ */
+static void move_host_state(host *hst, host *old) {
+	unsigned long attr = old->modified_attributes;
+	command *temp_command = NULL;
+	timeperiod *temp_timeperiod = NULL;
+
+	hst->problem_has_been_acknowledged = old->problem_has_been_acknowledged;
+	hst->acknowledgement_type = old->acknowledgement_type;
+	hst->check_type = old->check_type;
+	hst->current_state = old->current_state;
+	hst->last_state = old->last_state;
+	hst->last_hard_state = old->last_hard_state;
+	move_string(hst->plugin_output, old->plugin_output);
+	move_string(hst->long_plugin_output, old->long_plugin_output);
+	move_string(hst->perf_data, old->perf_data);
+	hst->state_type = old->state_type;
+	hst->current_attempt = old->current_attempt;
+	hst->current_event_id = old->current_event_id;
+	hst->last_event_id = old->last_event_id;
+	hst->current_problem_id = old->current_problem_id;
+	hst->last_problem_id = old->last_problem_id;
+	hst->latency = old->latency;
+	hst->execution_time = old->execution_time;
+	hst->is_executing = old->is_executing;
+	hst->check_options = old->check_options;
+	hst->check_source = old->check_source;
+	hst->last_notification = old->last_notification;
+	hst->next_notification = old->next_notification;
+	hst->next_check = old->next_check;
+	hst->last_check = old->last_check;
+	hst->last_state_change = old->last_state_change;
+	hst->last_hard_state_change = old->last_hard_state_change;
+	hst->last_time_up = old->last_time_up;
+	hst->last_time_down = old->last_time_down;
+	hst->last_time_unreachable = old->last_time_unreachable;
+	hst->has_been_checked = old->has_been_checked;
+	hst->is_being_freshened = old->is_being_freshened;
+	hst->notified_on = old->notified_on;
+	hst->current_notification_number = old->current_notification_number;
+	hst->no_more_notifications = old->no_more_notifications;
+	hst->current_notification_id = old->current_notification_id;
+	hst->check_flapping_recovery_notification = old->check_flapping_recovery_notification;
+	hst->scheduled_downtime_depth = old->scheduled_downtime_depth;
+	hst->pending_flex_downtime = old->pending_flex_downtime;
+	memcpy(hst->state_history, old->state_history, sizeof(hst->state_history));
+	hst->state_history_index = old->state_history_index;
+	hst->last_state_history_update = old->last_state_history_update;
+	hst->is_flapping = old->is_flapping;
+	hst->flapping_comment_id = old->flapping_comment_id;
+	hst->percent_state_change = old->percent_state_change;
+	hst->modified_attributes = attr;
+
+	if(attr & MODATTR_NOTIFICATIONS_ENABLED)
+		hst->notifications_enabled = old->notifications_enabled;
+	if(attr & MODATTR_ACTIVE_CHECKS_ENABLED)
+		hst->checks_enabled = old->checks_enabled;
+	if(attr & MODATTR_PASSIVE_CHECKS_ENABLED)
+		hst->accept_passive_checks = old->accept_passive_checks;
+	if(attr & MODATTR_EVENT_HANDLER_ENABLED)
+		hst->event_handler_enabled = old->event_handler_enabled;
+	if(attr & MODATTR_FLAP_DETECTION_ENABLED)
+		hst->flap_detection_enabled = old->flap_detection_enabled;
+	if(attr & MODATTR_PERFORMANCE_DATA_ENABLED)
+		hst->process_performance_data = old->process_performance_data;
+	if(attr & MODATTR_OBSESSIVE_HANDLER_ENABLED)
+		hst->obsess = old->obsess;
+	if(attr & MODATTR_NORMAL_CHECK_INTERVAL)
+		hst->check_interval = old->check_interval;
+	if(attr & MODATTR_RETRY_CHECK_INTERVAL)
+		hst->retry_interval = old->retry_interval;
+	if(attr & MODATTR_MAX_CHECK_ATTEMPTS)
+		hst->max_attempts = old->max_attempts;
+
+	if(attr & MODATTR_EVENT_HANDLER_COMMAND) {
+		if((temp_command = find_bang_command(old->event_handler)) != NULL) {
+			move_string(hst->event_handler, old->event_handler);
+			hst->event_handler_ptr = temp_command;
+			}
+		else
+			hst->modified_attributes &= ~MODATTR_EVENT_HANDLER_COMMAND;
+		}
+	if(attr & MODATTR_CHECK_COMMAND) {
+		if((temp_command = find_bang_command(old->check_command)) != NULL) {
+			move_string(hst->check_command, old->check_command);
+			hst->check_command_ptr = temp_command;
+			}
+		else
+			hst->modified_attributes &= ~MODATTR_CHECK_COMMAND;
+		}
+	if(attr & MODATTR_CHECK_TIMEPERIOD) {
+		if((temp_timeperiod = find_timeperiod(old->check_period)) != NULL) {
+			move_string(hst->check_period, old->check_period);
+			hst->check_period_ptr = temp_timeperiod;
+			}
+		else
+			hst->modified_attributes &= ~MODATTR_CHECK_TIMEPERIOD;
+		}
+	if(attr & MODATTR_NOTIFICATION_TIMEPERIOD) {
+		if((temp_timeperiod = find_timeperiod(old->notification_period)) != NULL) {
+			move_string(hst->notification_period, old->notification_period);
+			hst->notification_period_ptr = temp_timeperiod;
+			}
+		else
+			hst->modified_attributes &= ~MODATTR_NOTIFICATION_TIMEPERIOD;
+		}
+	if(attr & MODATTR_CUSTOM_VARIABLE)
+		move_custom_variables(hst->custom_variables, old->custom_variables);
+
+	/* max_check_attempts may have been lowered */
+	if(hst->current_attempt > hst->max_attempts)
+		hst->current_attempt = hst->max_attempts;
+	}
+
+
+/* moves the runtime state of a service to its new definition */
+static void move_service_state(service *svc, service *old) {
+	unsigned long attr = old->modified_attributes;
+	command *temp_command = NULL;
+	timeperiod *temp_timeperiod = NULL;
+
+	svc->problem_has_been_acknowledged = old->problem_has_been_acknowledged;
+	svc->acknowledgement_type = old->acknowledgement_type;
+	svc->host_problem_at_last_check = old->host_problem_at_last_check;
+	svc->check_type = old->check_type;
+	svc->current_state = old->current_state;
+	svc->last_state = old->last_state;
+	svc->last_hard_state = old->last_hard_state;
+	move_string(svc->plugin_output, old->plugin_output);
+	move_string(svc->long_plugin_output, old->long_plugin_output);
+	move_string(svc->perf_data, old->perf_data);
+	svc->state_type = old->state_type;
+	svc->next_check = old->next_check;
+	svc->last_check = old->last_check;
+	svc->current_attempt = old->current_attempt;
+	svc->current_event_id = old->current_event_id;
+	svc->last_event_id = old->last_event_id;
+	svc->current_problem_id = old->current_problem_id;
+	svc->last_problem_id = old->last_problem_id;
+	svc->last_notification = old->last_notification;
+	svc->next_notification = old->next_notification;
+	svc->no_more_notifications = old->no_more_notifications;
+	svc->check_flapping_recovery_notification = old->check_flapping_recovery_notification;
+	svc->last_state_change = old->last_state_change;
+	svc->last_hard_state_change = old->last_hard_state_change;
+	svc->last_time_ok = old->last_time_ok;
+	svc->last_time_warning = old->last_time_warning;
+	svc->last_time_unknown = old->last_time_unknown;
+	svc->last_time_critical = old->last_time_critical;
+	svc->has_been_checked = old->has_been_checked;
+	svc->is_being_freshened = old->is_being_freshened;
+	svc->notified_on = old->notified_on;
+	svc->current_notification_number = old->current_notification_number;
+	svc->current_notification_id = old->current_notification_id;
+	svc->latency = old->latency;
+	svc->execution_time = old->execution_time;
+	svc->is_executing = old->is_executing;
+	svc->check_options = old->check_options;
+	svc->check_source = old->check_source;
+	svc->scheduled_downtime_depth = old->scheduled_downtime_depth;
+	svc->pending_flex_downtime = old->pending_flex_downtime;
+	memcpy(svc->state_history, old->state_history, sizeof(svc->state_history));
+	svc->state_history_index = old->state_history_index;
+	svc->is_flapping = old->is_flapping;
+	svc->flapping_comment_id = old->flapping_comment_id;
+	svc->percent_state_change = old->percent_state_change;
+	svc->modified_attributes = attr;
+
+	if(attr & MODATTR_NOTIFICATIONS_ENABLED)
+		svc->notifications_enabled = old->notifications_enabled;
+	if(attr & MODATTR_ACTIVE_CHECKS_ENABLED)
+		svc->checks_enabled = old->checks_enabled;
+	if(attr & MODATTR_PASSIVE_CHECKS_ENABLED)
+		svc->accept_passive_checks = old->accept_passive_checks;
+	if(attr & MODATTR_EVENT_HANDLER_ENABLED)
+		svc->event_handler_enabled = old->event_handler_enabled;
+	if(attr & MODATTR_FLAP_DETECTION_ENABLED)
+		svc->flap_detection_enabled = old->flap_detection_enabled;
+	if(attr & MODATTR_PERFORMANCE_DATA_ENABLED)
+		svc->process_performance_data = old->process_performance_data;
+	if(attr & MODATTR_OBSESSIVE_HANDLER_ENABLED)
+		svc->obsess = old->obsess;
+	if(attr & MODATTR_NORMAL_CHECK_INTERVAL)
+		svc->check_interval = old->check_interval;
+	if(attr & MODATTR_RETRY_CHECK_INTERVAL)
+		svc->retry_interval = old->retry_interval;
+	if(attr & MODATTR_MAX_CHECK_ATTEMPTS)
+		svc->max_attempts = old->max_attempts;
+
+	if(attr & MODATTR_EVENT_HANDLER_COMMAND) {
+		if((temp_command = find_bang_command(old->event_handler)) != NULL) {
+			move_string(svc->event_handler, old->event_handler);
+			svc->event_handler_ptr = temp_command;
+			}
+		else
+			svc->modified_attributes &= ~MODATTR_EVENT_HANDLER_COMMAND;
+		}
+	if(attr & MODATTR_CHECK_COMMAND) {
+		if((temp_command = find_bang_command(old->check_command)) != NULL) {
+			move_string(svc->check_command, old->check_command);
+			svc->check_command_ptr = temp_command;
+			}
+		else
+			svc->modified_attributes &= ~MODATTR_CHECK_COMMAND;
+		}
+	if(attr & MODATTR_CHECK_TIMEPERIOD) {
+		if((temp_timeperiod = find_timeperiod(old->check_period)) != NULL) {
+			move_string(svc->check_period, old->check_period);
+			svc->check_period_ptr = temp_timeperiod;
+			}
+		else
+			svc->modified_attributes &= ~MODATTR_CHECK_TIMEPERIOD;
+		}
+	if(attr & MODATTR_NOTIFICATION_TIMEPERIOD) {
+		if((temp_timeperiod = find_timeperiod(old->notification_period)) != NULL) {
+			move_string(svc->notification_period, old->notification_period);
+			svc->notification_period_ptr = temp_timeperiod;
+			}
+		else
+			svc->modified_attributes &= ~MODATTR_NOTIFICATION_TIMEPERIOD;
+		}
+	if(attr & MODATTR_CUSTOM_VARIABLE)
+		move_custom_variables(svc->custom_variables, old->custom_variables);
+
+	if(svc->current_attempt > svc->max_attempts)
+		svc->current_attempt = svc->max_attempts;
+	}
+
+
+/* moves the runtime state of a contact to its new definition */
+static void move_contact_state(contact *cntct, contact *old) {
+	timeperiod *temp_timeperiod = NULL;
+
+	cntct->last_host_notification = old->last_host_notification;
+	cntct->last_service_notification = old->last_service_notification;
+	cntct->modified_attributes = old->modified_attributes;
+	cntct->modified_host_attributes = old->modified_host_attributes;
+	cntct->modified_service_attributes = old->modified_service_attributes;
+
+	if(old->modified_host_attributes & MODATTR_NOTIFICATIONS_ENABLED)
+		cntct->host_notifications_enabled = old->host_notifications_enabled;
+	if(old->modified_service_attributes & MODATTR_NOTIFICATIONS_ENABLED)
+		cntct->service_notifications_enabled = old->service_notifications_enabled;
+
+	if(old->modified_host_attributes & MODATTR_NOTIFICATION_TIMEPERIOD) {
+		if((temp_timeperiod = find_timeperiod(old->host_notification_period)) != NULL) {
+			move_string(cntct->host_notification_period, old->host_notification_period);
+			cntct->host_notification_period_ptr = temp_timeperiod;
+			}
+		else
+			cntct->modified_host_attributes &= ~MODATTR_NOTIFICATION_TIMEPERIOD;
+		}
+	if(old->modified_service_attributes & MODATTR_NOTIFICATION_TIMEPERIOD) {
+		if((temp_timeperiod = find_timeperiod(old->service_notification_period)) != NULL) {
+			move_string(cntct->service_notification_period, old->service_notification_period);
+			cntct->service_notification_period_ptr = temp_timeperiod;
+			}
+		else
+			cntct->modified_service_attributes &= ~MODATTR_NOTIFICATION_TIMEPERIOD;
+		}
+	if(old->modified_attributes & MODATTR_CUSTOM_VARIABLE)
+		move_custom_variables(cntct->custom_variables, old->custom_variables);
+	}
+
+
+
+/******************************************************************/
+/******************* CHECK SCHEDULING FUNCTIONS *******************/
+/******************************************************************/
+
+/* same rules as init_timing_loop() */
+static int check_can_be_scheduled(double check_interval, int checks_enabled, timeperiod *check_period_ptr, time_t current_time) {
+	time_t next_valid_time = 0L;
+
+	if(check_interval == 0 || checks_enabled == FALSE)
+		return FALSE;
+
+	if(check_time_against_period(current_time, check_period_ptr) == ERROR) {
+		get_next_valid_time(current_time, &next_valid_time, check_period_ptr);
+		if(current_time == next_valid_time)
+			return FALSE;
+		}
+
+	return TRUE;
+	}
+
+
+/* takes an unneeded check event out of the queue */
+static void drop_check_event(timed_event *event) {
+	if(event == NULL)
+		return;
+	remove_event(nagios_squeue, event);
+	my_free(event);
+	}
+
+
+/*
+ * Hands the check event of the old host (if any) to the new one and
+ * reschedules it if the new definition needs that. An unchanged host
+ * keeps the exact check time it had.
+ */
+static void reschedule_host(host *hst, host *old, time_t current_time, struct reload_stats *stats) {
+	timed_event *temp_event = NULL;
+
+	if(old != NULL && (temp_event = old->next_check_event) != NULL) {
+		old->next_check_event = NULL;
+		temp_event->event_data = (void *)hst;
+		hst->next_check_event = temp_event;
+		}
+
+	hst->should_be_scheduled = check_can_be_scheduled(hst->check_interval, hst->checks_enabled, hst->check_period_ptr, current_time);
+
+	/* forced checks still run, like they do after a restart */
+	if(hst->should_be_scheduled == FALSE) {
+		if(temp_event != NULL && !(temp_event->event_options & CHECK_OPTION_FORCE_EXECUTION)) {
+			drop_check_event(temp_event);
+			hst->next_check_event = NULL;
+			}
+		return;
+		}
+
+	/* the old timeperiods are still around, so we can go by their names */
+	if(temp_event != NULL && hst->check_interval == old->check_interval && hst->retry_interval == old->retry_interval &&
+	   !strings_differ(timeperiod_name(hst->check_period_ptr), timeperiod_name(old->check_period_ptr)))
+		return;
+
+	/* spread new checks out, but don't push back one that's due sooner */
+	schedule_host_check(hst, current_time + ranged_urand(0, check_window(hst)), CHECK_OPTION_NONE);
+	stats->rescheduled++;
+	}
+
+
+static void reschedule_service(service *svc, service *old, time_t current_time, struct reload_stats *stats) {
+	timed_event *temp_event = NULL;
+
+	if(old != NULL && (temp_event = old->next_check_event) != NULL) {
+		old->next_check_event = NULL;
+		temp_event->event_data = (void *)svc;
+		svc->next_check_event = temp_event;
+		}
+
+	svc->should_be_scheduled = check_can_be_scheduled(svc->check_interval, svc->checks_enabled, svc->check_period_ptr, current_time);
+
+	if(svc->should_be_scheduled == FALSE) {
+		if(temp_event != NULL && !(temp_event->event_options & CHECK_OPTION_FORCE_EXECUTION)) {
+			drop_check_event(temp_event);
+			svc->next_check_event = NULL;
+			}
+		return;
+		}
+
+	if(temp_event != NULL && svc->check_interval == old->check_interval && svc->retry_interval == old->retry_interval &&
+	   !strings_differ(timeperiod_name(svc->check_period_ptr), timeperiod_name(old->check_period_ptr)))
+		return;
+
+	schedule_service_check(svc, current_time + ranged_urand(0, check_window(svc)), CHECK_OPTION_NONE);
+	stats->rescheduled++;
+	}
+
+
+/* drops the comments and downtime of a host or service that's no longer defined */
+static void delete_object_annotations(int downtime_type, char *host_name, char *service_description) {
+	scheduled_downtime *temp_downtime = NULL;
+	scheduled_downtime *next_downtime = NULL;
+
+	/*
+	 * unschedule_downtime() wants the object around to update it,
+	 * so we take the downtime's events off the queue and delete it
+	 */
+	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = next_downtime) {
+		next_downtime = temp_downtime->next;
+		if(temp_downtime->type != downtime_type || strcmp(temp_downtime->host_name, host_name))
+			continue;
+		if(service_description != NULL && strings_differ(temp_downtime->service_description, service_description))
+			continue;
+		if(temp_downtime->start_event) {
+			remove_event(nagios_squeue, temp_downtime->start_event);
+			my_free(temp_downtime->start_event);
+			}
+		if(temp_downtime->stop_event) {
+			remove_event(nagios_squeue, temp_downtime->stop_event);
+			my_free(temp_downtime->stop_event);
+			}
+		delete_downtime(temp_downtime->type, temp_downtime->downtime_id);
+		}
+
+	if(service_description == NULL)
+		delete_all_host_comments(host_name);
+	else
+		delete_all_service_comments(host_name, service_description);
+	}
+
+
+/* matches up old and new objects and moves everything that belongs to the old ones */
+static void transfer_object_state(object_set *old, struct reload_stats *stats) {
+	bitmap *kept_hosts = NULL;
+	bitmap *kept_services = NULL;
+	host *temp_host = NULL;
+	host *old_host = NULL;
+	service *temp_service = NULL;
+	service *old_service = NULL;
+	contact *temp_contact = NULL;
+	contact *old_contact = NULL;
+	time_t current_time;
+	unsigned int i;
+
+	time(&current_time);
+
+	kept_hosts = bitmap_create(old->count.hosts + 1);
+	kept_services = bitmap_create(old->count.services + 1);
+
+	for(i = 0; i < num_objects.hosts; i++) {
+		temp_host = host_ary[i];
+		old_host = old->hash_tables[HOST_SKIPLIST] ? dkhash_get(old->hash_tables[HOST_SKIPLIST], temp_host->name, NULL) : NULL;
+		if(old_host != NULL) {
+			bitmap_set(kept_hosts, old_host->id);
+			move_host_state(temp_host, old_host);
+			stats->kept++;
+			}
+		else
+			stats->added++;
+		reschedule_host(temp_host, old_host, current_time, stats);
+		}
+
+	for(i = 0; i < num_objects.services; i++) {
+		temp_service = service_ary[i];
+		old_service = old->hash_tables[SERVICE_SKIPLIST] ? dkhash_get(old->hash_tables[SERVICE_SKIPLIST], temp_service->host_name, temp_service->description) : NULL;
+		if(old_service != NULL) {
+			bitmap_set(kept_services, old_service->id);
+			move_service_state(temp_service, old_service);
+			stats->kept++;
+			}
+		else
+			stats->added++;
+		reschedule_service(temp_service, old_service, current_time, stats);
+		}
+
+	for(i = 0; i < num_objects.contacts; i++) {
+		temp_contact = contact_ary[i];
+		old_contact = old->hash_tables[CONTACT_SKIPLIST] ? dkhash_get(old->hash_tables[CONTACT_SKIPLIST], temp_contact->name, NULL) : NULL;
+		if(old_contact != NULL)
+			move_contact_state(temp_contact, old_contact);
+		}
+
+	/* whatever wasn't matched is gone */
+	for(i = 0; i < old->count.services; i++) {
+		old_service = old->service_ary[i];
+		if(bitmap_isset(kept_services, i))
+			continue;
+		log_debug_info(DEBUGL_CONFIG, 1, "Service '%s' on host '%s' was removed\n", old_service->description, old_service->host_name);
+		drop_check_event(old_service->next_check_event);
+		old_service->next_check_event = NULL;
+		delete_object_annotations(SERVICE_DOWNTIME, old_service->host_name, old_service->description);
+		stats->removed++;
+		}
+	for(i = 0; i < old->count.hosts; i++) {
+		old_host = old->host_ary[i];
+		if(bitmap_isset(kept_hosts, i))
+			continue;
+		log_debug_info(DEBUGL_CONFIG, 1, "Host '%s' was removed\n", old_host->name);
+		drop_check_event(old_host->next_check_event);
+		old_host->next_check_event = NULL;
+		delete_object_annotations(HOST_DOWNTIME, old_host->name, NULL);
+		stats->removed++;
+		}
+
+	bitmap_destroy(kept_hosts);
+	bitmap_destroy(kept_services);
+	}
+
+
+
+/******************************************************************/
+/************************ RELOAD FUNCTIONS ************************/
+/******************************************************************/
+
+#ifdef USE_EVENT_BROKER
+/*
+ * modules may hang on to objects, so they're reloaded the way a restart
+ * would. They're unloaded while the old objects are still around and
+ * loaded again once the new ones are in place
+ */
+static void unload_modules(void) {
+	broker_program_state(NEBTYPE_PROCESS_EVENTLOOPEND, NEBFLAG_NONE, NEBATTR_NONE, NULL);
+	broker_program_state(NEBTYPE_PROCESS_RESTART, NEBFLAG_USER_INITIATED, NEBATTR_RESTART_NORMAL, NULL);
+	neb_unload_all_modules(NEBMODULE_FORCE_UNLOAD, NEBMODULE_NEB_RESTART);
+	}
+
+static void load_modules(void) {
+	if(neb_load_all_modules() != OK)
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Failed to reload one or more modules after reloading the object configuration.\n");
+	broker_program_state(NEBTYPE_PROCESS_PRELAUNCH, NEBFLAG_NONE, NEBATTR_NONE, NULL);
+	broker_program_state(NEBTYPE_PROCESS_START, NEBFLAG_NONE, NEBATTR_NONE, NULL);
+	}
+#endif
+
+
+/*
+ * Reads the object configuration again and swaps it in. Returns OK
+ * if the new objects are in place, ERROR if the config couldn't be
+ * read (in which case nothing changes) and RELOAD_RESTART if a full
+ * restart is needed instead.
+ */
+int reload_object_config(char *main_config_file) {
+	object_set old_objects;
+	struct reload_stats stats;
+	command *saved_global_host_event_handler_ptr = global_host_event_handler_ptr;
+	command *saved_global_service_event_handler_ptr = global_service_event_handler_ptr;
+	command *saved_ocsp_command_ptr = ocsp_command_ptr;
+	command *saved_ochp_command_ptr = ochp_command_ptr;
+	struct timeval start, end;
+	int result = OK;
+
+	if(use_incremental_reload == FALSE)
+		return RELOAD_RESTART;
+
+	if(checksum_main_config(main_config_file) != main_config_checksum) {
+		logit(NSLOG_PROCESS_INFO, TRUE, "Main config or resource files have changed, so a full restart is needed.\n");
+		return RELOAD_RESTART;
+		}
+
+	logit(NSLOG_PROCESS_INFO, TRUE, "Reloading object configuration...\n");
+	gettimeofday(&start, NULL);
+	memset(&old_objects, 0, sizeof(old_objects));
+	memset(&stats, 0, sizeof(stats));
+
+	/* parse the new objects with the running ones out of the way */
+	swap_object_data(&old_objects);
+	result = read_all_object_data(main_config_file);
+	if(result == OK)
+		result = pre_flight_check();
+
+	/* modules never noticed we tried, so there's nothing else to undo */
+	if(result != OK) {
+		logit(NSLOG_PROCESS_INFO | NSLOG_RUNTIME_ERROR | NSLOG_CONFIG_ERROR, TRUE, "Error: Unable to reload the object configuration due to errors in the configuration files. Keeping the running configuration. Run Nagios from the command line with the -v option to verify your config.\n");
+		free_object_data();
+		swap_object_data(&old_objects);
+		global_host_event_handler_ptr = saved_global_host_event_handler_ptr;
+		global_service_event_handler_ptr = saved_global_service_event_handler_ptr;
+		ocsp_command_ptr = saved_ocsp_command_ptr;
+		ochp_command_ptr = saved_ochp_command_ptr;
+		return ERROR;
+		}
+
+#ifdef USE_EVENT_BROKER
+	unload_modules();
+#endif
+
+	transfer_object_state(&old_objects, &stats);
+	free_object_set(&old_objects);
+
+	/* nothing may point into the old objects anymore */
+	clear_volatile_macros_r(get_global_macros());
+	invalidate_macro_environment_cache();
+	update_performance_data_commands();
+	prepare_commands();
+	reset_object_status_data();
+	init_freshness_data();
+
+	fcache_objects(object_cache_file);
+	fcache_binary_objects(binary_object_cache_file);
+
+#ifdef USE_EVENT_BROKER
+	load_modules();
+#endif
+
+	update_all_status_data();
+
+#ifdef USE_EVENT_BROKER
+	broker_program_state(NEBTYPE_PROCESS_EVENTLOOPSTART, NEBFLAG_NONE, NEBATTR_NONE, NULL);
+#endif
+
+	gettimeofday(&end, NULL);
+	logit(NSLOG_PROCESS_INFO, TRUE, "Object configuration reloaded in %.3fs: %u hosts/services kept, %u added, %u removed, %u checks rescheduled.\n",
+	      tv_delta_f(&start, &end), stats.kept, stats.added, stats.removed, stats.rescheduled);
+
+	return OK;
+	}
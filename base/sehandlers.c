@@ -80,7 +80,7 @@ int obsessive_compulsive_service_check_processor(service *svc) {
 	log_debug_info(DEBUGL_CHECKS, 2, "Raw obsessive compulsive service processor command line: %s\n", raw_command);
 
 	/* process any macros in the raw command line */
-	process_macros_r(&mac, raw_command, &processed_command, macro_options);
+	process_command_macros_r(&mac, raw_command, &processed_command, macro_options);
 	my_free(raw_command);
 	if(processed_command == NULL) {
 		clear_volatile_macros_r(&mac);
@@ -135,7 +135,7 @@ int obsessive_compulsive_host_check_processor(host *hst) {
 	log_debug_info(DEBUGL_CHECKS, 2, "Raw obsessive compulsive host processor command line: %s\n", raw_command);
 
 	/* process any macros in the raw command line */
-	process_macros_r(&mac, raw_command, &processed_command, macro_options);
+	process_command_macros_r(&mac, raw_command, &processed_command, macro_options);
 	my_free(raw_command);
 	if(processed_command == NULL) {
 		clear_volatile_macros_r(&mac);
@@ -252,7 +252,7 @@ int run_global_service_event_handler(nagios_macros *mac, service *svc) {
 	log_debug_info(DEBUGL_EVENTHANDLERS, 2, "Raw global service event handler command line: %s\n", raw_command);
 
 	/* process any macros in the raw command line */
-	process_macros_r(mac, raw_command, &processed_command, macro_options);
+	process_command_macros_r(mac, raw_command, &processed_command, macro_options);
 	my_free(raw_command);
 	if(processed_command == NULL)
 		return ERROR;
@@ -352,7 +352,7 @@ int run_service_event_handler(nagios_macros *mac, service *svc) {
 	log_debug_info(DEBUGL_EVENTHANDLERS, 2, "Raw service event handler command line: %s\n", raw_command);
 
 	/* process any macros in the raw command line */
-	process_macros_r(mac, raw_command, &processed_command, macro_options);
+	process_command_macros_r(mac, raw_command, &processed_command, macro_options);
 	my_free(raw_command);
 	if(processed_command == NULL)
 		return ERROR;
@@ -496,7 +496,7 @@ int run_global_host_event_handler(nagios_macros *mac, host *hst) {
 	log_debug_info(DEBUGL_EVENTHANDLERS, 2, "Raw global host event handler command line: %s\n", raw_command);
 
 	/* process any macros in the raw command line */
-	process_macros_r(mac, raw_command, &processed_command, macro_options);
+	process_command_macros_r(mac, raw_command, &processed_command, macro_options);
 	my_free(raw_command);
 	if(processed_command == NULL)
 		return ERROR;
@@ -594,7 +594,7 @@ int run_host_event_handler(nagios_macros *mac, host *hst) {
 	log_debug_info(DEBUGL_EVENTHANDLERS, 2, "Raw host event handler command line: %s\n", raw_command);
 
 	/* process any macros in the raw command line */
-	process_macros_r(mac, raw_command, &processed_command, macro_options);
+	process_command_macros_r(mac, raw_command, &processed_command, macro_options);
 	my_free(raw_command);
 	if(processed_command == NULL)
 		return ERROR;
@@ -51,6 +51,7 @@ char *check_result_path;
 char *lock_file;
 
 int num_check_workers;
+int config_parser_threads;
 char *qh_socket_path;
 
 char *nagios_user;
@@ -142,6 +143,7 @@ int retention_update_interval;
 int use_retained_program_state;
 int use_retained_scheduling_info;
 int retention_scheduling_horizon;
+int use_binary_retention_file;
 char *retention_file;
 
 unsigned long modified_process_attributes = MODATTR_NONE;
@@ -181,6 +183,7 @@ int translate_passive_host_checks;
 int passive_host_checks_are_soft;
 
 int status_update_interval;
+int status_snapshot_compaction_interval;
 
 int time_change_threshold;
 
@@ -192,6 +195,15 @@ double low_host_flap_threshold;
 double high_host_flap_threshold;
 
 int use_large_installation_tweaks;
+int use_timing_wheel;
+int max_event_batch_size;
+int worker_dispatch_policy;
+int use_binary_worker_framing;
+int use_io_uring;
+int worker_spawn_method;
+int use_incremental_reload;
+int use_async_log_writer;
+unsigned long async_log_buffer_size;
 int enable_environment_macros;
 int free_child_process_memory;
 int child_processes_fork_twice;
@@ -221,6 +233,8 @@ int     host_perfdata_file_pipe;
 int     service_perfdata_file_pipe;
 unsigned long host_perfdata_file_processing_interval;
 unsigned long service_perfdata_file_processing_interval;
+unsigned long perfdata_file_buffer_size;
+unsigned long perfdata_file_flush_interval;
 char    *host_perfdata_file_processing_command;
 char    *service_perfdata_file_processing_command;
 int     host_perfdata_process_empty_results;
@@ -331,6 +345,7 @@ void init_main_cfg_vars(int first_time) {
 	use_retained_program_state = TRUE;
 	use_retained_scheduling_info = FALSE;
 	retention_scheduling_horizon = DEFAULT_RETENTION_SCHEDULING_HORIZON;
+	use_binary_retention_file = DEFAULT_USE_BINARY_RETENTION_FILE;
 	if(first_time) {
 		/* Not sure why this is not reset in reset_variables() */
 		retention_file = NULL;
@@ -364,6 +379,8 @@ void init_main_cfg_vars(int first_time) {
 	max_parallel_service_checks = DEFAULT_MAX_PARALLEL_SERVICE_CHECKS;
 
 	status_update_interval = DEFAULT_STATUS_UPDATE_INTERVAL;
+	status_snapshot_compaction_interval = DEFAULT_STATUS_SNAPSHOT_COMPACTION_INTERVAL;
+	config_parser_threads = DEFAULT_CONFIG_PARSER_THREADS;
 
 	event_broker_options = BROKER_NOTHING;
 
@@ -378,6 +395,15 @@ void init_main_cfg_vars(int first_time) {
 	passive_host_checks_are_soft = DEFAULT_PASSIVE_HOST_CHECKS_SOFT;
 
 	use_large_installation_tweaks = DEFAULT_USE_LARGE_INSTALLATION_TWEAKS;
+	use_timing_wheel = DEFAULT_USE_TIMING_WHEEL;
+	max_event_batch_size = DEFAULT_MAX_EVENT_BATCH_SIZE;
+	worker_dispatch_policy = DEFAULT_WORKER_DISPATCH_POLICY;
+	use_binary_worker_framing = DEFAULT_USE_BINARY_WORKER_FRAMING;
+	use_io_uring = DEFAULT_USE_IO_URING;
+	worker_spawn_method = DEFAULT_WORKER_SPAWN_METHOD;
+	use_incremental_reload = DEFAULT_USE_INCREMENTAL_RELOAD;
+	use_async_log_writer = DEFAULT_USE_ASYNC_LOG_WRITER;
+	async_log_buffer_size = DEFAULT_ASYNC_LOG_BUFFER_SIZE;
 	enable_environment_macros = FALSE;
 	free_child_process_memory = -1;
 	child_processes_fork_twice = -1;
@@ -405,6 +431,8 @@ void init_main_cfg_vars(int first_time) {
 		service_perfdata_file_append = TRUE;
 		host_perfdata_file_processing_interval = 0L;
 		service_perfdata_file_processing_interval = 0L;
+		perfdata_file_buffer_size = DEFAULT_PERFDATA_FILE_BUFFER_SIZE;
+		perfdata_file_flush_interval = DEFAULT_PERFDATA_FILE_FLUSH_INTERVAL;
 		host_perfdata_file_processing_command = NULL;
 		service_perfdata_file_processing_command = NULL;
 		host_perfdata_process_empty_results =
@@ -804,6 +832,10 @@ int get_raw_command_line_r(nagios_macros *mac, command *cmd_ptr, char *cmd, char
 	/* clear the argv macros */
 	clear_argv_macros_r(mac);
 
+	/* remember the command so its compiled templates can be used */
+	mac->command_ptr = full_command ? cmd_ptr : NULL;
+	mac->command_options = macro_options;
+
 	/* make sure we've got all the requirements */
 	if(cmd_ptr == NULL || full_command == NULL)
 		return ERROR;
@@ -873,6 +905,299 @@ int get_raw_command_line(command *cmd_ptr, char *cmd, char **full_command, int m
 	}
 
 
+/*
+ * Characters runcmd_cmd2strv() treats as anything but a plain byte.
+ * An argument without any of these comes out of a command line
+ * exactly the way it went in, no matter how it's quoted.
+ */
+#define CMD_SPECIAL_CHARS " \t\r\n\\'\"|<>&;`()$*?"
+#define CMD_SPACE_CHARS " \t\r\n"
+
+/* copy a vector of strings into a single allocation */
+static char **pack_argv(char **args, int argc)
+{
+	char **argv, *buf;
+	size_t bufsize = 0;
+	int i;
+
+	for(i = 0; i < argc; i++)
+		bufsize += strlen(args[i]) + 1;
+	if(!(argv = malloc((argc + 1) * sizeof(char *) + bufsize)))
+		return NULL;
+	buf = (char *)&argv[argc + 1];
+	for(i = 0; i < argc; i++) {
+		size_t len = strlen(args[i]) + 1;
+
+		argv[i] = memcpy(buf, args[i], len);
+		buf += len;
+		}
+	argv[argc] = NULL;
+
+	return argv;
+	}
+
+
+/*
+ * Split a command line the way runcmd_cmd2strv() does, if it can be
+ * run without a shell. Each argument that has macros in it is kept
+ * as it's written in the command line, quotes and all, so it can be
+ * expanded and split on its own when the command is run. Arguments
+ * without macros are kept the way they'll be passed to the command.
+ * Command lines that need a shell, set environment variables or have
+ * macros we can't reason about are marked as needing a shell.
+ */
+static void tokenize_command_line(command *cmd)
+{
+	const char *line = cmd->command_line;
+	char *masked = NULL, **tokens = NULL, **raw = NULL, **args = NULL;
+	int *pos = NULL, argc = 0, nraw = 0, i, j;
+	size_t len;
+
+	if(!line || !*line || strchr(line, '\x01'))
+		return;
+
+	len = strlen(line);
+	masked = malloc(len + 1);
+	pos = malloc((len + 1) * sizeof(int));
+	tokens = calloc((len / 2) + 5, sizeof(char *));
+	raw = calloc((len / 2) + 5, sizeof(char *));
+	if(!masked || !pos || !tokens || !raw)
+		goto out;
+
+	/* replace each $MACRO$ with a placeholder byte, remembering where it came from */
+	for(i = 0, j = 0; line[i]; i++) {
+		const char *end;
+
+		pos[j] = i;
+		if(line[i] != '$') {
+			masked[j++] = line[i];
+			continue;
+			}
+		/* "$$" and unbalanced dollar signs are left to the shell */
+		end = strchr(line + i + 1, '$');
+		if(!end || end == line + i + 1 || strcspn(line + i + 1, CMD_SPECIAL_CHARS) < (size_t)(end - line - i - 1)) {
+			cmd->argv_shell = TRUE;
+			goto out;
+			}
+		masked[j++] = '\x01';
+		i = end - line;
+		}
+	masked[j] = 0;
+	pos[j] = i;
+
+	if(runcmd_cmd2strv(masked, &argc, tokens)) {
+		cmd->argv_shell = TRUE;
+		goto out;
+		}
+	/* VAR=value prefixes go into the environment, which the shell does for us */
+	if(!argc || strchr(tokens[0], '=')) {
+		cmd->argv_shell = argc > 0;
+		goto out;
+		}
+
+	/*
+	 * find where each argument starts and ends in the command line,
+	 * making sure runcmd_cmd2strv() sees the same argument there
+	 */
+	for(i = 0; masked[i]; ) {
+		char *tok, *check[3] = { NULL, NULL, NULL };
+		int start, sq = 0, dq = 0, n = 0, ret;
+
+		if(strchr(CMD_SPACE_CHARS, masked[i])) {
+			i++;
+			continue;
+			}
+		for(start = i; masked[i] && (sq || dq || !strchr(CMD_SPACE_CHARS, masked[i])); i++) {
+			if(masked[i] == '\\' && !sq && masked[i + 1])
+				i++;
+			else if(masked[i] == '\'' && !dq)
+				sq = !sq;
+			else if(masked[i] == '"' && !sq)
+				dq = !dq;
+			}
+		if(nraw == argc || !(tok = strndup(masked + start, i - start)))
+			goto out;
+		ret = runcmd_cmd2strv(tok, &n, check);
+		if(ret || n != 1 || strcmp(check[0], tokens[nraw])) {
+			if(n)
+				free(check[0]);
+			free(tok);
+			goto out;
+			}
+		free(check[0]);
+
+		/* the arguments with macros in them get their macros back */
+		if(strchr(tok, '\x01') && !(raw[nraw] = strndup(line + pos[start], pos[i] - pos[start]))) {
+			free(tok);
+			goto out;
+			}
+		free(tok);
+		nraw++;
+		}
+	if(nraw != argc)
+		goto out;
+
+	if(!(args = calloc(argc, sizeof(char *))))
+		goto out;
+	for(i = 0; i < argc; i++)
+		args[i] = raw[i] ? raw[i] : tokens[i];
+	if(!(cmd->argv = pack_argv(args, argc)))
+		goto out;
+
+	/* compile the macros of the arguments that have any, or don't use the template at all */
+	for(i = 0; i < argc; i++) {
+		if(!raw[i])
+			continue;
+		if(!cmd->argv_tmpl && !(cmd->argv_tmpl = calloc(argc, sizeof(struct macro_template *))))
+			break;
+		if(!(cmd->argv_tmpl[i] = compile_macro_template(cmd->argv[i])))
+			break;
+		}
+	if(i < argc) {
+		for(j = 0; cmd->argv_tmpl && j < argc; j++)
+			my_free(cmd->argv_tmpl[j]);
+		my_free(cmd->argv_tmpl);
+		my_free(cmd->argv);
+		}
+
+out:
+	if(argc)
+		free(tokens[0]);
+	for(i = 0; raw && i < nraw; i++)
+		free(raw[i]);
+	free(args);
+	free(raw);
+	free(tokens);
+	free(pos);
+	free(masked);
+	}
+
+
+/* compile the macros of a command line and split it into an argv template, if possible */
+void prepare_command(command *cmd) {
+	if(!cmd->macro_tmpl)
+		cmd->macro_tmpl = compile_macro_template(cmd->command_line);
+	if(!cmd->argv && !cmd->argv_shell)
+		tokenize_command_line(cmd);
+	}
+
+
+/* compile the macros of all command lines and decide how each is run */
+void prepare_commands(void) {
+	unsigned int i, direct = 0, shell = 0;
+
+	for(i = 0; i < num_objects.commands; i++) {
+		prepare_command(command_ary[i]);
+		if(command_ary[i]->argv)
+			direct++;
+		else if(command_ary[i]->argv_shell)
+			shell++;
+		}
+
+	log_debug_info(DEBUGL_COMMANDS, 1, "%u of %u commands can be run without a shell, %u need one\n", direct, num_objects.commands, shell);
+	}
+
+
+/*
+ * expand the command line of the command last prepared with
+ * get_raw_command_line_r(), using its compiled template if it has
+ * one. raw_command is what get_raw_command_line_r() handed back
+ */
+int process_command_macros_r(nagios_macros *mac, char *raw_command, char **output, int options) {
+	if(mac && mac->command_ptr && mac->command_ptr->macro_tmpl)
+		return process_macro_template_r(mac, mac->command_ptr->macro_tmpl, output, options);
+
+	return process_macros_r(mac, raw_command, output, options);
+	}
+
+
+/*
+ * Expand the argv template of the command last passed through
+ * get_raw_command_line_r(). Arguments without macros are used as
+ * they are, and those with macros are expanded and split on their
+ * own, which is where they'd split in the expanded command line.
+ * If an expansion would need a shell, we give up and the worker
+ * parses the full command line instead. Commands marked as needing
+ * a shell get it here. The returned vector is a single allocation.
+ */
+char **get_command_argv_r(nagios_macros *mac, const char *command_line) {
+	char ***split, **args, **argv = NULL, **tmp, *exp;
+	command *cmd;
+	int argc, nargs = 0, i, j, n;
+
+	if(!mac || !(cmd = mac->command_ptr) || !command_line)
+		return NULL;
+
+	if(cmd->argv_shell) {
+		char *sh[] = { "/bin/sh", "-c", (char *)command_line };
+		return pack_argv(sh, 3);
+		}
+	if(!cmd->argv)
+		return NULL;
+
+	for(argc = 0; cmd->argv[argc]; argc++)
+		;
+	split = calloc(argc, sizeof(char **));
+	args = calloc(argc, sizeof(char *));
+	if(!split || !args)
+		goto out;
+
+	for(i = 0; i < argc; i++) {
+		if(!cmd->argv_tmpl || !cmd->argv_tmpl[i]) {
+			nargs++;
+			continue;
+			}
+		exp = NULL;
+		process_macro_template_r(mac, cmd->argv_tmpl[i], &exp, mac->command_options);
+		if(!exp)
+			goto out;
+		/* an argument that expands to nothing isn't there at all */
+		if(strspn(exp, CMD_SPACE_CHARS) == strlen(exp)) {
+			free(exp);
+			continue;
+			}
+		n = 0;
+		split[i] = calloc((strlen(exp) / 2) + 5, sizeof(char *));
+		if(!split[i] || exp[strlen(exp) - 1] == '\\' || runcmd_cmd2strv(exp, &n, split[i])) {
+			if(split[i] && n)
+				free(split[i][0]);
+			my_free(split[i]);
+			free(exp);
+			goto out;
+			}
+		free(exp);
+		nargs += n;
+		}
+
+	if(!nargs || !(tmp = realloc(args, nargs * sizeof(char *))))
+		goto out;
+	args = tmp;
+	for(i = 0, n = 0; i < argc; i++) {
+		if(!split[i]) {
+			if(!cmd->argv_tmpl || !cmd->argv_tmpl[i])
+				args[n++] = cmd->argv[i];
+			continue;
+			}
+		for(j = 0; split[i][j]; j++)
+			args[n++] = split[i][j];
+		}
+	/* VAR=value prefixes are handled by the worker's parser */
+	if(!strchr(args[0], '='))
+		argv = pack_argv(args, nargs);
+
+out:
+	for(i = 0; split && i < argc; i++) {
+		if(split[i]) {
+			free(split[i][0]);
+			free(split[i]);
+			}
+		}
+	free(split);
+	free(args);
+	return argv;
+	}
+
+
 
 /******************************************************************/
 /******************** ENVIRONMENT FUNCTIONS ***********************/
@@ -1738,6 +2063,7 @@ void handle_sigxfsz(int sig) {
 		host_perfdata_file,
 		service_perfdata_file,
 		object_cache_file,
+		binary_object_cache_file,
 		object_precache_file,
 		status_file,
 		retention_file,
@@ -3376,6 +3702,7 @@ void cleanup(void) {
 
 	/* free all allocated memory - including macros */
 	free_memory(get_global_macros());
+	stop_log_writer();
 	close_log_file();
 
 	return;
@@ -3393,6 +3720,7 @@ void free_memory(nagios_macros *mac) {
 	/* free event queue data */
 	squeue_destroy(nagios_squeue, SQUEUE_FREE_DATA);
 	nagios_squeue = NULL;
+	free_freshness_data();
 
 	/* free memory for global event handlers */
 	my_free(global_host_event_handler);
@@ -3406,6 +3734,7 @@ void free_memory(nagios_macros *mac) {
 	my_free(ochp_command);
 
 	my_free(object_cache_file);
+	my_free(binary_object_cache_file);
 	my_free(object_precache_file);
 
 	/*
@@ -3418,6 +3747,7 @@ void free_memory(nagios_macros *mac) {
 	 */
 	clear_volatile_macros_r(mac);
 
+	invalidate_macro_environment_cache();
 	free_macrox_names();
 
 	/* free illegal char strings */
@@ -3451,6 +3781,8 @@ void free_memory(nagios_macros *mac) {
 	my_free(config_file_dir);
 	my_free(nagios_binary_path);
 	my_free(status_file);
+	my_free(status_snapshot_file);
+	my_free(status_shm_file);
 	my_free(retention_file);
 
 	for (i = 0; i < MAX_USER_MACROS; i++) {
@@ -3507,6 +3839,7 @@ int reset_variables(void) {
 	my_free(debug_file);
 
 	my_free(object_cache_file);
+	my_free(binary_object_cache_file);
 	my_free(object_precache_file);
 
 	my_free(nagios_user);
@@ -24,6 +24,7 @@ struct wproc_job {
 	char *command;
 	void *arg;
 	struct wproc_worker *wp;
+	squeue_event *deadline; /* our slot in job_deadlines, or NULL */
 };
 
 struct wproc_list;
@@ -35,7 +36,12 @@ struct wproc_worker {
 	int max_jobs; /**< Max number of jobs the worker can handle */
 	int jobs_running; /**< jobs running */
 	int jobs_started; /**< jobs started */
+	int jobs_timedout; /**< jobs the worker had to kill for running too long */
+	int jobs_orphaned; /**< jobs we gave up on ever hearing back about */
 	int job_index; /**< round-robin slot allocator (this wraps) */
+	double ewma_runtime; /**< moving average of job runtime, in seconds */
+	int framing; /**< WORKER_FRAMING_TEXT or WORKER_FRAMING_BINARY */
+	int split_argv; /**< worker runs "arg" vectors in place of "command" */
 	iocache *ioc;  /**< iocache for reading from worker */
 	fanout_table *jobs; /**< array of jobs */
 	struct wproc_list *wp_list;
@@ -50,6 +56,13 @@ struct wproc_list {
 static struct wproc_list workers = {0, 0, NULL};
 
 static dkhash_table *specialized_workers;
+
+/*
+ * Every job that's been handed to a worker, keyed by when we give
+ * up on ever hearing back about it. Workers kill jobs that run past
+ * their timeout, so anything left here long after that was lost.
+ */
+static squeue_t *job_deadlines;
 static struct wproc_list *to_remove = NULL;
 
 typedef struct wproc_callback_job {
@@ -66,7 +79,16 @@ typedef struct wproc_object_job {
 unsigned int wproc_num_workers_online = 0, wproc_num_workers_desired = 0;
 unsigned int wproc_num_workers_spawned = 0;
 
-extern struct kvvec * macros_to_kvv(nagios_macros *);
+/* slack, on top of the job's timeout, before a job is considered orphaned */
+#define WPROC_ORPHAN_SLACK 600
+
+/* weight of the latest job's runtime in a worker's ewma_runtime */
+#define WPROC_EWMA_ALPHA 0.2
+
+static const char *dispatch_policy_names[] = {
+	"round-robin", "least-jobs", "power-of-two", "ewma-latency",
+};
+
 
 #define tv2float(tv) ((float)((tv)->tv_sec) + ((float)(tv)->tv_usec) / 1000000.0)
 
@@ -214,6 +236,74 @@ static struct wproc_list *get_wproc_list(const char *cmd)
 	return wp_list ? wp_list : &workers;
 }
 
+/*
+ * How long a new job on this worker can be expected to take to
+ * finish, in units that are only meaningful for comparing workers.
+ * Workers that haven't completed any jobs yet, such as ones that
+ * were just respawned, are taken to be as fast as the fastest one
+ * we've measured, so they get their share of jobs right away.
+ */
+static double worker_load(struct wproc_worker *wp, int use_latency, double fastest)
+{
+	double load = wp->jobs_running + 1;
+
+	if (use_latency)
+		load *= wp->ewma_runtime > 0.0 ? wp->ewma_runtime : fastest;
+	return load;
+}
+
+/*
+ * Scans all workers for the least loaded one. We start scanning at
+ * the round-robin index so ties don't all go to the first worker.
+ */
+static struct wproc_worker *get_least_loaded_worker(struct wproc_list *wp_list, int use_latency)
+{
+	struct wproc_worker *best = NULL, *wp;
+	double best_load = 0.0, fastest = 0.0, load;
+	unsigned int i, start = wp_list->idx++;
+
+	if (use_latency) {
+		for (i = 0; i < wp_list->len; i++) {
+			wp = wp_list->wps[i];
+			if (wp->ewma_runtime > 0.0 && (fastest == 0.0 || wp->ewma_runtime < fastest))
+				fastest = wp->ewma_runtime;
+		}
+		/* nothing measured yet, so it's down to the job count */
+		if (fastest == 0.0)
+			fastest = 1.0;
+	}
+
+	for (i = 0; i < wp_list->len; i++) {
+		wp = wp_list->wps[(start + i) % wp_list->len];
+		if (wp->jobs_running >= wp->max_jobs)
+			continue;
+		load = worker_load(wp, use_latency, fastest);
+		if (!best || load < best_load) {
+			best = wp;
+			best_load = load;
+		}
+	}
+
+	/* everyone is full, so let round-robin decide */
+	return best ? best : wp_list->wps[start % wp_list->len];
+}
+
+/* the "power of two choices": the less busy of two random workers */
+static struct wproc_worker *get_p2c_worker(struct wproc_list *wp_list)
+{
+	struct wproc_worker *a, *b;
+	unsigned int i;
+
+	if (wp_list->len < 2)
+		return wp_list->wps[0];
+
+	i = rand() % wp_list->len;
+	a = wp_list->wps[i];
+	b = wp_list->wps[(i + 1 + (rand() % (wp_list->len - 1))) % wp_list->len];
+
+	return b->jobs_running < a->jobs_running ? b : a;
+}
+
 static struct wproc_worker *get_worker(const char *cmd)
 {
 	struct wproc_list *wp_list;
@@ -241,6 +331,15 @@ static struct wproc_worker *get_worker(const char *cmd)
 		return NULL;
 	}
 
+	switch (worker_dispatch_policy) {
+	case WPDISPATCH_LEAST_JOBS:
+		return get_least_loaded_worker(wp_list, 0);
+	case WPDISPATCH_POWER_OF_TWO:
+		return get_p2c_worker(wp_list);
+	case WPDISPATCH_EWMA_LATENCY:
+		return get_least_loaded_worker(wp_list, 1);
+	}
+
 	return wp_list->wps[wp_list->idx++ % wp_list->len];
 }
 
@@ -294,11 +393,28 @@ static void run_job_callback(struct wproc_job *job, struct wproc_result *wpres,
 	cj->callback = NULL;
 }
 
+static void arm_job_deadline(struct wproc_job *job)
+{
+	time_t deadline = time(NULL) + job->timeout + check_reaper_interval + WPROC_ORPHAN_SLACK;
+
+	if (!job_deadlines && !(job_deadlines = squeue_create(1024)))
+		return;
+
+	if (job->deadline)
+		squeue_remove(job_deadlines, job->deadline);
+	job->deadline = squeue_add(job_deadlines, deadline, job);
+}
+
 static void destroy_job(struct wproc_job *job)
 {
 	if (!job)
 		return;
 
+	if (job->deadline) {
+		squeue_remove(job_deadlines, job->deadline);
+		job->deadline = NULL;
+	}
+
 	switch (job->type) {
 	case WPJOB_CHECK:
 		free_check_result(job->arg);
@@ -463,6 +579,12 @@ void free_worker_memory(int flags)
 	dkhash_walk_data(specialized_workers, remove_specialized);
 	dkhash_destroy(specialized_workers);
 	specialized_workers = NULL; /* Don't leave pointers to freed memory. */
+
+	/* jobs retained along with their workers still need their deadlines */
+	if (job_deadlines && !squeue_size(job_deadlines)) {
+		squeue_destroy(job_deadlines, 0);
+		job_deadlines = NULL;
+	}
 }
 
 static int str2timeval(char *str, struct timeval *tv)
@@ -530,6 +652,10 @@ static int parse_worker_result(wproc_result *wpres, struct kvvec *kvv)
 		key = kvv->kv[i].key;
 		value = kvv->kv[i].value;
 
+		/* workers may echo the split command back, but we have no use for it */
+		if (kvv->kv[i].key_len == 3 && !strcmp(key, "arg"))
+			continue;
+
 		k = wpres_get_key(key, kvv->kv[i].key_len);
 		if (!k) {
 			logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: Unrecognized result variable: (i=%d) %s=%s\n", i, key, value);
@@ -593,6 +719,12 @@ static void fo_reassign_wproc_job(void *job_)
 	job->wp = get_worker(job->command);
 	if (job->wp != NULL) {
 		job->id = get_job_id(job->wp);
+		if (fanout_add(job->wp->jobs, job->id, job) < 0) {
+			/* the orphan checks will clean up after it */
+			logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: Error: can't add job to %s in fo_reassign_wproc_job\n", job->wp->name);
+			job->wp = NULL;
+			return;
+		}
 		/* macros aren't used right now anyways */
 		wproc_run_job(job, NULL);
 	} else {
@@ -600,29 +732,40 @@ static void fo_reassign_wproc_job(void *job_)
 	}
 }
 
-static int handle_worker_result(int sd, int events, void *arg)
+/*
+ * reads whatever the worker has sent us and handles all complete
+ * messages. With io_uring, the broker has done the read and hands
+ * us 'data'. Otherwise it's NULL and we read straight into the
+ * iocache, so binary messages are parsed where they landed.
+ * Returns the number of bytes read, so 0 means the worker is gone
+ * and has been destroyed
+ */
+static int read_worker_results(struct wproc_worker *wp, char *data, int nread)
 {
 	wproc_object_job *oj = NULL;
 	char *buf, *error_reason = NULL;
 	unsigned long size;
 	int ret;
 	static struct kvvec kvv = KVVEC_INITIALIZER;
-	struct wproc_worker *wp = (struct wproc_worker *)arg;
 
-	if((ret = iocache_capacity(wp->ioc)) < 0) {
-		logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: iocache_capacity() is %d for worker %s.\n", ret, wp->name);
+	if (!data) {
+		nread = iocache_read(wp->ioc, wp->sd);
+		if (nread < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: iocache_read() from %s returned %d: %s\n",
+					  wp->name, nread, strerror(errno));
+			}
+			return nread;
+		}
+	} else if (nread < 0) {
+		/* the broker won't read from the socket again after this */
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: Failed to read from %s: %s\n",
+			  wp->name, strerror(-nread));
 	}
-
-	ret = iocache_read(wp->ioc, wp->sd);
-
-	if (ret < 0) {
-		logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: iocache_read() from %s returned %d: %s\n",
-			  wp->name, ret, strerror(errno));
-		return 0;
-	} else if (ret == 0) {
+	if (nread <= 0) {
 		logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: Socket to worker %s broken, removing", wp->name);
 		wproc_num_workers_online--;
-		iobroker_unregister(nagios_iobs, sd);
+		iobroker_unregister(nagios_iobs, wp->sd);
 		if (workers.len <= 0) {
 			/* there aren't global workers left, we can't run any more checks
 			 * we should try respawning a few of the standard ones
@@ -635,21 +778,49 @@ static int handle_worker_result(int sd, int events, void *arg)
 		wproc_destroy(wp, 0);
 		return 0;
 	}
-	while ((buf = worker_ioc2msg(wp->ioc, &size, 0))) {
+
+	/* results may straddle reads, so they're collected in the iocache */
+	if (data) {
+		while (iocache_capacity(wp->ioc) < (unsigned long)nread) {
+			if (iocache_grow(wp->ioc, iocache_size(wp->ioc)) < 0) {
+				logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: Failed to grow the iocache for %s. Dropping %d bytes\n",
+					  wp->name, nread);
+				return -1;
+			}
+		}
+		iocache_add(wp->ioc, data, nread);
+	}
+
+	for (;;) {
 		struct wproc_job *job;
 		wproc_result wpres;
 
-		/* log messages are handled first */
-		if (size > 5 && !memcmp(buf, "log=", 4)) {
-			logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: %s: %s\n", wp->name, buf + 4);
-			continue;
-		}
+		if (wp->framing == WORKER_FRAMING_BINARY) {
+			/* binary messages are parsed in place, straight from the iocache */
+			if (!(buf = worker_ioc2bmsg(wp->ioc, &size)))
+				break;
+			ret = bbuf2kvvec_prealloc(&kvv, buf, size, KVVEC_ASSIGN);
+			if (ret > 0 && kvv.kv[0].key_len == 3 && !strcmp(kvv.kv[0].key, "log")) {
+				logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: %s: %s\n", wp->name, kvv.kv[0].value);
+				continue;
+			}
+		} else {
+			if (!(buf = worker_ioc2msg(wp->ioc, &size, 0)))
+				break;
+
+			/* log messages are handled first */
+			if (size > 5 && !memcmp(buf, "log=", 4)) {
+				logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: %s: %s\n", wp->name, buf + 4);
+				continue;
+			}
 
-		/* for everything else we need to actually parse */
-		if (buf2kvvec_prealloc(&kvv, buf, size, '=', '\0', KVVEC_ASSIGN) <= 0) {
+			/* for everything else we need to actually parse */
+			ret = buf2kvvec_prealloc(&kvv, buf, size, '=', '\0', KVVEC_ASSIGN);
+		}
+		if (ret <= 0) {
 			logit(NSLOG_RUNTIME_ERROR, TRUE,
 				  "wproc: Failed to parse key/value vector from worker response with len %lu. First kv=%s",
-				  size, buf ? buf : "(NULL)");
+				  size, wp->framing == WORKER_FRAMING_BINARY ? "(binary)" : buf);
 			continue;
 		}
 
@@ -665,6 +836,14 @@ static int handle_worker_result(int sd, int events, void *arg)
 				  wpres.job_id, wp->name);
 			continue;
 		}
+
+		/* keep track of how fast this worker gets through its jobs */
+		if (wp->ewma_runtime > 0.0) {
+			wp->ewma_runtime = (WPROC_EWMA_ALPHA * tv_delta_f(&wpres.start, &wpres.stop)) +
+				((1.0 - WPROC_EWMA_ALPHA) * wp->ewma_runtime);
+		} else {
+			wp->ewma_runtime = tv_delta_f(&wpres.start, &wpres.stop);
+		}
 		if (wpres.type != job->type) {
 			logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: %s claims job %d is type %d, but we think it's type %d\n",
 				  wp->name, job->id, wpres.type, job->type);
@@ -681,6 +860,7 @@ static int handle_worker_result(int sd, int events, void *arg)
 			wpres.early_timeout = TRUE;
 		}
 		if (wpres.early_timeout) {
+			wp->jobs_timedout++;
 			asprintf(&error_reason, "timed out after %.2fs", tv_delta_f(&wpres.start, &wpres.stop));
 		}
 		else if (WIFSIGNALED(wpres.wait_status)) {
@@ -794,6 +974,31 @@ static int handle_worker_result(int sd, int events, void *arg)
 		destroy_job(job);
 	}
 
+	return nread;
+}
+
+/*
+ * Worker sockets are edge-triggered, so we must keep reading until
+ * there's nothing left or we won't be told about the rest
+ */
+static int handle_worker_result(int sd, int events, void *arg)
+{
+	int ret;
+
+	do {
+		ret = read_worker_results((struct wproc_worker *)arg, NULL, 0);
+	} while (ret > 0 || (ret < 0 && errno == EINTR));
+
+	return 0;
+}
+
+/*
+ * With io_uring, the broker does the reading for us, and keeps at
+ * it until there's nothing left
+ */
+static int handle_worker_read(int sd, char *buf, int len, void *arg)
+{
+	read_worker_results((struct wproc_worker *)arg, buf, len);
 	return 0;
 }
 
@@ -813,7 +1018,7 @@ int workers_alive(void)
 /* a service for registering workers */
 static int register_worker(int sd, char *buf, unsigned int len)
 {
-	int i, is_global = 1;
+	int i, is_global = 1, spawn = RUNCMD_SPAWN_FORK;
 	struct kvvec *info;
 	struct wproc_worker *worker;
 
@@ -833,8 +1038,14 @@ static int register_worker(int sd, char *buf, unsigned int len)
 	worker->sd = sd;
 	worker->ioc = iocache_create(1 * 1024 * 1024);
 
+	/* a copy of what the kernel read is only worth it if it saves the read() */
 	iobroker_unregister(nagios_iobs, sd);
-	iobroker_register(nagios_iobs, sd, worker, handle_worker_result);
+	if (iobroker_get_backend(nagios_iobs) == IOBROKER_BACKEND_URING)
+		iobroker_register_reader(nagios_iobs, sd, worker, handle_worker_read,
+		                         IOBROKER_EDGE_TRIGGERED | IOBROKER_PRIORITY);
+	else
+		iobroker_register_flags(nagios_iobs, sd, worker, handle_worker_result,
+		                        IOBROKER_EDGE_TRIGGERED | IOBROKER_PRIORITY);
 
 	for(i = 0; i < info->kv_pairs; i++) {
 		struct key_value *kv = &info->kv[i];
@@ -847,6 +1058,17 @@ static int register_worker(int sd, char *buf, unsigned int len)
 		else if (!strcmp(kv->key, "max_jobs")) {
 			worker->max_jobs = atoi(kv->value);
 		}
+		else if (!strcmp(kv->key, "framing")) {
+			if (use_binary_worker_framing && !strcmp(kv->value, "binary"))
+				worker->framing = WORKER_FRAMING_BINARY;
+		}
+		else if (!strcmp(kv->key, "argv")) {
+			worker->split_argv = !strcmp(kv->value, "yes");
+		}
+		else if (!strcmp(kv->key, "spawn")) {
+			if (worker_spawn_method == RUNCMD_SPAWN_POSIX && !strcmp(kv->value, "posix_spawn"))
+				spawn = RUNCMD_SPAWN_POSIX;
+		}
 		else if (!strcmp(kv->key, "plugin")) {
 			struct wproc_list *command_handlers;
 			is_global = 0;
@@ -885,7 +1107,14 @@ static int register_worker(int sd, char *buf, unsigned int len)
 	}
 	wproc_num_workers_online++;
 	kvvec_destroy(info, 0);
-	nsock_printf_nul(sd, "OK");
+	if (worker->framing == WORKER_FRAMING_BINARY && spawn == RUNCMD_SPAWN_POSIX)
+		nsock_printf_nul(sd, "OK framing=binary;spawn=posix_spawn");
+	else if (worker->framing == WORKER_FRAMING_BINARY)
+		nsock_printf_nul(sd, "OK framing=binary");
+	else if (spawn == RUNCMD_SPAWN_POSIX)
+		nsock_printf_nul(sd, "OK spawn=posix_spawn");
+	else
+		nsock_printf_nul(sd, "OK");
 
 	/* signal query handler to release its iocache for this one */
 	return QH_TAKEOVER;
@@ -899,6 +1128,9 @@ static int wproc_query_handler(int sd, char *buf, unsigned int len)
 		nsock_printf_nul(sd, "Control worker processes.\n"
 			"Valid commands:\n"
 			"  wpstats              Print general job information\n"
+			"  policy [<policy>]    Print or set the job dispatch policy\n"
+			"                       <policy> can be round-robin, least-jobs,\n"
+			"                       power-of-two or ewma-latency.\n"
 			"  register <options>   Register a new worker\n"
 			"                       <options> can be name, pid, max_jobs and/or plugin.\n"
 			"                       There can be many plugin args.");
@@ -918,12 +1150,29 @@ static int wproc_query_handler(int sd, char *buf, unsigned int len)
 
 		for (i = 0; i < workers.len; i++) {
 			struct wproc_worker *wp = workers.wps[i];
-			nsock_printf(sd, "name=%s;pid=%ld;jobs_running=%u;jobs_started=%u\n",
+			nsock_printf(sd, "name=%s;pid=%ld;jobs_running=%u;jobs_started=%u;jobs_timedout=%u;jobs_orphaned=%u;max_jobs=%d;ewma_runtime=%.3f\n",
 					wp->name, (long)wp->pid,
-					wp->jobs_running, wp->jobs_started);
+					wp->jobs_running, wp->jobs_started,
+					wp->jobs_timedout, wp->jobs_orphaned,
+					wp->max_jobs, wp->ewma_runtime);
 		}
 		return 0;
 	}
+	if (!strcmp(buf, "policy")) {
+		unsigned int i;
+
+		if (space) {
+			for (i = 0; i < ARRAY_SIZE(dispatch_policy_names); i++) {
+				if (!strcmp(rbuf, dispatch_policy_names[i]))
+					break;
+			}
+			if (i == ARRAY_SIZE(dispatch_policy_names))
+				return 400;
+			worker_dispatch_policy = i;
+		}
+		nsock_printf_nul(sd, "policy=%s", dispatch_policy_names[worker_dispatch_policy]);
+		return 0;
+	}
 
 	return 400;
 }
@@ -1004,6 +1253,26 @@ int init_workers(int desired_workers)
 	return 0;
 }
 
+/*
+ * The argv for the command the macros were last prepared for.
+ * Only its arguments with macros in them are expanded; the rest
+ * were split when the configuration was loaded. The macros are
+ * only good for this one job, so the command is forgotten here.
+ */
+static char **wproc_job_argv(struct wproc_job *job, nagios_macros *mac)
+{
+	char **argv = NULL;
+
+	if (!mac || !mac->command_ptr)
+		return NULL;
+
+	if (job->wp->split_argv)
+		argv = get_command_argv_r(mac, job->command);
+	mac->command_ptr = NULL;
+
+	return argv;
+}
+
 /*
  * Handles adding the command and macros to the kvvec,
  * as well as shipping the command off to a designated
@@ -1012,10 +1281,12 @@ int init_workers(int desired_workers)
 static int wproc_run_job(struct wproc_job *job, nagios_macros *mac)
 {
 	static struct kvvec * kvv;
+	static char *env_buf;
+	static unsigned long env_buf_size;
+	unsigned long env_len;
 	struct kvvec_buf *kvvb;
-	struct kvvec *env_kvvp = NULL;
-	struct kvvec_buf *env_kvvb = NULL;
 	struct wproc_worker *wp;
+	char **argv;
 	int ret, result = OK;
     ssize_t written = 0;
 
@@ -1032,23 +1303,46 @@ static int wproc_run_job(struct wproc_job *job, nagios_macros *mac)
 
 	kvvec_addkv(kvv, "job_id", (char *)mkstr("%d", job->id));
 	kvvec_addkv(kvv, "type", (char *)mkstr("%d", job->type));
-	kvvec_addkv(kvv, "command", job->command);
+
+	/* the split command replaces the command line, it doesn't accompany it */
+	if ((argv = wproc_job_argv(job, mac))) {
+		char **arg;
+		for (arg = argv; *arg; arg++)
+			kvvec_addkv(kvv, "arg", *arg);
+	}
+	else {
+		kvvec_addkv(kvv, "command", job->command);
+	}
 	kvvec_addkv(kvv, "timeout", (char *)mkstr("%u", job->timeout));
 
-	/* Add the macro environment variables */
+	/*
+	 * Add the macro environment variables. Binary workers get them
+	 * as a nested binary kvvec, others as "key=value" lines.
+	 */
 	if(mac) {
-		env_kvvp = macros_to_kvv(mac);
-		if(NULL != env_kvvp) {
-			env_kvvb = kvvec2buf(env_kvvp, '=', '\n', 0);
-			if(NULL != env_kvvb) {
-				kvvec_addkv_wlen(kvv, "env", strlen("env"), env_kvvb->buf,
-						env_kvvb->buflen);
-			}
-			kvvec_destroy(env_kvvp, KVVEC_FREE_KEYS);
-			my_free(env_kvvb->buf);
-			my_free(env_kvvb);
+		env_len = macros_to_env_buf(mac, wp->framing == WORKER_FRAMING_BINARY, &env_buf, &env_buf_size);
+		if(env_len)
+			kvvec_addkv_wlen(kvv, "env", strlen("env"), env_buf, env_len);
+	}
+
+	if (wp->framing == WORKER_FRAMING_BINARY) {
+		ret = worker_send_kvvec_framed(wp->sd, kvv, WORKER_FRAMING_BINARY);
+		if (ret < 0) {
+			logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: '%s' seems to be choked. ret = %d; errno = %d (%s)\n",
+				  wp->name, ret, errno, strerror(errno));
+			destroy_job(job);
+			result = ERROR;
+		} else {
+			wp->jobs_running++;
+			wp->jobs_started++;
+			loadctl.jobs_running++;
+			arm_job_deadline(job);
 		}
+		kvvec_destroy(kvv, 0);
+		free(argv);
+		return result;
 	}
+
 	kvvb = build_kvvec_buf(kvv);
 	/* ret = write(wp->sd, kvvb->buf, kvvb->bufsize); */
 	ret = nwrite(wp->sd, kvvb->buf, kvvb->bufsize, &written);
@@ -1061,6 +1355,7 @@ static int wproc_run_job(struct wproc_job *job, nagios_macros *mac)
 		wp->jobs_running++;
 		wp->jobs_started++;
 		loadctl.jobs_running++;
+		arm_job_deadline(job);
 	}
 
 	my_free(kvvb->buf);
@@ -1068,6 +1363,7 @@ static int wproc_run_job(struct wproc_job *job, nagios_macros *mac)
 
 	/* no key/value flags, they were not allocated */
 	kvvec_destroy(kvv, 0);
+	free(argv);
 
 	return result;
 }
@@ -1163,3 +1459,52 @@ int wproc_run_callback(char *cmd, int timeout,
 	job = create_job(WPJOB_CALLBACK, cj, timeout, cmd);
 	return wproc_run_job(job, mac);
 }
+
+/*
+ * Gives up on the jobs whose deadline has passed. Hosts and services
+ * get their orphaned checks rescheduled, and any result that turns up
+ * for a job after this is logged and ignored. Returns the number of
+ * jobs that were reaped
+ */
+int wproc_reap_orphaned_jobs(time_t now)
+{
+	struct wproc_job *job;
+	int reaped = 0;
+
+	while ((job = squeue_peek(job_deadlines)) != NULL) {
+		if (squeue_event_runtime(job->deadline)->tv_sec > now)
+			break;
+
+		squeue_pop(job_deadlines);
+		job->deadline = NULL;
+
+		if (job->type == WPJOB_CHECK) {
+			check_result *cr = (check_result *)job->arg;
+			service *svc;
+			host *hst;
+
+			/* with orphan checking disabled, the job is left to its fate */
+			if (cr->service_description) {
+				if (check_orphaned_services == FALSE)
+					continue;
+				if ((svc = find_service(cr->host_name, cr->service_description)) != NULL)
+					handle_orphaned_service_check(svc, now);
+			} else {
+				if (check_orphaned_hosts == FALSE)
+					continue;
+				if ((hst = find_host(cr->host_name)) != NULL)
+					handle_orphaned_host_check(hst, now);
+			}
+		} else {
+			logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: %s job %d on %s never came back. Giving up on it\n",
+			      wpjob_type_name(job->type), job->id, job->wp ? job->wp->name : "(no worker)");
+		}
+
+		if (job->wp)
+			job->wp->jobs_orphaned++;
+		destroy_job(job);
+		reaped++;
+	}
+
+	return reaped;
+}
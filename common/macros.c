@@ -97,6 +97,38 @@ static const struct macro_key_code *find_macro_key(const char *name) {
 	}
 
 
+/*
+ * URL-encode and/or clean a macro value the way the caller asked
+ * for. Returns the value to insert. *free_macro says whether the
+ * value we got must be free()'d on the way in, and whether the
+ * returned one must be on the way out.
+ */
+static char *finish_macro_value(char *value, int macro_options, int options, int *free_macro) {
+	char *ret;
+
+	/* URL encode the macro if requested - this allocates new memory */
+	if(options & URL_ENCODE_MACRO_CHARS) {
+		ret = get_url_encoded_string(value);
+		if(*free_macro == TRUE)
+			my_free(value);
+		value = ret;
+		*free_macro = TRUE;
+		}
+
+	/* some macros should sometimes be cleaned */
+	if(macro_options & options & (STRIP_ILLEGAL_MACRO_CHARS | ESCAPE_MACRO_CHARS)) {
+		/* empty values come back as a static "" */
+		ret = clean_macro_chars(value, options);
+		if(*free_macro == TRUE)
+			my_free(value);
+		*free_macro = *ret ? TRUE : FALSE;
+		return ret;
+		}
+
+	return value;
+	}
+
+
 /*
  * replace macros in notification commands with their values,
  * the thread-safe version
@@ -108,7 +140,6 @@ int process_macros_r(nagios_macros *mac, char *input_buffer, char **output_buffe
 	char *delim_ptr = NULL;
 	int in_macro = FALSE;
 	char *selected_macro = NULL;
-	char *original_macro = NULL;
 	int result = OK;
 	int free_macro = FALSE;
 	int macro_options = 0;
@@ -210,42 +241,11 @@ int process_macros_r(nagios_macros *mac, char *input_buffer, char **output_buffe
 
 				log_debug_info(DEBUGL_MACROS, 2, "  Processed '%s', Free: %d,  Cleaning options: %d\n", temp_buffer, free_macro, options);
 
-				/* URL encode the macro if requested - this allocates new memory */
-				if(options & URL_ENCODE_MACRO_CHARS) {
-					original_macro = selected_macro;
-					selected_macro = get_url_encoded_string(selected_macro);
-					if(free_macro == TRUE) {
-						my_free(original_macro);
-					}
-					free_macro = TRUE;
-				}
-
-				/* some macros should sometimes be cleaned */
-				if(macro_options & options & (STRIP_ILLEGAL_MACRO_CHARS | ESCAPE_MACRO_CHARS)) {
-
-					char *cleaned_macro = NULL;
-
-					/* add the (cleaned) processed macro to the end of the already processed buffer */
-					if(selected_macro != NULL && (cleaned_macro = clean_macro_chars(selected_macro, options)) != NULL) {
-						*output_buffer = (char *)realloc(*output_buffer, strlen(*output_buffer) + strlen(cleaned_macro) + 1);
-						strcat(*output_buffer, cleaned_macro);
-						if(*cleaned_macro) {
-							my_free(cleaned_macro);
-						}
-
-						log_debug_info(DEBUGL_MACROS, 2, "  Cleaned macro.  Running output (%lu): '%s'\n", (unsigned long)strlen(*output_buffer), *output_buffer);
-					}
-				}
-
-				/* others are not cleaned */
-				else {
-					/* add the processed macro to the end of the already processed buffer */
-					if(selected_macro != NULL) {
-						*output_buffer = (char *)realloc(*output_buffer, strlen(*output_buffer) + strlen(selected_macro) + 1);
-						strcat(*output_buffer, selected_macro);
-
-						log_debug_info(DEBUGL_MACROS, 2, "  Uncleaned macro.  Running output (%lu): '%s'\n", (unsigned long)strlen(*output_buffer), *output_buffer);
-					}
+				/* add the (possibly encoded and cleaned) macro to the end of the already processed buffer */
+				selected_macro = finish_macro_value(selected_macro, macro_options, options, &free_macro);
+				if(selected_macro != NULL) {
+					*output_buffer = (char *)realloc(*output_buffer, strlen(*output_buffer) + strlen(selected_macro) + 1);
+					strcat(*output_buffer, selected_macro);
 				}
 
 				/* free memory if necessary (if we URL encoded the macro or we were told to do so by grab_macro_value()) */
@@ -273,6 +273,231 @@ int process_macros(char *input_buffer, char **output_buffer, int options) {
 	return process_macros_r(&global_macros, input_buffer, output_buffer, options);
 	}
 
+
+/*
+ * Compiled macro templates
+ *
+ * process_macros_r() has to split its input and look up every macro
+ * by name each time it's called. For strings we expand over and over
+ * (command lines, perfdata templates) we do that once and keep a list
+ * of literal and macro segments instead, so expanding them is just a
+ * matter of fetching the values and copying everything into a buffer
+ * that's sized up front. The output is identical to what
+ * process_macros_r() would produce.
+ */
+#define MTPL_LITERAL 0 /* plain text */
+#define MTPL_BAD     1 /* never a valid macro, printed as-is */
+#define MTPL_ARGV    2 /* $ARGn$, code is n - 1 */
+#define MTPL_USER    3 /* $USERn$, code is n - 1 */
+#define MTPL_X       4 /* regular $MACRO$, code is its MACRO_* index */
+#define MTPL_OTHER   5 /* anything else, looked up by name */
+
+struct macro_segment {
+	int type;
+	int code;
+	int options; /* cleaning options for MTPL_X macros */
+	int stray; /* no closing '$' */
+	char *str; /* text or macro name */
+	size_t len;
+	};
+
+struct macro_template {
+	size_t size_hint; /* initial output buffer size */
+	int segments;
+	struct macro_segment seg[1];
+	};
+
+struct macro_template *compile_macro_template(const char *input) {
+	struct macro_template *tmpl;
+	const struct macro_key_code *mkey;
+	char *buf, *p, *chunk;
+	int in_macro = FALSE, nsegs = 1, x;
+	size_t len;
+
+	if(input == NULL)
+		return NULL;
+
+	for(len = 0; input[len]; len++) {
+		if(input[len] == '$')
+			nsegs++;
+		}
+
+	/* segments and a copy of the input split on '$', all in one go */
+	tmpl = calloc(1, sizeof(*tmpl) + nsegs * sizeof(struct macro_segment) + len + 1);
+	if(tmpl == NULL)
+		return NULL;
+	buf = (char *)&tmpl->seg[nsegs + 1];
+	memcpy(buf, input, len + 1);
+
+	for(p = buf; p != NULL; in_macro = !in_macro) {
+		struct macro_segment *seg = &tmpl->seg[tmpl->segments];
+
+		chunk = p;
+		if((p = strchr(p, '$')) != NULL)
+			*p++ = 0;
+
+		seg->str = chunk;
+		seg->len = strlen(chunk);
+		seg->stray = p == NULL;
+
+		if(in_macro == FALSE) {
+			if(seg->len)
+				tmpl->segments++;
+			continue;
+			}
+
+		tmpl->segments++;
+
+		/* "$$" is an escaped $, and so is a trailing one */
+		if(!*chunk) {
+			seg->str = "$";
+			seg->len = 1;
+			}
+
+		/* same lookup order as grab_macro_value_r() */
+		else if(!strncmp(chunk, "ARG", 3)) {
+			x = atoi(chunk + 3);
+			seg->type = (x <= 0 || x > MAX_COMMAND_ARGUMENTS) ? MTPL_BAD : MTPL_ARGV;
+			seg->code = x - 1;
+			}
+		else if(!strncmp(chunk, "USER", 4)) {
+			x = atoi(chunk + 4);
+			seg->type = (x <= 0 || x > MAX_USER_MACROS) ? MTPL_BAD : MTPL_USER;
+			seg->code = x - 1;
+			}
+		else if(!strchr(chunk, ':') && (mkey = find_macro_key(chunk))) {
+			seg->type = MTPL_X;
+			seg->code = mkey->code;
+			seg->options = mkey->options;
+			}
+		else
+			seg->type = MTPL_OTHER;
+		}
+
+	/* room for the text and a modest value for each macro */
+	tmpl->size_hint = len + 1 + 32 * (nsegs / 2);
+
+	return tmpl;
+	}
+
+
+/*
+ * make room for len more bytes (and a nul) in a template's output
+ * buffer. On errors, the buffer is released and *out is NULL
+ */
+static int grow_template_output(char **out, size_t *size, size_t used, size_t len) {
+	char *p;
+
+	if(used + len < *size)
+		return OK;
+	while(used + len >= *size)
+		*size *= 2;
+	if((p = realloc(*out, *size)) == NULL) {
+		my_free(*out);
+		return ERROR;
+		}
+	*out = p;
+	return OK;
+	}
+
+
+int process_macro_template_r(nagios_macros *mac, const struct macro_template *tmpl, char **output_buffer, int options) {
+	size_t size, used = 0;
+	char *out;
+	int i;
+
+	if(output_buffer == NULL)
+		return ERROR;
+
+	/*
+	 * values are copied as soon as we've fetched them, since some
+	 * of them point to buffers the next lookup may replace
+	 */
+	size = tmpl ? tmpl->size_hint : 1;
+	if(tmpl == NULL || (out = malloc(size)) == NULL) {
+		*output_buffer = strdup("");
+		return ERROR;
+		}
+
+	for(i = 0; i < tmpl->segments && out; i++) {
+		const struct macro_segment *seg = &tmpl->seg[i];
+		char *value = NULL;
+		int free_macro = FALSE, macro_options = 0, result = OK;
+		size_t len;
+
+		switch(seg->type) {
+		case MTPL_LITERAL:
+			if(grow_template_output(&out, &size, used, seg->len) == OK) {
+				memcpy(out + used, seg->str, seg->len);
+				used += seg->len;
+				}
+			continue;
+		case MTPL_BAD:
+			result = ERROR;
+			break;
+		case MTPL_ARGV:
+			value = mac->argv[seg->code];
+			break;
+		case MTPL_USER:
+			value = macro_user[seg->code];
+			break;
+		case MTPL_X:
+			/* grab_macro_value_r() shortcuts this one, uncleaned */
+			if(seg->code == MACRO_HOSTADDRESS && mac->host_ptr) {
+				value = mac->host_ptr->address;
+				break;
+				}
+			result = grab_macrox_value_r(mac, seg->code, NULL, NULL, &value, &free_macro);
+			macro_options = seg->options;
+			break;
+		default:
+			result = grab_macro_value_r(mac, seg->str, &value, &macro_options, &free_macro);
+			break;
+			}
+
+		/* not a macro after all. Print it the way we found it */
+		if(result != OK) {
+			if(free_macro == TRUE)
+				my_free(value);
+			if(grow_template_output(&out, &size, used, seg->len + 2) == OK) {
+				out[used++] = '$';
+				memcpy(out + used, seg->str, seg->len);
+				used += seg->len;
+				if(!seg->stray)
+					out[used++] = '$';
+				}
+			continue;
+			}
+
+		if(value == NULL)
+			continue;
+
+		value = finish_macro_value(value, macro_options, options, &free_macro);
+		if(value != NULL) {
+			len = strlen(value);
+			if(grow_template_output(&out, &size, used, len) == OK) {
+				memcpy(out + used, value, len);
+				used += len;
+				}
+			if(free_macro == TRUE)
+				my_free(value);
+			}
+		}
+
+	if(out == NULL) {
+		*output_buffer = strdup("");
+		return ERROR;
+		}
+
+	out[used] = 0;
+	*output_buffer = out;
+
+	log_debug_info(DEBUGL_MACROS, 1, "Expanded macro template: '%s'\n", out);
+
+	return OK;
+	}
+
+
 /******************************************************************/
 /********************** MACRO GRAB FUNCTIONS **********************/
 /******************************************************************/
@@ -2944,6 +3169,8 @@ int clear_volatile_macros_r(nagios_macros *mac) {
 	/* clear ARGx macros */
 	clear_argv_macros_r(mac);
 
+	mac->command_ptr = NULL;
+
 	return OK;
 	}
 
@@ -3294,7 +3521,7 @@ int set_macro_environment_var(char *name, char *value, int set) {
 	return OK;
 	}
 
-static int add_macrox_environment_vars_r(nagios_macros *, struct kvvec *);
+static int add_macrox_environment_vars_r(nagios_macros *, struct kvvec *, int);
 static int add_argv_macro_environment_vars_r(nagios_macros *, struct kvvec *);
 static int add_custom_macro_environment_vars_r(nagios_macros *, struct kvvec *);
 static int add_contact_address_environment_vars_r(nagios_macros *,
@@ -3314,7 +3541,7 @@ struct kvvec * macros_to_kvv(nagios_macros *mac) {
 	if((kvvp = calloc(1, sizeof(struct kvvec))) == NULL) return NULL;
 	if(!kvvec_init(kvvp, MACRO_X_COUNT + MAX_COMMAND_ARGUMENTS + MAX_CONTACT_ADDRESSES + 4)) return NULL;
 
-	add_macrox_environment_vars_r(mac, kvvp);
+	add_macrox_environment_vars_r(mac, kvvp, FALSE);
 	add_argv_macro_environment_vars_r(mac, kvvp);
 	add_custom_macro_environment_vars_r(mac, kvvp);
 	add_contact_address_environment_vars_r(mac, kvvp);
@@ -3322,8 +3549,127 @@ struct kvvec * macros_to_kvv(nagios_macros *mac) {
 	return kvvp;
 	}
 
+/*
+ * Environment macros that only depend on the configuration of a single
+ * object (or on nothing at all) are serialized once per object and
+ * cached, see macros_to_env_buf().
+ */
+#define MACRO_ENV_VOLATILE     0
+#define MACRO_ENV_GLOBAL       1
+#define MACRO_ENV_HOST         2
+#define MACRO_ENV_HOSTGROUP    3
+#define MACRO_ENV_SERVICE      4
+#define MACRO_ENV_SERVICEGROUP 5
+#define MACRO_ENV_CONTACT      6
+#define MACRO_ENV_CONTACTGROUP 7
+#define MACRO_ENV_SCOPES       8
+
+static const struct {
+	int macro;
+	int scope;
+} macrox_env_static[] = {
+	{ MACRO_ADMINEMAIL, MACRO_ENV_GLOBAL },
+	{ MACRO_ADMINPAGER, MACRO_ENV_GLOBAL },
+	{ MACRO_MAINCONFIGFILE, MACRO_ENV_GLOBAL },
+	{ MACRO_STATUSDATAFILE, MACRO_ENV_GLOBAL },
+	{ MACRO_RETENTIONDATAFILE, MACRO_ENV_GLOBAL },
+	{ MACRO_OBJECTCACHEFILE, MACRO_ENV_GLOBAL },
+	{ MACRO_TEMPFILE, MACRO_ENV_GLOBAL },
+	{ MACRO_LOGFILE, MACRO_ENV_GLOBAL },
+	{ MACRO_RESOURCEFILE, MACRO_ENV_GLOBAL },
+	{ MACRO_COMMANDFILE, MACRO_ENV_GLOBAL },
+	{ MACRO_HOSTPERFDATAFILE, MACRO_ENV_GLOBAL },
+	{ MACRO_SERVICEPERFDATAFILE, MACRO_ENV_GLOBAL },
+	{ MACRO_PROCESSSTARTTIME, MACRO_ENV_GLOBAL },
+	{ MACRO_TEMPPATH, MACRO_ENV_GLOBAL },
+	{ MACRO_EVENTSTARTTIME, MACRO_ENV_GLOBAL },
+	{ MACRO_HOSTNAME, MACRO_ENV_HOST },
+	{ MACRO_HOSTALIAS, MACRO_ENV_HOST },
+	{ MACRO_HOSTADDRESS, MACRO_ENV_HOST },
+	{ MACRO_HOSTDISPLAYNAME, MACRO_ENV_HOST },
+	{ MACRO_HOSTACTIONURL, MACRO_ENV_HOST },
+	{ MACRO_HOSTNOTESURL, MACRO_ENV_HOST },
+	{ MACRO_HOSTNOTES, MACRO_ENV_HOST },
+	{ MACRO_HOSTINFOURL, MACRO_ENV_HOST },
+	{ MACRO_HOSTCHECKCOMMAND, MACRO_ENV_HOST },
+	{ MACRO_HOSTGROUPNAMES, MACRO_ENV_HOST },
+	{ MACRO_MAXHOSTATTEMPTS, MACRO_ENV_HOST },
+	{ MACRO_HOSTIMPORTANCE, MACRO_ENV_HOST },
+	{ MACRO_HOSTANDSERVICESIMPORTANCE, MACRO_ENV_HOST },
+	{ MACRO_HOSTNOTIFICATIONPERIOD, MACRO_ENV_HOST },
+	{ MACRO_HOSTGROUPNAME, MACRO_ENV_HOSTGROUP },
+	{ MACRO_HOSTGROUPALIAS, MACRO_ENV_HOSTGROUP },
+	{ MACRO_HOSTGROUPNOTES, MACRO_ENV_HOSTGROUP },
+	{ MACRO_HOSTGROUPNOTESURL, MACRO_ENV_HOSTGROUP },
+	{ MACRO_HOSTGROUPACTIONURL, MACRO_ENV_HOSTGROUP },
+	{ MACRO_HOSTGROUPMEMBERS, MACRO_ENV_HOSTGROUP },
+	{ MACRO_HOSTGROUPMEMBERADDRESSES, MACRO_ENV_HOSTGROUP },
+	{ MACRO_SERVICEDESC, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICEDISPLAYNAME, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICEACTIONURL, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICENOTESURL, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICENOTES, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICEINFOURL, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICECHECKCOMMAND, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICEGROUPNAMES, MACRO_ENV_SERVICE },
+	{ MACRO_MAXSERVICEATTEMPTS, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICEISVOLATILE, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICEIMPORTANCE, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICENOTIFICATIONPERIOD, MACRO_ENV_SERVICE },
+	{ MACRO_SERVICEGROUPNAME, MACRO_ENV_SERVICEGROUP },
+	{ MACRO_SERVICEGROUPALIAS, MACRO_ENV_SERVICEGROUP },
+	{ MACRO_SERVICEGROUPNOTES, MACRO_ENV_SERVICEGROUP },
+	{ MACRO_SERVICEGROUPNOTESURL, MACRO_ENV_SERVICEGROUP },
+	{ MACRO_SERVICEGROUPACTIONURL, MACRO_ENV_SERVICEGROUP },
+	{ MACRO_SERVICEGROUPMEMBERS, MACRO_ENV_SERVICEGROUP },
+	{ MACRO_CONTACTNAME, MACRO_ENV_CONTACT },
+	{ MACRO_CONTACTALIAS, MACRO_ENV_CONTACT },
+	{ MACRO_CONTACTEMAIL, MACRO_ENV_CONTACT },
+	{ MACRO_CONTACTPAGER, MACRO_ENV_CONTACT },
+	{ MACRO_CONTACTGROUPNAMES, MACRO_ENV_CONTACT },
+	{ MACRO_CONTACTGROUPNAME, MACRO_ENV_CONTACTGROUP },
+	{ MACRO_CONTACTGROUPALIAS, MACRO_ENV_CONTACTGROUP },
+	{ MACRO_CONTACTGROUPMEMBERS, MACRO_ENV_CONTACTGROUP },
+	};
+
+static unsigned char macrox_env_scope[MACRO_X_COUNT];
+static int macrox_env_scope_initialized = FALSE;
+
+static void init_macrox_env_scope(void)
+{
+	unsigned int i;
+
+	if(macrox_env_scope_initialized == TRUE)
+		return;
+
+	for(i = 0; i < sizeof(macrox_env_static) / sizeof(macrox_env_static[0]); i++)
+		macrox_env_scope[macrox_env_static[i].macro] = macrox_env_static[i].scope;
+	macrox_env_scope_initialized = TRUE;
+	}
+
+/* large installations don't get all macros */
+static int skip_macrox_environment_var(int x)
+{
+	if(use_large_installation_tweaks == FALSE)
+		return FALSE;
+
+	/*
+	 * member macros tend to overflow the
+	 * environment on large installations
+	 */
+	if(x == MACRO_SERVICEGROUPMEMBERS || x == MACRO_HOSTGROUPMEMBERS ||
+		x == MACRO_HOSTGROUPMEMBERADDRESSES)
+		return TRUE;
+
+	/* summary macros are CPU intensive to compute */
+	if(x >= MACRO_TOTALHOSTSUP && x <= MACRO_TOTALSERVICEPROBLEMSUNHANDLED)
+		return TRUE;
+
+	return FALSE;
+	}
+
 /* adds macrox environment variables */
-static int add_macrox_environment_vars_r(nagios_macros *mac, struct kvvec *kvvp)
+static int add_macrox_environment_vars_r(nagios_macros *mac, struct kvvec *kvvp, int volatile_only)
 {
 	/*register*/ int x = 0;
 	int free_macro = FALSE;
@@ -3338,20 +3684,12 @@ static int add_macrox_environment_vars_r(nagios_macros *mac, struct kvvec *kvvp)
 				MACRO_X_COUNT);
 		free_macro = FALSE;
 
-		/* large installations don't get all macros */
-		if(use_large_installation_tweaks == TRUE) {
-			/*
-			 * member macros tend to overflow the
-			 * environment on large installations
-			 */
-			if(x == MACRO_SERVICEGROUPMEMBERS || x == MACRO_HOSTGROUPMEMBERS ||
-				x == MACRO_HOSTGROUPMEMBERADDRESSES)
-				continue;
+		if(skip_macrox_environment_var(x) == TRUE)
+			continue;
 
-			/* summary macros are CPU intensive to compute */
-			if(x >= MACRO_TOTALHOSTSUP && x <= MACRO_TOTALSERVICEPROBLEMSUNHANDLED)
-				continue;
-			}
+		/* the cached environment blocks already have these */
+		if(volatile_only == TRUE && macrox_env_scope[x] != MACRO_ENV_VOLATILE)
+			continue;
 
 		/* generate the macro value if it hasn't already been done */
 		/* THIS IS EXPENSIVE */
@@ -3541,4 +3879,332 @@ static int add_contact_address_environment_vars_r(nagios_macros *mac,
 	return OK;
 	}
 
+
+/*
+ * A run of serialized environment variables. Both formats are kept
+ * since they're built on demand, but in practice only the one the
+ * workers speak will ever be used.
+ */
+struct macro_env_block {
+	char *buf[2];
+	unsigned long len[2];
+	int built[2];
+	};
+
+/* one block per object, plus one for "no such object", indexed by id */
+static struct macro_env_block *macro_env_cache[MACRO_ENV_SCOPES];
+static unsigned int macro_env_cache_slots[MACRO_ENV_SCOPES];
+
+/*
+ * Adaptive commands are rare enough that we can simply drop all the
+ * blocks when an object changes and rebuild them as they're needed.
+ */
+void invalidate_macro_environment_cache(void) {
+	unsigned int i;
+	int scope;
+
+	for(scope = 0; scope < MACRO_ENV_SCOPES; scope++) {
+		if(macro_env_cache[scope] == NULL)
+			continue;
+		for(i = 0; i < macro_env_cache_slots[scope]; i++) {
+			my_free(macro_env_cache[scope][i].buf[0]);
+			my_free(macro_env_cache[scope][i].buf[1]);
+			}
+		my_free(macro_env_cache[scope]);
+		macro_env_cache_slots[scope] = 0;
+		}
+	}
+
+/* get the object a scope refers to, along with its cache slot */
+static void *macro_env_object(nagios_macros *mac, int scope, unsigned int *slot, unsigned int *slots) {
+	void *obj = NULL;
+	unsigned int count = 0, id = 0;
+
+	switch(scope) {
+		case MACRO_ENV_HOST:
+			count = num_objects.hosts;
+			if((obj = mac->host_ptr))
+				id = mac->host_ptr->id;
+			break;
+		case MACRO_ENV_HOSTGROUP:
+			count = num_objects.hostgroups;
+			if((obj = mac->hostgroup_ptr))
+				id = mac->hostgroup_ptr->id;
+			break;
+		case MACRO_ENV_SERVICE:
+			count = num_objects.services;
+			if((obj = mac->service_ptr))
+				id = mac->service_ptr->id;
+			break;
+		case MACRO_ENV_SERVICEGROUP:
+			count = num_objects.servicegroups;
+			if((obj = mac->servicegroup_ptr))
+				id = mac->servicegroup_ptr->id;
+			break;
+		case MACRO_ENV_CONTACT:
+			count = num_objects.contacts;
+			if((obj = mac->contact_ptr))
+				id = mac->contact_ptr->id;
+			break;
+		case MACRO_ENV_CONTACTGROUP:
+			count = num_objects.contactgroups;
+			if((obj = mac->contactgroup_ptr))
+				id = mac->contactgroup_ptr->id;
+			break;
+		default:
+			break;
+		}
+
+	/* objects we can't find a slot for simply aren't cached */
+	*slot = obj ? (id < count ? id : count + 1) : count;
+	*slots = count + 1;
+	return obj;
+	}
+
+static int has_macros(const char *str) {
+	return str && strchr(str, '$') ? TRUE : FALSE;
+	}
+
+/*
+ * Notes and urls are run through the macro processor, so when they
+ * have macros in them their values depend on more than the object
+ * they belong to and can't be cached.
+ */
+static int macro_env_cacheable(int scope, void *obj) {
+	host *temp_host = obj;
+	hostgroup *temp_hostgroup = obj;
+	service *temp_service = obj;
+	servicegroup *temp_servicegroup = obj;
+
+	if(obj == NULL)
+		return TRUE;
+
+	switch(scope) {
+		case MACRO_ENV_HOST:
+			return !(has_macros(temp_host->notes) || has_macros(temp_host->notes_url) || has_macros(temp_host->action_url));
+		case MACRO_ENV_HOSTGROUP:
+			return !(has_macros(temp_hostgroup->notes) || has_macros(temp_hostgroup->notes_url) || has_macros(temp_hostgroup->action_url));
+		case MACRO_ENV_SERVICE:
+			return !(has_macros(temp_service->notes) || has_macros(temp_service->notes_url) || has_macros(temp_service->action_url));
+		case MACRO_ENV_SERVICEGROUP:
+			return !(has_macros(temp_servicegroup->notes) || has_macros(temp_servicegroup->notes_url) || has_macros(temp_servicegroup->action_url));
+		default:
+			break;
+		}
+
+	return TRUE;
+	}
+
+/*
+ * serializes the environment variables of a single scope/object. Blocks
+ * that won't be cached are built with the job's macros, so notes and
+ * urls can refer to anything the job can.
+ */
+static int build_macro_env_block(nagios_macros *job_mac, int scope, void *obj, int binary, char **buf, unsigned long *len) {
+	nagios_macros mac, *grab_mac = job_mac ? job_mac : &mac;
+	struct kvvec *kvvp;
+	struct kvvec_buf *kvvb;
+	customvariablesmember *temp_customvariablesmember = NULL;
+	const char *custom_prefix = NULL;
+	char *envname, *value;
+	int x, free_macro;
+
+	*buf = NULL;
+	*len = 0;
+
+	/* only the object we're caching the block for is visible */
+	memset(&mac, 0, sizeof(mac));
+	switch(scope) {
+		case MACRO_ENV_HOST:
+			if((mac.host_ptr = obj))
+				temp_customvariablesmember = mac.host_ptr->custom_variables;
+			custom_prefix = "_HOST";
+			break;
+		case MACRO_ENV_HOSTGROUP:
+			mac.hostgroup_ptr = obj;
+			break;
+		case MACRO_ENV_SERVICE:
+			if((mac.service_ptr = obj))
+				temp_customvariablesmember = mac.service_ptr->custom_variables;
+			custom_prefix = "_SERVICE";
+			break;
+		case MACRO_ENV_SERVICEGROUP:
+			mac.servicegroup_ptr = obj;
+			break;
+		case MACRO_ENV_CONTACT:
+			if((mac.contact_ptr = obj))
+				temp_customvariablesmember = mac.contact_ptr->custom_variables;
+			custom_prefix = "_CONTACT";
+			break;
+		case MACRO_ENV_CONTACTGROUP:
+			mac.contactgroup_ptr = obj;
+			break;
+		default:
+			break;
+		}
+
+	if((kvvp = kvvec_create(32)) == NULL)
+		return ERROR;
+
+	/* values are copied right away since mkstr() ones don't last */
+	for(x = 0; x < MACRO_X_COUNT; x++) {
+		if(macrox_env_scope[x] != scope || skip_macrox_environment_var(x) == TRUE)
+			continue;
+		value = NULL;
+		free_macro = FALSE;
+		grab_macrox_value_r(grab_mac, x, NULL, NULL, &value, &free_macro);
+		asprintf(&envname, "%s%s", MACRO_ENV_VAR_PREFIX, macro_x_names[x]);
+		kvvec_addkv(kvvp, envname, value ? strdup(value) : NULL);
+		if(free_macro == TRUE)
+			my_free(value);
+		}
+
+	for(; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
+		if(temp_customvariablesmember->variable_value == NULL || !*temp_customvariablesmember->variable_value)
+			continue;
+		value = clean_macro_chars(temp_customvariablesmember->variable_value,
+				STRIP_ILLEGAL_MACRO_CHARS | ESCAPE_MACRO_CHARS);
+		if(!*value) {
+			my_free(value);
+			continue;
+			}
+		asprintf(&envname, "%s%s%s", MACRO_ENV_VAR_PREFIX, custom_prefix,
+				temp_customvariablesmember->variable_name);
+		kvvec_addkv(kvvp, envname, value);
+		}
+
+	/* contact name, alias, email and pager are in the block already */
+	if(mac.contact_ptr) {
+		for(x = 0; x < MAX_CONTACT_ADDRESSES; x++) {
+			value = mac.contact_ptr->address[x];
+			asprintf(&envname, "%sCONTACTADDRESS%d", MACRO_ENV_VAR_PREFIX, x);
+			kvvec_addkv(kvvp, envname, value ? strdup(value) : NULL);
+			}
+		}
+
+	if(binary) {
+		*len = kvvec_bbuf_len(kvvp);
+		if((*buf = malloc(*len + 1)) == NULL)
+			*len = 0;
+		else
+			kvvec2bbuf(kvvp, *buf, *len);
+		}
+	else if(kvvp->kv_pairs && (kvvb = kvvec2buf(kvvp, '=', '\n', 0))) {
+		*buf = kvvb->buf;
+		*len = kvvb->buflen;
+		free(kvvb);
+		}
+
+	kvvec_destroy(kvvp, KVVEC_FREE_ALL);
+	return OK;
+	}
+
+/* makes room for another need bytes at the end of the environment */
+static int reserve_env_buf(char **buf, unsigned long *bufsize, unsigned long len, unsigned long need) {
+	unsigned long size;
+	char *new_buf;
+
+	if(len + need <= *bufsize)
+		return OK;
+
+	for(size = *bufsize ? *bufsize : 4096; size < len + need; size *= 2)
+		;
+	if((new_buf = realloc(*buf, size)) == NULL)
+		return ERROR;
+	*buf = new_buf;
+	*bufsize = size;
+	return OK;
+	}
+
+static int append_env_buf(char **buf, unsigned long *bufsize, unsigned long *len, const char *data, unsigned long data_len) {
+	if(!data_len)
+		return OK;
+	if(reserve_env_buf(buf, bufsize, *len, data_len) != OK)
+		return ERROR;
+	memcpy(*buf + *len, data, data_len);
+	*len += data_len;
+	return OK;
+	}
+
+/* returns the cached block for an object, building it if necessary */
+static struct macro_env_block *get_macro_env_block(int scope, void *obj, unsigned int slot, unsigned int slots, int binary) {
+	struct macro_env_block *blk;
+
+	if(macro_env_cacheable(scope, obj) == FALSE)
+		return NULL;
+
+	if(macro_env_cache[scope] == NULL) {
+		if((macro_env_cache[scope] = calloc(slots, sizeof(struct macro_env_block))) == NULL)
+			return NULL;
+		macro_env_cache_slots[scope] = slots;
+		}
+	if(slot >= macro_env_cache_slots[scope])
+		return NULL;
+
+	blk = &macro_env_cache[scope][slot];
+	if(blk->built[binary] == FALSE) {
+		if(build_macro_env_block(NULL, scope, obj, binary, &blk->buf[binary], &blk->len[binary]) != OK)
+			return NULL;
+		blk->built[binary] = TRUE;
+		}
+
+	return blk;
+	}
+
+unsigned long macros_to_env_buf(nagios_macros *mac, int binary, char **buf, unsigned long *bufsize) {
+	struct macro_env_block *blk;
+	struct kvvec *kvvp;
+	struct kvvec_buf *kvvb;
+	unsigned long len = 0, block_len;
+	unsigned int slot, slots;
+	char *block;
+	void *obj;
+	int scope, result = OK;
+
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "macros_to_env_buf()\n");
+
+	if(enable_environment_macros == FALSE || mac == NULL)
+		return 0;
+
+	binary = binary ? 1 : 0;
+	init_macrox_env_scope();
+
+	/* the parts that only change with the configuration come first */
+	for(scope = MACRO_ENV_GLOBAL; scope < MACRO_ENV_SCOPES && result == OK; scope++) {
+		obj = macro_env_object(mac, scope, &slot, &slots);
+		if((blk = get_macro_env_block(scope, obj, slot, slots, binary))) {
+			result = append_env_buf(buf, bufsize, &len, blk->buf[binary], blk->len[binary]);
+			continue;
+			}
+
+		/* uncacheable, so build it, use it and lose it */
+		if(build_macro_env_block(mac, scope, obj, binary, &block, &block_len) != OK)
+			return 0;
+		result = append_env_buf(buf, bufsize, &len, block, block_len);
+		my_free(block);
+		}
+	if(result != OK)
+		return 0;
+
+	/* ...followed by the ones we have to look up for every job */
+	if((kvvp = kvvec_create(MACRO_X_COUNT + MAX_COMMAND_ARGUMENTS)) == NULL)
+		return 0;
+	add_macrox_environment_vars_r(mac, kvvp, TRUE);
+	add_argv_macro_environment_vars_r(mac, kvvp);
+
+	if(binary) {
+		block_len = kvvec_bbuf_len(kvvp);
+		if((result = reserve_env_buf(buf, bufsize, len, block_len)) == OK)
+			len += kvvec2bbuf(kvvp, *buf + len, block_len);
+		}
+	else if((kvvb = kvvec2buf(kvvp, '=', '\n', 0))) {
+		result = append_env_buf(buf, bufsize, &len, kvvb->buf, kvvb->buflen);
+		my_free(kvvb->buf);
+		my_free(kvvb);
+		}
+
+	kvvec_destroy(kvvp, KVVEC_FREE_KEYS);
+	return result == OK ? len : 0;
+	}
+
 #endif
@@ -30,6 +30,7 @@
 #else
 #include "../include/nagios.h"
 #endif
+#include <stdint.h>
 
 
 
@@ -263,6 +264,27 @@ const char *check_type_name(int check_type)
 /******************************************************************/
 
 
+/* loads objects from a binary cache, if there's one we can use */
+static int read_binary_object_data(void) {
+#ifdef NSCGI
+	struct stat bin_st, text_st;
+
+	/* don't trust a binary cache that's older than the text one */
+	if(!binary_object_cache_file || stat(binary_object_cache_file, &bin_st) < 0)
+		return OBJCACHE_UNUSABLE;
+	if(object_cache_file && !stat(object_cache_file, &text_st) && text_st.st_mtime > bin_st.st_mtime)
+		return OBJCACHE_UNUSABLE;
+
+	return read_binary_object_cache(binary_object_cache_file);
+#else
+	if(!use_precached_objects)
+		return OBJCACHE_UNUSABLE;
+
+	return read_binary_object_cache(object_precache_file);
+#endif
+	}
+
+
 /* read all host configuration data from external source */
 int read_object_config_data(const char *main_config_file, int options) {
 	int result = OK;
@@ -270,8 +292,12 @@ int read_object_config_data(const char *main_config_file, int options) {
 	/* reset object counts */
 	memset(&num_objects, 0, sizeof(num_objects));
 
-	/* read in data from all text host config files (template-based) */
-	result = xodtemplate_read_config_data(main_config_file, options);
+	/* a binary cache has everything resolved already */
+	result = read_binary_object_data();
+
+	/* otherwise read in data from all text host config files (template-based) */
+	if(result == OBJCACHE_UNUSABLE)
+		result = xodtemplate_read_config_data(main_config_file, options);
 	if(result != OK)
 		return ERROR;
 
@@ -362,7 +388,7 @@ int create_object_tables(unsigned int *ocount)
 		const unsigned int hash_size = ocount[i];
 		if (!hash_size)
 			continue;
-		object_hash_tables[i] = dkhash_create(hash_size);
+		object_hash_tables[i] = dkhash_create_backend(hash_size, DKHASH_BACKEND_OPEN);
 		if (!object_hash_tables[i]) {
 			logit(NSLOG_CONFIG_ERROR, TRUE, "Failed to create hash table with %u entries\n", hash_size);
 		}
@@ -2898,6 +2924,13 @@ int free_object_data(void) {
 		command *this_command = command_ary[i];
 		my_free(this_command->name);
 		my_free(this_command->command_line);
+		if(this_command->argv_tmpl) {
+			for(x = 0; this_command->argv[x]; x++)
+				my_free(this_command->argv_tmpl[x]);
+			my_free(this_command->argv_tmpl);
+			}
+		my_free(this_command->argv);
+		my_free(this_command->macro_tmpl);
 		my_free(this_command);
 		}
 
@@ -2980,6 +3013,57 @@ int free_object_data(void) {
 
 
 
+#ifndef NSCGI
+#define swap_object_ptr(a, b) do { void *swap_tmp_ = (a); (a) = (b); (b) = swap_tmp_; } while(0)
+
+/* exchanges all live object data with that in 'set' */
+void swap_object_data(object_set *set) {
+	struct object_count count;
+	unsigned int i;
+
+	for(i = 0; i < ARRAY_SIZE(object_hash_tables); i++)
+		swap_object_ptr(object_hash_tables[i], set->hash_tables[i]);
+
+	swap_object_ptr(command_list, set->command_list);
+	swap_object_ptr(timeperiod_list, set->timeperiod_list);
+	swap_object_ptr(host_list, set->host_list);
+	swap_object_ptr(service_list, set->service_list);
+	swap_object_ptr(contact_list, set->contact_list);
+	swap_object_ptr(hostgroup_list, set->hostgroup_list);
+	swap_object_ptr(servicegroup_list, set->servicegroup_list);
+	swap_object_ptr(contactgroup_list, set->contactgroup_list);
+	swap_object_ptr(hostescalation_list, set->hostescalation_list);
+	swap_object_ptr(serviceescalation_list, set->serviceescalation_list);
+	swap_object_ptr(command_ary, set->command_ary);
+	swap_object_ptr(timeperiod_ary, set->timeperiod_ary);
+	swap_object_ptr(host_ary, set->host_ary);
+	swap_object_ptr(service_ary, set->service_ary);
+	swap_object_ptr(contact_ary, set->contact_ary);
+	swap_object_ptr(hostgroup_ary, set->hostgroup_ary);
+	swap_object_ptr(servicegroup_ary, set->servicegroup_ary);
+	swap_object_ptr(contactgroup_ary, set->contactgroup_ary);
+	swap_object_ptr(hostescalation_ary, set->hostescalation_ary);
+	swap_object_ptr(hostdependency_ary, set->hostdependency_ary);
+	swap_object_ptr(serviceescalation_ary, set->serviceescalation_ary);
+	swap_object_ptr(servicedependency_ary, set->servicedependency_ary);
+
+	count = num_objects;
+	num_objects = set->count;
+	set->count = count;
+	}
+
+
+/* frees the objects in 'set', leaving the live ones alone */
+void free_object_set(object_set *set) {
+	swap_object_data(set);
+	free_object_data();
+	swap_object_data(set);
+	memset(set, 0, sizeof(*set));
+	}
+#endif
+
+
+
 /******************************************************************/
 /*********************** CACHE FUNCTIONS **************************/
 /******************************************************************/
@@ -3545,3 +3629,1254 @@ int fcache_objects(char *cache_file) {
 	return OK;
 	}
 #endif
+
+
+
+/******************************************************************/
+/******************* BINARY CACHE FUNCTIONS ***********************/
+/******************************************************************/
+
+/*
+ * The binary object cache holds the same objects as the text one,
+ * but loads without going through the template engine. After the
+ * header comes a table of nul-terminated strings, each stored once
+ * and referred to by its offset (0 meaning NULL), followed by the
+ * objects as a stream of 32-bit integers and doubles in the byte
+ * order of the writer. Objects refer to other objects by id, so
+ * they're stored in the order they must be registered in, with
+ * group memberships last.
+ */
+#define OBJCACHE_MAGIC "NAGOBJC"
+#define OBJCACHE_FORMAT_VERSION 1
+#define OBJCACHE_BYTE_ORDER 0x01020304
+
+struct objcache_header {
+	char magic[8];
+	uint32_t byte_order;
+	uint32_t format_version;
+	uint32_t object_version;
+	uint32_t ocount[NUM_OBJECT_SKIPLISTS];
+	uint32_t pad;
+	uint64_t strings_size;
+	uint64_t data_size;
+	};
+
+#ifndef NSCGI
+struct objcache_buf {
+	char *buf;
+	size_t len, size;
+	};
+
+struct objcache_writer {
+	struct objcache_buf strings;
+	struct objcache_buf data;
+	dkhash_table *strtab;
+	int error;
+	};
+
+static void oc_append(struct objcache_writer *w, struct objcache_buf *b, const void *ptr, size_t len)
+{
+	if(w->error)
+		return;
+
+	if(b->len + len > b->size) {
+		size_t size = b->size ? b->size : 65536;
+		char *buf;
+
+		while(size < b->len + len)
+			size *= 2;
+		if((buf = realloc(b->buf, size)) == NULL) {
+			w->error = ENOMEM;
+			return;
+			}
+		b->buf = buf;
+		b->size = size;
+		}
+	memcpy(b->buf + b->len, ptr, len);
+	b->len += len;
+}
+
+static void oc_put_u32(struct objcache_writer *w, unsigned int val)
+{
+	uint32_t v = val;
+	oc_append(w, &w->data, &v, sizeof(v));
+}
+
+/* negative values survive the round trip through uint32_t */
+#define oc_put_int(w, val) oc_put_u32(w, (unsigned int)(val))
+
+static void oc_put_double(struct objcache_writer *w, double val)
+{
+	oc_append(w, &w->data, &val, sizeof(val));
+}
+
+static void oc_put_str(struct objcache_writer *w, const char *str)
+{
+	void *offset;
+
+	if(str == NULL) {
+		oc_put_u32(w, 0);
+		return;
+		}
+
+	/* object names and such are repeated all over, so store them once */
+	if((offset = dkhash_get(w->strtab, str, NULL)) == NULL) {
+		if(w->strings.len + strlen(str) + 1 > UINT32_MAX) {
+			w->error = EFBIG;
+			return;
+			}
+		offset = (void *)(uintptr_t)w->strings.len;
+		oc_append(w, &w->strings, str, strlen(str) + 1);
+		if(dkhash_insert(w->strtab, str, NULL, offset) != DKHASH_OK)
+			w->error = ENOMEM;
+		}
+	oc_put_u32(w, (unsigned int)(uintptr_t)offset);
+}
+
+static void oc_put_contacts(struct objcache_writer *w, contactsmember *list)
+{
+	contactsmember *l;
+	unsigned int n = 0;
+
+	for(l = list; l; l = l->next)
+		n++;
+	oc_put_u32(w, n);
+	for(l = list; l; l = l->next)
+		oc_put_u32(w, l->contact_ptr->id);
+}
+
+static void oc_put_contactgroups(struct objcache_writer *w, contactgroupsmember *list)
+{
+	contactgroupsmember *l;
+	unsigned int n = 0;
+
+	for(l = list; l; l = l->next)
+		n++;
+	oc_put_u32(w, n);
+	for(l = list; l; l = l->next)
+		oc_put_u32(w, l->group_ptr->id);
+}
+
+static void oc_put_customvars(struct objcache_writer *w, customvariablesmember *list)
+{
+	customvariablesmember *l;
+	unsigned int n = 0;
+
+	for(l = list; l; l = l->next)
+		n++;
+	oc_put_u32(w, n);
+	for(l = list; l; l = l->next) {
+		oc_put_str(w, l->variable_name);
+		oc_put_str(w, l->variable_value);
+		}
+}
+
+static void oc_put_commands(struct objcache_writer *w, commandsmember *list)
+{
+	commandsmember *l;
+	unsigned int n = 0;
+
+	for(l = list; l; l = l->next)
+		n++;
+	oc_put_u32(w, n);
+	for(l = list; l; l = l->next)
+		oc_put_str(w, l->command);
+}
+
+static void oc_put_timeranges(struct objcache_writer *w, timerange *list)
+{
+	timerange *l;
+	unsigned int n = 0;
+
+	for(l = list; l; l = l->next)
+		n++;
+	oc_put_u32(w, n);
+	for(l = list; l; l = l->next) {
+		oc_put_u32(w, l->range_start);
+		oc_put_u32(w, l->range_end);
+		}
+}
+
+static void oc_put_timeperiod(struct objcache_writer *w, timeperiod *tp)
+{
+	timeperiodexclusion *exclude;
+	daterange *dr;
+	unsigned int n;
+	int x;
+
+	oc_put_str(w, tp->name);
+	oc_put_str(w, tp->alias);
+
+	for(n = 0, exclude = tp->exclusions; exclude; exclude = exclude->next)
+		n++;
+	oc_put_u32(w, n);
+	for(exclude = tp->exclusions; exclude; exclude = exclude->next)
+		oc_put_str(w, exclude->timeperiod_name);
+
+	for(x = 0; x < DATERANGE_TYPES; x++) {
+		for(n = 0, dr = tp->exceptions[x]; dr; dr = dr->next)
+			n++;
+		oc_put_u32(w, n);
+		for(dr = tp->exceptions[x]; dr; dr = dr->next) {
+			oc_put_int(w, dr->syear);
+			oc_put_int(w, dr->smon);
+			oc_put_int(w, dr->smday);
+			oc_put_int(w, dr->swday);
+			oc_put_int(w, dr->swday_offset);
+			oc_put_int(w, dr->eyear);
+			oc_put_int(w, dr->emon);
+			oc_put_int(w, dr->emday);
+			oc_put_int(w, dr->ewday);
+			oc_put_int(w, dr->ewday_offset);
+			oc_put_int(w, dr->skip_interval);
+			oc_put_timeranges(w, dr->times);
+			}
+		}
+
+	for(x = 0; x < 7; x++)
+		oc_put_timeranges(w, tp->days[x]);
+}
+
+static void oc_put_contact(struct objcache_writer *w, contact *c)
+{
+	int x;
+
+	oc_put_str(w, c->name);
+	oc_put_str(w, c->alias != c->name ? c->alias : NULL);
+	oc_put_str(w, c->email);
+	oc_put_str(w, c->pager);
+	for(x = 0; x < MAX_CONTACT_ADDRESSES; x++)
+		oc_put_str(w, c->address[x]);
+	oc_put_str(w, c->service_notification_period);
+	oc_put_str(w, c->host_notification_period);
+	oc_put_u32(w, c->service_notification_options);
+	oc_put_u32(w, c->host_notification_options);
+	oc_put_int(w, c->host_notifications_enabled);
+	oc_put_int(w, c->service_notifications_enabled);
+	oc_put_int(w, c->can_submit_commands);
+	oc_put_int(w, c->retain_status_information);
+	oc_put_int(w, c->retain_nonstatus_information);
+	oc_put_u32(w, c->minimum_value);
+	oc_put_commands(w, c->host_notification_commands);
+	oc_put_commands(w, c->service_notification_commands);
+	oc_put_customvars(w, c->custom_variables);
+}
+
+static void oc_put_host(struct objcache_writer *w, host *h)
+{
+	hostsmember *l;
+	unsigned int n = 0;
+
+	oc_put_str(w, h->name);
+	oc_put_str(w, h->display_name != h->name ? h->display_name : NULL);
+	oc_put_str(w, h->alias != h->name ? h->alias : NULL);
+	oc_put_str(w, h->address != h->name ? h->address : NULL);
+	oc_put_str(w, h->check_period);
+	/* the initial state only lives on as the current one */
+	oc_put_int(w, h->current_state);
+	oc_put_double(w, h->check_interval);
+	oc_put_double(w, h->retry_interval);
+	oc_put_int(w, h->max_attempts);
+	oc_put_u32(w, h->notification_options);
+	oc_put_double(w, h->notification_interval);
+	oc_put_double(w, h->first_notification_delay);
+	oc_put_str(w, h->notification_period);
+	oc_put_int(w, h->notifications_enabled);
+	oc_put_str(w, h->check_command);
+	oc_put_int(w, h->checks_enabled);
+	oc_put_int(w, h->accept_passive_checks);
+	oc_put_str(w, h->event_handler);
+	oc_put_int(w, h->event_handler_enabled);
+	oc_put_int(w, h->flap_detection_enabled);
+	oc_put_double(w, h->low_flap_threshold);
+	oc_put_double(w, h->high_flap_threshold);
+	oc_put_int(w, h->flap_detection_options);
+	oc_put_u32(w, h->stalking_options);
+	oc_put_int(w, h->process_performance_data);
+	oc_put_int(w, h->check_freshness);
+	oc_put_int(w, h->freshness_threshold);
+	oc_put_str(w, h->notes);
+	oc_put_str(w, h->notes_url);
+	oc_put_str(w, h->action_url);
+	oc_put_str(w, h->icon_image);
+	oc_put_str(w, h->icon_image_alt);
+	oc_put_str(w, h->vrml_image);
+	oc_put_str(w, h->statusmap_image);
+	oc_put_int(w, h->x_2d);
+	oc_put_int(w, h->y_2d);
+	oc_put_int(w, h->have_2d_coords);
+	oc_put_double(w, h->x_3d);
+	oc_put_double(w, h->y_3d);
+	oc_put_double(w, h->z_3d);
+	oc_put_int(w, h->have_3d_coords);
+	oc_put_int(w, h->should_be_drawn);
+	oc_put_int(w, h->retain_status_information);
+	oc_put_int(w, h->retain_nonstatus_information);
+	oc_put_int(w, h->obsess);
+	oc_put_u32(w, h->hourly_value);
+
+	for(l = h->parent_hosts; l; l = l->next)
+		n++;
+	oc_put_u32(w, n);
+	for(l = h->parent_hosts; l; l = l->next)
+		oc_put_str(w, l->host_name);
+	oc_put_contactgroups(w, h->contact_groups);
+	oc_put_contacts(w, h->contacts);
+	oc_put_customvars(w, h->custom_variables);
+}
+
+static void oc_put_service(struct objcache_writer *w, service *s)
+{
+	servicesmember *l;
+	unsigned int n = 0;
+
+	oc_put_u32(w, s->host_ptr->id);
+	oc_put_str(w, s->description);
+	oc_put_str(w, s->display_name != s->description ? s->display_name : NULL);
+	oc_put_str(w, s->check_period);
+	oc_put_int(w, s->current_state);
+	oc_put_int(w, s->max_attempts);
+	oc_put_int(w, s->parallelize);
+	oc_put_int(w, s->accept_passive_checks);
+	oc_put_double(w, s->check_interval);
+	oc_put_double(w, s->retry_interval);
+	oc_put_double(w, s->notification_interval);
+	oc_put_double(w, s->first_notification_delay);
+	oc_put_str(w, s->notification_period);
+	oc_put_u32(w, s->notification_options);
+	oc_put_int(w, s->notifications_enabled);
+	oc_put_int(w, s->is_volatile);
+	oc_put_str(w, s->event_handler);
+	oc_put_int(w, s->event_handler_enabled);
+	oc_put_str(w, s->check_command);
+	oc_put_int(w, s->checks_enabled);
+	oc_put_int(w, s->flap_detection_enabled);
+	oc_put_double(w, s->low_flap_threshold);
+	oc_put_double(w, s->high_flap_threshold);
+	oc_put_u32(w, s->flap_detection_options);
+	oc_put_u32(w, s->stalking_options);
+	oc_put_int(w, s->process_performance_data);
+	oc_put_int(w, s->check_freshness);
+	oc_put_int(w, s->freshness_threshold);
+	oc_put_str(w, s->notes);
+	oc_put_str(w, s->notes_url);
+	oc_put_str(w, s->action_url);
+	oc_put_str(w, s->icon_image);
+	oc_put_str(w, s->icon_image_alt);
+	oc_put_int(w, s->retain_status_information);
+	oc_put_int(w, s->retain_nonstatus_information);
+	oc_put_int(w, s->obsess);
+	oc_put_u32(w, s->hourly_value);
+
+	for(l = s->parents; l; l = l->next)
+		n++;
+	oc_put_u32(w, n);
+	for(l = s->parents; l; l = l->next) {
+		oc_put_str(w, l->host_name);
+		oc_put_str(w, l->service_description);
+		}
+	oc_put_contactgroups(w, s->contact_groups);
+	oc_put_contacts(w, s->contacts);
+	oc_put_customvars(w, s->custom_variables);
+}
+
+static int oc_cmp_host(const void *a_, const void *b_)
+{
+	const host *a = *(const host **)a_;
+	const host *b = *(const host **)b_;
+	return strcmp(a->name, b->name);
+}
+
+static int oc_cmp_service(const void *a_, const void *b_)
+{
+	const service *a = *(const service **)a_;
+	const service *b = *(const service **)b_;
+	int ret = strcmp(a->host_name, b->host_name);
+	return ret ? ret : strcmp(a->description, b->description);
+}
+
+/*
+ * group members are stored sorted, the way add_host_to_hostgroup()
+ * and add_service_to_servicegroup() would have them without large
+ * installation tweaks, so the loader can simply append them
+ */
+static void oc_put_sorted_members(struct objcache_writer *w, void **ary, unsigned int n, int (*cmp)(const void *, const void *))
+{
+	unsigned int i;
+
+	qsort(ary, n, sizeof(void *), cmp);
+	oc_put_u32(w, n);
+	for(i = 0; i < n; i++)
+		oc_put_u32(w, *(unsigned int *)ary[i]);
+}
+
+static void oc_put_group_members(struct objcache_writer *w)
+{
+	hostsmember *hm;
+	servicesmember *sm;
+	void **ary = NULL;
+	unsigned int i, n;
+
+	/* contactgroups keep their members in the order they were added */
+	for(i = 0; i < num_objects.contactgroups; i++)
+		oc_put_contacts(w, contactgroup_ary[i]->members);
+
+	if(num_objects.hosts + num_objects.services && (ary = malloc(sizeof(void *) * (num_objects.hosts + num_objects.services))) == NULL) {
+		w->error = ENOMEM;
+		return;
+		}
+	for(i = 0; i < num_objects.hostgroups; i++) {
+		for(n = 0, hm = hostgroup_ary[i]->members; hm; hm = hm->next)
+			ary[n++] = hm->host_ptr;
+		oc_put_sorted_members(w, ary, n, oc_cmp_host);
+		}
+	for(i = 0; i < num_objects.servicegroups; i++) {
+		for(n = 0, sm = servicegroup_ary[i]->members; sm; sm = sm->next)
+			ary[n++] = sm->service_ptr;
+		oc_put_sorted_members(w, ary, n, oc_cmp_service);
+		}
+	free(ary);
+}
+
+static void oc_put_escalation_contacts(struct objcache_writer *w, contactgroupsmember *groups, contactsmember *contacts)
+{
+	oc_put_contactgroups(w, groups);
+	oc_put_contacts(w, contacts);
+}
+
+/* writes all objects to a binary cache file, for use by the CGIs or the -u option */
+int fcache_binary_objects(const char *cache_file) {
+	struct objcache_writer w;
+	struct objcache_header hdr;
+	objectlist *list;
+	char *tmp_file = NULL;
+	unsigned int i;
+	int fd, x;
+
+	/* some people won't want to cache their objects */
+	if(!cache_file || !strcmp(cache_file, "/dev/null"))
+		return OK;
+
+	memset(&w, 0, sizeof(w));
+	memset(&hdr, 0, sizeof(hdr));
+	if((w.strtab = dkhash_create_backend(65536, DKHASH_BACKEND_OPEN)) == NULL)
+		return ERROR;
+
+	/* offset 0 is the NULL string */
+	oc_append(&w, &w.strings, "", 1);
+
+	for(i = 0; i < num_objects.timeperiods; i++)
+		oc_put_timeperiod(&w, timeperiod_ary[i]);
+	for(i = 0; i < num_objects.commands; i++) {
+		oc_put_str(&w, command_ary[i]->name);
+		oc_put_str(&w, command_ary[i]->command_line);
+		}
+	for(i = 0; i < num_objects.contactgroups; i++) {
+		contactgroup *cg = contactgroup_ary[i];
+		oc_put_str(&w, cg->group_name);
+		oc_put_str(&w, cg->alias != cg->group_name ? cg->alias : NULL);
+		}
+	for(i = 0; i < num_objects.hostgroups; i++) {
+		hostgroup *hg = hostgroup_ary[i];
+		oc_put_str(&w, hg->group_name);
+		oc_put_str(&w, hg->alias != hg->group_name ? hg->alias : NULL);
+		oc_put_str(&w, hg->notes);
+		oc_put_str(&w, hg->notes_url);
+		oc_put_str(&w, hg->action_url);
+		}
+	for(i = 0; i < num_objects.servicegroups; i++) {
+		servicegroup *sg = servicegroup_ary[i];
+		oc_put_str(&w, sg->group_name);
+		oc_put_str(&w, sg->alias != sg->group_name ? sg->alias : NULL);
+		oc_put_str(&w, sg->notes);
+		oc_put_str(&w, sg->notes_url);
+		oc_put_str(&w, sg->action_url);
+		}
+	for(i = 0; i < num_objects.contacts; i++)
+		oc_put_contact(&w, contact_ary[i]);
+	for(i = 0; i < num_objects.hosts; i++)
+		oc_put_host(&w, host_ary[i]);
+	for(i = 0; i < num_objects.services; i++)
+		oc_put_service(&w, service_ary[i]);
+	oc_put_group_members(&w);
+
+	/* dependencies hang off the dependent object */
+	for(i = 0; i < num_objects.services; i++) {
+		for(x = 0; x < 2; x++) {
+			list = x ? service_ary[i]->exec_deps : service_ary[i]->notify_deps;
+			for(; list; list = list->next) {
+				servicedependency *sd = (servicedependency *)list->object_ptr;
+				oc_put_u32(&w, sd->dependent_service_ptr->id);
+				oc_put_u32(&w, sd->master_service_ptr->id);
+				oc_put_int(&w, sd->dependency_type);
+				oc_put_int(&w, sd->inherits_parent);
+				oc_put_int(&w, sd->failure_options);
+				oc_put_str(&w, sd->dependency_period);
+				hdr.ocount[SERVICEDEPENDENCY_SKIPLIST]++;
+				}
+			}
+		}
+	for(i = 0; i < num_objects.serviceescalations; i++) {
+		serviceescalation *se = serviceescalation_ary[i];
+		oc_put_u32(&w, se->service_ptr->id);
+		oc_put_int(&w, se->first_notification);
+		oc_put_int(&w, se->last_notification);
+		oc_put_double(&w, se->notification_interval);
+		oc_put_str(&w, se->escalation_period);
+		oc_put_int(&w, se->escalation_options);
+		oc_put_escalation_contacts(&w, se->contact_groups, se->contacts);
+		}
+	for(i = 0; i < num_objects.hosts; i++) {
+		for(x = 0; x < 2; x++) {
+			list = x ? host_ary[i]->exec_deps : host_ary[i]->notify_deps;
+			for(; list; list = list->next) {
+				hostdependency *hd = (hostdependency *)list->object_ptr;
+				oc_put_u32(&w, hd->dependent_host_ptr->id);
+				oc_put_u32(&w, hd->master_host_ptr->id);
+				oc_put_int(&w, hd->dependency_type);
+				oc_put_int(&w, hd->inherits_parent);
+				oc_put_int(&w, hd->failure_options);
+				oc_put_str(&w, hd->dependency_period);
+				hdr.ocount[HOSTDEPENDENCY_SKIPLIST]++;
+				}
+			}
+		}
+	for(i = 0; i < num_objects.hostescalations; i++) {
+		hostescalation *he = hostescalation_ary[i];
+		oc_put_u32(&w, he->host_ptr->id);
+		oc_put_int(&w, he->first_notification);
+		oc_put_int(&w, he->last_notification);
+		oc_put_double(&w, he->notification_interval);
+		oc_put_str(&w, he->escalation_period);
+		oc_put_int(&w, he->escalation_options);
+		oc_put_escalation_contacts(&w, he->contact_groups, he->contacts);
+		}
+	dkhash_destroy(w.strtab);
+
+	memcpy(hdr.magic, OBJCACHE_MAGIC, sizeof(hdr.magic));
+	hdr.byte_order = OBJCACHE_BYTE_ORDER;
+	hdr.format_version = OBJCACHE_FORMAT_VERSION;
+	hdr.object_version = CURRENT_OBJECT_STRUCTURE_VERSION;
+	hdr.ocount[TIMEPERIOD_SKIPLIST] = num_objects.timeperiods;
+	hdr.ocount[COMMAND_SKIPLIST] = num_objects.commands;
+	hdr.ocount[CONTACTGROUP_SKIPLIST] = num_objects.contactgroups;
+	hdr.ocount[HOSTGROUP_SKIPLIST] = num_objects.hostgroups;
+	hdr.ocount[SERVICEGROUP_SKIPLIST] = num_objects.servicegroups;
+	hdr.ocount[CONTACT_SKIPLIST] = num_objects.contacts;
+	hdr.ocount[HOST_SKIPLIST] = num_objects.hosts;
+	hdr.ocount[SERVICE_SKIPLIST] = num_objects.services;
+	hdr.ocount[SERVICEESCALATION_SKIPLIST] = num_objects.serviceescalations;
+	hdr.ocount[HOSTESCALATION_SKIPLIST] = num_objects.hostescalations;
+	hdr.strings_size = w.strings.len;
+	hdr.data_size = w.data.len;
+
+	/* CGIs may have the old file mapped, so never rewrite it in place */
+	asprintf(&tmp_file, "%sXXXXXX", cache_file);
+	if(w.error || tmp_file == NULL || (fd = mkstemp(tmp_file)) < 0) {
+		logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Could not write binary object cache file '%s': %s\n", cache_file, strerror(w.error ? w.error : errno));
+		my_free(tmp_file);
+		my_free(w.strings.buf);
+		my_free(w.data.buf);
+		return ERROR;
+		}
+	if(write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)
+	   || write(fd, w.strings.buf, w.strings.len) != (ssize_t)w.strings.len
+	   || write(fd, w.data.buf, w.data.len) != (ssize_t)w.data.len)
+		w.error = errno ? errno : EIO;
+	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+	if(close(fd) && !w.error)
+		w.error = errno;
+	if(w.error || rename(tmp_file, cache_file)) {
+		logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Could not write binary object cache file '%s': %s\n", cache_file, strerror(w.error ? w.error : errno));
+		unlink(tmp_file);
+		w.error = TRUE;
+		}
+
+	my_free(tmp_file);
+	my_free(w.strings.buf);
+	my_free(w.data.buf);
+
+	return w.error ? ERROR : OK;
+	}
+#endif
+
+
+struct objcache_reader {
+	const char *data;
+	const char *end;
+	const char *strings;
+	size_t strings_size;
+	int error;
+	};
+
+static unsigned int oc_u32(struct objcache_reader *r)
+{
+	uint32_t v;
+
+	if(r->error || r->end - r->data < (ptrdiff_t)sizeof(v)) {
+		r->error = TRUE;
+		return 0;
+		}
+	memcpy(&v, r->data, sizeof(v));
+	r->data += sizeof(v);
+	return v;
+}
+
+#define oc_int(r) ((int)(int32_t)oc_u32(r))
+
+static double oc_double(struct objcache_reader *r)
+{
+	double v;
+
+	if(r->error || r->end - r->data < (ptrdiff_t)sizeof(v)) {
+		r->error = TRUE;
+		return 0.0;
+		}
+	memcpy(&v, r->data, sizeof(v));
+	r->data += sizeof(v);
+	return v;
+}
+
+/* strings in the mapped file, for arguments add_*() only look up or copy */
+static char *oc_str(struct objcache_reader *r)
+{
+	unsigned int offset = oc_u32(r);
+
+	if(!offset)
+		return NULL;
+	if(offset >= r->strings_size) {
+		r->error = TRUE;
+		return NULL;
+		}
+	return (char *)r->strings + offset;
+}
+
+/* private copies, for everything the objects get to keep */
+static char *oc_strdup(struct objcache_reader *r)
+{
+	char *str = oc_str(r);
+
+	if(str && (str = strdup(str)) == NULL)
+		r->error = TRUE;
+	return str;
+}
+
+static void *oc_ref(struct objcache_reader *r, void *ary, unsigned int num)
+{
+	unsigned int id = oc_u32(r);
+
+	if(id >= num) {
+		r->error = TRUE;
+		return NULL;
+		}
+	return ((void **)ary)[id];
+}
+
+/*
+ * lists are read back in the order they were written, which is
+ * the order they had in memory, so we append rather than going
+ * through the add_*() functions, which mostly prepend.
+ */
+static void oc_read_contacts(struct objcache_reader *r, contactsmember **list)
+{
+	contactsmember *cm;
+	contact *c;
+	unsigned int n;
+
+	for(n = oc_u32(r); n > 0 && !r->error; n--) {
+		if((c = oc_ref(r, contact_ary, num_objects.contacts)) == NULL || (cm = malloc(sizeof(*cm))) == NULL) {
+			r->error = TRUE;
+			return;
+			}
+		cm->contact_name = c->name;
+		cm->contact_ptr = c;
+		cm->next = NULL;
+		*list = cm;
+		list = &cm->next;
+		}
+}
+
+static void oc_read_contactgroups(struct objcache_reader *r, contactgroupsmember **list)
+{
+	contactgroupsmember *cgm;
+	contactgroup *cg;
+	unsigned int n;
+
+	for(n = oc_u32(r); n > 0 && !r->error; n--) {
+		if((cg = oc_ref(r, contactgroup_ary, num_objects.contactgroups)) == NULL || (cgm = malloc(sizeof(*cgm))) == NULL) {
+			r->error = TRUE;
+			return;
+			}
+		cgm->group_name = cg->group_name;
+		cgm->group_ptr = cg;
+		cgm->next = NULL;
+		*list = cgm;
+		list = &cgm->next;
+		}
+}
+
+static void oc_read_customvars(struct objcache_reader *r, customvariablesmember **list)
+{
+	customvariablesmember *cv;
+	unsigned int n;
+
+	for(n = oc_u32(r); n > 0 && !r->error; n--) {
+		if((cv = calloc(1, sizeof(*cv))) == NULL) {
+			r->error = TRUE;
+			return;
+			}
+		*list = cv;
+		list = &cv->next;
+		cv->variable_name = oc_strdup(r);
+		cv->variable_value = oc_strdup(r);
+		}
+}
+
+static void oc_read_commands(struct objcache_reader *r, commandsmember **list)
+{
+	commandsmember *cm;
+	unsigned int n;
+
+	for(n = oc_u32(r); n > 0 && !r->error; n--) {
+		if((cm = calloc(1, sizeof(*cm))) == NULL) {
+			r->error = TRUE;
+			return;
+			}
+		*list = cm;
+		list = &cm->next;
+		cm->command = oc_strdup(r);
+		}
+}
+
+static void oc_read_timeranges(struct objcache_reader *r, timerange **list)
+{
+	timerange *tr;
+	unsigned int n;
+
+	for(n = oc_u32(r); n > 0 && !r->error; n--) {
+		if((tr = malloc(sizeof(*tr))) == NULL) {
+			r->error = TRUE;
+			return;
+			}
+		tr->range_start = oc_u32(r);
+		tr->range_end = oc_u32(r);
+		tr->next = NULL;
+		*list = tr;
+		list = &tr->next;
+		}
+}
+
+static int oc_read_timeperiod(struct objcache_reader *r)
+{
+	timeperiod *tp;
+	timeperiodexclusion *exclude, **exclusions;
+	daterange *dr, **exceptions;
+	char *name, *alias;
+	unsigned int n;
+	int x;
+
+	name = oc_strdup(r);
+	alias = oc_strdup(r);
+	if(r->error || (tp = add_timeperiod(name, alias)) == NULL)
+		return ERROR;
+
+	exclusions = &tp->exclusions;
+	for(n = oc_u32(r); n > 0 && !r->error; n--) {
+		if((exclude = calloc(1, sizeof(*exclude))) == NULL)
+			return ERROR;
+		*exclusions = exclude;
+		exclusions = &exclude->next;
+		exclude->timeperiod_name = oc_strdup(r);
+		}
+
+	for(x = 0; x < DATERANGE_TYPES; x++) {
+		exceptions = &tp->exceptions[x];
+		for(n = oc_u32(r); n > 0 && !r->error; n--) {
+			if((dr = calloc(1, sizeof(*dr))) == NULL)
+				return ERROR;
+			*exceptions = dr;
+			exceptions = &dr->next;
+			dr->type = x;
+			dr->syear = oc_int(r);
+			dr->smon = oc_int(r);
+			dr->smday = oc_int(r);
+			dr->swday = oc_int(r);
+			dr->swday_offset = oc_int(r);
+			dr->eyear = oc_int(r);
+			dr->emon = oc_int(r);
+			dr->emday = oc_int(r);
+			dr->ewday = oc_int(r);
+			dr->ewday_offset = oc_int(r);
+			dr->skip_interval = oc_int(r);
+			oc_read_timeranges(r, &dr->times);
+			}
+		}
+
+	for(x = 0; x < 7; x++)
+		oc_read_timeranges(r, &tp->days[x]);
+
+	return r->error ? ERROR : OK;
+}
+
+static int oc_read_group(struct objcache_reader *r, int type)
+{
+	char *name, *alias, *notes = NULL, *notes_url = NULL, *action_url = NULL;
+	void *grp = NULL;
+
+	name = oc_strdup(r);
+	alias = oc_strdup(r);
+	if(type != CONTACTGROUP_SKIPLIST) {
+		notes = oc_strdup(r);
+		notes_url = oc_strdup(r);
+		action_url = oc_strdup(r);
+		}
+	if(r->error)
+		return ERROR;
+
+	if(type == CONTACTGROUP_SKIPLIST)
+		grp = add_contactgroup(name, alias);
+	else if(type == HOSTGROUP_SKIPLIST)
+		grp = add_hostgroup(name, alias, notes, notes_url, action_url);
+	else
+		grp = add_servicegroup(name, alias, notes, notes_url, action_url);
+
+	return grp ? OK : ERROR;
+}
+
+static int oc_read_contact(struct objcache_reader *r)
+{
+	contact c, *new_contact;
+	int x;
+
+	/* a scratch copy, filled in the order oc_put_contact() wrote it */
+	memset(&c, 0, sizeof(c));
+	c.name = oc_strdup(r);
+	c.alias = oc_strdup(r);
+	c.email = oc_strdup(r);
+	c.pager = oc_strdup(r);
+	for(x = 0; x < MAX_CONTACT_ADDRESSES; x++)
+		c.address[x] = oc_strdup(r);
+	c.service_notification_period = oc_str(r);
+	c.host_notification_period = oc_str(r);
+	c.service_notification_options = oc_u32(r);
+	c.host_notification_options = oc_u32(r);
+	c.host_notifications_enabled = oc_int(r);
+	c.service_notifications_enabled = oc_int(r);
+	c.can_submit_commands = oc_int(r);
+	c.retain_status_information = oc_int(r);
+	c.retain_nonstatus_information = oc_int(r);
+	c.minimum_value = oc_u32(r);
+	if(r->error)
+		return ERROR;
+
+	new_contact = add_contact(c.name, c.alias, c.email, c.pager, c.address, c.service_notification_period, c.host_notification_period, c.service_notification_options, c.host_notification_options, c.host_notifications_enabled, c.service_notifications_enabled, c.can_submit_commands, c.retain_status_information, c.retain_nonstatus_information, c.minimum_value);
+	if(new_contact == NULL)
+		return ERROR;
+
+	oc_read_commands(r, &new_contact->host_notification_commands);
+	oc_read_commands(r, &new_contact->service_notification_commands);
+	oc_read_customvars(r, &new_contact->custom_variables);
+
+	return r->error ? ERROR : OK;
+}
+
+static int oc_read_host(struct objcache_reader *r)
+{
+	host h, *new_host;
+	hostsmember *hm, **parents;
+	unsigned int n;
+	int notifications_enabled;
+
+	memset(&h, 0, sizeof(h));
+	h.name = oc_strdup(r);
+	h.display_name = oc_strdup(r);
+	h.alias = oc_strdup(r);
+	h.address = oc_strdup(r);
+	h.check_period = oc_str(r);
+	h.initial_state = oc_int(r);
+	h.check_interval = oc_double(r);
+	h.retry_interval = oc_double(r);
+	h.max_attempts = oc_int(r);
+	h.notification_options = oc_u32(r);
+	h.notification_interval = oc_double(r);
+	h.first_notification_delay = oc_double(r);
+	h.notification_period = oc_str(r);
+	notifications_enabled = oc_int(r); /* core-only field */
+	h.check_command = oc_strdup(r);
+	h.checks_enabled = oc_int(r);
+	h.accept_passive_checks = oc_int(r);
+	h.event_handler = oc_strdup(r);
+	h.event_handler_enabled = oc_int(r);
+	h.flap_detection_enabled = oc_int(r);
+	h.low_flap_threshold = oc_double(r);
+	h.high_flap_threshold = oc_double(r);
+	h.flap_detection_options = oc_int(r);
+	h.stalking_options = oc_u32(r);
+	h.process_performance_data = oc_int(r);
+	h.check_freshness = oc_int(r);
+	h.freshness_threshold = oc_int(r);
+	h.notes = oc_strdup(r);
+	h.notes_url = oc_strdup(r);
+	h.action_url = oc_strdup(r);
+	h.icon_image = oc_strdup(r);
+	h.icon_image_alt = oc_strdup(r);
+	h.vrml_image = oc_strdup(r);
+	h.statusmap_image = oc_strdup(r);
+	h.x_2d = oc_int(r);
+	h.y_2d = oc_int(r);
+	h.have_2d_coords = oc_int(r);
+	h.x_3d = oc_double(r);
+	h.y_3d = oc_double(r);
+	h.z_3d = oc_double(r);
+	h.have_3d_coords = oc_int(r);
+	h.should_be_drawn = oc_int(r);
+	h.retain_status_information = oc_int(r);
+	h.retain_nonstatus_information = oc_int(r);
+	h.obsess = oc_int(r);
+	h.hourly_value = oc_u32(r);
+	if(r->error)
+		return ERROR;
+
+	new_host = add_host(h.name, h.display_name, h.alias, h.address, h.check_period, h.initial_state, h.check_interval, h.retry_interval, h.max_attempts, h.notification_options, h.notification_interval, h.first_notification_delay, h.notification_period, notifications_enabled, h.check_command, h.checks_enabled, h.accept_passive_checks, h.event_handler, h.event_handler_enabled, h.flap_detection_enabled, h.low_flap_threshold, h.high_flap_threshold, h.flap_detection_options, h.stalking_options, h.process_performance_data, h.check_freshness, h.freshness_threshold, h.notes, h.notes_url, h.action_url, h.icon_image, h.icon_image_alt, h.vrml_image, h.statusmap_image, h.x_2d, h.y_2d, h.have_2d_coords, h.x_3d, h.y_3d, h.z_3d, h.have_3d_coords, h.should_be_drawn, h.retain_status_information, h.retain_nonstatus_information, h.obsess, h.hourly_value);
+	if(new_host == NULL)
+		return ERROR;
+
+	parents = &new_host->parent_hosts;
+	for(n = oc_u32(r); n > 0 && !r->error; n--) {
+		if((hm = calloc(1, sizeof(*hm))) == NULL)
+			return ERROR;
+		*parents = hm;
+		parents = &hm->next;
+		hm->host_name = oc_strdup(r);
+		}
+	oc_read_contactgroups(r, &new_host->contact_groups);
+	oc_read_contacts(r, &new_host->contacts);
+	oc_read_customvars(r, &new_host->custom_variables);
+
+	return r->error ? ERROR : OK;
+}
+
+static int oc_read_service(struct objcache_reader *r)
+{
+	service s, *new_service;
+	servicesmember *sm, **parents;
+	host *h;
+	unsigned int n;
+
+	/* add_service() copies all strings it keeps */
+	memset(&s, 0, sizeof(s));
+	h = oc_ref(r, host_ary, num_objects.hosts);
+	s.description = oc_str(r);
+	s.display_name = oc_str(r);
+	s.check_period = oc_str(r);
+	s.initial_state = oc_int(r);
+	s.max_attempts = oc_int(r);
+	s.parallelize = oc_int(r);
+	s.accept_passive_checks = oc_int(r);
+	s.check_interval = oc_double(r);
+	s.retry_interval = oc_double(r);
+	s.notification_interval = oc_double(r);
+	s.first_notification_delay = oc_double(r);
+	s.notification_period = oc_str(r);
+	s.notification_options = oc_u32(r);
+	s.notifications_enabled = oc_int(r);
+	s.is_volatile = oc_int(r);
+	s.event_handler = oc_str(r);
+	s.event_handler_enabled = oc_int(r);
+	s.check_command = oc_str(r);
+	s.checks_enabled = oc_int(r);
+	s.flap_detection_enabled = oc_int(r);
+	s.low_flap_threshold = oc_double(r);
+	s.high_flap_threshold = oc_double(r);
+	s.flap_detection_options = oc_u32(r);
+	s.stalking_options = oc_u32(r);
+	s.process_performance_data = oc_int(r);
+	s.check_freshness = oc_int(r);
+	s.freshness_threshold = oc_int(r);
+	s.notes = oc_str(r);
+	s.notes_url = oc_str(r);
+	s.action_url = oc_str(r);
+	s.icon_image = oc_str(r);
+	s.icon_image_alt = oc_str(r);
+	s.retain_status_information = oc_int(r);
+	s.retain_nonstatus_information = oc_int(r);
+	s.obsess = oc_int(r);
+	s.hourly_value = oc_u32(r);
+	if(r->error)
+		return ERROR;
+
+	new_service = add_service(h->name, s.description, s.display_name, s.check_period, s.initial_state, s.max_attempts, s.parallelize, s.accept_passive_checks, s.check_interval, s.retry_interval, s.notification_interval, s.first_notification_delay, s.notification_period, s.notification_options, s.notifications_enabled, s.is_volatile, s.event_handler, s.event_handler_enabled, s.check_command, s.checks_enabled, s.flap_detection_enabled, s.low_flap_threshold, s.high_flap_threshold, s.flap_detection_options, s.stalking_options, s.process_performance_data, s.check_freshness, s.freshness_threshold, s.notes, s.notes_url, s.action_url, s.icon_image, s.icon_image_alt, s.retain_status_information, s.retain_nonstatus_information, s.obsess, s.hourly_value);
+	if(new_service == NULL)
+		return ERROR;
+
+	parents = &new_service->parents;
+	for(n = oc_u32(r); n > 0 && !r->error; n--) {
+		if((sm = calloc(1, sizeof(*sm))) == NULL)
+			return ERROR;
+		*parents = sm;
+		parents = &sm->next;
+		sm->host_name = oc_strdup(r);
+		sm->service_description = oc_strdup(r);
+		}
+	oc_read_contactgroups(r, &new_service->contact_groups);
+	oc_read_contacts(r, &new_service->contacts);
+	oc_read_customvars(r, &new_service->custom_variables);
+
+	return r->error ? ERROR : OK;
+}
+
+/* joins up groups and their members, the same way the add_*() functions do */
+static int oc_read_group_members(struct objcache_reader *r)
+{
+	contactsmember *cm;
+	hostsmember *hm, **hms;
+	servicesmember *sm, **sms;
+	host *h;
+	service *s;
+	unsigned int i, n;
+
+	for(i = 0; i < num_objects.contactgroups && !r->error; i++) {
+		oc_read_contacts(r, &contactgroup_ary[i]->members);
+		for(cm = contactgroup_ary[i]->members; cm; cm = cm->next) {
+			if(prepend_object_to_objectlist(&cm->contact_ptr->contactgroups_ptr, contactgroup_ary[i]) != OK)
+				return ERROR;
+			}
+		}
+	timing_point("Contactgroup members loaded\n");
+
+	for(i = 0; i < num_objects.hostgroups && !r->error; i++) {
+		hms = &hostgroup_ary[i]->members;
+		for(n = oc_u32(r); n > 0 && !r->error; n--) {
+			if((h = oc_ref(r, host_ary, num_objects.hosts)) == NULL || (hm = calloc(1, sizeof(*hm))) == NULL)
+				return ERROR;
+			hm->host_name = h->name;
+			hm->host_ptr = h;
+			*hms = hm;
+			hms = &hm->next;
+			if(prepend_object_to_objectlist(&h->hostgroups_ptr, hostgroup_ary[i]) != OK)
+				return ERROR;
+			}
+		}
+	timing_point("Hostgroup members loaded\n");
+
+	for(i = 0; i < num_objects.servicegroups && !r->error; i++) {
+		sms = &servicegroup_ary[i]->members;
+		for(n = oc_u32(r); n > 0 && !r->error; n--) {
+			if((s = oc_ref(r, service_ary, num_objects.services)) == NULL || (sm = calloc(1, sizeof(*sm))) == NULL)
+				return ERROR;
+			sm->host_name = s->host_name;
+			sm->service_description = s->description;
+			sm->service_ptr = s;
+			*sms = sm;
+			sms = &sm->next;
+			if(prepend_object_to_objectlist(&s->servicegroups_ptr, servicegroup_ary[i]) != OK)
+				return ERROR;
+			}
+		}
+	timing_point("Servicegroup members loaded\n");
+
+	return r->error ? ERROR : OK;
+}
+
+static int oc_read_servicedependency(struct objcache_reader *r)
+{
+	service *dependent, *master;
+	int type, inherits_parent, failure_options;
+	char *period;
+
+	dependent = oc_ref(r, service_ary, num_objects.services);
+	master = oc_ref(r, service_ary, num_objects.services);
+	type = oc_int(r);
+	inherits_parent = oc_int(r);
+	failure_options = oc_int(r);
+	period = oc_str(r);
+	if(r->error)
+		return ERROR;
+
+	if(!add_service_dependency(dependent->host_name, dependent->description, master->host_name, master->description, type, inherits_parent, failure_options, period))
+		return ERROR;
+	return OK;
+}
+
+static int oc_read_hostdependency(struct objcache_reader *r)
+{
+	host *dependent, *master;
+	int type, inherits_parent, failure_options;
+	char *period;
+
+	dependent = oc_ref(r, host_ary, num_objects.hosts);
+	master = oc_ref(r, host_ary, num_objects.hosts);
+	type = oc_int(r);
+	inherits_parent = oc_int(r);
+	failure_options = oc_int(r);
+	period = oc_str(r);
+	if(r->error)
+		return ERROR;
+
+	if(!add_host_dependency(dependent->name, master->name, type, inherits_parent, failure_options, period))
+		return ERROR;
+	return OK;
+}
+
+static int oc_read_serviceescalation(struct objcache_reader *r)
+{
+	serviceescalation *se;
+	service *s;
+	int first, last, options;
+	double interval;
+	char *period;
+
+	s = oc_ref(r, service_ary, num_objects.services);
+	first = oc_int(r);
+	last = oc_int(r);
+	interval = oc_double(r);
+	period = oc_str(r);
+	options = oc_int(r);
+	if(r->error)
+		return ERROR;
+
+	if((se = add_serviceescalation(s->host_name, s->description, first, last, interval, period, options)) == NULL)
+		return ERROR;
+	oc_read_contactgroups(r, &se->contact_groups);
+	oc_read_contacts(r, &se->contacts);
+
+	return r->error ? ERROR : OK;
+}
+
+static int oc_read_hostescalation(struct objcache_reader *r)
+{
+	hostescalation *he;
+	host *h;
+	int first, last, options;
+	double interval;
+	char *period;
+
+	h = oc_ref(r, host_ary, num_objects.hosts);
+	first = oc_int(r);
+	last = oc_int(r);
+	interval = oc_double(r);
+	period = oc_str(r);
+	options = oc_int(r);
+	if(r->error)
+		return ERROR;
+
+	if((he = add_hostescalation(h->name, first, last, interval, period, options)) == NULL)
+		return ERROR;
+	oc_read_contactgroups(r, &he->contact_groups);
+	oc_read_contacts(r, &he->contacts);
+
+	return r->error ? ERROR : OK;
+}
+
+/* runs one of the readers above 'count' times, bailing out on the first error */
+#define oc_read_objects(r, count, func) \
+	do { \
+		unsigned int i_; \
+		for(i_ = 0; i_ < (count) && result == OK; i_++) \
+			result = func; \
+		if((r)->error) \
+			result = ERROR; \
+	} while(0)
+
+/*
+ * reads objects from a binary object cache. Returns OBJCACHE_UNUSABLE
+ * without touching anything if the file doesn't exist or was written
+ * by some other version of Nagios, so the caller can fall back to
+ * reading the text configuration.
+ */
+int read_binary_object_cache(const char *cache_file) {
+	struct objcache_header hdr;
+	struct objcache_reader r;
+	struct stat st;
+	unsigned int ocount[NUM_OBJECT_SKIPLISTS];
+	char *map;
+	int fd, i, result = OK;
+
+	if(cache_file == NULL || (fd = open(cache_file, O_RDONLY)) < 0)
+		return OBJCACHE_UNUSABLE;
+
+	if(fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(hdr) || read(fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+		close(fd);
+		return OBJCACHE_UNUSABLE;
+		}
+
+	/* a text precache from an earlier run is perfectly fine too */
+	if(memcmp(hdr.magic, OBJCACHE_MAGIC, sizeof(hdr.magic))) {
+		close(fd);
+		return OBJCACHE_UNUSABLE;
+		}
+	if(hdr.byte_order != OBJCACHE_BYTE_ORDER || hdr.format_version != OBJCACHE_FORMAT_VERSION || hdr.object_version != CURRENT_OBJECT_STRUCTURE_VERSION) {
+		logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Binary object cache '%s' was written by a different version of Nagios and must be recreated.\n", cache_file);
+		close(fd);
+		return OBJCACHE_UNUSABLE;
+		}
+	if(hdr.strings_size < 1 || hdr.strings_size > (uint64_t)st.st_size || hdr.data_size > (uint64_t)st.st_size || sizeof(hdr) + hdr.strings_size + hdr.data_size != (uint64_t)st.st_size) {
+		logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Binary object cache '%s' is truncated and can't be used.\n", cache_file);
+		close(fd);
+		return OBJCACHE_UNUSABLE;
+		}
+
+	if((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		return OBJCACHE_UNUSABLE;
+		}
+
+	memset(&r, 0, sizeof(r));
+	r.strings = map + sizeof(hdr);
+	r.strings_size = hdr.strings_size;
+	r.data = r.strings + r.strings_size;
+	r.end = r.data + hdr.data_size;
+
+	/* each string must end within the string table */
+	if(*r.strings || r.strings[r.strings_size - 1]) {
+		logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Binary object cache '%s' is corrupt and can't be used.\n", cache_file);
+		munmap(map, st.st_size);
+		close(fd);
+		return OBJCACHE_UNUSABLE;
+		}
+
+	for(i = 0; i < NUM_OBJECT_SKIPLISTS; i++)
+		ocount[i] = hdr.ocount[i];
+	if(create_object_tables(ocount) != OK)
+		result = ERROR;
+
+	oc_read_objects(&r, ocount[TIMEPERIOD_SKIPLIST], oc_read_timeperiod(&r));
+	timing_point("%u timeperiods loaded\n", num_objects.timeperiods);
+	for(i = 0; i < (int)ocount[COMMAND_SKIPLIST] && result == OK; i++) {
+		char *name = oc_strdup(&r), *command_line = oc_strdup(&r);
+		if(r.error || !add_command(name, command_line))
+			result = ERROR;
+		}
+	timing_point("%u commands loaded\n", num_objects.commands);
+	oc_read_objects(&r, ocount[CONTACTGROUP_SKIPLIST], oc_read_group(&r, CONTACTGROUP_SKIPLIST));
+	oc_read_objects(&r, ocount[HOSTGROUP_SKIPLIST], oc_read_group(&r, HOSTGROUP_SKIPLIST));
+	oc_read_objects(&r, ocount[SERVICEGROUP_SKIPLIST], oc_read_group(&r, SERVICEGROUP_SKIPLIST));
+	timing_point("Groups loaded\n");
+	oc_read_objects(&r, ocount[CONTACT_SKIPLIST], oc_read_contact(&r));
+	timing_point("%u contacts loaded\n", num_objects.contacts);
+	oc_read_objects(&r, ocount[HOST_SKIPLIST], oc_read_host(&r));
+	timing_point("%u hosts loaded\n", num_objects.hosts);
+	oc_read_objects(&r, ocount[SERVICE_SKIPLIST], oc_read_service(&r));
+	timing_point("%u services loaded\n", num_objects.services);
+	if(result == OK)
+		result = oc_read_group_members(&r);
+	oc_read_objects(&r, ocount[SERVICEDEPENDENCY_SKIPLIST], oc_read_servicedependency(&r));
+	oc_read_objects(&r, ocount[SERVICEESCALATION_SKIPLIST], oc_read_serviceescalation(&r));
+	oc_read_objects(&r, ocount[HOSTDEPENDENCY_SKIPLIST], oc_read_hostdependency(&r));
+	oc_read_objects(&r, ocount[HOSTESCALATION_SKIPLIST], oc_read_hostescalation(&r));
+	timing_point("Dependencies and escalations loaded\n");
+
+	/* anything left over means the counts didn't match the data */
+	if(result == OK && r.data != r.end)
+		r.error = TRUE;
+	if(r.error)
+		result = ERROR;
+
+	if(result != OK)
+		logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Failed to read objects from binary object cache '%s'%s\n", cache_file, r.error ? " (file is corrupt)" : "");
+
+	munmap(map, st.st_size);
+	close(fd);
+
+	return result;
+	}
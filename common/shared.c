@@ -16,10 +16,13 @@ int check_external_commands;
 int log_rotation_method;
 
 char *object_cache_file;
+char *binary_object_cache_file;
 struct object_count num_objects;
 
 int process_performance_data;
 char *status_file;
+char *status_snapshot_file;
+char *status_shm_file;
 
 int nagios_pid = 0;
 int daemon_mode = FALSE;
@@ -53,9 +56,12 @@ void init_shared_cfg_vars(int first_time) {
 	log_rotation_method = LOG_ROTATION_NONE;
 
 	object_cache_file = strdup(DEFAULT_OBJECT_CACHE_FILE);
+	binary_object_cache_file = NULL;
 
 	process_performance_data = DEFAULT_PROCESS_PERFORMANCE_DATA;
 	status_file = NULL;
+	status_snapshot_file = NULL;
+	status_shm_file = NULL;
 
 	check_external_commands = DEFAULT_CHECK_EXTERNAL_COMMANDS;
 
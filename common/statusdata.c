@@ -87,6 +87,12 @@ int cleanup_status_data(int delete_status_data) {
 	}
 
 
+/* status data has to forget about the old objects after an incremental reload */
+int reset_object_status_data(void) {
+	return xsddefault_reset_object_status_data();
+	}
+
+
 
 /* updates program status info */
 int update_program_status(int aggregated_dump) {
@@ -111,6 +117,8 @@ int update_host_status(host *hst, int aggregated_dump) {
 		broker_host_status(NEBTYPE_HOSTSTATUS_UPDATE, NEBFLAG_NONE, NEBATTR_NONE, hst, NULL);
 #endif
 
+	xsddefault_update_host_status(hst);
+
 	return OK;
 	}
 
@@ -125,6 +133,8 @@ int update_service_status(service *svc, int aggregated_dump) {
 		broker_service_status(NEBTYPE_SERVICESTATUS_UPDATE, NEBFLAG_NONE, NEBATTR_NONE, svc, NULL);
 #endif
 
+	xsddefault_update_service_status(svc);
+
 	return OK;
 	}
 
@@ -139,6 +149,8 @@ int update_contact_status(contact *cntct, int aggregated_dump) {
 		broker_contact_status(NEBTYPE_CONTACTSTATUS_UPDATE, NEBFLAG_NONE, NEBATTR_NONE, cntct, NULL);
 #endif
 
+	xsddefault_update_contact_status(cntct);
+
 	return OK;
 	}
 #endif
@@ -410,6 +422,8 @@ void free_status_data(void) {
 	/* free memory for the host status list */
 	for(this_hoststatus = hoststatus_list; this_hoststatus != NULL; this_hoststatus = next_hoststatus) {
 		next_hoststatus = this_hoststatus->next;
+		if(xsddefault_is_shm_status(this_hoststatus))
+			continue;
 		my_free(this_hoststatus->host_name);
 		my_free(this_hoststatus->plugin_output);
 		my_free(this_hoststatus->long_plugin_output);
@@ -420,6 +434,8 @@ void free_status_data(void) {
 	/* free memory for the service status list */
 	for(this_svcstatus = servicestatus_list; this_svcstatus != NULL; this_svcstatus = next_svcstatus) {
 		next_svcstatus = this_svcstatus->next;
+		if(xsddefault_is_shm_status(this_svcstatus))
+			continue;
 		my_free(this_svcstatus->host_name);
 		my_free(this_svcstatus->description);
 		my_free(this_svcstatus->plugin_output);
@@ -428,6 +444,9 @@ void free_status_data(void) {
 		my_free(this_svcstatus);
 		}
 
+	/* the ones read from the status segment go all at once */
+	xsddefault_free_status_shm();
+
 	/* free hash lists reset list pointers */
 	my_free(hoststatus_hashlist);
 	my_free(servicestatus_hashlist);
@@ -0,0 +1,280 @@
+/*
+ * Prints a binary Nagios retention file (use_binary_retention_file=1)
+ * as a text retention file, so it can be read, diffed or converted
+ * back to the text format by replacing the retention file with it
+ * while Nagios is stopped.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "../lib/kvvec.h"
+#include "../lib/dkhash.h"
+#include "../xdata/xrddefault.h"
+
+struct record {
+	unsigned int type, id, segment, segment_type, len;
+	char *payload;
+};
+
+static const char *block_names[] = {
+	NULL, "info", "program", "host", "service", "contact",
+	"hostcomment", "servicecomment", "hostdowntime", "servicedowntime"
+};
+
+static struct record *recs;
+static unsigned int num_recs, num_segments;
+static dkhash_table *hosts, *services, *contacts;
+
+static unsigned int get_u32(const char *buf)
+{
+	unsigned int val;
+
+	memcpy(&val, buf, 4);
+	return ntohl(val);
+}
+
+static void usage(char *progname)
+{
+	printf("Usage: %s [-a] <retention_file>\n", progname);
+	printf("  -a  print every record of every segment, rather than the\n");
+	printf("      state Nagios would read from the file\n");
+}
+
+/* returns the value of 'key' in a parsed record, or NULL */
+static char *get_value(struct kvvec *kvv, const char *key)
+{
+	int i;
+
+	for (i = 0; i < kvv->kv_pairs; i++) {
+		if (!strcmp(kvv->kv[i].key, key))
+			return kvv->kv[i].value;
+	}
+	return NULL;
+}
+
+/* the table an object record is keyed in, along with its keys */
+static dkhash_table *object_keys(struct record *rec, struct kvvec *kvv, char **k1, char **k2)
+{
+	*k2 = NULL;
+	switch (rec->type) {
+	case XRDDEFAULT_HOSTSTATUS_DATA:
+		*k1 = get_value(kvv, "host_name");
+		return *k1 ? hosts : NULL;
+	case XRDDEFAULT_SERVICESTATUS_DATA:
+		*k1 = get_value(kvv, "host_name");
+		*k2 = get_value(kvv, "service_description");
+		return *k1 && *k2 ? services : NULL;
+	case XRDDEFAULT_CONTACTSTATUS_DATA:
+		*k1 = get_value(kvv, "contact_name");
+		return *k1 ? contacts : NULL;
+	}
+	return NULL;
+}
+
+static int parse(struct record *rec, struct kvvec *kvv)
+{
+	/* payloads are parsed in place, so keep the mapped copy intact */
+	static char *buf;
+	static unsigned int bufsize;
+
+	if (rec->len > bufsize) {
+		free(buf);
+		bufsize = rec->len;
+		if (!(buf = malloc(bufsize)))
+			return -1;
+	}
+	memcpy(buf, rec->payload, rec->len);
+	return bbuf2kvvec_prealloc(kvv, buf, rec->len, KVVEC_ASSIGN);
+}
+
+static void print_record(struct record *rec, struct kvvec *kvv)
+{
+	int i;
+
+	printf("%s {\n", block_names[rec->type]);
+	for (i = 0; i < kvv->kv_pairs; i++)
+		printf("%s=%s\n", kvv->kv[i].key, kvv->kv[i].value);
+	printf("}\n");
+}
+
+/* finds all records in all complete segments */
+static int read_segments(char *map, size_t len)
+{
+	size_t offset = 0, seg_end;
+	unsigned long long seg_len;
+	unsigned int i, seg_records, size = 0;
+
+	while (len - offset >= XRDDEFAULT_SEGMENT_HEADER_LEN) {
+		char *hdr = map + offset;
+
+		if (memcmp(hdr, XRDDEFAULT_BINARY_MAGIC, 8))
+			break;
+		if (get_u32(hdr + 8) != XRDDEFAULT_BINARY_VERSION) {
+			fprintf(stderr, "Unsupported format version %u at offset %lu\n", get_u32(hdr + 8), (unsigned long)offset);
+			break;
+		}
+		seg_records = get_u32(hdr + 16);
+		seg_len = ((unsigned long long)get_u32(hdr + 24) << 32) | get_u32(hdr + 28);
+		if (!seg_records || seg_len > len - offset - XRDDEFAULT_SEGMENT_HEADER_LEN) {
+			fprintf(stderr, "Incomplete segment at offset %lu ignored\n", (unsigned long)offset);
+			break;
+		}
+
+		num_segments++;
+		offset += XRDDEFAULT_SEGMENT_HEADER_LEN;
+		seg_end = offset + seg_len;
+		for (i = 0; i < seg_records && seg_end - offset >= XRDDEFAULT_RECORD_HEADER_LEN; i++) {
+			struct record *rec;
+
+			if (num_recs >= size) {
+				size = size ? size * 2 : 4096;
+				if (!(recs = realloc(recs, size * sizeof(*recs))))
+					return -1;
+			}
+			rec = &recs[num_recs];
+			rec->type = get_u32(map + offset);
+			rec->id = get_u32(map + offset + 4);
+			rec->len = get_u32(map + offset + 8);
+			offset += XRDDEFAULT_RECORD_HEADER_LEN;
+			if (rec->len > seg_end - offset)
+				break;
+			rec->payload = map + offset;
+			rec->segment = num_segments;
+			rec->segment_type = get_u32(hdr + 12);
+			offset += rec->len;
+			if (rec->type > XRDDEFAULT_NO_DATA && rec->type <= XRDDEFAULT_SERVICEDOWNTIME_DATA)
+				num_recs++;
+		}
+		offset = seg_end;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct kvvec kvv = KVVEC_INITIALIZER;
+	struct stat st;
+	char *path = NULL, *map, *k1, *k2;
+	int fd, i, print_all = 0, pass;
+	unsigned int r;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-a"))
+			print_all = 1;
+		else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			usage(argv[0]);
+			return 0;
+		} else if (!path)
+			path = argv[i];
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!path) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	if (st.st_size < XRDDEFAULT_SEGMENT_HEADER_LEN) {
+		fprintf(stderr, "%s is not a binary retention file\n", path);
+		return 1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED || memcmp(map, XRDDEFAULT_BINARY_MAGIC, 8)) {
+		fprintf(stderr, "%s is not a binary retention file\n", path);
+		return 1;
+	}
+
+	if (read_segments(map, st.st_size) < 0) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	if (print_all) {
+		unsigned int segment = 0;
+
+		for (r = 0; r < num_recs; r++) {
+			if (recs[r].segment != segment) {
+				segment = recs[r].segment;
+				printf("# segment %u (%s)\n", segment,
+				       recs[r].segment_type == XRDDEFAULT_SEGMENT_FULL ? "full" : "incremental");
+			}
+			if (parse(&recs[r], &kvv) < 0) {
+				printf("# corrupt %s record\n", block_names[recs[r].type]);
+				continue;
+			}
+			print_record(&recs[r], &kvv);
+		}
+		return 0;
+	}
+
+	/* the last record of each object wins */
+	hosts = dkhash_create(num_recs / 4 + 1);
+	services = dkhash_create(num_recs + 1);
+	contacts = dkhash_create(1024);
+	if (!hosts || !services || !contacts) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	for (r = 0; r < num_recs; r++) {
+		struct record **last;
+		dkhash_table *t;
+
+		if (parse(&recs[r], &kvv) < 0 || !(t = object_keys(&recs[r], &kvv, &k1, &k2)))
+			continue;
+		if (!(last = dkhash_get(t, k1, k2))) {
+			/* the keys point into the parse buffer, so the table gets copies */
+			if (!(last = malloc(sizeof(*last))) || dkhash_insert(t, strdup(k1), k2 ? strdup(k2) : NULL, last) < 0) {
+				fprintf(stderr, "Out of memory\n");
+				return 1;
+			}
+		}
+		*last = &recs[r];
+	}
+
+	printf("########################################\n");
+	printf("#      NAGIOS STATE RETENTION FILE\n");
+	printf("#\n");
+	printf("# CONVERTED FROM %s\n", path);
+	printf("########################################\n");
+
+	/* the same order Nagios writes and reads them in */
+	for (pass = 0; pass < 3; pass++) {
+		for (r = 0; r < num_recs; r++) {
+			struct record *rec = &recs[r];
+			dkhash_table *t;
+
+			if (parse(rec, &kvv) < 0)
+				continue;
+			if ((t = object_keys(rec, &kvv, &k1, &k2))) {
+				struct record **last = dkhash_get(t, k1, k2);
+				if (pass != 1 || !last || *last != rec)
+					continue;
+			} else if (rec->type >= XRDDEFAULT_HOSTSTATUS_DATA && rec->type <= XRDDEFAULT_CONTACTSTATUS_DATA) {
+				continue;
+			} else if (rec->segment != num_segments) {
+				continue;
+			} else if (pass != (rec->type <= XRDDEFAULT_PROGRAMSTATUS_DATA ? 0 : 2)) {
+				continue;
+			}
+			print_record(rec, &kvv);
+		}
+	}
+
+	return 0;
+}
@@ -44,7 +44,10 @@ extern int defer_comment_sorting;
 extern unsigned long next_downtime_id;
 
 extern char *object_cache_file;
+extern char *binary_object_cache_file;
 extern char *status_file;
+extern char *status_snapshot_file;
+extern char *status_shm_file;
 
 extern time_t program_start;
 extern int nagios_pid;
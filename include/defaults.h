@@ -18,7 +18,10 @@
 #define DEFAULT_MAX_PARALLEL_SERVICE_CHECKS 			0	/* maximum number of service checks we can have running at any given time (0=unlimited) */
 #define DEFAULT_RETENTION_UPDATE_INTERVAL			60	/* minutes between auto-save of retention data */
 #define DEFAULT_RETENTION_SCHEDULING_HORIZON    		900     /* max seconds between program restarts that we will preserve scheduling information */
+#define DEFAULT_USE_BINARY_RETENTION_FILE			0	/* write retention data in the binary, incremental format */
 #define DEFAULT_STATUS_UPDATE_INTERVAL				60	/* seconds between aggregated status data updates */
+#define DEFAULT_STATUS_SNAPSHOT_COMPACTION_INTERVAL		300	/* seconds between rewrites of the binary status snapshot */
+#define DEFAULT_CONFIG_PARSER_THREADS				1	/* threads used to read object config files (0 = one per CPU) */
 #define DEFAULT_FRESHNESS_CHECK_INTERVAL        		60      /* seconds between service result freshness checks */
 #define DEFAULT_AUTO_RESCHEDULING_INTERVAL      		30      /* seconds between host and service check rescheduling events */
 #define DEFAULT_AUTO_RESCHEDULING_WINDOW        		180     /* window of time (in seconds) for which we should reschedule host and service checks */
@@ -73,6 +76,15 @@
 #define DEFAULT_ENABLE_PREDICTIVE_SERVICE_DEPENDENCY_CHECKS	1	/* should we use predictive service dependency checks? */
 
 #define DEFAULT_USE_LARGE_INSTALLATION_TWEAKS                   0       /* don't use tweaks for large Nagios installations */
+#define DEFAULT_USE_TIMING_WHEEL                                0       /* keep scheduled events in a binary heap */
+#define DEFAULT_MAX_EVENT_BATCH_SIZE                            1       /* poll for input between every due event */
+#define DEFAULT_WORKER_DISPATCH_POLICY                          WPDISPATCH_ROUND_ROBIN /* hand out jobs to workers in turn */
+#define DEFAULT_USE_BINARY_WORKER_FRAMING                       0       /* talk to workers using delimited key=value messages */
+#define DEFAULT_USE_IO_URING                                    0       /* use the default (epoll/poll/select) io broker */
+#define DEFAULT_WORKER_SPAWN_METHOD                             RUNCMD_SPAWN_FORK /* workers fork() to run plugins */
+#define DEFAULT_USE_INCREMENTAL_RELOAD                          0       /* SIGHUP does a full restart */
+#define DEFAULT_USE_ASYNC_LOG_WRITER                            0       /* write the main log from the event loop */
+#define DEFAULT_ASYNC_LOG_BUFFER_SIZE                           1048576 /* bytes of log lines the writer thread may lag behind */
 
 #define DEFAULT_ADDITIONAL_FRESHNESS_LATENCY			15	/* seconds to be added to freshness thresholds when automatically calculated by Nagios */
 
@@ -89,6 +101,8 @@
 #define DEFAULT_HOST_PERFDATA_FILE_TEMPLATE "[HOSTPERFDATA]\t$TIMET$\t$HOSTNAME$\t$HOSTEXECUTIONTIME$\t$HOSTOUTPUT$\t$HOSTPERFDATA$"
 #define DEFAULT_SERVICE_PERFDATA_FILE_TEMPLATE "[SERVICEPERFDATA]\t$TIMET$\t$HOSTNAME$\t$SERVICEDESC$\t$SERVICEEXECUTIONTIME$\t$SERVICELATENCY$\t$SERVICEOUTPUT$\t$SERVICEPERFDATA$"
 #define DEFAULT_HOST_PERFDATA_PROCESS_EMPTY_RESULTS 1
+#define DEFAULT_PERFDATA_FILE_BUFFER_SIZE 0 /* write perfdata file lines as they come */
+#define DEFAULT_PERFDATA_FILE_FLUSH_INTERVAL 5
 #define DEFAULT_SERVICE_PERFDATA_PROCESS_EMPTY_RESULTS 1
 
 #endif /* NAGIOS_DEFAULTS_H_INCLUDED */
@@ -56,6 +56,8 @@ struct nagios_macros {
 	customvariablesmember *custom_host_vars;
 	customvariablesmember *custom_service_vars;
 	customvariablesmember *custom_contact_vars;
+	command *command_ptr; /* command last expanded by get_raw_command_line_r() */
+	int command_options; /* ...and the macro options it was expanded with */
 	};
 typedef struct nagios_macros nagios_macros;
 
@@ -248,6 +250,20 @@ int process_macros(char *, char **, int);
 /* thread-safe version of the above */
 int process_macros_r(nagios_macros *mac, char *, char **, int);
 
+/* a string with its macros pre-parsed, see compile_macro_template() */
+struct macro_template;
+
+/*
+ * Pre-parse a string with macros in it, so it can be expanded over
+ * and over with process_macro_template_r() without having to find
+ * and look up its macros each time.
+ * Returns a single allocation the caller free()'s, or NULL on errors.
+ */
+struct macro_template *compile_macro_template(const char *);
+
+/* process_macros_r() for compiled templates */
+int process_macro_template_r(nagios_macros *mac, const struct macro_template *, char **, int);
+
 /* cleans macros characters before insertion into output string */
 char *clean_macro_chars(char *, int);
 
@@ -343,6 +359,21 @@ int set_argv_macro_environment_vars_r(nagios_macros *mac, int);
 int set_custom_macro_environment_vars_r(nagios_macros *mac, int);
 int set_contact_address_environment_vars_r(nagios_macros *mac, int);
 
+/* all environment macros for a job, keys allocated, values borrowed */
+struct kvvec *macros_to_kvv(nagios_macros *mac);
+
+/*
+ * Serialize the environment macros for a job into *buf, growing it as
+ * needed. Macros that only depend on the configuration of an object are
+ * cached per object, so only the volatile ones are looked up each time.
+ * binary selects the kvvec2bbuf() format over kvvec2buf()'s "key=value\n".
+ * Returns the length of the environment, or 0 if there's none to export.
+ */
+unsigned long macros_to_env_buf(nagios_macros *mac, int binary, char **buf, unsigned long *bufsize);
+
+/* forget the cached environment macros, f.e. when objects change */
+void invalidate_macro_environment_cache(void);
+
 #endif
 
 NAGIOS_END_DECL
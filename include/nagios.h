@@ -47,6 +47,7 @@ extern char *object_precache_file;
 extern unsigned int nofile_limit, nproc_limit, max_apps;
 
 extern int num_check_workers;
+extern int config_parser_threads;
 extern char *qh_socket_path;
 
 extern char *nagios_user;
@@ -151,6 +152,7 @@ extern int retention_update_interval;
 extern int use_retained_program_state;
 extern int use_retained_scheduling_info;
 extern int retention_scheduling_horizon;
+extern int use_binary_retention_file;
 extern char *retention_file;
 extern unsigned long retained_host_attribute_mask;
 extern unsigned long retained_service_attribute_mask;
@@ -163,6 +165,7 @@ extern int translate_passive_host_checks;
 extern int passive_host_checks_are_soft;
 
 extern int status_update_interval;
+extern int status_snapshot_compaction_interval;
 extern char *retention_file;
 
 extern int time_change_threshold;
@@ -175,6 +178,15 @@ extern double low_host_flap_threshold;
 extern double high_host_flap_threshold;
 
 extern int use_large_installation_tweaks;
+extern int use_timing_wheel;
+extern int max_event_batch_size;
+extern int worker_dispatch_policy;
+extern int use_binary_worker_framing;
+extern int use_io_uring;
+extern int worker_spawn_method;
+extern int use_incremental_reload;
+extern int use_async_log_writer;
+extern unsigned long async_log_buffer_size;
 extern int enable_environment_macros;
 extern int free_child_process_memory;
 extern int child_processes_fork_twice;
@@ -231,6 +243,8 @@ extern int     host_perfdata_file_pipe;
 extern int     service_perfdata_file_pipe;
 extern unsigned long host_perfdata_file_processing_interval;
 extern unsigned long service_perfdata_file_processing_interval;
+extern unsigned long perfdata_file_buffer_size;
+extern unsigned long perfdata_file_flush_interval;
 extern char    *host_perfdata_file_processing_command;
 extern char    *service_perfdata_file_processing_command;
 extern int     host_perfdata_process_empty_results;
@@ -419,6 +433,15 @@ extern struct load_control loadctl;
 
 
 
+	/********* WORKER JOB DISPATCH POLICIES ***************/
+
+#define WPDISPATCH_ROUND_ROBIN		0	/* hand out jobs to each worker in turn */
+#define WPDISPATCH_LEAST_JOBS		1	/* pick the worker with the fewest running jobs */
+#define WPDISPATCH_POWER_OF_TWO		2	/* pick the less busy of two random workers */
+#define WPDISPATCH_EWMA_LATENCY		3	/* pick the worker expected to finish a job first */
+
+
+
 	/************ SCHEDULED DOWNTIME TYPES ****************/
 
 #define ACTIVE_DOWNTIME                 0       /* active downtime - currently in effect */
@@ -482,6 +505,13 @@ extern const char *qh_strerror(int code);
 int read_main_config_file(char *);                     		/* reads the main config file (nagios.cfg) */
 int read_resource_file(char *);					/* processes macros in resource file */
 int read_all_object_data(char *);				/* reads all object config data */
+struct command *find_bang_command(char *);			/* finds a command with its arguments still attached */
+
+
+/**** Reload Functions ****/
+#define RELOAD_RESTART 1	/* reload_object_config() couldn't be done in place */
+void initialize_reload_data(char *);				/* remembers what the main config files look like */
+int reload_object_config(char *);				/* re-reads object config without restarting */
 
 
 /**** Setup Functions ****/
@@ -528,12 +558,16 @@ int close_command_file(void);					/* closes and deletes the external command fil
 int check_service_parents(service *svc);			/* checks service parents */
 int check_service_dependencies(service *, int);          	/* checks service dependencies */
 int check_host_dependencies(host *, int);                	/* checks host dependencies */
-void check_for_orphaned_services(void);				/* checks for orphaned services */
-void check_for_orphaned_hosts(void);				/* checks for orphaned hosts */
+void handle_orphaned_service_check(service *svc, time_t current_time);	/* reschedules a service whose check never came back */
+void handle_orphaned_host_check(host *hst, time_t current_time);	/* reschedules a host whose check never came back */
 void check_service_result_freshness(void);              	/* checks the "freshness" of service check results */
 int is_service_result_fresh(service *, time_t, int);            /* determines if a service's check results are fresh */
 void check_host_result_freshness(void);                 	/* checks the "freshness" of host check results */
 int is_host_result_fresh(host *, time_t, int);                  /* determines if a host's check results are fresh */
+void init_freshness_data(void);                                 /* indexes the freshness deadlines of all hosts and services */
+void free_freshness_data(void);
+void update_service_freshness_deadline(service *);              /* re-arms a service's freshness deadline */
+void update_host_freshness_deadline(host *);                    /* re-arms a host's freshness deadline */
 int my_system(char *, int, int *, double *, char **, int);         	/* executes a command via popen(), but also protects against timeouts */
 int my_system_r(nagios_macros *mac, char *, int, int *, double *, char **, int); /* thread-safe version of the above */
 
@@ -664,6 +698,25 @@ extern int get_raw_command_line_r(nagios_macros *mac, command *, char *, char **
  */
 extern int get_raw_command_line(command *, char *, char **, int);
 
+/*
+ * compiles the macros in a command line, decides if it needs a shell
+ * and splits it into an argv template if it doesn't
+ */
+extern void prepare_command(command *);
+
+/* prepare_command() for all commands */
+extern void prepare_commands(void);
+
+/* process_macros_r() for the command last prepared with get_raw_command_line_r() */
+extern int process_command_macros_r(nagios_macros *mac, char *, char **, int);
+
+/*
+ * the argv to run the command last prepared with get_raw_command_line_r(),
+ * given the command line process_command_macros_r() expanded it to.
+ * Returns NULL if the command line must be parsed by the worker instead
+ */
+extern char **get_command_argv_r(nagios_macros *mac, const char *);
+
 int check_time_against_period(time_t, timeperiod *);	/* check to see if a specific time is covered by a time period */
 int is_daterange_single_day(daterange *);
 time_t calculate_time_from_weekday_of_month(int, int, int, int);	/* calculates midnight time of specific (3rd, last, etc.) weekday of a particular month */
@@ -679,8 +732,30 @@ int query_update_api(void);                             /* checks to see if new
 
 
 /**** External Command Functions ****/
+/*
+ * An external command split up by parse_external_command(). 'name'
+ * and 'args' point into the parsed line. For passive check results
+ * the arguments are also split up into a copy of them, 'split_args',
+ * which the caller must free. 'output' is only set, and unescaped,
+ * if all the arguments were there.
+ */
+struct external_command {
+	int id;                         /* CMD_* id, or CMD_NONE if unknown */
+	time_t entry_time;
+	char *name;
+	char *args;
+	char *split_args;
+	char *host_name;
+	char *service_description;
+	int return_code;
+	char *output;
+	};
+
 int process_external_command1(char *);                  /* top-level external command processor */
 int process_external_command2(int, time_t, char *);	/* process an external command */
+int parse_external_command(char *, struct external_command *);  /* splits up a raw external command line */
+int process_parsed_external_command(struct external_command *); /* processes a parsed external command */
+int external_command_id(const char *);                  /* looks up the CMD_* id of an external command */
 int process_external_commands_from_file(char *, int);   /* process external commands in a file */
 int process_host_command(int, time_t, char *);          /* process an external host command */
 int process_hostgroup_command(int, time_t, char *);     /* process an external hostgroup command */
@@ -323,6 +323,10 @@ typedef struct command {
 	char    *name;
 	char    *command_line;
 	struct command *next;
+	char    **argv; /* command_line split into arguments at config load, or NULL */
+	int     argv_shell; /* command_line must be run with /bin/sh -c */
+	struct macro_template *macro_tmpl; /* compiled command_line */
+	struct macro_template **argv_tmpl; /* compiled argv, NULL where there are no macros */
 	} command;
 
 
@@ -737,6 +741,40 @@ extern struct hostdependency **hostdependency_ary;
 extern struct serviceescalation **serviceescalation_ary;
 extern struct servicedependency **servicedependency_ary;
 
+#ifndef NSCGI
+/*
+ * A complete set of objects, lists, arrays and lookup tables, set
+ * aside so a new configuration can be parsed into the globals while
+ * the running one is kept around
+ */
+typedef struct object_set {
+	struct dkhash_table *hash_tables[NUM_OBJECT_SKIPLISTS];
+	struct command *command_list;
+	struct timeperiod *timeperiod_list;
+	struct host *host_list;
+	struct service *service_list;
+	struct contact *contact_list;
+	struct hostgroup *hostgroup_list;
+	struct servicegroup *servicegroup_list;
+	struct contactgroup *contactgroup_list;
+	struct hostescalation *hostescalation_list;
+	struct serviceescalation *serviceescalation_list;
+	struct command **command_ary;
+	struct timeperiod **timeperiod_ary;
+	struct host **host_ary;
+	struct service **service_ary;
+	struct contact **contact_ary;
+	struct hostgroup **hostgroup_ary;
+	struct servicegroup **servicegroup_ary;
+	struct contactgroup **contactgroup_ary;
+	struct hostescalation **hostescalation_ary;
+	struct hostdependency **hostdependency_ary;
+	struct serviceescalation **serviceescalation_ary;
+	struct servicedependency **servicedependency_ary;
+	struct object_count count;
+	} object_set;
+#endif
+
 
 /********************* FUNCTIONS **********************/
 
@@ -866,11 +904,19 @@ void fcache_serviceescalation(FILE *fp, struct serviceescalation *temp_servicees
 void fcache_hostdependency(FILE *fp, struct hostdependency *temp_hostdependency);
 void fcache_hostescalation(FILE *fp, struct hostescalation *temp_hostescalation);
 int fcache_objects(char *cache_file);
+int fcache_binary_objects(const char *cache_file);
 #endif
 
+#define OBJCACHE_UNUSABLE 1 /* binary object cache is missing or from another version */
+int read_binary_object_cache(const char *cache_file);
+
 
 /**** Object Cleanup Functions ****/
 int free_object_data(void);                             /* frees all allocated memory for the object definitions */
+#ifndef NSCGI
+void swap_object_data(object_set *set);                 /* exchanges the live objects with the ones in 'set' */
+void free_object_set(object_set *set);                  /* frees the objects of a set-aside object set */
+#endif
 
 
 NAGIOS_END_DECL
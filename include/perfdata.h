@@ -30,6 +30,7 @@ NAGIOS_BEGIN_DECL
 
 int initialize_performance_data(const char *);    /* initializes performance data */
 int cleanup_performance_data(void);               /* cleans up performance data */
+int update_performance_data_commands(void);       /* looks up performance data commands again */
 
 int update_host_performance_data(host *);         /* updates host performance data */
 int update_service_performance_data(service *);   /* updates service performance data */
@@ -189,6 +189,7 @@ void free_status_data(void);                            /* free all memory alloc
 int initialize_status_data(const char *);               /* initializes status data at program start */
 int update_all_status_data(void);                       /* updates all status data */
 int cleanup_status_data(int);                           /* cleans up status data at program termination */
+int reset_object_status_data(void);                     /* drops status data tied to the previous object set */
 int update_program_status(int);                         /* updates program status data */
 int update_host_status(host *, int);                    /* updates host status data */
 int update_service_status(service *, int);              /* updates service status data */
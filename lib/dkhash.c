@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "dkhash.h"
 #include "lnag-utils.h"
 #include "nsutils.h"
@@ -11,8 +12,17 @@ typedef struct dkhash_bucket {
 	struct dkhash_bucket *next;
 } dkhash_bucket;
 
+/* a slot in an open addressing table. Empty slots have key == NULL */
+typedef struct dkhash_oa_slot {
+	const char *key;
+	const char *key2;
+	void *data;
+	unsigned int hash;
+} dkhash_oa_slot;
+
 struct dkhash_table {
 	dkhash_bucket **buckets;
+	dkhash_oa_slot *slots; /* non-NULL for DKHASH_BACKEND_OPEN */
 	unsigned int num_buckets;
 	unsigned int added, removed;
 	unsigned int entries;
@@ -51,30 +61,96 @@ unsigned int dkhash_table_size(dkhash_table *t)
 	return t ? t->num_buckets : 0;
 }
 
+int dkhash_backend(dkhash_table *t)
+{
+	if (!t)
+		return -1;
+	return t->slots ? DKHASH_BACKEND_OPEN : DKHASH_BACKEND_CHAINED;
+}
+
 /*
- * polynomial conversion ignoring overflows.
- * Pretty standard hash, once based on Ozan Yigit's sdbm() hash
- * but later modified for Nagios to produce better results on our
- * typical data.
+ * String hashing modeled on wyhash. We eat the key 16 bytes at a
+ * time and fold each chunk into the state with a 64x64->128 bit
+ * multiply, which mixes far better than the old byte-at-a-time
+ * polynomial hash and is a lot faster on longer keys.
  */
-#define PRIME 509
-static inline unsigned int hash(register const char *k)
+#define DK_P0 0xa0761d6478bd642fULL
+#define DK_P1 0xe7037ed1a0b428dbULL
+#define DK_P2 0x8ebc6af09c88c6e3ULL
+
+static inline uint64_t dk_mix(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)a * b;
+	return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+	uint64_t ha = a >> 32, la = (uint32_t)a, hb = b >> 32, lb = (uint32_t)b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo, hi;
+
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+	return lo ^ hi;
+#endif
+}
+
+static inline uint64_t dk_r8(const unsigned char *p)
 {
-	register unsigned int h = 0x123; /* magic */
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
 
-	while (*k)
-		h = *k++ + PRIME * h;
+static inline uint64_t dk_r4(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
 
-	return h;
+static inline uint64_t hash(const char *key, uint64_t seed)
+{
+	const unsigned char *p = (const unsigned char *)key;
+	size_t len = strlen(key), left = len;
+	uint64_t a, b;
+
+	seed ^= DK_P0;
+	for (; left > 16; left -= 16, p += 16)
+		seed = dk_mix(dk_r8(p) ^ DK_P1, dk_r8(p + 8) ^ seed);
+
+	if (left >= 8) {
+		a = dk_r8(p);
+		b = dk_r8(p + left - 8);
+	} else if (left >= 4) {
+		a = dk_r4(p);
+		b = dk_r4(p + left - 4);
+	} else if (left) {
+		a = ((uint64_t)p[0] << 16) | ((uint64_t)p[left >> 1] << 8) | p[left - 1];
+		b = 0;
+	} else {
+		a = b = 0;
+	}
+
+	return dk_mix(DK_P1 ^ len, dk_mix(a ^ DK_P1, b ^ seed));
 }
 
-static inline unsigned int dkhash_slot(dkhash_table *t, const char *k1, const char *k2)
+/*
+ * The second key is hashed with the first key's hash as seed, so we
+ * never have to glue the keys together, and swapping them around
+ * yields a different hash.
+ */
+static inline unsigned int dkhash_hash(const char *k1, const char *k2)
 {
-	register unsigned int h;
-	h = hash(k1);
+	uint64_t h = hash(k1, 0);
 	if (k2)
-		h ^= hash(k2);
-	return h % t->num_buckets;
+		h = hash(k2, h ^ DK_P2);
+	return (unsigned int)(h ^ (h >> 32));
+}
+
+static inline unsigned int dkhash_slot(dkhash_table *t, const char *k1, const char *k2)
+{
+	return dkhash_hash(k1, k2) & (t->num_buckets - 1);
 }
 
 static dkhash_bucket *dkhash_get_bucket(dkhash_table *t, const char *key, unsigned int slot)
@@ -101,6 +177,108 @@ static dkhash_bucket *dkhash_get_bucket2(dkhash_table *t, const char *k1, const
 	return NULL;
 }
 
+/*
+ * Open addressing with linear probing. The table is always a power
+ * of 2 in size and never more than 3/4 full, so probe sequences stay
+ * short and there's always an empty slot to stop at. Removal shifts
+ * the rest of the probe sequence back instead of leaving tombstones.
+ */
+static inline int oa_match(dkhash_oa_slot *s, unsigned int h, const char *k1, const char *k2)
+{
+	if (s->hash != h || strcmp(k1, s->key))
+		return 0;
+	if (!k2)
+		return !s->key2;
+	return s->key2 && !strcmp(k2, s->key2);
+}
+
+static int oa_find(dkhash_table *t, unsigned int h, const char *k1, const char *k2)
+{
+	unsigned int i, mask = t->num_buckets - 1;
+
+	for (i = h & mask; t->slots[i].key; i = (i + 1) & mask) {
+		if (oa_match(&t->slots[i], h, k1, k2))
+			return i;
+	}
+
+	return -1;
+}
+
+/* rehash into a larger table. We keep the hashes, so this is cheap */
+static int oa_grow(dkhash_table *t)
+{
+	dkhash_oa_slot *old = t->slots, *s;
+	unsigned int i, size = t->num_buckets * 2, mask = size - 1;
+
+	if (!(s = calloc(size, sizeof(*s))))
+		return DKHASH_ENOMEM;
+
+	for (i = 0; i < t->num_buckets; i++) {
+		unsigned int x;
+		if (!old[i].key)
+			continue;
+		for (x = old[i].hash & mask; s[x].key; x = (x + 1) & mask)
+			;
+		s[x] = old[i];
+	}
+
+	free(old);
+	t->slots = s;
+	t->num_buckets = size;
+	return DKHASH_OK;
+}
+
+static int oa_insert(dkhash_table *t, const char *k1, const char *k2, void *data)
+{
+	unsigned int i, h, mask;
+
+	h = dkhash_hash(k1, k2);
+	if (oa_find(t, h, k1, k2) >= 0)
+		return DKHASH_EDUPE;
+
+	if ((t->entries + 1) * 4 > t->num_buckets * 3 && oa_grow(t) < 0)
+		return DKHASH_ENOMEM;
+
+	mask = t->num_buckets - 1;
+	i = h & mask;
+	if (t->slots[i].key)
+		t->collisions++;
+	for (; t->slots[i].key; i = (i + 1) & mask)
+		;
+
+	t->slots[i].key = k1;
+	t->slots[i].key2 = k2;
+	t->slots[i].data = data;
+	t->slots[i].hash = h;
+	t->added++;
+	if (++t->entries > t->max_entries)
+		t->max_entries = t->entries;
+
+	return DKHASH_OK;
+}
+
+/* empty slot 'i', moving entries further down the probe sequence up */
+static void *oa_remove_slot(dkhash_table *t, unsigned int i)
+{
+	unsigned int j, mask = t->num_buckets - 1;
+	void *data = t->slots[i].data;
+
+	for (j = (i + 1) & mask; t->slots[j].key; j = (j + 1) & mask) {
+		unsigned int home = t->slots[j].hash & mask;
+
+		/* entries whose home slot lies cyclically in (i, j] stay put */
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+		t->slots[i] = t->slots[j];
+		i = j;
+	}
+
+	t->slots[i].key = NULL;
+	t->entries--;
+	t->removed++;
+	return data;
+}
+
 int dkhash_insert(dkhash_table *t, const char *k1, const char *k2, void *data)
 {
 	unsigned int slot;
@@ -109,6 +287,9 @@ int dkhash_insert(dkhash_table *t, const char *k1, const char *k2, void *data)
 	if (!t || !k1)
 		return DKHASH_EINVAL;
 
+	if (t->slots)
+		return oa_insert(t, k1, k2, data);
+
 	slot = dkhash_slot(t, k1, k2);
 	bkt = k2 ? dkhash_get_bucket2(t, k1, k2, slot) : dkhash_get_bucket(t, k1, slot);
 
@@ -142,13 +323,18 @@ void *dkhash_get(dkhash_table *t, const char *k1, const char *k2)
 	if (!t || !k1)
 		return NULL;
 
+	if (t->slots) {
+		int i = oa_find(t, dkhash_hash(k1, k2), k1, k2);
+		return i < 0 ? NULL : t->slots[i].data;
+	}
+
 	slot = dkhash_slot(t, k1, k2);
 	bkt = k2 ? dkhash_get_bucket2(t, k1, k2, slot) : dkhash_get_bucket(t, k1, slot);
 
 	return bkt ? bkt->data : NULL;
 }
 
-dkhash_table *dkhash_create(unsigned int size)
+dkhash_table *dkhash_create_backend(unsigned int size, int backend)
 {
 	double			ratio;
 	unsigned int	sz;
@@ -157,6 +343,9 @@ dkhash_table *dkhash_create(unsigned int size)
 	if (!size)
 		return NULL;
 
+	if (backend != DKHASH_BACKEND_CHAINED && backend != DKHASH_BACKEND_OPEN)
+		return NULL;
+
 	if(!(t = calloc(1, sizeof(*t))))
 		return NULL;
 
@@ -165,7 +354,11 @@ dkhash_table *dkhash_create(unsigned int size)
 	if (ratio < 1.4)
 		sz = rup2pof2(sz + 1);
 
-	if (!(t->buckets = calloc(sz, sizeof(dkhash_bucket *)))) {
+	if (backend == DKHASH_BACKEND_OPEN)
+		t->slots = calloc(sz, sizeof(dkhash_oa_slot));
+	else
+		t->buckets = calloc(sz, sizeof(dkhash_bucket *));
+	if (!t->slots && !t->buckets) {
 		free(t);
 		return NULL;
 	}
@@ -174,6 +367,11 @@ dkhash_table *dkhash_create(unsigned int size)
 	return t;
 }
 
+dkhash_table *dkhash_create(unsigned int size)
+{
+	return dkhash_create_backend(size, DKHASH_BACKEND_CHAINED);
+}
+
 int dkhash_destroy(dkhash_table *t)
 {
 	unsigned int i;
@@ -181,7 +379,7 @@ int dkhash_destroy(dkhash_table *t)
 	if (!t)
 		return DKHASH_EINVAL;
 
-	for (i = 0; i < t->num_buckets; i++) {
+	for (i = 0; t->buckets && i < t->num_buckets; i++) {
 		dkhash_bucket *b, *next;
 		for (b = t->buckets[i]; b; b = next) {
 			next = b->next;
@@ -189,6 +387,7 @@ int dkhash_destroy(dkhash_table *t)
 		}
 	}
 	free(t->buckets);
+	free(t->slots);
 	free(t);
 	return DKHASH_OK;
 }
@@ -210,6 +409,11 @@ void *dkhash_remove(dkhash_table *t, const char *k1, const char *k2)
 	if (!t || !k1)
 		return NULL;
 
+	if (t->slots) {
+		int i = oa_find(t, dkhash_hash(k1, k2), k1, k2);
+		return i < 0 ? NULL : oa_remove_slot(t, i);
+	}
+
 	slot = dkhash_slot(t, k1, k2);
 	if (!(bkt = t->buckets[slot]))
 		return NULL;
@@ -241,6 +445,33 @@ void dkhash_walk_data(dkhash_table *t, int (*walker)(void *)) {
 	if (!t->entries)
 		return;
 
+	if (t->slots) {
+		unsigned int start, n, mask = t->num_buckets - 1;
+
+		/*
+		 * Start right after an empty slot, so no probe sequence
+		 * wraps around past us. Removals then only ever move
+		 * entries we haven't visited yet into the current slot.
+		 */
+		for (start = 0; t->slots[start].key; start++)
+			;
+		for (n = 1; n <= t->num_buckets; n++) {
+			unsigned int x = (start + n) & mask;
+			int ret;
+
+			if (!t->slots[x].key)
+				continue;
+			ret = walker(t->slots[x].data);
+			if (ret & DKHASH_WALK_REMOVE) {
+				oa_remove_slot(t, x);
+				n--;
+			}
+			if (ret & DKHASH_WALK_STOP)
+				return;
+		}
+		return;
+	}
+
 	for (i = 0; i < t->num_buckets; i++) {
 		int depth = 0;
 		dkhash_bucket *next;
@@ -25,6 +25,12 @@
 #define DKHASH_EINVAL (-EINVAL) /**< Invalid parameters passed */
 #define DKHASH_ENOMEM (-ENOMEM) /**< Memory allocation failed */
 
+/**
+ * Backends for dkhash_create_backend()
+ */
+#define DKHASH_BACKEND_CHAINED 0 /**< Fixed-size table of chained buckets (the default) */
+#define DKHASH_BACKEND_OPEN    1 /**< Linear probing table that grows as needed */
+
 struct dkhash_table;
 /** opaque type */
 typedef struct dkhash_table dkhash_table;
@@ -38,6 +44,28 @@ typedef struct dkhash_table dkhash_table;
  */
 extern dkhash_table *dkhash_create(unsigned int size);
 
+/**
+ * Create a dual-keyed hash-table using a particular backend
+ * DKHASH_BACKEND_CHAINED tables never change size, so lookups slow
+ * down if they get filled past the size given here.
+ * DKHASH_BACKEND_OPEN tables keep all entries in one flat array that
+ * doubles in size whenever it gets 3/4 full, so 'size' is only a hint
+ * to avoid resizing while the table is being filled. They're faster
+ * than chained tables and don't allocate memory per entry, so they're
+ * preferable unless pointers to the table's internals must stay valid.
+ * @param size The expected number of entries
+ * @param backend One of the DKHASH_BACKEND_* values
+ * @return A pointer to the new table on success, NULL on errors
+ */
+extern dkhash_table *dkhash_create_backend(unsigned int size, int backend);
+
+/**
+ * Get the backend a hash table was created with
+ * @param t The hash table
+ * @return One of the DKHASH_BACKEND_* values, or -1 on errors
+ */
+extern int dkhash_backend(dkhash_table *t);
+
 /**
  * Destroy a dual-keyed hash table
  * @param t The table to destroy
@@ -89,7 +117,8 @@ extern void dkhash_walk_data(dkhash_table *t, int (*walker)(void *data));
 /**
  * Get number of collisions in hash table
  * Many collisions is a sign of a too small hash table or
- * poor hash-function.
+ * poor hash-function. For DKHASH_BACKEND_OPEN tables, this is the
+ * number of inserts that didn't land in their preferred slot.
  * @param t The hash table to report on
  * @return The total number of collisions (not duplicates) from inserts
  */
@@ -126,6 +155,7 @@ extern unsigned int dkhash_num_entries_removed(dkhash_table *t);
 
 /**
  * Get actual table size (in number of buckets)
+ * For DKHASH_BACKEND_OPEN tables, this grows as entries are added.
  * @param t The hash table
  * @return Number of bucket-slots in hash table
  */
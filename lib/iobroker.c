@@ -18,6 +18,24 @@
 #ifndef EPOLLONESHOT
 # define EPOLLONESHOT 0
 #endif
+#ifndef EPOLLET
+# define EPOLLET 0
+#endif
+/*
+ * io_uring is only ever used on Linux, so we only look for it when
+ * we've got epoll() to fall back to
+ */
+#if defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+#  include <sys/syscall.h>
+#  include <sys/mman.h>
+#  include <endian.h>
+#  if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(IORING_FEAT_EXT_ARG)
+#   define IOBROKER_HAS_URING 1
+#  endif
+# endif
+#endif
 #elif !defined(IOBROKER_USES_SELECT)
 #include <poll.h>
 #else
@@ -35,23 +53,480 @@
 typedef struct {
 	int fd; /* the file descriptor */
 	int events; /* events the caller is interested in */
+	int flags; /* IOBROKER_EDGE_TRIGGERED and friends */
+	unsigned int gen; /* registration generation, for io_uring */
 	int (*handler)(int, int, void *); /* where we send data */
+	int (*reader)(int, char *, int, void *); /* ...or what we've read for it */
 	void *arg; /* the argument we send to the input handler */
+	int rready; /* io_uring: a completed read awaits the reader */
+	int rlen; /* io_uring: result of that read */
+	int rbid; /* io_uring: buffer holding the data, or -1 */
 } iobroker_fd;
 
+/* how much we read at a time on behalf of readers */
+#define IOBROKER_READ_SIZE (64 * 1024)
+
 
 struct iobroker_set {
 	iobroker_fd **iobroker_fds;
 	int max_fds; /* max number of sockets we can accept */
 	int num_fds; /* number of sockets we're currently brokering for */
+	char *rbuf; /* where we read() to for readers */
 #ifdef IOBROKER_USES_EPOLL
 	int epfd;
 	struct epoll_event *ep_events;
+#ifdef IOBROKER_HAS_URING
+	struct iob_uring *uring; /* non-NULL if we're using io_uring */
+	unsigned int uring_gen;
+#endif
 #elif !defined(IOBROKER_USES_SELECT)
 	struct pollfd *pfd;
 #endif
 };
 
+#ifdef IOBROKER_HAS_URING
+/*
+ * The io_uring broker keeps a request armed in the kernel for each
+ * registered socket. Sockets registered with a reader get a read
+ * into one of a pool of buffers we've handed the kernel, so their
+ * data arrives along with the completion and nobody has to read()
+ * it. Others get a poll request, since their handlers do their own
+ * reading. Level-triggered sockets get one-shot polls that are
+ * re-armed once their handler has run, while edge-triggered ones get a
+ * multishot poll that keeps firing until it's removed. New, re-armed
+ * and removed requests are queued up and handed to the kernel by the
+ * same system call that waits for events, so a busy set costs one
+ * system call per round instead of one per socket.
+ */
+#define URING_SQ_ENTRIES 1024
+#define URING_CQ_ENTRIES 16384
+#define URING_UD_IGNORE (~0ULL)
+#define URING_RBUF_GROUP 1
+#define URING_RBUF_COUNT 32
+#define URING_RBUF_SIZE IOBROKER_READ_SIZE
+#define uring_ud(s) (((unsigned long long)(s)->gen << 32) | (unsigned int)(s)->fd)
+
+struct iob_uring {
+	int fd;
+	int multishot; /* cleared if the kernel rejects multishot polls */
+	unsigned int sq_entries;
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_len, cq_ring_len, sqes_len;
+	unsigned long long *rearm; /* fired one-shot requests, as user_data */
+	unsigned int num_rearm, rearm_alloc;
+	char *rbufs; /* the buffers readers' data lands in, or NULL */
+};
+
+static void uring_destroy(struct iob_uring *r)
+{
+	if (r->sqes && r->sqes != MAP_FAILED)
+		munmap(r->sqes, r->sqes_len);
+	if (r->cq_ring && r->cq_ring != MAP_FAILED && r->cq_ring != r->sq_ring)
+		munmap(r->cq_ring, r->cq_ring_len);
+	if (r->sq_ring && r->sq_ring != MAP_FAILED)
+		munmap(r->sq_ring, r->sq_ring_len);
+	close(r->fd);
+	free(r->rearm);
+	free(r->rbufs);
+	free(r);
+}
+
+static int uring_enter(struct iob_uring *r, int timeout);
+static int uring_provide(struct iob_uring *r, int bid, int nr);
+
+static struct iob_uring *uring_create(void)
+{
+	struct io_uring_params p;
+	struct iob_uring *r;
+	int fd;
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = URING_CQ_ENTRIES;
+	fd = syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &p);
+	if (fd < 0)
+		return NULL;
+
+	/* we need timeouts on waits and must never lose a completion */
+	if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)) {
+		close(fd);
+		return NULL;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	if (!(r = calloc(1, sizeof(*r)))) {
+		close(fd);
+		return NULL;
+	}
+	r->fd = fd;
+	r->multishot = 1;
+	r->sq_entries = p.sq_entries;
+	r->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	r->cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->cq_ring_len > r->sq_ring_len)
+			r->sq_ring_len = r->cq_ring_len;
+		r->cq_ring_len = r->sq_ring_len;
+	}
+
+	r->sq_ring = mmap(NULL, r->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (r->sq_ring == MAP_FAILED) {
+		uring_destroy(r);
+		return NULL;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ring = r->sq_ring;
+	} else {
+		r->cq_ring = mmap(NULL, r->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (r->cq_ring == MAP_FAILED) {
+			uring_destroy(r);
+			return NULL;
+		}
+	}
+	r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		uring_destroy(r);
+		return NULL;
+	}
+
+	r->sq_head = (unsigned int *)((char *)r->sq_ring + p.sq_off.head);
+	r->sq_tail = (unsigned int *)((char *)r->sq_ring + p.sq_off.tail);
+	r->sq_mask = (unsigned int *)((char *)r->sq_ring + p.sq_off.ring_mask);
+	r->sq_array = (unsigned int *)((char *)r->sq_ring + p.sq_off.array);
+	r->cq_head = (unsigned int *)((char *)r->cq_ring + p.cq_off.head);
+	r->cq_tail = (unsigned int *)((char *)r->cq_ring + p.cq_off.tail);
+	r->cq_mask = (unsigned int *)((char *)r->cq_ring + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)((char *)r->cq_ring + p.cq_off.cqes);
+
+	/*
+	 * Hand the kernel the buffers readers' data goes into. If it
+	 * won't take them, readers get polled and read() like everyone
+	 * else.
+	 */
+	if ((r->rbufs = malloc((size_t)URING_RBUF_COUNT * URING_RBUF_SIZE))) {
+		unsigned int head = *r->cq_head;
+		int res = -1;
+
+		if (uring_provide(r, 0, URING_RBUF_COUNT) < 0 || uring_enter(r, -1) < 0) {
+			uring_destroy(r);
+			return NULL;
+		}
+		if (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+			res = r->cqes[head & *r->cq_mask].res;
+			__atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+		}
+		if (res < 0) {
+			free(r->rbufs);
+			r->rbufs = NULL;
+		}
+	}
+
+	return r;
+}
+
+static inline unsigned int uring_sq_pending(struct iob_uring *r)
+{
+	return *r->sq_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Submit everything we've queued, and wait up to 'timeout' msecs
+ * for at least one completion if 'timeout' isn't 0
+ */
+static int uring_enter(struct iob_uring *r, int timeout)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	unsigned int flags = 0, min_complete = 0;
+	int ret;
+
+	memset(&arg, 0, sizeof(arg));
+	if (timeout) {
+		flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+		min_complete = 1;
+		if (timeout > 0) {
+			ts.tv_sec = timeout / 1000;
+			ts.tv_nsec = (timeout % 1000) * 1000000LL;
+			arg.ts = (unsigned long long)(unsigned long)&ts;
+		}
+	}
+
+	ret = syscall(__NR_io_uring_enter, r->fd, uring_sq_pending(r), min_complete, flags,
+	              flags ? &arg : NULL, flags ? sizeof(arg) : 0);
+	if (ret < 0 && (errno == ETIME || errno == EBUSY || errno == EAGAIN))
+		return 0;
+	return ret;
+}
+
+static struct io_uring_sqe *uring_get_sqe(struct iob_uring *r)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int idx;
+
+	/* hand over what we've got if the submission queue is full */
+	if (uring_sq_pending(r) >= r->sq_entries) {
+		uring_enter(r, 0);
+		if (uring_sq_pending(r) >= r->sq_entries)
+			return NULL;
+	}
+
+	idx = *r->sq_tail & *r->sq_mask;
+	sqe = &r->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	r->sq_array[idx] = idx;
+	return sqe;
+}
+
+static inline void uring_commit(struct iob_uring *r)
+{
+	__atomic_store_n(r->sq_tail, *r->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+/* give 'nr' buffers, starting with buffer 'bid', (back) to the kernel */
+static int uring_provide(struct iob_uring *r, int bid, int nr)
+{
+	struct io_uring_sqe *sqe;
+
+	if (!(sqe = uring_get_sqe(r)))
+		return IOBROKER_ELIB;
+
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = nr;
+	sqe->addr = (unsigned long)(r->rbufs + (size_t)bid * URING_RBUF_SIZE);
+	sqe->len = URING_RBUF_SIZE;
+	sqe->off = bid;
+	sqe->buf_group = URING_RBUF_GROUP;
+	sqe->user_data = URING_UD_IGNORE;
+	uring_commit(r);
+	return 0;
+}
+
+static int uring_arm(struct iob_uring *r, iobroker_fd *s)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int events = s->events;
+
+	if (!(sqe = uring_get_sqe(r)))
+		return IOBROKER_ELIB;
+
+	/* the kernel picks a buffer once there's something to read */
+	if (s->reader && r->rbufs) {
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = s->fd;
+		sqe->off = (unsigned long long)-1;
+		sqe->len = URING_RBUF_SIZE;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = URING_RBUF_GROUP;
+		sqe->user_data = uring_ud(s);
+		uring_commit(r);
+		return 0;
+	}
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+	events = (events << 16) | (events >> 16);
+#endif
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = s->fd;
+	sqe->poll32_events = events;
+	sqe->user_data = uring_ud(s);
+	if ((s->flags & IOBROKER_EDGE_TRIGGERED) && r->multishot)
+		sqe->len = IORING_POLL_ADD_MULTI;
+	uring_commit(r);
+	return 0;
+}
+
+static int uring_disarm(struct iob_uring *r, iobroker_fd *s)
+{
+	struct io_uring_sqe *sqe;
+
+	if (!(sqe = uring_get_sqe(r)))
+		return IOBROKER_ELIB;
+
+	sqe->opcode = s->reader && r->rbufs ? IORING_OP_ASYNC_CANCEL : IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = uring_ud(s);
+	sqe->user_data = URING_UD_IGNORE;
+	uring_commit(r);
+
+	/*
+	 * The request holds a reference to the file, so it must be
+	 * gone before our caller close()'s the socket or the other
+	 * end won't notice until our next poll
+	 */
+	return uring_enter(r, 0) < 0 ? IOBROKER_ELIB : 0;
+}
+
+/*
+ * Remember a fired one-shot request so it can be re-armed on the next
+ * round. Re-arming a poll right away would let the kernel report data
+ * the handler hasn't gotten around to reading yet.
+ */
+static void uring_defer_rearm(struct iob_uring *r, unsigned long long ud)
+{
+	if (r->num_rearm >= r->rearm_alloc) {
+		unsigned int alloc = r->rearm_alloc ? r->rearm_alloc * 2 : 64;
+		unsigned long long *tmp = realloc(r->rearm, alloc * sizeof(*tmp));
+		if (!tmp)
+			return;
+		r->rearm = tmp;
+		r->rearm_alloc = alloc;
+	}
+	r->rearm[r->num_rearm++] = ud;
+}
+
+/*
+ * Hand a completed read to its reader, then give the buffer back to
+ * the kernel and have the next read queued up. The reader may well
+ * unregister the socket, so we mustn't touch it afterwards.
+ */
+static void uring_deliver(iobroker_set *iobs, iobroker_fd *s)
+{
+	struct iob_uring *r = iobs->uring;
+	unsigned long long ud = uring_ud(s);
+	int len = s->rlen, bid = s->rbid;
+
+	if (!s->rready)
+		return;
+	s->rready = 0;
+	s->rbid = -1;
+
+	s->reader(s->fd, bid >= 0 ? r->rbufs + (size_t)bid * URING_RBUF_SIZE : NULL, len, s->arg);
+	if (bid >= 0)
+		uring_provide(r, bid, 1);
+
+	/* end of file and errors are final */
+	if (len > 0)
+		uring_defer_rearm(r, ud);
+}
+
+/*
+ * Wait for and collect completed requests into 'ready'. One-shot
+ * requests that fired last round are re-armed first, since their
+ * handlers have run by now. Completions for sockets that have since
+ * been unregistered or re-registered are dropped.
+ */
+static int uring_poll(iobroker_set *iobs, int timeout, struct epoll_event *ready, int max)
+{
+	struct iob_uring *r = iobs->uring;
+	unsigned int i, head, tail;
+	int n = 0;
+
+	for (i = 0; i < r->num_rearm; i++) {
+		int fd = (int)(r->rearm[i] & 0xffffffff);
+		iobroker_fd *s = fd < iobs->max_fds ? iobs->iobroker_fds[fd] : NULL;
+
+		if (s && uring_ud(s) == r->rearm[i])
+			uring_arm(r, s);
+	}
+	r->num_rearm = 0;
+
+	if (uring_enter(r, timeout) < 0)
+		return IOBROKER_ELIB;
+
+	head = *r->cq_head;
+	tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail && n < max; head++) {
+		struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+		int fd = (int)(cqe->user_data & 0xffffffff);
+		iobroker_fd *s;
+
+		if (cqe->user_data == URING_UD_IGNORE || fd < 0 || fd >= iobs->max_fds)
+			continue;
+		s = iobs->iobroker_fds[fd];
+		if (!s || s->gen != (unsigned int)(cqe->user_data >> 32)) {
+			/* a read we've since cancelled may still have used a buffer */
+			if (cqe->flags & IORING_CQE_F_BUFFER)
+				uring_provide(r, cqe->flags >> IORING_CQE_BUFFER_SHIFT, 1);
+			continue;
+		}
+
+		if (s->reader && r->rbufs) {
+			/* we're out of buffers. Try again once some come back */
+			if (cqe->res == -ENOBUFS) {
+				uring_defer_rearm(r, cqe->user_data);
+				continue;
+			}
+			s->rready = 1;
+			s->rlen = cqe->res;
+			s->rbid = -1;
+			if (cqe->flags & IORING_CQE_F_BUFFER)
+				s->rbid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+			ready[n].events = EPOLLIN;
+			ready[n].data.fd = fd;
+			n++;
+			continue;
+		}
+
+		if (cqe->res < 0) {
+			/* old kernels don't do multishot, so use one-shot polls instead */
+			if (cqe->res == -EINVAL && r->multishot && (s->flags & IOBROKER_EDGE_TRIGGERED)) {
+				r->multishot = 0;
+				uring_defer_rearm(r, cqe->user_data);
+			}
+			continue;
+		}
+		if (!(cqe->flags & IORING_CQE_F_MORE))
+			uring_defer_rearm(r, cqe->user_data);
+
+		ready[n].events = cqe->res;
+		ready[n].data.fd = fd;
+		n++;
+	}
+	__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+	return n;
+}
+#endif /* IOBROKER_HAS_URING */
+
+/*
+ * Read from a socket on behalf of its reader. Edge-triggered sockets
+ * are read until they run dry, or we wouldn't hear about the rest.
+ * The reader may unregister the socket, in which case we stop.
+ */
+static void iob_read(iobroker_set *iobs, iobroker_fd *s)
+{
+	int fd = s->fd;
+	ssize_t len;
+
+	if (!iobs->rbuf && !(iobs->rbuf = malloc(IOBROKER_READ_SIZE))) {
+		s->reader(fd, NULL, -ENOMEM, s->arg);
+		return;
+	}
+
+	for (;;) {
+		len = read(fd, iobs->rbuf, IOBROKER_READ_SIZE);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+
+		s->reader(fd, iobs->rbuf, len < 0 ? -errno : (int)len, s->arg);
+		if (len <= 0 || iobs->iobroker_fds[fd] != s || !(s->flags & IOBROKER_EDGE_TRIGGERED))
+			return;
+	}
+}
+
+/* call the handler, or the reader, of a socket that's ready */
+static void iob_fire(iobroker_set *iobs, iobroker_fd *s, int events)
+{
+	if (!s->reader) {
+		s->handler(s->fd, events, s->arg);
+		return;
+	}
+#ifdef IOBROKER_HAS_URING
+	if (iobs->uring && iobs->uring->rbufs) {
+		uring_deliver(iobs, s);
+		return;
+	}
+#endif
+	iob_read(iobs, s);
+}
+
 static struct {
 	int code;
 	const char *string;
@@ -172,7 +647,50 @@ error_out:
 	return NULL;
 }
 
-static int reg_one(iobroker_set *iobs, int fd, int events, void *arg, int (*handler)(int, int, void *))
+iobroker_set *iobroker_create_backend(int backend)
+{
+	iobroker_set *iobs;
+
+	if (!(iobs = iobroker_create()))
+		return NULL;
+
+#ifdef IOBROKER_HAS_URING
+	/* if the kernel won't give us a ring we stick with epoll() */
+	if (backend == IOBROKER_BACKEND_URING)
+		iobs->uring = uring_create();
+#endif
+
+	return iobs;
+}
+
+int iobroker_get_backend(iobroker_set *iobs)
+{
+	if (!iobs)
+		return IOBROKER_ENOSET;
+#ifdef IOBROKER_HAS_URING
+	if (iobs->uring)
+		return IOBROKER_BACKEND_URING;
+#endif
+	return IOBROKER_BACKEND_DEFAULT;
+}
+
+const char *iobroker_get_backend_name(iobroker_set *iobs)
+{
+#ifdef IOBROKER_HAS_URING
+	if (iobs && iobs->uring)
+		return "io_uring";
+#endif
+#if defined(IOBROKER_USES_EPOLL)
+	return "epoll";
+#elif defined(IOBROKER_USES_SELECT)
+	return "select";
+#else
+	return "poll";
+#endif
+}
+
+static int reg_one(iobroker_set *iobs, int fd, int events, int flags, void *arg,
+                   int (*handler)(int, int, void *), int (*reader)(int, char *, int, void *))
 {
 	iobroker_fd *s;
 
@@ -189,10 +707,35 @@ static int reg_one(iobroker_set *iobs, int fd, int events, void *arg, int (*hand
 	if (iobs->iobroker_fds[fd] != NULL)
 		return IOBROKER_EALREADY;
 
+#ifdef IOBROKER_HAS_URING
+	if (iobs->uring) {
+		s = calloc(1, sizeof(iobroker_fd));
+		if (!s)
+			return IOBROKER_ELIB;
+		s->handler = handler;
+		s->reader = reader;
+		s->rbid = -1;
+		s->fd = fd;
+		s->arg = arg;
+		s->events = events;
+		s->flags = flags;
+		s->gen = ++iobs->uring_gen;
+		if (uring_arm(iobs->uring, s) < 0) {
+			free(s);
+			return IOBROKER_ELIB;
+		}
+		iobs->iobroker_fds[fd] = s;
+		iobs->num_fds++;
+		return 0;
+	}
+#endif
+
 #ifdef IOBROKER_USES_EPOLL
 	{
 		struct epoll_event ev;
 		ev.events = events;
+		if (flags & IOBROKER_EDGE_TRIGGERED)
+			ev.events |= EPOLLET;
 		ev.data.ptr = arg;
 		ev.data.fd = fd;
 		if (epoll_ctl(iobs->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
@@ -203,9 +746,12 @@ static int reg_one(iobroker_set *iobs, int fd, int events, void *arg, int (*hand
 
 	s = calloc(1, sizeof(iobroker_fd));
 	s->handler = handler;
+	s->reader = reader;
+	s->rbid = -1;
 	s->fd = fd;
 	s->arg = arg;
 	s->events = events;
+	s->flags = flags;
 	iobs->iobroker_fds[fd] = s;
 	iobs->num_fds++;
 
@@ -213,20 +759,36 @@ static int reg_one(iobroker_set *iobs, int fd, int events, void *arg, int (*hand
 }
 
 int iobroker_register(iobroker_set *iobs, int fd, void *arg, int (*handler)(int, int, void *))
+{
+	return iobroker_register_flags(iobs, fd, arg, handler, 0);
+}
+
+int iobroker_register_flags(iobroker_set *iobs, int fd, void *arg, int (*handler)(int, int, void *), int flags)
 {
 #ifdef IOBROKER_USES_EPOLL
-	return reg_one(iobs, fd, EPOLLIN | EPOLLRDHUP, arg, handler);
+	return reg_one(iobs, fd, EPOLLIN | EPOLLRDHUP, flags, arg, handler, NULL);
 #else
-	return reg_one(iobs, fd, POLLIN, arg, handler);
+	return reg_one(iobs, fd, POLLIN, flags, arg, handler, NULL);
+#endif
+}
+
+int iobroker_register_reader(iobroker_set *iobs, int fd, void *arg, int (*reader)(int, char *, int, void *), int flags)
+{
+	if (!reader)
+		return IOBROKER_EINVAL;
+#ifdef IOBROKER_USES_EPOLL
+	return reg_one(iobs, fd, EPOLLIN | EPOLLRDHUP, flags, arg, NULL, reader);
+#else
+	return reg_one(iobs, fd, POLLIN, flags, arg, NULL, reader);
 #endif
 }
 
 int iobroker_register_out(iobroker_set *iobs, int fd, void *arg, int (*handler)(int, int, void *))
 {
 #ifdef IOBROKER_USES_EPOLL
-	return reg_one(iobs, fd, EPOLLOUT, arg, handler);
+	return reg_one(iobs, fd, EPOLLOUT, 0, arg, handler, NULL);
 #else
-	return reg_one(iobs, fd, POLLOUT, arg, handler);
+	return reg_one(iobs, fd, POLLOUT, 0, arg, handler, NULL);
 #endif
 }
 
@@ -249,6 +811,23 @@ int iobroker_unregister(iobroker_set *iobs, int fd)
 	if (fd < 0 || fd >= iobs->max_fds || !iobs->iobroker_fds[fd])
 		return IOBROKER_EINVAL;
 
+#ifdef IOBROKER_HAS_URING
+	if (iobs->uring) {
+		iobroker_fd *s = iobs->iobroker_fds[fd];
+		int ret;
+
+		/* data nobody will read now, but the buffer must go back */
+		if (s->rready && s->rbid >= 0)
+			uring_provide(iobs->uring, s->rbid, 1);
+		ret = uring_disarm(iobs->uring, s);
+		free(iobs->iobroker_fds[fd]);
+		iobs->iobroker_fds[fd] = NULL;
+		if (iobs->num_fds > 0)
+			iobs->num_fds--;
+		return ret;
+	}
+#endif
+
 	free(iobs->iobroker_fds[fd]);
 	iobs->iobroker_fds[fd] = NULL;
 	if (iobs->num_fds > 0)
@@ -315,6 +894,11 @@ void iobroker_destroy(iobroker_set *iobs, int flags)
 	}
 	free(iobs->iobroker_fds);
 	iobs->iobroker_fds = NULL;
+	free(iobs->rbuf);
+#ifdef IOBROKER_HAS_URING
+	if (iobs->uring)
+		uring_destroy(iobs->uring);
+#endif
 #ifdef IOBROKER_USES_EPOLL
 	free(iobs->ep_events);
 	close(iobs->epfd);
@@ -334,6 +918,11 @@ int iobroker_poll(iobroker_set *iobs, int timeout)
 		return IOBROKER_ENOINIT;
 
 #if defined(IOBROKER_USES_EPOLL)
+#ifdef IOBROKER_HAS_URING
+	if (iobs->uring)
+		nfds = uring_poll(iobs, timeout, iobs->ep_events, iobs->max_fds);
+	else
+#endif
 	nfds = epoll_wait(iobs->epfd, iobs->ep_events, iobs->num_fds, timeout);
 	if (nfds < 0) {
 		return IOBROKER_ELIB;
@@ -350,7 +939,7 @@ int iobroker_poll(iobroker_set *iobs, int timeout)
 		s = iobs->iobroker_fds[fd];
 
 		if (s) {
-			s->handler(fd, iobs->ep_events[i].events, s->arg);
+			iob_fire(iobs, s, iobs->ep_events[i].events);
 			ret++;
 		}
 	}
@@ -395,7 +984,7 @@ int iobroker_poll(iobroker_set *iobs, int timeout)
 					/* this should be logged somehow */
 					continue;
 				}
-				s->handler(s->fd, POLLIN, s->arg);
+				iob_fire(iobs, s, POLLIN);
 				ret++;
 			}
 		}
@@ -430,7 +1019,114 @@ int iobroker_poll(iobroker_set *iobs, int timeout)
 				/* this should be logged somehow */
 				continue;
 			}
-			s->handler(s->fd, (int)iobs->pfd[i].revents, s->arg);
+			iob_fire(iobs, s, (int)iobs->pfd[i].revents);
+			ret++;
+		}
+	}
+#endif
+
+	return ret;
+}
+
+
+int iobroker_poll_batch(iobroker_set *iobs, int timeout, iobroker_event *ready, int max)
+{
+	int i, nfds, ret = 0;
+
+	if (!iobs)
+		return IOBROKER_ENOSET;
+
+	if (!iobs->num_fds)
+		return IOBROKER_ENOINIT;
+
+	if (!ready || max <= 0)
+		return IOBROKER_EINVAL;
+
+#if defined(IOBROKER_USES_EPOLL)
+#ifdef IOBROKER_HAS_URING
+	if (iobs->uring)
+		nfds = uring_poll(iobs, timeout, iobs->ep_events, max < iobs->max_fds ? max : iobs->max_fds);
+	else
+#endif
+	nfds = epoll_wait(iobs->epfd, iobs->ep_events, max < iobs->num_fds ? max : iobs->num_fds, timeout);
+	if (nfds < 0) {
+		return IOBROKER_ELIB;
+	}
+
+	for (i = 0; i < nfds; i++) {
+		int fd = iobs->ep_events[i].data.fd;
+		iobroker_fd *s;
+
+		if (fd < 0 || fd >= iobs->max_fds || !(s = iobs->iobroker_fds[fd])) {
+			continue;
+		}
+		ready[ret].fd = fd;
+		ready[ret].events = iobs->ep_events[i].events;
+		ready[ret].flags = s->flags;
+		ready[ret].arg = s->arg;
+		ret++;
+	}
+#elif defined(IOBROKER_USES_SELECT)
+	{
+		fd_set read_fds;
+		int num_fds = 0;
+		struct timeval tv;
+
+		FD_ZERO(&read_fds);
+		for (i = 0; i < iobs->max_fds; i++) {
+			if (!iobs->iobroker_fds[i])
+				continue;
+			num_fds++;
+			FD_SET(iobs->iobroker_fds[i]->fd, &read_fds);
+			if (num_fds == iobs->num_fds)
+				break;
+		}
+		if (timeout >= 0) {
+			tv.tv_sec = timeout / 1000;
+			tv.tv_usec = (timeout % 1000) * 1000;
+			nfds = select(iobs->max_fds, &read_fds, NULL, NULL, &tv);
+		} else {
+			nfds = select(iobs->max_fds, &read_fds, NULL, NULL, NULL);
+		}
+		if (nfds < 0) {
+			return IOBROKER_ELIB;
+		}
+		for (i = 0; i < iobs->max_fds && ret < max; i++) {
+			iobroker_fd *s = iobs->iobroker_fds[i];
+			if (!s || !FD_ISSET(s->fd, &read_fds))
+				continue;
+			ready[ret].fd = s->fd;
+			ready[ret].events = POLLIN;
+			ready[ret].flags = s->flags;
+			ready[ret].arg = s->arg;
+			ret++;
+		}
+	}
+#else
+	{
+		int p = 0;
+
+		for (i = 0; i < iobs->max_fds; i++) {
+			if (!iobs->iobroker_fds[i])
+				continue;
+			iobs->pfd[p].fd = iobs->iobroker_fds[i]->fd;
+			iobs->pfd[p].events = POLLIN;
+			p++;
+		}
+		nfds = poll(iobs->pfd, p, timeout);
+		if (nfds < 0) {
+			return IOBROKER_ELIB;
+		}
+		for (i = 0; i < p && ret < max; i++) {
+			iobroker_fd *s;
+			if (iobs->pfd[i].revents == 0)
+				continue;
+			if (!(s = iobs->iobroker_fds[iobs->pfd[i].fd]))
+				continue;
+			ready[ret].fd = s->fd;
+			ready[ret].events = (int)iobs->pfd[i].revents;
+			ready[ret].flags = s->flags;
+			ready[ret].arg = s->arg;
 			ret++;
 		}
 	}
@@ -438,3 +1134,19 @@ int iobroker_poll(iobroker_set *iobs, int timeout)
 
 	return ret;
 }
+
+int iobroker_dispatch(iobroker_set *iobs, iobroker_event *ev)
+{
+	iobroker_fd *s;
+
+	if (!iobs || !ev || ev->fd < 0 || ev->fd >= iobs->max_fds)
+		return 0;
+
+	/* an earlier handler may have closed or replaced this one */
+	s = iobs->iobroker_fds[ev->fd];
+	if (!s || s->arg != ev->arg)
+		return 0;
+
+	iob_fire(iobs, s, ev->events);
+	return 1;
+}
@@ -199,18 +199,16 @@ int iocache_read(iocache *ioc, int fd)
 	/* if we've maxed out our buflen, grow by 2x to be safe */
 	if (ioc->ioc_buflen >= ioc->ioc_bufsize) {
 
-		to_read = ioc->ioc_buflen + ioc->ioc_bufsize;
 		ret = iocache_grow(ioc, ioc->ioc_bufsize);
 		if (ret == -1) {
-			to_read = ioc->ioc_buflen;
+			errno = ENOMEM;
+			return -1;
 		}
-
-	} else {
-
-		/* calculate the size we should read */
-		to_read = ioc->ioc_bufsize - ioc->ioc_buflen;
 	}
 
+	/* calculate the size we should read */
+	to_read = ioc->ioc_bufsize - ioc->ioc_buflen;
+
 	bytes_read = read(fd, ioc->ioc_buf + ioc->ioc_buflen, to_read);
 	if (bytes_read > 0) {
 		ioc->ioc_buflen += bytes_read;
@@ -225,7 +223,8 @@ int iocache_add(iocache *ioc, char *buf, unsigned int len)
 	if (!ioc || iocache_capacity(ioc) < len)
 		return -1;
 
-	memcpy(ioc->ioc_buf + ioc->ioc_offset, buf, len);
+	/* iocache_capacity() has moved unread data to the front */
+	memcpy(ioc->ioc_buf + ioc->ioc_buflen, buf, len);
 	ioc->ioc_buflen += len;
 	return ioc->ioc_buflen - ioc->ioc_offset;
 }
@@ -345,3 +345,140 @@ struct kvvec *buf2kvvec(char *str, unsigned int len, const char kvsep,
 	free(kvv);
 	return NULL;
 }
+
+/*
+ * Binary key/value buffers. Each pair is laid out as
+ *   <key_len:4><value_len:4><key>\0<value>\0
+ * with both lengths in network byte order. The trailing nul bytes
+ * cost us two bytes per pair, but mean a receiver can hand out
+ * pointers straight into the buffer without copying anything.
+ */
+#define KVVEC_BPAIR_OVERHEAD 10
+
+static inline void put_u32(char *buf, unsigned int val)
+{
+	unsigned char *p = (unsigned char *)buf;
+	p[0] = (val >> 24) & 0xff;
+	p[1] = (val >> 16) & 0xff;
+	p[2] = (val >> 8) & 0xff;
+	p[3] = val & 0xff;
+}
+
+static inline unsigned int get_u32(const char *buf)
+{
+	const unsigned char *p = (const unsigned char *)buf;
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+		((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+unsigned long kvvec_bbuf_len(struct kvvec *kvv)
+{
+	unsigned long len = 0;
+	int i;
+
+	if (!kvv)
+		return 0;
+
+	for (i = 0; i < kvv->kv_pairs; i++) {
+		len += KVVEC_BPAIR_OVERHEAD + kvv->kv[i].key_len + kvv->kv[i].value_len;
+	}
+
+	return len;
+}
+
+unsigned long kvvec2bbuf(struct kvvec *kvv, char *buf, unsigned long bufsize)
+{
+	unsigned long len = 0;
+	int i;
+
+	if (!kvv || !buf || bufsize < kvvec_bbuf_len(kvv))
+		return 0;
+
+	for (i = 0; i < kvv->kv_pairs; i++) {
+		struct key_value *kv = &kvv->kv[i];
+		put_u32(buf + len, kv->key_len);
+		put_u32(buf + len + 4, kv->value_len);
+		len += 8;
+		memcpy(buf + len, kv->key, kv->key_len);
+		len += kv->key_len;
+		buf[len++] = 0;
+		if (kv->value_len) {
+			memcpy(buf + len, kv->value, kv->value_len);
+			len += kv->value_len;
+		}
+		buf[len++] = 0;
+	}
+
+	return len;
+}
+
+int bbuf2kvvec_prealloc(struct kvvec *kvv, char *buf, unsigned long len, int flags)
+{
+	unsigned long offset = 0;
+	int num_pairs = 0;
+
+	if (!buf || !len || !kvv)
+		return -1;
+
+	/* count and validate first, so we never resize halfway through */
+	while (offset < len) {
+		unsigned long klen, vlen;
+
+		if (len - offset < KVVEC_BPAIR_OVERHEAD)
+			return -1;
+		klen = get_u32(buf + offset);
+		vlen = get_u32(buf + offset + 4);
+		if (klen + vlen > len - offset - KVVEC_BPAIR_OVERHEAD)
+			return -1;
+		offset += KVVEC_BPAIR_OVERHEAD + klen + vlen;
+		num_pairs++;
+	}
+
+	if (!(flags & KVVEC_APPEND)) {
+		if (!kvvec_init(kvv, num_pairs))
+			return -1;
+	} else if (kvvec_capacity(kvv) < num_pairs && kvvec_resize(kvv, kvv->kv_pairs + num_pairs) < 0) {
+		return -1;
+	}
+
+	for (offset = 0; offset < len;) {
+		struct key_value *kv = &kvv->kv[kvv->kv_pairs++];
+		char *key, *value;
+
+		kv->key_len = get_u32(buf + offset);
+		kv->value_len = get_u32(buf + offset + 4);
+		key = buf + offset + 8;
+		value = key + kv->key_len + 1;
+		offset += KVVEC_BPAIR_OVERHEAD + kv->key_len + kv->value_len;
+
+		if (flags & KVVEC_COPY) {
+			kv->key = malloc(kv->key_len + 1);
+			kv->value = malloc(kv->value_len + 1);
+			memcpy(kv->key, key, kv->key_len);
+			memcpy(kv->value, value, kv->value_len);
+		} else {
+			kv->key = key;
+			kv->value = value;
+		}
+		kv->key[kv->key_len] = 0;
+		kv->value[kv->value_len] = 0;
+	}
+	kvv->kvv_sorted = 0;
+
+	return num_pairs;
+}
+
+struct kvvec *bbuf2kvvec(char *buf, unsigned long len, int flags)
+{
+	struct kvvec *kvv;
+
+	kvv = kvvec_create(len / 40);
+	if (!kvv)
+		return NULL;
+
+	if (bbuf2kvvec_prealloc(kvv, buf, len, flags) >= 0)
+		return kvv;
+
+	kvvec_destroy(kvv, (flags & KVVEC_COPY) ? KVVEC_FREE_ALL : 0);
+	return NULL;
+}
@@ -203,5 +203,53 @@ extern struct kvvec *buf2kvvec(char *str, unsigned int len, const char kvsep, co
  * @return The number of pairs in the created key/value vector
  */
 extern int buf2kvvec_prealloc(struct kvvec *kvv, char *str, unsigned int len, const char kvsep, const char pair_sep, int flags);
+
+/**
+ * Calculate the size of the binary buffer kvvec2bbuf() would
+ * produce for a key/value vector.
+ *
+ * @param kvv The key/value vector
+ * @return The number of bytes needed to hold the binary buffer
+ */
+extern unsigned long kvvec_bbuf_len(struct kvvec *kvv);
+
+/**
+ * Serialize a key/value vector into a caller-supplied buffer using
+ * the binary format. Every pair is written as its key length and
+ * value length (4 bytes each, network byte order), followed by the
+ * key and the value, each terminated by a nul byte. Since nothing
+ * is escaped, keys and values may contain any bytes at all.
+ *
+ * @param kvv The key/value vector to convert
+ * @param buf The buffer to write into
+ * @param bufsize Size of 'buf'. Must be at least kvvec_bbuf_len(kvv)
+ * @return The number of bytes written, or 0 on errors
+ */
+extern unsigned long kvvec2bbuf(struct kvvec *kvv, char *buf, unsigned long bufsize);
+
+/**
+ * Parse a binary buffer created by kvvec2bbuf() into a
+ * pre-allocated key/value vector. With KVVEC_ASSIGN, keys and
+ * values point straight into 'buf', which must outlive the
+ * vector.
+ *
+ * @param kvv A pre-allocated key/value vector to populate
+ * @param buf The buffer to parse
+ * @param len Length of 'buf'
+ * @param flags bitmask. See KVVEC_{ASSIGN,COPY,APPEND} for values
+ * @return The number of pairs parsed, or -1 on malformed input
+ */
+extern int bbuf2kvvec_prealloc(struct kvvec *kvv, char *buf, unsigned long len, int flags);
+
+/**
+ * Create a key/value vector from a binary buffer created by
+ * kvvec2bbuf().
+ *
+ * @param buf The buffer to parse
+ * @param len Length of 'buf'
+ * @param flags bitmask. See KVVEC_{ASSIGN,COPY} for values
+ * @return The created key/value vector, or NULL on errors
+ */
+extern struct kvvec *bbuf2kvvec(char *buf, unsigned long len, int flags);
 /** @} */
 #endif /* INCLUDE_kvvec_h__ */
@@ -180,7 +180,16 @@ pqueue_change_priority(pqueue_t *q, pqueue_pri_t new_pri, void *d)
 int
 pqueue_remove(pqueue_t *q, void *d)
 {
-	unsigned int posn = q->getpos(d);
+	unsigned int posn;
+
+	if (!q || !d)
+		return 1;
+
+	/* not ours to remove */
+	posn = q->getpos(d);
+	if (!posn || posn >= q->size || q->d[posn] != d)
+		return 1;
+
 	q->d[posn] = q->d[--q->size];
 	if (q->cmppri(q->getpri(d), q->getpri(q->d[posn]))) {
 		bubble_up(q, posn);
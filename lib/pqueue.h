@@ -137,7 +137,7 @@ void *pqueue_pop(pqueue_t *q);
  * remove an item from the queue.
  * @param q the queue
  * @param d the entry
- * @return 0 on success
+ * @return 0 on success, non-zero if the entry isn't in the queue
  */
 int pqueue_remove(pqueue_t *q, void *d);
 
@@ -22,9 +22,16 @@
 #include <sys/wait.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <fcntl.h>
 #include <errno.h>
 #include "runcmd.h"
 
+#if defined(_POSIX_SPAWN) && _POSIX_SPAWN > 0
+# include <spawn.h>
+# define HAVE_POSIX_SPAWN
+extern char **environ;
+#endif
+
 
 /** macros **/
 #ifndef WEXITSTATUS
@@ -67,6 +74,8 @@ static int maxfd = 0;
 # endif /* _SC_OPEN_MAX */
 #endif /* OPEN_MAX */
 
+static int spawn_method = RUNCMD_SPAWN_FORK;
+
 
 const char *runcmd_strerror(int code)
 {
@@ -328,79 +337,181 @@ void runcmd_init(void)
 static int runcmd_setenv(const char *name, const char *value);
 int update_environment(char *name, char *value, int set);
 
-/* Start running a command */
-/* The definition declares nonnull arguments, so checking for these
-   arguments as null results in a compiler warning. */
-int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
-		void (*iobreg)(int, int, void *), void *iobregarg)
+int runcmd_set_spawn_method(int method)
 {
-	char **argv = NULL;
-	int argc = 0;
-	int cmd2strv_errors;
-	size_t cmdlen;
-	pid_t pid;
+	if (method == RUNCMD_SPAWN_FORK) {
+		spawn_method = method;
+		return 0;
+	}
+#ifdef HAVE_POSIX_SPAWN
+	if (method == RUNCMD_SPAWN_POSIX) {
+		spawn_method = method;
+		return 0;
+	}
+#endif
+	return RUNCMD_EINVAL;
+}
 
-	int i = 0;
+int runcmd_get_spawn_method(void)
+{
+	return spawn_method;
+}
 
-	if (!pids) {
-		runcmd_init();
+#ifdef HAVE_POSIX_SPAWN
+/* add or replace a "name=value" string in envp */
+static void envp_set(char **envp, int *envc, char *str)
+{
+	size_t len = strcspn(str, "=") + 1;
+	int i;
+
+	for (i = 0; i < *envc; i++) {
+		if (!strncmp(envp[i], str, len)) {
+			envp[i] = str;
+			return;
+		}
 	}
+	envp[(*envc)++] = str;
+}
 
-	/* We can't do anything without a command, or FD arrays. */
-	if (cmd == NULL || *cmd == NULL || pfd == NULL || pfderr == NULL) {
-		return RUNCMD_EINVAL;
+/*
+ * posix_spawn() can't setenv() in the child, so we build the child's
+ * environment up front instead. That's our own environment, with
+ * the pairs in 'env' and the VAR=value prefixes in 'vars' on top.
+ * The strings from 'env' get glued together in 'buf', which the
+ * caller must free() along with the returned array.
+ */
+static char **runcmd_build_envp(char **env, char **vars, int nvars, char **buf)
+{
+	char **envp, **e, *p;
+	int envc = 0, n = nvars + 1;
+	size_t len = 0;
+
+	for (e = environ; *e; e++)
+		n++;
+	for (e = env; e && e[0] && e[1]; e += 2) {
+		len += strlen(e[0]) + strlen(e[1]) + 2;
+		n++;
 	}
 
-	cmdlen = strlen(cmd);
-	argv = calloc((cmdlen / 2) + 5, sizeof(char *));
-	if (!argv) {
-		return RUNCMD_EALLOC;
+	if (!(envp = malloc(n * sizeof(char *))))
+		return NULL;
+	if (!(p = *buf = malloc(len + 1))) {
+		free(envp);
+		return NULL;
 	}
 
-	cmd2strv_errors = runcmd_cmd2strv(cmd, &argc, argv);
+	for (e = environ; *e; e++)
+		envp[envc++] = *e;
+	for (e = env; e && e[0] && e[1]; e += 2) {
+		char *str = p;
+		p += sprintf(p, "%s=%s", e[0], e[1]) + 1;
+		envp_set(envp, &envc, str);
+	}
+	for (n = 0; n < nvars; n++)
+		envp_set(envp, &envc, vars[n]);
+	envp[envc] = NULL;
 
-	/* We couldn't allocate the parsed argument array. */
-	if (cmd2strv_errors == RUNCMD_EALLOC) {
-		free(argv);
-		return RUNCMD_EALLOC;
+	return envp;
+}
+
+/*
+ * Start argv with posix_spawn(). Returns the child's pid, or -1 if
+ * the command should be started the old-fashioned way instead.
+ */
+static pid_t runcmd_spawn(char **argv, int argc, int raw, char **env, int *pfd, int *pfderr)
+{
+	posix_spawn_file_actions_t fa;
+	posix_spawnattr_t attr;
+	char **envp = environ, *envbuf = NULL;
+	short flags = POSIX_SPAWN_SETPGROUP;
+	pid_t pid;
+	int i = 0, ret;
+
+	/* VAR=value prefixes go into the environment */
+	if (!raw) {
+		for (; i < argc && strchr(argv[i], '='); i++)
+			;
+		/* let the fork() path complain about missing commands */
+		if (i == argc)
+			return -1;
 	}
 
-	/* Run complex commands via the shell. */
-	if (cmd2strv_errors) {
+	if ((env && env[0]) || i) {
+		if (!(envp = runcmd_build_envp(env, argv, i, &envbuf)))
+			return -1;
+	}
 
-		free(argv[0]);
-		argv[0] = "/bin/sh";
-		argv[1] = "-c";
-		argv[2] = strdup(cmd);
-		if (!argv[2]) {
-			free(argv);
-			return RUNCMD_EALLOC;
-		}
-		argv[3] = NULL;
+	/*
+	 * All pipe ends are close-on-exec, so we only need to hook up
+	 * stdout and stderr. dup2() clears the flag on the copies.
+	 */
+	posix_spawn_file_actions_init(&fa);
+	posix_spawn_file_actions_adddup2(&fa, pfd[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&fa, pfderr[1], STDERR_FILENO);
+
+	/* our children must be process group leaders so we can kill them */
+	posix_spawnattr_init(&attr);
+#ifdef POSIX_SPAWN_USEVFORK
+	flags |= POSIX_SPAWN_USEVFORK;
+#endif
+	posix_spawnattr_setflags(&attr, flags);
+	posix_spawnattr_setpgroup(&attr, 0);
+
+	ret = posix_spawnp(&pid, argv[i], &fa, &attr, argv + i, envp);
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&fa);
+	if (envp != environ) {
+		free(envp);
+		free(envbuf);
 	}
 
+	return ret ? -1 : pid;
+}
+#endif /* HAVE_POSIX_SPAWN */
+
+/*
+ * Hook up the pipes and start argv. With raw set, argv is executed
+ * exactly as given. Otherwise leading VAR=value arguments are put in
+ * the child's environment, the way a shell would.
+ * Returns the child's stdout fd, or one of the RUNCMD_E* codes.
+ */
+static int runcmd_start(char **argv, int argc, int raw, int *pfd, int *pfderr,
+		char **env, void (*iobreg)(int, int, void *), void *iobregarg)
+{
+	pid_t pid;
+	int i = 0;
+
 	if (pipe(pfd) < 0) {
-		free(!cmd2strv_errors ? argv[0] : argv[2]);
-		free(argv);
 		return RUNCMD_EFD;
 	}
 
 	if (pipe(pfderr) < 0) {
-		free(!cmd2strv_errors ? argv[0] : argv[2]);
-		free(argv);
 		close(pfd[0]);
 		close(pfd[1]);
 		return RUNCMD_EFD;
 	}
 
+	if (spawn_method == RUNCMD_SPAWN_POSIX) {
+		/* keep other children from inheriting these pipes */
+		fcntl(pfd[0], F_SETFD, FD_CLOEXEC);
+		fcntl(pfd[1], F_SETFD, FD_CLOEXEC);
+		fcntl(pfderr[0], F_SETFD, FD_CLOEXEC);
+		fcntl(pfderr[1], F_SETFD, FD_CLOEXEC);
+	}
+
 	if (iobreg) {
 		iobreg(pfd[0], pfderr[0], iobregarg);
 	}
 
+#ifdef HAVE_POSIX_SPAWN
+	pid = -1;
+	if (spawn_method == RUNCMD_SPAWN_POSIX)
+		pid = runcmd_spawn(argv, argc, raw, env, pfd, pfderr);
+	if (pid < 0)
+#endif
 	pid = fork();
 	if (pid < 0) {
-		free(!cmd2strv_errors ? argv[0] : argv[2]);
-		free(argv);
 		close(pfd[0]);
 		close(pfd[1]);
 		close(pfderr[0]);
@@ -461,7 +572,7 @@ int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
 
 		/* Add VAR=value arguments from simple commands to the environment. */
 		i = 0;
-		if (!cmd2strv_errors) {
+		if (!raw) {
 			char *ev;
 			for (; i < argc && (ev = strchr(argv[i], '=')); ++i) {
 				if (*ev) *ev++ = '\0';
@@ -485,22 +596,13 @@ int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
 		fprintf(stderr, "execvp(%s, ...) failed. errno is %d: %s\n", argv[i], errno, strerror(errno));
 
 child_error_exit:
-		/* Free argv memory before exiting so valgrind doesn't see it as a leak. */
-		free(!cmd2strv_errors ? argv[0] : argv[2]);
-		free(argv);
 		_exit(exit_status);
 	}
 
 	/* parent picks up execution here */
-	/*
-	 * close childs file descriptors in our address space and
-	 * release the memory we used that won't get passed to the
-	 * caller.
-	 */
+	/* close childs file descriptors in our address space */
 	close(pfd[1]);
 	close(pfderr[1]);
-	free(!cmd2strv_errors ? argv[0] : argv[2]);
-	free(argv);
 
 	/* tag our file's entry in the pid-list and return it */
 	pids[pfd[0]] = pid;
@@ -508,6 +610,84 @@ child_error_exit:
 	return pfd[0];
 }
 
+/* Start running a command */
+/* The definition declares nonnull arguments, so checking for these
+   arguments as null results in a compiler warning. */
+int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
+		void (*iobreg)(int, int, void *), void *iobregarg)
+{
+	char **argv = NULL;
+	int argc = 0;
+	int cmd2strv_errors;
+	size_t cmdlen;
+	int ret;
+
+	if (!pids) {
+		runcmd_init();
+	}
+
+	/* We can't do anything without a command, or FD arrays. */
+	if (cmd == NULL || *cmd == NULL || pfd == NULL || pfderr == NULL) {
+		return RUNCMD_EINVAL;
+	}
+
+	cmdlen = strlen(cmd);
+	argv = calloc((cmdlen / 2) + 5, sizeof(char *));
+	if (!argv) {
+		return RUNCMD_EALLOC;
+	}
+
+	cmd2strv_errors = runcmd_cmd2strv(cmd, &argc, argv);
+
+	/* We couldn't allocate the parsed argument array. */
+	if (cmd2strv_errors == RUNCMD_EALLOC) {
+		free(argv);
+		return RUNCMD_EALLOC;
+	}
+
+	/* Run complex commands via the shell. */
+	if (cmd2strv_errors) {
+
+		free(argv[0]);
+		argv[0] = "/bin/sh";
+		argv[1] = "-c";
+		argv[2] = strdup(cmd);
+		if (!argv[2]) {
+			free(argv);
+			return RUNCMD_EALLOC;
+		}
+		argv[3] = NULL;
+		argc = 3;
+	}
+
+	ret = runcmd_start(argv, argc, cmd2strv_errors, pfd, pfderr, env, iobreg, iobregarg);
+
+	/* release the memory we used that won't get passed to the caller */
+	free(!cmd2strv_errors ? argv[0] : argv[2]);
+	free(argv);
+
+	return ret;
+}
+
+int runcmd_open_argv(char **argv, int *pfd, int *pfderr, char **env,
+		void (*iobreg)(int, int, void *), void *iobregarg)
+{
+	int argc;
+
+	if (!pids) {
+		runcmd_init();
+	}
+
+	if (!argv || !argv[0] || !*argv[0] || !pfd || !pfderr) {
+		return RUNCMD_EINVAL;
+	}
+
+	for (argc = 1; argv[argc]; argc++)
+		;
+
+	return runcmd_start(argv, argc, 1, pfd, pfderr, env, iobreg, iobregarg);
+}
+
 
 int runcmd_close(int fd)
 {
@@ -41,6 +41,10 @@
 #define RUNCMD_EINVAL (-5)  /**< Invalid parameters */
 #define RUNCMD_EWAIT  (-6)  /**< Failed to wait() */
 
+/** Ways to start child processes, for runcmd_set_spawn_method() */
+#define RUNCMD_SPAWN_FORK  0 /**< fork() and exec (the default) */
+#define RUNCMD_SPAWN_POSIX 1 /**< posix_spawn(), falling back to fork() */
+
 /**
  * Initialize the runcmd library.
  *
@@ -51,6 +55,27 @@
  */
 extern void runcmd_init(void);
 
+/**
+ * Select how runcmd_open() starts child processes
+ * With RUNCMD_SPAWN_POSIX, children are started with posix_spawn(),
+ * which (on Linux, at least) uses vfork() semantics and so doesn't
+ * have to copy the caller's page tables. That makes a huge difference
+ * for processes with lots of memory that launch lots of programs.
+ * Commands that can't be started that way (f.e. because the program
+ * doesn't exist) are retried with fork(), so errors are reported the
+ * same way regardless of the spawn method.
+ * This should be called before any commands are started.
+ * @param method One of the RUNCMD_SPAWN_* values
+ * @return 0 on success, RUNCMD_EINVAL if the method isn't supported
+ */
+extern int runcmd_set_spawn_method(int method);
+
+/**
+ * Get the method runcmd_open() uses to start child processes
+ * @return One of the RUNCMD_SPAWN_* values
+ */
+extern int runcmd_get_spawn_method(void);
+
 /**
  * Return pid of a command with a specific file descriptor
  * @param[in] fd stdout filedescriptor of the child to get pid from
@@ -77,6 +102,23 @@ extern const char *runcmd_strerror(int code);
 extern int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env,
 		void (*iobreg)(int, int, void *), void *iobregarg);
 
+/**
+ * Start a command from an already split argument vector
+ * This skips parsing the command string entirely, so it's meant for
+ * callers that have tokenized the command up front. argv is executed
+ * as-is, without a shell. VAR=value prefixes are not handled, so
+ * argv[0] must name the program to run.
+ * @param[in] argv NULL-terminated argument vector
+ * @param[out] pfd Child's stdout filedescriptor
+ * @param[out] pfderr Child's stderr filedescriptor
+ * @param[in] env Environment variables to set, as name/value pairs
+ * @param[in] iobreg The callback function to register the iobrokers for the read ends of the pipe
+ * @param[in] iobregarg The "arg" value to pass to iobroker_register()
+ * @return The child's stdout fd on success, one of the RUNCMD_E* codes on errors
+ */
+extern int runcmd_open_argv(char **argv, int *pfd, int *pfderr, char **env,
+		void (*iobreg)(int, int, void *), void *iobregarg);
+
 /**
  * Close a command and return its exit status
  * @note Don't use this. It's a retarded way to reap children suitable
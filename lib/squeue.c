@@ -7,10 +7,16 @@
  * the implementation details of the pqueue's binary heap from the
  * callers.
  *
+ * With the default heap backend:
  * peek() is O(1)
  * add(), pop() and remove() are O(lg n), although remove() is
  * impossible unless caller maintains the pointer to the scheduled
  * event.
+ *
+ * The timing wheel backend files events by whole seconds into a
+ * hierarchy of 256-slot wheels and only keeps the events due in the
+ * current second in a (small) binary heap, so add(), pop() and
+ * remove() are O(1) amortized for events within the horizon.
  */
 
 #include <stdlib.h>
@@ -21,11 +27,36 @@
 #include "squeue.h"
 #include "pqueue.h"
 
+/* where a timing wheel event currently lives, unless it's in a slot */
+#define SQ_SLOT_HEAP     -1 /* due at or before the wheel cursor */
+#define SQ_SLOT_OVERFLOW -2 /* beyond the reach of the outermost wheel */
+
+#define SQ_WHEEL_BITS   8
+#define SQ_WHEEL_SLOTS  (1 << SQ_WHEEL_BITS)
+#define SQ_WHEEL_MASK   (SQ_WHEEL_SLOTS - 1)
+#define SQ_MAX_LEVELS   4
+#define SQ_WHEEL_HEAP_SIZE 1023
+#define SQ_MAPBITS      (sizeof(unsigned int) * 8)
+#define SQ_MAPWORDS     (SQ_WHEEL_SLOTS / SQ_MAPBITS)
+
 struct squeue_event {
 	unsigned int pos;
 	pqueue_pri_t pri;
 	struct timeval when;
 	void *data;
+	int slot;
+	struct squeue_event *next, *prev;
+};
+
+struct squeue {
+	int backend;
+	unsigned int size;
+	pqueue_t *pq;        /* all events, or the ones due at 'cursor' */
+	pqueue_t *overflow;  /* wheel events too far out for 'slots' */
+	unsigned long long cursor; /* wheel time, in seconds */
+	unsigned int levels;
+	struct squeue_event *slots[SQ_MAX_LEVELS][SQ_WHEEL_SLOTS];
+	unsigned int map[SQ_MAX_LEVELS][SQ_MAPWORDS];
 };
 
 /*
@@ -94,17 +125,205 @@ void *squeue_event_data(squeue_event *evt)
 	return NULL;
 }
 
-squeue_t *squeue_create(unsigned int horizon)
+/*
+ * Timing wheel helpers.
+ * An event due at 't' is filed on the level of the most significant
+ * byte in which 't' differs from the cursor, in the slot indexed by
+ * that byte of 't'. Every event on a level is thus later than all
+ * events on the levels below it, so the next event is always found
+ * in the first occupied slot of the lowest non-empty level.
+ */
+static int wheel_next_slot(squeue_t *q, unsigned int level, unsigned int from)
+{
+	unsigned int i = from, word;
+
+	while (i < SQ_WHEEL_SLOTS) {
+		word = q->map[level][i / SQ_MAPBITS] >> (i % SQ_MAPBITS);
+		if (!word) {
+			i = ((i / SQ_MAPBITS) + 1) * SQ_MAPBITS;
+			continue;
+		}
+		for (; !(word & 1); word >>= 1)
+			i++;
+		return i;
+	}
+
+	return -1;
+}
+
+static int wheel_file(squeue_t *q, squeue_event *evt)
+{
+	unsigned long long t = evt->when.tv_sec, diff;
+	unsigned int level, idx;
+
+	if (t <= q->cursor) {
+		evt->slot = SQ_SLOT_HEAP;
+		return pqueue_insert(q->pq, evt);
+	}
+
+	diff = t ^ q->cursor;
+	for (level = 0; level < q->levels; level++) {
+		if (!(diff >> (SQ_WHEEL_BITS * (level + 1))))
+			break;
+	}
+	if (level == q->levels) {
+		evt->slot = SQ_SLOT_OVERFLOW;
+		return pqueue_insert(q->overflow, evt);
+	}
+
+	idx = (t >> (SQ_WHEEL_BITS * level)) & SQ_WHEEL_MASK;
+	evt->slot = (level * SQ_WHEEL_SLOTS) + idx;
+	evt->prev = NULL;
+	evt->next = q->slots[level][idx];
+	if (evt->next)
+		evt->next->prev = evt;
+	q->slots[level][idx] = evt;
+	q->map[level][idx / SQ_MAPBITS] |= 1U << (idx % SQ_MAPBITS);
+
+	return 0;
+}
+
+static int wheel_unfile(squeue_t *q, squeue_event *evt)
+{
+	unsigned int level, idx;
+
+	if (evt->slot == SQ_SLOT_HEAP)
+		return pqueue_remove(q->pq, evt);
+	if (evt->slot == SQ_SLOT_OVERFLOW)
+		return pqueue_remove(q->overflow, evt);
+
+	level = evt->slot / SQ_WHEEL_SLOTS;
+	idx = evt->slot % SQ_WHEEL_SLOTS;
+	if (level >= q->levels || (!evt->prev && q->slots[level][idx] != evt))
+		return -1;
+	if (evt->prev)
+		evt->prev->next = evt->next;
+	else
+		q->slots[level][idx] = evt->next;
+	if (evt->next)
+		evt->next->prev = evt->prev;
+	if (!q->slots[level][idx])
+		q->map[level][idx / SQ_MAPBITS] &= ~(1U << (idx % SQ_MAPBITS));
+	evt->next = evt->prev = NULL;
+
+	return 0;
+}
+
+/*
+ * Moves the cursor forward until the heap holds the earliest
+ * event(s) in the queue. Each event is cascaded at most once per
+ * level, which is where the amortized O(1) comes from.
+ */
+static void wheel_advance(squeue_t *q)
 {
+	squeue_event *evt, *next;
+	unsigned int level, shift;
+	int idx = -1;
+
+	while (!pqueue_size(q->pq) && q->size) {
+		for (level = 0; level < q->levels; level++) {
+			shift = SQ_WHEEL_BITS * level;
+			idx = wheel_next_slot(q, level, ((q->cursor >> shift) & SQ_WHEEL_MASK) + 1);
+			if (idx >= 0)
+				break;
+		}
+
+		if (level < q->levels) {
+			shift = SQ_WHEEL_BITS * level;
+			q->cursor &= ~((1ULL << (shift + SQ_WHEEL_BITS)) - 1);
+			q->cursor |= (unsigned long long)idx << shift;
+			evt = q->slots[level][idx];
+			q->slots[level][idx] = NULL;
+			q->map[level][idx / SQ_MAPBITS] &= ~(1U << (idx % SQ_MAPBITS));
+			for (; evt; evt = next) {
+				next = evt->next;
+				wheel_file(q, evt);
+			}
+			continue;
+		}
+
+		/* all wheels are empty, so restart them from the overflow queue */
+		if (!(evt = pqueue_peek(q->overflow)))
+			break;
+		q->cursor = evt->when.tv_sec;
+		shift = SQ_WHEEL_BITS * q->levels;
+		while ((evt = pqueue_peek(q->overflow))) {
+			if (((unsigned long long)evt->when.tv_sec ^ q->cursor) >> shift)
+				break;
+			pqueue_pop(q->overflow);
+			wheel_file(q, evt);
+		}
+	}
+}
+
+squeue_t *squeue_create_backend(unsigned int horizon, int backend)
+{
+	squeue_t *q;
+
 	if (!horizon)
 		horizon = 127; /* makes pqueue allocate 128 elements */
 
-	return pqueue_init(horizon, sq_cmp_pri, sq_get_pri, sq_set_pri, sq_get_pos, sq_set_pos);
+	if (!(q = calloc(1, sizeof(*q))))
+		return NULL;
+
+	/* with the wheel, the heap only holds what's due in the current second */
+	q->backend = backend;
+	q->pq = pqueue_init(backend == SQUEUE_BACKEND_WHEEL ? SQ_WHEEL_HEAP_SIZE : horizon, sq_cmp_pri, sq_get_pri, sq_set_pri, sq_get_pos, sq_set_pos);
+	if (!q->pq) {
+		free(q);
+		return NULL;
+	}
+
+	if (backend == SQUEUE_BACKEND_WHEEL) {
+		q->overflow = pqueue_init(127, sq_cmp_pri, sq_get_pri, sq_set_pri, sq_get_pos, sq_set_pos);
+		if (!q->overflow) {
+			pqueue_free(q->pq);
+			free(q);
+			return NULL;
+		}
+		/* cover at least 18 hours, or the horizon if it's longer */
+		for (q->levels = 2; q->levels < SQ_MAX_LEVELS; q->levels++) {
+			if (!(horizon >> (SQ_WHEEL_BITS * q->levels)))
+				break;
+		}
+		q->cursor = time(NULL);
+	}
+
+	return q;
+}
+
+squeue_t *squeue_create(unsigned int horizon)
+{
+	return squeue_create_backend(horizon, SQUEUE_BACKEND_HEAP);
+}
+
+int squeue_backend(squeue_t *q)
+{
+	if (!q)
+		return -1;
+	return q->backend;
+}
+
+/*
+ * Only use bottom sizeof(pqueue_pri_t)-SQ_BITS bits on 64-bit
+ * systems, or we may get entries at the head of the queue that
+ * are actually scheduled to run several hundred thousand years
+ * from now.
+ */
+static void evt_set_when(squeue_event *evt, struct timeval *tv)
+{
+	evt->when.tv_sec = tv->tv_sec;
+	if (sizeof(evt->when.tv_sec) > 4) {
+		evt->when.tv_sec &= (1ULL << ((sizeof(pqueue_pri_t) * 8) - SQ_BITS)) - 1;
+	}
+	evt->when.tv_usec = tv->tv_usec;
+	evt->pri = evt_compute_pri(&evt->when);
 }
 
 squeue_event *squeue_add_tv(squeue_t *q, struct timeval *tv, void *data)
 {
 	squeue_event *evt;
+	int ret;
 
 	if (!q)
 		return NULL;
@@ -116,23 +335,18 @@ squeue_event *squeue_add_tv(squeue_t *q, struct timeval *tv, void *data)
 	/* we can't schedule events in the past */
 	if (tv->tv_sec < time(NULL))
 		tv->tv_sec = time(NULL);
-	evt->when.tv_sec = tv->tv_sec;
-	if (sizeof(evt->when.tv_sec) > 4) {
-		/*
-		 * Only use bottom sizeof(pqueue_pri_t)-SQ_BITS bits on
-		 * 64-bit systems, or we may get entries at the head
-		 * of the queue are actually scheduled to run several
-		 * hundred thousand years from now.
-		 */
-		evt->when.tv_sec &= (1ULL << ((sizeof(pqueue_pri_t) * 8) - SQ_BITS)) - 1;
-	}
-	evt->when.tv_usec = tv->tv_usec;
+	evt_set_when(evt, tv);
 	evt->data = data;
 
-	evt->pri = evt_compute_pri(&evt->when);
+	if (q->backend == SQUEUE_BACKEND_WHEEL)
+		ret = wheel_file(q, evt);
+	else
+		ret = pqueue_insert(q->pq, evt);
 
-	if (!pqueue_insert(q, evt))
+	if (!ret) {
+		q->size++;
 		return evt;
+	}
 
 	free(evt);
 	return NULL;
@@ -170,21 +384,34 @@ void squeue_change_priority_tv(squeue_t *q, squeue_event *evt, struct timeval *t
 {
 	if (!q || !evt || !tv) return;
 
+	if (q->backend == SQUEUE_BACKEND_WHEEL) {
+		wheel_unfile(q, evt);
+		evt_set_when(evt, tv);
+		wheel_file(q, evt);
+		return;
+	}
+
+	/* pqueue_change_priority() needs the old priority, so go slow here */
 	evt->when.tv_sec = tv->tv_sec;
 	if (sizeof(evt->when.tv_sec) > 4) {
-		/* Only use bottom sizeof(pqueue_pri_t)-SQ_BITS bits on 64-bit systems,
-		 * or we may get entries at the head of the queue are actually
-		 * scheduled to run several hundred thousand years from now. */
 		evt->when.tv_sec &= (1ULL << ((sizeof(pqueue_pri_t) * 8) - SQ_BITS)) - 1;
 	}
 	evt->when.tv_usec = tv->tv_usec;
 
-	pqueue_change_priority(q, evt_compute_pri(&evt->when), evt);
+	pqueue_change_priority(q->pq, evt_compute_pri(&evt->when), evt);
 }
 
 void *squeue_peek(squeue_t *q)
 {
-	squeue_event *evt = pqueue_peek(q);
+	squeue_event *evt;
+
+	if (!q)
+		return NULL;
+
+	if (q->backend == SQUEUE_BACKEND_WHEEL)
+		wheel_advance(q);
+
+	evt = pqueue_peek(q->pq);
 	if (evt)
 		return evt->data;
 	return NULL;
@@ -195,8 +422,15 @@ void *squeue_pop(squeue_t *q)
 	squeue_event *evt;
 	void *ptr = NULL;
 
-	evt = pqueue_pop(q);
+	if (!q)
+		return NULL;
+
+	if (q->backend == SQUEUE_BACKEND_WHEEL)
+		wheel_advance(q);
+
+	evt = pqueue_pop(q->pq);
 	if (evt) {
+		q->size--;
 		ptr = evt->data;
 		free(evt);
 	}
@@ -209,42 +443,80 @@ int squeue_remove(squeue_t *q, squeue_event *evt)
 
 	if (!q || !evt)
 		return -1;
-	ret = pqueue_remove(q, evt);
-	if (evt)
-		free(evt);
+	if (q->backend == SQUEUE_BACKEND_WHEEL)
+		ret = wheel_unfile(q, evt);
+	else
+		ret = pqueue_remove(q->pq, evt);
 
-	return ret;
+	/* leave alone what isn't in this queue */
+	if (ret)
+		return -1;
+
+	q->size--;
+	free(evt);
+
+	return 0;
 }
 
-void squeue_destroy(squeue_t *q, int flags)
+int squeue_walk(squeue_t *q, int (*walker)(squeue_event *, void *), void *arg)
 {
-	unsigned int i;
+	squeue_event *evt, *next;
+	unsigned int i, level;
+	int ret;
 
-	if (!q || pqueue_size(q) < 1)
-		return;
+	if (!q || !walker)
+		return -1;
 
-	/*
-	 * Using two separate loops is a lot faster than
-	 * doing 1 cmp+branch for every queued item
-	 */
-	if (flags & SQUEUE_FREE_DATA) {
-		for (i = 0; i < pqueue_size(q); i++) {
-			free(((squeue_event *)q->d[i + 1])->data);
-			free(q->d[i + 1]);
-		}
-	} else {
-		for (i = 0; i < pqueue_size(q); i++) {
-			free(q->d[i + 1]);
+	for (i = 1; i < q->pq->size; i++) {
+		if ((ret = walker(q->pq->d[i], arg)))
+			return ret;
+	}
+
+	if (q->backend != SQUEUE_BACKEND_WHEEL)
+		return 0;
+
+	for (i = 1; i < q->overflow->size; i++) {
+		if ((ret = walker(q->overflow->d[i], arg)))
+			return ret;
+	}
+	for (level = 0; level < q->levels; level++) {
+		for (i = 0; i < SQ_WHEEL_SLOTS; i++) {
+			for (evt = q->slots[level][i]; evt; evt = next) {
+				next = evt->next;
+				if ((ret = walker(evt, arg)))
+					return ret;
+			}
 		}
 	}
-	pqueue_free(q);
+
+	return 0;
+}
+
+static int sq_free_event(squeue_event *evt, void *free_data)
+{
+	if (free_data)
+		free(evt->data);
+	free(evt);
+	return 0;
+}
+
+void squeue_destroy(squeue_t *q, int flags)
+{
+	if (!q)
+		return;
+
+	squeue_walk(q, sq_free_event, (flags & SQUEUE_FREE_DATA) ? q : NULL);
+	pqueue_free(q->pq);
+	if (q->overflow)
+		pqueue_free(q->overflow);
+	free(q);
 }
 
 unsigned int squeue_size(squeue_t *q)
 {
 	if (!q)
 		return 0;
-	return pqueue_size(q);
+	return q->size;
 }
 
 int squeue_evt_when_is_after(squeue_event *evt, struct timeval *reftime) {
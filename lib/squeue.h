@@ -10,6 +10,9 @@
  * This library is based on the pqueue api, which implements a
  * priority queue based on a binary heap, providing O(lg n) times
  * for insert() and remove(), and O(1) time for peek().
+ * Queues can optionally be backed by a hierarchical timing wheel
+ * instead, which makes insert(), remove() and pop() O(1) amortized
+ * for the common case of events scheduled within the horizon.
  * @note There is no "find". Callers must maintain pointers to their
  * scheduled events if they wish to be able to remove them.
  *
@@ -21,7 +24,8 @@
  * The pqueue library can be useful on its own though, so we
  * don't block that from user view.
  */
-typedef pqueue_t squeue_t;
+struct squeue;
+typedef struct squeue squeue_t;
 struct squeue_event;
 typedef struct squeue_event squeue_event;
 
@@ -30,6 +34,12 @@ typedef struct squeue_event squeue_event;
  */
 #define SQUEUE_FREE_DATA (1 << 0) /** Call free() on all data pointers */
 
+/**
+ * Backends for squeue_create_backend()
+ */
+#define SQUEUE_BACKEND_HEAP  0 /** Binary heap (the default) */
+#define SQUEUE_BACKEND_WHEEL 1 /** Hierarchical timing wheel */
+
 /**
  * Get the scheduled runtime of this event
  * @param[in] evt The event to get runtime of
@@ -59,6 +69,29 @@ extern void *squeue_event_data(squeue_event *evt);
  */
 extern squeue_t *squeue_create(unsigned int size);
 
+/**
+ * Creates a scheduling queue using the given backend.
+ * For SQUEUE_BACKEND_HEAP, "horizon" is the size hint described
+ * for squeue_create(). For SQUEUE_BACKEND_WHEEL, it is the number
+ * of seconds (the wheels' ticks) into the future events get
+ * scheduled, which determines how many wheel levels get set up.
+ * Events further into the future than the wheels reach (at least
+ * 18 hours) are kept in a binary heap until they come within reach,
+ * so the horizon only affects performance.
+ *
+ * @param horizon See squeue_create()
+ * @param backend One of the SQUEUE_BACKEND_* values
+ * @return A pointer to a scheduling queue
+ */
+extern squeue_t *squeue_create_backend(unsigned int horizon, int backend);
+
+/**
+ * Get the backend a scheduling queue was created with
+ * @param[in] q The scheduling queue to inspect
+ * @return One of the SQUEUE_BACKEND_* values, or -1 on errors
+ */
+extern int squeue_backend(squeue_t *q);
+
 /**
  * Destroys a scheduling queue completely
  * @param[in] q The doomed queue
@@ -145,9 +178,23 @@ extern void *squeue_pop(squeue_t *q);
  * @note This causes the associated squeue_event() to be free()'d.
  * @param[in] q The scheduling queue to remove from
  * @param[in] evt The event to remove
+ * @return 0 on success, -1 if the event isn't in the queue, in
+ *         which case both are left alone
  */
 extern int squeue_remove(squeue_t *q, squeue_event *evt);
 
+/**
+ * Calls "walker" once for every event in the scheduling queue, in
+ * no particular order. Walking stops as soon as "walker" returns
+ * non-zero. The walker must not add or remove events.
+ *
+ * @param[in] q The scheduling queue to walk
+ * @param[in] walker Callback to run for each event
+ * @param[in] arg Passed on to the walker as its second argument
+ * @return 0 on success, -1 on errors, or the walker's last return value
+ */
+extern int squeue_walk(squeue_t *q, int (*walker)(squeue_event *, void *), void *arg);
+
 /**
  * Returns the number of events in the scheduling queue. This
  * function never fails.
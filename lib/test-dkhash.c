@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include "dkhash.c"
 #include "t-utils.h"
 
@@ -26,7 +27,12 @@ unsigned int dkhash_count_entries(dkhash_table *table)
 {
 	unsigned int i, count = 0;
 
-	for (i = 0; i < table->num_buckets; i++) {
+	for (i = 0; table->slots && i < table->num_buckets; i++) {
+		if (table->slots[i].key)
+			count++;
+	}
+
+	for (i = 0; table->buckets && i < table->num_buckets; i++) {
 		dkhash_bucket *bkt;
 		for (bkt = table->buckets[i]; bkt; bkt = bkt->next)
 			count++;
@@ -84,7 +90,12 @@ static int del_matching(void *data)
 	return 0;
 }
 
-int main(int argc, char **argv)
+static const char *backend_name(int backend)
+{
+	return backend == DKHASH_BACKEND_OPEN ? "open addressing" : "chained";
+}
+
+static int dk_test_backend(int backend)
 {
 	dkhash_table *tx, *t;
 	unsigned int x;
@@ -94,9 +105,9 @@ int main(int argc, char **argv)
 	char *strs[10];
 	char tmp[32];
 
-	t_set_colors(0);
-	t_start("dkhash basic test");
-	t = dkhash_create(512);
+	t_start("dkhash basic test (%s)", backend_name(backend));
+	t = dkhash_create_backend(512, backend);
+	ok_int(dkhash_backend(t), backend, "Table must use the requested backend");
 
 	p1 = strdup("a not-so secret value");
 	dkhash_insert(t, "nisse", NULL, p1);
@@ -118,16 +129,27 @@ int main(int argc, char **argv)
 	ok_int(dkhash_num_entries(t), 1, "should be 1 entries after 2 inserts and 1 successful remove");
 	p2 = dkhash_remove(t, "nisse", NULL);
 	test(p1 == p2, "dkhash_remove() should return removed data");
+
+	ok_int(dkhash_insert(t, "kalle", "nisse", p1), DKHASH_OK, "inserting two keys must work");
+	ok_int(dkhash_insert(t, "nisse", "kalle", p2), DKHASH_OK, "inserting swapped keys must work");
+	ok_int(dkhash_insert(t, "kallenisse", NULL, strs), DKHASH_OK, "inserting the keys glued together must work");
+	ok_int(dkhash_insert(t, "kalle", "nisse", p2), DKHASH_EDUPE, "duplicate inserts must be rejected");
+	test(dkhash_get(t, "kalle", "nisse") == p1, "first key must come first");
+	test(dkhash_get(t, "nisse", "kalle") == p2, "swapped keys must not mix things up");
+	test(dkhash_get(t, "kallenisse", NULL) == strs, "glued keys must not mix things up");
+	test(dkhash_get(t, "kalle", NULL) == NULL, "first key alone must not match");
+	dkhash_destroy(t);
+	free(p1);
 	ret = t_end();
 
 	t_reset();
 	/* lots of tests below, so we shut up while they're running */
 	t_verbose = 0;
 
-	t_start("dkhash_walk_data() test");
+	t_start("dkhash_walk_data() test (%s)", backend_name(backend));
 	memset(&s, 0, sizeof(s));
 	/* first we set up the dkhash-tables */
-	tx = dkhash_create(16);
+	tx = dkhash_create_backend(16, backend);
 	for (x = 0; x < ARRAY_SIZE(keys); x++) {
 		dkhash_insert(tx, keys[x].k1, NULL, ddup(x, 0, 0));
 		dkhash_insert(tx, keys[x].k2, NULL, ddup(x, 0, 0));
@@ -151,6 +173,7 @@ int main(int argc, char **argv)
 	test(0 == dkhash_num_entries(tx), "x table post all ops");
 	test(0 == dkhash_check_table(tx), "x table consistency post all ops");
 	dkhash_debug_table(tx, 0);
+	dkhash_destroy(tx);
 	r2 = t_end();
 	ret = r2 ? r2 : ret;
 
@@ -160,9 +183,9 @@ int main(int argc, char **argv)
 		strs[x] = strdup(tmp);
 	}
 
-	t_start("dkhash single bucket add remove forward");
+	t_start("dkhash single bucket add remove forward (%s)", backend_name(backend));
 
-	t = dkhash_create(1);
+	t = dkhash_create_backend(1, backend);
 	for(x = 0; x < 10; x++) {
 		dkhash_insert(t, strs[x], NULL, strs[x]);
 	}
@@ -171,13 +194,14 @@ int main(int argc, char **argv)
 		p2 = dkhash_remove(t, p1, NULL);
 		test(p1 == p2, "remove should return a value");
 	}
+	dkhash_destroy(t);
 	r2 = t_end();
 	ret = r2 ? r2 : ret;
 	t_reset();
 
-	t_start("dkhash single bucket add remove backward");
+	t_start("dkhash single bucket add remove backward (%s)", backend_name(backend));
 
-	t = dkhash_create(1);
+	t = dkhash_create_backend(1, backend);
 	for(x = 0; x < 10; x++) {
 		dkhash_insert(t, strs[x], NULL, strs[x]);
 	}
@@ -188,7 +212,146 @@ int main(int argc, char **argv)
 	}
 
 	dkhash_destroy(t);
+	for(x = 0; x < 10; x++)
+		free(strs[x]);
+
+	r2 = t_end();
+	t_reset();
+	return r2 ? r2 : ret;
+}
+
+/*
+ * Grows an open addressing table from a single slot to well over
+ * 100k entries, then removes every other entry, so that lots of
+ * probe sequences have to be shifted back, and makes sure all
+ * the remaining entries can still be found.
+ */
+#define GROW_ENTRIES 100000
+static int dk_test_grow(void)
+{
+	dkhash_table *t;
+	char **names;
+	unsigned int i, found = 0, gone = 0;
+
+	t_start("dkhash open addressing resize and removal");
+	t = dkhash_create_backend(1, DKHASH_BACKEND_OPEN);
+	names = calloc(GROW_ENTRIES, sizeof(char *));
+	t_req(t != NULL && names != NULL);
+	for (i = 0; i < GROW_ENTRIES; i++) {
+		char buf[32];
+		sprintf(buf, "host%u", i);
+		names[i] = strdup(buf);
+		if (dkhash_insert(t, names[i], i & 1 ? "PING" : NULL, names[i]) != DKHASH_OK)
+			break;
+	}
+	ok_int(i, GROW_ENTRIES, "all inserts must succeed");
+	ok_int(dkhash_num_entries(t), GROW_ENTRIES, "all entries must be counted");
+	test(dkhash_table_size(t) >= GROW_ENTRIES * 4 / 3, "table must have grown to %u slots", dkhash_table_size(t));
+	ok_int(dkhash_check_table(t), 0, "table must be consistent after growing");
+
+	for (i = 0; i < GROW_ENTRIES; i += 2) {
+		if (dkhash_remove(t, names[i], NULL) == names[i])
+			gone++;
+	}
+	for (i = 0; i < GROW_ENTRIES; i++) {
+		void *p = dkhash_get(t, names[i], i & 1 ? "PING" : NULL);
+		if (i & 1 ? p == names[i] : p == NULL)
+			found++;
+	}
+	ok_int(gone, GROW_ENTRIES / 2, "every removal must succeed");
+	ok_int(found, GROW_ENTRIES, "remaining entries must be found and removed ones not");
+	ok_int(dkhash_check_table(t), 0, "table must be consistent after removals");
+
+	dkhash_destroy(t);
+	for (i = 0; i < GROW_ENTRIES; i++)
+		free(names[i]);
+	free(names);
+	return t_end();
+}
+
+static double dk_tv_delta(struct timeval *start, struct timeval *stop)
+{
+	return (double)(stop->tv_sec - start->tv_sec) +
+		(double)(stop->tv_usec - start->tv_usec) / 1000000;
+}
+
+/*
+ * Benchmarks a backend with host/service key pairs, as used by
+ * find_service(). The table is deliberately created too small, as
+ * happens when objects are added after the table was sized.
+ */
+#define BENCH_HOSTS 25000
+#define BENCH_SVCS 20
+#define BENCH_ROUNDS 4
+static void dk_bench(int backend, char **hosts, char **svcs)
+{
+	dkhash_table *t;
+	struct timeval start, stop;
+	unsigned int h, s, r, hits = 0, total = BENCH_HOSTS * BENCH_SVCS;
+	double fill, lookup;
+
+	t = dkhash_create_backend(total / 8, backend);
+	gettimeofday(&start, NULL);
+	for (h = 0; h < BENCH_HOSTS; h++) {
+		for (s = 0; s < BENCH_SVCS; s++)
+			dkhash_insert(t, hosts[h], svcs[s], hosts[h]);
+	}
+	gettimeofday(&stop, NULL);
+	fill = dk_tv_delta(&start, &stop);
+
+	gettimeofday(&start, NULL);
+	for (r = 0; r < BENCH_ROUNDS; r++) {
+		for (s = 0; s < BENCH_SVCS; s++) {
+			for (h = 0; h < BENCH_HOSTS; h++)
+				hits += dkhash_get(t, hosts[h], svcs[s]) == hosts[h];
+		}
+	}
+	gettimeofday(&stop, NULL);
+	lookup = dk_tv_delta(&start, &stop);
+
+	ok_int(hits, total * BENCH_ROUNDS, "all lookups must hit");
+	t_diag("%s: %u entries in %u slots, %u collisions; %.0f inserts/s, %.0f lookups/s",
+	       backend_name(backend), total, dkhash_table_size(t), dkhash_collisions(t),
+	       total / fill, total * BENCH_ROUNDS / lookup);
+	dkhash_destroy(t);
+}
 
+int main(int argc, char **argv)
+{
+	char *hosts[BENCH_HOSTS], *svcs[BENCH_SVCS];
+	unsigned int i;
+	int ret, r2;
+
+	t_set_colors(0);
+
+	ret = dk_test_backend(DKHASH_BACKEND_CHAINED);
+	r2 = dk_test_backend(DKHASH_BACKEND_OPEN);
+	ret = r2 ? r2 : ret;
+	t_reset();
+	r2 = dk_test_grow();
+	ret = r2 ? r2 : ret;
+	t_reset();
+
+	for (i = 0; i < BENCH_HOSTS; i++) {
+		char buf[64];
+		sprintf(buf, "srv-%05u.dc%u.example.com", i, i % 3);
+		hosts[i] = strdup(buf);
+	}
+	for (i = 0; i < BENCH_SVCS; i++) {
+		char buf[64];
+		sprintf(buf, "Disk usage /var/lib/volume%u", i);
+		svcs[i] = strdup(buf);
+	}
+
+	t_start("dkhash benchmarks");
+	dk_bench(DKHASH_BACKEND_CHAINED, hosts, svcs);
+	dk_bench(DKHASH_BACKEND_OPEN, hosts, svcs);
 	r2 = t_end();
+
+	for (i = 0; i < BENCH_HOSTS; i++)
+		free(hosts[i]);
+	for (i = 0; i < BENCH_SVCS; i++)
+		free(svcs[i]);
+
 	return r2 ? r2 : ret;
 }
@@ -106,6 +106,172 @@ static int listen_handler(int fd, int events, void *arg)
 	return 0;
 }
 
+static int batch_calls;
+static int batch_handler(int fd, int events, void *arg)
+{
+	char buf[4];
+
+	/* deliberately read less than is available */
+	(void)read(fd, buf, sizeof(buf));
+	batch_calls++;
+	return 0;
+}
+
+static void test_poll_batch(int backend)
+{
+	iobroker_set *bs;
+	iobroker_event ready[4];
+	int et[2], lt[2], i, nfds, prio = -1;
+
+	bs = iobroker_create_backend(backend);
+	batch_calls = 0;
+	socketpair(AF_UNIX, SOCK_STREAM, 0, et);
+	socketpair(AF_UNIX, SOCK_STREAM, 0, lt);
+	fcntl(et[0], F_SETFL, O_NONBLOCK);
+	fcntl(lt[0], F_SETFL, O_NONBLOCK);
+	ok_int(iobroker_register_flags(bs, et[0], &et[0], batch_handler, IOBROKER_EDGE_TRIGGERED), 0,
+		   "edge-triggered registration must succeed");
+	ok_int(iobroker_register_flags(bs, lt[0], &lt[0], batch_handler, IOBROKER_PRIORITY), 0,
+		   "flagged registration must succeed");
+	ok_int(iobroker_poll_batch(bs, 0, ready, 0), IOBROKER_EINVAL, "empty ready lists must be rejected");
+
+	write(et[1], "edge triggered", 14);
+	write(lt[1], "level triggered", 15);
+	nfds = iobroker_poll_batch(bs, 1000, ready, 4);
+	ok_int(nfds, 2, "both sockets must be reported ready");
+	for (i = 0; i < nfds; i++) {
+		if (ready[i].flags & IOBROKER_PRIORITY)
+			prio = i;
+	}
+	test(prio >= 0 && ready[prio].fd == lt[0] && ready[prio].arg == &lt[0],
+		 "ready list must carry fd, arg and registration flags");
+	ok_int(batch_calls, 0, "iobroker_poll_batch() must not call handlers");
+	for (i = 0; i < nfds; i++) {
+		ok_int(iobroker_dispatch(bs, &ready[i]), 1, "ready sockets must be dispatched");
+	}
+	ok_int(batch_calls, 2, "iobroker_dispatch() must call handlers");
+
+	/* both sockets still have unread data */
+	nfds = iobroker_poll_batch(bs, 0, ready, 4);
+#ifdef IOBROKER_USES_EPOLL
+	if (backend == IOBROKER_BACKEND_URING)
+		t_diag("io_uring multishot polls are%s supported", bs->uring->multishot ? "" : " not");
+	ok_int(nfds, 1, "only the level-triggered socket must be reported again");
+	test(nfds == 1 && ready[0].fd == lt[0], "the socket reported again must be the level-triggered one");
+	write(et[1], "more", 4);
+	nfds = iobroker_poll_batch(bs, 0, ready, 4);
+	ok_int(nfds, 2, "new data must wake the edge-triggered socket up again");
+#else
+	ok_int(nfds, 2, "level-triggered brokers report both sockets again");
+#endif
+
+	/* entries for sockets closed by earlier handlers must be skipped */
+	iobroker_close(bs, lt[0]);
+	for (i = 0; i < nfds; i++) {
+		if (ready[i].fd == lt[0])
+			ok_int(iobroker_dispatch(bs, &ready[i]), 0, "stale ready entries must be skipped");
+	}
+
+	close(et[1]);
+	close(lt[1]);
+	iobroker_destroy(bs, IOBROKER_CLOSE_SOCKETS);
+}
+
+static struct {
+	char buf[256 * 1024];
+	int len, eof, calls;
+} rd;
+static int test_reader(int fd, char *buf, int len, void *arg)
+{
+	rd.calls++;
+	if (len <= 0) {
+		rd.eof = 1;
+		iobroker_close((iobroker_set *)arg, fd);
+		return 0;
+	}
+	if (rd.len + len <= (int)sizeof(rd.buf))
+		memcpy(rd.buf + rd.len, buf, len);
+	rd.len += len;
+	return 0;
+}
+
+static void test_readers(int backend)
+{
+	iobroker_set *rs;
+	iobroker_event ready[4];
+	static char big[200 * 1024];
+	int sv[2], i, nfds, sent = 0, mismatch = 0;
+
+	rs = iobroker_create_backend(backend);
+#ifdef IOBROKER_HAS_URING
+	if (backend == IOBROKER_BACKEND_URING)
+		t_diag("io_uring %s", rs->uring->rbufs ? "reads into provided buffers" : "polls readers");
+#endif
+	memset(&rd, 0, sizeof(rd));
+	socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	fcntl(sv[0], F_SETFL, O_NONBLOCK);
+	fcntl(sv[1], F_SETFL, O_NONBLOCK);
+	ok_int(iobroker_register_reader(rs, sv[0], rs, NULL, 0), IOBROKER_EINVAL, "readers must have a reader");
+	ok_int(iobroker_register_reader(rs, sv[0], rs, test_reader, IOBROKER_EDGE_TRIGGERED), 0,
+		   "reader registration must succeed");
+
+	write(sv[1], "hello reader", 12);
+	iobroker_poll(rs, 1000);
+	test(rd.len == 12 && !memcmp(rd.buf, "hello reader", 12), "readers must be handed the data");
+
+	/* more than fits in a read, written as fast as the socket takes it */
+	for (i = 0; i < (int)sizeof(big); i++)
+		big[i] = i % 251;
+	rd.len = 0;
+	while (rd.len < (int)sizeof(big)) {
+		if (sent < (int)sizeof(big)) {
+			int ret = write(sv[1], big + sent, sizeof(big) - sent);
+			if (ret > 0)
+				sent += ret;
+		}
+		if (iobroker_poll(rs, 1000) <= 0)
+			break;
+	}
+	ok_int(rd.len, (int)sizeof(big), "readers must get everything that's written");
+	for (i = 0; i < rd.len && i < (int)sizeof(big); i++) {
+		if (rd.buf[i] != big[i]) {
+			mismatch = 1;
+			break;
+		}
+	}
+	ok_int(mismatch, 0, "readers must get the data in order");
+
+	/* batched reads are only handed over when dispatched */
+	rd.len = rd.calls = 0;
+	write(sv[1], "batched", 7);
+	nfds = iobroker_poll_batch(rs, 1000, ready, 4);
+	ok_int(nfds, 1, "batch polls must report readers");
+	ok_int(rd.calls, 0, "batch polls must not call readers");
+	for (i = 0; i < nfds; i++)
+		iobroker_dispatch(rs, &ready[i]);
+	test(rd.len == 7 && !memcmp(rd.buf, "batched", 7), "dispatching must hand readers their data");
+
+	close(sv[1]);
+	iobroker_poll(rs, 1000);
+	test(rd.eof && !iobroker_is_registered(rs, sv[0]), "readers must be told about closed sockets");
+
+	/* reads that are never dispatched mustn't use up the broker's buffers */
+	for (i = 0; i < 100; i++) {
+		socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+		fcntl(sv[0], F_SETFL, O_NONBLOCK);
+		iobroker_register_reader(rs, sv[0], rs, test_reader, 0);
+		write(sv[1], "x", 1);
+		nfds = iobroker_poll_batch(rs, 1000, ready, 4);
+		iobroker_close(rs, sv[0]);
+		close(sv[1]);
+		if (nfds != 1)
+			break;
+	}
+	ok_int(i, 100, "unregistering sockets with undispatched reads must work");
+
+	iobroker_destroy(rs, IOBROKER_CLOSE_SOCKETS);
+}
+
 void sighandler(int sig)
 {
 	/* test failed */
@@ -155,25 +321,13 @@ static int conn_spam(struct sockaddr_in *sain)
 	return 0;
 }
 
-int main(int argc, char **argv)
+static void test_backend(int backend, int spam)
 {
 	int listen_fd, flags, sockopt = 1;
 	struct sockaddr_in sain;
-	int error;
-	const char *err_msg;
-
-	t_set_colors(0);
-	t_start("iobroker ipc test");
 
-	error = iobroker_get_max_fds(NULL);
-	ok_int(error, IOBROKER_ENOSET, "test errors when passing null");
-
-	err_msg = iobroker_strerror(error);
-	test(err_msg && !strcmp(err_msg, iobroker_errors[(~error) + 1].string), "iobroker_strerror() returns the right string");
-
-	iobs = iobroker_create();
-	error = iobroker_get_max_fds(iobs);
-	test(iobs && error >= 0, "max fd's for real iobroker set must be > 0");
+	iobs = iobroker_create_backend(backend);
+	test(iobs && iobroker_get_backend(iobs) == backend, "%s backend must be created", iobroker_get_backend_name(iobs));
 
 	listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 	flags = fcntl(listen_fd, F_GETFD);
@@ -189,7 +343,7 @@ int main(int argc, char **argv)
 	listen(listen_fd, 128);
 	iobroker_register(iobs, listen_fd, iobs, listen_handler);
 
-	if (argc == 1)
+	if (spam)
 		conn_spam(&sain);
 
 	for (;;) {
@@ -202,6 +356,42 @@ int main(int argc, char **argv)
 	iobroker_close(iobs, listen_fd);
 	iobroker_destroy(iobs, 0);
 
+	test_poll_batch(backend);
+	test_readers(backend);
+}
+
+int main(int argc, char **argv)
+{
+	int error;
+	const char *err_msg;
+	iobroker_set *probe;
+
+	t_set_colors(0);
+	t_start("iobroker ipc test");
+
+	error = iobroker_get_max_fds(NULL);
+	ok_int(error, IOBROKER_ENOSET, "test errors when passing null");
+
+	err_msg = iobroker_strerror(error);
+	test(err_msg && !strcmp(err_msg, iobroker_errors[(~error) + 1].string), "iobroker_strerror() returns the right string");
+
+	probe = iobroker_create();
+	error = iobroker_get_max_fds(probe);
+	test(probe && error >= 0, "max fd's for real iobroker set must be > 0");
+	iobroker_destroy(probe, 0);
+
+	test_backend(IOBROKER_BACKEND_DEFAULT, argc == 1);
+
+	/* io_uring may be missing or disabled, in which case we fall back */
+	probe = iobroker_create_backend(IOBROKER_BACKEND_URING);
+	if (iobroker_get_backend(probe) == IOBROKER_BACKEND_URING) {
+		iobroker_destroy(probe, 0);
+		test_backend(IOBROKER_BACKEND_URING, argc == 1);
+	} else {
+		t_diag("io_uring is not available; only testing %s", iobroker_get_backend_name(probe));
+		iobroker_destroy(probe, 0);
+	}
+
 	t_end();
 	return 0;
 }
@@ -59,6 +59,29 @@ static int test_delimiter(const char *delim, unsigned int delim_len)
 	return 0;
 }
 
+/* reading into a full cache must grow it, not write past its end */
+static void test_read_full(void)
+{
+	iocache *ioc;
+	char buf[3000];
+	int fds[2], i;
+
+	ioc = iocache_create(1024);
+	t_req(ioc != NULL);
+	t_req(pipe(fds) == 0);
+	memset(buf, 'x', sizeof(buf));
+	t_req(write(fds[1], buf, sizeof(buf)) == sizeof(buf));
+	close(fds[1]);
+
+	for (i = 0; i < 3; i++)
+		iocache_read(ioc, fds[0]);
+	test(iocache_available(ioc) == sizeof(buf), "all data read, %lu bytes available", iocache_available(ioc));
+	test(iocache_size(ioc) >= iocache_available(ioc), "buffer (%lu) must hold what was read", iocache_size(ioc));
+
+	close(fds[0]);
+	iocache_destroy(ioc);
+}
+
 int main(int argc, char **argv)
 {
 	unsigned int i;
@@ -77,5 +100,9 @@ int main(int argc, char **argv)
 		t_end();
 	}
 
+	t_start("iocache_read() into a full cache");
+	test_read_full();
+	t_end();
+
 	return t_end();
 }
@@ -149,6 +149,44 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/* kvvec2bbuf -> bbuf2kvvec, both in place and copying */
+	kvvec_destroy(kvv2, 0);
+	kvv = kvvec_create(1);
+	add_vars(kvv, test_data, 1239819);
+	{
+		unsigned long blen;
+		char *bbuf = malloc(15);
+
+		memcpy(bbuf, "nul\0and\1delim\0\0", 15);
+		kvvec_addkv_wlen(kvv, strdup("binary"), 6, bbuf, 15);
+		kvvec_addkv_wlen(kvv, strdup("empty"), 5, strdup(""), 0);
+		blen = kvvec_bbuf_len(kvv);
+		bbuf = malloc(blen);
+
+		ok_int((int)kvvec2bbuf(kvv, bbuf, blen - 1), 0, "kvvec2bbuf() must refuse short buffers");
+		ok_int((int)kvvec2bbuf(kvv, bbuf, blen), (int)blen, "kvvec2bbuf() must fill the buffer exactly");
+		kvv2 = kvvec_create(1);
+		ok_int(bbuf2kvvec_prealloc(kvv2, bbuf, blen, KVVEC_ASSIGN), kvv->kv_pairs, "bbuf2kvvec_prealloc() must find all pairs");
+		kvv3 = bbuf2kvvec(bbuf, blen, KVVEC_COPY);
+		for (i = 0; i < kvv->kv_pairs; i++) {
+			struct key_value *kv1 = &kvv->kv[i], *kv2 = &kvv2->kv[i], *kv3 = &kvv3->kv[i];
+			test(kv1->key_len == kv2->key_len && kv1->value_len == kv2->value_len &&
+				 !memcmp(kv1->key, kv2->key, kv1->key_len) &&
+				 !memcmp(kv1->value, kv2->value, kv1->value_len),
+				 "binary kv pair %d must match when assigned", i);
+			test(kv2->key >= bbuf && kv2->key < bbuf + blen, "assigned key %d must point into the buffer", i);
+			test(!kv2->value[kv2->value_len], "assigned value %d must be nul-terminated", i);
+			test(kv3->value_len == kv1->value_len && !memcmp(kv1->value, kv3->value, kv1->value_len),
+				 "binary kv pair %d must match when copied", i);
+		}
+		ok_int(bbuf2kvvec_prealloc(kvv2, bbuf, blen - 1, KVVEC_ASSIGN), -1, "truncated binary buffers must be rejected");
+		ok_int(bbuf2kvvec_prealloc(kvv2, bbuf, blen, KVVEC_APPEND), kvv->kv_pairs, "appending binary buffers must work");
+		free(bbuf);
+	}
+	kvvec_destroy(kvv, KVVEC_FREE_ALL);
+	kvvec_destroy(kvv2, 0);
+	kvvec_destroy(kvv3, KVVEC_FREE_ALL);
+
 	t_end();
 	return 0;
 }
@@ -2,6 +2,8 @@
 #include "runcmd.c"
 #include "t-utils.h"
 #include <stdio.h>
+#include <sys/time.h>
+#include <sys/mman.h>
 
 #define BUF_SIZE 1024
 
@@ -106,39 +108,195 @@ struct {
 	{ 0, NULL, 0, { NULL, NULL, NULL }},
 };
 
+struct {
+	char *cmd;
+	char *env[5];
+	char *output;
+} env_case[] = {
+	{ "printenv RUNCMD_TEST_VAR", { NULL }, "from parent\n" },
+	{ "printenv RUNCMD_TEST_VAR", { "RUNCMD_TEST_VAR", "from env", NULL }, "from env\n" },
+	{ "RUNCMD_TEST_VAR=prefixed printenv RUNCMD_TEST_VAR", { "RUNCMD_TEST_VAR", "from env", NULL }, "prefixed\n" },
+	{ "/bin/sh -c 'echo $RUNCMD_TEST_VAR'", { "RUNCMD_TEST_VAR", "via shell", NULL }, "via shell\n" },
+	{ "/nonexistent/runcmd-test", { NULL }, "execvp(/nonexistent/runcmd-test, ...) failed. errno is 2: No such file or directory\n" },
+	{ NULL, { NULL }, NULL },
+};
+
+struct {
+	char *argv[5];
+	char *env[3];
+	char *output;
+} argv_case[] = {
+	{ { ECHO_COMMAND, "-n", "a b", "'c' $d \\e", NULL }, { NULL }, "a b 'c' $d \\e" },
+	{ { "printenv", "RUNCMD_TEST_VAR", NULL }, { "RUNCMD_TEST_VAR", "from env", NULL }, "from env\n" },
+	{ { "RUNCMD_TEST_VAR=x", "printenv", NULL }, { NULL }, "execvp(RUNCMD_TEST_VAR=x, ...) failed. errno is 2: No such file or directory\n" },
+	{ { NULL }, { NULL }, NULL },
+};
+
 /* We need an iobreg callback to pass to runcmd_open(). */
 static void stub_iobreg(int fdout, int fderr, void *arg) { }
 
+static const char *spawn_name(int method)
+{
+	return method == RUNCMD_SPAWN_POSIX ? "posix_spawn" : "fork";
+}
+
+/* read everything from fd into out */
+static void read_all(int fd, char *out)
+{
+	int len, pos = 0;
+
+	while (pos < BUF_SIZE - 1 && (len = read(fd, out + pos, BUF_SIZE - pos - 1)) > 0)
+		pos += len;
+	out[pos] = 0;
+}
+
+static int test_env(int method)
+{
+	int i;
+	char out[BUF_SIZE];
+
+	t_start("environment passing (%s)", spawn_name(method));
+	runcmd_set_spawn_method(method);
+	setenv("RUNCMD_TEST_VAR", "from parent", 1);
+	for (i = 0; env_case[i].cmd; i++) {
+		int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
+		int stub_iobregarg = 0, fd, status;
+
+		fd = runcmd_open(env_case[i].cmd, pfd, pfderr, env_case[i].env, stub_iobreg, &stub_iobregarg);
+		if (!test(fd >= 0, "runcmd_open(%s) must work", env_case[i].cmd))
+			continue;
+		test(runcmd_pid(fd) > 0, "child must have a pid");
+		read_all(pfd[0], out);
+		if (!*out)
+			read_all(pfderr[0], out);
+		close(pfderr[0]);
+		status = runcmd_close(fd);
+		ok_str(env_case[i].output, out, env_case[i].cmd);
+		test(i == 4 ? status == 2 : !status, "exit code of %s must be right (was %d)", env_case[i].cmd, status);
+	}
+	unsetenv("RUNCMD_TEST_VAR");
+	runcmd_set_spawn_method(RUNCMD_SPAWN_FORK);
+	return t_end();
+}
+
+static int test_open_argv(int method)
+{
+	int i;
+	char out[BUF_SIZE];
+
+	t_start("pre-split argv (%s)", spawn_name(method));
+	runcmd_set_spawn_method(method);
+	for (i = 0; argv_case[i].argv[0]; i++) {
+		int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
+		int stub_iobregarg = 0, fd;
+
+		fd = runcmd_open_argv(argv_case[i].argv, pfd, pfderr, argv_case[i].env, stub_iobreg, &stub_iobregarg);
+		if (!test(fd >= 0, "runcmd_open_argv(%s) must work", argv_case[i].argv[0]))
+			continue;
+		read_all(pfd[0], out);
+		if (!*out)
+			read_all(pfderr[0], out);
+		close(pfderr[0]);
+		runcmd_close(fd);
+		ok_str(argv_case[i].output, out, argv_case[i].argv[0]);
+	}
+	ok_int(runcmd_open_argv(argv_case[i].argv, NULL, NULL, NULL, NULL, NULL), RUNCMD_EINVAL,
+	       "empty argv must be rejected");
+	runcmd_set_spawn_method(RUNCMD_SPAWN_FORK);
+	return t_end();
+}
+
+/*
+ * Measures how many /bin/true's we can start and reap per second,
+ * with a large, fully touched heap to make the page tables as big
+ * as a busy worker's.
+ */
+#define BENCH_SPAWNS 1000
+#define BENCH_HEAP (64 << 20)
+static void spawn_bench(int method, char *heap)
+{
+	struct timeval start, stop;
+	int i, failed = 0;
+	double elapsed;
+
+	runcmd_set_spawn_method(method);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_SPAWNS; i++) {
+		int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
+		int stub_iobregarg = 0, fd;
+
+		fd = runcmd_open("/bin/true", pfd, pfderr, NULL, stub_iobreg, &stub_iobregarg);
+		if (fd < 0) {
+			failed++;
+			continue;
+		}
+		close(pfderr[0]);
+		failed += runcmd_close(fd) != 0;
+	}
+	gettimeofday(&stop, NULL);
+	runcmd_set_spawn_method(RUNCMD_SPAWN_FORK);
+
+	elapsed = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_usec - start.tv_usec) / 1000000;
+	ok_int(failed, 0, "all spawned commands must succeed");
+	t_diag("%s: %d spawns with %dMB heap in %.3fs; %.0f spawns/sec",
+	       spawn_name(method), BENCH_SPAWNS, heap ? BENCH_HEAP >> 20 : 0, elapsed, BENCH_SPAWNS / elapsed);
+}
+
+static int test_exec_output(int method)
+{
+	int i;
+	char *out = calloc(1, BUF_SIZE);
+
+	t_start("exec output comparison (%s)", spawn_name(method));
+	runcmd_set_spawn_method(method);
+	for (i = 0; cases[i].input != NULL; i++) {
+		memset(out, 0, BUF_SIZE);
+		int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
+		/* We need a stub iobregarg since runcmd_open()'s prototype
+		 * declares it attribute non-null. */
+		int stub_iobregarg = 0;
+		int fd;
+		char *cmd;
+		asprintf(&cmd, ECHO_COMMAND " -n %s", cases[i].input);
+		fd = runcmd_open(cmd, pfd, pfderr, NULL, stub_iobreg, &stub_iobregarg);
+		free(cmd);
+		read(pfd[0], out, BUF_SIZE);
+		ok_str(cases[i].output, out, "Echoing a command should give expected output");
+		close(pfd[0]);
+		close(pfderr[0]);
+		close(fd);
+	}
+	free(out);
+	runcmd_set_spawn_method(RUNCMD_SPAWN_FORK);
+	return t_end();
+}
+
 int main(int argc, char **argv)
 {
 	int ret, r2;
+	char *heap;
 
 	runcmd_init();
 	t_set_colors(0);
-	t_start("exec output comparison");
-	{
-		int i;
-		char *out = calloc(1, BUF_SIZE);
-		for (i = 0; cases[i].input != NULL; i++) {
-			memset(out, 0, BUF_SIZE);
-			int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
-			/* We need a stub iobregarg since runcmd_open()'s prototype
-			 * declares it attribute non-null. */
-			int stub_iobregarg = 0;
-			int fd;
-			char *cmd;
-			asprintf(&cmd, ECHO_COMMAND " -n %s", cases[i].input);
-			fd = runcmd_open(cmd, pfd, pfderr, NULL, stub_iobreg, &stub_iobregarg);
-			free(cmd);
-			read(pfd[0], out, BUF_SIZE);
-			ok_str(cases[i].output, out, "Echoing a command should give expected output");
-			close(pfd[0]);
-			close(pfderr[0]);
-			close(fd);
-		}
-		free(out);
+	ret = test_exec_output(RUNCMD_SPAWN_FORK);
+	t_reset();
+	r2 = test_env(RUNCMD_SPAWN_FORK);
+	ret = r2 ? r2 : ret;
+	t_reset();
+	r2 = test_open_argv(RUNCMD_SPAWN_FORK);
+	ret = r2 ? r2 : ret;
+	t_reset();
+	if (!runcmd_set_spawn_method(RUNCMD_SPAWN_POSIX)) {
+		r2 = test_exec_output(RUNCMD_SPAWN_POSIX);
+		ret = r2 ? r2 : ret;
+		t_reset();
+		r2 = test_env(RUNCMD_SPAWN_POSIX);
+		ret = r2 ? r2 : ret;
+		t_reset();
+		r2 = test_open_argv(RUNCMD_SPAWN_POSIX);
+		ret = r2 ? r2 : ret;
+		t_reset();
 	}
-	ret = t_end();
 	t_reset();
 	t_start("anomaly detection");
 	{
@@ -171,6 +329,25 @@ int main(int argc, char **argv)
 		}
 	}
 
+	r2 = t_end();
+	ret = r2 ? r2 : ret;
+	t_reset();
+
+	t_start("spawn benchmarks");
+	spawn_bench(RUNCMD_SPAWN_FORK, NULL);
+	if (!runcmd_set_spawn_method(RUNCMD_SPAWN_POSIX))
+		spawn_bench(RUNCMD_SPAWN_POSIX, NULL);
+	if ((heap = malloc(BENCH_HEAP))) {
+#ifdef MADV_NOHUGEPAGE
+		/* a busy worker's heap is made of small allocations */
+		madvise(heap, BENCH_HEAP, MADV_NOHUGEPAGE);
+#endif
+		memset(heap, 1, BENCH_HEAP);
+		spawn_bench(RUNCMD_SPAWN_FORK, heap);
+		if (!runcmd_set_spawn_method(RUNCMD_SPAWN_POSIX))
+			spawn_bench(RUNCMD_SPAWN_POSIX, heap);
+		free(heap);
+	}
 	r2 = t_end();
 	return r2 ? r2 : ret;
 }
@@ -12,21 +12,38 @@
 #include "squeue.c"
 #include "t-utils.h"
 
+static int sq_collect(squeue_event *evt, void *arg)
+{
+	squeue_event ***next = (squeue_event ***)arg;
+	**next = evt;
+	(*next)++;
+	return 0;
+}
+
+static int sq_cmp_evt(const void *a_, const void *b_)
+{
+	const squeue_event *a = *(const squeue_event **)a_;
+	const squeue_event *b = *(const squeue_event **)b_;
+
+	if (a->pri == b->pri)
+		return 0;
+	return a->pri < b->pri ? -1 : 1;
+}
+
 static void squeue_foreach(squeue_t *q, int (*walker)(squeue_event *, void *), void *arg)
 {
-	squeue_t *dup;
-	void *e, *dup_d;
+	squeue_event **ary, **next;
+	unsigned int i, size = squeue_size(q);
 
-	dup = squeue_create(q->size);
-	dup_d = dup->d;
-	memcpy(dup, q, sizeof(*q));
-	dup->d = dup_d;
-	memcpy(dup->d, q->d, (q->size * sizeof(void *)));
+	if (!(next = ary = calloc(size + 1, sizeof(*ary))))
+		return;
 
-	while ((e = pqueue_pop(dup))) {
-		walker(e, arg);
+	squeue_walk(q, sq_collect, &next);
+	qsort(ary, size, sizeof(*ary), sq_cmp_evt);
+	for (i = 0; i < size; i++) {
+		walker(ary[i], arg);
 	}
-	squeue_destroy(dup, 0);
+	free(ary);
 }
 
 #define t(expr, args...) \
@@ -73,7 +90,7 @@ static int sq_test_random(squeue_t *sq)
 		t(squeue_size(sq) == i + 1 + size);
 	}
 
-	t(pqueue_is_valid(sq));
+	t(pqueue_is_valid(sq->pq));
 
 	/*
 	 * make sure we pop events in increasing "priority",
@@ -87,29 +104,80 @@ static int sq_test_random(squeue_t *sq)
 		max = *d;
 		t(squeue_size(sq) == size + (EVT_ARY - i - 1));
 	}
-	t(pqueue_is_valid(sq));
+	t(pqueue_is_valid(sq->pq));
 
 	return 0;
 }
 
-int main(int argc, char **argv)
+/*
+ * Spreads events over several days, so that the timing wheel has
+ * to cascade events between levels and through its overflow queue,
+ * then removes every third event and makes sure the rest pop out
+ * in order.
+ */
+#define SPREAD_EVTS 20000
+static void sq_test_spread(int backend)
 {
 	squeue_t *sq;
+	squeue_event **evts;
 	struct timeval tv;
-	sq_test_event a, b, c, d, *x;
+	time_t now = time(NULL);
+	unsigned long long *d, prev = 0;
+	unsigned long long *pri;
+	unsigned int i, popped = 0, misordered = 0, expected = 0;
 
-	t_set_colors(0);
-	t_start("squeue tests");
+	sq = squeue_create_backend(1024, backend);
+	evts = calloc(SPREAD_EVTS, sizeof(*evts));
+	pri = calloc(SPREAD_EVTS, sizeof(*pri));
+	t_req(sq != NULL && evts != NULL && pri != NULL);
+
+	for (i = 0; i < SPREAD_EVTS; i++) {
+		tv.tv_sec = now + (rand() % (i & 1 ? 300 : 40000000));
+		tv.tv_usec = rand() % 1000000;
+		evts[i] = squeue_add_tv(sq, &tv, &pri[i]);
+		pri[i] = evts[i]->pri;
+	}
+	t(squeue_size(sq) == SPREAD_EVTS);
+
+	for (i = 0; i < SPREAD_EVTS; i++) {
+		if (i % 3)
+			expected++;
+		else
+			squeue_remove(sq, evts[i]);
+	}
+	t(squeue_size(sq) == expected);
+
+	while ((d = squeue_pop(sq))) {
+		if (*d < prev)
+			misordered++;
+		prev = *d;
+		popped++;
+	}
+	t(popped == expected, "popped: %u; expected: %u", popped, expected);
+	t(misordered == 0, "%u events popped out of order", misordered);
+	t(squeue_size(sq) == 0);
+
+	squeue_destroy(sq, 0);
+	free(evts);
+	free(pri);
+}
+
+static void sq_test_backend(int backend)
+{
+	squeue_t *sq, *sq2;
+	sq_test_event a, b, c, d, e, *x;
+
+	t_start("squeue tests (%s backend)",
+	        backend == SQUEUE_BACKEND_WHEEL ? "timing wheel" : "heap");
 
 	a.id = 1;
 	b.id = 2;
 	c.id = 3;
 	d.id = 4;
+	e.id = 5;
 
-	gettimeofday(&tv, NULL);
 	/* Order in is a, b, c, d, but we should get b, c, d, a out. */
-	srand(tv.tv_usec ^ tv.tv_sec);
-	t((sq = squeue_create(1024)) != NULL);
+	t((sq = squeue_create_backend(1024, backend)) != NULL);
 	t(squeue_size(sq) == 0);
 
 	/* we fill and empty the squeue completely once before testing */
@@ -170,10 +238,113 @@ int main(int argc, char **argv)
 	t(squeue_remove(NULL, NULL) == -1);
 	t(squeue_remove(NULL, a.evt) == -1);
 
+	/* an event from some other queue is left alone, and so is the queue */
+	t((sq2 = squeue_create_backend(1024, backend)) != NULL);
+	t((e.evt = squeue_add(sq2, time(NULL) + 7, &e)) != NULL);
+	t(squeue_remove(sq, e.evt) == -1);
+	t(squeue_size(sq) == 2, "squeue_size(sq) = %d\n", squeue_size(sq));
+	t(squeue_size(sq2) == 1);
+	t(squeue_pop(sq2) == &e);
+	t(squeue_remove(sq2, d.evt) == -1);
+	t(squeue_size(sq2) == 0);
+	squeue_destroy(sq2, 0);
+
+	sq_high = 0;
 	squeue_foreach(sq, sq_walker, NULL);
 
 	/* clean up to prevent false valgrind positives */
 	squeue_destroy(sq, 0);
 
+	sq_test_spread(backend);
+
+	t_end();
+}
+
+static double sq_tv_delta(struct timeval *start, struct timeval *stop)
+{
+	return (double)(stop->tv_sec - start->tv_sec) +
+		(double)(stop->tv_usec - start->tv_usec) / 1000000;
+}
+
+/*
+ * Benchmarks a backend with 1M events spread over the next four
+ * hours, first with a plain fill-and-drain and then in the steady
+ * state of a running scheduler, where each popped event is re-added
+ * one check interval later.
+ */
+#define BENCH_EVTS 1000000
+static void sq_bench(int backend)
+{
+	squeue_t *sq;
+	struct timeval tv, start, stop;
+	time_t now = time(NULL);
+	unsigned long i, misordered = 0;
+	unsigned long long *d, prev = 0;
+	static unsigned long long pri[BENCH_EVTS];
+	double fill, drain, steady;
+
+	sq = squeue_create_backend(BENCH_EVTS, backend);
+	t_req(sq != NULL);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_EVTS; i++) {
+		tv.tv_sec = now + (rand() % 14400);
+		tv.tv_usec = rand() % 1000000;
+		squeue_add_tv(sq, &tv, &pri[i]);
+		pri[i] = evt_compute_pri(&tv);
+	}
+	gettimeofday(&stop, NULL);
+	fill = sq_tv_delta(&start, &stop);
+
+	gettimeofday(&start, NULL);
+	while ((d = squeue_pop(sq))) {
+		if (*d < prev)
+			misordered++;
+		prev = *d;
+	}
+	gettimeofday(&stop, NULL);
+	drain = sq_tv_delta(&start, &stop);
+	t(misordered == 0, "%lu events popped out of order", misordered);
+
+	/* the wheel has moved on to 'now + 4h', so start over */
+	squeue_destroy(sq, 0);
+	sq = squeue_create_backend(BENCH_EVTS, backend);
+	t_req(sq != NULL);
+	for (i = 0; i < BENCH_EVTS; i++) {
+		tv.tv_sec = now + (rand() % 300);
+		tv.tv_usec = rand() % 1000000;
+		squeue_add_tv(sq, &tv, &pri[i]);
+	}
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_EVTS; i++) {
+		d = squeue_pop(sq);
+		tv.tv_sec = now + 300 + (i / 3000);
+		tv.tv_usec = rand() % 1000000;
+		squeue_add_tv(sq, &tv, d);
+	}
+	gettimeofday(&stop, NULL);
+	steady = sq_tv_delta(&start, &stop);
+
+	t_diag("%s: %d events; fill %.3fs, drain %.3fs, pop+re-add %.3fs",
+	       backend == SQUEUE_BACKEND_WHEEL ? "timing wheel" : "heap",
+	       BENCH_EVTS, fill, drain, steady);
+	squeue_destroy(sq, 0);
+}
+
+int main(int argc, char **argv)
+{
+	struct timeval tv;
+
+	t_set_colors(0);
+
+	gettimeofday(&tv, NULL);
+	srand(tv.tv_usec ^ tv.tv_sec);
+
+	sq_test_backend(SQUEUE_BACKEND_HEAP);
+	sq_test_backend(SQUEUE_BACKEND_WHEEL);
+
+	t_start("squeue benchmarks");
+	sq_bench(SQUEUE_BACKEND_HEAP);
+	sq_bench(SQUEUE_BACKEND_WHEEL);
 	return t_end();
 }
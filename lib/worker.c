@@ -31,6 +31,7 @@ static iobroker_set *iobs;
 static squeue_t *sq;
 static unsigned int started, running_jobs, timeouts, reapable;
 static int master_sd;
+static int framing = WORKER_FRAMING_TEXT;
 static int parent_pid;
 static fanout_table *ptab;
 
@@ -100,12 +101,29 @@ static void wlog(const char *fmt, ...)
 		return;
 	}
 
-	len += LOG_KEY_LEN; /* log= */
-	if (len > sizeof(lmsg) - MSG_DELIM_LEN - 1) {
+	if (len > sizeof(lmsg) - LOG_KEY_LEN - MSG_DELIM_LEN - 1) {
 		/* A truncated log is better than no log or buffer overflows. */
-		len = sizeof(lmsg) - MSG_DELIM_LEN - 1;
+		len = sizeof(lmsg) - LOG_KEY_LEN - MSG_DELIM_LEN - 1;
+	}
+
+	if (framing == WORKER_FRAMING_BINARY) {
+		struct kvvec kvv = KVVEC_INITIALIZER;
+		struct key_value kv;
+
+		kv.key = (char *)"log";
+		kv.key_len = 3;
+		kv.value = lmsg + LOG_KEY_LEN;
+		kv.value_len = len;
+		kvv.kv = &kv;
+		kvv.kv_pairs = kvv.kv_alloc = 1;
+		if (worker_send_kvvec_framed(master_sd, &kvv, framing) < 0 && errno == EPIPE) {
+			exit_worker(1, "Failed to write() to master");
+		}
+		return;
 	}
 
+	len += LOG_KEY_LEN; /* log= */
+
 	/* Add the kv pair separator and the message delimiter. */
 	lmsg[len] = 0;
 	len++;
@@ -145,7 +163,7 @@ static void job_error(child_process *cp, struct kvvec *kvv, const char *fmt, ...
 	}
 	kvvec_addkv_wlen(kvv, "error_msg", 9, msg, len);
 
-	if (worker_send_kvvec(master_sd, kvv) < 0 && errno == EPIPE) {
+	if (worker_send_kvvec_framed(master_sd, kvv, framing) < 0 && errno == EPIPE) {
 		/* Master has died or abandoned us, so exit. */
 		exit_worker(1, "Failed to send job error key/value vector to master");
 	}
@@ -192,11 +210,87 @@ int send_kvvec(int sd, struct kvvec *kvv)
 	return worker_send_kvvec(sd, kvv);
 }
 
+void worker_set_framing(int mode)
+{
+	framing = mode;
+}
+
+unsigned long worker_kvvec2bmsg(struct kvvec *kvv, char *buf, unsigned long bufsize)
+{
+	unsigned long len, i;
+
+	len = kvvec_bbuf_len(kvv);
+	if (!buf || bufsize < WORKER_FRAME_HDR_LEN + len)
+		return 0;
+	if (kvvec2bbuf(kvv, buf + WORKER_FRAME_HDR_LEN, len) != len)
+		return 0;
+
+	for (i = 0; i < WORKER_FRAME_HDR_LEN; i++) {
+		buf[i] = (len >> (8 * (WORKER_FRAME_HDR_LEN - 1 - i))) & 0xff;
+	}
+
+	return WORKER_FRAME_HDR_LEN + len;
+}
+
+int worker_send_kvvec_framed(int sd, struct kvvec *kvv, int mode)
+{
+	static char *bbuf;
+	static unsigned long bbuf_size;
+	unsigned long len;
+
+	if (mode != WORKER_FRAMING_BINARY)
+		return worker_send_kvvec(sd, kvv);
+
+	/*
+	 * Jobs and results are sent at a furious rate, so we keep the
+	 * buffer around and only grow it when a message doesn't fit
+	 */
+	len = WORKER_FRAME_HDR_LEN + kvvec_bbuf_len(kvv);
+	if (len > bbuf_size) {
+		char *nbuf = realloc(bbuf, len * 2);
+		if (!nbuf)
+			return -1;
+		bbuf = nbuf;
+		bbuf_size = len * 2;
+	}
+	if (!(len = worker_kvvec2bmsg(kvv, bbuf, bbuf_size)))
+		return -1;
+
+	return nwrite(sd, bbuf, len, NULL);
+}
+
 char *worker_ioc2msg(iocache *ioc, unsigned long *size, int flags)
 {
 	return iocache_use_delim(ioc, MSG_DELIM, MSG_DELIM_LEN, size);
 }
 
+char *worker_ioc2bmsg(iocache *ioc, unsigned long *size)
+{
+	unsigned char *hdr;
+	unsigned long len = 0;
+	int i;
+
+	*size = 0;
+	if (iocache_available(ioc) < WORKER_FRAME_HDR_LEN)
+		return NULL;
+
+	hdr = (unsigned char *)iocache_use_size(ioc, WORKER_FRAME_HDR_LEN);
+	if (!hdr)
+		return NULL;
+	for (i = 0; i < WORKER_FRAME_HDR_LEN; i++) {
+		len = (len << 8) | hdr[i];
+	}
+
+	/* not all of it has arrived yet, so leave the header for next time */
+	if (iocache_available(ioc) < len) {
+		iocache_unuse_size(ioc, WORKER_FRAME_HDR_LEN);
+		return NULL;
+	}
+
+	*size = len;
+	return iocache_use_size(ioc, len);
+}
+
 int worker_buf2kvvec_prealloc(struct kvvec *kvv, char *buf, unsigned long len, int kvv_flags)
 {
 	return buf2kvvec_prealloc(kvv, buf, len, KV_SEP, PAIR_SEP, kvv_flags);
@@ -240,6 +334,7 @@ static void destroy_job(child_process *cp)
 	if(NULL != cp->env) kvvec_destroy(cp->env, KVVEC_FREE_ALL);
 	kvvec_destroy(cp->request, KVVEC_FREE_ALL);
 	free(cp->cmd);
+	free(cp->argv);
 
 	free(cp->ei);
 	free(cp);
@@ -294,6 +389,7 @@ int finish_job(child_process *cp, int reason)
 	/*
 	 * Now build the return message.
 	 * First comes the request, minus environment variables
+	 * and the pre-split argv
 	 */
 	for (i = 0; i < cp->request->kv_pairs; i++) {
 		struct key_value *kv = &cp->request->kv[i];
@@ -301,6 +397,10 @@ int finish_job(child_process *cp, int reason)
 		if (kv->key_len == 3 && !strcmp(kv->key, "env")) {
 			continue;
 		}
+		/* the core already has the argv it sent us */
+		if (kv->key_len == 3 && !strcmp(kv->key, "arg")) {
+			continue;
+		}
 		kvvec_addkv_wlen(&resp, kv->key, kv->key_len, kv->value, kv->value_len);
 	}
 	kvvec_addkv(&resp, "wait_status", mkstr("%d", cp->ret));
@@ -317,7 +417,7 @@ int finish_job(child_process *cp, int reason)
 	}
 	kvvec_addkv_wlen(&resp, "outerr", 6, cp->outerr.buf, cp->outerr.len);
 	kvvec_addkv_wlen(&resp, "outstd", 6, cp->outstd.buf, cp->outstd.len);
-	ret = worker_send_kvvec(master_sd, &resp);
+	ret = worker_send_kvvec_framed(master_sd, &resp, framing);
 	if (ret < 0 && errno == EPIPE)
 		exit_worker(1, "Failed to send kvvec struct to master");
 
@@ -575,8 +675,12 @@ int start_cmd(child_process *cp)
 
 	char **env = env_from_kvvec(cp->env);
 
-	cp->outstd.fd = runcmd_open(cp->cmd, pfd, pfderr, env, 
-			cmd_iobroker_register, cp);
+	if (cp->argv)
+		cp->outstd.fd = runcmd_open_argv(cp->argv, pfd, pfderr, env,
+				cmd_iobroker_register, cp);
+	else
+		cp->outstd.fd = runcmd_open(cp->cmd, pfd, pfderr, env,
+				cmd_iobroker_register, cp);
 	my_free(env);
 	if (cp->outstd.fd < 0) {
 		return -1;
@@ -598,7 +702,7 @@ static iocache *ioc;
 
 static child_process *parse_command_kvvec(struct kvvec *kvv)
 {
-	int i;
+	int i, argc = 0;
 	child_process *cp;
 
 	/* get this command's struct and insert it at the top of the list */
@@ -628,6 +732,18 @@ static child_process *parse_command_kvvec(struct kvvec *kvv)
 			cp->cmd = strdup(value);
 			continue;
 		}
+		if (!strcmp(key, "arg")) {
+			/*
+			 * the core has split the command for us already.
+			 * The request stays around until the job is done,
+			 * so we can point straight into it
+			 */
+			if (!cp->argv)
+				cp->argv = calloc(kvv->kv_pairs + 1, sizeof(char *));
+			if (cp->argv)
+				cp->argv[argc++] = value;
+			continue;
+		}
 		if (!strcmp(key, "job_id")) {
 			cp->id = (unsigned int)strtoul(value, &endptr, 0);
 			continue;
@@ -637,7 +753,10 @@ static child_process *parse_command_kvvec(struct kvvec *kvv)
 			continue;
 		}
 		if (!strcmp(key, "env")) {
-			cp->env = buf2kvvec(value, strlen(value), '=', '\n', KVVEC_COPY);
+			if (framing == WORKER_FRAMING_BINARY)
+				cp->env = bbuf2kvvec(value, kv->value_len, KVVEC_COPY);
+			else
+				cp->env = buf2kvvec(value, strlen(value), '=', '\n', KVVEC_COPY);
 			continue;
 		}
 	}
@@ -665,7 +784,7 @@ static void spawn_job(struct kvvec *kvv, int(*cb)(child_process *))
 		job_error(NULL, kvv, "Failed to parse worker-command");
 		return;
 	}
-	if (!cp->cmd) {
+	if (!cp->cmd && !cp->argv) {
 		job_error(cp, kvv, "Failed to parse commandline. Ignoring job %u", cp->id);
 		return;
 	}
@@ -684,7 +803,7 @@ static void spawn_job(struct kvvec *kvv, int(*cb)(child_process *))
 	}
 }
 
-static int receive_command(int sd, int events, void *arg)
+static int read_commands(int sd, void *arg)
 {
 	int ioc_ret;
 	char *buf;
@@ -714,6 +833,15 @@ static int receive_command(int sd, int events, void *arg)
 	 * now loop over all inbound messages in the iocache.
 	 * Since KV_TERMINATOR is a nul-byte, they're separated by 3 nuls
 	 */
+	if (framing == WORKER_FRAMING_BINARY) {
+		while ((buf = worker_ioc2bmsg(ioc, &size))) {
+			struct kvvec *kvv;
+			kvv = bbuf2kvvec(buf, size, KVVEC_COPY);
+			if (kvv)
+				spawn_job(kvv, arg);
+		}
+		return ioc_ret;
+	}
 	while ((buf = iocache_use_delim(ioc, MSG_DELIM, MSG_DELIM_LEN, &size))) {
 		struct kvvec *kvv;
 		/* we must copy vars here, as we preserve them for the response */
@@ -722,6 +850,21 @@ static int receive_command(int sd, int events, void *arg)
 			spawn_job(kvv, arg);
 	}
 
+	return ioc_ret;
+}
+
+/*
+ * The master socket is edge-triggered, so we keep reading until
+ * it's drained
+ */
+static int receive_command(int sd, int events, void *arg)
+{
+	int ret;
+
+	do {
+		ret = read_commands(sd, arg);
+	} while (ret > 0 || (ret < 0 && errno == EINTR));
+
 	return 0;
 }
 
@@ -791,7 +934,7 @@ void enter_worker(int sd, int (*cb)(child_process*))
 	sq = squeue_create(1024);
 	worker_set_sockopts(master_sd, 256 * 1024);
 
-	iobroker_register(iobs, master_sd, cb, receive_command);
+	iobroker_register_flags(iobs, master_sd, cb, receive_command, IOBROKER_EDGE_TRIGGERED);
 	while (iobroker_get_num_fds(iobs) > 0) {
 		int poll_time = -1;
 
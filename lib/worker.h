@@ -22,6 +22,22 @@
 #define ETIME ETIMEDOUT
 #endif
 
+/**
+ * @name Worker socket framing
+ * Messages between core and workers are normally key=value pairs
+ * separated by nul bytes and terminated by a special delimiter.
+ * Workers that offer "framing=binary" when registering and get
+ * "OK framing=binary" back switch to binary framing instead, where
+ * each message is a 4 byte length (network byte order) followed by
+ * a kvvec2bbuf() payload. The environment is then shipped as a
+ * nested binary payload in the "env" value.
+ * @{
+ */
+#define WORKER_FRAMING_TEXT   0 /**< delimited key=value messages */
+#define WORKER_FRAMING_BINARY 1 /**< length-prefixed binary messages */
+#define WORKER_FRAME_HDR_LEN  4 /**< size of the binary length prefix */
+/** @} */
+
 typedef struct iobuf {
 	int fd;
 	unsigned int len;
@@ -39,6 +55,7 @@ typedef struct child_process {
 	iobuf outstd;
 	iobuf outerr;
 	execution_information *ei;
+	char **argv; /**< pre-split command, points into request */
 } child_process;
 
 /**
@@ -108,6 +125,47 @@ extern int send_kvvec(int sd, struct kvvec *kvv)
  */
 extern char *worker_ioc2msg(iocache *ioc, unsigned long *size, int flags);
 
+/**
+ * Select the framing used by enter_worker() and friends when
+ * talking to the master. Must be called before enter_worker().
+ * @param framing One of the WORKER_FRAMING_* values
+ */
+extern void worker_set_framing(int framing);
+
+/**
+ * Frame a key/value vector as a binary worker message in a
+ * caller-supplied buffer: the length prefix followed by the
+ * kvvec2bbuf() payload.
+ * @param kvv The key/value vector to frame
+ * @param buf The buffer to write into
+ * @param bufsize Size of 'buf'. Must be at least
+ *                WORKER_FRAME_HDR_LEN + kvvec_bbuf_len(kvv)
+ * @return The number of bytes written, or 0 on errors
+ */
+extern unsigned long worker_kvvec2bmsg(struct kvvec *kvv, char *buf, unsigned long bufsize);
+
+/**
+ * Send a key/value vector through a socket using the given framing.
+ * Binary messages are built in a buffer that is reused between
+ * calls, so this is not thread-safe.
+ * @param[in] sd The socket descriptor to send to
+ * @param kvv The key/value vector to send
+ * @param framing One of the WORKER_FRAMING_* values
+ * @return The number of bytes sent, or -1 on errors
+ */
+extern int worker_send_kvvec_framed(int sd, struct kvvec *kvv, int framing);
+
+/**
+ * Grab a length-prefixed binary worker message from an iocache
+ * buffer. The returned payload (sans length prefix) can be parsed
+ * in place with bbuf2kvvec_prealloc().
+ * @param[in] ioc The io cache
+ * @param[out] size Out buffer for payload length
+ * @return A buffer from the iocache on success; NULL if no complete
+ *         message is available yet
+ */
+extern char *worker_ioc2bmsg(iocache *ioc, unsigned long *size);
+
 /**
  * Parse a worker message to a preallocated key/value vector
  *
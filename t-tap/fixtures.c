@@ -0,0 +1,53 @@
+/*
+ * Scratch directories for what the tests write. The object configs
+ * they read are checked in under etc/, with a nagios-<name>.cfg main
+ * config for each of them.
+ */
+#include <dirent.h>
+
+/* makes /tmp/nagios-<name>.XXXXXX and returns its path, or NULL */
+char *make_scratch_dir(const char *name) {
+	char *dir = NULL;
+
+	if(asprintf(&dir, "/tmp/nagios-%s.XXXXXX", name) < 0)
+		return NULL;
+	if(mkdtemp(dir) == NULL) {
+		free(dir);
+		return NULL;
+		}
+	return dir;
+	}
+
+/* the path of 'file' in a scratch directory, for the caller to free */
+char *scratch_path(const char *dir, const char *file) {
+	char *path = NULL;
+
+	if(asprintf(&path, "%s/%s", dir, file) < 0)
+		return NULL;
+	return path;
+	}
+
+/* removes a scratch directory along with whatever was left in it */
+int remove_scratch_dir(char *dir) {
+	struct dirent *de;
+	char *path;
+	DIR *dp;
+	int result;
+
+	if(dir == NULL)
+		return -1;
+	if((dp = opendir(dir)) != NULL) {
+		while((de = readdir(dp)) != NULL) {
+			if(!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+				continue;
+			if((path = scratch_path(dir, de->d_name)) != NULL) {
+				unlink(path);
+				free(path);
+				}
+			}
+		closedir(dp);
+		}
+	result = rmdir(dir);
+	free(dir);
+	return result;
+	}
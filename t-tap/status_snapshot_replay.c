@@ -0,0 +1,47 @@
+/*****************************************************************************
+*
+* status_snapshot_replay.c - Print a status snapshot and its delta log
+*                            the way the CGIs replay them
+*
+* Program: Nagios Core Testing
+* License: GPL
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+*****************************************************************************/
+
+/*
+ * The core writes the snapshot and the CGIs read it, so
+ * test_status_snapshot runs this to see what a CGI would make of it.
+ */
+
+/* Need these to get CGI mode */
+#undef NSCORE
+#define NSCGI 1
+#include "../xdata/xsddefault.c"
+
+int main(int argc, char **argv) {
+	char *text;
+
+	if(argc != 2) {
+		fprintf(stderr, "Usage: %s <status snapshot file>\n", argv[0]);
+		return 2;
+		}
+	if((text = xsddefault_read_status_snapshot(argv[1])) == NULL)
+		return 1;
+	fputs(text, stdout);
+	free(text);
+
+	return 0;
+	}
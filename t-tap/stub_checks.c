@@ -13,7 +13,7 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 int reap_check_results(void) 
 { return OK; }
 
-void check_for_orphaned_services(void) 
+void handle_orphaned_service_check(service *svc, time_t current_time)
 { }
 
 void check_service_result_freshness(void) 
@@ -25,7 +25,16 @@ int run_scheduled_host_check(host *hst, int check_options, double latency)
 void check_host_result_freshness(void) 
 { }
 
-void check_for_orphaned_hosts(void) 
+void update_service_freshness_deadline(service *svc)
+{ }
+
+void update_host_freshness_deadline(host *hst)
+{ }
+
+void free_freshness_data(void)
+{ }
+
+void handle_orphaned_host_check(host *hst, time_t current_time)
 { }
 
 #ifndef TEST_EVENTS_C
@@ -34,3 +43,6 @@ int run_scheduled_service_check(service *svc, int check_options, double latency)
 { return OK; }
 
 #endif
+
+void init_freshness_data(void)
+{ }
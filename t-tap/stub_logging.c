@@ -10,6 +10,9 @@ int fix_log_file_owner(uid_t uid, gid_t gid)
 int close_log_file(void) 
 { return OK; }
 
+int stop_log_writer(void)
+{ return OK; }
+
 int rotate_log_file(time_t rotation_time) 
 { return OK; }
 
@@ -12,6 +12,12 @@ int grab_service_macros_r(nagios_macros *mac, service *svc)
 int process_macros_r(nagios_macros *mac, char *input_buffer, char **output_buffer, int options) 
 { return OK; }
 
+struct macro_template *compile_macro_template(const char *input)
+{ return NULL; }
+
+int process_macro_template_r(nagios_macros *mac, const struct macro_template *tmpl, char **output_buffer, int options)
+{ return OK; }
+
 int clear_volatile_macros_r(nagios_macros *mac) 
 { return OK; }
 
@@ -29,3 +35,6 @@ int clear_argv_macros_r(nagios_macros *mac)
 
 int set_all_macro_environment_vars_r(nagios_macros *mac, int set) 
 { return OK; }
+
+void invalidate_macro_environment_cache(void)
+{}
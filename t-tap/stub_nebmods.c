@@ -12,3 +12,6 @@ int neb_deinit_modules(void)
 
 int neb_add_module(char *filename, char *args, int should_be_loaded) 
 { return OK; }
+
+int neb_load_all_modules(void) 
+{ return OK; }
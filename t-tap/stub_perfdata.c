@@ -9,3 +9,6 @@ int initialize_performance_data(const char *cfgfile)
 
 int cleanup_performance_data(void) 
 { return OK; }
+
+int update_performance_data_commands(void) 
+{ return OK; }
@@ -10,6 +10,9 @@ int update_contact_status(contact *cntct, int aggregated_dump)
 int update_all_status_data(void) 
 { return OK; }
 
+int reset_object_status_data(void) 
+{ return OK; }
+
 
 #if !(defined(TEST_CHECKS_C) || defined(TEST_EVENTS_C))
 
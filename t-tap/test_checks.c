@@ -1463,6 +1463,74 @@ void run_misc_service_check_tests()
         "run service check is ERROR when object is null");
 }
 
+void run_freshness_tests()
+{
+    service *svc2 = NULL;
+    service *svcs[2];
+    time_t now = 0L;
+
+    time(&now);
+
+    create_objects(STATE_UP, HARD_STATE, "host up", STATE_OK, HARD_STATE, "service ok");
+    svc2 = (service *) calloc(1, sizeof(service));
+    svc2->host_name   = HOST_NAME;
+    svc2->description = "svc2";
+    svc2->id          = 1;
+    svcs[0] = svc1;
+    svcs[1] = svc2;
+    service_ary = svcs;
+    num_objects.services = 2;
+
+    check_service_freshness = TRUE;
+    service_freshness_check_interval = 60;
+    interval_length = 60;
+    event_start = now - 3600;
+
+    /* svc1 was checked a moment ago, svc2 went stale long ago */
+    svc1->check_freshness     = svc2->check_freshness     = TRUE;
+    svc1->freshness_threshold = svc2->freshness_threshold = 60;
+    svc1->checks_enabled      = svc2->checks_enabled      = TRUE;
+    svc2->has_been_checked    = TRUE;
+    svc2->check_interval      = 5;
+    svc1->last_check = now - 30;
+    svc2->last_check = now - 600;
+    init_freshness_data();
+
+    check_service_result_freshness();
+    ok(svc2->is_being_freshened == TRUE && svc1->is_being_freshened == FALSE,
+        "only the stale service gets a freshness check");
+
+    /* nothing is scanned; svc1 isn't looked at before its deadline */
+    svc2->is_being_freshened = FALSE;
+    svc1->last_check = now - 600;
+    check_service_result_freshness();
+    ok(svc1->is_being_freshened == FALSE && svc2->is_being_freshened == FALSE,
+        "deadlines that haven't passed don't fire, and fired ones are re-armed for later");
+
+    /* a result moves the deadline, here to one that has already passed */
+    create_check_result(CHECK_TYPE_ACTIVE, STATE_OK, "service ok");
+    handle_svc1();
+    check_service_result_freshness();
+    ok(svc1->is_being_freshened == TRUE,
+        "a check result re-arms the deadline");
+
+    /* and a fresh result moves it back out */
+    svc1->is_being_freshened = FALSE;
+    chk_result->start_time.tv_sec = now;
+    chk_result->finish_time.tv_sec = now;
+    handle_svc1();
+    check_service_result_freshness();
+    ok(svc1->is_being_freshened == FALSE,
+        "a fresh result pushes the deadline back");
+
+    free_freshness_data();
+    service_ary = NULL;
+    num_objects.services = 0;
+    check_service_freshness = FALSE;
+    free(svc2);
+    free_all();
+}
+
 void run_reaper_tests()
 {
     /* test null dir */
@@ -1530,7 +1598,7 @@ int main(int argc, char **argv)
     accept_passive_host_checks      = TRUE;
     accept_passive_service_checks   = TRUE;
 
-    plan_tests(453);
+    plan_tests(457);
 
     time(&now);
 
@@ -1543,6 +1611,7 @@ int main(int argc, char **argv)
     run_passive_host_tests();
 
     run_misc_host_check_tests(now);
+    run_freshness_tests();
     run_reaper_tests();
 
     return exit_status();
@@ -131,7 +131,7 @@ int
 main() {
 	time_t now = 0L;
 
-	plan_tests(62);
+	plan_tests(84);
 
 	ok(test_start_time == 0L, "Start time is empty");
 	ok(test_comment == NULL, "And test_comment is blank");
@@ -228,6 +228,50 @@ main() {
 	ok(test_servicename == NULL, "servicename right") || diag("servicename=%s", test_servicename);
 	ok(strcmp(test_comment, "comment") == 0, "comment right") || diag("comment=%s", test_comment);
 
+	/* external command lines are split up the same way by the worker and the core */
+	ok(external_command_id("PROCESS_SERVICE_CHECK_RESULT") == CMD_PROCESS_SERVICE_CHECK_RESULT, "external_command_id finds commands");
+	ok(external_command_id("enter_standby_mode") == CMD_DISABLE_NOTIFICATIONS, "external_command_id ignores case and knows aliases");
+	ok(external_command_id("_MY_COMMAND") == CMD_CUSTOM_COMMAND, "external_command_id knows custom commands");
+	ok(external_command_id("NO_SUCH_COMMAND") == CMD_NONE, "external_command_id rejects unknown commands");
+	ok(external_command_id("") == CMD_NONE, "external_command_id rejects empty names");
+
+	{
+		struct external_command ec;
+		char line[256];
+
+		strcpy(line, "no entry time");
+		ok(parse_external_command(line, &ec) == CMD_ERROR_MALFORMED_COMMAND, "parse_external_command rejects lines without an entry time");
+		strcpy(line, "[1234567890]");
+		ok(parse_external_command(line, &ec) == CMD_ERROR_MALFORMED_COMMAND, "parse_external_command rejects lines without a command");
+
+		strcpy(line, "[1234567890] SHUTDOWN_PROGRAM\r\n");
+		ok(parse_external_command(line, &ec) == CMD_ERROR_OK, "parse_external_command accepts commands without arguments");
+		ok(ec.id == CMD_SHUTDOWN_PROCESS && ec.entry_time == 1234567890L, "command id and entry time are right");
+		ok(!strcmp(ec.name, "SHUTDOWN_PROGRAM") && !strcmp(ec.args, ""), "name and arguments are right") || diag("name=%s args=%s", ec.name, ec.args);
+		ok(ec.split_args == NULL && ec.output == NULL, "other commands' arguments aren't split up");
+
+		strcpy(line, "[1] BOGUS_COMMAND;some;args");
+		ok(parse_external_command(line, &ec) == CMD_ERROR_OK && ec.id == CMD_NONE, "unknown commands are parsed, but have no id");
+		ok(!strcmp(ec.args, "some;args"), "arguments are right");
+
+		strcpy(line, "[1] PROCESS_SERVICE_CHECK_RESULT;host1;svc1;2;CRITICAL\\nsecond\\\\line|perf=1");
+		ok(parse_external_command(line, &ec) == CMD_ERROR_OK, "parse_external_command accepts service check results");
+		ok(!strcmp(ec.args, "host1;svc1;2;CRITICAL\\nsecond\\\\line|perf=1"), "raw arguments are kept") || diag("args=%s", ec.args);
+		ok(!strcmp(ec.host_name, "host1") && !strcmp(ec.service_description, "svc1"), "host and service are split up");
+		ok(ec.return_code == 2, "return code is split up");
+		ok(!strcmp(ec.output, "CRITICAL\nsecond\\line|perf=1"), "output is unescaped") || diag("output=%s", ec.output);
+		my_free(ec.split_args);
+
+		strcpy(line, "[1] PROCESS_HOST_CHECK_RESULT;host1;0");
+		ok(parse_external_command(line, &ec) == CMD_ERROR_OK, "parse_external_command accepts host check results");
+		ok(!strcmp(ec.host_name, "host1") && ec.service_description == NULL && ec.return_code == 0, "host and return code are split up");
+		ok(ec.output && !strcmp(ec.output, ""), "output may be empty");
+		my_free(ec.split_args);
+
+		strcpy(line, "[1] PROCESS_SERVICE_CHECK_RESULT;host1;svc1");
+		ok(parse_external_command(line, &ec) == CMD_ERROR_OK && ec.output == NULL, "incomplete check results are left for the command to reject");
+		my_free(ec.split_args);
+	}
 
 	return exit_status();
 	}
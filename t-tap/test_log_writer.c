@@ -0,0 +1,132 @@
+/*****************************************************************************
+*
+* test_log_writer.c - Test the asynchronous log writer
+*
+* Program: Nagios Core Testing
+* License: GPL
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+*****************************************************************************/
+
+#define NSCORE 1
+#include "../base/logging.c"
+
+#include "tap.h"
+#include "stub_perfdata.c"
+#include "stub_workers.c"
+#include "stub_events.c"
+#include "stub_commands.c"
+#include "stub_checks.c"
+#include "stub_nebmods.c"
+#include "stub_netutils.c"
+#include "stub_broker.c"
+#include "stub_statusdata.c"
+#include "stub_flapping.c"
+#include "stub_notifications.c"
+#include "fixtures.c"
+
+/* log 'count' lines numbered from 'first', with lengths that make the ring wrap */
+static void log_lines(unsigned int first, unsigned int count) {
+	char buf[1024];
+	time_t stamp;
+	unsigned int i, len;
+
+	for(i = first; i < first + count; i++) {
+		stamp = i;
+		len = snprintf(buf, sizeof(buf), "line %u:", i);
+		memset(buf + len, 'x', i * 37 % 700);
+		buf[len + i * 37 % 700] = 0;
+		write_to_log(buf, NSLOG_INFO_MESSAGE, &stamp);
+		}
+	}
+
+/*
+ * does the log hold lines 0 up to 'count', in order and each whole,
+ * with 'big' (if set) as a line of its own right after line 'big_at'?
+ */
+static int log_has_lines(unsigned int count, const char *big, unsigned int big_at) {
+	char *line = NULL, expect[64];
+	size_t line_size = 0;
+	unsigned int next = 0, len;
+	int result = TRUE, big_seen = FALSE;
+	FILE *fp;
+
+	if((fp = fopen(log_file, "r")) == NULL)
+		return FALSE;
+	while(result == TRUE && getline(&line, &line_size, fp) > 0) {
+		if(big && next == big_at + 1 && big_seen == FALSE) {
+			big_seen = TRUE;
+			if(strncmp(line, "[0] ", 4) || strncmp(line + 4, big, strlen(big)) || line[4 + strlen(big)] != '\n')
+				result = FALSE;
+			continue;
+			}
+		len = snprintf(expect, sizeof(expect), "[%u] line %u:", next, next);
+		if(strncmp(line, expect, len) || strspn(line + len, "x") != next * 37 % 700 || line[len + next * 37 % 700] != '\n') {
+			diag("line %u is '%.60s'", next, line);
+			result = FALSE;
+			}
+		next++;
+		}
+	free(line);
+	fclose(fp);
+
+	return result == TRUE && next == count && (big == NULL || big_seen == TRUE);
+	}
+
+int main(int argc, char **argv) {
+	char *dir, *big;
+	time_t zero = 0;
+
+	plan_tests(9);
+
+	ok((dir = make_scratch_dir("logwriter")) != NULL, "Made log directory");
+	log_file = scratch_path(dir, "nagios.log");
+	logging_options = NSLOG_INFO_MESSAGE;
+	use_syslog = FALSE;
+	use_async_log_writer = TRUE;
+	async_log_buffer_size = 0;
+
+	ok(start_log_writer() == OK && lw.running == TRUE && lw.size == 65536, "Started log writer with the smallest ring");
+
+	/* many times the ring's size, so the producer waits on the writer and entries pad the ring's end */
+	log_lines(0, 2000);
+	ok(lw.tail > 4 * lw.size, "Producer went round the ring several times");
+	close_log_file();
+	ok(lw.head == lw.tail, "Closing the log drains the ring");
+	ok(log_has_lines(2000, NULL, 0), "Every line written once, whole and in order");
+
+	/* a line too big for the ring is written directly, after what's queued */
+	big = calloc(1, lw.size);
+	memset(big, 'B', lw.size - 1);
+	log_lines(2000, 100);
+	write_to_log(big, NSLOG_INFO_MESSAGE, &zero);
+	log_lines(2100, 100);
+	close_log_file();
+	ok(log_has_lines(2200, big, 2099), "Oversized line keeps its place among queued ones");
+
+	/* stopping the writer flushes, and logging goes on without it */
+	log_lines(2200, 300);
+	ok(stop_log_writer() == OK && lw.running == FALSE && lw.buf == NULL, "Stopping the log writer drains the ring");
+	log_lines(2500, 10);
+	close_log_file();
+	ok(log_has_lines(2510, big, 2099), "Lines logged after it stopped follow on directly");
+	ok(stop_log_writer() == OK, "Stopping it twice is harmless");
+	free(big);
+
+	my_free(log_file);
+	remove_scratch_dir(dir);
+
+	return exit_status();
+	}
@@ -209,12 +209,21 @@ void setup_environment()
 
 #define RUN_MACRO_TEST(_STR, _EXPECT, _OPTS)                                                        \
     do {                                                                                            \
+        struct macro_template *_tmpl;                                                               \
         if (process_macros_r(mac, (_STR), &output, _OPTS) == OK) {                                  \
             ok(strcmp(output, _EXPECT) == 0, "'%s': '%s' == '%s'", (_STR), output, (_EXPECT));      \
         } else {                                                                                    \
             fail("process_macros_r returns ERROR for " _STR);                                       \
         }                                                                                           \
         my_free(output);                                                                            \
+        _tmpl = compile_macro_template(_STR);                                                       \
+        if (process_macro_template_r(mac, _tmpl, &output, _OPTS) == OK) {                           \
+            ok(strcmp(output, _EXPECT) == 0, "template '%s': '%s' == '%s'", (_STR), output, (_EXPECT)); \
+        } else {                                                                                    \
+            fail("process_macro_template_r returns ERROR for " _STR);                               \
+        }                                                                                           \
+        my_free(output);                                                                            \
+        my_free(_tmpl);                                                                             \
     } while(0)
 
 #define ALLOC_MACROS(_STR)                                                                          \
@@ -351,19 +360,208 @@ void test_escaping(nagios_macros *mac)
     ALLOC_MACROS("$TOTALSERVICESCRITICALUNHANDLED$");
 }
 
+#define BENCH_COMMAND "$USER1$/check_ping -H $HOSTADDRESS$ -w $ARG1$ -c $ARG2$ -p 5 -t $SERVICEDESC$"
+
+/*
+    Compiled templates must expand exactly like process_macros_r() does,
+    including the odd cases: escaped and stray $'s, unknown macros,
+    argument macros and on-demand macros
+*/
+static const char *template_case[] = {
+    "",
+    "no macros at all",
+    "$$",
+    "100$$ sure $",
+    "$HOSTNAME$$SERVICEDESC$",
+    "$HOSTNAME",
+    "trailing $HOSTADDRESS",
+    "$NOSUCHMACRO$ and $NOSUCH:MACRO$",
+    "$ARG1$ $ARG2$ $ARG0$ $ARG99$",
+    "$USER1$ $USER2$ $USER0$",
+    "$HOSTADDRESS$ $HOSTOUTPUT$ $SERVICEOUTPUT$",
+    "$HOSTNAME:name'&%$ $SERVICEDESC:name'&%:service'&&%$",
+    "$_HOSTNOSUCHVAR$ $CONTACTADDRESS0$",
+    "$HOSTGROUPNAME$ $SERVICEGROUPNOTES$ $HOSTNOTESURL$",
+    BENCH_COMMAND,
+    NULL,
+};
+
+void test_templates(nagios_macros *mac)
+{
+    static const int opts[] = {
+        NO_OPTIONS,
+        STRIP_ILLEGAL_MACRO_CHARS | ESCAPE_MACRO_CHARS,
+        URL_ENCODE_MACRO_CHARS,
+    };
+    char *expect = NULL, *output = NULL;
+    int i, o, matched = 0;
+
+    mac->argv[0] = strdup("arg1'&%");
+    mac->argv[1] = strdup("");
+    macro_user[0] = strdup("/usr/lib/nagios/plugins");
+
+    for (i = 0; template_case[i]; i++) {
+        struct macro_template *tmpl = compile_macro_template(template_case[i]);
+        for (o = 0; o < (int)(sizeof(opts) / sizeof(opts[0])); o++) {
+            process_macros_r(mac, (char *)template_case[i], &expect, opts[o]);
+            process_macro_template_r(mac, tmpl, &output, opts[o]);
+            if (expect && output && !strcmp(expect, output))
+                matched++;
+            else
+                diag("'%s' with options %d: template gave '%s', expected '%s'",
+                     template_case[i], opts[o], output, expect);
+            my_free(expect);
+            my_free(output);
+        }
+        my_free(tmpl);
+    }
+    ok(matched == i * o, "%d of %d template expansions match process_macros_r()", matched, i * o);
+}
+
+/*
+    Micro-benchmark: a typical check command line, expanded with
+    process_macros_r() and with its compiled template
+*/
+#define BENCH_ROUNDS 200000
+void bench_templates(nagios_macros *mac)
+{
+    char *str = BENCH_COMMAND;
+    struct macro_template *tmpl = compile_macro_template(str);
+    int macro_options = STRIP_ILLEGAL_MACRO_CHARS | ESCAPE_MACRO_CHARS;
+    struct timeval start, stop;
+    double interpreted, compiled;
+    char *output = NULL;
+    int i;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        process_macros_r(mac, str, &output, macro_options);
+        my_free(output);
+    }
+    gettimeofday(&stop, NULL);
+    interpreted = tv_delta_f(&start, &stop);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        process_macro_template_r(mac, tmpl, &output, macro_options);
+        my_free(output);
+    }
+    gettimeofday(&stop, NULL);
+    compiled = tv_delta_f(&start, &stop);
+
+    diag("%d expansions: process_macros_r() %.3fs (%.0f/s), template %.3fs (%.0f/s)",
+         BENCH_ROUNDS, interpreted, BENCH_ROUNDS / interpreted, compiled, BENCH_ROUNDS / compiled);
+    ok(tmpl != NULL, "benchmark template must compile");
+    my_free(tmpl);
+}
+
+static const char *env_value(struct kvvec *kvv, const char *key)
+{
+    int i;
+
+    for (i = 0; kvv && i < kvv->kv_pairs; i++) {
+        if (!strcmp(kvv->kv[i].key, key))
+            return kvv->kv[i].value;
+    }
+    return NULL;
+}
+
+/*
+    macros_to_env_buf() must export what macros_to_kvv() does, with
+    static blocks cached per object until they're invalidated
+*/
+void test_environment(nagios_macros *mac)
+{
+    struct kvvec *full, *env;
+    nagios_macros plain_mac;
+    host plain;
+    char *buf = NULL;
+    unsigned long len, bufsize = 0;
+    int i, matched = 0;
+
+    enable_environment_macros = TRUE;
+
+    /* everything in these objects has macros in it, so nothing is cached */
+    full = macros_to_kvv(mac);
+    len = macros_to_env_buf(mac, TRUE, &buf, &bufsize);
+    env = bbuf2kvvec(buf, len, KVVEC_COPY);
+    for (i = 0; full && env && i < full->kv_pairs; i++) {
+        const char *value = env_value(env, full->kv[i].key);
+        if (value && !strcmp(value, full->kv[i].value ? full->kv[i].value : ""))
+            matched++;
+        else
+            diag("%s is '%s' in the environment, expected '%s'",
+                 full->kv[i].key, value, full->kv[i].value);
+    }
+    ok(full && env && matched == full->kv_pairs && env->kv_pairs == full->kv_pairs,
+       "binary environment must match macros_to_kvv()");
+    kvvec_destroy(env, KVVEC_FREE_ALL);
+
+    len = macros_to_env_buf(mac, FALSE, &buf, &bufsize);
+    env = buf2kvvec(buf, len, '=', '\n', KVVEC_COPY);
+    ok(full && env && env->kv_pairs == full->kv_pairs,
+       "text environment must have as many variables as macros_to_kvv()");
+    kvvec_destroy(env, KVVEC_FREE_ALL);
+    kvvec_destroy(full, KVVEC_FREE_KEYS);
+
+    /* a host without macros in its notes gets its block cached */
+    memset(&plain, 0, sizeof(plain));
+    memset(&plain_mac, 0, sizeof(plain_mac));
+    plain.name = plain.alias = plain.address = "plain";
+    add_custom_variable_to_object(&plain.custom_variables, "FOO", "bar");
+    num_objects.hosts = 1;
+    grab_host_macros_r(&plain_mac, &plain);
+
+    len = macros_to_env_buf(&plain_mac, TRUE, &buf, &bufsize);
+    env = bbuf2kvvec(buf, len, KVVEC_COPY);
+    ok(env && !strcmp(env_value(env, "NAGIOS_HOSTNAME"), "plain") &&
+       !strcmp(env_value(env, "NAGIOS__HOSTFOO"), "bar"),
+       "host macros must be exported from the cached block");
+    kvvec_destroy(env, KVVEC_FREE_ALL);
+
+    my_free(plain.custom_variables->variable_value);
+    plain.custom_variables->variable_value = strdup("baz");
+    len = macros_to_env_buf(&plain_mac, TRUE, &buf, &bufsize);
+    env = bbuf2kvvec(buf, len, KVVEC_COPY);
+    ok(env && !strcmp(env_value(env, "NAGIOS__HOSTFOO"), "bar"),
+       "cached blocks must be reused until invalidated");
+    kvvec_destroy(env, KVVEC_FREE_ALL);
+
+    invalidate_macro_environment_cache();
+    len = macros_to_env_buf(&plain_mac, TRUE, &buf, &bufsize);
+    env = bbuf2kvvec(buf, len, KVVEC_COPY);
+    ok(env && !strcmp(env_value(env, "NAGIOS__HOSTFOO"), "baz"),
+       "invalidated blocks must be rebuilt");
+    kvvec_destroy(env, KVVEC_FREE_ALL);
+
+    invalidate_macro_environment_cache();
+    clear_volatile_macros_r(&plain_mac);
+    my_free(plain.custom_variables->variable_name);
+    my_free(plain.custom_variables->variable_value);
+    my_free(plain.custom_variables);
+    num_objects.hosts = 0;
+    enable_environment_macros = FALSE;
+    my_free(buf);
+}
+
 /*****************************************************************************/
 /*                             Main function                                 */
 /*****************************************************************************/
 
 int main(void) {
 
-    plan_tests(23);
+    plan_tests(45);
 
     reset_variables();
     setup_environment();
     setup_objects();
 
     test_escaping(mac);
+    test_templates(mac);
+    bench_templates(mac);
+    test_environment(mac);
+    clear_argv_macros_r(mac);
+    my_free(macro_user[0]);
 
     free_memory(mac);
     free(mac);
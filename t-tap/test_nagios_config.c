@@ -55,9 +55,170 @@
 #include "stub_statusdata.c"
 #include "stub_flapping.c"
 #include "stub_notifications.c"
+#include "fixtures.c"
 
 int xrddefault_read_state_information(void);
 
+/* what etc/templates.cfg has objects inherit */
+#define DEEP_DEPTH 4
+#define DEEP_VARS 2
+#define DEEP_HOSTS 3
+#define DEEP_SERVICES 2
+
+/* the chains the config load benchmark has objects inherit from */
+#define BENCH_DEPTH 8
+#define BENCH_VARS 6
+#define BENCH_SERVICES 5
+
+/*
+ * writes a main config and objects for the config load benchmark:
+ * 'hosts' hosts with BENCH_SERVICES services each, all inheriting
+ * from two chains of BENCH_DEPTH templates that each add BENCH_VARS
+ * custom variables and a contactgroup
+ */
+static int write_benchmark_config(const char *dir, int hosts) {
+	const char *kind[] = { "host", "service" };
+	char *path, cwd[1024];
+	FILE *fp;
+	int k, side, d, v, h, sv;
+
+	if(getcwd(cwd, sizeof(cwd)) == NULL || (path = scratch_path(dir, "nagios.cfg")) == NULL)
+		return ERROR;
+	fp = fopen(path, "w");
+	free(path);
+	if(fp == NULL)
+		return ERROR;
+	fprintf(fp, "log_file=var/nagios.log\ntemp_path=/tmp\ncheck_result_path=var\n");
+	fprintf(fp, "cfg_file=%s/etc/common.cfg\ncfg_file=objects.cfg\n", cwd);
+	fclose(fp);
+
+	if((path = scratch_path(dir, "objects.cfg")) == NULL)
+		return ERROR;
+	fp = fopen(path, "w");
+	free(path);
+	if(fp == NULL)
+		return ERROR;
+	for(d = 0; d < BENCH_DEPTH; d++)
+		fprintf(fp, "define contactgroup {\n\tcontactgroup_name cg%d\n\tmembers admin\n}\n", d);
+	for(k = 0; k < 2; k++) {
+		for(side = 'a'; side <= 'b'; side++) {
+			for(d = 0; d < BENCH_DEPTH; d++) {
+				fprintf(fp, "define %s {\n\tname %s-%c%d\n\tregister 0\n", kind[k], kind[k], side, d);
+				if(d)
+					fprintf(fp, "\tuse %s-%c%d\n", kind[k], side, d - 1);
+				else
+					fprintf(fp, "\tcheck_command check\n\tmax_check_attempts 3\n\tcheck_period 24x7\n\tnotification_period 24x7\n");
+				fprintf(fp, "\tcontact_groups +cg%d\n\t_SHARED %c%d\n", d, side, d);
+				for(v = 0; v < BENCH_VARS; v++)
+					fprintf(fp, "\t_%s%c%d_%d %d\n", kind[k], side, d, v, v);
+				fprintf(fp, "}\n");
+				}
+			}
+		}
+	for(h = 0; h < hosts; h++) {
+		fprintf(fp, "define host {\n\tuse host-a%d,host-b%d\n\thost_name h%d\n\taddress 127.0.0.1\n}\n", BENCH_DEPTH - 1, BENCH_DEPTH - 1, h);
+		for(sv = 0; sv < BENCH_SERVICES; sv++)
+			fprintf(fp, "define service {\n\tuse service-a%d,service-b%d\n\thost_name h%d\n\tservice_description s%d\n}\n",
+			        BENCH_DEPTH - 1, BENCH_DEPTH - 1, h, sv);
+		}
+	fclose(fp);
+
+	return OK;
+	}
+
+static int count_objectlist(objectlist *list) {
+	int n = 0;
+
+	for(; list; list = list->next)
+		n++;
+	return n;
+	}
+
+static int count_hostgroup_members(hostgroup *hg) {
+	hostsmember *hm;
+	int n = 0;
+
+	for(hm = hg ? hg->members : NULL; hm; hm = hm->next)
+		n++;
+	return n;
+	}
+
+/* how the binary object cache from common/objects.c starts out */
+struct objcache_test_header {
+	char magic[8];
+	uint32_t byte_order;
+	uint32_t format_version;
+	uint32_t object_version;
+	uint32_t ocount[NUM_OBJECT_SKIPLISTS];
+	};
+
+/* compares two text object caches, skipping their comment headers */
+static int same_object_cache(const char *a, const char *b) {
+	char la[1024], lb[1024];
+	FILE *fa, *fb;
+	int same = FALSE;
+
+	fa = fopen(a, "r");
+	fb = fopen(b, "r");
+	if(fa && fb) {
+		for(;;) {
+			char *ra, *rb;
+			while((ra = fgets(la, sizeof(la), fa)) && *la == '#');
+			while((rb = fgets(lb, sizeof(lb), fb)) && *lb == '#');
+			if(!ra || !rb) {
+				same = !ra && !rb;
+				break;
+				}
+			if(strcmp(la, lb))
+				break;
+			}
+		}
+	if(fa)
+		fclose(fa);
+	if(fb)
+		fclose(fb);
+	return same;
+	}
+
+/* copies the first 'len' bytes of a file, optionally messing up the byte at 'bad' */
+static int copy_object_cache(const char *from, const char *to, off_t len, off_t bad) {
+	char *buf;
+	FILE *fp;
+	int fd, result = ERROR;
+
+	if((buf = malloc(len)) == NULL)
+		return ERROR;
+	if((fd = open(from, O_RDONLY)) >= 0 && read(fd, buf, len) == len && (fp = fopen(to, "w"))) {
+		if(bad >= 0)
+			buf[bad] ^= 0x5a;
+		if(fwrite(buf, len, 1, fp) == 1)
+			result = OK;
+		fclose(fp);
+		}
+	if(fd >= 0)
+		close(fd);
+	free(buf);
+	return result;
+	}
+
+static int count_customvars(customvariablesmember *cv, const char *name, const char **value) {
+	int n = 0;
+
+	for(; cv; cv = cv->next, n++) {
+		if(!strcmp(cv->variable_name, name))
+			*value = cv->variable_value;
+		}
+	return n;
+	}
+
+static int count_contactgroups(contactgroupsmember *cgm) {
+	int n = 0;
+
+	for(; cgm; cgm = cgm->next)
+		n++;
+	return n;
+	}
+
 int main(int argc, char **argv) {
 	int result;
 	int error = FALSE;
@@ -71,8 +232,17 @@ int main(int argc, char **argv) {
 	host *temp_host = NULL;
 	hostgroup *temp_hostgroup = NULL;
 	hostsmember *temp_member = NULL;
+	struct object_count serial_count;
+	unsigned int host1_id;
+	char *scratch;
+	int bench_hosts;
+	struct timeval start, stop;
+	const char *shared = NULL, *value = NULL;
+	service *temp_service = NULL;
+	char *cache_path, *cache2_path, *bin_path, *bad_path;
+	struct stat st;
 
-	plan_tests(14);
+	plan_tests(66);
 
 	/* reset program variables */
 	reset_variables();
@@ -125,7 +295,176 @@ int main(int argc, char **argv) {
 	ok(find_service_downtime(1110) != NULL, "Found service downtime 1110");
 	ok(find_host_downtime(1234567888) == NULL, "No such host downtime");
 
+	serial_count = num_objects;
+	host1_id = temp_host->id;
+	cleanup();
+
+	/* the same objects should come out of a parallel read */
+	reset_variables();
+	config_file = strdup("smallconfig/nagios.cfg");
+	result = read_main_config_file(config_file);
+	config_parser_threads = 4;
+	ok(result == OK && read_all_object_data(config_file) == OK, "Read all object config files with 4 parser threads");
+	ok(!memcmp(&serial_count, &num_objects, sizeof(num_objects)), "Same number of objects of each type");
+	temp_host = find_host("host1");
+	ok(temp_host != NULL && temp_host->id == host1_id, "host1 has the same id");
+	ok(pre_flight_check() == OK, "Preflight check okay");
+
+	cleanup();
+
+	/* objects inheriting from two deep template chains each */
+	reset_variables();
+	config_file = strdup("etc/nagios-templates.cfg");
+	result = read_main_config_file(config_file);
+	ok(result == OK && read_all_object_data(config_file) == OK && pre_flight_check() == OK, "Read deep template config");
+	ok(num_objects.hosts == DEEP_HOSTS && num_objects.services == DEEP_HOSTS * DEEP_SERVICES, "All deep template objects registered");
+
+	temp_host = find_host("h0");
+	ok(temp_host != NULL && count_customvars(temp_host->custom_variables, "SHARED", &shared) == 2 + 2 * DEEP_DEPTH * DEEP_VARS,
+	   "Host inherits custom variables from both template chains");
+	ok(shared != NULL && !strcmp(shared, "a3"), "First template wins for custom variables") || diag("SHARED=%s", shared);
+	value = NULL;
+	count_customvars(temp_host->custom_variables, "HOSTB0_1", &value);
+	ok(value != NULL && !strcmp(value, "1"), "Variable from the bottom of the second chain resolved") || diag("HOSTB0_1=%s", value);
+	ok(temp_host->check_command != NULL && !strcmp(temp_host->check_command, "check") && temp_host->max_attempts == 3 &&
+	   temp_host->check_period != NULL && !strcmp(temp_host->check_period, "24x7"), "Plain directives resolved through the whole chain");
+	ok(count_contactgroups(temp_host->contact_groups) == DEEP_DEPTH, "Additive contactgroups resolved through the whole chain");
+
+	/* the other host names the chains the other way around */
+	temp_host = find_host("h2");
+	shared = value = NULL;
+	ok(temp_host != NULL && count_customvars(temp_host->custom_variables, "SHARED", &shared) == 2 + 2 * DEEP_DEPTH * DEEP_VARS &&
+	   count_customvars(temp_host->custom_variables, "HOSTA0_1", &value) > 0, "Host with reversed templates inherits the same variables");
+	ok(shared != NULL && !strcmp(shared, "b3"), "Template order decides which one wins") || diag("SHARED=%s", shared);
+	ok(value != NULL && !strcmp(value, "mine"), "Host's own variable beats the inherited one") || diag("HOSTA0_1=%s", value);
+
+	temp_service = find_service("h2", "s1");
+	shared = value = NULL;
+	ok(temp_service != NULL && count_customvars(temp_service->custom_variables, "SHARED", &shared) == 1 + 2 * DEEP_DEPTH * DEEP_VARS &&
+	   count_customvars(temp_service->custom_variables, "SERVICEB0_0", &value) > 0, "Service inherits custom variables from both template chains");
+	ok(shared != NULL && !strcmp(shared, "a3") && value != NULL && !strcmp(value, "0"), "Service variables resolved")
+	|| diag("SHARED=%s SERVICEB0_0=%s", shared, value);
+	ok(temp_service != NULL && count_contactgroups(temp_service->contact_groups) == DEEP_DEPTH, "Service adds its contactgroup to the inherited ones");
+	serial_count = num_objects;
+	cleanup();
+
+	reset_variables();
+	config_file = strdup("etc/nagios-templates.cfg");
+	result = read_main_config_file(config_file);
+	config_parser_threads = 4;
+	ok(result == OK && read_all_object_data(config_file) == OK && !memcmp(&serial_count, &num_objects, sizeof(num_objects)),
+	   "Same deep template objects with 4 parser threads");
+	cleanup();
+
+	/*
+	 * how long a big deep template config takes to read, when asked
+	 * for with NAGIOS_CONFIG_BENCHMARK_HOSTS=<hosts>
+	 */
+	bench_hosts = getenv("NAGIOS_CONFIG_BENCHMARK_HOSTS") ? atoi(getenv("NAGIOS_CONFIG_BENCHMARK_HOSTS")) : 0;
+	skip_start(bench_hosts <= 0, 2, "Config load benchmark not asked for");
+	scratch = make_scratch_dir("deepbench");
+	ok(scratch != NULL && write_benchmark_config(scratch, bench_hosts) == OK, "Wrote config load benchmark config");
+	reset_variables();
+	config_file = scratch_path(scratch, "nagios.cfg");
+	result = read_main_config_file(config_file);
+	gettimeofday(&start, NULL);
+	result = result == OK ? read_all_object_data(config_file) : result;
+	gettimeofday(&stop, NULL);
+	ok(result == OK && num_objects.hosts == (unsigned int)bench_hosts && num_objects.services == (unsigned int)bench_hosts * BENCH_SERVICES,
+	   "Read config load benchmark config");
+	diag("%u hosts and %u services read in %.3fs", num_objects.hosts, num_objects.services, tv_delta_f(&start, &stop));
+	cleanup();
+	remove_scratch_dir(scratch);
+	skip_end;
+
+	/* extinfo objects inherit from their templates */
+	for(c = 1; c <= 4; c += 3) {
+		reset_variables();
+		config_file = strdup("etc/nagios-extinfo.cfg");
+		result = read_main_config_file(config_file);
+		config_parser_threads = c;
+		ok(result == OK && read_all_object_data(config_file) == OK, "Read extinfo template config with %d parser thread(s)", c);
+		temp_host = find_host("h0");
+		ok(temp_host != NULL && temp_host->notes && !strcmp(temp_host->notes, "from_template"), "hostextinfo inherits notes from its template");
+		ok(temp_host != NULL && temp_host->icon_image && !strcmp(temp_host->icon_image, "host.png") &&
+		   temp_host->icon_image_alt && !strcmp(temp_host->icon_image_alt, "own"), "hostextinfo keeps its own values");
+		temp_service = find_service("h0", "s0");
+		ok(temp_service != NULL && temp_service->notes && !strcmp(temp_service->notes, "svc_from_template"), "serviceextinfo inherits notes from its template");
+		cleanup();
+		}
+
+	/* objects reached more than once are expanded once */
+	reset_variables();
+	config_file = strdup("etc/nagios-expansion.cfg");
+	result = read_main_config_file(config_file);
+	ok(result == OK && read_all_object_data(config_file) == OK && pre_flight_check() == OK, "Read member expansion config");
+	ok(num_objects.services == 7 && find_service("h2", "s0") != NULL && find_service("h2", "s1") == NULL,
+	   "Services expanded once per host, minus excluded hosts") || diag("%u services", num_objects.services);
+	ok(count_hostgroup_members(find_hostgroup("hgAll")) == 4, "Nested hostgroup members listed once");
+	temp_service = find_service("h0", "s0");
+	ok(temp_service != NULL && temp_service->contacts && !temp_service->contacts->next, "Repeated contact listed once");
+	ok(find_contactgroup("everyone") && find_contactgroup("everyone")->members && find_contactgroup("everyone")->members->next &&
+	   !find_contactgroup("everyone")->members->next->next, "Repeated contactgroup member listed once");
+	ok(find_servicegroup("sg") && find_servicegroup("sg")->members && find_servicegroup("sg")->members->next &&
+	   !find_servicegroup("sg")->members->next->next, "Repeated servicegroup member listed once");
+	ok(num_objects.serviceescalations == 7, "Escalations expanded once per service") || diag("%u escalations", num_objects.serviceescalations);
+	ok(count_objectlist(find_service("h1", "s0")->escalation_list) == 2 && count_objectlist(find_service("h3", "s0")->escalation_list) == 1,
+	   "Services reached through groups and hosts get one copy of each escalation");
+	ok(count_objectlist(find_service("h0", "s1")->escalation_list) == 0, "Excluded service gets no escalation");
+	cleanup();
+
+	/* the binary object cache gives back the very same objects */
+	scratch = make_scratch_dir("objcache");
+	cache_path = scratch_path(scratch, "objects.cache");
+	cache2_path = scratch_path(scratch, "objects.cache2");
+	bin_path = scratch_path(scratch, "objects.bin");
+	bad_path = scratch_path(scratch, "objects.bad");
+	reset_variables();
+	config_file = strdup("etc/nagios-objcache.cfg");
+	result = read_main_config_file(config_file);
+	ok(scratch != NULL && result == OK && read_all_object_data(config_file) == OK && pre_flight_check() == OK, "Read object cache config");
+	ok(fcache_objects(cache_path) == OK && fcache_binary_objects(bin_path) == OK, "Wrote text and binary object caches");
+	serial_count = num_objects;
+	cleanup();
+
+	/* the way -u loads a precache */
+	reset_variables();
+	config_file = strdup("etc/nagios-objcache.cfg");
+	result = read_main_config_file(config_file);
+	use_precached_objects = TRUE;
+	my_free(object_precache_file);
+	object_precache_file = strdup(bin_path);
+	ok(result == OK && read_object_config_data(config_file, READ_ALL_OBJECT_DATA) == OK && pre_flight_check() == OK, "Read binary object cache");
+	ok(!memcmp(&serial_count, &num_objects, sizeof(num_objects)), "Same number of objects of each type from the binary cache");
+	ok(fcache_objects(cache2_path) == OK && same_object_cache(cache_path, cache2_path), "Binary cache round trip gives the same objects");
+	temp_service = find_service("h1", "s1");
+	ok(temp_service != NULL && temp_service->check_command_ptr == find_command("check") && temp_service->escalation_list != NULL
+	   && temp_service->notify_deps != NULL && temp_service->servicegroups_ptr != NULL, "Service links are restored");
+	use_precached_objects = FALSE;
+	cleanup();
+
+	reset_variables();
+	ok(stat(bin_path, &st) == 0 && copy_object_cache(bin_path, bad_path, st.st_size - 1, -1) == OK, "Wrote truncated binary cache");
+	ok(read_binary_object_cache(bad_path) == OBJCACHE_UNUSABLE && num_objects.hosts == 0, "Truncated binary cache is not used");
+	ok(copy_object_cache(bin_path, bad_path, 16, -1) == OK && read_binary_object_cache(bad_path) == OBJCACHE_UNUSABLE, "Binary cache with a cut off header is not used");
+	ok(copy_object_cache(bin_path, bad_path, st.st_size, 0) == OK && read_binary_object_cache(bad_path) == OBJCACHE_UNUSABLE, "Binary cache with a bad magic is not used");
+	ok(read_binary_object_cache(cache_path) == OBJCACHE_UNUSABLE, "Text object cache is not taken for a binary one");
+	ok(read_binary_object_cache(NULL) == OBJCACHE_UNUSABLE && read_binary_object_cache(bad_path + 1) == OBJCACHE_UNUSABLE, "Missing binary cache is not used");
+
+	/* the host count moves the reader off the rest of the data */
+	ok(copy_object_cache(bin_path, bad_path, st.st_size, offsetof(struct objcache_test_header, ocount) + HOST_SKIPLIST * sizeof(uint32_t)) == OK,
+	   "Wrote binary cache with a corrupt object count");
+	ok(read_binary_object_cache(bad_path) == ERROR, "Corrupt binary cache is rejected");
+	cleanup();
+	reset_variables();
+	ok(copy_object_cache(bin_path, bad_path, st.st_size, st.st_size - 3) == OK && read_binary_object_cache(bad_path) == ERROR,
+	   "Binary cache with corrupt object data is rejected");
 	cleanup();
+	remove_scratch_dir(scratch);
+	my_free(cache_path);
+	my_free(cache2_path);
+	my_free(bin_path);
+	my_free(bad_path);
 
 	my_free(config_file);
 
@@ -0,0 +1,158 @@
+/*****************************************************************************
+*
+* test_perfdata.c - Test spooling of the performance data files
+*
+* Program: Nagios Core Testing
+* License: GPL
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+*****************************************************************************/
+
+#define NSCORE 1
+#include "../xdata/xpddefault.c"
+
+#include "tap.h"
+#include "stub_perfdata.c"
+#include "stub_workers.c"
+#include "stub_events.c"
+#include "stub_logging.c"
+#include "stub_commands.c"
+#include "stub_checks.c"
+#include "stub_nebmods.c"
+#include "stub_netutils.c"
+#include "stub_broker.c"
+#include "stub_statusdata.c"
+#include "stub_flapping.c"
+#include "stub_notifications.c"
+#include "fixtures.c"
+
+/* spool lines numbered from 'first' up to 'last' */
+static void spool_lines(struct perfdata_spool *spool, FILE *fp, unsigned int first, unsigned int last) {
+	char line[64];
+
+	for(; first < last; first++) {
+		snprintf(line, sizeof(line), "perfdata line %03u", first);
+		xpddefault_spool_line(spool, fp, line, "test");
+		}
+	}
+
+/*
+ * does what's in buf hold lines 'first' up to 'last' in order,
+ * with 'big' as a line of its own right after line 'big_at'?
+ */
+static int has_lines(const char *buf, unsigned int first, unsigned int last, const char *big, unsigned int big_at) {
+	char expect[64];
+	size_t len;
+
+	for(; first < last; first++) {
+		len = snprintf(expect, sizeof(expect), "perfdata line %03u\n", first);
+		if(strncmp(buf, expect, len)) {
+			diag("expected '%.*s' but found '%.30s'", (int)len - 1, expect, buf);
+			return FALSE;
+			}
+		buf += len;
+		if(big && first == big_at) {
+			if(strncmp(buf, big, strlen(big)) || buf[strlen(big)] != '\n')
+				return FALSE;
+			buf += strlen(big) + 1;
+			}
+		}
+	return *buf == 0;
+	}
+
+static char *read_file(const char *path) {
+	static char buf[8192];
+	ssize_t len = 0;
+	int fd;
+
+	if((fd = open(path, O_RDONLY)) < 0)
+		return NULL;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	buf[len > 0 ? len : 0] = 0;
+	return buf;
+	}
+
+int main(int argc, char **argv) {
+	char *dir;
+	char big[300], filler[4096], *contents;
+	struct stat st;
+	unsigned long dropped;
+	int reader, writer;
+	ssize_t len;
+
+	plan_tests(11);
+
+	ok((dir = make_scratch_dir("perfdata")) != NULL, "Made perfdata directory");
+	perfdata_file_buffer_size = 256;
+	memset(big, 'B', sizeof(big) - 1);
+	big[sizeof(big) - 1] = 0;
+
+	/* a plain file */
+	service_perfdata_file = scratch_path(dir, "service-perfdata");
+	ok(xpddefault_open_service_perfdata_file() == OK && service_perfdata_fp != NULL, "Opened service perfdata file");
+	spool_lines(&service_perfdata_spool, service_perfdata_fp, 0, 100);
+	ok(stat(service_perfdata_file, &st) == 0 && st.st_size > 0 && st.st_size < 100 * 18 && service_perfdata_spool.len > 0,
+	   "A full spool is written out, and the rest stays spooled");
+	xpddefault_spool_line(&service_perfdata_spool, service_perfdata_fp, big, "service");
+	spool_lines(&service_perfdata_spool, service_perfdata_fp, 100, 110);
+	xpddefault_close_service_perfdata_file();
+	ok(service_perfdata_spool.len == 0 && service_perfdata_fp == NULL, "Closing the file writes out the spool");
+	contents = read_file(service_perfdata_file);
+	ok(contents != NULL && has_lines(contents, 0, 110, big, 99), "Every line written once and in order, oversized one included");
+
+	/* the flush event writes out what's spooled without closing the file */
+	ok(xpddefault_open_service_perfdata_file() == OK, "Reopened service perfdata file");
+	spool_lines(&service_perfdata_spool, service_perfdata_fp, 0, 5);
+	xpddefault_flush_perfdata_files();
+	contents = read_file(service_perfdata_file);
+	ok(contents != NULL && has_lines(contents, 0, 5, NULL, 0) && service_perfdata_spool.len == 0, "Flushing writes out the spool");
+	xpddefault_close_service_perfdata_file();
+
+	/* a pipe with a reader that has stopped reading */
+	host_perfdata_file = scratch_path(dir, "host-perfdata");
+	host_perfdata_file_pipe = TRUE;
+	mkfifo(host_perfdata_file, 0600);
+	reader = open(host_perfdata_file, O_RDONLY | O_NONBLOCK);
+	ok(reader >= 0 && xpddefault_open_host_perfdata_file() == OK, "Opened host perfdata pipe");
+	writer = open(host_perfdata_file, O_WRONLY | O_NONBLOCK);
+	memset(filler, 'F', sizeof(filler));
+	while(write(writer, filler, sizeof(filler)) > 0)
+		;
+	close(writer);
+	spool_lines(&host_perfdata_spool, host_perfdata_fp, 0, 30);
+	dropped = host_perfdata_spool.dropped;
+	ok(host_perfdata_spool.len > 0 && dropped > 0, "A full pipe keeps what's spooled and drops what won't fit");
+
+	/* once the reader catches up, what was kept comes through in order */
+	while((len = read(reader, filler, sizeof(filler))) > 0 && filler[len - 1] == 'F')
+		;
+	xpddefault_flush_perfdata_files();
+	ok(host_perfdata_spool.len == 0 && host_perfdata_spool.dropped == 0, "Spool written out once the pipe drains");
+	len = read(reader, filler, sizeof(filler) - 1);
+	filler[len > 0 ? len : 0] = 0;
+	ok(len > 0 && len % 18 == 0 && len / 18 + dropped == 30 && has_lines(filler, 0, len / 18, NULL, 0),
+	   "Kept lines come through in order") || diag("read '%s'", filler);
+
+	xpddefault_close_host_perfdata_file();
+	close(reader);
+	remove_scratch_dir(dir);
+	my_free(host_perfdata_spool.buf);
+	my_free(service_perfdata_spool.buf);
+	my_free(host_perfdata_file);
+	my_free(service_perfdata_file);
+
+	return exit_status();
+	}
@@ -0,0 +1,192 @@
+/*****************************************************************************
+*
+* test_query_handler.c - Test check result submission through the query handler
+*
+* Program: Nagios Core Testing
+* License: GPL
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+*****************************************************************************/
+
+#define NSCORE 1
+#include "../base/query-handler.c"
+
+#include "tap.h"
+#include "stub_perfdata.c"
+#include "stub_workers.c"
+#include "stub_events.c"
+#include "stub_logging.c"
+#include "stub_commands.c"
+#include "stub_nebmods.c"
+#include "stub_netutils.c"
+#include "stub_broker.c"
+#include "stub_statusdata.c"
+#include "stub_flapping.c"
+#include "stub_notifications.c"
+#include "fixtures.c"
+
+/* we want to see the results the stream hands over */
+#define handle_async_host_check_result stub_handle_async_host_check_result
+#define handle_async_service_check_result stub_handle_async_service_check_result
+#include "stub_checks.c"
+#undef handle_async_host_check_result
+#undef handle_async_service_check_result
+
+static int got_results, got_return_code;
+static char got_output[256];
+static const char *got_source;
+
+int handle_async_host_check_result(host *hst, check_result *cr) {
+	got_results++;
+	got_return_code = cr->return_code;
+	snprintf(got_output, sizeof(got_output), "%s", cr->output);
+	got_source = hst->check_source;
+	return OK;
+	}
+
+int handle_async_service_check_result(service *svc, check_result *cr) {
+	got_results++;
+	got_return_code = cr->return_code;
+	snprintf(got_output, sizeof(got_output), "%s/%s", svc->description, cr->output);
+	got_source = svc->check_source;
+	return OK;
+	}
+
+/* connect to the query handler socket and have the core accept us */
+static int qh_connect(const char *path) {
+	int sd = nsock_unix(path, NSOCK_TCP | NSOCK_CONNECT | NSOCK_BLOCK);
+
+	if(sd >= 0)
+		iobroker_poll(nagios_iobs, 100);
+	return sd;
+	}
+
+/* send a query and let the core handle it */
+static void qh_send(int sd, const void *buf, size_t len) {
+	if(write(sd, buf, len) == (ssize_t)len)
+		iobroker_poll(nagios_iobs, 100);
+	}
+
+/* read a nul-terminated reply, or return -1 if the core hung up without one */
+static int qh_reply(int sd, char *buf, size_t size) {
+	size_t len = 0;
+
+	while(len < size - 1 && read(sd, buf + len, 1) == 1) {
+		if(buf[len++] == 0)
+			return len;
+		}
+	buf[len] = 0;
+	return len ? (int)len : -1;
+	}
+
+static void send_result(int sd, int framing, const char *host_name, const char *service, const char *output, int split) {
+	struct kvvec *kvv = kvvec_create(8);
+	int sv[2];
+	char buf[1024];
+	ssize_t len;
+
+	kvvec_addkv(kvv, "host_name", (char *)host_name);
+	if(service)
+		kvvec_addkv(kvv, "service_description", (char *)service);
+	kvvec_addkv(kvv, "return_code", "2");
+	if(output)
+		kvvec_addkv(kvv, "output", (char *)output);
+
+	/* frame it the way a worker would, then send it on in one or two parts */
+	socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	worker_send_kvvec_framed(sv[0], kvv, framing);
+	close(sv[0]);
+	len = read(sv[1], buf, sizeof(buf));
+	close(sv[1]);
+	kvvec_destroy(kvv, 0);
+
+	if(split) {
+		qh_send(sd, buf, split);
+		qh_send(sd, buf + split, len - split);
+		}
+	else
+		qh_send(sd, buf, len);
+	}
+
+int main(int argc, char **argv) {
+	char *dir, *qh_path, reply[256];
+	int sd, bsd;
+
+	plan_tests(14);
+
+	reset_variables();
+	config_file = strdup("etc/nagios-hosts.cfg");
+	ok(read_main_config_file(config_file) == OK && read_all_object_data(config_file) == OK && pre_flight_check() == OK,
+	   "Read object config");
+	dir = make_scratch_dir("qh");
+	qh_path = scratch_path(dir, "nagios.qh");
+	nagios_iobs = iobroker_create();
+	ok(nagios_iobs != NULL && qh_init(qh_path) == OK, "Query handler listening");
+
+	/* a one-shot query has its connection closed under it, so it can't be a stream */
+	sd = qh_connect(qh_path);
+	qh_send(sd, "#checkresult stream", 20);
+	ok(qh_reply(sd, reply, sizeof(reply)) > 0 && !strncmp(reply, "400: ", 5), "One-shot stream request is refused")
+	|| diag("reply was '%s'", reply);
+	ok(qh_reply(sd, reply, sizeof(reply)) < 0 && cr_streams == 0, "Connection closed, with no stream left behind");
+	close(sd);
+
+	/* a text stream */
+	sd = qh_connect(qh_path);
+	qh_send(sd, "@checkresult stream", 20);
+	ok(qh_reply(sd, reply, sizeof(reply)) > 0 && !strcmp(reply, "OK") && cr_streams == 1, "Opened text check result stream");
+	send_result(sd, WORKER_FRAMING_TEXT, "h0", NULL, "text result", 0);
+	ok(got_results == 1 && got_return_code == 2 && !strcmp(got_output, "text result"), "Text result handed to the core");
+	ok(got_source && !strcmp(got_source, "check result stream"), "Result comes from the check result stream");
+
+	/* and a binary one, with a result arriving in pieces */
+	bsd = qh_connect(qh_path);
+	qh_send(bsd, "@checkresult stream framing=binary", 35);
+	ok(qh_reply(bsd, reply, sizeof(reply)) > 0 && !strcmp(reply, "OK") && cr_streams == 2, "Opened binary check result stream");
+	send_result(bsd, WORKER_FRAMING_BINARY, "h0", "s0", "binary result", 0);
+	ok(got_results == 2 && !strcmp(got_output, "s0/binary result"), "Binary framed result handed to the core");
+	send_result(bsd, WORKER_FRAMING_BINARY, "h0", "s0", "split result", 2);
+	send_result(bsd, WORKER_FRAMING_BINARY, "h0", "s0", "split again", 9);
+	ok(got_results == 4 && !strcmp(got_output, "s0/split again"), "Results split across reads are put back together");
+
+	/* junk is counted, not passed on */
+	send_result(bsd, WORKER_FRAMING_BINARY, "h0", "s0", NULL, 0);
+	send_result(bsd, WORKER_FRAMING_BINARY, "nosuchhost", NULL, "lost", 0);
+	ok(got_results == 4 && cr_results == 4 && cr_rejected == 2, "Incomplete and unknown results are rejected")
+	|| diag("results=%lu rejected=%lu", cr_results, cr_rejected);
+
+	/* hanging up ends the stream */
+	close(sd);
+	iobroker_poll(nagios_iobs, 100);
+	ok(cr_streams == 1, "Closed text stream goes away");
+	close(bsd);
+	iobroker_poll(nagios_iobs, 100);
+	ok(cr_streams == 0, "Closed binary stream goes away");
+
+	sd = qh_connect(qh_path);
+	qh_send(sd, "#checkresult stats", 19);
+	ok(qh_reply(sd, reply, sizeof(reply)) > 0 && !strcmp(reply, "streams=0;results=4;rejected=2"), "Stream statistics")
+	|| diag("reply was '%s'", reply);
+	close(sd);
+
+	qh_deinit(qh_path);
+	iobroker_destroy(nagios_iobs, IOBROKER_CLOSE_SOCKETS);
+	cleanup();
+	my_free(qh_path);
+	my_free(config_file);
+	remove_scratch_dir(dir);
+
+	return exit_status();
+	}
@@ -0,0 +1,135 @@
+/*****************************************************************************
+*
+* test_reload.c - Test incremental reloads of the object configuration
+*
+* Program: Nagios Core Testing
+* License: GPL
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+*****************************************************************************/
+
+#define NSCORE 1
+#include "../base/reload.c"
+
+#include "tap.h"
+#include "stub_perfdata.c"
+#include "stub_workers.c"
+#include "stub_logging.c"
+#include "stub_commands.c"
+#include "stub_checks.c"
+#include "stub_nebmods.c"
+#include "stub_netutils.c"
+#include "stub_broker.c"
+#include "stub_statusdata.c"
+#include "stub_flapping.c"
+#include "stub_notifications.c"
+
+/* the events the reload takes off the queue */
+static int removed_events;
+
+timed_event *schedule_new_event(int event_type, int high_priority, time_t run_time, int recurring, unsigned long event_interval, void *timing_func, int compensate_for_time_change, void *event_data, void *event_args, int event_options)
+{ return NULL; }
+
+void add_event(squeue_t *sq, timed_event *event)
+{ }
+
+void remove_event(squeue_t *sq, timed_event *event)
+{ removed_events++; }
+
+int dump_event_stats(int sd)
+{ return OK; }
+
+static timed_event *new_check_event(void *data) {
+	timed_event *event = calloc(1, sizeof(*event));
+
+	event->event_type = EVENT_HOST_CHECK;
+	event->event_data = data;
+	return event;
+	}
+
+int main(int argc, char **argv) {
+	object_set old_objects;
+	struct reload_stats stats;
+	host *h0, *h1, *h2;
+	service *s0;
+	timed_event *h0_event, *s0_event;
+	scheduled_downtime *temp_downtime;
+	unsigned long downtime_id = 0L;
+	int result;
+
+	plan_tests(19);
+
+	reset_variables();
+	config_file = strdup("etc/nagios-reload.cfg");
+	result = read_main_config_file(config_file);
+	ok(result == OK && read_all_object_data(config_file) == OK && pre_flight_check() == OK, "Read initial object config");
+	initialize_downtime_data();
+	initialize_reload_data(config_file);
+
+	/* give the running objects some state and queued events */
+	h0 = find_host("h0");
+	h0->current_state = HOST_DOWN;
+	h0->plugin_output = strdup("down");
+	h0->next_check_event = h0_event = new_check_event(h0);
+	s0 = find_service("h0", "s0");
+	s0->current_state = STATE_CRITICAL;
+	s0->next_check_event = s0_event = new_check_event(s0);
+	h1 = find_host("h1");
+	h1->next_check_event = new_check_event(h1);
+	find_service("h1", "s0")->next_check_event = new_check_event(find_service("h1", "s0"));
+	schedule_downtime(HOST_DOWNTIME, "h1", NULL, time(NULL), "user", "comment", time(NULL) + 60, time(NULL) + 120, TRUE, 0, 0, &downtime_id);
+	temp_downtime = find_host_downtime(downtime_id);
+	ok(temp_downtime != NULL, "Scheduled downtime for h1");
+	temp_downtime->start_event = calloc(1, sizeof(timed_event));
+
+	/* h1 goes away, h2 comes in and h0 stays */
+	memset(&old_objects, 0, sizeof(old_objects));
+	memset(&stats, 0, sizeof(stats));
+	swap_object_data(&old_objects);
+	ok(find_host("h0") == NULL && old_objects.count.hosts == 2, "Running objects set aside");
+	ok(read_all_object_data("etc/nagios-reload-h2.cfg") == OK && pre_flight_check() == OK, "Read new object config");
+	transfer_object_state(&old_objects, &stats);
+
+	ok(stats.kept == 2 && stats.added == 2 && stats.removed == 2, "Kept, added and removed hosts and services counted")
+	|| diag("kept=%u added=%u removed=%u", stats.kept, stats.added, stats.removed);
+	h0 = find_host("h0");
+	ok(h0->current_state == HOST_DOWN && h0->plugin_output && !strcmp(h0->plugin_output, "down"), "Kept host keeps its state");
+	ok(h0->next_check_event == h0_event && h0_event->event_data == h0, "Kept host takes over its check event");
+	s0 = find_service("h0", "s0");
+	ok(s0->current_state == STATE_CRITICAL, "Kept service keeps its state");
+	ok(s0->next_check_event == s0_event && s0_event->event_data == s0, "Kept service takes over its check event");
+	h2 = find_host("h2");
+	ok(h2 != NULL && h2->current_state == HOST_UP && h2->next_check_event == NULL, "Added host starts out fresh");
+	ok(find_service("h2", "s0") != NULL && find_service("h2", "s0")->current_state == STATE_OK, "Added service starts out fresh");
+	ok(find_host("h1") == NULL, "Removed host is gone");
+	ok(find_host_downtime(downtime_id) == NULL, "Removed host's downtime is gone");
+	ok(removed_events == 3, "Removed objects' check and downtime events taken off the queue") || diag("removed %d events", removed_events);
+	free_object_set(&old_objects);
+
+	/* a broken config leaves the running objects alone */
+	ok(reload_object_config("etc/nagios-reload-broken.cfg") == ERROR, "Reloading a broken config fails");
+	ok(find_host("h0") == h0 && find_host("h2") == h2 && find_host("h1") == NULL, "Running objects are back in place");
+	ok(h0->current_state == HOST_DOWN && h0->next_check_event == h0_event, "Running objects keep their state");
+	ok(num_objects.hosts == 2 && num_objects.services == 2, "Object counts restored");
+
+	/* and a good one goes right in */
+	ok(reload_object_config(config_file) == OK && find_host("h1") != NULL && find_host("h2") == NULL &&
+	   find_host("h0")->current_state == HOST_DOWN, "Reloaded object config");
+
+	cleanup();
+	my_free(config_file);
+
+	return exit_status();
+	}
@@ -0,0 +1,276 @@
+/*****************************************************************************
+*
+* test_retention.c - Test binary and incremental retention files
+*
+* Program: Nagios Core Testing
+* License: GPL
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+*****************************************************************************/
+
+#define NSCORE 1
+#include "../xdata/xrddefault.c"
+
+#include "tap.h"
+#include "stub_perfdata.c"
+#include "stub_workers.c"
+#include "stub_events.c"
+#include "stub_logging.c"
+#include "stub_commands.c"
+#include "stub_checks.c"
+#include "stub_nebmods.c"
+#include "stub_netutils.c"
+#include "stub_broker.c"
+#include "stub_statusdata.c"
+#include "stub_flapping.c"
+#include "stub_notifications.c"
+#include "fixtures.c"
+
+/* the hosts in etc/hosts.cfg */
+#define RETENTION_HOSTS 4
+
+/* counts the segments of the retention file and the records in the last one */
+static int count_segments(unsigned int *last_records) {
+	char hdr[XRDDEFAULT_SEGMENT_HEADER_LEN];
+	unsigned long long len;
+	int segments = 0;
+	FILE *fp;
+
+	*last_records = 0;
+	if((fp = fopen(retention_file, "r")) == NULL)
+		return -1;
+	while(fread(hdr, sizeof(hdr), 1, fp) == 1 && !memcmp(hdr, XRDDEFAULT_BINARY_MAGIC, 8)) {
+		segments++;
+		*last_records = xrd_get_u32(hdr + 16);
+		len = ((unsigned long long)xrd_get_u32(hdr + 24) << 32) | xrd_get_u32(hdr + 28);
+		if(fseeko(fp, len, SEEK_CUR) < 0)
+			break;
+		}
+	fclose(fp);
+
+	return segments;
+	}
+
+
+/*
+ * builds a binary retention file in memory with 'count' host records,
+ * cycling through the hosts. Every other record carries a stale id,
+ * and every seventh is for a host that's gone
+ */
+static char *build_host_records(unsigned int count, size_t *len) {
+	xrd_output out;
+	char *recs = NULL, *buf = NULL;
+	size_t recs_len = 0, buf_len = 0;
+	FILE *hdr_fp;
+	unsigned int i, id;
+
+	memset(&out, 0, sizeof(out));
+	out.binary = TRUE;
+	if((out.fp = open_memstream(&recs, &recs_len)) == NULL)
+		return NULL;
+	for(i = 0; i < count; i++) {
+		id = i % RETENTION_HOSTS;
+		xrd_begin(&out, XRDDEFAULT_HOSTSTATUS_DATA, (i & 1) ? id + 1 : id);
+		if(i % 7 == 0)
+			xrd_var(&out, "host_name", "gone");
+		else
+			xrd_var(&out, "host_name", "h%u", id);
+		xrd_var(&out, "current_event_id", "%u", i);
+		xrd_end(&out, NULL, 0);
+		}
+	fclose(out.fp);
+	my_free(out.buf);
+
+	if((hdr_fp = open_memstream(&buf, &buf_len)) == NULL) {
+		free(recs);
+		return NULL;
+		}
+	xrd_write_segment_header(hdr_fp, XRDDEFAULT_SEGMENT_FULL, out.records, out.bytes);
+	fwrite(recs, 1, recs_len, hdr_fp);
+	fclose(hdr_fp);
+	free(recs);
+
+	*len = buf_len;
+	return buf;
+	}
+
+
+int main(int argc, char **argv) {
+	char *dir;
+	unsigned int records, count, i, last[RETENTION_HOSTS];
+	xrd_input in;
+	xrd_record *rec;
+	host *h0, *h1, *temp_host;
+	service *s0;
+	off_t full_size;
+	time_t last_check;
+	int resolved, segments;
+	char *buf;
+	size_t len;
+	FILE *fp;
+
+	plan_tests(27);
+
+	reset_variables();
+	config_file = strdup("etc/nagios-hosts.cfg");
+	ok(read_main_config_file(config_file) == OK && read_all_object_data(config_file) == OK && pre_flight_check() == OK,
+	   "Read object config");
+	initialize_downtime_data();
+	dir = make_scratch_dir("retention");
+	retention_file = scratch_path(dir, "retention.dat");
+	temp_file = scratch_path(dir, "retention.tmp");
+	use_binary_retention_file = TRUE;
+
+	/* the first save writes everything */
+	h0 = find_host("h0");
+	h1 = find_host("h1");
+	s0 = find_service("h1", "s0");
+	h0->current_state = HOST_DOWN;
+	h0->plugin_output = strdup("down");
+	ok(xrddefault_save_state_information() == OK, "Saved retention data");
+	segments = count_segments(&records);
+	ok(segments == 1 && records == 2 + 2 * RETENTION_HOSTS + 1, "Full segment holds everything")
+	|| diag("%d segments, %u records", segments, records);
+	full_size = saved.full_size;
+
+	/* what changes afterwards gets appended */
+	s0->current_state = STATE_WARNING;
+	ok(xrddefault_save_state_information() == OK, "Saved changed retention data");
+	segments = count_segments(&records);
+	ok(segments == 2 && records == 3 && saved.full_size == full_size && saved.size > full_size,
+	   "Only the changed service was appended") || diag("%d segments, %u records", segments, records);
+
+	/* check times and latency alone aren't a change */
+	h1->last_check = time(NULL);
+	h1->next_check = h1->last_check + 300;
+	h1->latency = 1.5;
+	h1->execution_time = 0.25;
+	s0->last_check = h1->last_check;
+	ok(xrddefault_save_state_information() == OK, "Saved retention data after checks");
+	segments = count_segments(&records);
+	ok(segments == 3 && records == 2, "New check times and latency aren't appended")
+	|| diag("%d segments, %u records", segments, records);
+	h1->current_attempt = 2;
+	ok(xrddefault_save_state_information() == OK && count_segments(&records) == 4 && records == 3,
+	   "Volatile values are written along with a real change");
+
+	/* the binary reader puts the last record of each object back */
+	h0->current_state = HOST_UP;
+	my_free(h0->plugin_output);
+	s0->current_state = STATE_OK;
+	h1->current_attempt = 1;
+	ok(xrddefault_read_state_information() == OK, "Read binary retention data");
+	ok(h0->current_state == HOST_DOWN && h0->plugin_output && !strcmp(h0->plugin_output, "down"),
+	   "Host state read from the full segment");
+	ok(s0->current_state == STATE_WARNING, "Service state read from an appended segment");
+	ok(h1->current_attempt == 2, "Last record of an object wins");
+
+	/* a save that died halfway is ignored */
+	s0->current_state = STATE_CRITICAL;
+	ok(xrddefault_save_state_information() == OK, "Saved retention data");
+	if((fp = fopen(retention_file, "a")) != NULL) {
+		xrd_write_segment_header(fp, XRDDEFAULT_SEGMENT_INCREMENTAL, 0, 0);
+		fputs("garbage", fp);
+		fclose(fp);
+		}
+	s0->current_state = STATE_OK;
+	ok(xrddefault_read_state_information() == OK && s0->current_state == STATE_CRITICAL,
+	   "Unfinished segment is ignored");
+
+	/* someone else's file gets rewritten rather than appended to */
+	s0->current_state = STATE_UNKNOWN;
+	ok(xrddefault_save_state_information() == OK && count_segments(&records) == 1 && saved.size == saved.full_size,
+	   "Retention file rewritten when it changed behind our back");
+
+	/* and so does one where the appended changes outgrow the full segment */
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next)
+		temp_host->current_state = HOST_UNREACHABLE;
+	for(i = 0; i < num_objects.services; i++)
+		service_ary[i]->current_state = STATE_CRITICAL;
+	ok(xrddefault_save_state_information() == OK && count_segments(&records) == 2, "Changed objects appended");
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next)
+		temp_host->current_state = HOST_DOWN;
+	ok(xrddefault_save_state_information() == OK && count_segments(&records) == 1 &&
+	   records == 2 + 2 * RETENTION_HOSTS + 1 && saved.size == saved.full_size, "Retention file compacted");
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next)
+		temp_host->current_state = HOST_UP;
+	ok(xrddefault_read_state_information() == OK && h1->current_state == HOST_DOWN, "Compacted file reads back");
+
+	/* check times alone wait for a real change, or for the save on the way out */
+	unlink(retention_file);
+	ok(xrddefault_save_state_information() == OK && count_segments(&records) == 1, "Saved a fresh retention file");
+	h1->last_check = time(NULL) - 60;
+	s0->last_check = h1->last_check;
+	last_check = h1->last_check;
+	ok(xrddefault_save_state_information() == OK && (segments = count_segments(&records)) == 2 && records == 2,
+	   "Check times alone still aren't appended") || diag("%d segments, %u records", segments, records);
+	sigrestart = TRUE;
+	ok(xrddefault_save_state_information() == OK && count_segments(&records) == 1 && saved.size == saved.full_size,
+	   "Retention file rewritten when restarting");
+	sigrestart = FALSE;
+	h1->last_check = 0;
+	s0->last_check = 0;
+	ok(xrddefault_read_state_information() == OK && h1->last_check == last_check && s0->last_check == last_check,
+	   "Check times read back after a restart") || diag("%lu %lu", (unsigned long)h1->last_check, (unsigned long)s0->last_check);
+
+	/* enough records to resolve them on several threads */
+	count = XRD_PARALLEL_MIN_RECORDS + 3;
+	buf = build_host_records(count, &len);
+	memset(&in, 0, sizeof(in));
+	in.map = buf;
+	in.map_len = len;
+	ok(buf != NULL && xrd_index_binary(&in) == OK && in.num_recs == count, "Indexed host records");
+
+	resolved = 0;
+	memset(last, 0, sizeof(last));
+	for(i = 0; i < in.num_recs; i++) {
+		rec = &in.recs[i];
+		temp_host = (i % 7 == 0) ? NULL : host_ary[i % RETENTION_HOSTS];
+		if(rec->obj == temp_host && (temp_host == NULL || rec->skip == 1))
+			resolved++;
+		if(temp_host != NULL)
+			last[i % RETENTION_HOSTS] = i;
+		}
+	ok(resolved == (int)count, "Every record resolved to its host, whatever its id") || diag("%d of %u resolved", resolved, count);
+	ok(in.num_order == RETENTION_HOSTS, "One record used per host");
+	for(i = 0, resolved = 0; i < in.num_order; i++) {
+		rec = &in.recs[in.order[i]];
+		if(rec->obj != NULL && in.order[i] == last[((host *)rec->obj)->id])
+			resolved++;
+		}
+	ok(resolved == RETENTION_HOSTS, "The last record of each host is used");
+
+	/* however many cpus there are to do it on */
+	for(i = 0; i < in.num_recs; i++) {
+		in.recs[i].obj = NULL;
+		in.recs[i].skip = 0;
+		}
+	xrd_resolve_all(&in, 4);
+	for(i = 0, resolved = 0; i < in.num_recs; i++) {
+		temp_host = (i % 7 == 0) ? NULL : host_ary[i % RETENTION_HOSTS];
+		if(in.recs[i].obj == temp_host && in.recs[i].skip == 1)
+			resolved++;
+		}
+	ok(resolved == (int)count, "Records resolved the same on four threads") || diag("%d of %u resolved", resolved, count);
+	in.map = NULL;
+	xrd_close(&in);
+	free(buf);
+
+	cleanup();
+	my_free(config_file);
+	remove_scratch_dir(dir);
+
+	return exit_status();
+	}
@@ -0,0 +1,229 @@
+/*****************************************************************************
+ *
+ * test_status_shm.c - Test reading status data from the status segment
+ *
+ * Program: Nagios Core Testing
+ * License: GPL
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *****************************************************************************/
+
+/* Need these to get CGI mode */
+#undef NSCORE
+#define NSCGI 1
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/statusdata.h"
+#include "../include/comments.h"
+#include "../include/downtime.h"
+#include "../xdata/xsddefault.h"
+#include "tap.h"
+#include "fixtures.c"
+
+extern hoststatus *hoststatus_list;
+extern int nagios_pid;
+extern int enable_notifications;
+extern int program_stats[MAX_CHECK_STATS_TYPES][3];
+
+/*
+ * A segment like the core writes it, with hosts h0 and h1 and
+ * service s0 on h0, one comment on h0 and a downtime on s0.
+ */
+static struct xsddefault_shm_header *build_segment(size_t *size) {
+	struct xsddefault_shm_header *shm;
+	struct xsddefault_shm_record *r;
+	struct xsddefault_shm_program *prog;
+	struct xsddefault_shm_comment *c;
+	struct xsddefault_shm_downtime *d;
+	const char strings[] = "\0h0\0h1\0s0";
+	char *misc;
+	size_t len;
+
+	*size = sizeof(*shm) + 3 * sizeof(*r) + 16 + 4096;
+	if((shm = calloc(1, *size)) == NULL)
+		return NULL;
+	memcpy(shm->magic, XSDDEFAULT_SHM_MAGIC, sizeof(shm->magic));
+	shm->header_size = sizeof(*shm);
+	shm->record_size = sizeof(*r);
+	shm->num_hosts = 2;
+	shm->num_services = 1;
+	shm->records = sizeof(*shm);
+	shm->strings = shm->records + 3 * sizeof(*r);
+	shm->strings_size = 16;
+	shm->misc = shm->strings + shm->strings_size;
+	shm->misc_size = 4096;
+	shm->last_update = 1234567890;
+	memcpy((char *)shm + shm->strings, strings, sizeof(strings));
+
+	r = (struct xsddefault_shm_record *)((char *)shm + shm->records);
+	r[0].name = 1;
+	r[0].has_been_checked = 1;
+	r[0].current_state = HOST_DOWN;
+	r[0].plugin_output_len = 13;
+	r[0].perf_data_len = 3;
+	memcpy(r[0].text, "down\\nfor now\0a=1\0", 19);
+	r[1].name = 4;
+	r[1].should_be_scheduled = 1;
+	r[1].next_check = 1234567890;
+	r[2].name = 1;
+	r[2].description = 7;
+	r[2].has_been_checked = 1;
+	r[2].current_state = STATE_CRITICAL;
+	r[2].plugin_output_len = 4;
+	r[2].long_plugin_output_len = 4;
+	memcpy(r[2].text, "crit\0\0more", 11);
+
+	misc = (char *)shm + shm->misc;
+	prog = (struct xsddefault_shm_program *)misc;
+	prog->nagios_pid = 4711;
+	prog->enable_notifications = 1;
+	prog->check_stats[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS][0] = 17;
+	prog->num_comments = 1;
+	prog->num_downtime = 1;
+	c = (struct xsddefault_shm_comment *)(prog + 1);
+	d = (struct xsddefault_shm_downtime *)(c + 1);
+	len = (char *)(d + 1) - misc + 1;
+	c->comment_type = HOST_COMMENT;
+	c->comment_id = 42;
+	c->host_name = len;
+	len += sprintf(misc + len, "h0") + 1;
+	c->author = len;
+	len += sprintf(misc + len, "me") + 1;
+	c->comment_data = len;
+	len += sprintf(misc + len, "a comment") + 1;
+	d->type = SERVICE_DOWNTIME;
+	d->downtime_id = 7;
+	d->comment_id = 42;
+	d->start_time = 1000;
+	d->end_time = 2000;
+	d->fixed = 1;
+	d->host_name = c->host_name;
+	d->service_description = len;
+	len += sprintf(misc + len, "s0") + 1;
+	d->author = c->author;
+	d->comment = c->comment_data;
+	shm->misc_len = len;
+
+	return shm;
+	}
+
+static int write_file(const char *path, const void *buf, size_t len) {
+	FILE *fp;
+	int result = ERROR;
+
+	if((fp = fopen(path, "w")) == NULL)
+		return ERROR;
+	if(fwrite(buf, len, 1, fp) == 1)
+		result = OK;
+	if(fclose(fp))
+		result = ERROR;
+	return result;
+	}
+
+int main(int argc, char **argv) {
+	char *dir, *status_file = "etc/status-shm-fallback.dat";
+	struct xsddefault_shm_header *shm;
+	struct xsddefault_shm_record *r;
+	hoststatus *temp_hoststatus;
+	servicestatus *temp_servicestatus;
+	nagios_comment *temp_comment;
+	scheduled_downtime *temp_downtime;
+	size_t size;
+
+	plan_tests(22);
+
+	ok((dir = make_scratch_dir("statusshm")) != NULL && (shm = build_segment(&size)) != NULL, "Built status segment");
+	status_shm_file = scratch_path(dir, "status.shm");
+	ok(write_file(status_shm_file, shm, size) == OK, "Wrote status segment");
+
+	/* downtime is only taken for objects that exist */
+	my_free(object_cache_file);
+	object_cache_file = strdup("etc/status-shm.cache");
+	ok(read_object_config_data(object_cache_file, READ_ALL_OBJECT_DATA) == OK, "Read objects");
+	initialize_downtime_data();
+
+	ok(xsddefault_read_status_data(status_file, 0) == OK, "Read status data from the status segment");
+	temp_hoststatus = find_hoststatus("h0");
+	ok(temp_hoststatus != NULL && temp_hoststatus->status == SD_HOST_DOWN && temp_hoststatus->last_update == 1234567890,
+	   "Host status read");
+	ok(temp_hoststatus != NULL && !strcmp(temp_hoststatus->plugin_output, "down\nfor now") &&
+	   !strcmp(temp_hoststatus->perf_data, "a=1") && temp_hoststatus->long_plugin_output == NULL, "Host check output read");
+	temp_hoststatus = find_hoststatus("h1");
+	ok(temp_hoststatus != NULL && temp_hoststatus->has_been_checked == FALSE &&
+	   !strncmp(temp_hoststatus->plugin_output, "Host check scheduled for", 24), "Pending host gets the usual output");
+	temp_servicestatus = find_servicestatus("h0", "s0");
+	ok(temp_servicestatus != NULL && temp_servicestatus->status == SERVICE_CRITICAL &&
+	   !strcmp(temp_servicestatus->plugin_output, "crit") && temp_servicestatus->perf_data == NULL &&
+	   !strcmp(temp_servicestatus->long_plugin_output, "more"), "Service status read");
+	ok(find_hoststatus("fallback") == NULL, "Status file left alone");
+	ok(nagios_pid == 4711 && enable_notifications == TRUE && program_stats[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS][0] == 17,
+	   "Program status read");
+	temp_comment = find_host_comment(42);
+	ok(temp_comment != NULL && !strcmp(temp_comment->host_name, "h0") && !strcmp(temp_comment->comment_data, "a comment"),
+	   "Comment read");
+	temp_downtime = find_service_downtime(7);
+	ok(temp_downtime != NULL && !strcmp(temp_downtime->service_description, "s0") && temp_downtime->comment_id == 42 &&
+	   temp_downtime->fixed == TRUE && temp_downtime->end_time == 2000, "Downtime read");
+	ok(xsddefault_is_shm_status(find_hoststatus("h1")) && xsddefault_is_shm_status(find_servicestatus("h0", "s0")),
+	   "Statuses live in the segment's arrays");
+	free_status_data();
+	free_comment_data();
+	free_downtime_data();
+	ok(hoststatus_list == NULL && find_hoststatus("h0") == NULL, "Status data freed");
+
+	/* a record the core never finished writing */
+	r = (struct xsddefault_shm_record *)((char *)shm + shm->records);
+	r[2].seq = 1;
+	ok(write_file(status_shm_file, shm, size) == OK, "Wrote status segment with a torn record");
+	ok(xsddefault_read_status_data(status_file, 0) == OK, "Read status data");
+	ok(find_hoststatus("fallback") != NULL && find_hoststatus("h0") == NULL && comment_list == NULL,
+	   "Status file read instead, with nothing from the segment");
+	free_status_data();
+
+	/* same for the misc area */
+	r[2].seq = 2;
+	shm->misc_seq = 3;
+	ok(write_file(status_shm_file, shm, size) == OK && xsddefault_read_status_data(status_file, 0) == OK &&
+	   find_hoststatus("fallback") != NULL && find_hoststatus("h0") == NULL, "Torn misc area falls back to the status file");
+	free_status_data();
+
+	/* and for a segment from some other version */
+	shm->misc_seq = 4;
+	memcpy(shm->magic, "NSSHM001", sizeof(shm->magic));
+	ok(write_file(status_shm_file, shm, size) == OK && xsddefault_read_status_data(status_file, 0) == OK &&
+	   find_hoststatus("fallback") != NULL, "Old status segment falls back to the status file");
+	free_status_data();
+
+	memcpy(shm->magic, XSDDEFAULT_SHM_MAGIC, sizeof(shm->magic));
+	shm->obsolete = 1;
+	ok(write_file(status_shm_file, shm, size) == OK && xsddefault_read_status_data(status_file, 0) == OK &&
+	   find_hoststatus("fallback") != NULL, "Obsolete status segment falls back to the status file");
+	free_status_data();
+
+	shm->obsolete = 0;
+	initialize_downtime_data();
+	ok(write_file(status_shm_file, shm, size) == OK && xsddefault_read_status_data(status_file, 0) == OK &&
+	   find_hoststatus("h0") != NULL, "Status segment is used again once it's fine");
+	free_status_data();
+	free_comment_data();
+	free_downtime_data();
+
+	ok(remove_scratch_dir(dir) == 0, "Cleaned up");
+	free(shm);
+	my_free(status_shm_file);
+	free_object_data();
+
+	return exit_status();
+	}
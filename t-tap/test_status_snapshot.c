@@ -0,0 +1,189 @@
+/*****************************************************************************
+*
+* test_status_snapshot.c - Test the binary status snapshot and delta log
+*
+* Program: Nagios Core Testing
+* License: GPL
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+*****************************************************************************/
+
+#define NSCORE 1
+#include "../xdata/xsddefault.c"
+
+#include "tap.h"
+#include "stub_perfdata.c"
+#include "stub_workers.c"
+#include "stub_events.c"
+#include "stub_logging.c"
+#include "stub_commands.c"
+#include "stub_checks.c"
+#include "stub_nebmods.c"
+#include "stub_netutils.c"
+#include "stub_broker.c"
+#include "stub_statusdata.c"
+#include "stub_flapping.c"
+#include "stub_notifications.c"
+#include "fixtures.c"
+
+static int compare_lines(const void *a, const void *b) {
+	return strcmp(*(char * const *)a, *(char * const *)b);
+	}
+
+
+/*
+ * status file text with comments and blank lines dropped and the
+ * fields of each block sorted, since replayed blocks put last_update
+ * at the end
+ */
+static char *normalize_status_text(FILE *fp) {
+	char *line = NULL, *fields[512], *out = NULL;
+	size_t line_size = 0, out_len = 0;
+	unsigned int num_fields = 0, i;
+	FILE *out_fp;
+
+	if((out_fp = open_memstream(&out, &out_len)) == NULL)
+		return NULL;
+	while(getline(&line, &line_size, fp) > 0) {
+		if(line[0] == '#' || line[0] == '\n')
+			continue;
+		if(!strcmp(line, "\t}\n")) {
+			qsort(fields, num_fields, sizeof(char *), compare_lines);
+			for(i = 0; i < num_fields; i++) {
+				fputs(fields[i], out_fp);
+				free(fields[i]);
+				}
+			fputs(line, out_fp);
+			num_fields = 0;
+			}
+		else if(line[0] == '\t' && num_fields < sizeof(fields) / sizeof(fields[0]))
+			fields[num_fields++] = strdup(line);
+		else
+			fputs(line, out_fp);
+		}
+	for(i = 0; i < num_fields; i++)
+		free(fields[i]);
+	free(line);
+	fclose(out_fp);
+
+	return out;
+	}
+
+
+/*
+ * does what the CGIs replay match a full status file written at
+ * 'current_time', or the one the last save wrote if that's 0?
+ */
+static int replay_matches_full_dump(time_t current_time) {
+	char *cmd = NULL, *replayed = NULL, *full = NULL;
+	int result = FALSE;
+	FILE *fp;
+
+	if(current_time && xsddefault_save_text_status_data(current_time) != OK)
+		return FALSE;
+	if((fp = fopen(status_file, "r")) != NULL) {
+		full = normalize_status_text(fp);
+		fclose(fp);
+		}
+	asprintf(&cmd, "./status_snapshot_replay %s", status_snapshot_file);
+	if(cmd && (fp = popen(cmd, "r")) != NULL) {
+		replayed = normalize_status_text(fp);
+		if(pclose(fp) != 0)
+			my_free(replayed);
+		}
+
+	if(full && replayed && strstr(full, "hoststatus {") != NULL)
+		result = !strcmp(full, replayed);
+	if(result == FALSE && full && replayed)
+		diag("full dump:\n%s\nreplayed:\n%s", full, replayed);
+
+	my_free(cmd);
+	my_free(full);
+	my_free(replayed);
+	return result;
+	}
+
+
+int main(int argc, char **argv) {
+	char *dir;
+	unsigned long comment_id = 0L;
+	time_t current_time;
+	host *h0;
+	service *s1;
+	contact *admin;
+	FILE *fp;
+
+	plan_tests(10);
+
+	reset_variables();
+	config_file = strdup("etc/nagios-hosts.cfg");
+	ok(read_main_config_file(config_file) == OK && read_all_object_data(config_file) == OK && pre_flight_check() == OK,
+	   "Read object config");
+	initialize_downtime_data();
+	dir = make_scratch_dir("snapshot");
+	status_file = scratch_path(dir, "status.dat");
+	status_snapshot_file = scratch_path(dir, "status.bin");
+	temp_file = scratch_path(dir, "status.tmp");
+	ok(xsddefault_initialize_status_data(config_file) == OK, "Initialized status data");
+
+	/* the first save writes a snapshot */
+	h0 = find_host("h0");
+	s1 = find_service("h1", "s0");
+	admin = find_contact("admin");
+	ok(xsddefault_save_status_data() == OK && status_delta_fd >= 0, "Wrote status snapshot");
+	ok(replay_matches_full_dump(0), "Snapshot replays to the status file");
+	current_time = last_status_compaction + 1;
+
+	/* then what changes goes into the delta log */
+	h0->current_state = HOST_DOWN;
+	h0->plugin_output = strdup("down");
+	h0->last_check = current_time;
+	xsddefault_update_host_status(h0);
+	add_new_comment(HOST_COMMENT, USER_COMMENT, "h0", NULL, current_time, "me", "looking", TRUE, COMMENTSOURCE_INTERNAL, FALSE, (time_t)0, &comment_id);
+	ok(xsddefault_append_status_delta(current_time) == OK && status_delta_size > 16, "Appended changed host and comment");
+	ok(replay_matches_full_dump(current_time), "Snapshot plus delta replays to a full dump");
+
+	current_time++;
+	s1->current_state = STATE_CRITICAL;
+	s1->plugin_output = strdup("critical");
+	xsddefault_update_service_status(s1);
+	admin->host_notifications_enabled = FALSE;
+	xsddefault_update_contact_status(admin);
+	h0->current_state = HOST_UP;
+	xsddefault_update_host_status(h0);
+	delete_comment(HOST_COMMENT, comment_id);
+	ok(xsddefault_append_status_delta(current_time) == OK, "Appended a second delta");
+	ok(replay_matches_full_dump(current_time), "Later deltas win, and deleted comments are gone");
+
+	/* a dump the core is still writing isn't used */
+	if((fp = fopen(status_delta_file, "a")) != NULL) {
+		fputc(XSDDEFAULT_HOSTSTATUS_DATA, fp);
+		fputs("\x01\x09host_name\x02h0", fp);
+		fclose(fp);
+		}
+	ok(replay_matches_full_dump(current_time), "Unfinished dump in the delta log is ignored");
+
+	/* and compaction starts over with what we have */
+	last_status_compaction = 0;
+	ok(xsddefault_save_status_data() == OK && status_delta_size == 16 && replay_matches_full_dump(0),
+	   "Compacted snapshot replays to a full dump");
+
+	xsddefault_cleanup_status_data(TRUE);
+	cleanup();
+	my_free(config_file);
+	remove_scratch_dir(dir);
+
+	return exit_status();
+	}
@@ -68,6 +68,8 @@ int my_recvall(int s, char *buf, int *len, int timeout) { return 0; }
 int neb_free_module_list(void) { return 0; }
 int close_command_file(void) { return 0; }
 int close_log_file(void) { return 0; }
+int stop_log_writer(void) { return 0; }
+void free_freshness_data(void) {}
 int fix_log_file_owner(uid_t uid, gid_t gid) { return 0; }
 int handle_async_service_check_result(service *temp_service, check_result *queued_check_result) { return 0; }
 int handle_async_host_check_result(host *temp_host, check_result *queued_check_result) { return 0; }
@@ -0,0 +1,277 @@
+/*****************************************************************************
+*
+* test_workers.c - Test handing out worker jobs, splitting their commands and giving up on lost ones
+*
+* Program: Nagios Core Testing
+* License: GPL
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+*****************************************************************************/
+
+#define NSCORE 1
+#include "../base/workers.c"
+
+#include "tap.h"
+#include "stub_perfdata.c"
+#include "stub_events.c"
+#include "stub_logging.c"
+#include "stub_commands.c"
+#include "stub_nebmods.c"
+#include "stub_netutils.c"
+#include "stub_broker.c"
+#include "stub_statusdata.c"
+#include "stub_flapping.c"
+#include "stub_notifications.c"
+#include "fixtures.c"
+
+/* we want to see which checks get rescheduled */
+#define handle_orphaned_service_check stub_handle_orphaned_service_check
+#define handle_orphaned_host_check stub_handle_orphaned_host_check
+#include "stub_checks.c"
+#undef handle_orphaned_service_check
+#undef handle_orphaned_host_check
+
+static int orphaned_services, orphaned_hosts;
+
+int qh_register_handler(const char *name, const char *description, unsigned int options, qh_handler handler)
+{ return 0; }
+
+void handle_orphaned_service_check(service *svc, time_t current_time)
+{ orphaned_services++; }
+
+void handle_orphaned_host_check(host *hst, time_t current_time)
+{ orphaned_hosts++; }
+
+/* three idle workers that take jobs as get_worker() hands them out */
+static void run_dispatch_tests(void) {
+	struct wproc_worker w[3], *wps[3];
+	int i, p2c_ok = TRUE;
+
+	memset(w, 0, sizeof(w));
+	for(i = 0; i < 3; i++) {
+		w[i].name = "test worker";
+		w[i].max_jobs = 10;
+		wps[i] = &w[i];
+		}
+	workers.wps = wps;
+	workers.len = 3;
+	workers.idx = 0;
+
+	worker_dispatch_policy = WPDISPATCH_ROUND_ROBIN;
+	ok(get_worker("/bin/true") == &w[0] && get_worker("/bin/true") == &w[1] && get_worker("/bin/true") == &w[2] &&
+	   get_worker("/bin/true") == &w[0], "Round-robin takes the workers in turn");
+
+	worker_dispatch_policy = WPDISPATCH_LEAST_JOBS;
+	w[0].jobs_running = 5;
+	w[1].jobs_running = 2;
+	w[2].jobs_running = 4;
+	ok(get_worker("/bin/true") == &w[1], "Least-jobs picks the worker with the fewest jobs");
+	w[1].jobs_running = w[1].max_jobs;
+	ok(get_worker("/bin/true") == &w[2], "Least-jobs passes over full workers");
+
+	/* with two workers, both are drawn every time */
+	worker_dispatch_policy = WPDISPATCH_POWER_OF_TWO;
+	workers.len = 2;
+	w[1].jobs_running = 3;
+	for(i = 0; i < 10; i++)
+		p2c_ok = p2c_ok && get_worker("/bin/true") == &w[1];
+	ok(p2c_ok, "Power-of-two picks the less busy of the workers it draws");
+	workers.len = 3;
+
+	/* 2s * 1, 0.1s * 4 and 0.5s * 1 */
+	worker_dispatch_policy = WPDISPATCH_EWMA_LATENCY;
+	w[0].jobs_running = 0;
+	w[0].ewma_runtime = 2.0;
+	w[1].ewma_runtime = 0.1;
+	w[2].jobs_running = 0;
+	w[2].ewma_runtime = 0.5;
+	ok(get_worker("/bin/true") == &w[1], "EWMA latency prefers a fast worker over idle slow ones");
+	w[2].ewma_runtime = 0.0;
+	ok(get_worker("/bin/true") == &w[2], "A worker with no measurements yet is taken to be as fast as the fastest");
+	w[0].ewma_runtime = w[1].ewma_runtime = 0.0;
+	w[0].jobs_running = 5;
+	w[2].jobs_running = 4;
+	ok(get_worker("/bin/true") == &w[1], "With nothing measured, EWMA latency goes by job count");
+
+	worker_dispatch_policy = WPDISPATCH_ROUND_ROBIN;
+	workers.wps = NULL;
+	workers.len = 0;
+	}
+
+/* true if argv is what we expected. Frees argv */
+static int argv_is(char **argv, const char **expect) {
+	int i, match = argv != NULL;
+
+	for(i = 0; match && expect[i]; i++)
+		match = argv[i] && !strcmp(argv[i], expect[i]);
+	match = match && !argv[i];
+	for(i = 0; !match && argv && argv[i]; i++)
+		diag("argv[%d]: '%s'", i, argv[i]);
+	free(argv);
+	return match;
+	}
+
+static void prepare_test_command(command *cmd, const char *command_line) {
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->command_line = strdup(command_line);
+	prepare_command(cmd);
+	}
+
+static void free_test_command(command *cmd) {
+	int i;
+
+	for(i = 0; cmd->argv_tmpl && cmd->argv[i]; i++)
+		my_free(cmd->argv_tmpl[i]);
+	my_free(cmd->argv_tmpl);
+	my_free(cmd->argv);
+	my_free(cmd->macro_tmpl);
+	my_free(cmd->command_line);
+	}
+
+/* command lines split at config load, and expanded per job */
+static void run_argv_tests(void) {
+	const char *echo_host[] = { "/bin/echo", "-a", "b c", "h0", NULL };
+	const char *echo_args[] = { "/bin/echo", "x y", "-w", "5", "-c", "10", NULL };
+	const char *shell[] = { "/bin/sh", "-c", "/bin/echo a | cat", NULL };
+	struct wproc_worker w;
+	struct wproc_job job;
+	nagios_macros mac;
+	command cmd;
+
+	memset(&mac, 0, sizeof(mac));
+	grab_host_macros_r(&mac, find_host("h0"));
+	mac.command_ptr = &cmd;
+
+	prepare_test_command(&cmd, "/bin/echo -a 'b c' $HOSTNAME$");
+	ok(cmd.argv && !cmd.argv_shell && cmd.argv_tmpl && !cmd.argv_tmpl[2] && cmd.argv_tmpl[3],
+	   "Command line split at config load, with its macro argument marked");
+	ok(argv_is(get_command_argv_r(&mac, "/bin/echo -a 'b c' h0"), echo_host), "Only the macro argument is expanded per job");
+	free_test_command(&cmd);
+
+	prepare_test_command(&cmd, "/bin/echo \"$ARG1$\" $ARG2$");
+	mac.argv[0] = strdup("x y");
+	mac.argv[1] = strdup("-w 5 -c 10");
+	ok(argv_is(get_command_argv_r(&mac, "/bin/echo \"x y\" -w 5 -c 10"), echo_args),
+	   "Macro arguments split where the expanded command line would");
+	my_free(mac.argv[1]);
+	mac.argv[1] = strdup("a;b");
+	ok(get_command_argv_r(&mac, "/bin/echo \"x y\" a;b") == NULL, "Macros that expand to shell specials leave the command line to the worker");
+	free_test_command(&cmd);
+
+	prepare_test_command(&cmd, "/bin/echo a | cat");
+	ok(cmd.argv_shell && !cmd.argv, "Command lines that need a shell are marked at config load");
+	ok(argv_is(get_command_argv_r(&mac, "/bin/echo a | cat"), shell), "And run with /bin/sh -c");
+	free_test_command(&cmd);
+
+	prepare_test_command(&cmd, "FOO=$ARG1$ /bin/true");
+	ok(cmd.argv_shell && !cmd.argv, "So are those that set environment variables");
+	free_test_command(&cmd);
+
+	/* the prepared command only goes with the job it was prepared for */
+	prepare_test_command(&cmd, "/bin/echo -a 'b c' $HOSTNAME$");
+	memset(&w, 0, sizeof(w));
+	memset(&job, 0, sizeof(job));
+	w.split_argv = TRUE;
+	job.wp = &w;
+	job.command = "/bin/echo -a 'b c' h0";
+	ok(argv_is(wproc_job_argv(&job, &mac), echo_host) && mac.command_ptr == NULL && wproc_job_argv(&job, &mac) == NULL,
+	   "Jobs use the prepared command once");
+	free_test_command(&cmd);
+
+	clear_volatile_macros_r(&mac);
+	}
+
+/* a check job, handed to the worker as wproc_run_job() would */
+static struct wproc_job *start_check_job(const char *host_name, const char *service_description) {
+	check_result *cr = calloc(1, sizeof(*cr));
+	struct wproc_job *job;
+
+	init_check_result(cr);
+	cr->host_name = strdup(host_name);
+	if(service_description) {
+		cr->service_description = strdup(service_description);
+		cr->object_check_type = SERVICE_CHECK;
+		}
+	if((job = create_job(WPJOB_CHECK, cr, 30, "/bin/true")) != NULL)
+		arm_job_deadline(job);
+	return job;
+	}
+
+int main(int argc, char **argv) {
+	struct wproc_worker *wp;
+	struct wproc_job *svc_job, *host_job, *answered_job, *other_job;
+	unsigned int svc_job_id;
+	time_t now, due;
+
+	plan_tests(25);
+
+	reset_variables();
+	config_file = strdup("etc/nagios-hosts.cfg");
+	ok(read_main_config_file(config_file) == OK && read_all_object_data(config_file) == OK && pre_flight_check() == OK,
+	   "Read object config");
+
+	run_dispatch_tests();
+	run_argv_tests();
+
+	/* a worker that never answers */
+	wp = calloc(1, sizeof(*wp));
+	wp->name = "test worker";
+	wp->sd = -1;
+	wp->jobs = fanout_create(16);
+	workers.wps = &wp;
+	workers.len = 1;
+	check_orphaned_services = check_orphaned_hosts = TRUE;
+
+	time(&now);
+	due = now + 30 + check_reaper_interval + WPROC_ORPHAN_SLACK + 1;
+	svc_job = start_check_job("h0", "s0");
+	host_job = start_check_job("h0", NULL);
+	answered_job = start_check_job("h0", "s0");
+	if((other_job = create_job(WPJOB_HOST_PERFDATA, NULL, 30, "/bin/true")) != NULL)
+		arm_job_deadline(other_job);
+	ok(svc_job && host_job && answered_job && other_job && squeue_size(job_deadlines) == 4, "Started jobs");
+	svc_job_id = svc_job->id;
+
+	/* a result came back for this one */
+	destroy_job(get_job(wp, answered_job->id));
+	ok(squeue_size(job_deadlines) == 3, "Answered job leaves the deadline index");
+
+	ok(wproc_reap_orphaned_jobs(now) == 0 && orphaned_services == 0 && orphaned_hosts == 0, "Nothing is reaped before its deadline");
+	ok(wproc_reap_orphaned_jobs(due) == 3, "Jobs past their deadline are reaped");
+	ok(orphaned_services == 1 && orphaned_hosts == 1, "Orphaned service and host checks are rescheduled once each")
+	|| diag("services=%d hosts=%d", orphaned_services, orphaned_hosts);
+	ok(wp->jobs_orphaned == 3 && get_job(wp, svc_job_id) == NULL && squeue_size(job_deadlines) == 0,
+	   "Reaped jobs are gone and counted against their worker");
+	ok(wproc_reap_orphaned_jobs(due + 3600) == 0 && orphaned_services == 1 && orphaned_hosts == 1,
+	   "Nothing is reaped twice");
+
+	/* with orphan checking disabled, the job is left alone */
+	check_orphaned_services = FALSE;
+	svc_job = start_check_job("h0", "s0");
+	ok(wproc_reap_orphaned_jobs(due) == 0 && orphaned_services == 1, "Orphaned service checks are left alone when disabled");
+	ok(get_job(wp, svc_job->id) == svc_job && svc_job->deadline == NULL && wproc_reap_orphaned_jobs(due + 3600) == 0,
+	   "Such a job is still known, and not reaped later");
+	destroy_job(svc_job);
+
+	squeue_destroy(job_deadlines, 0);
+	fanout_destroy(wp->jobs, NULL);
+	free(wp);
+	workers.wps = NULL;
+	workers.len = 0;
+	cleanup();
+	my_free(config_file);
+
+	return exit_status();
+	}
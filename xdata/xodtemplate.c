@@ -55,6 +55,7 @@
 
 #ifdef NSCORE
 #include "../include/nagios.h"
+#include <pthread.h>
 #endif
 
 #ifdef NSCGI
@@ -105,8 +106,9 @@ skiplist *xobject_template_skiplists[NUM_XOBJECT_SKIPLISTS];
 skiplist *xobject_skiplists[NUM_XOBJECT_SKIPLISTS];
 
 
-void *xodtemplate_current_object = NULL;
-int xodtemplate_current_object_type = XODTEMPLATE_NONE;
+/* the object being parsed, which is per thread when parsing in parallel */
+__thread void *xodtemplate_current_object = NULL;
+__thread int xodtemplate_current_object_type = XODTEMPLATE_NONE;
 
 int xodtemplate_current_config_file = 0;
 char **xodtemplate_config_files = NULL;
@@ -120,6 +122,78 @@ static struct object_count xodcount;
 static bitmap *host_map = NULL, *contact_map = NULL;
 static bitmap *service_map = NULL, *parent_map = NULL;
 
+/* objects already on the list an expansion function is building */
+static bitmap *listed_hosts = NULL, *listed_contacts = NULL;
+static bitmap *listed_services = NULL;
+static void xodtemplate_mark_listed(bitmap *listed, objectlist *list, int set);
+static int xodtemplate_add_listed(objectlist **list, bitmap *listed, void *obj);
+static int _xodtemplate_expand_services(objectlist **list, bitmap *reject_map, char *host_name, char *services, int _config_file, int _start_line);
+
+/* a message logged while parsing a file in a worker thread */
+typedef struct xodtemplate_parse_message {
+	int data_type;
+	int display;
+	char *text;
+	struct xodtemplate_parse_message *next;
+	} xodtemplate_parse_message;
+
+/*
+ * One entry in the list of things to read when object config files
+ * are parsed in parallel. Worker threads parse files into the lists
+ * and skiplists of their job, and the main thread merges the jobs in
+ * order, so the result is the same as reading the files one by one.
+ * Entries without a filename announce the directory they're from.
+ */
+typedef struct xodtemplate_parse_job {
+	char *filename;
+	char *dirname;
+	int threaded;       /* should be parsed by a worker thread */
+	int serial;         /* must be parsed by the main thread */
+	int done;
+	int result;
+	struct object_count count;
+	xodtemplate_parse_message *messages, *last_message;
+	skiplist *template_skiplists[NUM_XOBJECT_SKIPLISTS];
+	skiplist *skiplists[NUM_XOBJECT_SKIPLISTS];
+	xodtemplate_timeperiod *timeperiod_list;
+	xodtemplate_command *command_list;
+	xodtemplate_contactgroup *contactgroup_list;
+	xodtemplate_hostgroup *hostgroup_list;
+	xodtemplate_servicegroup *servicegroup_list;
+	xodtemplate_servicedependency *servicedependency_list;
+	xodtemplate_serviceescalation *serviceescalation_list;
+	xodtemplate_contact *contact_list;
+	xodtemplate_host *host_list;
+	xodtemplate_service *service_list;
+	xodtemplate_hostdependency *hostdependency_list;
+	xodtemplate_hostescalation *hostescalation_list;
+	xodtemplate_hostextinfo *hostextinfo_list;
+	xodtemplate_serviceextinfo *serviceextinfo_list;
+	} xodtemplate_parse_job;
+
+/* the job the current thread is parsing, if any */
+static __thread xodtemplate_parse_job *xod_parse_job = NULL;
+
+#ifdef NSCORE
+static int parse_threads = 1;
+static xodtemplate_parse_job *parse_jobs = NULL;
+static int num_parse_jobs = 0, parse_jobs_size = 0, next_parse_job = 0;
+static int parse_options = 0, stop_parsing = FALSE;
+static pthread_mutex_t parse_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t parse_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t *parse_thread_ids = NULL;
+static int num_parse_threads = 0;
+static xodtemplate_host **resolve_hosts = NULL;
+static xodtemplate_service **resolve_services = NULL;
+static unsigned int num_resolve_hosts = 0, num_resolve_services = 0, next_resolve = 0;
+static int resolve_result = OK;
+
+static xodtemplate_parse_job *xodtemplate_add_parse_job(char *, char *);
+static int xodtemplate_queue_parse_dir(char *);
+static int xodtemplate_process_parse_jobs(int, int);
+#endif
+static void xodtemplate_create_skiplists(skiplist **, skiplist **);
+
 /* These variables are defined in base/utils.c, but as CGIs do not need these
    we just fake the values for this file */
 #ifdef NSCGI
@@ -161,7 +235,11 @@ static bitmap *service_map = NULL, *parent_map = NULL;
 
 /* returns the name of a numbered config file */
 static const char *xodtemplate_config_file_name(int cfgfile) {
-	if(cfgfile <= xodtemplate_current_config_file)
+	/* files read by worker threads are numbered when they're merged */
+	if(xod_parse_job != NULL && cfgfile == 0)
+		return xod_parse_job->filename;
+
+	if(cfgfile > 0 && cfgfile <= xodtemplate_current_config_file)
 		return xodtemplate_config_files[cfgfile - 1];
 
 	return "?";
@@ -193,6 +271,7 @@ int xodtemplate_read_config_data(const char *main_config_file, int options) {
 	char *val = NULL;
 	double runtime[11];
 	mmapfile *thefile = NULL;
+	xodtemplate_parse_job *job = NULL;
 #endif
 	struct timeval tv[12];
 	int result = OK;
@@ -255,6 +334,9 @@ int xodtemplate_read_config_data(const char *main_config_file, int options) {
 
 	/* process object config files normally... */
 	else {
+		/* object config files may be read by several threads */
+		parse_threads = config_parser_threads > 0 ? config_parser_threads : online_cpus();
+
 		/* determine the directory of the main config file */
 		if((cfgfile = (char *)strdup(main_config_file)) == NULL) {
 			my_free(xodtemplate_config_files);
@@ -306,7 +388,14 @@ int xodtemplate_read_config_data(const char *main_config_file, int options) {
 					cfgfile = strdup(val);
 
 				/* process the config file... */
-				result = xodtemplate_process_config_file(cfgfile, options);
+				if(parse_threads > 1) {
+					if((job = xodtemplate_add_parse_job(cfgfile, NULL)) != NULL)
+						job->threaded = TRUE;
+					else
+						result = ERROR;
+					}
+				else
+					result = xodtemplate_process_config_file(cfgfile, options);
 
 				my_free(cfgfile);
 
@@ -329,7 +418,15 @@ int xodtemplate_read_config_data(const char *main_config_file, int options) {
 					cfgfile[strlen(cfgfile) - 1] = '\x0';
 
 				/* process the config directory... */
-				result = xodtemplate_process_config_dir(cfgfile, options);
+				if(parse_threads > 1) {
+					/* stop queueing at a directory that can't be read */
+					if(xodtemplate_queue_parse_dir(cfgfile) == ERROR) {
+						my_free(cfgfile);
+						break;
+						}
+					}
+				else
+					result = xodtemplate_process_config_dir(cfgfile, options);
 
 				my_free(cfgfile);
 
@@ -339,6 +436,10 @@ int xodtemplate_read_config_data(const char *main_config_file, int options) {
 				}
 			}
 
+		/* read what's been queued */
+		if(parse_threads > 1)
+			result = xodtemplate_process_parse_jobs(options, result);
+
 		/* free memory and close the file */
 		my_free(config_base_dir);
 		my_free(input);
@@ -379,7 +480,9 @@ int xodtemplate_read_config_data(const char *main_config_file, int options) {
 	/* do the meat and potatoes stuff... */
 	host_map = bitmap_create(xodcount.hosts);
 	contact_map = bitmap_create(xodcount.contacts);
-	if(!host_map || !contact_map) {
+	listed_hosts = bitmap_create(xodcount.hosts);
+	listed_contacts = bitmap_create(xodcount.contacts);
+	if(!host_map || !contact_map || !listed_hosts || !listed_contacts) {
 		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Failed to create bitmaps for resolving objects\n");
 		return ERROR;
 		}
@@ -408,7 +511,8 @@ int xodtemplate_read_config_data(const char *main_config_file, int options) {
 
 	/* now we have an accurate service count */
 	service_map = bitmap_create(xodcount.services);
-	if(!service_map) {
+	listed_services = bitmap_create(xodcount.services);
+	if(!service_map || !listed_services) {
 		logit(NSLOG_CONFIG_ERROR, TRUE, "Failed to create service map\n");
 		return ERROR;
 		}
@@ -509,6 +613,10 @@ int xodtemplate_read_config_data(const char *main_config_file, int options) {
 	bitmap_destroy(contact_map);
 	bitmap_destroy(host_map);
 	bitmap_destroy(service_map);
+	bitmap_destroy(listed_contacts);
+	bitmap_destroy(listed_hosts);
+	bitmap_destroy(listed_services);
+	listed_contacts = listed_hosts = listed_services = NULL;
 
 	return result;
 	}
@@ -593,6 +701,67 @@ int xodtemplate_process_config_dir(char *dirname, int options) {
 	}
 
 
+/* saves the name of a config file, returning its number */
+static int xodtemplate_register_config_file(char *filename) {
+
+	/* save config file name */
+	xodtemplate_config_files[xodtemplate_current_config_file++] = (char *)strdup(filename);
+
+	/* reallocate memory for config files */
+	if(!(xodtemplate_current_config_file % 256)) {
+		xodtemplate_config_files = (char **)realloc(xodtemplate_config_files, (xodtemplate_current_config_file + 256) * sizeof(char *));
+		if(xodtemplate_config_files == NULL)
+			return ERROR;
+		}
+
+	return xodtemplate_current_config_file;
+	}
+
+
+#ifdef NSCORE
+/*
+ * Worker threads can't log anything while they parse, since that
+ * would mix up the order of the messages. What they log is kept with
+ * their job instead, and logged when the main thread merges it.
+ */
+static void xodtemplate_logit(int data_type, int display, const char *fmt, ...) {
+	xodtemplate_parse_message *new_message = NULL;
+	char *buffer = NULL;
+	va_list ap;
+
+	va_start(ap, fmt);
+	if(vasprintf(&buffer, fmt, ap) < 0)
+		buffer = NULL;
+	va_end(ap);
+	if(buffer == NULL)
+		return;
+
+	if(xod_parse_job == NULL) {
+		logit(data_type, display, "%s", buffer);
+		free(buffer);
+		return;
+		}
+
+	if((new_message = (xodtemplate_parse_message *)malloc(sizeof(*new_message))) == NULL) {
+		free(buffer);
+		return;
+		}
+	new_message->data_type = data_type;
+	new_message->display = display;
+	new_message->text = buffer;
+	new_message->next = NULL;
+	if(xod_parse_job->last_message == NULL)
+		xod_parse_job->messages = new_message;
+	else
+		xod_parse_job->last_message->next = new_message;
+	xod_parse_job->last_message = new_message;
+	}
+
+/* everything logged while parsing object definitions goes through the above */
+#define logit xodtemplate_logit
+#endif
+
+
 /* process data in a specific config file */
 int xodtemplate_process_config_file(char *filename, int options) {
 	mmapfile *thefile = NULL;
@@ -605,18 +774,13 @@ int xodtemplate_process_config_file(char *filename, int options) {
 	char *ptr = NULL;
 
 
+	/* worker threads parse files the main thread already knows about */
+	if(xod_parse_job == NULL) {
 #ifdef NSCORE
-	if(verify_config >= 2)
-		printf("Processing object config file '%s'...\n", filename);
+		if(verify_config >= 2)
+			printf("Processing object config file '%s'...\n", filename);
 #endif
-
-	/* save config file name */
-	xodtemplate_config_files[xodtemplate_current_config_file++] = (char *)strdup(filename);
-
-	/* reallocate memory for config files */
-	if(!(xodtemplate_current_config_file % 256)) {
-		xodtemplate_config_files = (char **)realloc(xodtemplate_config_files, (xodtemplate_current_config_file + 256) * sizeof(char *));
-		if(xodtemplate_config_files == NULL)
+		if(xodtemplate_register_config_file(filename) == ERROR)
 			return ERROR;
 		}
 
@@ -712,7 +876,7 @@ int xodtemplate_process_config_file(char *filename, int options) {
 				}
 
 			/* start a new definition */
-			if(xodtemplate_begin_object_definition(input, options, xodtemplate_current_config_file, current_line) == ERROR) {
+			if(xodtemplate_begin_object_definition(input, options, xod_parse_job ? 0 : xodtemplate_current_config_file, current_line) == ERROR) {
 				logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Could not add object definition in file '%s' on line %d.\n", filename, current_line);
 				result = ERROR;
 				break;
@@ -830,6 +994,11 @@ int xodtemplate_process_config_file(char *filename, int options) {
 	\
 			/* update current object pointer */ \
 			xodtemplate_current_object=xodtemplate_##type##_list_tail; \
+		} else if(xod_parse_job != NULL) { \
+			/* worker threads keep objects with their job until it's merged */ \
+			new_##type->next=xod_parse_job->type##_list; \
+			xod_parse_job->type##_list=new_##type; \
+			xodtemplate_current_object=new_##type; \
 		} else { \
 			/* add new object to head of list in memory */ \
 			new_##type->next=xodtemplate_##type##_list; \
@@ -1092,7 +1261,7 @@ static const char *xodtemplate_type_name(unsigned int id) {
 static void xodtemplate_obsoleted(const char *var, int start_line) {
 	logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: %s is obsoleted and no longer has any effect in %s type objects (config file '%s', starting at line %d)\n",
 		 var, xodtemplate_type_name(xodtemplate_current_object_type),
-		 xodtemplate_config_file_name(xodtemplate_current_config_file), start_line);
+		 xodtemplate_config_file_name(xod_parse_job ? 0 : xodtemplate_current_config_file), start_line);
 	}
 
 /* adds a property to an object definition */
@@ -1118,8 +1287,19 @@ int xodtemplate_add_object_property(char *input, int options) {
 	xodtemplate_hostextinfo *temp_hostextinfo = NULL;
 	xodtemplate_serviceextinfo *temp_serviceextinfo = NULL;
 	int x, lth, force_skiplists = FALSE;
+	skiplist **template_skiplists = xobject_template_skiplists;
+	skiplist **object_skiplists = xobject_skiplists;
+	struct object_count *counts = &xodcount;
+	char *strtok_ptr = NULL;
 
 
+	/* worker threads have skiplists and counters of their own */
+	if(xod_parse_job != NULL) {
+		template_skiplists = xod_parse_job->template_skiplists;
+		object_skiplists = xod_parse_job->skiplists;
+		counts = &xod_parse_job->count;
+		}
+
 	/* should some object definitions be added to skiplists immediately? */
 #ifdef NSCORE
 	if(use_precached_objects == TRUE)
@@ -1229,7 +1409,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add timeperiod to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[TIMEPERIOD_SKIPLIST], (void *)temp_timeperiod);
+					result = skiplist_insert(template_skiplists[TIMEPERIOD_SKIPLIST], (void *)temp_timeperiod);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for timeperiod '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_timeperiod->_config_file), temp_timeperiod->_start_line);
@@ -1250,7 +1430,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add timeperiod to template skiplist for fast searches */
-					result = skiplist_insert(xobject_skiplists[TIMEPERIOD_SKIPLIST], (void *)temp_timeperiod);
+					result = skiplist_insert(object_skiplists[TIMEPERIOD_SKIPLIST], (void *)temp_timeperiod);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for timeperiod '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_timeperiod->_config_file), temp_timeperiod->_start_line);
@@ -1299,7 +1479,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add command to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[COMMAND_SKIPLIST], (void *)temp_command);
+					result = skiplist_insert(template_skiplists[COMMAND_SKIPLIST], (void *)temp_command);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for command '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_command->_config_file), temp_command->_start_line);
@@ -1320,7 +1500,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add command to template skiplist for fast searches */
-					result = skiplist_insert(xobject_skiplists[COMMAND_SKIPLIST], (void *)temp_command);
+					result = skiplist_insert(object_skiplists[COMMAND_SKIPLIST], (void *)temp_command);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for command '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_command->_config_file), temp_command->_start_line);
@@ -1363,7 +1543,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add contactgroup to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[CONTACTGROUP_SKIPLIST], (void *)temp_contactgroup);
+					result = skiplist_insert(template_skiplists[CONTACTGROUP_SKIPLIST], (void *)temp_contactgroup);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for contactgroup '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_contactgroup->_config_file), temp_contactgroup->_start_line);
@@ -1384,7 +1564,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add contactgroup to template skiplist for fast searches */
-					result = skiplist_insert(xobject_skiplists[CONTACTGROUP_SKIPLIST], (void *)temp_contactgroup);
+					result = skiplist_insert(object_skiplists[CONTACTGROUP_SKIPLIST], (void *)temp_contactgroup);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for contactgroup '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_contactgroup->_config_file), temp_contactgroup->_start_line);
@@ -1459,7 +1639,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add hostgroup to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[HOSTGROUP_SKIPLIST], (void *)temp_hostgroup);
+					result = skiplist_insert(template_skiplists[HOSTGROUP_SKIPLIST], (void *)temp_hostgroup);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for hostgroup '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_hostgroup->_config_file), temp_hostgroup->_start_line);
@@ -1480,7 +1660,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add hostgroup to template skiplist for fast searches */
-					result = skiplist_insert(xobject_skiplists[HOSTGROUP_SKIPLIST], (void *)temp_hostgroup);
+					result = skiplist_insert(object_skiplists[HOSTGROUP_SKIPLIST], (void *)temp_hostgroup);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for hostgroup '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_hostgroup->_config_file), temp_hostgroup->_start_line);
@@ -1577,7 +1757,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add servicegroup to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[SERVICEGROUP_SKIPLIST], (void *)temp_servicegroup);
+					result = skiplist_insert(template_skiplists[SERVICEGROUP_SKIPLIST], (void *)temp_servicegroup);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for servicegroup '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_servicegroup->_config_file), temp_servicegroup->_start_line);
@@ -1598,7 +1778,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add servicegroup to template skiplist for fast searches */
-					result = skiplist_insert(xobject_skiplists[SERVICEGROUP_SKIPLIST], (void *)temp_servicegroup);
+					result = skiplist_insert(object_skiplists[SERVICEGROUP_SKIPLIST], (void *)temp_servicegroup);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for servicegroup '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_servicegroup->_config_file), temp_servicegroup->_start_line);
@@ -1695,7 +1875,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add dependency to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[SERVICEDEPENDENCY_SKIPLIST], (void *)temp_servicedependency);
+					result = skiplist_insert(template_skiplists[SERVICEDEPENDENCY_SKIPLIST], (void *)temp_servicedependency);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for service dependency '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_servicedependency->_config_file), temp_servicedependency->_start_line);
@@ -1779,7 +1959,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				}
 			else if(!strcmp(variable, "execution_failure_options") || !strcmp(variable, "execution_failure_criteria")) {
 				temp_servicedependency->have_execution_failure_options = TRUE;
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "o") || !strcmp(temp_ptr, "ok"))
 						flag_set(temp_servicedependency->execution_failure_options, OPT_OK);
 					else if(!strcmp(temp_ptr, "u") || !strcmp(temp_ptr, "unknown"))
@@ -1805,7 +1985,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				}
 			else if(!strcmp(variable, "notification_failure_options") || !strcmp(variable, "notification_failure_criteria")) {
 				temp_servicedependency->have_notification_failure_options = TRUE;
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "o") || !strcmp(temp_ptr, "ok"))
 						flag_set(temp_servicedependency->notification_failure_options, OPT_OK);
 					else if(!strcmp(temp_ptr, "u") || !strcmp(temp_ptr, "unknown"))
@@ -1854,7 +2034,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add escalation to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[SERVICEESCALATION_SKIPLIST], (void *)temp_serviceescalation);
+					result = skiplist_insert(template_skiplists[SERVICEESCALATION_SKIPLIST], (void *)temp_serviceescalation);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for service escalation '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_serviceescalation->_config_file), temp_serviceescalation->_start_line);
@@ -1942,7 +2122,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_serviceescalation->have_notification_interval = TRUE;
 				}
 			else if(!strcmp(variable, "escalation_options")) {
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "w") || !strcmp(temp_ptr, "warning"))
 						flag_set(temp_serviceescalation->escalation_options, OPT_WARNING);
 					else if(!strcmp(temp_ptr, "u") || !strcmp(temp_ptr, "unknown"))
@@ -1989,7 +2169,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add contact to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[CONTACT_SKIPLIST], (void *)temp_contact);
+					result = skiplist_insert(template_skiplists[CONTACT_SKIPLIST], (void *)temp_contact);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for contact '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_contact->_config_file), temp_contact->_start_line);
@@ -2010,7 +2190,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add contact to template skiplist for fast searches */
-					result = skiplist_insert(xobject_skiplists[CONTACT_SKIPLIST], (void *)temp_contact);
+					result = skiplist_insert(object_skiplists[CONTACT_SKIPLIST], (void *)temp_contact);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for contact '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_contact->_config_file), temp_contact->_start_line);
@@ -2024,7 +2204,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 							break;
 						}
 					}
-				temp_contact->id = xodcount.contacts++;
+				temp_contact->id = counts->contacts++;
 				}
 			else if(!strcmp(variable, "alias")) {
 				if((temp_contact->alias = (char *)strdup(value)) == NULL)
@@ -2091,7 +2271,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_contact->have_service_notification_commands = TRUE;
 				}
 			else if(!strcmp(variable, "host_notification_options")) {
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "d") || !strcmp(temp_ptr, "down"))
 						flag_set(temp_contact->host_notification_options, OPT_DOWN);
 					else if(!strcmp(temp_ptr, "u") || !strcmp(temp_ptr, "unreachable"))
@@ -2116,7 +2296,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_contact->have_host_notification_options = TRUE;
 				}
 			else if(!strcmp(variable, "service_notification_options")) {
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "u") || !strcmp(temp_ptr, "unknown"))
 						flag_set(temp_contact->service_notification_options, OPT_UNKNOWN);
 					else if(!strcmp(temp_ptr, "w") || !strcmp(temp_ptr, "warning"))
@@ -2224,7 +2404,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add host to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[HOST_SKIPLIST], (void *)temp_host);
+					result = skiplist_insert(template_skiplists[HOST_SKIPLIST], (void *)temp_host);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for host '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_host->_config_file), temp_host->_start_line);
@@ -2245,7 +2425,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add host to template skiplist for fast searches */
-					result = skiplist_insert(xobject_skiplists[HOST_SKIPLIST], (void *)temp_host);
+					result = skiplist_insert(object_skiplists[HOST_SKIPLIST], (void *)temp_host);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for host '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_host->_config_file), temp_host->_start_line);
@@ -2259,7 +2439,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 							break;
 						}
 					}
-				temp_host->id = xodcount.hosts++;
+				temp_host->id = counts->hosts++;
 				}
 			else if(!strcmp(variable, "display_name")) {
 				if(strcmp(value, XODTEMPLATE_NULL)) {
@@ -2468,7 +2648,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				/* user is specifying something, so discard defaults... */
 				temp_host->flap_detection_options = OPT_NOTHING;
 
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "o") || !strcmp(temp_ptr, "up"))
 						flag_set(temp_host->flap_detection_options, OPT_UP);
 					else if(!strcmp(temp_ptr, "d") || !strcmp(temp_ptr, "down"))
@@ -2489,7 +2669,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_host->have_flap_detection_options = TRUE;
 				}
 			else if(!strcmp(variable, "notification_options")) {
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "d") || !strcmp(temp_ptr, "down"))
 						flag_set(temp_host->notification_options, OPT_DOWN);
 					else if(!strcmp(temp_ptr, "u") || !strcmp(temp_ptr, "unreachable"))
@@ -2526,7 +2706,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_host->have_first_notification_delay = TRUE;
 				}
 			else if(!strcmp(variable, "stalking_options")) {
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "o") || !strcmp(temp_ptr, "up"))
 						flag_set(temp_host->stalking_options, OPT_UP);
 					else if(!strcmp(temp_ptr, "d") || !strcmp(temp_ptr, "down"))
@@ -2556,12 +2736,12 @@ int xodtemplate_add_object_property(char *input, int options) {
 				xodtemplate_obsoleted(variable, temp_host->_start_line);
 				}
 			else if(!strcmp(variable, "2d_coords")) {
-				if((temp_ptr = strtok(value, ", ")) == NULL) {
+				if((temp_ptr = strtok_r(value, ", ", &strtok_ptr)) == NULL) {
 					logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Invalid 2d_coords value '%s' in host definition.\n", temp_ptr);
 					return ERROR;
 					}
 				temp_host->x_2d = atoi(temp_ptr);
-				if((temp_ptr = strtok(NULL, ", ")) == NULL) {
+				if((temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) == NULL) {
 					logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Invalid 2d_coords value '%s' in host definition.\n", temp_ptr);
 					return ERROR;
 					}
@@ -2569,17 +2749,17 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_host->have_2d_coords = TRUE;
 				}
 			else if(!strcmp(variable, "3d_coords")) {
-				if((temp_ptr = strtok(value, ", ")) == NULL) {
+				if((temp_ptr = strtok_r(value, ", ", &strtok_ptr)) == NULL) {
 					logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Invalid 3d_coords value '%s' in host definition.\n", temp_ptr);
 					return ERROR;
 					}
 				temp_host->x_3d = strtod(temp_ptr, NULL);
-				if((temp_ptr = strtok(NULL, ", ")) == NULL) {
+				if((temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) == NULL) {
 					logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Invalid 3d_coords value '%s' in host definition.\n", temp_ptr);
 					return ERROR;
 					}
 				temp_host->y_3d = strtod(temp_ptr, NULL);
-				if((temp_ptr = strtok(NULL, ", ")) == NULL) {
+				if((temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) == NULL) {
 					logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Invalid 3d_coords value '%s' in host definition.\n", temp_ptr);
 					return ERROR;
 					}
@@ -2650,7 +2830,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add service to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[SERVICE_SKIPLIST], (void *)temp_service);
+					result = skiplist_insert(template_skiplists[SERVICE_SKIPLIST], (void *)temp_service);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for service '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_service->_config_file), temp_service->_start_line);
@@ -2675,7 +2855,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				/* NOTE: services are added to the skiplist in xodtemplate_duplicate_services(), except if daemon is using precached config */
 				if(result == OK && force_skiplists == TRUE  && temp_service->host_name != NULL && temp_service->service_description != NULL) {
 					/* add service to template skiplist for fast searches */
-					result = skiplist_insert(xobject_skiplists[SERVICE_SKIPLIST], (void *)temp_service);
+					result = skiplist_insert(object_skiplists[SERVICE_SKIPLIST], (void *)temp_service);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for service '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_service->_config_file), temp_service->_start_line);
@@ -2683,7 +2863,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 							break;
 						case SKIPLIST_OK:
 							result = OK;
-							temp_service->id = xodcount.services++;
+							temp_service->id = counts->services++;
 							break;
 						default:
 							result = ERROR;
@@ -2701,7 +2881,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				/* NOTE: services are added to the skiplist in xodtemplate_duplicate_services(), except if daemon is using precached config */
 				if(result == OK && force_skiplists == TRUE  && temp_service->host_name != NULL && temp_service->service_description != NULL) {
 					/* add service to template skiplist for fast searches */
-					result = skiplist_insert(xobject_skiplists[SERVICE_SKIPLIST], (void *)temp_service);
+					result = skiplist_insert(object_skiplists[SERVICE_SKIPLIST], (void *)temp_service);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for service '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_service->_config_file), temp_service->_start_line);
@@ -2709,7 +2889,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 							break;
 						case SKIPLIST_OK:
 							result = OK;
-							temp_service->id = xodcount.services++;
+							temp_service->id = counts->services++;
 							break;
 						default:
 							result = ERROR;
@@ -2929,7 +3109,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				/* user is specifying something, so discard defaults... */
 				temp_service->flap_detection_options = OPT_NOTHING;
 
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "o") || !strcmp(temp_ptr, "ok"))
 						flag_set(temp_service->flap_detection_options, OPT_OK);
 					else if(!strcmp(temp_ptr, "w") || !strcmp(temp_ptr, "warning"))
@@ -2952,7 +3132,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_service->have_flap_detection_options = TRUE;
 				}
 			else if(!strcmp(variable, "notification_options")) {
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "u") || !strcmp(temp_ptr, "unknown"))
 						flag_set(temp_service->notification_options, OPT_UNKNOWN);
 					else if(!strcmp(temp_ptr, "w") || !strcmp(temp_ptr, "warning"))
@@ -2991,7 +3171,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_service->have_first_notification_delay = TRUE;
 				}
 			else if(!strcmp(variable, "stalking_options")) {
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "o") || !strcmp(temp_ptr, "ok"))
 						flag_set(temp_service->stalking_options, OPT_OK);
 					else if(!strcmp(temp_ptr, "w") || !strcmp(temp_ptr, "warning"))
@@ -3083,7 +3263,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add dependency to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[HOSTDEPENDENCY_SKIPLIST], (void *)temp_hostdependency);
+					result = skiplist_insert(template_skiplists[HOSTDEPENDENCY_SKIPLIST], (void *)temp_hostdependency);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for host dependency '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_hostdependency->_config_file), temp_hostdependency->_start_line);
@@ -3139,7 +3319,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				}
 			else if(!strcmp(variable, "notification_failure_options") || !strcmp(variable, "notification_failure_criteria")) {
 				temp_hostdependency->have_notification_failure_options = TRUE;
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "o") || !strcmp(temp_ptr, "up"))
 						flag_set(temp_hostdependency->notification_failure_options, OPT_UP);
 					else if(!strcmp(temp_ptr, "d") || !strcmp(temp_ptr, "down"))
@@ -3162,7 +3342,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 					}
 				}
 			else if(!strcmp(variable, "execution_failure_options") || !strcmp(variable, "execution_failure_criteria")) {
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "o") || !strcmp(temp_ptr, "up"))
 						flag_set(temp_hostdependency->execution_failure_options, OPT_UP);
 					else if(!strcmp(temp_ptr, "d") || !strcmp(temp_ptr, "down"))
@@ -3209,7 +3389,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add escalation to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[HOSTESCALATION_SKIPLIST], (void *)temp_hostescalation);
+					result = skiplist_insert(template_skiplists[HOSTESCALATION_SKIPLIST], (void *)temp_hostescalation);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for host escalation '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_hostescalation->_config_file), temp_hostescalation->_start_line);
@@ -3282,7 +3462,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_hostescalation->have_notification_interval = TRUE;
 				}
 			else if(!strcmp(variable, "escalation_options")) {
-				for(temp_ptr = strtok(value, ", "); temp_ptr; temp_ptr = strtok(NULL, ", ")) {
+				for(temp_ptr = strtok_r(value, ", ", &strtok_ptr); temp_ptr; temp_ptr = strtok_r(NULL, ", ", &strtok_ptr)) {
 					if(!strcmp(temp_ptr, "d") || !strcmp(temp_ptr, "down"))
 						flag_set(temp_hostescalation->escalation_options, OPT_DOWN);
 					else if(!strcmp(temp_ptr, "u") || !strcmp(temp_ptr, "unreachable"))
@@ -3313,7 +3493,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 		case XODTEMPLATE_HOSTEXTINFO:
 
-			temp_hostextinfo = xodtemplate_hostextinfo_list;
+			temp_hostextinfo = (xodtemplate_hostextinfo *)xodtemplate_current_object;
 
 			if(!strcmp(variable, "use")) {
 				if((temp_hostextinfo->template = (char *)strdup(value)) == NULL)
@@ -3326,7 +3506,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[HOSTEXTINFO_SKIPLIST], (void *)temp_hostextinfo);
+					result = skiplist_insert(template_skiplists[HOSTEXTINFO_SKIPLIST], (void *)temp_hostextinfo);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for extended host info '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_hostextinfo->_config_file), temp_hostextinfo->_start_line);
@@ -3405,13 +3585,13 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_hostextinfo->have_statusmap_image = TRUE;
 				}
 			else if(!strcmp(variable, "2d_coords")) {
-				temp_ptr = strtok(value, ", ");
+				temp_ptr = strtok_r(value, ", ", &strtok_ptr);
 				if(temp_ptr == NULL) {
 					logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Invalid 2d_coords value '%s' in extended host info definition.\n", temp_ptr);
 					return ERROR;
 					}
 				temp_hostextinfo->x_2d = atoi(temp_ptr);
-				temp_ptr = strtok(NULL, ", ");
+				temp_ptr = strtok_r(NULL, ", ", &strtok_ptr);
 				if(temp_ptr == NULL) {
 					logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Invalid 2d_coords value '%s' in extended host info definition.\n", temp_ptr);
 					return ERROR;
@@ -3420,19 +3600,19 @@ int xodtemplate_add_object_property(char *input, int options) {
 				temp_hostextinfo->have_2d_coords = TRUE;
 				}
 			else if(!strcmp(variable, "3d_coords")) {
-				temp_ptr = strtok(value, ", ");
+				temp_ptr = strtok_r(value, ", ", &strtok_ptr);
 				if(temp_ptr == NULL) {
 					logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Invalid 3d_coords value '%s' in extended host info definition.\n", temp_ptr);
 					return ERROR;
 					}
 				temp_hostextinfo->x_3d = strtod(temp_ptr, NULL);
-				temp_ptr = strtok(NULL, ", ");
+				temp_ptr = strtok_r(NULL, ", ", &strtok_ptr);
 				if(temp_ptr == NULL) {
 					logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Invalid 3d_coords value '%s' in extended host info definition.\n", temp_ptr);
 					return ERROR;
 					}
 				temp_hostextinfo->y_3d = strtod(temp_ptr, NULL);
-				temp_ptr = strtok(NULL, ", ");
+				temp_ptr = strtok_r(NULL, ", ", &strtok_ptr);
 				if(temp_ptr == NULL) {
 					logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Invalid 3d_coords value '%s' in extended host info definition.\n", temp_ptr);
 					return ERROR;
@@ -3451,7 +3631,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 		case XODTEMPLATE_SERVICEEXTINFO:
 
-			temp_serviceextinfo = xodtemplate_serviceextinfo_list;
+			temp_serviceextinfo = (xodtemplate_serviceextinfo *)xodtemplate_current_object;
 
 			if(!strcmp(variable, "use")) {
 				if((temp_serviceextinfo->template = (char *)strdup(value)) == NULL)
@@ -3464,7 +3644,7 @@ int xodtemplate_add_object_property(char *input, int options) {
 
 				if(result == OK) {
 					/* add to template skiplist for fast searches */
-					result = skiplist_insert(xobject_template_skiplists[SERVICEEXTINFO_SKIPLIST], (void *)temp_serviceextinfo);
+					result = skiplist_insert(template_skiplists[SERVICEEXTINFO_SKIPLIST], (void *)temp_serviceextinfo);
 					switch(result) {
 						case SKIPLIST_ERROR_DUPLICATE:
 							logit(NSLOG_CONFIG_WARNING, TRUE, "Warning: Duplicate definition found for extended service info '%s' (config file '%s', starting on line %d)\n", value, xodtemplate_config_file_name(temp_serviceextinfo->_config_file), temp_serviceextinfo->_start_line);
@@ -3564,13 +3744,14 @@ int xodtemplate_add_object_property(char *input, int options) {
 /* completes an object definition */
 int xodtemplate_end_object_definition(int options) {
 	int result = OK;
+	struct object_count *counts = xod_parse_job ? &xod_parse_job->count : &xodcount;
 
 	switch(xodtemplate_current_object_type) {
 	case XODTEMPLATE_HOSTESCALATION:
-		xodcount.hostescalations += !!use_precached_objects;
+		counts->hostescalations += !!use_precached_objects;
 		break;
 	case XODTEMPLATE_SERVICEESCALATION:
-		xodcount.serviceescalations += !!use_precached_objects;
+		counts->serviceescalations += !!use_precached_objects;
 		break;
 	case XODTEMPLATE_TIMEPERIOD:
 		xod_check_complete(timeperiod);
@@ -3921,7 +4102,8 @@ int xodtemplate_parse_timeperiod_directive(xodtemplate_timeperiod *tperiod, char
 		result = ERROR;
 
 #ifdef NSCORE
-	if(result == ERROR) {
+	/* files that fail in worker threads are read again by the main thread */
+	if(result == ERROR && xod_parse_job == NULL) {
 		printf("Error: Could not parse timeperiod directive '%s'!\n", input);
 		}
 #endif
@@ -4008,6 +4190,375 @@ int xodtemplate_get_weekday_from_string(char *str, int *weekday) {
 	return ERROR;
 	}
 
+#ifdef NSCORE
+#undef logit
+#endif
+
+
+
+/******************************************************************/
+/***************** PARALLEL CONFIG FILE PARSING *******************/
+/******************************************************************/
+
+#ifdef NSCORE
+/* adds an entry to the list of things to read */
+static xodtemplate_parse_job *xodtemplate_add_parse_job(char *filename, char *dirname) {
+	xodtemplate_parse_job *new_jobs = NULL, *job = NULL;
+
+	if(num_parse_jobs >= parse_jobs_size) {
+		new_jobs = (xodtemplate_parse_job *)realloc(parse_jobs, (parse_jobs_size + 256) * sizeof(*new_jobs));
+		if(new_jobs == NULL)
+			return NULL;
+		parse_jobs = new_jobs;
+		parse_jobs_size += 256;
+		}
+
+	job = &parse_jobs[num_parse_jobs];
+	memset(job, 0, sizeof(*job));
+	job->filename = filename ? (char *)strdup(filename) : NULL;
+	job->dirname = dirname ? (char *)strdup(dirname) : NULL;
+	if((filename && !job->filename) || (dirname && !job->dirname)) {
+		my_free(job->filename);
+		my_free(job->dirname);
+		return NULL;
+		}
+	num_parse_jobs++;
+
+	return job;
+	}
+
+
+/* removes entries from the end of the list of things to read */
+static void xodtemplate_drop_parse_jobs(int first) {
+
+	while(num_parse_jobs > first) {
+		num_parse_jobs--;
+		my_free(parse_jobs[num_parse_jobs].filename);
+		my_free(parse_jobs[num_parse_jobs].dirname);
+		}
+	}
+
+
+/*
+ * lists the files in a config directory in the order
+ * xodtemplate_process_config_dir() would read them
+ */
+static int xodtemplate_queue_config_dir(char *dirname) {
+	char file[MAX_FILENAME_LENGTH];
+	DIR *dirp = NULL;
+	struct dirent *dirfile = NULL;
+	xodtemplate_parse_job *job = NULL;
+	struct stat stat_buf;
+	int result = OK;
+	int x = 0;
+
+	if(xodtemplate_add_parse_job(NULL, dirname) == NULL)
+		return ERROR;
+
+	if((dirp = opendir(dirname)) == NULL)
+		return ERROR;
+
+	while((dirfile = readdir(dirp)) != NULL && result == OK) {
+
+		/* skip hidden files and directories, and current and parent dir */
+		if(dirfile->d_name[0] == '.')
+			continue;
+
+		snprintf(file, sizeof(file), "%s/%s", dirname, dirfile->d_name);
+		file[sizeof(file) - 1] = '\x0';
+
+		if(stat(file, &stat_buf) == -1) {
+			result = ERROR;
+			break;
+			}
+
+		switch(stat_buf.st_mode & S_IFMT) {
+
+			case S_IFREG:
+				x = strlen(dirfile->d_name);
+				if(x <= 4 || strcmp(dirfile->d_name + (x - 4), ".cfg"))
+					break;
+				if((job = xodtemplate_add_parse_job(file, NULL)) == NULL)
+					result = ERROR;
+				else
+					job->threaded = TRUE;
+				break;
+
+			case S_IFDIR:
+				result = xodtemplate_queue_config_dir(file);
+				break;
+
+			default:
+				break;
+			}
+		}
+
+	closedir(dirp);
+
+	return result;
+	}
+
+
+/* queues a cfg_dir, leaving it to the main thread if it can't be read */
+static int xodtemplate_queue_parse_dir(char *dirname) {
+	xodtemplate_parse_job *job = NULL;
+	int first = num_parse_jobs;
+
+	if(xodtemplate_queue_config_dir(dirname) == OK)
+		return OK;
+
+	/*
+	 * reading the directory the usual way will log the error at
+	 * the right moment, so there's no point in queueing anything
+	 * that comes after it.
+	 */
+	xodtemplate_drop_parse_jobs(first);
+	if((job = xodtemplate_add_parse_job(NULL, dirname)) != NULL)
+		job->serial = TRUE;
+
+	return ERROR;
+	}
+
+
+/* parses queued files until there are none left */
+static void *xodtemplate_parse_thread(void *discard) {
+	xodtemplate_parse_job *job = NULL;
+	mmapfile *thefile = NULL;
+
+	while(1) {
+		pthread_mutex_lock(&parse_lock);
+		while(next_parse_job < num_parse_jobs && parse_jobs[next_parse_job].threaded == FALSE)
+			next_parse_job++;
+		if(stop_parsing == TRUE || next_parse_job >= num_parse_jobs) {
+			pthread_mutex_unlock(&parse_lock);
+			break;
+			}
+		job = &parse_jobs[next_parse_job++];
+		pthread_mutex_unlock(&parse_lock);
+
+		/* files that include others must be read in order by the main thread */
+		thefile = mmap_fopen(job->filename);
+		if(thefile == NULL || (thefile->mmap_buf != NULL && memmem(thefile->mmap_buf, thefile->file_size, "include_", 8) != NULL))
+			job->serial = TRUE;
+		if(thefile != NULL)
+			mmap_fclose(thefile);
+
+		if(job->serial == FALSE) {
+			xodtemplate_create_skiplists(job->template_skiplists, job->skiplists);
+			xod_parse_job = job;
+			job->result = xodtemplate_process_config_file(job->filename, parse_options);
+			xodtemplate_current_object = NULL;
+			xodtemplate_current_object_type = XODTEMPLATE_NONE;
+			xod_parse_job = NULL;
+			}
+
+		pthread_mutex_lock(&parse_lock);
+		job->done = TRUE;
+		pthread_cond_broadcast(&parse_cond);
+		pthread_mutex_unlock(&parse_lock);
+		}
+
+	return NULL;
+	}
+
+
+/* removes what a job added to a set of skiplists, up to (not including) 'stop' */
+static void xodtemplate_unmerge_skiplists(skiplist **to, skiplist **from, void *stop) {
+	void *ptr = NULL, *data = NULL;
+	int x = 0;
+
+	for(x = 0; x < NUM_XOBJECT_SKIPLISTS; x++) {
+		for(data = skiplist_get_first(from[x], &ptr); data != NULL; data = skiplist_get_next(&ptr)) {
+			if(data == stop)
+				return;
+			skiplist_delete_first(to[x], data);
+			}
+		}
+	}
+
+
+/* adds a job's skiplist entries to a set of skiplists, or none at all if one is a duplicate */
+static int xodtemplate_merge_skiplists(skiplist **to, skiplist **from) {
+	void *ptr = NULL, *data = NULL;
+	int x = 0;
+
+	for(x = 0; x < NUM_XOBJECT_SKIPLISTS; x++) {
+		for(data = skiplist_get_first(from[x], &ptr); data != NULL; data = skiplist_get_next(&ptr)) {
+			if(skiplist_insert(to[x], data) != SKIPLIST_OK) {
+				xodtemplate_unmerge_skiplists(to, from, data);
+				return ERROR;
+				}
+			}
+		}
+
+	return OK;
+	}
+
+
+/* moves the objects of a job to the global lists */
+#define xod_merge_list(type) \
+	do { \
+		xodtemplate_##type *o = NULL, *last = NULL; \
+		for(o = job->type##_list; o != NULL; o = o->next) { \
+			o->_config_file = cfgfile; \
+			last = o; \
+			} \
+		if(last != NULL) { \
+			last->next = xodtemplate_##type##_list; \
+			xodtemplate_##type##_list = job->type##_list; \
+			job->type##_list = NULL; \
+			} \
+	} while(0)
+
+/*
+ * merges a parsed file into what's been read so far. If that
+ * fails, nothing has changed and the file should be read again
+ * by the main thread to get the errors right.
+ */
+static int xodtemplate_merge_parse_job(xodtemplate_parse_job *job) {
+	xodtemplate_parse_message *message = NULL;
+	xodtemplate_host *temp_host = NULL;
+	xodtemplate_contact *temp_contact = NULL;
+	int cfgfile = 0;
+
+	if(xodtemplate_merge_skiplists(xobject_template_skiplists, job->template_skiplists) == ERROR)
+		return ERROR;
+	if(xodtemplate_merge_skiplists(xobject_skiplists, job->skiplists) == ERROR) {
+		xodtemplate_unmerge_skiplists(xobject_template_skiplists, job->template_skiplists, NULL);
+		return ERROR;
+		}
+
+	if(verify_config >= 2)
+		printf("Processing object config file '%s'...\n", job->filename);
+	if((cfgfile = xodtemplate_register_config_file(job->filename)) == ERROR)
+		return ERROR;
+
+	for(message = job->messages; message != NULL; message = message->next)
+		logit(message->data_type, message->display, "%s", message->text);
+
+	/* objects got their ids as if theirs was the first file */
+	for(temp_host = job->host_list; temp_host != NULL; temp_host = temp_host->next) {
+		if(temp_host->host_name != NULL)
+			temp_host->id += xodcount.hosts;
+		}
+	for(temp_contact = job->contact_list; temp_contact != NULL; temp_contact = temp_contact->next) {
+		if(temp_contact->contact_name != NULL)
+			temp_contact->id += xodcount.contacts;
+		}
+	xodcount.hosts += job->count.hosts;
+	xodcount.contacts += job->count.contacts;
+
+	xod_merge_list(timeperiod);
+	xod_merge_list(command);
+	xod_merge_list(contactgroup);
+	xod_merge_list(hostgroup);
+	xod_merge_list(servicegroup);
+	xod_merge_list(servicedependency);
+	xod_merge_list(serviceescalation);
+	xod_merge_list(contact);
+	xod_merge_list(host);
+	xod_merge_list(service);
+	xod_merge_list(hostdependency);
+	xod_merge_list(hostescalation);
+	xod_merge_list(hostextinfo);
+	xod_merge_list(serviceextinfo);
+
+	return OK;
+	}
+#undef xod_merge_list
+
+
+/*
+ * reads everything that's been queued. Worker threads parse the
+ * files while the main thread merges them in order, so the objects,
+ * their ids and the messages logged end up exactly as if the files
+ * had been read one by one. Objects from files that have to be
+ * read again are leaked, but that only happens when there's an
+ * error in them.
+ */
+static int xodtemplate_process_parse_jobs(int options, int result) {
+	xodtemplate_parse_job *job = NULL;
+	xodtemplate_parse_message *message = NULL;
+	int threaded_jobs = 0;
+	int x = 0, y = 0;
+
+	parse_options = options;
+	stop_parsing = FALSE;
+	next_parse_job = 0;
+
+	for(x = 0; x < num_parse_jobs; x++)
+		threaded_jobs += parse_jobs[x].threaded;
+	if(threaded_jobs > parse_threads)
+		threaded_jobs = parse_threads;
+
+	if(result == OK && threaded_jobs > 0) {
+		if((parse_thread_ids = (pthread_t *)calloc(threaded_jobs, sizeof(pthread_t))) != NULL) {
+			for(x = 0; x < threaded_jobs; x++) {
+				if(pthread_create(&parse_thread_ids[num_parse_threads], NULL, xodtemplate_parse_thread, NULL))
+					break;
+				num_parse_threads++;
+				}
+			}
+		}
+
+	/* without threads, everything is read the usual way */
+	if(num_parse_threads == 0) {
+		for(x = 0; x < num_parse_jobs; x++) {
+			parse_jobs[x].serial = TRUE;
+			parse_jobs[x].done = TRUE;
+			}
+		}
+
+	for(x = 0; x < num_parse_jobs && result == OK; x++) {
+		job = &parse_jobs[x];
+
+		if(job->filename == NULL) {
+			if(job->serial == TRUE)
+				result = xodtemplate_process_config_dir(job->dirname, options);
+			else if(verify_config >= 2)
+				printf("Processing object config directory '%s'...\n", job->dirname);
+			continue;
+			}
+
+		pthread_mutex_lock(&parse_lock);
+		while(job->done == FALSE)
+			pthread_cond_wait(&parse_cond, &parse_lock);
+		pthread_mutex_unlock(&parse_lock);
+
+		if(job->serial == FALSE && job->result == OK && xodtemplate_merge_parse_job(job) == OK)
+			continue;
+
+		result = xodtemplate_process_config_file(job->filename, options);
+		}
+
+	pthread_mutex_lock(&parse_lock);
+	stop_parsing = TRUE;
+	pthread_mutex_unlock(&parse_lock);
+	for(x = 0; x < num_parse_threads; x++)
+		pthread_join(parse_thread_ids[x], NULL);
+	num_parse_threads = 0;
+	my_free(parse_thread_ids);
+
+	for(x = 0; x < num_parse_jobs; x++) {
+		job = &parse_jobs[x];
+		while((message = job->messages) != NULL) {
+			job->messages = message->next;
+			my_free(message->text);
+			my_free(message);
+			}
+		for(y = 0; y < NUM_XOBJECT_SKIPLISTS; y++) {
+			skiplist_free(&job->template_skiplists[y]);
+			skiplist_free(&job->skiplists[y]);
+			}
+		}
+	xodtemplate_drop_parse_jobs(0);
+	my_free(parse_jobs);
+	parse_jobs_size = 0;
+
+	return result;
+	}
+#endif
+
 
 
 /******************************************************************/
@@ -4203,12 +4754,11 @@ int xodtemplate_duplicate_services(void) {
  * If we have host_name/hostgroup_name and service_description, we do multiple
  * simple lookups and concatenate the results.
  */
-static int xodtemplate_create_service_list(objectlist **ret, bitmap *reject_map, char *host_name, char *hostgroup_name, char *servicegroup_name, char *service_description, int _config_file, int _start_line)
+static int _xodtemplate_create_service_list(objectlist **ret, bitmap *reject_map, char *host_name, char *hostgroup_name, char *servicegroup_name, char *service_description, int _config_file, int _start_line)
 {
 	objectlist *hlist = NULL, *hglist = NULL, *slist = NULL, *sglist = NULL;
 	objectlist *glist, *gnext, *list, *next; /* iterators */
 	xodtemplate_hostgroup fake_hg;
-	bitmap *in;
 
 	/*
 	 * if we have a service_description, we need host_name
@@ -4225,8 +4775,6 @@ static int xodtemplate_create_service_list(objectlist **ret, bitmap *reject_map,
 
 	/* we'll need these */
 	bitmap_clear(host_map);
-	if (!(in = bitmap_create(xodcount.services)))
-		return ERROR;
 
 	/*
 	 * all services in the accepted servicegroups can be added, except
@@ -4243,10 +4791,9 @@ static int xodtemplate_create_service_list(objectlist **ret, bitmap *reject_map,
 			xodtemplate_service *s = (xodtemplate_service *)list->object_ptr;
 
 			/* rejected or already added */
-			if(bitmap_isset(in, s->id) || bitmap_isset(reject_map, s->id))
+			if(bitmap_isset(reject_map, s->id))
 				continue;
-			bitmap_set(in, s->id);
-			if(prepend_object_to_objectlist(ret, s) != OK) {
+			if(xodtemplate_add_listed(ret, listed_services, s) != OK) {
 				free_objectlist(&gnext);
 				return ERROR;
 			}
@@ -4275,7 +4822,6 @@ static int xodtemplate_create_service_list(objectlist **ret, bitmap *reject_map,
 		if(prepend_object_to_objectlist(&hglist, &fake_hg) != OK) {
 			free_objectlist(&hlist);
 			free_objectlist(&hglist);
-			bitmap_destroy(in);
 			return ERROR;
 		}
 	}
@@ -4290,36 +4836,56 @@ static int xodtemplate_create_service_list(objectlist **ret, bitmap *reject_map,
 			if(bitmap_isset(host_map, h->id))
 				continue;
 
-			/* expand services and add them all, unless they're rejected */
+			/*
+			 * expand services and add them all, unless they're rejected.
+			 * listed_services stays marked for everything on *ret, so
+			 * only services we don't have yet end up on slist
+			 */
 			slist = NULL;
-			if(xodtemplate_expand_services(&slist, reject_map, h->host_name, service_description, _config_file, _start_line) != OK) {
+			if(_xodtemplate_expand_services(&slist, reject_map, h->host_name, service_description, _config_file, _start_line) != OK) {
+				free_objectlist(&slist);
 				free_objectlist(&gnext);
-				bitmap_destroy(in);
+				free_objectlist(&fake_hg.member_list);
 				return ERROR;
 			}
 			for(list = slist; list; list = next) {
 				xodtemplate_service *s = (xodtemplate_service *)list->object_ptr;
 				next = list->next;
-				free(list);
-				if(bitmap_isset(in, s->id) || bitmap_isset(reject_map, s->id))
+				if(bitmap_isset(reject_map, s->id)) {
+					bitmap_unset(listed_services, s->id);
+					free(list);
 					continue;
-				bitmap_set(in, s->id);
-				if(prepend_object_to_objectlist(ret, s) != OK) {
-					free_objectlist(&next);
-					free_objectlist(&gnext);
-					free_objectlist(&fake_hg.member_list);
-					bitmap_destroy(in);
-					return ERROR;
 				}
+				list->next = *ret;
+				*ret = list;
 			}
 		}
 	}
 
-	bitmap_destroy(in);
 	free_objectlist(&fake_hg.member_list);
 	return OK;
 }
 
+/*
+ * Services stay marked in listed_services while the list is being
+ * built, so each service costs a single bit test however many hosts
+ * and groups it's reached through. The marks are taken off again
+ * when we're done.
+ */
+static int xodtemplate_create_service_list(objectlist **ret, bitmap *reject_map, char *host_name, char *hostgroup_name, char *servicegroup_name, char *service_description, int _config_file, int _start_line)
+{
+	int result;
+
+	xodtemplate_mark_listed(listed_services, *ret, TRUE);
+	result = _xodtemplate_create_service_list(ret, reject_map, host_name, hostgroup_name, servicegroup_name, service_description, _config_file, _start_line);
+	if(result == OK)
+		xodtemplate_mark_listed(listed_services, *ret, FALSE);
+	else
+		bitmap_clear(listed_services);
+
+	return result;
+}
+
 /* duplicates object definitions */
 int xodtemplate_duplicate_objects(void) {
 	int result = OK;
@@ -5034,22 +5600,156 @@ static int xodtemplate_register_and_destroy_servicedependency(void *sd_)
 }
 
 
-/* resolves object definitions */
-int xodtemplate_resolve_objects(void) {
-	xodtemplate_timeperiod *temp_timeperiod = NULL;
-	xodtemplate_command *temp_command = NULL;
-	xodtemplate_contactgroup *temp_contactgroup = NULL;
-	xodtemplate_hostgroup *temp_hostgroup = NULL;
-	xodtemplate_servicegroup *temp_servicegroup = NULL;
-	xodtemplate_servicedependency *temp_servicedependency = NULL;
-	xodtemplate_serviceescalation *temp_serviceescalation = NULL;
-	xodtemplate_contact *temp_contact = NULL;
-	xodtemplate_host *temp_host = NULL;
+#ifdef NSCORE
+/* checks the templates of an object type, remembering the last list that was fine */
+#define xod_check_templates(type) \
+	do { \
+		xodtemplate_##type *o = NULL; \
+		char *last = NULL, *names = NULL, *ptr = NULL, *name = NULL; \
+		for(o = xodtemplate_##type##_list; o != NULL; o = o->next) { \
+			if(o->template == NULL || (last != NULL && !strcmp(o->template, last))) \
+				continue; \
+			if((names = (char *)strdup(o->template)) == NULL) \
+				return FALSE; \
+			ptr = names; \
+			for(name = my_strsep(&ptr, ","); name != NULL; name = my_strsep(&ptr, ",")) { \
+				if(xodtemplate_find_##type(name) == NULL) \
+					break; \
+				} \
+			my_free(names); \
+			if(name != NULL) \
+				return FALSE; \
+			last = o->template; \
+			} \
+	} while(0)
+
+/*
+ * hosts and services can only be resolved in threads when there's
+ * no error to log, since the first one found has to be the one
+ * logged. Missing templates are the only errors there can be.
+ */
+static int xodtemplate_templates_exist(void) {
+
+	xod_check_templates(host);
+	xod_check_templates(service);
+
+	return TRUE;
+	}
+#undef xod_check_templates
+
+
+/* resolves chunks of the hosts and services that aren't templates */
+static void *xodtemplate_resolve_thread(void *discard) {
+	unsigned int x = 0, end = 0, total = num_resolve_hosts + num_resolve_services;
+	int result = OK;
+
+	while(1) {
+		pthread_mutex_lock(&parse_lock);
+		x = next_resolve;
+		next_resolve += 256;
+		pthread_mutex_unlock(&parse_lock);
+		if(x >= total)
+			break;
+
+		for(end = (x + 256 < total) ? x + 256 : total; x < end; x++) {
+			if(x < num_resolve_hosts)
+				result = xodtemplate_resolve_host(resolve_hosts[x]);
+			else
+				result = xodtemplate_resolve_service(resolve_services[x - num_resolve_hosts]);
+			if(result == ERROR) {
+				pthread_mutex_lock(&parse_lock);
+				resolve_result = ERROR;
+				pthread_mutex_unlock(&parse_lock);
+				}
+			}
+		}
+
+	return NULL;
+	}
+
+
+/*
+ * resolves the hosts and services that were skipped by
+ * xodtemplate_resolve_objects(). Their templates have all been
+ * resolved already, and they only change themselves.
+ */
+static int xodtemplate_resolve_in_threads(void) {
+	xodtemplate_host *temp_host = NULL;
+	xodtemplate_service *temp_service = NULL;
+	pthread_t *tids = NULL;
+	int x = 0, threads = 0;
+
+	for(temp_host = xodtemplate_host_list; temp_host != NULL; temp_host = temp_host->next)
+		num_resolve_hosts += (temp_host->has_been_resolved == FALSE);
+	for(temp_service = xodtemplate_service_list; temp_service != NULL; temp_service = temp_service->next)
+		num_resolve_services += (temp_service->has_been_resolved == FALSE);
+
+	resolve_hosts = (xodtemplate_host **)malloc(sizeof(*resolve_hosts) * (num_resolve_hosts + 1));
+	resolve_services = (xodtemplate_service **)malloc(sizeof(*resolve_services) * (num_resolve_services + 1));
+	if(resolve_hosts == NULL || resolve_services == NULL) {
+		my_free(resolve_hosts);
+		my_free(resolve_services);
+		return ERROR;
+		}
+
+	num_resolve_hosts = num_resolve_services = 0;
+	for(temp_host = xodtemplate_host_list; temp_host != NULL; temp_host = temp_host->next) {
+		if(temp_host->has_been_resolved == FALSE)
+			resolve_hosts[num_resolve_hosts++] = temp_host;
+		}
+	for(temp_service = xodtemplate_service_list; temp_service != NULL; temp_service = temp_service->next) {
+		if(temp_service->has_been_resolved == FALSE)
+			resolve_services[num_resolve_services++] = temp_service;
+		}
+
+	next_resolve = 0;
+	resolve_result = OK;
+
+	/* the main thread does its share of the work too */
+	if((tids = (pthread_t *)calloc(parse_threads, sizeof(pthread_t))) != NULL) {
+		for(x = 0; x < parse_threads - 1; x++) {
+			if(pthread_create(&tids[threads], NULL, xodtemplate_resolve_thread, NULL))
+				break;
+			threads++;
+			}
+		}
+	xodtemplate_resolve_thread(NULL);
+	for(x = 0; x < threads; x++)
+		pthread_join(tids[x], NULL);
+
+	my_free(tids);
+	my_free(resolve_hosts);
+	my_free(resolve_services);
+	num_resolve_hosts = num_resolve_services = 0;
+
+	return resolve_result;
+	}
+#endif
+
+
+/* resolves object definitions */
+int xodtemplate_resolve_objects(void) {
+	xodtemplate_timeperiod *temp_timeperiod = NULL;
+	xodtemplate_command *temp_command = NULL;
+	xodtemplate_contactgroup *temp_contactgroup = NULL;
+	xodtemplate_hostgroup *temp_hostgroup = NULL;
+	xodtemplate_servicegroup *temp_servicegroup = NULL;
+	xodtemplate_servicedependency *temp_servicedependency = NULL;
+	xodtemplate_serviceescalation *temp_serviceescalation = NULL;
+	xodtemplate_contact *temp_contact = NULL;
+	xodtemplate_host *temp_host = NULL;
 	xodtemplate_service *temp_service = NULL;
 	xodtemplate_hostdependency *temp_hostdependency = NULL;
 	xodtemplate_hostescalation *temp_hostescalation = NULL;
 	xodtemplate_hostextinfo *temp_hostextinfo = NULL;
 	xodtemplate_serviceextinfo *temp_serviceextinfo = NULL;
+	int skip_plain_objects = FALSE;
+
+#ifdef NSCORE
+	/* hosts and services that aren't templates may be left to worker threads */
+	if(parse_threads > 1)
+		skip_plain_objects = xodtemplate_templates_exist();
+#endif
 
 	/* resolve all timeperiod objects */
 	for(temp_timeperiod = xodtemplate_timeperiod_list; temp_timeperiod != NULL; temp_timeperiod = temp_timeperiod->next) {
@@ -5101,12 +5801,16 @@ int xodtemplate_resolve_objects(void) {
 
 	/* resolve all host objects */
 	for(temp_host = xodtemplate_host_list; temp_host != NULL; temp_host = temp_host->next) {
+		if(skip_plain_objects == TRUE && temp_host->name == NULL)
+			continue;
 		if(xodtemplate_resolve_host(temp_host) == ERROR)
 			return ERROR;
 		}
 
 	/* resolve all service objects */
 	for(temp_service = xodtemplate_service_list; temp_service != NULL; temp_service = temp_service->next) {
+		if(skip_plain_objects == TRUE && temp_service->name == NULL)
+			continue;
 		if(xodtemplate_resolve_service(temp_service) == ERROR)
 			return ERROR;
 		}
@@ -5135,6 +5839,11 @@ int xodtemplate_resolve_objects(void) {
 			return ERROR;
 		}
 
+#ifdef NSCORE
+	if(skip_plain_objects == TRUE)
+		return xodtemplate_resolve_in_threads();
+#endif
+
 	return OK;
 	}
 
@@ -5667,14 +6376,265 @@ int xodtemplate_resolve_contact(xodtemplate_contact *this_contact) {
 
 
 
+/*
+ * The same "use" directive tends to be repeated verbatim by thousands
+ * of hosts and services, so we look up the templates it names and
+ * merge their custom variables only once for each distinct one.
+ * Templates are fully resolved before they're added here, so an
+ * object only has to copy what it's missing.
+ */
+typedef struct xodtemplate_use_struct {
+	char *use;
+	void **templates;
+	xodtemplate_customvariablesmember *custom_variables;
+	int cached;
+	int missing_template;
+	} xodtemplate_use;
+
+static dkhash_table *xodtemplate_use_cache = NULL;
+
+/*
+ * how many templates this thread is in the middle of resolving. With
+ * circular "use" directives, a template may still be incomplete when
+ * it's used, so nothing built then may be cached.
+ */
+static __thread int xodtemplate_use_depth = 0;
+
+static int xodtemplate_free_use(void *data) {
+	xodtemplate_use *use = (xodtemplate_use *)data;
+	xodtemplate_customvariablesmember *cv, *next_cv;
+
+	/* the variables point to the templates' strings */
+	for(cv = use->custom_variables; cv != NULL; cv = next_cv) {
+		next_cv = cv->next;
+		my_free(cv);
+		}
+	my_free(use->templates);
+	my_free(use->use);
+	my_free(use);
+
+	return DKHASH_WALK_REMOVE;
+	}
+
+static void xodtemplate_free_use_cache(void) {
+	if(xodtemplate_use_cache == NULL)
+		return;
+	dkhash_walk_data(xodtemplate_use_cache, xodtemplate_free_use);
+	dkhash_destroy(xodtemplate_use_cache);
+	xodtemplate_use_cache = NULL;
+	}
+
+static xodtemplate_use *xodtemplate_create_use(const char *use_str) {
+	xodtemplate_use *use;
+	const char *p;
+	int n = 2;
+
+	for(p = use_str; *p; p++)
+		n += (*p == ',');
+
+	if((use = (xodtemplate_use *)calloc(1, sizeof(*use))) == NULL)
+		return NULL;
+	use->use = (char *)strdup(use_str);
+	use->templates = (void **)calloc(n, sizeof(void *));
+	if(use->use == NULL || use->templates == NULL) {
+		xodtemplate_free_use(use);
+		return NULL;
+		}
+
+	return use;
+	}
+
+/* adds the template's custom variables to the ones already merged, unless they're overridden */
+static int xodtemplate_merge_use_variables(xodtemplate_use *use, xodtemplate_customvariablesmember *template_vars) {
+	xodtemplate_customvariablesmember *cv, *temp_cv, **tail;
+
+	for(tail = &use->custom_variables; *tail != NULL; tail = &(*tail)->next)
+		;
+
+	for(temp_cv = template_vars; temp_cv != NULL; temp_cv = temp_cv->next) {
+		for(cv = use->custom_variables; cv != NULL; cv = cv->next) {
+			if(!strcmp(temp_cv->variable_name, cv->variable_name))
+				break;
+			}
+		if(cv != NULL)
+			continue;
+
+		if((cv = (xodtemplate_customvariablesmember *)malloc(sizeof(*cv))) == NULL)
+			return ERROR;
+		cv->variable_name = temp_cv->variable_name;
+		cv->variable_value = temp_cv->variable_value;
+		cv->next = NULL;
+		*tail = cv;
+		tail = &cv->next;
+		}
+
+	return OK;
+	}
+
+/* caches a fully built use entry, unless another thread beat us to it */
+static xodtemplate_use *xodtemplate_cache_use(const char *type, xodtemplate_use *use) {
+	xodtemplate_use *old;
+
+	/* the caller frees this one when it's done with it */
+	if(xodtemplate_use_depth > 0 || use->missing_template == TRUE)
+		return use;
+
+#ifdef NSCORE
+	pthread_mutex_lock(&parse_lock);
+#endif
+	if(xodtemplate_use_cache == NULL)
+		xodtemplate_use_cache = dkhash_create(1024);
+	if((old = (xodtemplate_use *)dkhash_get(xodtemplate_use_cache, type, use->use)) == NULL) {
+		if(xodtemplate_use_cache != NULL && dkhash_insert(xodtemplate_use_cache, type, use->use, use) == DKHASH_OK) {
+			use->cached = TRUE;
+			old = use;
+			use = NULL;
+			}
+		}
+#ifdef NSCORE
+	pthread_mutex_unlock(&parse_lock);
+#endif
+
+	/* freed outside the lock, since someone else's copy is in use */
+	if(use != NULL)
+		xodtemplate_free_use(use);
+
+	return old;
+	}
+
+static xodtemplate_use *xodtemplate_find_use(const char *type, const char *use_str) {
+	xodtemplate_use *use = NULL;
+
+#ifdef NSCORE
+	pthread_mutex_lock(&parse_lock);
+#endif
+	if(xodtemplate_use_cache != NULL)
+		use = (xodtemplate_use *)dkhash_get(xodtemplate_use_cache, type, use_str);
+#ifdef NSCORE
+	pthread_mutex_unlock(&parse_lock);
+#endif
+
+	return use;
+	}
+
+/* adds the merged custom variables of the templates that an object doesn't have itself */
+static int xodtemplate_inherit_use_variables(xodtemplate_customvariablesmember **object_vars, xodtemplate_use *use) {
+	xodtemplate_customvariablesmember *own_vars = *object_vars;
+	xodtemplate_customvariablesmember *cv, *temp_cv;
+
+	for(temp_cv = use->custom_variables; temp_cv != NULL; temp_cv = temp_cv->next) {
+
+		/* see if this object has a variable by the same name */
+		for(cv = own_vars; cv != NULL; cv = cv->next) {
+			if(!strcmp(temp_cv->variable_name, cv->variable_name))
+				break;
+			}
+
+		/* we didn't find the same variable name, so add a new custom variable */
+		if(cv == NULL && xodtemplate_add_custom_variable_to_object(object_vars, temp_cv->variable_name, temp_cv->variable_value) == NULL)
+			return ERROR;
+		}
+
+	return OK;
+	}
+
+/* returns the resolved templates named by a host's "use" directive */
+static xodtemplate_use *xodtemplate_get_host_use(xodtemplate_host *this_host) {
+	xodtemplate_use *use;
+	xodtemplate_host *template_host;
+	char *template_names, *template_name_ptr, *temp_ptr;
+	int x = 0;
+
+	if((use = xodtemplate_find_use("host", this_host->template)) != NULL)
+		return use;
+
+	if((use = xodtemplate_create_use(this_host->template)) == NULL)
+		return NULL;
+	if((template_names = (char *)strdup(this_host->template)) == NULL) {
+		xodtemplate_free_use(use);
+		return NULL;
+		}
+
+	template_name_ptr = template_names;
+	for(temp_ptr = my_strsep(&template_name_ptr, ","); temp_ptr != NULL; temp_ptr = my_strsep(&template_name_ptr, ",")) {
+
+		template_host = xodtemplate_find_host(temp_ptr);
+		if(template_host == NULL) {
+			logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Template '%s' specified in host definition could not be not found (config file '%s', starting on line %d)\n", temp_ptr, xodtemplate_config_file_name(this_host->_config_file), this_host->_start_line);
+			/* the templates before it still get applied */
+			use->missing_template = TRUE;
+			break;
+			}
+
+		/* resolve the template host... */
+		xodtemplate_use_depth++;
+		xodtemplate_resolve_host(template_host);
+		xodtemplate_use_depth--;
+
+		use->templates[x++] = template_host;
+		if(xodtemplate_merge_use_variables(use, template_host->custom_variables) == ERROR) {
+			my_free(template_names);
+			xodtemplate_free_use(use);
+			return NULL;
+			}
+		}
+	my_free(template_names);
+
+	return xodtemplate_cache_use("host", use);
+	}
+
+/* returns the resolved templates named by a service's "use" directive */
+static xodtemplate_use *xodtemplate_get_service_use(xodtemplate_service *this_service) {
+	xodtemplate_use *use;
+	xodtemplate_service *template_service;
+	char *template_names, *template_name_ptr, *temp_ptr;
+	int x = 0;
+
+	if((use = xodtemplate_find_use("service", this_service->template)) != NULL)
+		return use;
+
+	if((use = xodtemplate_create_use(this_service->template)) == NULL)
+		return NULL;
+	if((template_names = (char *)strdup(this_service->template)) == NULL) {
+		xodtemplate_free_use(use);
+		return NULL;
+		}
+
+	template_name_ptr = template_names;
+	for(temp_ptr = my_strsep(&template_name_ptr, ","); temp_ptr != NULL; temp_ptr = my_strsep(&template_name_ptr, ",")) {
+
+		template_service = xodtemplate_find_service(temp_ptr);
+		if(template_service == NULL) {
+			logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Template '%s' specified in service definition could not be not found (config file '%s', starting on line %d)\n", temp_ptr, xodtemplate_config_file_name(this_service->_config_file), this_service->_start_line);
+			/* the templates before it still get applied */
+			use->missing_template = TRUE;
+			break;
+			}
+
+		/* resolve the template service... */
+		xodtemplate_use_depth++;
+		xodtemplate_resolve_service(template_service);
+		xodtemplate_use_depth--;
+
+		use->templates[x++] = template_service;
+		if(xodtemplate_merge_use_variables(use, template_service->custom_variables) == ERROR) {
+			my_free(template_names);
+			xodtemplate_free_use(use);
+			return NULL;
+			}
+		}
+	my_free(template_names);
+
+	return xodtemplate_cache_use("service", use);
+	}
+
+
 /* resolves a host object */
 int xodtemplate_resolve_host(xodtemplate_host *this_host) {
-	char *temp_ptr = NULL;
-	char *template_names = NULL;
-	char *template_name_ptr = NULL;
+	xodtemplate_use *use = NULL;
 	xodtemplate_host *template_host = NULL;
-	xodtemplate_customvariablesmember *this_customvariablesmember = NULL;
-	xodtemplate_customvariablesmember *temp_customvariablesmember = NULL;
+	int result = OK;
+	int x;
 
 	/* return if this host has already been resolved */
 	if(this_host->has_been_resolved == TRUE)
@@ -5687,22 +6647,12 @@ int xodtemplate_resolve_host(xodtemplate_host *this_host) {
 	if(this_host->template == NULL)
 		return OK;
 
-	if((template_names = (char *)strdup(this_host->template)) == NULL)
+	if((use = xodtemplate_get_host_use(this_host)) == NULL)
 		return ERROR;
 
 	/* apply all templates */
-	template_name_ptr = template_names;
-	for(temp_ptr = my_strsep(&template_name_ptr, ","); temp_ptr != NULL; temp_ptr = my_strsep(&template_name_ptr, ",")) {
-
-		template_host = xodtemplate_find_host(temp_ptr);
-		if(template_host == NULL) {
-			logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Template '%s' specified in host definition could not be not found (config file '%s', starting on line %d)\n", temp_ptr, xodtemplate_config_file_name(this_host->_config_file), this_host->_start_line);
-			my_free(template_names);
-			return ERROR;
-			}
-
-		/* resolve the template host... */
-		xodtemplate_resolve_host(template_host);
+	for(x = 0; use->templates[x] != NULL; x++) {
+		template_host = (xodtemplate_host *)use->templates[x];
 
 		/* apply missing properties from template host... */
 		xod_inherit_str_nohave(this_host, template_host, host_name);
@@ -5764,37 +6714,27 @@ int xodtemplate_resolve_host(xodtemplate_host *this_host) {
 
 		xod_inherit(this_host, template_host, retain_status_information);
 		xod_inherit(this_host, template_host, retain_nonstatus_information);
-
-		/* apply missing custom variables from template host... */
-		for(temp_customvariablesmember = template_host->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-
-			/* see if this host has a variable by the same name */
-			for(this_customvariablesmember = this_host->custom_variables; this_customvariablesmember != NULL; this_customvariablesmember = this_customvariablesmember->next) {
-				if(!strcmp(temp_customvariablesmember->variable_name, this_customvariablesmember->variable_name))
-					break;
-				}
-
-			/* we didn't find the same variable name, so add a new custom variable */
-			if(this_customvariablesmember == NULL)
-				xodtemplate_add_custom_variable_to_host(this_host, temp_customvariablesmember->variable_name, temp_customvariablesmember->variable_value);
-			}
 		}
 
-	my_free(template_names);
+	/* apply missing custom variables from template hosts... */
+	result = xodtemplate_inherit_use_variables(&this_host->custom_variables, use);
+	if(use->missing_template == TRUE)
+		result = ERROR;
 
-	return OK;
+	if(use->cached == FALSE)
+		xodtemplate_free_use(use);
+
+	return result;
 	}
 
 
 
 /* resolves a service object */
 int xodtemplate_resolve_service(xodtemplate_service *this_service) {
-	char *temp_ptr = NULL;
-	char *template_names = NULL;
-	char *template_name_ptr = NULL;
+	xodtemplate_use *use = NULL;
 	xodtemplate_service *template_service = NULL;
-	xodtemplate_customvariablesmember *this_customvariablesmember = NULL;
-	xodtemplate_customvariablesmember *temp_customvariablesmember = NULL;
+	int result = OK;
+	int x;
 
 	/* return if this service has already been resolved */
 	if(this_service->has_been_resolved == TRUE)
@@ -5807,22 +6747,12 @@ int xodtemplate_resolve_service(xodtemplate_service *this_service) {
 	if(this_service->template == NULL)
 		return OK;
 
-	if((template_names = (char *)strdup(this_service->template)) == NULL)
+	if((use = xodtemplate_get_service_use(this_service)) == NULL)
 		return ERROR;
 
 	/* apply all templates */
-	template_name_ptr = template_names;
-	for(temp_ptr = my_strsep(&template_name_ptr, ","); temp_ptr != NULL; temp_ptr = my_strsep(&template_name_ptr, ",")) {
-
-		template_service = xodtemplate_find_service(temp_ptr);
-		if(template_service == NULL) {
-			logit(NSLOG_CONFIG_ERROR, TRUE, "Error: Template '%s' specified in service definition could not be not found (config file '%s', starting on line %d)\n", temp_ptr, xodtemplate_config_file_name(this_service->_config_file), this_service->_start_line);
-			my_free(template_names);
-			return ERROR;
-			}
-
-		/* resolve the template service... */
-		xodtemplate_resolve_service(template_service);
+	for(x = 0; use->templates[x] != NULL; x++) {
+		template_service = (xodtemplate_service *)use->templates[x];
 
 		/* apply missing properties from template service... */
 		xod_inherit_str(this_service, template_service, service_description);
@@ -5877,25 +6807,17 @@ int xodtemplate_resolve_service(xodtemplate_service *this_service) {
 		xod_inherit(this_service, template_service, retain_status_information);
 		xod_inherit(this_service, template_service, retain_nonstatus_information);
 		xod_inherit(this_service, template_service, hourly_value);
-
-		/* apply missing custom variables from template service... */
-		for(temp_customvariablesmember = template_service->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-
-			/* see if this host has a variable by the same name */
-			for(this_customvariablesmember = this_service->custom_variables; this_customvariablesmember != NULL; this_customvariablesmember = this_customvariablesmember->next) {
-				if(!strcmp(temp_customvariablesmember->variable_name, this_customvariablesmember->variable_name))
-					break;
-				}
-
-			/* we didn't find the same variable name, so add a new custom variable */
-			if(this_customvariablesmember == NULL)
-				xodtemplate_add_custom_variable_to_service(this_service, temp_customvariablesmember->variable_name, temp_customvariablesmember->variable_value);
-			}
 		}
 
-	my_free(template_names);
+	/* apply missing custom variables from template services... */
+	result = xodtemplate_inherit_use_variables(&this_service->custom_variables, use);
+	if(use->missing_template == TRUE)
+		result = ERROR;
 
-	return OK;
+	if(use->cached == FALSE)
+		xodtemplate_free_use(use);
+
+	return result;
 	}
 
 
@@ -6995,6 +7917,42 @@ static int xodtemplate_register_contactgroup_members(xodtemplate_contactgroup *t
 	return num_regs;
 }
 
+/*
+ * add_host_to_hostgroup() and add_service_to_servicegroup() keep their
+ * member lists sorted by insertion, which is quadratic when they're fed
+ * large groups in no particular order. Handing them the members in
+ * reverse order once sorted means every insertion lands at the head.
+ */
+static int xodtemplate_compare_hostgroup_members(const void *a, const void *b) {
+	return xodtemplate_skiplist_compare_host((*(objectlist **)b)->object_ptr, (*(objectlist **)a)->object_ptr);
+	}
+
+static int xodtemplate_compare_servicegroup_members(const void *a, const void *b) {
+	return xodtemplate_skiplist_compare_service((*(objectlist **)b)->object_ptr, (*(objectlist **)a)->object_ptr);
+	}
+
+static void xodtemplate_sort_members(objectlist **members, int (*cmp)(const void *, const void *)) {
+	objectlist *list, **ary;
+	unsigned int i, num = 0;
+
+	for(list = *members; list; list = list->next)
+		num++;
+	if(num < 2)
+		return;
+
+	/* an unsorted list is slow to register, but still correct */
+	if(!(ary = malloc(num * sizeof(*ary))))
+		return;
+	for(i = 0, list = *members; list; list = list->next)
+		ary[i++] = list;
+	qsort(ary, num, sizeof(*ary), cmp);
+	for(i = 0; i < num - 1; i++)
+		ary[i]->next = ary[i + 1];
+	ary[num - 1]->next = NULL;
+	*members = ary[0];
+	free(ary);
+	}
+
 static int xodtemplate_register_hostgroup_members(xodtemplate_hostgroup *this_hostgroup)
 {
 	objectlist *list;
@@ -7005,6 +7963,7 @@ static int xodtemplate_register_hostgroup_members(xodtemplate_hostgroup *this_ho
 		return 0;
 
 	hg = find_hostgroup(this_hostgroup->hostgroup_name);
+	xodtemplate_sort_members(&this_hostgroup->member_list, xodtemplate_compare_hostgroup_members);
 	for(list = this_hostgroup->member_list; list; list = list->next) {
 		xodtemplate_host *h = (xodtemplate_host *)list->object_ptr;
 		if (!add_host_to_hostgroup(hg, h->host_name)) {
@@ -7026,6 +7985,7 @@ static int xodtemplate_register_servicegroup_members(xodtemplate_servicegroup *t
 		return 0;
 
 	sg = find_servicegroup(this_servicegroup->servicegroup_name);
+	xodtemplate_sort_members(&this_servicegroup->member_list, xodtemplate_compare_servicegroup_members);
 	for(list = this_servicegroup->member_list; list; list = next) {
 		xodtemplate_service *s = (xodtemplate_service *)list->object_ptr;
 		next = list->next;
@@ -8147,6 +9107,15 @@ int xodtemplate_merge_host_extinfo_object(xodtemplate_host *this_host, xodtempla
 /******************************************************************/
 
 int xodtemplate_init_xobject_skiplists(void) {
+
+	xodtemplate_create_skiplists(xobject_template_skiplists, xobject_skiplists);
+
+	return OK;
+	}
+
+
+/* creates a set of template and object skiplists */
+static void xodtemplate_create_skiplists(skiplist **xobject_template_skiplists, skiplist **xobject_skiplists) {
 	int x = 0;
 
 	for(x = 0; x < NUM_XOBJECT_SKIPLISTS; x++) {
@@ -8181,7 +9150,6 @@ int xodtemplate_init_xobject_skiplists(void) {
 	 * host and service extinfo, dependencies, and escalations don't
 	 * need to be sorted, so we avoid creating skiplists for them.
 	 */
-	return OK;
 	}
 
 
@@ -8952,6 +9920,9 @@ int xodtemplate_free_memory(void) {
 
 	/* free skiplists */
 	xodtemplate_free_xobject_skiplists();
+#ifndef NSCGI
+	xodtemplate_free_use_cache();
+#endif
 
 	return OK;
 	}
@@ -9068,8 +10039,43 @@ void xodtemplate_remove_memberlist_item(xodtemplate_memberlist *item, xodtemplat
 /******************************************************************/
 
 
+/*
+ * The expansion functions below used to rely on the duplicate check in
+ * add_object_to_objectlist(), which walks the entire list for every
+ * object it adds and made expanding large groups quadratic. Instead we
+ * mark the objects on the list being built in a map of their own. No
+ * other bits are ever set in that map, so walking the finished list
+ * clears it again in time proportional to what we expanded.
+ * The same cast trick as in _xodtemplate_add_group_member() applies.
+ */
+static void xodtemplate_mark_listed(bitmap *listed, objectlist *list, int set) {
+	xodtemplate_host *h;
+
+	for(; list; list = list->next) {
+		h = (xodtemplate_host *)list->object_ptr;
+		if(set == TRUE)
+			bitmap_set(listed, h->id);
+		else if(bitmap_isset(listed, h->id))
+			bitmap_unset(listed, h->id);
+		}
+	}
+
+static int xodtemplate_add_listed(objectlist **list, bitmap *listed, void *obj) {
+	xodtemplate_host *h = (xodtemplate_host *)obj;
+
+	/* expanding before the maps exist, so fall back to a linear scan */
+	if(listed == NULL)
+		return add_object_to_objectlist(list, obj);
+
+	if(bitmap_isset(listed, h->id))
+		return OK;
+	bitmap_set(listed, h->id);
+	return prepend_object_to_objectlist(list, obj);
+	}
+
+
 /* expands contacts */
-int xodtemplate_expand_contacts(objectlist **ret, bitmap *reject_map, char *contacts, int _config_file, int _start_line) {
+static int _xodtemplate_expand_contacts(objectlist **ret, bitmap *reject_map, char *contacts, int _config_file, int _start_line) {
 	char *contact_names = NULL;
 	char *temp_ptr = NULL;
 	xodtemplate_contact *temp_contact = NULL;
@@ -9078,11 +10084,6 @@ int xodtemplate_expand_contacts(objectlist **ret, bitmap *reject_map, char *cont
 	int reject_item = FALSE;
 	int use_regexp = FALSE;
 
-	if(ret == NULL || contacts == NULL)
-		return ERROR;
-
-	*ret = NULL;
-
 	if((contact_names = (char *)strdup(contacts)) == NULL)
 		return ERROR;
 
@@ -9125,7 +10126,7 @@ int xodtemplate_expand_contacts(objectlist **ret, bitmap *reject_map, char *cont
 					continue;
 
 				/* add contact to list */
-				add_object_to_objectlist(ret, temp_contact);
+				xodtemplate_add_listed(ret, listed_contacts, temp_contact);
 				}
 
 			/* free memory allocated to compiled regexp */
@@ -9150,7 +10151,7 @@ int xodtemplate_expand_contacts(objectlist **ret, bitmap *reject_map, char *cont
 						continue;
 
 					/* add contact to list */
-					add_object_to_objectlist(ret, temp_contact);
+					xodtemplate_add_listed(ret, listed_contacts, temp_contact);
 					}
 				}
 
@@ -9174,7 +10175,7 @@ int xodtemplate_expand_contacts(objectlist **ret, bitmap *reject_map, char *cont
 						bitmap_set(reject_map, temp_contact->id);
 						}
 					else {
-						add_object_to_objectlist(ret, temp_contact);
+						xodtemplate_add_listed(ret, listed_contacts, temp_contact);
 						}
 					}
 				}
@@ -9195,6 +10196,20 @@ int xodtemplate_expand_contacts(objectlist **ret, bitmap *reject_map, char *cont
 	return OK;
 	}
 
+int xodtemplate_expand_contacts(objectlist **ret, bitmap *reject_map, char *contacts, int _config_file, int _start_line) {
+	int result;
+
+	if(ret == NULL || contacts == NULL)
+		return ERROR;
+
+	*ret = NULL;
+
+	result = _xodtemplate_expand_contacts(ret, reject_map, contacts, _config_file, _start_line);
+	xodtemplate_mark_listed(listed_contacts, *ret, FALSE);
+
+	return result;
+	}
+
 
 #ifdef NSCORE
 
@@ -9228,6 +10243,10 @@ objectlist *xodtemplate_expand_hostgroups_and_hosts(char *hostgroups, char *host
 			}
 		}
 
+	/* hosts already on the list mustn't be added again either */
+	for(list = ret; list; list = list->next)
+		bitmap_set(reject, ((xodtemplate_host *)list->object_ptr)->id);
+
 	/* process list of hostgroups... */
 	if(hostgroups != NULL) {
 		/* expand host */
@@ -9252,7 +10271,8 @@ objectlist *xodtemplate_expand_hostgroups_and_hosts(char *hostgroups, char *host
 			xodtemplate_host *h = (xodtemplate_host *)hlist->object_ptr;
 			if(bitmap_isset(reject, h->id))
 				continue;
-			add_object_to_objectlist(&ret, h);
+			bitmap_set(reject, h->id);
+			prepend_object_to_objectlist(&ret, h);
 		}
 	}
 	bitmap_destroy(reject);
@@ -9396,7 +10416,7 @@ int xodtemplate_expand_hostgroups(objectlist **list, bitmap *reject_map, char *h
 
 
 /* expands hosts */
-int xodtemplate_expand_hosts(objectlist **list, bitmap *reject_map, char *hosts, int _config_file, int _start_line) {
+static int _xodtemplate_expand_hosts(objectlist **list, bitmap *reject_map, char *hosts, int _config_file, int _start_line) {
 	char *temp_ptr = NULL;
 	xodtemplate_host *temp_host = NULL;
 	regex_t preg;
@@ -9404,9 +10424,6 @@ int xodtemplate_expand_hosts(objectlist **list, bitmap *reject_map, char *hosts,
 	int reject_item = FALSE;
 	int use_regexp = FALSE;
 
-	if(list == NULL || hosts == NULL)
-		return ERROR;
-
 	/* expand each host name */
 	for(temp_ptr = strtok(hosts, ","); temp_ptr; temp_ptr = strtok(NULL, ",")) {
 
@@ -9445,7 +10462,7 @@ int xodtemplate_expand_hosts(objectlist **list, bitmap *reject_map, char *hosts,
 					continue;
 
 				/* add host to list */
-				add_object_to_objectlist(list, temp_host);
+				xodtemplate_add_listed(list, listed_hosts, temp_host);
 				}
 
 			/* free memory allocated to compiled regexp */
@@ -9470,7 +10487,7 @@ int xodtemplate_expand_hosts(objectlist **list, bitmap *reject_map, char *hosts,
 						continue;
 
 					/* add host to list */
-					add_object_to_objectlist(list, temp_host);
+					xodtemplate_add_listed(list, listed_hosts, temp_host);
 					}
 				}
 
@@ -9491,7 +10508,7 @@ int xodtemplate_expand_hosts(objectlist **list, bitmap *reject_map, char *hosts,
 
 					/* add host to list */
 					if(!reject_item) {
-						add_object_to_objectlist(list, temp_host);
+						xodtemplate_add_listed(list, listed_hosts, temp_host);
 						}
 					else {
 						bitmap_set(reject_map, temp_host->id);
@@ -9512,6 +10529,19 @@ int xodtemplate_expand_hosts(objectlist **list, bitmap *reject_map, char *hosts,
 	return OK;
 	}
 
+int xodtemplate_expand_hosts(objectlist **list, bitmap *reject_map, char *hosts, int _config_file, int _start_line) {
+	int result;
+
+	if(list == NULL || hosts == NULL)
+		return ERROR;
+
+	xodtemplate_mark_listed(listed_hosts, *list, TRUE);
+	result = _xodtemplate_expand_hosts(list, reject_map, hosts, _config_file, _start_line);
+	xodtemplate_mark_listed(listed_hosts, *list, FALSE);
+
+	return result;
+	}
+
 
 /*
  * expands servicegroups.
@@ -9644,7 +10674,7 @@ int xodtemplate_expand_servicegroups(objectlist **list, bitmap *reject, char *se
 	}
 
 /* expands services (host name is not expanded) */
-int xodtemplate_expand_services(objectlist **list, bitmap *reject_map, char *host_name, char *services, int _config_file, int _start_line) {
+static int _xodtemplate_expand_services(objectlist **list, bitmap *reject_map, char *host_name, char *services, int _config_file, int _start_line) {
 	char *service_names = NULL;
 	char *temp_ptr = NULL;
 	xodtemplate_service *temp_service = NULL;
@@ -9657,9 +10687,6 @@ int xodtemplate_expand_services(objectlist **list, bitmap *reject_map, char *hos
 	int found_match = TRUE;
 	int reject_item = FALSE;
 
-	if(list == NULL)
-		return ERROR;
-
 	/*
 	 * One-step recursion for convenience.
 	 * Useful for servicegroups' "members" directive
@@ -9689,7 +10716,7 @@ int xodtemplate_expand_services(objectlist **list, bitmap *reject_map, char *hos
 			strip(p2);
 
 			/* now we have arguments we can handle safely, so do that */
-			if(xodtemplate_expand_services(list, reject_map, p1, p2, _config_file, _start_line) != OK) {
+			if(_xodtemplate_expand_services(list, reject_map, p1, p2, _config_file, _start_line) != OK) {
 				free(scopy);
 				return ERROR;
 				}
@@ -9781,7 +10808,7 @@ int xodtemplate_expand_services(objectlist **list, bitmap *reject_map, char *hos
 					continue;
 
 				/* add service to the list */
-				add_object_to_objectlist(list, temp_service);
+				xodtemplate_add_listed(list, listed_services, temp_service);
 				}
 
 			/* free memory allocated to compiled regexp */
@@ -9808,7 +10835,7 @@ int xodtemplate_expand_services(objectlist **list, bitmap *reject_map, char *hos
 					continue;
 
 				/* add service to the list */
-				add_object_to_objectlist(list, temp_service);
+				xodtemplate_add_listed(list, listed_services, temp_service);
 				}
 			}
 
@@ -9830,7 +10857,7 @@ int xodtemplate_expand_services(objectlist **list, bitmap *reject_map, char *hos
 				if(reject_item == TRUE)
 					bitmap_set(reject_map, temp_service->id);
 				else
-					add_object_to_objectlist(list, temp_service);
+					xodtemplate_add_listed(list, listed_services, temp_service);
 			}
 #ifndef NSCGI
 		}
@@ -9852,6 +10879,19 @@ int xodtemplate_expand_services(objectlist **list, bitmap *reject_map, char *hos
 	return OK;
 	}
 
+int xodtemplate_expand_services(objectlist **list, bitmap *reject_map, char *host_name, char *services, int _config_file, int _start_line) {
+	int result;
+
+	if(list == NULL)
+		return ERROR;
+
+	xodtemplate_mark_listed(listed_services, *list, TRUE);
+	result = _xodtemplate_expand_services(list, reject_map, host_name, services, _config_file, _start_line);
+	xodtemplate_mark_listed(listed_services, *list, FALSE);
+
+	return result;
+	}
+
 /* returns a comma-delimited list of hostgroup names */
 char * xodtemplate_process_hostgroup_names(char *hostgroups, int _config_file, int _start_line) {
 	xodtemplate_memberlist *temp_list = NULL;
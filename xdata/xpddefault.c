@@ -36,11 +36,29 @@ static command *host_perfdata_command_ptr = NULL;
 static command *service_perfdata_command_ptr = NULL;
 static command *host_perfdata_file_processing_command_ptr = NULL;
 static command *service_perfdata_file_processing_command_ptr = NULL;
+static struct macro_template *host_perfdata_file_tmpl = NULL;
+static struct macro_template *service_perfdata_file_tmpl = NULL;
 static FILE    *host_perfdata_fp = NULL;
 static FILE    *service_perfdata_fp = NULL;
 static int     host_perfdata_fd = -1;
 static int     service_perfdata_fd = -1;
 
+/*
+ * With perfdata_file_buffer_size set, lines are spooled in memory
+ * and written out with a single write() when the buffer fills up,
+ * every perfdata_file_flush_interval seconds and whenever the file
+ * is closed, which includes right before it's processed.
+ */
+struct perfdata_spool {
+	char *buf;
+	size_t len;
+	unsigned long dropped;
+	};
+static struct perfdata_spool host_perfdata_spool;
+static struct perfdata_spool service_perfdata_spool;
+
+static int xpddefault_flush_spool(struct perfdata_spool *, FILE *, const char *);
+
 
 /******************************************************************/
 /************** INITIALIZATION & CLEANUP FUNCTIONS ****************/
@@ -74,6 +92,10 @@ int xpddefault_initialize_performance_data(const char *cfgfile) {
 	xpddefault_preprocess_file_templates(host_perfdata_file_template);
 	xpddefault_preprocess_file_templates(service_perfdata_file_template);
 
+	/* these get expanded for every check result, so pre-parse them */
+	host_perfdata_file_tmpl = compile_macro_template(host_perfdata_file_template);
+	service_perfdata_file_tmpl = compile_macro_template(service_perfdata_file_template);
+
 	/* open the performance data files */
 	xpddefault_open_host_perfdata_file();
 	xpddefault_open_service_perfdata_file();
@@ -156,6 +178,10 @@ int xpddefault_initialize_performance_data(const char *cfgfile) {
 		service_perfdata_file_processing_command_ptr = temp_command;
 		}
 
+	/* periodically write out spooled perfdata */
+	if(perfdata_file_buffer_size > 0 && perfdata_file_flush_interval > 0)
+		schedule_new_event(EVENT_USER_FUNCTION, TRUE, current_time + perfdata_file_flush_interval, TRUE, perfdata_file_flush_interval, NULL, TRUE, (void *)xpddefault_flush_perfdata_files, NULL, 0);
+
 	/* periodically process the host perfdata file */
 	if(host_perfdata_file_processing_interval > 0 && host_perfdata_file_processing_command != NULL)
 		schedule_new_event(EVENT_USER_FUNCTION, TRUE, current_time + host_perfdata_file_processing_interval, TRUE, host_perfdata_file_processing_interval, NULL, TRUE, (void *)xpddefault_process_host_perfdata_file, NULL, 0);
@@ -187,6 +213,38 @@ int xpddefault_initialize_performance_data(const char *cfgfile) {
 
 
 
+/* finds the command a perfdata command line runs, dropping the command line if it's gone */
+static command *xpddefault_find_command(char **command_line, const char *description) {
+	char *temp_buffer = NULL;
+	command *temp_command = NULL;
+
+	if(*command_line == NULL)
+		return NULL;
+
+	temp_buffer = (char *)strdup(*command_line);
+	if((temp_command = find_command(my_strtok(temp_buffer, "!"))) == NULL) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: %s command '%s' was not found after reloading the object configuration - it will no longer be run!\n", description, temp_buffer);
+		my_free(*command_line);
+		}
+	my_free(temp_buffer);
+
+	return temp_command;
+	}
+
+
+/* looks up the performance data commands again, as the old command objects are gone after a reload */
+int xpddefault_update_performance_data_commands(void) {
+
+	host_perfdata_command_ptr = xpddefault_find_command(&host_perfdata_command, "Host performance");
+	service_perfdata_command_ptr = xpddefault_find_command(&service_perfdata_command, "Service performance");
+	host_perfdata_file_processing_command_ptr = xpddefault_find_command(&host_perfdata_file_processing_command, "Host performance file processing");
+	service_perfdata_file_processing_command_ptr = xpddefault_find_command(&service_perfdata_file_processing_command, "Service performance file processing");
+
+	return OK;
+	}
+
+
+
 /* cleans up performance data */
 int xpddefault_cleanup_performance_data(void) {
 
@@ -195,6 +253,8 @@ int xpddefault_cleanup_performance_data(void) {
 	my_free(service_perfdata_command);
 	my_free(host_perfdata_file_template);
 	my_free(service_perfdata_file_template);
+	my_free(host_perfdata_file_tmpl);
+	my_free(service_perfdata_file_tmpl);
 	my_free(host_perfdata_file);
 	my_free(service_perfdata_file);
 	my_free(host_perfdata_file_processing_command);
@@ -203,6 +263,8 @@ int xpddefault_cleanup_performance_data(void) {
 	/* close the files */
 	xpddefault_close_host_perfdata_file();
 	xpddefault_close_service_perfdata_file();
+	my_free(host_perfdata_spool.buf);
+	my_free(service_perfdata_spool.buf);
 
 	return OK;
 	}
@@ -332,7 +394,7 @@ int xpddefault_run_service_performance_data_command(nagios_macros *mac, service
 	log_debug_info(DEBUGL_PERFDATA, 2, "Raw service performance data command line: %s\n", raw_command_line);
 
 	/* process any macros in the raw command line */
-	process_macros_r(mac, raw_command_line, &processed_command_line, macro_options);
+	process_command_macros_r(mac, raw_command_line, &processed_command_line, macro_options);
 	my_free(raw_command_line);
 	if(processed_command_line == NULL)
 		return ERROR;
@@ -373,7 +435,7 @@ int xpddefault_run_host_performance_data_command(nagios_macros *mac, host *hst)
 	log_debug_info(DEBUGL_PERFDATA, 2, "Raw host performance data command line: %s\n", raw_command_line);
 
 	/* process any macros in the raw command line */
-	process_macros_r(mac, raw_command_line, &processed_command_line, macro_options);
+	process_command_macros_r(mac, raw_command_line, &processed_command_line, macro_options);
 	my_free(raw_command_line);
 	if (!processed_command_line)
 		return ERROR;
@@ -447,12 +509,16 @@ int xpddefault_open_service_perfdata_file(void) {
 /* close the host performance data file */
 int xpddefault_close_host_perfdata_file(void) {
 
+	/* whatever is spooled belongs in this file */
+	xpddefault_flush_spool(&host_perfdata_spool, host_perfdata_fp, "host");
+
+	/* fclose() also closes the descriptor of a pipe */
 	if(host_perfdata_fp != NULL)
 		fclose(host_perfdata_fp);
-	if(host_perfdata_fd >= 0) {
+	else if(host_perfdata_fd >= 0)
 		close(host_perfdata_fd);
-		host_perfdata_fd = -1;
-		}
+	host_perfdata_fp = NULL;
+	host_perfdata_fd = -1;
 
 	return OK;
 	}
@@ -461,17 +527,95 @@ int xpddefault_close_host_perfdata_file(void) {
 /* close the service performance data file */
 int xpddefault_close_service_perfdata_file(void) {
 
+	/* whatever is spooled belongs in this file */
+	xpddefault_flush_spool(&service_perfdata_spool, service_perfdata_fp, "service");
+
+	/* fclose() also closes the descriptor of a pipe */
 	if(service_perfdata_fp != NULL)
 		fclose(service_perfdata_fp);
-	if(service_perfdata_fd >= 0) {
+	else if(service_perfdata_fd >= 0)
 		close(service_perfdata_fd);
-		service_perfdata_fd = -1;
+	service_perfdata_fp = NULL;
+	service_perfdata_fd = -1;
+
+	return OK;
+	}
+
+
+/* writes out spooled perfdata lines. Whatever a full pipe won't take is kept for later */
+static int xpddefault_flush_spool(struct perfdata_spool *spool, FILE *fp, const char *type) {
+	size_t done = 0;
+	ssize_t wrote;
+
+	while(fp != NULL && done < spool->len) {
+		wrote = write(fileno(fp), spool->buf + done, spool->len - done);
+		if(wrote < 0) {
+			if(errno == EINTR)
+				continue;
+			log_debug_info(DEBUGL_PERFDATA, 1, "Failed to write %lu bytes of %s performance data: %s\n", (unsigned long)(spool->len - done), type, strerror(errno));
+			break;
+			}
+		done += wrote;
+		}
+
+	spool->len -= done;
+	if(spool->len > 0) {
+		memmove(spool->buf, spool->buf + done, spool->len);
+		return ERROR;
+		}
+
+	/* the reader caught up, so say once how much it missed */
+	if(spool->dropped > 0) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: %lu %s performance data lines were dropped because the %s performance data file didn't keep up\n", spool->dropped, type, type);
+		spool->dropped = 0;
 		}
 
 	return OK;
 	}
 
 
+/* adds a line to a perfdata spool, writing the spool out first if it won't fit */
+static int xpddefault_spool_line(struct perfdata_spool *spool, FILE *fp, const char *line, const char *type) {
+	size_t len = strlen(line);
+
+	if(spool->buf == NULL && (spool->buf = (char *)malloc(perfdata_file_buffer_size)) == NULL)
+		return ERROR;
+
+	if(spool->len + len + 1 > perfdata_file_buffer_size)
+		xpddefault_flush_spool(spool, fp, type);
+
+	if(spool->len + len + 1 > perfdata_file_buffer_size) {
+		/* the reader is stuck; don't let the core wait for it */
+		if(spool->len > 0) {
+			spool->dropped++;
+			return ERROR;
+			}
+
+		/* too big to ever fit, so bypass the spool */
+		fputs(line, fp);
+		fputc('\n', fp);
+		fflush(fp);
+		return OK;
+		}
+
+	memcpy(spool->buf + spool->len, line, len);
+	spool->buf[spool->len + len] = '\n';
+	spool->len += len + 1;
+
+	return OK;
+	}
+
+
+/* writes out spooled lines to both perfdata files */
+int xpddefault_flush_perfdata_files(void) {
+
+	xpddefault_flush_spool(&host_perfdata_spool, host_perfdata_fp, "host");
+	xpddefault_flush_spool(&service_perfdata_spool, service_perfdata_fp, "service");
+
+	return OK;
+	}
+
+
 /* processes delimiter characters in templates */
 int xpddefault_preprocess_file_templates(char *template) {
 	char *tempbuf;
@@ -530,22 +674,31 @@ int xpddefault_update_service_performance_data_file(nagios_macros *mac, service
 	if(service_perfdata_fp == NULL || service_perfdata_file_template == NULL)
 		return OK;
 
-	/* get the raw line to write */
-	raw_output = (char *)strdup(service_perfdata_file_template);
+	/* process any macros in the template */
+	if(service_perfdata_file_tmpl)
+		process_macro_template_r(mac, service_perfdata_file_tmpl, &processed_output, 0);
+	else {
+		/* get the raw line to write */
+		raw_output = (char *)strdup(service_perfdata_file_template);
 
-	log_debug_info(DEBUGL_PERFDATA, 2, "Raw service performance data file output: %s\n", raw_output);
+		log_debug_info(DEBUGL_PERFDATA, 2, "Raw service performance data file output: %s\n", raw_output);
 
-	/* process any macros in the raw output line */
-	process_macros_r(mac, raw_output, &processed_output, 0);
+		/* process any macros in the raw output line */
+		process_macros_r(mac, raw_output, &processed_output, 0);
+		}
 	if(processed_output == NULL)
 		return ERROR;
 
 	log_debug_info(DEBUGL_PERFDATA, 2, "Processed service performance data file output: %s\n", processed_output);
 
-	/* write to host performance data file */
-	fputs(processed_output, service_perfdata_fp);
-	fputc('\n', service_perfdata_fp);
-	fflush(service_perfdata_fp);
+	/* write to service performance data file */
+	if(perfdata_file_buffer_size > 0)
+		xpddefault_spool_line(&service_perfdata_spool, service_perfdata_fp, processed_output, "service");
+	else {
+		fputs(processed_output, service_perfdata_fp);
+		fputc('\n', service_perfdata_fp);
+		fflush(service_perfdata_fp);
+		}
 
 	/* free memory */
 	my_free(raw_output);
@@ -570,22 +723,31 @@ int xpddefault_update_host_performance_data_file(nagios_macros *mac, host *hst)
 	if(host_perfdata_fp == NULL || host_perfdata_file_template == NULL)
 		return OK;
 
-	/* get the raw output */
-	raw_output = (char *)strdup(host_perfdata_file_template);
+	/* process any macros in the template */
+	if(host_perfdata_file_tmpl)
+		process_macro_template_r(mac, host_perfdata_file_tmpl, &processed_output, 0);
+	else {
+		/* get the raw output */
+		raw_output = (char *)strdup(host_perfdata_file_template);
 
-	log_debug_info(DEBUGL_PERFDATA, 2, "Raw host performance file output: %s\n", raw_output);
+		log_debug_info(DEBUGL_PERFDATA, 2, "Raw host performance file output: %s\n", raw_output);
 
-	/* process any macros in the raw output */
-	process_macros_r(mac, raw_output, &processed_output, 0);
+		/* process any macros in the raw output */
+		process_macros_r(mac, raw_output, &processed_output, 0);
+		}
 	if(processed_output == NULL)
 		return ERROR;
 
 	log_debug_info(DEBUGL_PERFDATA, 2, "Processed host performance data file output: %s\n", processed_output);
 
 	/* write to host performance data file */
-	fputs(processed_output, host_perfdata_fp);
-	fputc('\n', host_perfdata_fp);
-	fflush(host_perfdata_fp);
+	if(perfdata_file_buffer_size > 0)
+		xpddefault_spool_line(&host_perfdata_spool, host_perfdata_fp, processed_output, "host");
+	else {
+		fputs(processed_output, host_perfdata_fp);
+		fputc('\n', host_perfdata_fp);
+		fflush(host_perfdata_fp);
+		}
 
 	/* free memory */
 	my_free(raw_output);
@@ -624,7 +786,7 @@ int xpddefault_process_host_perfdata_file(void) {
 	log_debug_info(DEBUGL_PERFDATA, 2, "Raw host performance data file processing command line: %s\n", raw_command_line);
 
 	/* process any macros in the raw command line */
-	process_macros_r(&mac, raw_command_line, &processed_command_line, macro_options);
+	process_command_macros_r(&mac, raw_command_line, &processed_command_line, macro_options);
 	my_free(raw_command_line);
 	if(processed_command_line == NULL) {
 		clear_volatile_macros_r(&mac);
@@ -684,7 +846,7 @@ int xpddefault_process_service_perfdata_file(void) {
 	log_debug_info(DEBUGL_PERFDATA, 2, "Raw service performance data file processing command line: %s\n", raw_command_line);
 
 	/* process any macros in the raw command line */
-	process_macros_r(&mac, raw_command_line, &processed_command_line, macro_options);
+	process_command_macros_r(&mac, raw_command_line, &processed_command_line, macro_options);
 	my_free(raw_command_line);
 	if(processed_command_line == NULL) {
 		clear_volatile_macros_r(&mac);
@@ -28,6 +28,7 @@
 
 int xpddefault_initialize_performance_data(const char *);
 int xpddefault_cleanup_performance_data(void);
+int xpddefault_update_performance_data_commands(void);
 
 int xpddefault_update_service_performance_data(service *);
 int xpddefault_update_host_performance_data(host *);
@@ -44,6 +45,7 @@ int xpddefault_open_host_perfdata_file(void);
 int xpddefault_open_service_perfdata_file(void);
 int xpddefault_close_host_perfdata_file(void);
 int xpddefault_close_service_perfdata_file(void);
+int xpddefault_flush_perfdata_files(void);
 
 int xpddefault_process_host_perfdata_file(void);
 int xpddefault_process_service_perfdata_file(void);
@@ -33,6 +33,9 @@
 #include "../include/comments.h"
 #include "../include/downtime.h"
 #include "xrddefault.h"
+#include <pthread.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
 
 
 /******************************************************************/
@@ -40,6 +43,9 @@
 /******************************************************************/
 
 
+static void xrd_free_checksums(void);
+
+
 /* initialize retention data */
 int xrddefault_initialize_retention_data(const char *cfgfile) {
 	nagios_macros *mac;
@@ -69,6 +75,7 @@ int xrddefault_cleanup_retention_data(void) {
 
 	/* free memory */
 	my_free(retention_file);
+	xrd_free_checksums();
 
 	return OK;
 	}
@@ -78,58 +85,332 @@ int xrddefault_cleanup_retention_data(void) {
 /**************** DEFAULT STATE OUTPUT FUNCTION *******************/
 /******************************************************************/
 
-int xrddefault_save_state_information(void) {
-	char *tmp_file = NULL;
-	customvariablesmember *temp_customvariablesmember = NULL;
-	time_t current_time = 0L;
-	int result = OK;
-	FILE *fp = NULL;
-	host *temp_host = NULL;
-	service *temp_service = NULL;
-	contact *temp_contact = NULL;
-	nagios_comment *temp_comment = NULL;
-	scheduled_downtime *temp_downtime = NULL;
-	int x = 0;
-	int fd = 0;
-	unsigned long host_attribute_mask = 0L;
-	unsigned long service_attribute_mask = 0L;
-	unsigned long contact_attribute_mask = 0L;
-	unsigned long contact_host_attribute_mask = 0L;
-	unsigned long contact_service_attribute_mask = 0L;
-	unsigned long process_host_attribute_mask = 0L;
-	unsigned long process_service_attribute_mask = 0L;
+/* names of the blocks in text retention files, by XRDDEFAULT_*_DATA */
+static const char *xrd_block_names[] = {
+	NULL, "info", "program", "host", "service", "contact",
+	"hostcomment", "servicecomment", "hostdowntime", "servicedowntime"
+	};
+
+/* variables of a block that don't count as a change to it */
+#define XRD_MAX_VOLATILE 4
+
+/* a state save, put together one block at a time */
+typedef struct xrd_output {
+	FILE *fp;
+	int binary;                 /* write binary records rather than text blocks */
+	int incremental;            /* skip objects that haven't changed since the last save */
+	char *buf;                  /* the current block */
+	size_t len;
+	size_t size;
+	size_t volatile_vars[XRD_MAX_VOLATILE][2]; /* start and end of each in the current block */
+	int num_volatile;
+	unsigned int records;       /* blocks written so far */
+	unsigned long long bytes;   /* bytes written so far */
+	int error;
+	} xrd_output;
+
+/* what we know about the binary retention file we last wrote */
+static struct {
+	unsigned long long *host_sums;      /* checksum of each object's last record, by id */
+	unsigned long long *service_sums;
+	unsigned long long *contact_sums;
+	unsigned int num_hosts;
+	unsigned int num_services;
+	unsigned int num_contacts;
+	off_t full_size;                    /* size of the full segment */
+	off_t size;                         /* size of the whole file */
+	ino_t ino;
+	} saved;
+
+
+static void xrd_put_u32(char *buf, unsigned int val) {
+	val = htonl(val);
+	memcpy(buf, &val, 4);
+	}
 
 
-	log_debug_info(DEBUGL_FUNCTIONS, 0, "xrddefault_save_state_information()\n");
+static unsigned int xrd_get_u32(const char *buf) {
+	unsigned int val;
 
-	/* make sure we have everything */
-	if(retention_file == NULL || temp_file == NULL) {
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: We don't have the required file names to store retention data!\n");
-		return ERROR;
+	memcpy(&val, buf, 4);
+	return ntohl(val);
+	}
+
+
+/* 64-bit FNV-1a, which is plenty to tell if a record has changed */
+#define XRD_CHECKSUM_INIT 14695981039346656037ULL
+
+static unsigned long long xrd_checksum(unsigned long long sum, const char *buf, size_t len) {
+
+	while(len--) {
+		sum ^= (unsigned char)*buf++;
+		sum *= 1099511628211ULL;
 		}
 
-	/* open a safe temp file for output */
-	asprintf(&tmp_file, "%sXXXXXX", temp_file);
-	if(tmp_file == NULL)
+	return sum;
+	}
+
+
+/* forget the checksums, so the next save is a full one */
+static void xrd_free_checksums(void) {
+	my_free(saved.host_sums);
+	my_free(saved.service_sums);
+	my_free(saved.contact_sums);
+	memset(&saved, 0, sizeof(saved));
+	}
+
+
+static int xrd_alloc_checksums(void) {
+	xrd_free_checksums();
+
+	saved.host_sums = calloc(num_objects.hosts + 1, sizeof(*saved.host_sums));
+	saved.service_sums = calloc(num_objects.services + 1, sizeof(*saved.service_sums));
+	saved.contact_sums = calloc(num_objects.contacts + 1, sizeof(*saved.contact_sums));
+	if(saved.host_sums == NULL || saved.service_sums == NULL || saved.contact_sums == NULL) {
+		xrd_free_checksums();
 		return ERROR;
-	if((fd = mkstemp(tmp_file)) == -1)
+		}
+	saved.num_hosts = num_objects.hosts;
+	saved.num_services = num_objects.services;
+	saved.num_contacts = num_objects.contacts;
+
+	return OK;
+	}
+
+
+/* makes room for 'len' more bytes in the current block */
+static int xrd_reserve(xrd_output *out, size_t len) {
+	char *buf;
+	size_t size;
+
+	if(out->len + len <= out->size)
+		return OK;
+
+	size = (out->len + len) * 2;
+	if((buf = (char *)realloc(out->buf, size)) == NULL) {
+		out->error = TRUE;
 		return ERROR;
+		}
+	out->buf = buf;
+	out->size = size;
 
-	log_debug_info(DEBUGL_RETENTIONDATA, 2, "Writing retention data to temp file '%s'\n", tmp_file);
+	return OK;
+	}
 
-	fp = (FILE *)fdopen(fd, "w");
-	if(fp == NULL) {
 
-		close(fd);
-		unlink(tmp_file);
+/* starts a new block */
+static void xrd_begin(xrd_output *out, int data_type, unsigned int id) {
 
-		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Could not open temp state retention file '%s' for writing!\n", tmp_file);
+	out->len = 0;
+	out->num_volatile = 0;
 
-		my_free(tmp_file);
+	if(out->binary == FALSE) {
+		if(xrd_reserve(out, strlen(xrd_block_names[data_type]) + 3) == OK)
+			out->len = sprintf(out->buf, "%s {\n", xrd_block_names[data_type]);
+		return;
+		}
 
-		return ERROR;
+	/* the payload length is filled in when the block is done */
+	if(xrd_reserve(out, XRDDEFAULT_RECORD_HEADER_LEN) == OK) {
+		xrd_put_u32(out->buf, data_type);
+		xrd_put_u32(out->buf + 4, id);
+		out->len = XRDDEFAULT_RECORD_HEADER_LEN;
+		}
+	}
+
+
+/*
+ * adds a variable named 'prefix' + 'var' to the current block, as a
+ * "var=value" line or a binary key/value pair
+ */
+static void xrd_vvar(xrd_output *out, const char *prefix, const char *var, const char *fmt, va_list ap) {
+	size_t prefix_len = strlen(prefix);
+	size_t var_len = strlen(var);
+	size_t start = out->len;
+	size_t hdr_len = out->binary ? 8 : 0;
+	va_list ap2;
+	int len;
+
+	if(xrd_reserve(out, hdr_len + prefix_len + var_len + 2) == ERROR)
+		return;
+
+	out->len += hdr_len;
+	memcpy(out->buf + out->len, prefix, prefix_len);
+	memcpy(out->buf + out->len + prefix_len, var, var_len);
+	out->len += prefix_len + var_len;
+	out->buf[out->len++] = out->binary ? '\0' : '=';
+
+	va_copy(ap2, ap);
+	len = vsnprintf(out->buf + out->len, out->size - out->len, fmt, ap2);
+	va_end(ap2);
+	if(len >= 0 && (size_t)len >= out->size - out->len) {
+		if(xrd_reserve(out, len + 1) == ERROR) {
+			out->len = start;
+			return;
+			}
+		len = vsnprintf(out->buf + out->len, out->size - out->len, fmt, ap);
+		}
+	if(len < 0) {
+		out->error = TRUE;
+		out->len = start;
+		return;
+		}
+
+	/* binary values keep vsnprintf()'s nul byte */
+	if(out->binary == FALSE)
+		out->buf[out->len + len] = '\n';
+	else {
+		xrd_put_u32(out->buf + start, prefix_len + var_len);
+		xrd_put_u32(out->buf + start + 4, len);
+		}
+	out->len += len + 1;
+	}
+
+
+static void xrd_var(xrd_output *out, const char *var, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	xrd_vvar(out, "", var, fmt, ap);
+	va_end(ap);
+	}
+
+
+static void xrd_prefixed_var(xrd_output *out, const char *prefix, const char *var, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	xrd_vvar(out, prefix, var, fmt, ap);
+	va_end(ap);
+	}
+
+
+/*
+ * adds a variable that changes with every check, such as the check
+ * times or latency. Those alone don't make an incremental save write
+ * the object again
+ */
+static void xrd_volatile_var(xrd_output *out, const char *var, const char *fmt, ...) {
+	size_t start = out->len;
+	va_list ap;
+
+	va_start(ap, fmt);
+	xrd_vvar(out, "", var, fmt, ap);
+	va_end(ap);
+
+	if(out->num_volatile < XRD_MAX_VOLATILE) {
+		out->volatile_vars[out->num_volatile][0] = start;
+		out->volatile_vars[out->num_volatile][1] = out->len;
+		out->num_volatile++;
+		}
+	}
+
+
+/* checksums the current block, leaving out its length and volatile variables */
+static unsigned long long xrd_block_checksum(xrd_output *out) {
+	unsigned long long sum = XRD_CHECKSUM_INIT;
+	size_t offset = XRDDEFAULT_RECORD_HEADER_LEN;
+	int i;
+
+	for(i = 0; i < out->num_volatile; i++) {
+		sum = xrd_checksum(sum, out->buf + offset, out->volatile_vars[i][0] - offset);
+		offset = out->volatile_vars[i][1];
 		}
 
+	return xrd_checksum(sum, out->buf + offset, out->len - offset);
+	}
+
+
+/* state history is saved oldest entry first */
+static void xrd_state_history(xrd_output *out, int *state_history, int state_history_index) {
+	char buf[MAX_STATE_HISTORY_ENTRIES * 12];
+	size_t len = 0;
+	int x;
+
+	for(x = 0; x < MAX_STATE_HISTORY_ENTRIES; x++)
+		len += snprintf(buf + len, sizeof(buf) - len, "%s%d", (x > 0) ? "," : "", state_history[(x + state_history_index) % MAX_STATE_HISTORY_ENTRIES]);
+
+	xrd_var(out, "state_history", "%s", buf);
+	}
+
+
+static void xrd_custom_variables(xrd_output *out, customvariablesmember *custom_variables) {
+	customvariablesmember *temp_customvariablesmember = NULL;
+
+	for(temp_customvariablesmember = custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
+		if(temp_customvariablesmember->variable_name)
+			xrd_prefixed_var(out, "_", temp_customvariablesmember->variable_name, "%d;%s", temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
+		}
+	}
+
+
+/*
+ * finishes the current block and writes it out. Blocks with a slot in
+ * 'sums' are objects, which incremental saves skip if their record is
+ * the same as the last one we wrote for them
+ */
+static void xrd_end(xrd_output *out, unsigned long long *sums, unsigned int id) {
+	unsigned long long sum;
+
+	if(out->binary == FALSE) {
+		if(xrd_reserve(out, 2) == OK) {
+			memcpy(out->buf + out->len, "}\n", 2);
+			out->len += 2;
+			}
+		}
+	else if(out->len >= XRDDEFAULT_RECORD_HEADER_LEN)
+		xrd_put_u32(out->buf + 8, out->len - XRDDEFAULT_RECORD_HEADER_LEN);
+
+	if(out->error == TRUE)
+		return;
+
+	if(out->binary == TRUE && sums != NULL) {
+		sum = xrd_block_checksum(out);
+		if(out->incremental == TRUE && sums[id] == sum)
+			return;
+		sums[id] = sum;
+		}
+
+	if(fwrite(out->buf, 1, out->len, out->fp) != out->len) {
+		out->error = TRUE;
+		return;
+		}
+	out->records++;
+	out->bytes += out->len;
+	}
+
+
+static int xrd_write_segment_header(FILE *fp, int segment_type, unsigned int records, unsigned long long len) {
+	char hdr[XRDDEFAULT_SEGMENT_HEADER_LEN];
+
+	memcpy(hdr, XRDDEFAULT_BINARY_MAGIC, 8);
+	xrd_put_u32(hdr + 8, XRDDEFAULT_BINARY_VERSION);
+	xrd_put_u32(hdr + 12, segment_type);
+	xrd_put_u32(hdr + 16, records);
+	xrd_put_u32(hdr + 20, 0);
+	xrd_put_u32(hdr + 24, (unsigned int)(len >> 32));
+	xrd_put_u32(hdr + 28, (unsigned int)(len & 0xffffffff));
+
+	return (fwrite(hdr, 1, sizeof(hdr), fp) == sizeof(hdr)) ? OK : ERROR;
+	}
+
+
+/* writes all blocks of a state save */
+static void xrddefault_write_state(xrd_output *out) {
+	time_t current_time = 0L;
+	host *temp_host = NULL;
+	service *temp_service = NULL;
+	contact *temp_contact = NULL;
+	nagios_comment *temp_comment = NULL;
+	scheduled_downtime *temp_downtime = NULL;
+	unsigned long host_attribute_mask = 0L;
+	unsigned long service_attribute_mask = 0L;
+	unsigned long contact_attribute_mask = 0L;
+	unsigned long contact_host_attribute_mask = 0L;
+	unsigned long contact_service_attribute_mask = 0L;
+	unsigned long process_host_attribute_mask = 0L;
+	unsigned long process_service_attribute_mask = 0L;
+
 	/* what attributes should be masked out? */
 	/* NOTE: host/service/contact-specific values may be added in the future, but for now we only have global masks */
 	process_host_attribute_mask = retained_process_host_attribute_mask;
@@ -139,268 +420,390 @@ int xrddefault_save_state_information(void) {
 	contact_host_attribute_mask = retained_contact_host_attribute_mask;
 	contact_service_attribute_mask = retained_contact_service_attribute_mask;
 
-	/* write version info to status file */
-	fprintf(fp, "########################################\n");
-	fprintf(fp, "#      NAGIOS STATE RETENTION FILE\n");
-	fprintf(fp, "#\n");
-	fprintf(fp, "# THIS FILE IS AUTOMATICALLY GENERATED\n");
-	fprintf(fp, "# BY NAGIOS.  DO NOT MODIFY THIS FILE!\n");
-	fprintf(fp, "########################################\n");
-
 	time(&current_time);
 
 	/* write file info */
-	fprintf(fp, "info {\n");
-	fprintf(fp, "created=%llu\n", (unsigned long long)current_time);
-	fprintf(fp, "version=%s\n", PROGRAM_VERSION);
-	fprintf(fp, "last_update_check=%llu\n", (unsigned long long)last_update_check);
-	fprintf(fp, "update_available=%d\n", update_available);
-	fprintf(fp, "update_uid=%lu\n", update_uid);
-	fprintf(fp, "last_version=%s\n", (last_program_version == NULL) ? "" : last_program_version);
-	fprintf(fp, "new_version=%s\n", (new_program_version == NULL) ? "" : new_program_version);
-	fprintf(fp, "}\n");
+	xrd_begin(out, XRDDEFAULT_INFO_DATA, 0);
+	xrd_var(out, "created", "%llu", (unsigned long long)current_time);
+	xrd_var(out, "version", "%s", PROGRAM_VERSION);
+	xrd_var(out, "last_update_check", "%llu", (unsigned long long)last_update_check);
+	xrd_var(out, "update_available", "%d", update_available);
+	xrd_var(out, "update_uid", "%lu", update_uid);
+	xrd_var(out, "last_version", "%s", (last_program_version == NULL) ? "" : last_program_version);
+	xrd_var(out, "new_version", "%s", (new_program_version == NULL) ? "" : new_program_version);
+	xrd_end(out, NULL, 0);
 
 	/* save program state information */
-	fprintf(fp, "program {\n");
-	fprintf(fp, "modified_host_attributes=%lu\n", (modified_host_process_attributes & ~process_host_attribute_mask));
-	fprintf(fp, "modified_service_attributes=%lu\n", (modified_service_process_attributes & ~process_service_attribute_mask));
-	fprintf(fp, "enable_notifications=%d\n", enable_notifications);
-	fprintf(fp, "active_service_checks_enabled=%d\n", execute_service_checks);
-	fprintf(fp, "passive_service_checks_enabled=%d\n", accept_passive_service_checks);
-	fprintf(fp, "active_host_checks_enabled=%d\n", execute_host_checks);
-	fprintf(fp, "passive_host_checks_enabled=%d\n", accept_passive_host_checks);
-	fprintf(fp, "enable_event_handlers=%d\n", enable_event_handlers);
-	fprintf(fp, "obsess_over_services=%d\n", obsess_over_services);
-	fprintf(fp, "obsess_over_hosts=%d\n", obsess_over_hosts);
-	fprintf(fp, "check_service_freshness=%d\n", check_service_freshness);
-	fprintf(fp, "check_host_freshness=%d\n", check_host_freshness);
-	fprintf(fp, "enable_flap_detection=%d\n", enable_flap_detection);
-	fprintf(fp, "process_performance_data=%d\n", process_performance_data);
-	fprintf(fp, "global_host_event_handler=%s\n", (global_host_event_handler == NULL) ? "" : global_host_event_handler);
-	fprintf(fp, "global_service_event_handler=%s\n", (global_service_event_handler == NULL) ? "" : global_service_event_handler);
-	fprintf(fp, "next_comment_id=%lu\n", next_comment_id);
-	fprintf(fp, "next_downtime_id=%lu\n", next_downtime_id);
-	fprintf(fp, "next_event_id=%lu\n", next_event_id);
-	fprintf(fp, "next_problem_id=%lu\n", next_problem_id);
-	fprintf(fp, "next_notification_id=%lu\n", next_notification_id);
-	fprintf(fp, "}\n");
+	xrd_begin(out, XRDDEFAULT_PROGRAMSTATUS_DATA, 0);
+	xrd_var(out, "modified_host_attributes", "%lu", (modified_host_process_attributes & ~process_host_attribute_mask));
+	xrd_var(out, "modified_service_attributes", "%lu", (modified_service_process_attributes & ~process_service_attribute_mask));
+	xrd_var(out, "enable_notifications", "%d", enable_notifications);
+	xrd_var(out, "active_service_checks_enabled", "%d", execute_service_checks);
+	xrd_var(out, "passive_service_checks_enabled", "%d", accept_passive_service_checks);
+	xrd_var(out, "active_host_checks_enabled", "%d", execute_host_checks);
+	xrd_var(out, "passive_host_checks_enabled", "%d", accept_passive_host_checks);
+	xrd_var(out, "enable_event_handlers", "%d", enable_event_handlers);
+	xrd_var(out, "obsess_over_services", "%d", obsess_over_services);
+	xrd_var(out, "obsess_over_hosts", "%d", obsess_over_hosts);
+	xrd_var(out, "check_service_freshness", "%d", check_service_freshness);
+	xrd_var(out, "check_host_freshness", "%d", check_host_freshness);
+	xrd_var(out, "enable_flap_detection", "%d", enable_flap_detection);
+	xrd_var(out, "process_performance_data", "%d", process_performance_data);
+	xrd_var(out, "global_host_event_handler", "%s", (global_host_event_handler == NULL) ? "" : global_host_event_handler);
+	xrd_var(out, "global_service_event_handler", "%s", (global_service_event_handler == NULL) ? "" : global_service_event_handler);
+	xrd_var(out, "next_comment_id", "%lu", next_comment_id);
+	xrd_var(out, "next_downtime_id", "%lu", next_downtime_id);
+	xrd_var(out, "next_event_id", "%lu", next_event_id);
+	xrd_var(out, "next_problem_id", "%lu", next_problem_id);
+	xrd_var(out, "next_notification_id", "%lu", next_notification_id);
+	xrd_end(out, NULL, 0);
 
 	/* save host state information */
 	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
 
-		fprintf(fp, "host {\n");
-		fprintf(fp, "host_name=%s\n", temp_host->name);
-		fprintf(fp, "modified_attributes=%lu\n", (temp_host->modified_attributes & ~host_attribute_mask));
-		fprintf(fp, "check_command=%s\n", (temp_host->check_command == NULL) ? "" : temp_host->check_command);
-		fprintf(fp, "check_period=%s\n", (temp_host->check_period == NULL) ? "" : temp_host->check_period);
-		fprintf(fp, "notification_period=%s\n", (temp_host->notification_period == NULL) ? "" : temp_host->notification_period);
-		fprintf(fp, "event_handler=%s\n", (temp_host->event_handler == NULL) ? "" : temp_host->event_handler);
-		fprintf(fp, "has_been_checked=%d\n", temp_host->has_been_checked);
-		fprintf(fp, "check_execution_time=%.3f\n", temp_host->execution_time);
-		fprintf(fp, "check_latency=%.3f\n", temp_host->latency);
-		fprintf(fp, "check_type=%d\n", temp_host->check_type);
-		fprintf(fp, "current_state=%d\n", temp_host->current_state);
-		fprintf(fp, "last_state=%d\n", temp_host->last_state);
-		fprintf(fp, "last_hard_state=%d\n", temp_host->last_hard_state);
-		fprintf(fp, "last_event_id=%lu\n", temp_host->last_event_id);
-		fprintf(fp, "current_event_id=%lu\n", temp_host->current_event_id);
-		fprintf(fp, "current_problem_id=%lu\n", temp_host->current_problem_id);
-		fprintf(fp, "last_problem_id=%lu\n", temp_host->last_problem_id);
-		fprintf(fp, "plugin_output=%s\n", (temp_host->plugin_output == NULL) ? "" : temp_host->plugin_output);
-		fprintf(fp, "long_plugin_output=%s\n", (temp_host->long_plugin_output == NULL) ? "" : temp_host->long_plugin_output);
-		fprintf(fp, "performance_data=%s\n", (temp_host->perf_data == NULL) ? "" : temp_host->perf_data);
-		fprintf(fp, "last_check=%llu\n", (unsigned long long)temp_host->last_check);
-		fprintf(fp, "next_check=%llu\n", (unsigned long long)temp_host->next_check);
-		fprintf(fp, "check_options=%d\n", temp_host->check_options);
-		fprintf(fp, "current_attempt=%d\n", temp_host->current_attempt);
-		fprintf(fp, "max_attempts=%d\n", temp_host->max_attempts);
-		fprintf(fp, "check_interval=%f\n", temp_host->check_interval);
-		fprintf(fp, "retry_interval=%f\n", temp_host->retry_interval);
-		fprintf(fp, "state_type=%d\n", temp_host->state_type);
-		fprintf(fp, "last_state_change=%llu\n", (unsigned long long)temp_host->last_state_change);
-		fprintf(fp, "last_hard_state_change=%llu\n", (unsigned long long)temp_host->last_hard_state_change);
-		fprintf(fp, "last_time_up=%llu\n", (unsigned long long)temp_host->last_time_up);
-		fprintf(fp, "last_time_down=%llu\n", (unsigned long long)temp_host->last_time_down);
-		fprintf(fp, "last_time_unreachable=%llu\n", (unsigned long long)temp_host->last_time_unreachable);
-		fprintf(fp, "notified_on_down=%d\n", flag_isset(temp_host->notified_on, OPT_DOWN));
-		fprintf(fp, "notified_on_unreachable=%d\n", flag_isset(temp_host->notified_on, OPT_UNREACHABLE));
-		fprintf(fp, "last_notification=%llu\n", (unsigned long long)temp_host->last_notification);
-		fprintf(fp, "current_notification_number=%d\n", temp_host->current_notification_number);
-		fprintf(fp, "current_notification_id=%lu\n", temp_host->current_notification_id);
-		fprintf(fp, "notifications_enabled=%d\n", temp_host->notifications_enabled);
-		fprintf(fp, "problem_has_been_acknowledged=%d\n", temp_host->problem_has_been_acknowledged);
-		fprintf(fp, "acknowledgement_type=%d\n", temp_host->acknowledgement_type);
-		fprintf(fp, "active_checks_enabled=%d\n", temp_host->checks_enabled);
-		fprintf(fp, "passive_checks_enabled=%d\n", temp_host->accept_passive_checks);
-		fprintf(fp, "event_handler_enabled=%d\n", temp_host->event_handler_enabled);
-		fprintf(fp, "flap_detection_enabled=%d\n", temp_host->flap_detection_enabled);
-		fprintf(fp, "process_performance_data=%d\n", temp_host->process_performance_data);
-		fprintf(fp, "obsess=%d\n", temp_host->obsess);
-		fprintf(fp, "is_flapping=%d\n", temp_host->is_flapping);
-		fprintf(fp, "percent_state_change=%.2f\n", temp_host->percent_state_change);
-		fprintf(fp, "check_flapping_recovery_notification=%d\n", temp_host->check_flapping_recovery_notification);
-
-		fprintf(fp, "state_history=");
-		for(x = 0; x < MAX_STATE_HISTORY_ENTRIES; x++)
-			fprintf(fp, "%s%d", (x > 0) ? "," : "", temp_host->state_history[(x + temp_host->state_history_index) % MAX_STATE_HISTORY_ENTRIES]);
-		fprintf(fp, "\n");
+		xrd_begin(out, XRDDEFAULT_HOSTSTATUS_DATA, temp_host->id);
+		xrd_var(out, "host_name", "%s", temp_host->name);
+		xrd_var(out, "modified_attributes", "%lu", (temp_host->modified_attributes & ~host_attribute_mask));
+		xrd_var(out, "check_command", "%s", (temp_host->check_command == NULL) ? "" : temp_host->check_command);
+		xrd_var(out, "check_period", "%s", (temp_host->check_period == NULL) ? "" : temp_host->check_period);
+		xrd_var(out, "notification_period", "%s", (temp_host->notification_period == NULL) ? "" : temp_host->notification_period);
+		xrd_var(out, "event_handler", "%s", (temp_host->event_handler == NULL) ? "" : temp_host->event_handler);
+		xrd_var(out, "has_been_checked", "%d", temp_host->has_been_checked);
+		xrd_volatile_var(out, "check_execution_time", "%.3f", temp_host->execution_time);
+		xrd_volatile_var(out, "check_latency", "%.3f", temp_host->latency);
+		xrd_var(out, "check_type", "%d", temp_host->check_type);
+		xrd_var(out, "current_state", "%d", temp_host->current_state);
+		xrd_var(out, "last_state", "%d", temp_host->last_state);
+		xrd_var(out, "last_hard_state", "%d", temp_host->last_hard_state);
+		xrd_var(out, "last_event_id", "%lu", temp_host->last_event_id);
+		xrd_var(out, "current_event_id", "%lu", temp_host->current_event_id);
+		xrd_var(out, "current_problem_id", "%lu", temp_host->current_problem_id);
+		xrd_var(out, "last_problem_id", "%lu", temp_host->last_problem_id);
+		xrd_var(out, "plugin_output", "%s", (temp_host->plugin_output == NULL) ? "" : temp_host->plugin_output);
+		xrd_var(out, "long_plugin_output", "%s", (temp_host->long_plugin_output == NULL) ? "" : temp_host->long_plugin_output);
+		xrd_var(out, "performance_data", "%s", (temp_host->perf_data == NULL) ? "" : temp_host->perf_data);
+		xrd_volatile_var(out, "last_check", "%llu", (unsigned long long)temp_host->last_check);
+		xrd_volatile_var(out, "next_check", "%llu", (unsigned long long)temp_host->next_check);
+		xrd_var(out, "check_options", "%d", temp_host->check_options);
+		xrd_var(out, "current_attempt", "%d", temp_host->current_attempt);
+		xrd_var(out, "max_attempts", "%d", temp_host->max_attempts);
+		xrd_var(out, "check_interval", "%f", temp_host->check_interval);
+		xrd_var(out, "retry_interval", "%f", temp_host->retry_interval);
+		xrd_var(out, "state_type", "%d", temp_host->state_type);
+		xrd_var(out, "last_state_change", "%llu", (unsigned long long)temp_host->last_state_change);
+		xrd_var(out, "last_hard_state_change", "%llu", (unsigned long long)temp_host->last_hard_state_change);
+		xrd_var(out, "last_time_up", "%llu", (unsigned long long)temp_host->last_time_up);
+		xrd_var(out, "last_time_down", "%llu", (unsigned long long)temp_host->last_time_down);
+		xrd_var(out, "last_time_unreachable", "%llu", (unsigned long long)temp_host->last_time_unreachable);
+		xrd_var(out, "notified_on_down", "%d", flag_isset(temp_host->notified_on, OPT_DOWN));
+		xrd_var(out, "notified_on_unreachable", "%d", flag_isset(temp_host->notified_on, OPT_UNREACHABLE));
+		xrd_var(out, "last_notification", "%llu", (unsigned long long)temp_host->last_notification);
+		xrd_var(out, "current_notification_number", "%d", temp_host->current_notification_number);
+		xrd_var(out, "current_notification_id", "%lu", temp_host->current_notification_id);
+		xrd_var(out, "notifications_enabled", "%d", temp_host->notifications_enabled);
+		xrd_var(out, "problem_has_been_acknowledged", "%d", temp_host->problem_has_been_acknowledged);
+		xrd_var(out, "acknowledgement_type", "%d", temp_host->acknowledgement_type);
+		xrd_var(out, "active_checks_enabled", "%d", temp_host->checks_enabled);
+		xrd_var(out, "passive_checks_enabled", "%d", temp_host->accept_passive_checks);
+		xrd_var(out, "event_handler_enabled", "%d", temp_host->event_handler_enabled);
+		xrd_var(out, "flap_detection_enabled", "%d", temp_host->flap_detection_enabled);
+		xrd_var(out, "process_performance_data", "%d", temp_host->process_performance_data);
+		xrd_var(out, "obsess", "%d", temp_host->obsess);
+		xrd_var(out, "is_flapping", "%d", temp_host->is_flapping);
+		xrd_var(out, "percent_state_change", "%.2f", temp_host->percent_state_change);
+		xrd_var(out, "check_flapping_recovery_notification", "%d", temp_host->check_flapping_recovery_notification);
+
+		xrd_state_history(out, temp_host->state_history, temp_host->state_history_index);
 
 		/* custom variables */
-		for(temp_customvariablesmember = temp_host->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-			if(temp_customvariablesmember->variable_name)
-				fprintf(fp, "_%s=%d;%s\n", temp_customvariablesmember->variable_name, temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
-			}
+		xrd_custom_variables(out, temp_host->custom_variables);
 
-		fprintf(fp, "}\n");
+		xrd_end(out, saved.host_sums, temp_host->id);
 		}
 
 	/* save service state information */
 	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
 
-		fprintf(fp, "service {\n");
-		fprintf(fp, "host_name=%s\n", temp_service->host_name);
-		fprintf(fp, "service_description=%s\n", temp_service->description);
-		fprintf(fp, "modified_attributes=%lu\n", (temp_service->modified_attributes & ~service_attribute_mask));
-		fprintf(fp, "check_command=%s\n", (temp_service->check_command == NULL) ? "" : temp_service->check_command);
-		fprintf(fp, "check_period=%s\n", (temp_service->check_period == NULL) ? "" : temp_service->check_period);
-		fprintf(fp, "notification_period=%s\n", (temp_service->notification_period == NULL) ? "" : temp_service->notification_period);
-		fprintf(fp, "event_handler=%s\n", (temp_service->event_handler == NULL) ? "" : temp_service->event_handler);
-		fprintf(fp, "has_been_checked=%d\n", temp_service->has_been_checked);
-		fprintf(fp, "check_execution_time=%.3f\n", temp_service->execution_time);
-		fprintf(fp, "check_latency=%.3f\n", temp_service->latency);
-		fprintf(fp, "check_type=%d\n", temp_service->check_type);
-		fprintf(fp, "current_state=%d\n", temp_service->current_state);
-		fprintf(fp, "last_state=%d\n", temp_service->last_state);
-		fprintf(fp, "last_hard_state=%d\n", temp_service->last_hard_state);
-		fprintf(fp, "last_event_id=%lu\n", temp_service->last_event_id);
-		fprintf(fp, "current_event_id=%lu\n", temp_service->current_event_id);
-		fprintf(fp, "current_problem_id=%lu\n", temp_service->current_problem_id);
-		fprintf(fp, "last_problem_id=%lu\n", temp_service->last_problem_id);
-		fprintf(fp, "current_attempt=%d\n", temp_service->current_attempt);
-		fprintf(fp, "max_attempts=%d\n", temp_service->max_attempts);
-		fprintf(fp, "check_interval=%f\n", temp_service->check_interval);
-		fprintf(fp, "retry_interval=%f\n", temp_service->retry_interval);
-		fprintf(fp, "state_type=%d\n", temp_service->state_type);
-		fprintf(fp, "last_state_change=%llu\n", (unsigned long long)temp_service->last_state_change);
-		fprintf(fp, "last_hard_state_change=%llu\n", (unsigned long long)temp_service->last_hard_state_change);
-		fprintf(fp, "last_time_ok=%llu\n", (unsigned long long)temp_service->last_time_ok);
-		fprintf(fp, "last_time_warning=%llu\n", (unsigned long long)temp_service->last_time_warning);
-		fprintf(fp, "last_time_unknown=%llu\n", (unsigned long long)temp_service->last_time_unknown);
-		fprintf(fp, "last_time_critical=%llu\n", (unsigned long long)temp_service->last_time_critical);
-		fprintf(fp, "plugin_output=%s\n", (temp_service->plugin_output == NULL) ? "" : temp_service->plugin_output);
-		fprintf(fp, "long_plugin_output=%s\n", (temp_service->long_plugin_output == NULL) ? "" : temp_service->long_plugin_output);
-		fprintf(fp, "performance_data=%s\n", (temp_service->perf_data == NULL) ? "" : temp_service->perf_data);
-		fprintf(fp, "last_check=%llu\n", (unsigned long long)temp_service->last_check);
-		fprintf(fp, "next_check=%llu\n", (unsigned long long)temp_service->next_check);
-		fprintf(fp, "check_options=%d\n", temp_service->check_options);
-		fprintf(fp, "notified_on_unknown=%d\n", flag_isset(temp_service->notified_on, OPT_UNKNOWN));
-		fprintf(fp, "notified_on_warning=%d\n", flag_isset(temp_service->notified_on, OPT_WARNING));
-		fprintf(fp, "notified_on_critical=%d\n", flag_isset(temp_service->notified_on, OPT_CRITICAL));
-		fprintf(fp, "current_notification_number=%d\n", temp_service->current_notification_number);
-		fprintf(fp, "current_notification_id=%lu\n", temp_service->current_notification_id);
-		fprintf(fp, "last_notification=%llu\n", (unsigned long long)temp_service->last_notification);
-		fprintf(fp, "notifications_enabled=%d\n", temp_service->notifications_enabled);
-		fprintf(fp, "active_checks_enabled=%d\n", temp_service->checks_enabled);
-		fprintf(fp, "passive_checks_enabled=%d\n", temp_service->accept_passive_checks);
-		fprintf(fp, "event_handler_enabled=%d\n", temp_service->event_handler_enabled);
-		fprintf(fp, "problem_has_been_acknowledged=%d\n", temp_service->problem_has_been_acknowledged);
-		fprintf(fp, "acknowledgement_type=%d\n", temp_service->acknowledgement_type);
-		fprintf(fp, "flap_detection_enabled=%d\n", temp_service->flap_detection_enabled);
-		fprintf(fp, "process_performance_data=%d\n", temp_service->process_performance_data);
-		fprintf(fp, "obsess=%d\n", temp_service->obsess);
-		fprintf(fp, "is_flapping=%d\n", temp_service->is_flapping);
-		fprintf(fp, "percent_state_change=%.2f\n", temp_service->percent_state_change);
-		fprintf(fp, "check_flapping_recovery_notification=%d\n", temp_service->check_flapping_recovery_notification);
-
-		fprintf(fp, "state_history=");
-		for(x = 0; x < MAX_STATE_HISTORY_ENTRIES; x++)
-			fprintf(fp, "%s%d", (x > 0) ? "," : "", temp_service->state_history[(x + temp_service->state_history_index) % MAX_STATE_HISTORY_ENTRIES]);
-		fprintf(fp, "\n");
+		xrd_begin(out, XRDDEFAULT_SERVICESTATUS_DATA, temp_service->id);
+		xrd_var(out, "host_name", "%s", temp_service->host_name);
+		xrd_var(out, "service_description", "%s", temp_service->description);
+		xrd_var(out, "modified_attributes", "%lu", (temp_service->modified_attributes & ~service_attribute_mask));
+		xrd_var(out, "check_command", "%s", (temp_service->check_command == NULL) ? "" : temp_service->check_command);
+		xrd_var(out, "check_period", "%s", (temp_service->check_period == NULL) ? "" : temp_service->check_period);
+		xrd_var(out, "notification_period", "%s", (temp_service->notification_period == NULL) ? "" : temp_service->notification_period);
+		xrd_var(out, "event_handler", "%s", (temp_service->event_handler == NULL) ? "" : temp_service->event_handler);
+		xrd_var(out, "has_been_checked", "%d", temp_service->has_been_checked);
+		xrd_volatile_var(out, "check_execution_time", "%.3f", temp_service->execution_time);
+		xrd_volatile_var(out, "check_latency", "%.3f", temp_service->latency);
+		xrd_var(out, "check_type", "%d", temp_service->check_type);
+		xrd_var(out, "current_state", "%d", temp_service->current_state);
+		xrd_var(out, "last_state", "%d", temp_service->last_state);
+		xrd_var(out, "last_hard_state", "%d", temp_service->last_hard_state);
+		xrd_var(out, "last_event_id", "%lu", temp_service->last_event_id);
+		xrd_var(out, "current_event_id", "%lu", temp_service->current_event_id);
+		xrd_var(out, "current_problem_id", "%lu", temp_service->current_problem_id);
+		xrd_var(out, "last_problem_id", "%lu", temp_service->last_problem_id);
+		xrd_var(out, "current_attempt", "%d", temp_service->current_attempt);
+		xrd_var(out, "max_attempts", "%d", temp_service->max_attempts);
+		xrd_var(out, "check_interval", "%f", temp_service->check_interval);
+		xrd_var(out, "retry_interval", "%f", temp_service->retry_interval);
+		xrd_var(out, "state_type", "%d", temp_service->state_type);
+		xrd_var(out, "last_state_change", "%llu", (unsigned long long)temp_service->last_state_change);
+		xrd_var(out, "last_hard_state_change", "%llu", (unsigned long long)temp_service->last_hard_state_change);
+		xrd_var(out, "last_time_ok", "%llu", (unsigned long long)temp_service->last_time_ok);
+		xrd_var(out, "last_time_warning", "%llu", (unsigned long long)temp_service->last_time_warning);
+		xrd_var(out, "last_time_unknown", "%llu", (unsigned long long)temp_service->last_time_unknown);
+		xrd_var(out, "last_time_critical", "%llu", (unsigned long long)temp_service->last_time_critical);
+		xrd_var(out, "plugin_output", "%s", (temp_service->plugin_output == NULL) ? "" : temp_service->plugin_output);
+		xrd_var(out, "long_plugin_output", "%s", (temp_service->long_plugin_output == NULL) ? "" : temp_service->long_plugin_output);
+		xrd_var(out, "performance_data", "%s", (temp_service->perf_data == NULL) ? "" : temp_service->perf_data);
+		xrd_volatile_var(out, "last_check", "%llu", (unsigned long long)temp_service->last_check);
+		xrd_volatile_var(out, "next_check", "%llu", (unsigned long long)temp_service->next_check);
+		xrd_var(out, "check_options", "%d", temp_service->check_options);
+		xrd_var(out, "notified_on_unknown", "%d", flag_isset(temp_service->notified_on, OPT_UNKNOWN));
+		xrd_var(out, "notified_on_warning", "%d", flag_isset(temp_service->notified_on, OPT_WARNING));
+		xrd_var(out, "notified_on_critical", "%d", flag_isset(temp_service->notified_on, OPT_CRITICAL));
+		xrd_var(out, "current_notification_number", "%d", temp_service->current_notification_number);
+		xrd_var(out, "current_notification_id", "%lu", temp_service->current_notification_id);
+		xrd_var(out, "last_notification", "%llu", (unsigned long long)temp_service->last_notification);
+		xrd_var(out, "notifications_enabled", "%d", temp_service->notifications_enabled);
+		xrd_var(out, "active_checks_enabled", "%d", temp_service->checks_enabled);
+		xrd_var(out, "passive_checks_enabled", "%d", temp_service->accept_passive_checks);
+		xrd_var(out, "event_handler_enabled", "%d", temp_service->event_handler_enabled);
+		xrd_var(out, "problem_has_been_acknowledged", "%d", temp_service->problem_has_been_acknowledged);
+		xrd_var(out, "acknowledgement_type", "%d", temp_service->acknowledgement_type);
+		xrd_var(out, "flap_detection_enabled", "%d", temp_service->flap_detection_enabled);
+		xrd_var(out, "process_performance_data", "%d", temp_service->process_performance_data);
+		xrd_var(out, "obsess", "%d", temp_service->obsess);
+		xrd_var(out, "is_flapping", "%d", temp_service->is_flapping);
+		xrd_var(out, "percent_state_change", "%.2f", temp_service->percent_state_change);
+		xrd_var(out, "check_flapping_recovery_notification", "%d", temp_service->check_flapping_recovery_notification);
+
+		xrd_state_history(out, temp_service->state_history, temp_service->state_history_index);
 
 		/* custom variables */
-		for(temp_customvariablesmember = temp_service->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-			if(temp_customvariablesmember->variable_name)
-				fprintf(fp, "_%s=%d;%s\n", temp_customvariablesmember->variable_name, temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
-			}
+		xrd_custom_variables(out, temp_service->custom_variables);
 
-		fprintf(fp, "}\n");
+		xrd_end(out, saved.service_sums, temp_service->id);
 		}
 
 	/* save contact state information */
 	for(temp_contact = contact_list; temp_contact != NULL; temp_contact = temp_contact->next) {
 
-		fprintf(fp, "contact {\n");
-		fprintf(fp, "contact_name=%s\n", temp_contact->name);
-		fprintf(fp, "modified_attributes=%lu\n", (temp_contact->modified_attributes & ~contact_attribute_mask));
-		fprintf(fp, "modified_host_attributes=%lu\n", (temp_contact->modified_host_attributes & ~contact_host_attribute_mask));
-		fprintf(fp, "modified_service_attributes=%lu\n", (temp_contact->modified_service_attributes & ~contact_service_attribute_mask));
-		fprintf(fp, "host_notification_period=%s\n", (temp_contact->host_notification_period == NULL) ? "" : temp_contact->host_notification_period);
-		fprintf(fp, "service_notification_period=%s\n", (temp_contact->service_notification_period == NULL) ? "" : temp_contact->service_notification_period);
-		fprintf(fp, "last_host_notification=%llu\n", (unsigned long long)temp_contact->last_host_notification);
-		fprintf(fp, "last_service_notification=%llu\n", (unsigned long long)temp_contact->last_service_notification);
-		fprintf(fp, "host_notifications_enabled=%d\n", temp_contact->host_notifications_enabled);
-		fprintf(fp, "service_notifications_enabled=%d\n", temp_contact->service_notifications_enabled);
+		xrd_begin(out, XRDDEFAULT_CONTACTSTATUS_DATA, temp_contact->id);
+		xrd_var(out, "contact_name", "%s", temp_contact->name);
+		xrd_var(out, "modified_attributes", "%lu", (temp_contact->modified_attributes & ~contact_attribute_mask));
+		xrd_var(out, "modified_host_attributes", "%lu", (temp_contact->modified_host_attributes & ~contact_host_attribute_mask));
+		xrd_var(out, "modified_service_attributes", "%lu", (temp_contact->modified_service_attributes & ~contact_service_attribute_mask));
+		xrd_var(out, "host_notification_period", "%s", (temp_contact->host_notification_period == NULL) ? "" : temp_contact->host_notification_period);
+		xrd_var(out, "service_notification_period", "%s", (temp_contact->service_notification_period == NULL) ? "" : temp_contact->service_notification_period);
+		xrd_var(out, "last_host_notification", "%llu", (unsigned long long)temp_contact->last_host_notification);
+		xrd_var(out, "last_service_notification", "%llu", (unsigned long long)temp_contact->last_service_notification);
+		xrd_var(out, "host_notifications_enabled", "%d", temp_contact->host_notifications_enabled);
+		xrd_var(out, "service_notifications_enabled", "%d", temp_contact->service_notifications_enabled);
 
 		/* custom variables */
-		for(temp_customvariablesmember = temp_contact->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-			if(temp_customvariablesmember->variable_name)
-				fprintf(fp, "_%s=%d;%s\n", temp_customvariablesmember->variable_name, temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
-			}
+		xrd_custom_variables(out, temp_contact->custom_variables);
 
-		fprintf(fp, "}\n");
+		xrd_end(out, saved.contact_sums, temp_contact->id);
 		}
 
 	/* save all comments */
 	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = temp_comment->next) {
 
-		if(temp_comment->comment_type == HOST_COMMENT)
-			fprintf(fp, "hostcomment {\n");
-		else
-			fprintf(fp, "servicecomment {\n");
-		fprintf(fp, "host_name=%s\n", temp_comment->host_name);
+		xrd_begin(out, (temp_comment->comment_type == HOST_COMMENT) ? XRDDEFAULT_HOSTCOMMENT_DATA : XRDDEFAULT_SERVICECOMMENT_DATA, 0);
+		xrd_var(out, "host_name", "%s", temp_comment->host_name);
 		if(temp_comment->comment_type == SERVICE_COMMENT)
-			fprintf(fp, "service_description=%s\n", temp_comment->service_description);
-		fprintf(fp, "entry_type=%d\n", temp_comment->entry_type);
-		fprintf(fp, "comment_id=%lu\n", temp_comment->comment_id);
-		fprintf(fp, "source=%d\n", temp_comment->source);
-		fprintf(fp, "persistent=%d\n", temp_comment->persistent);
-		fprintf(fp, "entry_time=%llu\n", (unsigned long long)temp_comment->entry_time);
-		fprintf(fp, "expires=%d\n", temp_comment->expires);
-		fprintf(fp, "expire_time=%llu\n", (unsigned long long)temp_comment->expire_time);
-		fprintf(fp, "author=%s\n", temp_comment->author);
-		fprintf(fp, "comment_data=%s\n", temp_comment->comment_data);
-		fprintf(fp, "}\n");
+			xrd_var(out, "service_description", "%s", temp_comment->service_description);
+		xrd_var(out, "entry_type", "%d", temp_comment->entry_type);
+		xrd_var(out, "comment_id", "%lu", temp_comment->comment_id);
+		xrd_var(out, "source", "%d", temp_comment->source);
+		xrd_var(out, "persistent", "%d", temp_comment->persistent);
+		xrd_var(out, "entry_time", "%llu", (unsigned long long)temp_comment->entry_time);
+		xrd_var(out, "expires", "%d", temp_comment->expires);
+		xrd_var(out, "expire_time", "%llu", (unsigned long long)temp_comment->expire_time);
+		xrd_var(out, "author", "%s", temp_comment->author);
+		xrd_var(out, "comment_data", "%s", temp_comment->comment_data);
+		xrd_end(out, NULL, 0);
 		}
 
 	/* save all downtime */
 	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
 
-		if(temp_downtime->type == HOST_DOWNTIME)
-			fprintf(fp, "hostdowntime {\n");
-		else
-			fprintf(fp, "servicedowntime {\n");
-		fprintf(fp, "host_name=%s\n", temp_downtime->host_name);
+		xrd_begin(out, (temp_downtime->type == HOST_DOWNTIME) ? XRDDEFAULT_HOSTDOWNTIME_DATA : XRDDEFAULT_SERVICEDOWNTIME_DATA, 0);
+		xrd_var(out, "host_name", "%s", temp_downtime->host_name);
 		if(temp_downtime->type == SERVICE_DOWNTIME)
-			fprintf(fp, "service_description=%s\n", temp_downtime->service_description);
-		fprintf(fp, "comment_id=%lu\n", temp_downtime->comment_id);
-		fprintf(fp, "downtime_id=%lu\n", temp_downtime->downtime_id);
-		fprintf(fp, "entry_time=%llu\n", (unsigned long long)temp_downtime->entry_time);
-		fprintf(fp, "start_time=%llu\n", (unsigned long long)temp_downtime->start_time);
-		fprintf(fp, "flex_downtime_start=%llu\n", (unsigned long long)temp_downtime->flex_downtime_start);
-		fprintf(fp, "end_time=%llu\n", (unsigned long long)temp_downtime->end_time);
-		fprintf(fp, "triggered_by=%lu\n", temp_downtime->triggered_by);
-		fprintf(fp, "fixed=%d\n", temp_downtime->fixed);
-		fprintf(fp, "duration=%lu\n", temp_downtime->duration);
-		fprintf(fp, "is_in_effect=%d\n", temp_downtime->is_in_effect);
-		fprintf(fp, "start_notification_sent=%d\n", temp_downtime->start_notification_sent);
-		fprintf(fp, "author=%s\n", temp_downtime->author);
-		fprintf(fp, "comment=%s\n", temp_downtime->comment);
-		fprintf(fp, "}\n");
+			xrd_var(out, "service_description", "%s", temp_downtime->service_description);
+		xrd_var(out, "comment_id", "%lu", temp_downtime->comment_id);
+		xrd_var(out, "downtime_id", "%lu", temp_downtime->downtime_id);
+		xrd_var(out, "entry_time", "%llu", (unsigned long long)temp_downtime->entry_time);
+		xrd_var(out, "start_time", "%llu", (unsigned long long)temp_downtime->start_time);
+		xrd_var(out, "flex_downtime_start", "%llu", (unsigned long long)temp_downtime->flex_downtime_start);
+		xrd_var(out, "end_time", "%llu", (unsigned long long)temp_downtime->end_time);
+		xrd_var(out, "triggered_by", "%lu", temp_downtime->triggered_by);
+		xrd_var(out, "fixed", "%d", temp_downtime->fixed);
+		xrd_var(out, "duration", "%lu", temp_downtime->duration);
+		xrd_var(out, "is_in_effect", "%d", temp_downtime->is_in_effect);
+		xrd_var(out, "start_notification_sent", "%d", temp_downtime->start_notification_sent);
+		xrd_var(out, "author", "%s", temp_downtime->author);
+		xrd_var(out, "comment", "%s", temp_downtime->comment);
+		xrd_end(out, NULL, 0);
+		}
+
+	}
+
+
+/*
+ * appends an incremental segment with the objects that changed since
+ * the last save to the binary retention file we wrote last
+ */
+static int xrddefault_append_state_information(void) {
+	xrd_output out;
+	struct stat st;
+	FILE *fp = NULL;
+	int fd = -1;
+
+	/* rewrite the file when someone else did, or when the changes start to outgrow it */
+	if(saved.host_sums == NULL || saved.num_hosts != num_objects.hosts || saved.num_services != num_objects.services || saved.num_contacts != num_objects.contacts)
+		return ERROR;
+	if(stat(retention_file, &st) < 0 || st.st_ino != saved.ino || st.st_size != saved.size)
+		return ERROR;
+	if(saved.size - saved.full_size > saved.full_size / 2)
+		return ERROR;
+
+	log_debug_info(DEBUGL_RETENTIONDATA, 2, "Appending changed retention data to '%s'\n", retention_file);
+
+	if((fd = open(retention_file, O_WRONLY)) == -1)
+		return ERROR;
+
+	/* the segment header says how much follows once it's all there */
+	if(lseek(fd, saved.size, SEEK_SET) < 0 || (fp = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		return ERROR;
+		}
+
+	memset(&out, 0, sizeof(out));
+	out.fp = fp;
+	out.binary = TRUE;
+	out.incremental = TRUE;
+
+	if(xrd_write_segment_header(fp, XRDDEFAULT_SEGMENT_INCREMENTAL, 0, 0) == ERROR)
+		out.error = TRUE;
+	else
+		xrddefault_write_state(&out);
+	my_free(out.buf);
+
+	if(out.error == FALSE && fflush(fp) == 0 && fseeko(fp, saved.size, SEEK_SET) == 0 &&
+	   xrd_write_segment_header(fp, XRDDEFAULT_SEGMENT_INCREMENTAL, out.records, out.bytes) == OK &&
+	   fflush(fp) == 0 && fsync(fd) == 0 && fclose(fp) == 0) {
+
+		saved.size += XRDDEFAULT_SEGMENT_HEADER_LEN + out.bytes;
+		log_debug_info(DEBUGL_RETENTIONDATA, 2, "Appended %u retention records (%llu bytes)\n", out.records, out.bytes);
+		return OK;
+		}
+
+	/* leave the file as it was */
+	if(ftruncate(fd, saved.size) < 0)
+		saved.size = 0;
+	fclose(fp);
+
+	return ERROR;
+	}
+
+
+int xrddefault_save_state_information(void) {
+	char *tmp_file = NULL;
+	int result = OK;
+	FILE *fp = NULL;
+	int fd = 0;
+	xrd_output out;
+	struct stat st;
+
+
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "xrddefault_save_state_information()\n");
+
+	/* make sure we have everything */
+	if(retention_file == NULL || temp_file == NULL) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: We don't have the required file names to store retention data!\n");
+		return ERROR;
+		}
+
+	/*
+	 * binary files only get what changed, as long as that's cheaper than
+	 * rewriting them. The save on the way out is always a full one, since
+	 * appended records leave out check times that didn't come with any
+	 * other change, and the next start needs them to schedule checks and
+	 * judge freshness.
+	 */
+	if(use_binary_retention_file == TRUE) {
+		if(sigshutdown == FALSE && sigrestart == FALSE && xrddefault_append_state_information() == OK)
+			return OK;
+		if(xrd_alloc_checksums() == ERROR)
+			return ERROR;
+		}
+	else
+		xrd_free_checksums();
+
+	/* open a safe temp file for output */
+	asprintf(&tmp_file, "%sXXXXXX", temp_file);
+	if(tmp_file == NULL)
+		return ERROR;
+	if((fd = mkstemp(tmp_file)) == -1)
+		return ERROR;
+
+	log_debug_info(DEBUGL_RETENTIONDATA, 2, "Writing retention data to temp file '%s'\n", tmp_file);
+
+	fp = (FILE *)fdopen(fd, "w");
+	if(fp == NULL) {
+
+		close(fd);
+		unlink(tmp_file);
+
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Could not open temp state retention file '%s' for writing!\n", tmp_file);
+
+		my_free(tmp_file);
+
+		return ERROR;
+		}
+
+	memset(&out, 0, sizeof(out));
+	out.fp = fp;
+	out.binary = use_binary_retention_file;
+
+	if(out.binary == TRUE) {
+		if(xrd_write_segment_header(fp, XRDDEFAULT_SEGMENT_FULL, 0, 0) == ERROR)
+			out.error = TRUE;
+		}
+	else {
+		/* write version info to status file */
+		fprintf(fp, "########################################\n");
+		fprintf(fp, "#      NAGIOS STATE RETENTION FILE\n");
+		fprintf(fp, "#\n");
+		fprintf(fp, "# THIS FILE IS AUTOMATICALLY GENERATED\n");
+		fprintf(fp, "# BY NAGIOS.  DO NOT MODIFY THIS FILE!\n");
+		fprintf(fp, "########################################\n");
+		}
+
+	if(out.error == FALSE)
+		xrddefault_write_state(&out);
+	my_free(out.buf);
+
+	/* now that we know what's in it, fill in the segment header */
+	if(out.binary == TRUE && out.error == FALSE) {
+		if(fflush(fp) != 0 || fseeko(fp, 0, SEEK_SET) != 0 || xrd_write_segment_header(fp, XRDDEFAULT_SEGMENT_FULL, out.records, out.bytes) == ERROR)
+			out.error = TRUE;
 		}
 
 	fflush(fp);
 	fsync(fd);
+	if(fstat(fd, &st) < 0)
+		out.error = TRUE;
 	result = fclose(fp);
+	if(out.error == TRUE) {
+		result = -1;
+		if(errno == 0)
+			errno = EIO;
+		}
 
 	/* save/close was successful */
 	if(result == 0) {
@@ -425,6 +828,16 @@ int xrddefault_save_state_information(void) {
 		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to save retention file: %s", strerror(errno));
 		}
 
+	/* remember what we wrote, so the next save can append to it */
+	if(out.binary == TRUE) {
+		if(result == OK) {
+			saved.full_size = saved.size = st.st_size;
+			saved.ino = st.st_ino;
+			}
+		else
+			xrd_free_checksums();
+		}
+
 	/* free memory */
 	my_free(tmp_file);
 
@@ -438,11 +851,458 @@ int xrddefault_save_state_information(void) {
 /***************** DEFAULT STATE INPUT FUNCTION *******************/
 /******************************************************************/
 
-int xrddefault_read_state_information(void) {
+/* what xrd_next() found */
+#define XRD_EOF          0
+#define XRD_BLOCK_START  1
+#define XRD_BLOCK_END    2
+#define XRD_VAR          3
+
+/* binary files with fewer records than this aren't worth the threads */
+#define XRD_PARALLEL_MIN_RECORDS 10000
+#define XRD_MAX_THREADS          8
+
+/* a record in a binary retention file */
+typedef struct xrd_record {
+	int data_type;
+	unsigned int id;
+	unsigned int segment;
+	unsigned int len;
+	char *payload;
+	void *obj;                  /* the host, service or contact it's for */
+	int skip;                   /* name variables already used to find 'obj' */
+	} xrd_record;
+
+/* a retention file being read, in either format */
+typedef struct xrd_input {
+	mmapfile *thefile;          /* text files */
+	char *inputbuf;
+	char *map;                  /* binary files */
+	size_t map_len;
+	xrd_record *recs;
+	unsigned int num_recs;
+	unsigned int *order;        /* the records to use, in the order to use them */
+	unsigned int num_order;
+	unsigned int next;
+	struct kvvec kvv;
+	int next_pair;
+	int in_block;
+	int data_type;              /* the current block */
+	void *obj;
+	} xrd_input;
+
+struct xrd_resolver {
+	xrd_record *recs;
+	unsigned int start, end;
+	};
+
+
+/*
+ * returns the value of the variable at '*offset' in a record's payload
+ * if it is named 'key', without modifying the payload
+ */
+static char *xrd_peek_value(xrd_record *rec, unsigned int *offset, const char *key) {
+	unsigned int klen, vlen;
+	char *buf = rec->payload + *offset;
+	size_t left = rec->len - *offset;
+
+	if(left < 10)
+		return NULL;
+	klen = xrd_get_u32(buf);
+	vlen = xrd_get_u32(buf + 4);
+	if((size_t)klen + vlen > left - 10 || buf[8 + klen] != '\0' || buf[9 + klen + vlen] != '\0')
+		return NULL;
+	if(strcmp(buf + 8, key))
+		return NULL;
+
+	*offset += 10 + klen + vlen;
+	return buf + 9 + klen;
+	}
+
+
+/*
+ * finds the object a record is for, trusting the saved id as long as
+ * the names still match. Only reads the object hashes, so it's safe to
+ * run for several records at once
+ */
+static void xrd_resolve_record(xrd_record *rec) {
+	unsigned int offset = 0;
+	char *name = NULL;
+	char *description = NULL;
+	host *temp_host = NULL;
+	service *temp_service = NULL;
+	contact *temp_contact = NULL;
+
+	switch(rec->data_type) {
+
+		case XRDDEFAULT_HOSTSTATUS_DATA:
+			if((name = xrd_peek_value(rec, &offset, "host_name")) == NULL)
+				return;
+			if(rec->id < num_objects.hosts && !strcmp(host_ary[rec->id]->name, name))
+				temp_host = host_ary[rec->id];
+			else
+				temp_host = find_host(name);
+			rec->obj = temp_host;
+			rec->skip = 1;
+			break;
+
+		case XRDDEFAULT_SERVICESTATUS_DATA:
+			if((name = xrd_peek_value(rec, &offset, "host_name")) == NULL)
+				return;
+			if((description = xrd_peek_value(rec, &offset, "service_description")) == NULL)
+				return;
+			if(rec->id < num_objects.services && !strcmp(service_ary[rec->id]->host_name, name) && !strcmp(service_ary[rec->id]->description, description))
+				temp_service = service_ary[rec->id];
+			else
+				temp_service = find_service(name, description);
+			rec->obj = temp_service;
+			rec->skip = 2;
+			break;
+
+		case XRDDEFAULT_CONTACTSTATUS_DATA:
+			if((name = xrd_peek_value(rec, &offset, "contact_name")) == NULL)
+				return;
+			if(rec->id < num_objects.contacts && !strcmp(contact_ary[rec->id]->name, name))
+				temp_contact = contact_ary[rec->id];
+			else
+				temp_contact = find_contact(name);
+			rec->obj = temp_contact;
+			rec->skip = 1;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+
+static void *xrd_resolve_records(void *arg) {
+	struct xrd_resolver *r = (struct xrd_resolver *)arg;
+	unsigned int i;
+
+	for(i = r->start; i < r->end; i++)
+		xrd_resolve_record(&r->recs[i]);
+
+	return NULL;
+	}
+
+
+/* how many threads to resolve 'num_recs' records on */
+static int xrd_resolve_threads(unsigned int num_recs) {
+	int threads;
+
+	if(num_recs < XRD_PARALLEL_MIN_RECORDS)
+		return 1;
+	threads = online_cpus();
+
+	return (threads > XRD_MAX_THREADS) ? XRD_MAX_THREADS : threads;
+	}
+
+
+/* resolves all records, splitting the work across 'threads' threads */
+static void xrd_resolve_all(xrd_input *in, int threads) {
+	struct xrd_resolver r[XRD_MAX_THREADS];
+	pthread_t tid[XRD_MAX_THREADS];
+	int started[XRD_MAX_THREADS];
+	unsigned int per_thread;
+	int i;
+
+	if(threads > XRD_MAX_THREADS)
+		threads = XRD_MAX_THREADS;
+
+	per_thread = in->num_recs / threads + 1;
+	for(i = 0; i < threads; i++) {
+		r[i].recs = in->recs;
+		r[i].start = i * per_thread;
+		r[i].end = r[i].start + per_thread;
+		if(r[i].start > in->num_recs)
+			r[i].start = in->num_recs;
+		if(r[i].end > in->num_recs)
+			r[i].end = in->num_recs;
+
+		/* the main thread takes the first share */
+		started[i] = (i > 0 && pthread_create(&tid[i], NULL, xrd_resolve_records, &r[i]) == 0);
+		}
+
+	for(i = 0; i < threads; i++) {
+		if(i == 0 || started[i] == FALSE)
+			xrd_resolve_records(&r[i]);
+		}
+	for(i = 1; i < threads; i++) {
+		if(started[i] == TRUE)
+			pthread_join(tid[i], NULL);
+		}
+
+	log_debug_info(DEBUGL_RETENTIONDATA, 2, "Resolved %u retention records using %d thread(s)\n", in->num_recs, threads);
+	}
+
+
+/*
+ * finds the records of all complete segments in a binary retention
+ * file and decides which of them to use: the last record of each
+ * object, and everything else from the last segment
+ */
+static int xrd_index_binary(xrd_input *in) {
+	unsigned long long seg_len;
+	unsigned int seg_records, segment = 0;
+	unsigned int *last_host = NULL, *last_service = NULL, *last_contact = NULL;
+	unsigned int i, *last;
+	size_t offset = 0, seg_end, size = 0;
+	xrd_record *rec, *recs;
+	char *hdr;
+	int pass;
+
+	while(in->map_len - offset >= XRDDEFAULT_SEGMENT_HEADER_LEN) {
+		hdr = in->map + offset;
+		if(memcmp(hdr, XRDDEFAULT_BINARY_MAGIC, 8))
+			break;
+		if(xrd_get_u32(hdr + 8) != XRDDEFAULT_BINARY_VERSION) {
+			if(segment == 0) {
+				logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Retention file '%s' has unsupported binary format version %u\n", retention_file, xrd_get_u32(hdr + 8));
+				return ERROR;
+				}
+			break;
+			}
+		seg_records = xrd_get_u32(hdr + 16);
+		seg_len = ((unsigned long long)xrd_get_u32(hdr + 24) << 32) | xrd_get_u32(hdr + 28);
+
+		/* an unfinished segment means the save was interrupted */
+		if(seg_records == 0 || seg_len > in->map_len - offset - XRDDEFAULT_SEGMENT_HEADER_LEN)
+			break;
+
+		segment++;
+		offset += XRDDEFAULT_SEGMENT_HEADER_LEN;
+		seg_end = offset + seg_len;
+		for(i = 0; i < seg_records && seg_end - offset >= XRDDEFAULT_RECORD_HEADER_LEN; i++) {
+			if(in->num_recs >= size) {
+				size = size ? size * 2 : 4096;
+				if((recs = realloc(in->recs, size * sizeof(xrd_record))) == NULL)
+					return ERROR;
+				in->recs = recs;
+				}
+			rec = &in->recs[in->num_recs];
+			rec->data_type = xrd_get_u32(in->map + offset);
+			rec->id = xrd_get_u32(in->map + offset + 4);
+			rec->len = xrd_get_u32(in->map + offset + 8);
+			offset += XRDDEFAULT_RECORD_HEADER_LEN;
+			if(rec->len > seg_end - offset)
+				break;
+			rec->payload = in->map + offset;
+			rec->segment = segment;
+			rec->obj = NULL;
+			rec->skip = 0;
+			offset += rec->len;
+			if(rec->data_type > XRDDEFAULT_NO_DATA && rec->data_type <= XRDDEFAULT_SERVICEDOWNTIME_DATA)
+				in->num_recs++;
+			}
+		offset = seg_end;
+		}
+
+	if(segment == 0) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Retention file '%s' has no complete binary segments\n", retention_file);
+		return OK;
+		}
+
+	log_debug_info(DEBUGL_RETENTIONDATA, 2, "Read %u retention records from %u segment(s)\n", in->num_recs, segment);
+
+	xrd_resolve_all(in, xrd_resolve_threads(in->num_recs));
+
+	in->order = malloc((in->num_recs + 1) * sizeof(unsigned int));
+	last_host = calloc(num_objects.hosts + 1, sizeof(unsigned int));
+	last_service = calloc(num_objects.services + 1, sizeof(unsigned int));
+	last_contact = calloc(num_objects.contacts + 1, sizeof(unsigned int));
+	if(in->order == NULL || last_host == NULL || last_service == NULL || last_contact == NULL) {
+		my_free(last_host);
+		my_free(last_service);
+		my_free(last_contact);
+		return ERROR;
+		}
+
+	/* which record of each object came last? */
+	for(i = 0; i < in->num_recs; i++) {
+		rec = &in->recs[i];
+		if(rec->obj == NULL)
+			continue;
+		if(rec->data_type == XRDDEFAULT_HOSTSTATUS_DATA)
+			last_host[((host *)rec->obj)->id] = i + 1;
+		else if(rec->data_type == XRDDEFAULT_SERVICESTATUS_DATA)
+			last_service[((service *)rec->obj)->id] = i + 1;
+		else if(rec->data_type == XRDDEFAULT_CONTACTSTATUS_DATA)
+			last_contact[((contact *)rec->obj)->id] = i + 1;
+		}
+
+	/* same order as in text files: program state, objects, comments, downtime */
+	for(pass = 0; pass < 3; pass++) {
+		for(i = 0; i < in->num_recs; i++) {
+			rec = &in->recs[i];
+			last = NULL;
+			switch(rec->data_type) {
+				case XRDDEFAULT_INFO_DATA:
+				case XRDDEFAULT_PROGRAMSTATUS_DATA:
+					if(pass != 0 || rec->segment != segment)
+						continue;
+					break;
+				case XRDDEFAULT_HOSTSTATUS_DATA:
+					last = (rec->obj) ? &last_host[((host *)rec->obj)->id] : NULL;
+					break;
+				case XRDDEFAULT_SERVICESTATUS_DATA:
+					last = (rec->obj) ? &last_service[((service *)rec->obj)->id] : NULL;
+					break;
+				case XRDDEFAULT_CONTACTSTATUS_DATA:
+					last = (rec->obj) ? &last_contact[((contact *)rec->obj)->id] : NULL;
+					break;
+				default:
+					if(pass != 2 || rec->segment != segment)
+						continue;
+					break;
+				}
+			if(rec->data_type >= XRDDEFAULT_HOSTSTATUS_DATA && rec->data_type <= XRDDEFAULT_CONTACTSTATUS_DATA) {
+				if(pass != 1 || last == NULL || *last != i + 1)
+					continue;
+				}
+			in->order[in->num_order++] = i;
+			}
+		}
+
+	my_free(last_host);
+	my_free(last_service);
+	my_free(last_contact);
+
+	return OK;
+	}
+
+
+/* opens a retention file, figuring out which format it's in */
+static int xrd_open(xrd_input *in, const char *path) {
+	struct stat st;
+	char magic[8];
+	int fd;
+
+	memset(in, 0, sizeof(*in));
+
+	if((fd = open(path, O_RDONLY)) == -1)
+		return ERROR;
+	if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(magic) || read(fd, magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, XRDDEFAULT_BINARY_MAGIC, sizeof(magic))) {
+		close(fd);
+		if((in->thefile = mmap_fopen(path)) == NULL)
+			return ERROR;
+		return OK;
+		}
+
+	/* payloads get parsed in place, so we need a private writable copy */
+	in->map_len = st.st_size;
+	in->map = mmap(NULL, in->map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(in->map == MAP_FAILED) {
+		in->map = NULL;
+		return ERROR;
+		}
+
+	log_debug_info(DEBUGL_RETENTIONDATA, 2, "Reading binary retention file '%s'\n", path);
+
+	return xrd_index_binary(in);
+	}
+
+
+static void xrd_close(xrd_input *in) {
+
+	if(in->thefile != NULL) {
+		my_free(in->inputbuf);
+		mmap_fclose(in->thefile);
+		}
+	if(in->map != NULL)
+		munmap(in->map, in->map_len);
+	my_free(in->recs);
+	my_free(in->order);
+	my_free(in->kvv.kv);
+	}
+
+
+/*
+ * returns the next event in a retention file, with 'var' and 'val'
+ * set for variables
+ */
+static int xrd_next(xrd_input *in, char **var, char **val) {
+	xrd_record *rec = NULL;
 	char *input = NULL;
-	char *inputbuf = NULL;
+	char *ch = NULL;
+	int x = 0;
+
+	/* binary files */
+	if(in->thefile == NULL) {
+		if(in->in_block == TRUE) {
+			if(in->next_pair < in->kvv.kv_pairs) {
+				*var = in->kvv.kv[in->next_pair].key;
+				*val = in->kvv.kv[in->next_pair].value;
+				in->next_pair++;
+				return XRD_VAR;
+				}
+			in->in_block = FALSE;
+			return XRD_BLOCK_END;
+			}
+
+		while(in->next < in->num_order) {
+			rec = &in->recs[in->order[in->next++]];
+			if(bbuf2kvvec_prealloc(&in->kvv, rec->payload, rec->len, KVVEC_ASSIGN) < 0) {
+				log_debug_info(DEBUGL_RETENTIONDATA, 1, "Skipping corrupt retention record of type %d\n", rec->data_type);
+				continue;
+				}
+			in->in_block = TRUE;
+			in->data_type = rec->data_type;
+			in->obj = rec->obj;
+			in->next_pair = (rec->obj != NULL) ? rec->skip : 0;
+			return XRD_BLOCK_START;
+			}
+
+		return XRD_EOF;
+		}
+
+	/* text files */
+	while(1) {
+
+		/* free memory */
+		my_free(in->inputbuf);
+
+		/* read the next line */
+		if((in->inputbuf = mmap_fgets(in->thefile)) == NULL)
+			return XRD_EOF;
+
+		input = in->inputbuf;
+
+		/* far better than strip()ing */
+		if(input[0] == '\t')
+			input++;
+
+		strip(input);
+
+		if(!strcmp(input, "}"))
+			return XRD_BLOCK_END;
+
+		if((ch = strchr(input, ' ')) != NULL && !strcmp(ch, " {")) {
+			for(x = XRDDEFAULT_INFO_DATA; x <= XRDDEFAULT_SERVICEDOWNTIME_DATA; x++) {
+				if(!strncmp(input, xrd_block_names[x], ch - input) && xrd_block_names[x][ch - input] == '\0') {
+					in->data_type = x;
+					in->obj = NULL;
+					return XRD_BLOCK_START;
+					}
+				}
+			}
+
+		/* slightly faster than strtok () */
+		*var = input;
+		if((*val = strchr(input, '=')) == NULL)
+			continue;
+		(*val)[0] = '\x0';
+		(*val)++;
+
+		return XRD_VAR;
+		}
+	}
+
+
+int xrddefault_read_state_information(void) {
+	xrd_input in;
+	int event = XRD_EOF;
 	char *temp_ptr = NULL;
-	mmapfile *thefile;
 	char *host_name = NULL;
 	char *service_description = NULL;
 	char *contact_name = NULL;
@@ -510,8 +1370,10 @@ int xrddefault_read_state_information(void) {
 		gettimeofday(&tv[0], NULL);
 
 	/* open the retention file for reading */
-	if((thefile = mmap_fopen(retention_file)) == NULL)
+	if(xrd_open(&in, retention_file) == ERROR) {
+		xrd_close(&in);
 		return ERROR;
+		}
 
 	/* what attributes should be masked out? */
 	/* NOTE: host/service/contact-specific values may be added in the future, but for now we only have global masks */
@@ -526,44 +1388,25 @@ int xrddefault_read_state_information(void) {
 	defer_downtime_sorting = 1;
 	defer_comment_sorting = 1;
 
-	/* read all lines in the retention file */
-	while(1) {
-
-		/* free memory */
-		my_free(inputbuf);
-
-		/* read the next line */
-		if((inputbuf = mmap_fgets(thefile)) == NULL)
-			break;
+	/* read all blocks in the retention file */
+	while((event = xrd_next(&in, &var, &val)) != XRD_EOF) {
 
-		input = inputbuf;
+		if(event == XRD_BLOCK_START) {
 
-		/* far better than strip()ing */
-		if(input[0] == '\t')
-			input++;
+			data_type = in.data_type;
 
-		strip(input);
+			/* binary files have already found the object */
+			if(in.obj != NULL) {
+				if(data_type == XRDDEFAULT_HOSTSTATUS_DATA)
+					temp_host = (host *)in.obj;
+				else if(data_type == XRDDEFAULT_SERVICESTATUS_DATA)
+					temp_service = (service *)in.obj;
+				else if(data_type == XRDDEFAULT_CONTACTSTATUS_DATA)
+					temp_contact = (contact *)in.obj;
+				}
+			}
 
-		if(!strcmp(input, "service {"))
-			data_type = XRDDEFAULT_SERVICESTATUS_DATA;
-		else if(!strcmp(input, "host {"))
-			data_type = XRDDEFAULT_HOSTSTATUS_DATA;
-		else if(!strcmp(input, "contact {"))
-			data_type = XRDDEFAULT_CONTACTSTATUS_DATA;
-		else if(!strcmp(input, "hostcomment {"))
-			data_type = XRDDEFAULT_HOSTCOMMENT_DATA;
-		else if(!strcmp(input, "servicecomment {"))
-			data_type = XRDDEFAULT_SERVICECOMMENT_DATA;
-		else if(!strcmp(input, "hostdowntime {"))
-			data_type = XRDDEFAULT_HOSTDOWNTIME_DATA;
-		else if(!strcmp(input, "servicedowntime {"))
-			data_type = XRDDEFAULT_SERVICEDOWNTIME_DATA;
-		else if(!strcmp(input, "info {"))
-			data_type = XRDDEFAULT_INFO_DATA;
-		else if(!strcmp(input, "program {"))
-			data_type = XRDDEFAULT_PROGRAMSTATUS_DATA;
-
-		else if(!strcmp(input, "}")) {
+		else if(event == XRD_BLOCK_END) {
 
 			switch(data_type) {
 
@@ -832,13 +1675,6 @@ int xrddefault_read_state_information(void) {
 
 		else if(data_type != XRDDEFAULT_NO_DATA) {
 
-			/* slightly faster than strtok () */
-			var = input;
-			if((val = strchr(input, '=')) == NULL)
-				continue;
-			val[0] = '\x0';
-			val++;
-
 			found_directive = TRUE;
 
 			switch(data_type) {
@@ -1684,8 +2520,7 @@ int xrddefault_read_state_information(void) {
 		}
 
 	/* free memory and close the file */
-	my_free(inputbuf);
-	mmap_fclose(thefile);
+	xrd_close(&in);
 
 	if(sort_downtime() != OK)
 		return ERROR;
@@ -35,6 +35,43 @@
 #define XRDDEFAULT_HOSTDOWNTIME_DATA     8
 #define XRDDEFAULT_SERVICEDOWNTIME_DATA  9
 
+/*
+ * Binary retention files
+ *
+ * A binary retention file is one full segment, holding the state of
+ * everything, followed by any number of incremental segments that
+ * only hold the hosts, services and contacts whose state changed
+ * since they were last written. Program state, comments and downtime
+ * are written in full in every segment, and only those of the last
+ * complete segment are read back.
+ *
+ * Segment header (all numbers in network byte order):
+ *   magic (8 bytes), version (4), segment type (4), number of
+ *   records (4), reserved (4), length of the records that follow (8)
+ *
+ * Record header:
+ *   block type (4, one of the XRDDEFAULT_*_DATA above), object id (4),
+ *   payload length (4)
+ *
+ * The payload is a binary key/value vector (see kvvec2bbuf()) with
+ * the same variables as the corresponding text block. Object ids are
+ * the host, service or contact id at the time the record was written,
+ * and the names at the start of the payload decide if they're still
+ * valid. When an object has several records, the last one wins.
+ * Check times, execution time and latency change with every check, so
+ * they don't count as a change of state, and records only carry their
+ * latest values when something else changed too. The save made when
+ * shutting down or restarting always writes a full segment, so they're
+ * current when the file is read back.
+ */
+#define XRDDEFAULT_BINARY_MAGIC          "NAGRTN\r\n"
+#define XRDDEFAULT_BINARY_VERSION        1
+#define XRDDEFAULT_SEGMENT_HEADER_LEN    32
+#define XRDDEFAULT_RECORD_HEADER_LEN     12
+
+#define XRDDEFAULT_SEGMENT_FULL          1
+#define XRDDEFAULT_SEGMENT_INCREMENTAL   2
+
 int xrddefault_initialize_retention_data(const char *);
 int xrddefault_cleanup_retention_data(void);
 int xrddefault_save_state_information(void);        /* saves all host and service state information */
@@ -60,11 +60,339 @@ int program_stats[MAX_CHECK_STATS_TYPES][3];
 
 #ifdef NSCORE
 
+/*
+ * When status_snapshot_file is set, status data is also kept in a
+ * binary snapshot that's rewritten only every so often, plus a delta
+ * log with the objects that changed since. Readers replay the delta
+ * log on top of the snapshot, so each status update only costs as
+ * much as the number of objects that actually changed.
+ */
+static char *status_delta_file;
+static int status_delta_fd = -1;
+static unsigned long long status_generation;
+static time_t last_status_compaction;
+static off_t status_snapshot_size;
+static off_t status_delta_size;
+static bitmap *dirty_hosts;
+static bitmap *dirty_services;
+static bitmap *dirty_contacts;
+
+/*
+ * All status data is written through one of these, so the same code
+ * produces the text status file as well as the records of the binary
+ * snapshot and delta log. A binary record is its type byte followed
+ * by its fields and a zero key id. Each field is the key id, the
+ * length of the value and the value itself, with all numbers written
+ * as 7-bit varints. The first time a key is used in a file, its id
+ * is followed by the length and name of the key, so readers can build
+ * the same key table as they go.
+ */
+struct xsd_writer {
+	FILE *fp;               /* text output, or NULL for binary */
+	int fd;                 /* binary output, or -1 to keep it in buf */
+	int error;
+	dkhash_table *keys;     /* key name -> key id */
+	char **key_names;
+	unsigned int num_keys;
+	char *buf;
+	size_t len;
+	size_t size;
+	char *scratch;
+	size_t scratch_size;
+	};
+
+static struct xsd_writer status_delta_writer = { NULL, -1 };
+
+static const char *xsd_record_names[] = {
+	NULL, "info", "programstatus", "hoststatus", "servicestatus",
+	"contactstatus", "hostcomment", "servicecomment", "hostdowntime",
+	"servicedowntime",
+	};
+
+/* the shared memory status segment, when status_shm_file is set */
+static struct xsddefault_shm_header *status_shm;
+static size_t status_shm_size;
+
+
+
+/******************************************************************/
+/**************** SHARED MEMORY STATUS FUNCTIONS ******************/
+/******************************************************************/
+
+static inline struct xsddefault_shm_record *xsd_shm_record(unsigned int i) {
+	return (struct xsddefault_shm_record *)((char *)status_shm + status_shm->records + (size_t)i * sizeof(struct xsddefault_shm_record));
+	}
+
+
+/* seqlock writer side; readers retry if they see an odd or changed sequence number */
+static inline void xsd_shm_write_begin(volatile uint32_t *seq) {
+	(*seq)++;
+	__sync_synchronize();
+	}
+
+static inline void xsd_shm_write_end(volatile uint32_t *seq) {
+	__sync_synchronize();
+	(*seq)++;
+	}
+
+
+/* copies a string into the text area of a record, leaving room for the ones after it */
+static uint16_t xsd_shm_put_text(char **p, size_t *left, const char *str, size_t reserve) {
+	size_t len = str ? strlen(str) : 0;
+
+	if(len > *left - 1 - reserve)
+		len = *left - 1 - reserve;
+	memcpy(*p, str ? str : "", len);
+	(*p)[len] = 0;
+	*p += len + 1;
+	*left -= len + 1;
+	return len;
+	}
+
+
+static void xsd_shm_set_text(struct xsddefault_shm_record *r, const char *plugin_output, const char *perf_data, const char *long_plugin_output) {
+	size_t left = sizeof(r->text);
+	char *p = r->text;
+
+	r->plugin_output_len = xsd_shm_put_text(&p, &left, plugin_output, 2);
+	r->perf_data_len = xsd_shm_put_text(&p, &left, perf_data, 1);
+	r->long_plugin_output_len = xsd_shm_put_text(&p, &left, long_plugin_output, 0);
+	}
+
+
+static void xsd_shm_write_host(host *hst) {
+	struct xsddefault_shm_record *r;
+
+	if(status_shm == NULL || hst->id >= status_shm->num_hosts)
+		return;
+	r = xsd_shm_record(hst->id);
+
+	xsd_shm_write_begin(&r->seq);
+	r->has_been_checked = hst->has_been_checked;
+	r->should_be_scheduled = hst->should_be_scheduled;
+	r->check_type = hst->check_type;
+	r->current_state = hst->current_state;
+	r->last_hard_state = hst->last_hard_state;
+	r->current_attempt = hst->current_attempt;
+	r->max_attempts = hst->max_attempts;
+	r->state_type = hst->state_type;
+	r->check_options = hst->check_options;
+	r->current_notification_number = hst->current_notification_number;
+	r->no_more_notifications = hst->no_more_notifications;
+	r->notifications_enabled = hst->notifications_enabled;
+	r->problem_has_been_acknowledged = hst->problem_has_been_acknowledged;
+	r->acknowledgement_type = hst->acknowledgement_type;
+	r->checks_enabled = hst->checks_enabled;
+	r->accept_passive_checks = hst->accept_passive_checks;
+	r->event_handler_enabled = hst->event_handler_enabled;
+	r->flap_detection_enabled = hst->flap_detection_enabled;
+	r->process_performance_data = hst->process_performance_data;
+	r->obsess = hst->obsess;
+	r->is_flapping = hst->is_flapping;
+	r->scheduled_downtime_depth = hst->scheduled_downtime_depth;
+	r->last_check = hst->last_check;
+	r->next_check = hst->next_check;
+	r->last_state_change = hst->last_state_change;
+	r->last_hard_state_change = hst->last_hard_state_change;
+	r->last_time[HOST_UP] = hst->last_time_up;
+	r->last_time[HOST_DOWN] = hst->last_time_down;
+	r->last_time[HOST_UNREACHABLE] = hst->last_time_unreachable;
+	r->last_notification = hst->last_notification;
+	r->next_notification = hst->next_notification;
+	r->execution_time = hst->execution_time;
+	r->latency = hst->latency;
+	r->percent_state_change = hst->percent_state_change;
+	xsd_shm_set_text(r, hst->plugin_output, hst->perf_data, hst->long_plugin_output);
+	xsd_shm_write_end(&r->seq);
+	}
+
+
+static void xsd_shm_write_service(service *svc) {
+	struct xsddefault_shm_record *r;
+
+	if(status_shm == NULL || svc->id >= status_shm->num_services)
+		return;
+	r = xsd_shm_record(status_shm->num_hosts + svc->id);
+
+	xsd_shm_write_begin(&r->seq);
+	r->has_been_checked = svc->has_been_checked;
+	r->should_be_scheduled = svc->should_be_scheduled;
+	r->check_type = svc->check_type;
+	r->current_state = svc->current_state;
+	r->last_hard_state = svc->last_hard_state;
+	r->current_attempt = svc->current_attempt;
+	r->max_attempts = svc->max_attempts;
+	r->state_type = svc->state_type;
+	r->check_options = svc->check_options;
+	r->current_notification_number = svc->current_notification_number;
+	r->no_more_notifications = svc->no_more_notifications;
+	r->notifications_enabled = svc->notifications_enabled;
+	r->problem_has_been_acknowledged = svc->problem_has_been_acknowledged;
+	r->acknowledgement_type = svc->acknowledgement_type;
+	r->checks_enabled = svc->checks_enabled;
+	r->accept_passive_checks = svc->accept_passive_checks;
+	r->event_handler_enabled = svc->event_handler_enabled;
+	r->flap_detection_enabled = svc->flap_detection_enabled;
+	r->process_performance_data = svc->process_performance_data;
+	r->obsess = svc->obsess;
+	r->is_flapping = svc->is_flapping;
+	r->scheduled_downtime_depth = svc->scheduled_downtime_depth;
+	r->last_check = svc->last_check;
+	r->next_check = svc->next_check;
+	r->last_state_change = svc->last_state_change;
+	r->last_hard_state_change = svc->last_hard_state_change;
+	r->last_time[STATE_OK] = svc->last_time_ok;
+	r->last_time[STATE_WARNING] = svc->last_time_warning;
+	r->last_time[STATE_CRITICAL] = svc->last_time_critical;
+	r->last_time[STATE_UNKNOWN] = svc->last_time_unknown;
+	r->last_notification = svc->last_notification;
+	r->next_notification = svc->next_notification;
+	r->execution_time = svc->execution_time;
+	r->latency = svc->latency;
+	r->percent_state_change = svc->percent_state_change;
+	xsd_shm_set_text(r, svc->plugin_output, svc->perf_data, svc->long_plugin_output);
+	xsd_shm_write_end(&r->seq);
+	}
+
+
+/* stops using the current segment, telling long-lived readers to let go of it too */
+static void xsd_shm_close(void) {
+	if(status_shm == NULL)
+		return;
+	status_shm->obsolete = 1;
+	munmap(status_shm, status_shm_size);
+	status_shm = NULL;
+	status_shm_size = 0;
+	}
+
+
+/*
+ * Builds a new segment with room for misc_size bytes of text and
+ * moves it into place. Readers that have the old one mapped keep
+ * seeing it until they notice it's obsolete.
+ */
+static int xsd_shm_create(size_t misc_size) {
+	struct xsddefault_shm_header *shm, *old_shm;
+	size_t old_shm_size;
+	struct xsddefault_shm_record *r;
+	size_t strings_size = 1, size;
+	char *tmp_file = NULL, *strings;
+	uint32_t *name_offset = NULL;
+	unsigned int i;
+	int fd;
+
+	/* the name table starts with the empty string, so 0 means "none" */
+	for(i = 0; i < num_objects.hosts; i++)
+		strings_size += strlen(host_ary[i]->name) + 1;
+	for(i = 0; i < num_objects.services; i++)
+		strings_size += strlen(service_ary[i]->description) + 1;
+	strings_size = (strings_size + 7) & ~(size_t)7;
+	misc_size = (misc_size + 7) & ~(size_t)7;
+	size = sizeof(*shm) + sizeof(*r) * ((size_t)num_objects.hosts + num_objects.services) + strings_size + misc_size;
+
+	asprintf(&tmp_file, "%s.XXXXXX", status_shm_file);
+	if(tmp_file == NULL)
+		return ERROR;
+	if((fd = mkstemp(tmp_file)) < 0) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to create temp file '%s' for the status segment: %s\n", tmp_file, strerror(errno));
+		my_free(tmp_file);
+		return ERROR;
+		}
+	if(ftruncate(fd, size) < 0 || (shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to set up status segment '%s': %s\n", tmp_file, strerror(errno));
+		close(fd);
+		unlink(tmp_file);
+		my_free(tmp_file);
+		return ERROR;
+		}
+	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	close(fd);
+
+	memcpy(shm->magic, XSDDEFAULT_SHM_MAGIC, sizeof(shm->magic));
+	shm->header_size = sizeof(*shm);
+	shm->record_size = sizeof(*r);
+	shm->num_hosts = num_objects.hosts;
+	shm->num_services = num_objects.services;
+	shm->records = sizeof(*shm);
+	shm->strings = shm->records + sizeof(*r) * ((size_t)num_objects.hosts + num_objects.services);
+	shm->strings_size = strings_size;
+	shm->misc = shm->strings + strings_size;
+	shm->misc_size = misc_size;
+
+	/* names never change, so they're only written here */
+	strings = (char *)shm + shm->strings;
+	name_offset = calloc(num_objects.hosts + 1, sizeof(*name_offset));
+	strings_size = 1;
+	for(i = 0; i < num_objects.hosts; i++) {
+		r = (struct xsddefault_shm_record *)((char *)shm + shm->records) + i;
+		r->name = strings_size;
+		if(name_offset)
+			name_offset[i] = strings_size;
+		strcpy(strings + strings_size, host_ary[i]->name);
+		strings_size += strlen(host_ary[i]->name) + 1;
+		}
+	for(i = 0; i < num_objects.services; i++) {
+		r = (struct xsddefault_shm_record *)((char *)shm + shm->records) + num_objects.hosts + i;
+		r->description = strings_size;
+		strcpy(strings + strings_size, service_ary[i]->description);
+		strings_size += strlen(service_ary[i]->description) + 1;
+		if(name_offset && service_ary[i]->host_ptr)
+			r->name = name_offset[service_ary[i]->host_ptr->id];
+		}
+	my_free(name_offset);
+
+	/* fill in the records before anyone can see the new segment */
+	old_shm = status_shm;
+	old_shm_size = status_shm_size;
+	status_shm = shm;
+	status_shm_size = size;
+	for(i = 0; i < num_objects.hosts; i++)
+		xsd_shm_write_host(host_ary[i]);
+	for(i = 0; i < num_objects.services; i++)
+		xsd_shm_write_service(service_ary[i]);
+
+	if(my_rename(tmp_file, status_shm_file)) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to update status segment '%s': %s\n", status_shm_file, strerror(errno));
+		unlink(tmp_file);
+		my_free(tmp_file);
+		xsd_shm_close();
+		status_shm = old_shm;
+		status_shm_size = old_shm_size;
+		return ERROR;
+		}
+	my_free(tmp_file);
+
+	if(old_shm) {
+		old_shm->obsolete = 1;
+		munmap(old_shm, old_shm_size);
+		}
+
+	return OK;
+	}
+
+
+
 /******************************************************************/
 /********************* INIT/CLEANUP FUNCTIONS *********************/
 /******************************************************************/
 
 
+/* releases everything a binary writer has allocated */
+static void xsd_writer_reset(struct xsd_writer *w) {
+	unsigned int i;
+
+	if(w->keys)
+		dkhash_destroy(w->keys);
+	for(i = 0; i < w->num_keys; i++)
+		my_free(w->key_names[i]);
+	my_free(w->key_names);
+	my_free(w->buf);
+	my_free(w->scratch);
+	memset(w, 0, sizeof(*w));
+	w->fd = -1;
+	}
+
+
 /* initialize status data */
 int xsddefault_initialize_status_data(const char *cfgfile) {
 	nagios_macros *mac;
@@ -87,6 +415,21 @@ int xsddefault_initialize_status_data(const char *cfgfile) {
 	if(status_file)
 		unlink(status_file);
 
+	/* the first update writes a fresh snapshot */
+	if(status_snapshot_file) {
+		my_free(status_delta_file);
+		if(asprintf(&status_delta_file, "%s.delta", status_snapshot_file) < 0)
+			status_delta_file = NULL;
+		if(status_delta_file == NULL)
+			return ERROR;
+		unlink(status_snapshot_file);
+		unlink(status_delta_file);
+		}
+
+	/* the segment is created along with the first status update */
+	if(status_shm_file)
+		unlink(status_shm_file);
+
 	return OK;
 	}
 
@@ -100,33 +443,652 @@ int xsddefault_cleanup_status_data(int delete_status_data) {
 			return ERROR;
 		}
 
+	if(status_delta_fd >= 0)
+		close(status_delta_fd);
+	status_delta_fd = -1;
+	xsd_writer_reset(&status_delta_writer);
+	bitmap_destroy(dirty_hosts);
+	bitmap_destroy(dirty_services);
+	bitmap_destroy(dirty_contacts);
+	dirty_hosts = dirty_services = dirty_contacts = NULL;
+	if(delete_status_data == TRUE && status_snapshot_file) {
+		unlink(status_snapshot_file);
+		if(status_delta_file)
+			unlink(status_delta_file);
+		}
+
+	xsd_shm_close();
+	if(delete_status_data == TRUE && status_shm_file)
+		unlink(status_shm_file);
+
 	/* free memory */
 	my_free(status_file);
+	my_free(status_snapshot_file);
+	my_free(status_delta_file);
+	my_free(status_shm_file);
+
+	return OK;
+	}
+
+
+/*
+ * The object set was replaced without a restart, so object ids may
+ * now belong to different objects. Drop the delta log and the dirty
+ * bitmaps so the next save writes a full snapshot, and rebuild the
+ * status segment with the new records and names.
+ */
+int xsddefault_reset_object_status_data(void) {
+	if(status_delta_fd >= 0)
+		close(status_delta_fd);
+	status_delta_fd = -1;
+	xsd_writer_reset(&status_delta_writer);
+	bitmap_destroy(dirty_hosts);
+	bitmap_destroy(dirty_services);
+	bitmap_destroy(dirty_contacts);
+	dirty_hosts = dirty_services = dirty_contacts = NULL;
+
+	if(status_shm != NULL)
+		return xsd_shm_create(status_shm->misc_size);
 
 	return OK;
 	}
 
 
+/* updates the status segment and marks objects that need to go into the next delta */
+void xsddefault_update_host_status(host *hst) {
+	xsd_shm_write_host(hst);
+	if(dirty_hosts && hst->id < num_objects.hosts)
+		bitmap_set(dirty_hosts, hst->id);
+	}
+
+void xsddefault_update_service_status(service *svc) {
+	xsd_shm_write_service(svc);
+	if(dirty_services && svc->id < num_objects.services)
+		bitmap_set(dirty_services, svc->id);
+	}
+
+void xsddefault_update_contact_status(contact *cntct) {
+	if(dirty_contacts && cntct->id < num_objects.contacts)
+		bitmap_set(dirty_contacts, cntct->id);
+	}
+
+
+
 /******************************************************************/
 /****************** STATUS DATA OUTPUT FUNCTIONS ******************/
 /******************************************************************/
 
-/* write all status data to file */
-int xsddefault_save_status_data(void) {
-	char *tmp_log = NULL;
-	customvariablesmember *temp_customvariablesmember = NULL;
+/* writes buffered binary records to the writer's file */
+static void xsd_flush(struct xsd_writer *w) {
+	if(w->len && !w->error && nwrite(w->fd, w->buf, w->len, NULL) != (ssize_t)w->len)
+		w->error = errno ? errno : EIO;
+	w->len = 0;
+	}
+
+
+static void xsd_put(struct xsd_writer *w, const void *data, size_t len) {
+	size_t size;
+	char *buf;
+
+	if(w->len + len > w->size) {
+		for(size = w->size ? w->size : 65536; size < w->len + len; size *= 2)
+			;
+		if((buf = realloc(w->buf, size)) == NULL) {
+			w->error = ENOMEM;
+			return;
+			}
+		w->buf = buf;
+		w->size = size;
+		}
+	memcpy(w->buf + w->len, data, len);
+	w->len += len;
+	}
+
+
+static void xsd_put_varint(struct xsd_writer *w, unsigned long long v) {
+	unsigned char b[10];
+	int n = 0;
+
+	do {
+		b[n] = v & 0x7f;
+		v >>= 7;
+		if(v)
+			b[n] |= 0x80;
+		n++;
+		} while(v);
+	xsd_put(w, b, n);
+	}
+
+
+/* writes the id of a key, adding it to the file's key table if it's new */
+static void xsd_put_key(struct xsd_writer *w, const char *key) {
+	unsigned long id;
+	char *name, **names;
+
+	if(w->keys == NULL && (w->keys = dkhash_create_backend(256, DKHASH_BACKEND_OPEN)) == NULL) {
+		w->error = ENOMEM;
+		return;
+		}
+	if((id = (unsigned long)dkhash_get(w->keys, key, NULL))) {
+		xsd_put_varint(w, id);
+		return;
+		}
+
+	names = realloc(w->key_names, sizeof(char *) * (w->num_keys + 1));
+	if(names)
+		w->key_names = names;
+	if(names == NULL || (name = strdup(key)) == NULL) {
+		w->error = ENOMEM;
+		return;
+		}
+	w->key_names[w->num_keys++] = name;
+	dkhash_insert(w->keys, name, NULL, (void *)(unsigned long)w->num_keys);
+	xsd_put_varint(w, w->num_keys);
+	xsd_put_varint(w, strlen(name));
+	xsd_put(w, name, strlen(name));
+	}
+
+
+static void xsd_field(struct xsd_writer *w, const char *key, const char *fmt, ...)
+	__attribute__((__format__(__printf__, 3, 4)));
+
+static void xsd_field(struct xsd_writer *w, const char *key, const char *fmt, ...) {
+	va_list ap;
+	size_t size;
+	char *scratch;
+	int len;
+
+	if(w->fp) {
+		fprintf(w->fp, "\t%s=", key);
+		va_start(ap, fmt);
+		vfprintf(w->fp, fmt, ap);
+		va_end(ap);
+		fputc('\n', w->fp);
+		return;
+		}
+
+	va_start(ap, fmt);
+	len = vsnprintf(w->scratch, w->scratch_size, fmt, ap);
+	va_end(ap);
+	if(len < 0)
+		return;
+	if((size_t)len >= w->scratch_size) {
+		for(size = w->scratch_size ? w->scratch_size : 4096; size <= (size_t)len; size *= 2)
+			;
+		if((scratch = realloc(w->scratch, size)) == NULL) {
+			w->error = ENOMEM;
+			return;
+			}
+		w->scratch = scratch;
+		w->scratch_size = size;
+		va_start(ap, fmt);
+		vsnprintf(w->scratch, w->scratch_size, fmt, ap);
+		va_end(ap);
+		}
+
+	xsd_put_key(w, key);
+	xsd_put_varint(w, len);
+	xsd_put(w, w->scratch, len);
+	}
+
+
+static void xsd_begin(struct xsd_writer *w, unsigned char type) {
+	if(w->fp)
+		fprintf(w->fp, "%s {\n", xsd_record_names[type]);
+	else
+		xsd_put(w, &type, 1);
+	}
+
+
+static void xsd_end(struct xsd_writer *w) {
+	if(w->fp) {
+		fprintf(w->fp, "\t}\n\n");
+		return;
+		}
+	xsd_put_varint(w, 0);
+	if(w->fd >= 0 && w->len >= 65536)
+		xsd_flush(w);
+	}
+
+
+/* binary-only records, such as the end-of-dump marker */
+static void xsd_marker(struct xsd_writer *w, unsigned char type) {
+	if(w->fp == NULL) {
+		xsd_put(w, &type, 1);
+		xsd_put_varint(w, 0);
+		}
+	}
+
+
+static void xsd_custom_variables(struct xsd_writer *w, customvariablesmember *temp_customvariablesmember) {
+	char *key = NULL;
+
+	for(; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
+		if(temp_customvariablesmember->variable_name == NULL)
+			continue;
+		if(asprintf(&key, "_%s", temp_customvariablesmember->variable_name) < 0)
+			continue;
+		xsd_field(w, key, "%d;%s", temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
+		my_free(key);
+		}
+	}
+
+
+/* write file info */
+static void xsd_write_info(struct xsd_writer *w, time_t current_time) {
+	xsd_begin(w, XSDDEFAULT_INFO_DATA);
+	xsd_field(w, "created", "%llu", (unsigned long long)current_time);
+	xsd_field(w, "version", "%s", PROGRAM_VERSION);
+	xsd_field(w, "last_update_check", "%llu", (unsigned long long)last_update_check);
+	xsd_field(w, "update_available", "%d", update_available);
+	xsd_field(w, "last_version", "%s", (last_program_version == NULL) ? "" : last_program_version);
+	xsd_field(w, "new_version", "%s", (new_program_version == NULL) ? "" : new_program_version);
+	xsd_end(w);
+	}
+
+
+/* save program status data */
+static void xsd_write_program_status(struct xsd_writer *w) {
+	xsd_begin(w, XSDDEFAULT_PROGRAMSTATUS_DATA);
+	xsd_field(w, "modified_host_attributes", "%lu", modified_host_process_attributes);
+	xsd_field(w, "modified_service_attributes", "%lu", modified_service_process_attributes);
+	xsd_field(w, "nagios_pid", "%d", nagios_pid);
+	xsd_field(w, "daemon_mode", "%d", daemon_mode);
+	xsd_field(w, "program_start", "%llu", (unsigned long long)program_start);
+	xsd_field(w, "last_log_rotation", "%llu", (unsigned long long)last_log_rotation);
+	xsd_field(w, "enable_notifications", "%d", enable_notifications);
+	xsd_field(w, "active_service_checks_enabled", "%d", execute_service_checks);
+	xsd_field(w, "passive_service_checks_enabled", "%d", accept_passive_service_checks);
+	xsd_field(w, "active_host_checks_enabled", "%d", execute_host_checks);
+	xsd_field(w, "passive_host_checks_enabled", "%d", accept_passive_host_checks);
+	xsd_field(w, "enable_event_handlers", "%d", enable_event_handlers);
+	xsd_field(w, "obsess_over_services", "%d", obsess_over_services);
+	xsd_field(w, "obsess_over_hosts", "%d", obsess_over_hosts);
+	xsd_field(w, "check_service_freshness", "%d", check_service_freshness);
+	xsd_field(w, "check_host_freshness", "%d", check_host_freshness);
+	xsd_field(w, "enable_flap_detection", "%d", enable_flap_detection);
+	xsd_field(w, "process_performance_data", "%d", process_performance_data);
+	xsd_field(w, "global_host_event_handler", "%s", (global_host_event_handler == NULL) ? "" : global_host_event_handler);
+	xsd_field(w, "global_service_event_handler", "%s", (global_service_event_handler == NULL) ? "" : global_service_event_handler);
+	xsd_field(w, "next_comment_id", "%lu", next_comment_id);
+	xsd_field(w, "next_downtime_id", "%lu", next_downtime_id);
+	xsd_field(w, "next_event_id", "%lu", next_event_id);
+	xsd_field(w, "next_problem_id", "%lu", next_problem_id);
+	xsd_field(w, "next_notification_id", "%lu", next_notification_id);
+	xsd_field(w, "active_scheduled_host_check_stats", "%d,%d,%d", check_statistics[ACTIVE_SCHEDULED_HOST_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_SCHEDULED_HOST_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_SCHEDULED_HOST_CHECK_STATS].minute_stats[2]);
+	xsd_field(w, "active_ondemand_host_check_stats", "%d,%d,%d", check_statistics[ACTIVE_ONDEMAND_HOST_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_ONDEMAND_HOST_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_ONDEMAND_HOST_CHECK_STATS].minute_stats[2]);
+	xsd_field(w, "passive_host_check_stats", "%d,%d,%d", check_statistics[PASSIVE_HOST_CHECK_STATS].minute_stats[0], check_statistics[PASSIVE_HOST_CHECK_STATS].minute_stats[1], check_statistics[PASSIVE_HOST_CHECK_STATS].minute_stats[2]);
+	xsd_field(w, "active_scheduled_service_check_stats", "%d,%d,%d", check_statistics[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS].minute_stats[2]);
+	xsd_field(w, "active_ondemand_service_check_stats", "%d,%d,%d", check_statistics[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS].minute_stats[2]);
+	xsd_field(w, "passive_service_check_stats", "%d,%d,%d", check_statistics[PASSIVE_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[PASSIVE_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[PASSIVE_SERVICE_CHECK_STATS].minute_stats[2]);
+	xsd_field(w, "cached_host_check_stats", "%d,%d,%d", check_statistics[ACTIVE_CACHED_HOST_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_CACHED_HOST_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_CACHED_HOST_CHECK_STATS].minute_stats[2]);
+	xsd_field(w, "cached_service_check_stats", "%d,%d,%d", check_statistics[ACTIVE_CACHED_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_CACHED_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_CACHED_SERVICE_CHECK_STATS].minute_stats[2]);
+	xsd_field(w, "external_command_stats", "%d,%d,%d", check_statistics[EXTERNAL_COMMAND_STATS].minute_stats[0], check_statistics[EXTERNAL_COMMAND_STATS].minute_stats[1], check_statistics[EXTERNAL_COMMAND_STATS].minute_stats[2]);
+
+	xsd_field(w, "parallel_host_check_stats", "%d,%d,%d", check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[0], check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[1], check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[2]);
+	xsd_field(w, "serial_host_check_stats", "%d,%d,%d", check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[0], check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[1], check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[2]);
+	xsd_end(w);
+	}
+
+
+static void xsd_write_host_status(struct xsd_writer *w, host *temp_host, time_t current_time) {
+	xsd_begin(w, XSDDEFAULT_HOSTSTATUS_DATA);
+	xsd_field(w, "host_name", "%s", temp_host->name);
+
+	xsd_field(w, "modified_attributes", "%lu", temp_host->modified_attributes);
+	xsd_field(w, "check_command", "%s", (temp_host->check_command == NULL) ? "" : temp_host->check_command);
+	xsd_field(w, "check_period", "%s", (temp_host->check_period == NULL) ? "" : temp_host->check_period);
+	xsd_field(w, "notification_period", "%s", (temp_host->notification_period == NULL) ? "" : temp_host->notification_period);
+	xsd_field(w, "importance", "%u", temp_host->hourly_value);
+	xsd_field(w, "check_interval", "%f", temp_host->check_interval);
+	xsd_field(w, "retry_interval", "%f", temp_host->retry_interval);
+	xsd_field(w, "event_handler", "%s", (temp_host->event_handler == NULL) ? "" : temp_host->event_handler);
+
+	xsd_field(w, "has_been_checked", "%d", temp_host->has_been_checked);
+	xsd_field(w, "should_be_scheduled", "%d", temp_host->should_be_scheduled);
+	xsd_field(w, "check_execution_time", "%.3f", temp_host->execution_time);
+	xsd_field(w, "check_latency", "%.3f", temp_host->latency);
+	xsd_field(w, "check_type", "%d", temp_host->check_type);
+	xsd_field(w, "current_state", "%d", temp_host->current_state);
+	xsd_field(w, "last_hard_state", "%d", temp_host->last_hard_state);
+	xsd_field(w, "last_event_id", "%lu", temp_host->last_event_id);
+	xsd_field(w, "current_event_id", "%lu", temp_host->current_event_id);
+	xsd_field(w, "current_problem_id", "%lu", temp_host->current_problem_id);
+	xsd_field(w, "last_problem_id", "%lu", temp_host->last_problem_id);
+	xsd_field(w, "plugin_output", "%s", (temp_host->plugin_output == NULL) ? "" : temp_host->plugin_output);
+	xsd_field(w, "long_plugin_output", "%s", (temp_host->long_plugin_output == NULL) ? "" : temp_host->long_plugin_output);
+	xsd_field(w, "performance_data", "%s", (temp_host->perf_data == NULL) ? "" : temp_host->perf_data);
+	xsd_field(w, "last_check", "%llu", (unsigned long long)temp_host->last_check);
+	xsd_field(w, "next_check", "%llu", (unsigned long long)temp_host->next_check);
+	xsd_field(w, "check_options", "%d", temp_host->check_options);
+	xsd_field(w, "current_attempt", "%d", temp_host->current_attempt);
+	xsd_field(w, "max_attempts", "%d", temp_host->max_attempts);
+	xsd_field(w, "state_type", "%d", temp_host->state_type);
+	xsd_field(w, "last_state_change", "%llu", (unsigned long long)temp_host->last_state_change);
+	xsd_field(w, "last_hard_state_change", "%llu", (unsigned long long)temp_host->last_hard_state_change);
+	xsd_field(w, "last_time_up", "%llu", (unsigned long long)temp_host->last_time_up);
+	xsd_field(w, "last_time_down", "%llu", (unsigned long long)temp_host->last_time_down);
+	xsd_field(w, "last_time_unreachable", "%llu", (unsigned long long)temp_host->last_time_unreachable);
+	xsd_field(w, "last_notification", "%llu", (unsigned long long)temp_host->last_notification);
+	xsd_field(w, "next_notification", "%llu", (unsigned long long)temp_host->next_notification);
+	xsd_field(w, "no_more_notifications", "%d", temp_host->no_more_notifications);
+	xsd_field(w, "current_notification_number", "%d", temp_host->current_notification_number);
+	xsd_field(w, "current_notification_id", "%lu", temp_host->current_notification_id);
+	xsd_field(w, "notifications_enabled", "%d", temp_host->notifications_enabled);
+	xsd_field(w, "problem_has_been_acknowledged", "%d", temp_host->problem_has_been_acknowledged);
+	xsd_field(w, "acknowledgement_type", "%d", temp_host->acknowledgement_type);
+	xsd_field(w, "active_checks_enabled", "%d", temp_host->checks_enabled);
+	xsd_field(w, "passive_checks_enabled", "%d", temp_host->accept_passive_checks);
+	xsd_field(w, "event_handler_enabled", "%d", temp_host->event_handler_enabled);
+	xsd_field(w, "flap_detection_enabled", "%d", temp_host->flap_detection_enabled);
+	xsd_field(w, "process_performance_data", "%d", temp_host->process_performance_data);
+	xsd_field(w, "obsess", "%d", temp_host->obsess);
+	xsd_field(w, "last_update", "%llu", (unsigned long long)current_time);
+	xsd_field(w, "is_flapping", "%d", temp_host->is_flapping);
+	xsd_field(w, "percent_state_change", "%.2f", temp_host->percent_state_change);
+	xsd_field(w, "scheduled_downtime_depth", "%d", temp_host->scheduled_downtime_depth);
+	xsd_custom_variables(w, temp_host->custom_variables);
+	xsd_end(w);
+	}
+
+
+static void xsd_write_service_status(struct xsd_writer *w, service *temp_service, time_t current_time) {
+	xsd_begin(w, XSDDEFAULT_SERVICESTATUS_DATA);
+	xsd_field(w, "host_name", "%s", temp_service->host_name);
+
+	xsd_field(w, "service_description", "%s", temp_service->description);
+	xsd_field(w, "modified_attributes", "%lu", temp_service->modified_attributes);
+	xsd_field(w, "check_command", "%s", (temp_service->check_command == NULL) ? "" : temp_service->check_command);
+	xsd_field(w, "check_period", "%s", (temp_service->check_period == NULL) ? "" : temp_service->check_period);
+	xsd_field(w, "notification_period", "%s", (temp_service->notification_period == NULL) ? "" : temp_service->notification_period);
+	xsd_field(w, "importance", "%u", temp_service->hourly_value);
+	xsd_field(w, "check_interval", "%f", temp_service->check_interval);
+	xsd_field(w, "retry_interval", "%f", temp_service->retry_interval);
+	xsd_field(w, "event_handler", "%s", (temp_service->event_handler == NULL) ? "" : temp_service->event_handler);
+
+	xsd_field(w, "has_been_checked", "%d", temp_service->has_been_checked);
+	xsd_field(w, "should_be_scheduled", "%d", temp_service->should_be_scheduled);
+	xsd_field(w, "check_execution_time", "%.3f", temp_service->execution_time);
+	xsd_field(w, "check_latency", "%.3f", temp_service->latency);
+	xsd_field(w, "check_type", "%d", temp_service->check_type);
+	xsd_field(w, "current_state", "%d", temp_service->current_state);
+	xsd_field(w, "last_hard_state", "%d", temp_service->last_hard_state);
+	xsd_field(w, "last_event_id", "%lu", temp_service->last_event_id);
+	xsd_field(w, "current_event_id", "%lu", temp_service->current_event_id);
+	xsd_field(w, "current_problem_id", "%lu", temp_service->current_problem_id);
+	xsd_field(w, "last_problem_id", "%lu", temp_service->last_problem_id);
+	xsd_field(w, "current_attempt", "%d", temp_service->current_attempt);
+	xsd_field(w, "max_attempts", "%d", temp_service->max_attempts);
+	xsd_field(w, "state_type", "%d", temp_service->state_type);
+	xsd_field(w, "last_state_change", "%llu", (unsigned long long)temp_service->last_state_change);
+	xsd_field(w, "last_hard_state_change", "%llu", (unsigned long long)temp_service->last_hard_state_change);
+	xsd_field(w, "last_time_ok", "%llu", (unsigned long long)temp_service->last_time_ok);
+	xsd_field(w, "last_time_warning", "%llu", (unsigned long long)temp_service->last_time_warning);
+	xsd_field(w, "last_time_unknown", "%llu", (unsigned long long)temp_service->last_time_unknown);
+	xsd_field(w, "last_time_critical", "%llu", (unsigned long long)temp_service->last_time_critical);
+	xsd_field(w, "plugin_output", "%s", (temp_service->plugin_output == NULL) ? "" : temp_service->plugin_output);
+	xsd_field(w, "long_plugin_output", "%s", (temp_service->long_plugin_output == NULL) ? "" : temp_service->long_plugin_output);
+	xsd_field(w, "performance_data", "%s", (temp_service->perf_data == NULL) ? "" : temp_service->perf_data);
+	xsd_field(w, "last_check", "%llu", (unsigned long long)temp_service->last_check);
+	xsd_field(w, "next_check", "%llu", (unsigned long long)temp_service->next_check);
+	xsd_field(w, "check_options", "%d", temp_service->check_options);
+	xsd_field(w, "current_notification_number", "%d", temp_service->current_notification_number);
+	xsd_field(w, "current_notification_id", "%lu", temp_service->current_notification_id);
+	xsd_field(w, "last_notification", "%llu", (unsigned long long)temp_service->last_notification);
+	xsd_field(w, "next_notification", "%llu", (unsigned long long)temp_service->next_notification);
+	xsd_field(w, "no_more_notifications", "%d", temp_service->no_more_notifications);
+	xsd_field(w, "notifications_enabled", "%d", temp_service->notifications_enabled);
+	xsd_field(w, "active_checks_enabled", "%d", temp_service->checks_enabled);
+	xsd_field(w, "passive_checks_enabled", "%d", temp_service->accept_passive_checks);
+	xsd_field(w, "event_handler_enabled", "%d", temp_service->event_handler_enabled);
+	xsd_field(w, "problem_has_been_acknowledged", "%d", temp_service->problem_has_been_acknowledged);
+	xsd_field(w, "acknowledgement_type", "%d", temp_service->acknowledgement_type);
+	xsd_field(w, "flap_detection_enabled", "%d", temp_service->flap_detection_enabled);
+	xsd_field(w, "process_performance_data", "%d", temp_service->process_performance_data);
+	xsd_field(w, "obsess", "%d", temp_service->obsess);
+	xsd_field(w, "last_update", "%llu", (unsigned long long)current_time);
+	xsd_field(w, "is_flapping", "%d", temp_service->is_flapping);
+	xsd_field(w, "percent_state_change", "%.2f", temp_service->percent_state_change);
+	xsd_field(w, "scheduled_downtime_depth", "%d", temp_service->scheduled_downtime_depth);
+	xsd_custom_variables(w, temp_service->custom_variables);
+	xsd_end(w);
+	}
+
+
+static void xsd_write_contact_status(struct xsd_writer *w, contact *temp_contact) {
+	xsd_begin(w, XSDDEFAULT_CONTACTSTATUS_DATA);
+	xsd_field(w, "contact_name", "%s", temp_contact->name);
+
+	xsd_field(w, "modified_attributes", "%lu", temp_contact->modified_attributes);
+	xsd_field(w, "modified_host_attributes", "%lu", temp_contact->modified_host_attributes);
+	xsd_field(w, "modified_service_attributes", "%lu", temp_contact->modified_service_attributes);
+	xsd_field(w, "host_notification_period", "%s", (temp_contact->host_notification_period == NULL) ? "" : temp_contact->host_notification_period);
+	xsd_field(w, "service_notification_period", "%s", (temp_contact->service_notification_period == NULL) ? "" : temp_contact->service_notification_period);
+
+	xsd_field(w, "last_host_notification", "%llu", (unsigned long long)temp_contact->last_host_notification);
+	xsd_field(w, "last_service_notification", "%llu", (unsigned long long)temp_contact->last_service_notification);
+	xsd_field(w, "host_notifications_enabled", "%d", temp_contact->host_notifications_enabled);
+	xsd_field(w, "service_notifications_enabled", "%d", temp_contact->service_notifications_enabled);
+	xsd_custom_variables(w, temp_contact->custom_variables);
+	xsd_end(w);
+	}
+
+
+static void xsd_write_comment(struct xsd_writer *w, nagios_comment *temp_comment) {
+	xsd_begin(w, temp_comment->comment_type == HOST_COMMENT ? XSDDEFAULT_HOSTCOMMENT_DATA : XSDDEFAULT_SERVICECOMMENT_DATA);
+	xsd_field(w, "host_name", "%s", temp_comment->host_name);
+	if(temp_comment->comment_type == SERVICE_COMMENT)
+		xsd_field(w, "service_description", "%s", temp_comment->service_description);
+	xsd_field(w, "entry_type", "%d", temp_comment->entry_type);
+	xsd_field(w, "comment_id", "%lu", temp_comment->comment_id);
+	xsd_field(w, "source", "%d", temp_comment->source);
+	xsd_field(w, "persistent", "%d", temp_comment->persistent);
+	xsd_field(w, "entry_time", "%llu", (unsigned long long)temp_comment->entry_time);
+	xsd_field(w, "expires", "%d", temp_comment->expires);
+	xsd_field(w, "expire_time", "%llu", (unsigned long long)temp_comment->expire_time);
+	xsd_field(w, "author", "%s", temp_comment->author);
+	xsd_field(w, "comment_data", "%s", temp_comment->comment_data);
+	xsd_end(w);
+	}
+
+
+static void xsd_write_downtime(struct xsd_writer *w, scheduled_downtime *temp_downtime) {
+	xsd_begin(w, temp_downtime->type == HOST_DOWNTIME ? XSDDEFAULT_HOSTDOWNTIME_DATA : XSDDEFAULT_SERVICEDOWNTIME_DATA);
+	xsd_field(w, "host_name", "%s", temp_downtime->host_name);
+	if(temp_downtime->type == SERVICE_DOWNTIME)
+		xsd_field(w, "service_description", "%s", temp_downtime->service_description);
+	xsd_field(w, "downtime_id", "%lu", temp_downtime->downtime_id);
+	xsd_field(w, "comment_id", "%lu", temp_downtime->comment_id);
+	xsd_field(w, "entry_time", "%llu", (unsigned long long)temp_downtime->entry_time);
+	xsd_field(w, "start_time", "%llu", (unsigned long long)temp_downtime->start_time);
+	xsd_field(w, "flex_downtime_start", "%llu", (unsigned long long)temp_downtime->flex_downtime_start);
+	xsd_field(w, "end_time", "%llu", (unsigned long long)temp_downtime->end_time);
+	xsd_field(w, "triggered_by", "%lu", temp_downtime->triggered_by);
+	xsd_field(w, "fixed", "%d", temp_downtime->fixed);
+	xsd_field(w, "duration", "%lu", temp_downtime->duration);
+	xsd_field(w, "is_in_effect", "%d", temp_downtime->is_in_effect);
+	xsd_field(w, "start_notification_sent", "%d", temp_downtime->start_notification_sent);
+	xsd_field(w, "author", "%s", temp_downtime->author);
+	xsd_field(w, "comment", "%s", temp_downtime->comment);
+	xsd_end(w);
+	}
+
+
+/* comments and downtime are few and change in many places, so deltas always carry all of them */
+static void xsd_write_comments_and_downtime(struct xsd_writer *w) {
+	nagios_comment *temp_comment = NULL;
+	scheduled_downtime *temp_downtime = NULL;
+
+	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = temp_comment->next)
+		xsd_write_comment(w, temp_comment);
+	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next)
+		xsd_write_downtime(w, temp_downtime);
+	}
+
+
+/* copies a string to the misc area, returning its offset (or 0 for none) */
+static uint32_t xsd_shm_put_string(char *misc, size_t *len, const char *str) {
+	uint32_t offset = *len;
+
+	if(str == NULL)
+		return 0;
+	strcpy(misc + *len, str);
+	*len += strlen(str) + 1;
+	return offset;
+	}
+
+
+/*
+ * Puts the program status, comments and downtime in the misc area
+ * of the status segment, creating the segment first if need be, or
+ * replacing it with a larger one if they don't fit.
+ */
+static int xsd_shm_update_misc(time_t current_time) {
+	struct xsddefault_shm_program *prog;
+	struct xsddefault_shm_comment *c;
+	struct xsddefault_shm_downtime *d;
+	nagios_comment *temp_comment = NULL;
+	scheduled_downtime *temp_downtime = NULL;
+	unsigned int num_comments = 0, num_downtime = 0;
+	size_t len, size;
+	char *misc;
+	int i;
+
+	/* strings go last, after the empty one that stands for none */
+	size = sizeof(*prog) + 1;
+	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = temp_comment->next, num_comments++) {
+		size += sizeof(*c) + strlen(temp_comment->host_name) + strlen(temp_comment->author) + strlen(temp_comment->comment_data) + 3;
+		if(temp_comment->service_description)
+			size += strlen(temp_comment->service_description) + 1;
+		}
+	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next, num_downtime++) {
+		size += sizeof(*d) + strlen(temp_downtime->host_name) + 1;
+		if(temp_downtime->service_description)
+			size += strlen(temp_downtime->service_description) + 1;
+		if(temp_downtime->author)
+			size += strlen(temp_downtime->author) + 1;
+		if(temp_downtime->comment)
+			size += strlen(temp_downtime->comment) + 1;
+		}
+
+	if((misc = calloc(1, size)) == NULL)
+		return ERROR;
+
+	prog = (struct xsddefault_shm_program *)misc;
+	prog->program_start = program_start;
+	prog->last_log_rotation = last_log_rotation;
+	prog->nagios_pid = nagios_pid;
+	prog->daemon_mode = daemon_mode;
+	prog->enable_notifications = enable_notifications;
+	prog->execute_service_checks = execute_service_checks;
+	prog->accept_passive_service_checks = accept_passive_service_checks;
+	prog->execute_host_checks = execute_host_checks;
+	prog->accept_passive_host_checks = accept_passive_host_checks;
+	prog->enable_event_handlers = enable_event_handlers;
+	prog->obsess_over_services = obsess_over_services;
+	prog->obsess_over_hosts = obsess_over_hosts;
+	prog->check_service_freshness = check_service_freshness;
+	prog->check_host_freshness = check_host_freshness;
+	prog->enable_flap_detection = enable_flap_detection;
+	prog->process_performance_data = process_performance_data;
+	for(i = 0; i < MAX_CHECK_STATS_TYPES; i++) {
+		prog->check_stats[i][0] = check_statistics[i].minute_stats[0];
+		prog->check_stats[i][1] = check_statistics[i].minute_stats[1];
+		prog->check_stats[i][2] = check_statistics[i].minute_stats[2];
+		}
+	prog->num_comments = num_comments;
+	prog->num_downtime = num_downtime;
+
+	c = (struct xsddefault_shm_comment *)(prog + 1);
+	d = (struct xsddefault_shm_downtime *)(c + num_comments);
+	len = (char *)(d + num_downtime) - misc + 1;
+	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = temp_comment->next, c++) {
+		c->comment_type = temp_comment->comment_type;
+		c->entry_type = temp_comment->entry_type;
+		c->source = temp_comment->source;
+		c->persistent = temp_comment->persistent;
+		c->expires = temp_comment->expires;
+		c->host_name = xsd_shm_put_string(misc, &len, temp_comment->host_name);
+		c->service_description = xsd_shm_put_string(misc, &len, temp_comment->service_description);
+		c->author = xsd_shm_put_string(misc, &len, temp_comment->author);
+		c->comment_data = xsd_shm_put_string(misc, &len, temp_comment->comment_data);
+		c->comment_id = temp_comment->comment_id;
+		c->entry_time = temp_comment->entry_time;
+		c->expire_time = temp_comment->expire_time;
+		}
+	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next, d++) {
+		d->type = temp_downtime->type;
+		d->fixed = temp_downtime->fixed;
+		d->is_in_effect = temp_downtime->is_in_effect;
+		d->start_notification_sent = temp_downtime->start_notification_sent;
+		d->host_name = xsd_shm_put_string(misc, &len, temp_downtime->host_name);
+		d->service_description = xsd_shm_put_string(misc, &len, temp_downtime->service_description);
+		d->author = xsd_shm_put_string(misc, &len, temp_downtime->author);
+		d->comment = xsd_shm_put_string(misc, &len, temp_downtime->comment);
+		d->downtime_id = temp_downtime->downtime_id;
+		d->comment_id = temp_downtime->comment_id;
+		d->triggered_by = temp_downtime->triggered_by;
+		d->duration = temp_downtime->duration;
+		d->entry_time = temp_downtime->entry_time;
+		d->start_time = temp_downtime->start_time;
+		d->flex_downtime_start = temp_downtime->flex_downtime_start;
+		d->end_time = temp_downtime->end_time;
+		}
+
+	if((status_shm == NULL || len > status_shm->misc_size) && xsd_shm_create(len < 32768 ? 65536 : len * 2) != OK) {
+		my_free(misc);
+		return ERROR;
+		}
+
+	xsd_shm_write_begin(&status_shm->misc_seq);
+	memcpy((char *)status_shm + status_shm->misc, misc, len);
+	status_shm->misc_len = len;
+	status_shm->last_update = current_time;
+	xsd_shm_write_end(&status_shm->misc_seq);
+
+	my_free(misc);
+	return OK;
+	}
+
+
+/* writes the status of everything */
+static void xsd_write_all(struct xsd_writer *w, time_t current_time) {
 	host *temp_host = NULL;
 	service *temp_service = NULL;
 	contact *temp_contact = NULL;
-	nagios_comment *temp_comment = NULL;
-	scheduled_downtime *temp_downtime = NULL;
-	time_t current_time;
+
+	xsd_write_info(w, current_time);
+	xsd_write_program_status(w);
+	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next)
+		xsd_write_host_status(w, temp_host, current_time);
+	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next)
+		xsd_write_service_status(w, temp_service, current_time);
+	for(temp_contact = contact_list; temp_contact != NULL; temp_contact = temp_contact->next)
+		xsd_write_contact_status(w, temp_contact);
+	xsd_write_comments_and_downtime(w);
+	}
+
+
+/* binary files start with their magic and the generation of the snapshot they belong to */
+static void xsd_write_header(struct xsd_writer *w, const char *magic) {
+	unsigned char gen[8];
+	int i;
+
+	for(i = 0; i < 8; i++)
+		gen[i] = (status_generation >> (i * 8)) & 0xff;
+	xsd_put(w, magic, 8);
+	xsd_put(w, gen, sizeof(gen));
+	}
+
+
+/* write all status data to the text status file */
+static int xsddefault_save_text_status_data(time_t current_time) {
+	struct xsd_writer w = { NULL, -1 };
+	char *tmp_log = NULL;
 	int fd = 0;
 	FILE *fp = NULL;
 	int result = OK;
 
-	log_debug_info(DEBUGL_FUNCTIONS, 0, "save_status_data()\n");
-
 	/* users may not want us to write status data */
 	if(!status_file || !strcmp(status_file, "/dev/null"))
 		return OK;
@@ -162,9 +1124,6 @@ int xsddefault_save_status_data(void) {
 		return ERROR;
 		}
 
-	/* generate check statistics */
-	generate_check_stats();
-
 	/* write version info to status file */
 	fprintf(fp, "########################################\n");
 	fprintf(fp, "#          NAGIOS STATUS FILE\n");
@@ -173,266 +1132,8 @@ int xsddefault_save_status_data(void) {
 	fprintf(fp, "# BY NAGIOS.  DO NOT MODIFY THIS FILE!\n");
 	fprintf(fp, "########################################\n\n");
 
-	time(&current_time);
-
-	/* write file info */
-	fprintf(fp, "info {\n");
-	fprintf(fp, "\tcreated=%llu\n", (unsigned long long)current_time);
-	fprintf(fp, "\tversion=%s\n", PROGRAM_VERSION);
-	fprintf(fp, "\tlast_update_check=%llu\n", (unsigned long long)last_update_check);
-	fprintf(fp, "\tupdate_available=%d\n", update_available);
-	fprintf(fp, "\tlast_version=%s\n", (last_program_version == NULL) ? "" : last_program_version);
-	fprintf(fp, "\tnew_version=%s\n", (new_program_version == NULL) ? "" : new_program_version);
-	fprintf(fp, "\t}\n\n");
-
-	/* save program status data */
-	fprintf(fp, "programstatus {\n");
-	fprintf(fp, "\tmodified_host_attributes=%lu\n", modified_host_process_attributes);
-	fprintf(fp, "\tmodified_service_attributes=%lu\n", modified_service_process_attributes);
-	fprintf(fp, "\tnagios_pid=%d\n", nagios_pid);
-	fprintf(fp, "\tdaemon_mode=%d\n", daemon_mode);
-	fprintf(fp, "\tprogram_start=%llu\n", (unsigned long long)program_start);
-	fprintf(fp, "\tlast_log_rotation=%llu\n", (unsigned long long)last_log_rotation);
-	fprintf(fp, "\tenable_notifications=%d\n", enable_notifications);
-	fprintf(fp, "\tactive_service_checks_enabled=%d\n", execute_service_checks);
-	fprintf(fp, "\tpassive_service_checks_enabled=%d\n", accept_passive_service_checks);
-	fprintf(fp, "\tactive_host_checks_enabled=%d\n", execute_host_checks);
-	fprintf(fp, "\tpassive_host_checks_enabled=%d\n", accept_passive_host_checks);
-	fprintf(fp, "\tenable_event_handlers=%d\n", enable_event_handlers);
-	fprintf(fp, "\tobsess_over_services=%d\n", obsess_over_services);
-	fprintf(fp, "\tobsess_over_hosts=%d\n", obsess_over_hosts);
-	fprintf(fp, "\tcheck_service_freshness=%d\n", check_service_freshness);
-	fprintf(fp, "\tcheck_host_freshness=%d\n", check_host_freshness);
-	fprintf(fp, "\tenable_flap_detection=%d\n", enable_flap_detection);
-	fprintf(fp, "\tprocess_performance_data=%d\n", process_performance_data);
-	fprintf(fp, "\tglobal_host_event_handler=%s\n", (global_host_event_handler == NULL) ? "" : global_host_event_handler);
-	fprintf(fp, "\tglobal_service_event_handler=%s\n", (global_service_event_handler == NULL) ? "" : global_service_event_handler);
-	fprintf(fp, "\tnext_comment_id=%lu\n", next_comment_id);
-	fprintf(fp, "\tnext_downtime_id=%lu\n", next_downtime_id);
-	fprintf(fp, "\tnext_event_id=%lu\n", next_event_id);
-	fprintf(fp, "\tnext_problem_id=%lu\n", next_problem_id);
-	fprintf(fp, "\tnext_notification_id=%lu\n", next_notification_id);
-	fprintf(fp, "\tactive_scheduled_host_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_SCHEDULED_HOST_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_SCHEDULED_HOST_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_SCHEDULED_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tactive_ondemand_host_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_ONDEMAND_HOST_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_ONDEMAND_HOST_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_ONDEMAND_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tpassive_host_check_stats=%d,%d,%d\n", check_statistics[PASSIVE_HOST_CHECK_STATS].minute_stats[0], check_statistics[PASSIVE_HOST_CHECK_STATS].minute_stats[1], check_statistics[PASSIVE_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tactive_scheduled_service_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_SCHEDULED_SERVICE_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tactive_ondemand_service_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_ONDEMAND_SERVICE_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tpassive_service_check_stats=%d,%d,%d\n", check_statistics[PASSIVE_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[PASSIVE_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[PASSIVE_SERVICE_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tcached_host_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_CACHED_HOST_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_CACHED_HOST_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_CACHED_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tcached_service_check_stats=%d,%d,%d\n", check_statistics[ACTIVE_CACHED_SERVICE_CHECK_STATS].minute_stats[0], check_statistics[ACTIVE_CACHED_SERVICE_CHECK_STATS].minute_stats[1], check_statistics[ACTIVE_CACHED_SERVICE_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\texternal_command_stats=%d,%d,%d\n", check_statistics[EXTERNAL_COMMAND_STATS].minute_stats[0], check_statistics[EXTERNAL_COMMAND_STATS].minute_stats[1], check_statistics[EXTERNAL_COMMAND_STATS].minute_stats[2]);
-
-	fprintf(fp, "\tparallel_host_check_stats=%d,%d,%d\n", check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[0], check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[1], check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\tserial_host_check_stats=%d,%d,%d\n", check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[0], check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[1], check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[2]);
-	fprintf(fp, "\t}\n\n");
-
-
-	/* save host status data */
-	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
-
-		fprintf(fp, "hoststatus {\n");
-		fprintf(fp, "\thost_name=%s\n", temp_host->name);
-
-		fprintf(fp, "\tmodified_attributes=%lu\n", temp_host->modified_attributes);
-		fprintf(fp, "\tcheck_command=%s\n", (temp_host->check_command == NULL) ? "" : temp_host->check_command);
-		fprintf(fp, "\tcheck_period=%s\n", (temp_host->check_period == NULL) ? "" : temp_host->check_period);
-		fprintf(fp, "\tnotification_period=%s\n", (temp_host->notification_period == NULL) ? "" : temp_host->notification_period);
-		fprintf(fp, "\timportance=%u\n", temp_host->hourly_value);
-		fprintf(fp, "\tcheck_interval=%f\n", temp_host->check_interval);
-		fprintf(fp, "\tretry_interval=%f\n", temp_host->retry_interval);
-		fprintf(fp, "\tevent_handler=%s\n", (temp_host->event_handler == NULL) ? "" : temp_host->event_handler);
-
-		fprintf(fp, "\thas_been_checked=%d\n", temp_host->has_been_checked);
-		fprintf(fp, "\tshould_be_scheduled=%d\n", temp_host->should_be_scheduled);
-		fprintf(fp, "\tcheck_execution_time=%.3f\n", temp_host->execution_time);
-		fprintf(fp, "\tcheck_latency=%.3f\n", temp_host->latency);
-		fprintf(fp, "\tcheck_type=%d\n", temp_host->check_type);
-		fprintf(fp, "\tcurrent_state=%d\n", temp_host->current_state);
-		fprintf(fp, "\tlast_hard_state=%d\n", temp_host->last_hard_state);
-		fprintf(fp, "\tlast_event_id=%lu\n", temp_host->last_event_id);
-		fprintf(fp, "\tcurrent_event_id=%lu\n", temp_host->current_event_id);
-		fprintf(fp, "\tcurrent_problem_id=%lu\n", temp_host->current_problem_id);
-		fprintf(fp, "\tlast_problem_id=%lu\n", temp_host->last_problem_id);
-		fprintf(fp, "\tplugin_output=%s\n", (temp_host->plugin_output == NULL) ? "" : temp_host->plugin_output);
-		fprintf(fp, "\tlong_plugin_output=%s\n", (temp_host->long_plugin_output == NULL) ? "" : temp_host->long_plugin_output);
-		fprintf(fp, "\tperformance_data=%s\n", (temp_host->perf_data == NULL) ? "" : temp_host->perf_data);
-		fprintf(fp, "\tlast_check=%llu\n", (unsigned long long)temp_host->last_check);
-		fprintf(fp, "\tnext_check=%llu\n", (unsigned long long)temp_host->next_check);
-		fprintf(fp, "\tcheck_options=%d\n", temp_host->check_options);
-		fprintf(fp, "\tcurrent_attempt=%d\n", temp_host->current_attempt);
-		fprintf(fp, "\tmax_attempts=%d\n", temp_host->max_attempts);
-		fprintf(fp, "\tstate_type=%d\n", temp_host->state_type);
-		fprintf(fp, "\tlast_state_change=%llu\n", (unsigned long long)temp_host->last_state_change);
-		fprintf(fp, "\tlast_hard_state_change=%llu\n", (unsigned long long)temp_host->last_hard_state_change);
-		fprintf(fp, "\tlast_time_up=%llu\n", (unsigned long long)temp_host->last_time_up);
-		fprintf(fp, "\tlast_time_down=%llu\n", (unsigned long long)temp_host->last_time_down);
-		fprintf(fp, "\tlast_time_unreachable=%llu\n", (unsigned long long)temp_host->last_time_unreachable);
-		fprintf(fp, "\tlast_notification=%llu\n", (unsigned long long)temp_host->last_notification);
-		fprintf(fp, "\tnext_notification=%llu\n", (unsigned long long)temp_host->next_notification);
-		fprintf(fp, "\tno_more_notifications=%d\n", temp_host->no_more_notifications);
-		fprintf(fp, "\tcurrent_notification_number=%d\n", temp_host->current_notification_number);
-		fprintf(fp, "\tcurrent_notification_id=%lu\n", temp_host->current_notification_id);
-		fprintf(fp, "\tnotifications_enabled=%d\n", temp_host->notifications_enabled);
-		fprintf(fp, "\tproblem_has_been_acknowledged=%d\n", temp_host->problem_has_been_acknowledged);
-		fprintf(fp, "\tacknowledgement_type=%d\n", temp_host->acknowledgement_type);
-		fprintf(fp, "\tactive_checks_enabled=%d\n", temp_host->checks_enabled);
-		fprintf(fp, "\tpassive_checks_enabled=%d\n", temp_host->accept_passive_checks);
-		fprintf(fp, "\tevent_handler_enabled=%d\n", temp_host->event_handler_enabled);
-		fprintf(fp, "\tflap_detection_enabled=%d\n", temp_host->flap_detection_enabled);
-		fprintf(fp, "\tprocess_performance_data=%d\n", temp_host->process_performance_data);
-		fprintf(fp, "\tobsess=%d\n", temp_host->obsess);
-		fprintf(fp, "\tlast_update=%llu\n", (unsigned long long)current_time);
-		fprintf(fp, "\tis_flapping=%d\n", temp_host->is_flapping);
-		fprintf(fp, "\tpercent_state_change=%.2f\n", temp_host->percent_state_change);
-		fprintf(fp, "\tscheduled_downtime_depth=%d\n", temp_host->scheduled_downtime_depth);
-		/* custom variables */
-		for(temp_customvariablesmember = temp_host->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-			if(temp_customvariablesmember->variable_name)
-				fprintf(fp, "\t_%s=%d;%s\n", temp_customvariablesmember->variable_name, temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
-			}
-		fprintf(fp, "\t}\n\n");
-		}
-
-	/* save service status data */
-	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
-
-		fprintf(fp, "servicestatus {\n");
-		fprintf(fp, "\thost_name=%s\n", temp_service->host_name);
-
-		fprintf(fp, "\tservice_description=%s\n", temp_service->description);
-		fprintf(fp, "\tmodified_attributes=%lu\n", temp_service->modified_attributes);
-		fprintf(fp, "\tcheck_command=%s\n", (temp_service->check_command == NULL) ? "" : temp_service->check_command);
-		fprintf(fp, "\tcheck_period=%s\n", (temp_service->check_period == NULL) ? "" : temp_service->check_period);
-		fprintf(fp, "\tnotification_period=%s\n", (temp_service->notification_period == NULL) ? "" : temp_service->notification_period);
-		fprintf(fp, "\timportance=%u\n", temp_service->hourly_value);
-		fprintf(fp, "\tcheck_interval=%f\n", temp_service->check_interval);
-		fprintf(fp, "\tretry_interval=%f\n", temp_service->retry_interval);
-		fprintf(fp, "\tevent_handler=%s\n", (temp_service->event_handler == NULL) ? "" : temp_service->event_handler);
-
-		fprintf(fp, "\thas_been_checked=%d\n", temp_service->has_been_checked);
-		fprintf(fp, "\tshould_be_scheduled=%d\n", temp_service->should_be_scheduled);
-		fprintf(fp, "\tcheck_execution_time=%.3f\n", temp_service->execution_time);
-		fprintf(fp, "\tcheck_latency=%.3f\n", temp_service->latency);
-		fprintf(fp, "\tcheck_type=%d\n", temp_service->check_type);
-		fprintf(fp, "\tcurrent_state=%d\n", temp_service->current_state);
-		fprintf(fp, "\tlast_hard_state=%d\n", temp_service->last_hard_state);
-		fprintf(fp, "\tlast_event_id=%lu\n", temp_service->last_event_id);
-		fprintf(fp, "\tcurrent_event_id=%lu\n", temp_service->current_event_id);
-		fprintf(fp, "\tcurrent_problem_id=%lu\n", temp_service->current_problem_id);
-		fprintf(fp, "\tlast_problem_id=%lu\n", temp_service->last_problem_id);
-		fprintf(fp, "\tcurrent_attempt=%d\n", temp_service->current_attempt);
-		fprintf(fp, "\tmax_attempts=%d\n", temp_service->max_attempts);
-		fprintf(fp, "\tstate_type=%d\n", temp_service->state_type);
-		fprintf(fp, "\tlast_state_change=%llu\n", (unsigned long long)temp_service->last_state_change);
-		fprintf(fp, "\tlast_hard_state_change=%llu\n", (unsigned long long)temp_service->last_hard_state_change);
-		fprintf(fp, "\tlast_time_ok=%llu\n", (unsigned long long)temp_service->last_time_ok);
-		fprintf(fp, "\tlast_time_warning=%llu\n", (unsigned long long)temp_service->last_time_warning);
-		fprintf(fp, "\tlast_time_unknown=%llu\n", (unsigned long long)temp_service->last_time_unknown);
-		fprintf(fp, "\tlast_time_critical=%llu\n", (unsigned long long)temp_service->last_time_critical);
-		fprintf(fp, "\tplugin_output=%s\n", (temp_service->plugin_output == NULL) ? "" : temp_service->plugin_output);
-		fprintf(fp, "\tlong_plugin_output=%s\n", (temp_service->long_plugin_output == NULL) ? "" : temp_service->long_plugin_output);
-		fprintf(fp, "\tperformance_data=%s\n", (temp_service->perf_data == NULL) ? "" : temp_service->perf_data);
-		fprintf(fp, "\tlast_check=%llu\n", (unsigned long long)temp_service->last_check);
-		fprintf(fp, "\tnext_check=%llu\n", (unsigned long long)temp_service->next_check);
-		fprintf(fp, "\tcheck_options=%d\n", temp_service->check_options);
-		fprintf(fp, "\tcurrent_notification_number=%d\n", temp_service->current_notification_number);
-		fprintf(fp, "\tcurrent_notification_id=%lu\n", temp_service->current_notification_id);
-		fprintf(fp, "\tlast_notification=%llu\n", (unsigned long long)temp_service->last_notification);
-		fprintf(fp, "\tnext_notification=%llu\n", (unsigned long long)temp_service->next_notification);
-		fprintf(fp, "\tno_more_notifications=%d\n", temp_service->no_more_notifications);
-		fprintf(fp, "\tnotifications_enabled=%d\n", temp_service->notifications_enabled);
-		fprintf(fp, "\tactive_checks_enabled=%d\n", temp_service->checks_enabled);
-		fprintf(fp, "\tpassive_checks_enabled=%d\n", temp_service->accept_passive_checks);
-		fprintf(fp, "\tevent_handler_enabled=%d\n", temp_service->event_handler_enabled);
-		fprintf(fp, "\tproblem_has_been_acknowledged=%d\n", temp_service->problem_has_been_acknowledged);
-		fprintf(fp, "\tacknowledgement_type=%d\n", temp_service->acknowledgement_type);
-		fprintf(fp, "\tflap_detection_enabled=%d\n", temp_service->flap_detection_enabled);
-		fprintf(fp, "\tprocess_performance_data=%d\n", temp_service->process_performance_data);
-		fprintf(fp, "\tobsess=%d\n", temp_service->obsess);
-		fprintf(fp, "\tlast_update=%llu\n", (unsigned long long)current_time);
-		fprintf(fp, "\tis_flapping=%d\n", temp_service->is_flapping);
-		fprintf(fp, "\tpercent_state_change=%.2f\n", temp_service->percent_state_change);
-		fprintf(fp, "\tscheduled_downtime_depth=%d\n", temp_service->scheduled_downtime_depth);
-		/* custom variables */
-		for(temp_customvariablesmember = temp_service->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-			if(temp_customvariablesmember->variable_name)
-				fprintf(fp, "\t_%s=%d;%s\n", temp_customvariablesmember->variable_name, temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
-			}
-		fprintf(fp, "\t}\n\n");
-		}
-
-	/* save contact status data */
-	for(temp_contact = contact_list; temp_contact != NULL; temp_contact = temp_contact->next) {
-
-		fprintf(fp, "contactstatus {\n");
-		fprintf(fp, "\tcontact_name=%s\n", temp_contact->name);
-
-		fprintf(fp, "\tmodified_attributes=%lu\n", temp_contact->modified_attributes);
-		fprintf(fp, "\tmodified_host_attributes=%lu\n", temp_contact->modified_host_attributes);
-		fprintf(fp, "\tmodified_service_attributes=%lu\n", temp_contact->modified_service_attributes);
-		fprintf(fp, "\thost_notification_period=%s\n", (temp_contact->host_notification_period == NULL) ? "" : temp_contact->host_notification_period);
-		fprintf(fp, "\tservice_notification_period=%s\n", (temp_contact->service_notification_period == NULL) ? "" : temp_contact->service_notification_period);
-
-		fprintf(fp, "\tlast_host_notification=%llu\n", (unsigned long long)temp_contact->last_host_notification);
-		fprintf(fp, "\tlast_service_notification=%llu\n", (unsigned long long)temp_contact->last_service_notification);
-		fprintf(fp, "\thost_notifications_enabled=%d\n", temp_contact->host_notifications_enabled);
-		fprintf(fp, "\tservice_notifications_enabled=%d\n", temp_contact->service_notifications_enabled);
-		/* custom variables */
-		for(temp_customvariablesmember = temp_contact->custom_variables; temp_customvariablesmember != NULL; temp_customvariablesmember = temp_customvariablesmember->next) {
-			if(temp_customvariablesmember->variable_name)
-				fprintf(fp, "\t_%s=%d;%s\n", temp_customvariablesmember->variable_name, temp_customvariablesmember->has_been_modified, (temp_customvariablesmember->variable_value == NULL) ? "" : temp_customvariablesmember->variable_value);
-			}
-		fprintf(fp, "\t}\n\n");
-		}
-
-	/* save all comments */
-	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = temp_comment->next) {
-
-		if(temp_comment->comment_type == HOST_COMMENT)
-			fprintf(fp, "hostcomment {\n");
-		else
-			fprintf(fp, "servicecomment {\n");
-		fprintf(fp, "\thost_name=%s\n", temp_comment->host_name);
-		if(temp_comment->comment_type == SERVICE_COMMENT)
-			fprintf(fp, "\tservice_description=%s\n", temp_comment->service_description);
-		fprintf(fp, "\tentry_type=%d\n", temp_comment->entry_type);
-		fprintf(fp, "\tcomment_id=%lu\n", temp_comment->comment_id);
-		fprintf(fp, "\tsource=%d\n", temp_comment->source);
-		fprintf(fp, "\tpersistent=%d\n", temp_comment->persistent);
-		fprintf(fp, "\tentry_time=%llu\n", (unsigned long long)temp_comment->entry_time);
-		fprintf(fp, "\texpires=%d\n", temp_comment->expires);
-		fprintf(fp, "\texpire_time=%llu\n", (unsigned long long)temp_comment->expire_time);
-		fprintf(fp, "\tauthor=%s\n", temp_comment->author);
-		fprintf(fp, "\tcomment_data=%s\n", temp_comment->comment_data);
-		fprintf(fp, "\t}\n\n");
-		}
-
-	/* save all downtime */
-	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
-
-		if(temp_downtime->type == HOST_DOWNTIME)
-			fprintf(fp, "hostdowntime {\n");
-		else
-			fprintf(fp, "servicedowntime {\n");
-		fprintf(fp, "\thost_name=%s\n", temp_downtime->host_name);
-		if(temp_downtime->type == SERVICE_DOWNTIME)
-			fprintf(fp, "\tservice_description=%s\n", temp_downtime->service_description);
-		fprintf(fp, "\tdowntime_id=%lu\n", temp_downtime->downtime_id);
-		fprintf(fp, "\tcomment_id=%lu\n", temp_downtime->comment_id);
-		fprintf(fp, "\tentry_time=%llu\n", (unsigned long long)temp_downtime->entry_time);
-		fprintf(fp, "\tstart_time=%llu\n", (unsigned long long)temp_downtime->start_time);
-		fprintf(fp, "\tflex_downtime_start=%llu\n", (unsigned long long)temp_downtime->flex_downtime_start);
-		fprintf(fp, "\tend_time=%llu\n", (unsigned long long)temp_downtime->end_time);
-		fprintf(fp, "\ttriggered_by=%lu\n", temp_downtime->triggered_by);
-		fprintf(fp, "\tfixed=%d\n", temp_downtime->fixed);
-		fprintf(fp, "\tduration=%lu\n", temp_downtime->duration);
-		fprintf(fp, "\tis_in_effect=%d\n", temp_downtime->is_in_effect);
-		fprintf(fp, "\tstart_notification_sent=%d\n", temp_downtime->start_notification_sent);
-		fprintf(fp, "\tauthor=%s\n", temp_downtime->author);
-		fprintf(fp, "\tcomment=%s\n", temp_downtime->comment);
-		fprintf(fp, "\t}\n\n");
-		}
-
+	w.fp = fp;
+	xsd_write_all(&w, current_time);
 
 	/* reset file permissions */
 	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
@@ -475,12 +1176,970 @@ int xsddefault_save_status_data(void) {
 	return result;
 	}
 
+
+/* writes a binary status file to a temp file and moves it into place */
+static int xsd_write_binary_file(struct xsd_writer *w, char *path, const char *magic, time_t current_time, off_t *size) {
+	char *tmp_file = NULL;
+	int fd;
+
+	asprintf(&tmp_file, "%sXXXXXX", temp_file);
+	if(tmp_file == NULL)
+		return -1;
+	if((fd = mkstemp(tmp_file)) == -1) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to create temp file '%s' for writing status data: %s\n", tmp_file, strerror(errno));
+		my_free(tmp_file);
+		return -1;
+		}
+
+	w->fd = fd;
+	xsd_write_header(w, magic);
+	if(current_time) {
+		xsd_write_all(w, current_time);
+		xsd_marker(w, XSDDEFAULT_END_OF_DUMP);
+		}
+	xsd_flush(w);
+	*size = lseek(fd, 0, SEEK_CUR);
+
+	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+	if(current_time && !w->error && fsync(fd))
+		w->error = errno;
+	if(w->error || my_rename(tmp_file, path)) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to update status data file '%s': %s", path, strerror(w->error ? w->error : errno));
+		close(fd);
+		unlink(tmp_file);
+		my_free(tmp_file);
+		return -1;
+		}
+
+	my_free(tmp_file);
+	return fd;
+	}
+
+
+/*
+ * Rewrites the snapshot and starts a new, empty, delta log. Both
+ * files get a new generation number, so readers that catch us half
+ * way through can tell the delta log doesn't belong to the snapshot.
+ */
+static int xsddefault_compact_status_data(time_t current_time) {
+	struct xsd_writer w = { NULL, -1 };
+	struct timeval tv;
+	unsigned long long generation;
+	int fd;
+
+	gettimeofday(&tv, NULL);
+	generation = (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+	status_generation = generation > status_generation ? generation : status_generation + 1;
+
+	if(status_delta_fd >= 0)
+		close(status_delta_fd);
+	status_delta_fd = -1;
+	xsd_writer_reset(&status_delta_writer);
+
+	fd = xsd_write_binary_file(&w, status_snapshot_file, XSDDEFAULT_SNAPSHOT_MAGIC, current_time, &status_snapshot_size);
+	xsd_writer_reset(&w);
+	if(fd < 0)
+		return ERROR;
+	close(fd);
+
+	fd = xsd_write_binary_file(&status_delta_writer, status_delta_file, XSDDEFAULT_DELTA_MAGIC, 0, &status_delta_size);
+	if(fd < 0)
+		return ERROR;
+	status_delta_fd = fd;
+	status_delta_writer.fd = -1;
+	last_status_compaction = current_time;
+
+	/* start tracking changes */
+	if(dirty_hosts == NULL) {
+		dirty_hosts = bitmap_create(num_objects.hosts + 1);
+		dirty_services = bitmap_create(num_objects.services + 1);
+		dirty_contacts = bitmap_create(num_objects.contacts + 1);
+		}
+	bitmap_clear(dirty_hosts);
+	bitmap_clear(dirty_services);
+	bitmap_clear(dirty_contacts);
+
+	return OK;
+	}
+
+
+/* appends the status of everything that has changed to the delta log */
+static int xsddefault_append_status_delta(time_t current_time) {
+	struct xsd_writer *w = &status_delta_writer;
+	unsigned int i;
+
+	xsd_write_info(w, current_time);
+	xsd_write_program_status(w);
+	for(i = 0; i < num_objects.hosts; i++) {
+		if(bitmap_isset(dirty_hosts, i))
+			xsd_write_host_status(w, host_ary[i], current_time);
+		}
+	for(i = 0; i < num_objects.services; i++) {
+		if(bitmap_isset(dirty_services, i))
+			xsd_write_service_status(w, service_ary[i], current_time);
+		}
+	for(i = 0; i < num_objects.contacts; i++) {
+		if(bitmap_isset(dirty_contacts, i))
+			xsd_write_contact_status(w, contact_ary[i]);
+		}
+	xsd_marker(w, XSDDEFAULT_CLEAR_COMMENTS);
+	xsd_marker(w, XSDDEFAULT_CLEAR_DOWNTIME);
+	xsd_write_comments_and_downtime(w);
+	xsd_marker(w, XSDDEFAULT_END_OF_DUMP);
+
+	bitmap_clear(dirty_hosts);
+	bitmap_clear(dirty_services);
+	bitmap_clear(dirty_contacts);
+
+	status_delta_size += w->len;
+	w->fd = status_delta_fd;
+	xsd_flush(w);
+	w->fd = -1;
+	if(w->error) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Unable to update status data file '%s': %s", status_delta_file, strerror(w->error));
+		/* readers ignore the broken dump, and we start over */
+		close(status_delta_fd);
+		status_delta_fd = -1;
+		return ERROR;
+		}
+
+	return OK;
+	}
+
+
+/* write all status data to file */
+int xsddefault_save_status_data(void) {
+	time_t current_time;
+	int result = OK;
+
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "save_status_data()\n");
+
+	/* users may not want us to write status data */
+	if((!status_file || !strcmp(status_file, "/dev/null")) && !status_snapshot_file && !status_shm_file)
+		return OK;
+
+	/* generate check statistics */
+	generate_check_stats();
+
+	time(&current_time);
+
+	if(status_shm_file && xsd_shm_update_misc(current_time) != OK)
+		result = ERROR;
+
+	if(!status_snapshot_file)
+		return xsddefault_save_text_status_data(current_time) == OK ? result : ERROR;
+
+	/*
+	 * Compact when it's time to, or when replaying the delta log
+	 * would be more work than reading a new snapshot. The text
+	 * status file is only kept for compatibility, so it's written
+	 * along with the snapshot.
+	 */
+	if(status_delta_fd < 0 || current_time < last_status_compaction ||
+	   current_time - last_status_compaction >= status_snapshot_compaction_interval ||
+	   status_delta_size > status_snapshot_size)
+	{
+		if(xsddefault_compact_status_data(current_time) != OK)
+			result = ERROR;
+		if(xsddefault_save_text_status_data(current_time) != OK)
+			result = ERROR;
+		return result;
+		}
+
+	return xsddefault_append_status_delta(current_time) == OK ? result : ERROR;
+	}
+
 #endif
 
 
 
 #ifdef NSCGI
 
+/******************************************************************/
+/***************** SHARED MEMORY STATUS FUNCTIONS *****************/
+/******************************************************************/
+
+/*
+ * Statuses read from the status segment live in one array per kind
+ * and point into the segment for their names, so the segment stays
+ * mapped until free_status_data(). Check output can change under us,
+ * so that's copied into a few large chunks instead.
+ */
+#define XSD_SHM_CHUNK_SIZE (64 * 1024)
+
+struct xsd_shm_chunk {
+	struct xsd_shm_chunk *next;
+	size_t used;
+	char buf[XSD_SHM_CHUNK_SIZE];
+	};
+
+static struct xsddefault_shm_header *status_shm;
+static size_t status_shm_size;
+static hoststatus *shm_hoststatus;
+static servicestatus *shm_servicestatus;
+static unsigned int shm_num_hosts;
+static unsigned int shm_num_services;
+static struct xsd_shm_chunk *shm_chunks;
+
+/* how often we try to get a consistent copy before giving up on the segment */
+#define XSD_SHM_MAX_TRIES 1000
+
+
+/* copies something the core may be updating, retrying until the copy is consistent */
+static int xsd_shm_read(volatile uint32_t *seq, void *dst, const void *src, size_t len) {
+	uint32_t before;
+	int tries;
+
+	/* if the core died while writing, we'll never get a clean copy */
+	for(tries = 0; tries < XSD_SHM_MAX_TRIES; tries++) {
+		before = *seq;
+		__sync_synchronize();
+		memcpy(dst, src, len);
+		__sync_synchronize();
+		if(!(before & 1) && *seq == before)
+			return OK;
+		}
+
+	return ERROR;
+	}
+
+
+static char *xsd_shm_name(uint32_t offset) {
+	if(offset == 0 || offset >= status_shm->strings_size)
+		return NULL;
+	return (char *)status_shm + status_shm->strings + offset;
+	}
+
+
+/* keeps a copy of some check output, or returns NULL if there's none */
+static char *xsd_shm_text(const char *text, size_t len, int unescape) {
+	struct xsd_shm_chunk *chunk = shm_chunks;
+	char *str;
+
+	/* empty values are left unset, like when they're read from the status file */
+	if(len == 0)
+		return NULL;
+	if(chunk == NULL || chunk->used + len + 1 > sizeof(chunk->buf)) {
+		if((chunk = malloc(sizeof(*chunk))) == NULL)
+			return NULL;
+		chunk->used = 0;
+		chunk->next = shm_chunks;
+		shm_chunks = chunk;
+		}
+	str = chunk->buf + chunk->used;
+	memcpy(str, text, len);
+	str[len] = 0;
+	if(unescape)
+		unescape_newlines(str);
+	chunk->used += strlen(str) + 1;
+	return str;
+	}
+
+
+/* copies a record and fills in the host or service status it belongs to */
+static int xsd_shm_read_status(unsigned int i, time_t last_update) {
+	struct xsddefault_shm_record r;
+	hoststatus *temp_hoststatus = NULL;
+	servicestatus *temp_servicestatus = NULL;
+	struct xsddefault_shm_record *records = (struct xsddefault_shm_record *)((char *)status_shm + status_shm->records);
+	const char *text;
+
+	if(xsd_shm_read(&records[i].seq, &r, &records[i], sizeof(r)) != OK)
+		return ERROR;
+	if((size_t)r.plugin_output_len + r.perf_data_len + r.long_plugin_output_len + 3 > sizeof(r.text))
+		r.plugin_output_len = r.perf_data_len = r.long_plugin_output_len = 0;
+	/* add_*_status() replaces the output of anything that's pending */
+	if(r.has_been_checked <= 0)
+		r.plugin_output_len = 0;
+	text = r.text;
+
+	if(i < status_shm->num_hosts) {
+		temp_hoststatus = &shm_hoststatus[i];
+		temp_hoststatus->host_name = xsd_shm_name(r.name);
+		temp_hoststatus->plugin_output = xsd_shm_text(text, r.plugin_output_len, TRUE);
+		text += r.plugin_output_len + 1;
+		temp_hoststatus->perf_data = xsd_shm_text(text, r.perf_data_len, FALSE);
+		text += r.perf_data_len + 1;
+		temp_hoststatus->long_plugin_output = xsd_shm_text(text, r.long_plugin_output_len, TRUE);
+		temp_hoststatus->has_been_checked = (r.has_been_checked > 0) ? TRUE : FALSE;
+		temp_hoststatus->should_be_scheduled = (r.should_be_scheduled > 0) ? TRUE : FALSE;
+		temp_hoststatus->execution_time = r.execution_time;
+		temp_hoststatus->latency = r.latency;
+		temp_hoststatus->check_type = r.check_type;
+		temp_hoststatus->status = r.current_state;
+		temp_hoststatus->last_hard_state = r.last_hard_state;
+		temp_hoststatus->current_attempt = r.current_attempt;
+		temp_hoststatus->max_attempts = r.max_attempts;
+		temp_hoststatus->last_check = r.last_check;
+		temp_hoststatus->next_check = r.next_check;
+		temp_hoststatus->check_options = r.check_options;
+		temp_hoststatus->state_type = r.state_type;
+		temp_hoststatus->last_state_change = r.last_state_change;
+		temp_hoststatus->last_hard_state_change = r.last_hard_state_change;
+		temp_hoststatus->last_time_up = r.last_time[HOST_UP];
+		temp_hoststatus->last_time_down = r.last_time[HOST_DOWN];
+		temp_hoststatus->last_time_unreachable = r.last_time[HOST_UNREACHABLE];
+		temp_hoststatus->last_notification = r.last_notification;
+		temp_hoststatus->next_notification = r.next_notification;
+		temp_hoststatus->no_more_notifications = (r.no_more_notifications > 0) ? TRUE : FALSE;
+		temp_hoststatus->current_notification_number = r.current_notification_number;
+		temp_hoststatus->notifications_enabled = (r.notifications_enabled > 0) ? TRUE : FALSE;
+		temp_hoststatus->problem_has_been_acknowledged = (r.problem_has_been_acknowledged > 0) ? TRUE : FALSE;
+		temp_hoststatus->acknowledgement_type = r.acknowledgement_type;
+		temp_hoststatus->checks_enabled = (r.checks_enabled > 0) ? TRUE : FALSE;
+		temp_hoststatus->accept_passive_checks = (r.accept_passive_checks > 0) ? TRUE : FALSE;
+		temp_hoststatus->event_handler_enabled = (r.event_handler_enabled > 0) ? TRUE : FALSE;
+		temp_hoststatus->flap_detection_enabled = (r.flap_detection_enabled > 0) ? TRUE : FALSE;
+		temp_hoststatus->process_performance_data = (r.process_performance_data > 0) ? TRUE : FALSE;
+		temp_hoststatus->obsess = (r.obsess > 0) ? TRUE : FALSE;
+		temp_hoststatus->last_update = last_update;
+		temp_hoststatus->is_flapping = (r.is_flapping > 0) ? TRUE : FALSE;
+		temp_hoststatus->percent_state_change = r.percent_state_change;
+		temp_hoststatus->scheduled_downtime_depth = (r.scheduled_downtime_depth < 0) ? 0 : r.scheduled_downtime_depth;
+		return OK;
+		}
+
+	temp_servicestatus = &shm_servicestatus[i - status_shm->num_hosts];
+	temp_servicestatus->host_name = xsd_shm_name(r.name);
+	temp_servicestatus->description = xsd_shm_name(r.description);
+	temp_servicestatus->plugin_output = xsd_shm_text(text, r.plugin_output_len, TRUE);
+	text += r.plugin_output_len + 1;
+	temp_servicestatus->perf_data = xsd_shm_text(text, r.perf_data_len, FALSE);
+	text += r.perf_data_len + 1;
+	temp_servicestatus->long_plugin_output = xsd_shm_text(text, r.long_plugin_output_len, TRUE);
+	temp_servicestatus->has_been_checked = (r.has_been_checked > 0) ? TRUE : FALSE;
+	temp_servicestatus->should_be_scheduled = (r.should_be_scheduled > 0) ? TRUE : FALSE;
+	temp_servicestatus->execution_time = r.execution_time;
+	temp_servicestatus->latency = r.latency;
+	temp_servicestatus->check_type = r.check_type;
+	temp_servicestatus->status = r.current_state;
+	temp_servicestatus->last_hard_state = r.last_hard_state;
+	temp_servicestatus->current_attempt = r.current_attempt;
+	temp_servicestatus->max_attempts = r.max_attempts;
+	temp_servicestatus->state_type = r.state_type;
+	temp_servicestatus->last_state_change = r.last_state_change;
+	temp_servicestatus->last_hard_state_change = r.last_hard_state_change;
+	temp_servicestatus->last_time_ok = r.last_time[STATE_OK];
+	temp_servicestatus->last_time_warning = r.last_time[STATE_WARNING];
+	temp_servicestatus->last_time_unknown = r.last_time[STATE_UNKNOWN];
+	temp_servicestatus->last_time_critical = r.last_time[STATE_CRITICAL];
+	temp_servicestatus->last_check = r.last_check;
+	temp_servicestatus->next_check = r.next_check;
+	temp_servicestatus->check_options = r.check_options;
+	temp_servicestatus->current_notification_number = r.current_notification_number;
+	temp_servicestatus->last_notification = r.last_notification;
+	temp_servicestatus->next_notification = r.next_notification;
+	temp_servicestatus->no_more_notifications = (r.no_more_notifications > 0) ? TRUE : FALSE;
+	temp_servicestatus->notifications_enabled = (r.notifications_enabled > 0) ? TRUE : FALSE;
+	temp_servicestatus->checks_enabled = (r.checks_enabled > 0) ? TRUE : FALSE;
+	temp_servicestatus->accept_passive_checks = (r.accept_passive_checks > 0) ? TRUE : FALSE;
+	temp_servicestatus->event_handler_enabled = (r.event_handler_enabled > 0) ? TRUE : FALSE;
+	temp_servicestatus->problem_has_been_acknowledged = (r.problem_has_been_acknowledged > 0) ? TRUE : FALSE;
+	temp_servicestatus->acknowledgement_type = r.acknowledgement_type;
+	temp_servicestatus->flap_detection_enabled = (r.flap_detection_enabled > 0) ? TRUE : FALSE;
+	temp_servicestatus->process_performance_data = (r.process_performance_data > 0) ? TRUE : FALSE;
+	temp_servicestatus->obsess = (r.obsess > 0) ? TRUE : FALSE;
+	temp_servicestatus->last_update = last_update;
+	temp_servicestatus->is_flapping = (r.is_flapping > 0) ? TRUE : FALSE;
+	temp_servicestatus->percent_state_change = r.percent_state_change;
+	temp_servicestatus->scheduled_downtime_depth = (r.scheduled_downtime_depth < 0) ? 0 : r.scheduled_downtime_depth;
+	return OK;
+	}
+
+
+/* a string in our copy of the misc area, or NULL if it's not there */
+static char *xsd_shm_misc_string(char *misc, size_t len, uint32_t offset) {
+	if(offset == 0 || offset >= len)
+		return NULL;
+	return misc + offset;
+	}
+
+
+/* picks up the program status, comments and downtime from a copy of the misc area */
+static int xsd_shm_read_misc(char *misc, size_t len) {
+	struct xsddefault_shm_program *prog = (struct xsddefault_shm_program *)misc;
+	struct xsddefault_shm_comment *c;
+	struct xsddefault_shm_downtime *d;
+	scheduled_downtime *temp_downtime;
+	unsigned int i;
+
+	if(len < sizeof(*prog) + 1 || misc[len - 1] != 0 ||
+	   sizeof(*prog) + (size_t)prog->num_comments * sizeof(*c) + (size_t)prog->num_downtime * sizeof(*d) >= len)
+		return ERROR;
+
+	nagios_pid = prog->nagios_pid;
+	daemon_mode = (prog->daemon_mode > 0) ? TRUE : FALSE;
+	program_start = prog->program_start;
+	last_log_rotation = prog->last_log_rotation;
+	enable_notifications = (prog->enable_notifications > 0) ? TRUE : FALSE;
+	execute_service_checks = (prog->execute_service_checks > 0) ? TRUE : FALSE;
+	accept_passive_service_checks = (prog->accept_passive_service_checks > 0) ? TRUE : FALSE;
+	execute_host_checks = (prog->execute_host_checks > 0) ? TRUE : FALSE;
+	accept_passive_host_checks = (prog->accept_passive_host_checks > 0) ? TRUE : FALSE;
+	enable_event_handlers = (prog->enable_event_handlers > 0) ? TRUE : FALSE;
+	obsess_over_services = (prog->obsess_over_services > 0) ? TRUE : FALSE;
+	obsess_over_hosts = (prog->obsess_over_hosts > 0) ? TRUE : FALSE;
+	check_service_freshness = (prog->check_service_freshness > 0) ? TRUE : FALSE;
+	check_host_freshness = (prog->check_host_freshness > 0) ? TRUE : FALSE;
+	enable_flap_detection = (prog->enable_flap_detection > 0) ? TRUE : FALSE;
+	process_performance_data = (prog->process_performance_data > 0) ? TRUE : FALSE;
+	for(i = 0; i < MAX_CHECK_STATS_TYPES; i++) {
+		program_stats[i][0] = prog->check_stats[i][0];
+		program_stats[i][1] = prog->check_stats[i][1];
+		program_stats[i][2] = prog->check_stats[i][2];
+		}
+
+	c = (struct xsddefault_shm_comment *)(prog + 1);
+	for(i = 0; i < prog->num_comments; i++, c++) {
+		add_comment(c->comment_type == HOST_COMMENT ? HOST_COMMENT : SERVICE_COMMENT, c->entry_type,
+		            xsd_shm_misc_string(misc, len, c->host_name), xsd_shm_misc_string(misc, len, c->service_description),
+		            c->entry_time, xsd_shm_misc_string(misc, len, c->author), xsd_shm_misc_string(misc, len, c->comment_data),
+		            c->comment_id, c->persistent, c->expires, c->expire_time, c->source);
+		}
+
+	d = (struct xsddefault_shm_downtime *)c;
+	for(i = 0; i < prog->num_downtime; i++, d++) {
+		if(d->type == HOST_DOWNTIME) {
+			add_host_downtime(xsd_shm_misc_string(misc, len, d->host_name), d->entry_time, xsd_shm_misc_string(misc, len, d->author),
+			                  xsd_shm_misc_string(misc, len, d->comment), d->start_time, d->flex_downtime_start, d->end_time, d->fixed,
+			                  d->triggered_by, d->duration, d->downtime_id, d->is_in_effect, d->start_notification_sent);
+			temp_downtime = find_downtime(HOST_DOWNTIME, d->downtime_id);
+			}
+		else {
+			add_service_downtime(xsd_shm_misc_string(misc, len, d->host_name), xsd_shm_misc_string(misc, len, d->service_description),
+			                     d->entry_time, xsd_shm_misc_string(misc, len, d->author), xsd_shm_misc_string(misc, len, d->comment),
+			                     d->start_time, d->flex_downtime_start, d->end_time, d->fixed, d->triggered_by, d->duration,
+			                     d->downtime_id, d->is_in_effect, d->start_notification_sent);
+			temp_downtime = find_downtime(SERVICE_DOWNTIME, d->downtime_id);
+			}
+		if(temp_downtime)
+			temp_downtime->comment_id = d->comment_id;
+		}
+
+	return OK;
+	}
+
+
+/* maps the status segment, or returns NULL if it isn't there or isn't usable */
+static struct xsddefault_shm_header *xsd_shm_attach(const char *shm_file, size_t *size) {
+	struct xsddefault_shm_header *shm;
+	size_t records_size;
+	struct stat st;
+	int fd;
+
+	if((fd = open(shm_file, O_RDONLY)) < 0)
+		return NULL;
+	if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*shm)) {
+		close(fd);
+		return NULL;
+		}
+	shm = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(shm == MAP_FAILED)
+		return NULL;
+	*size = st.st_size;
+
+	records_size = sizeof(struct xsddefault_shm_record) * ((size_t)shm->num_hosts + shm->num_services);
+	if(memcmp(shm->magic, XSDDEFAULT_SHM_MAGIC, sizeof(shm->magic)) ||
+	   shm->header_size != sizeof(*shm) || shm->record_size != sizeof(struct xsddefault_shm_record) ||
+	   shm->records < sizeof(*shm) || shm->records + records_size > shm->strings ||
+	   shm->strings_size == 0 || shm->strings + shm->strings_size > shm->misc ||
+	   shm->misc + shm->misc_size > *size ||
+	   ((const char *)shm)[shm->strings + shm->strings_size - 1] != 0)
+	{
+		munmap(shm, *size);
+		return NULL;
+		}
+
+	return shm;
+	}
+
+
+/* tells whether a host or service status was read from the status segment */
+int xsddefault_is_shm_status(const void *status) {
+	const char *p = status;
+
+	if(shm_hoststatus && p >= (const char *)shm_hoststatus && p < (const char *)(shm_hoststatus + shm_num_hosts))
+		return TRUE;
+	if(shm_servicestatus && p >= (const char *)shm_servicestatus && p < (const char *)(shm_servicestatus + shm_num_services))
+		return TRUE;
+	return FALSE;
+	}
+
+
+/* releases what the statuses read from the status segment point into */
+void xsddefault_free_status_shm(void) {
+	struct xsd_shm_chunk *chunk;
+	unsigned int i;
+
+	/* these got their output from add_*_status() */
+	for(i = 0; shm_hoststatus && i < shm_num_hosts; i++) {
+		if(shm_hoststatus[i].has_been_checked == FALSE)
+			my_free(shm_hoststatus[i].plugin_output);
+		}
+	for(i = 0; shm_servicestatus && i < shm_num_services; i++) {
+		if(shm_servicestatus[i].has_been_checked == FALSE)
+			my_free(shm_servicestatus[i].plugin_output);
+		}
+	my_free(shm_hoststatus);
+	my_free(shm_servicestatus);
+	shm_num_hosts = shm_num_services = 0;
+
+	while((chunk = shm_chunks)) {
+		shm_chunks = chunk->next;
+		free(chunk);
+		}
+
+	if(status_shm) {
+		munmap(status_shm, status_shm_size);
+		status_shm = NULL;
+		status_shm_size = 0;
+		}
+	}
+
+
+/*
+ * Reads all status data from the status segment. Returns ERROR without
+ * adding anything if the segment isn't usable or the core didn't let
+ * us get a consistent copy of it, so the status file can be read instead.
+ */
+static int xsddefault_read_status_shm(const char *shm_file) {
+	size_t len = 0;
+	time_t last_update = 0;
+	uint32_t before;
+	unsigned int i;
+	char *misc;
+	int tries, result = ERROR;
+
+	/* if the core just replaced the segment, the new one is in place */
+	for(tries = 0; tries < 3; tries++) {
+		if((status_shm = xsd_shm_attach(shm_file, &status_shm_size)) == NULL || !status_shm->obsolete)
+			break;
+		munmap(status_shm, status_shm_size);
+		status_shm = NULL;
+		}
+	if(status_shm == NULL)
+		return ERROR;
+
+	if((misc = malloc(status_shm->misc_size)) == NULL) {
+		xsddefault_free_status_shm();
+		return ERROR;
+		}
+	for(tries = 0; tries < XSD_SHM_MAX_TRIES && result != OK; tries++) {
+		before = status_shm->misc_seq;
+		__sync_synchronize();
+		len = status_shm->misc_len < status_shm->misc_size ? status_shm->misc_len : status_shm->misc_size;
+		last_update = status_shm->last_update;
+		memcpy(misc, (const char *)status_shm + status_shm->misc, len);
+		__sync_synchronize();
+		if(!(before & 1) && status_shm->misc_seq == before)
+			result = OK;
+		}
+
+	shm_num_hosts = status_shm->num_hosts;
+	shm_num_services = status_shm->num_services;
+	shm_hoststatus = calloc(shm_num_hosts + 1, sizeof(hoststatus));
+	shm_servicestatus = calloc(shm_num_services + 1, sizeof(servicestatus));
+	if(shm_hoststatus == NULL || shm_servicestatus == NULL)
+		result = ERROR;
+	for(i = 0; result == OK && i < shm_num_hosts + shm_num_services; i++)
+		result = xsd_shm_read_status(i, last_update);
+	if(result != OK) {
+		free(misc);
+		xsddefault_free_status_shm();
+		return ERROR;
+		}
+
+	/* everything's consistent, so we can go ahead and add it */
+	defer_downtime_sorting = 1;
+	defer_comment_sorting = 1;
+	for(i = 0; i < shm_num_hosts; i++)
+		add_host_status(&shm_hoststatus[i]);
+	for(i = 0; i < shm_num_services; i++)
+		add_service_status(&shm_servicestatus[i]);
+	result = xsd_shm_read_misc(misc, len);
+
+	free(misc);
+	return result;
+	}
+
+/******************************************************************/
+/******************* BINARY SNAPSHOT FUNCTIONS ********************/
+/******************************************************************/
+
+/*
+ * The snapshot and delta log are replayed into the same text format
+ * as the status file, one block per object, and that's then handed
+ * to the regular parser below.
+ */
+struct xsd_text {
+	char *buf;
+	size_t len;
+	size_t size;
+	};
+
+/* a record as it comes out of a binary status file */
+struct xsd_record {
+	int type;
+	char *text;             /* header and fields, but not the closing brace */
+	char *name;             /* host or contact name */
+	char *description;      /* service description */
+	};
+
+/* replayed records of one kind, in the order they were first seen */
+struct xsd_record_list {
+	struct xsd_record *rec;
+	unsigned int num;
+	unsigned int size;
+	dkhash_table *index;    /* (name, description) -> position + 1 */
+	};
+
+/* a binary status file as it's being decoded */
+struct xsd_reader {
+	const unsigned char *p;
+	const unsigned char *end;
+	char **keys;
+	unsigned int num_keys;
+	};
+
+static const char *xsd_record_names[] = {
+	NULL, "info", "programstatus", "hoststatus", "servicestatus",
+	"contactstatus", "hostcomment", "servicecomment", "hostdowntime",
+	"servicedowntime",
+	};
+
+
+static int xsd_text_add(struct xsd_text *t, const char *data, size_t len) {
+	size_t size;
+	char *buf;
+
+	if(t->len + len + 1 > t->size) {
+		for(size = t->size ? t->size : 4096; size < t->len + len + 1; size *= 2)
+			;
+		if((buf = realloc(t->buf, size)) == NULL)
+			return ERROR;
+		t->buf = buf;
+		t->size = size;
+		}
+	memcpy(t->buf + t->len, data, len);
+	t->len += len;
+	t->buf[t->len] = 0;
+	return OK;
+	}
+
+
+static int xsd_get_varint(struct xsd_reader *r, unsigned long long *v) {
+	int shift;
+
+	*v = 0;
+	for(shift = 0; r->p < r->end && shift < 64; shift += 7) {
+		*v |= (unsigned long long)(*r->p & 0x7f) << shift;
+		if(!(*r->p++ & 0x80))
+			return OK;
+		}
+	return ERROR;
+	}
+
+
+static void xsd_free_record(struct xsd_record *rec) {
+	my_free(rec->text);
+	my_free(rec->name);
+	my_free(rec->description);
+	}
+
+
+/* decodes the record at the reader's position */
+static int xsd_read_record(struct xsd_reader *r, struct xsd_record *rec) {
+	struct xsd_text text = { NULL, 0, 0 };
+	unsigned long long id, len;
+	const char *key;
+	char **keys;
+
+	memset(rec, 0, sizeof(*rec));
+	if(r->p >= r->end)
+		return ERROR;
+	rec->type = *r->p++;
+	if(rec->type == XSDDEFAULT_NO_DATA || rec->type > XSDDEFAULT_END_OF_DUMP)
+		return ERROR;
+	if(rec->type < XSDDEFAULT_CLEAR_COMMENTS) {
+		xsd_text_add(&text, xsd_record_names[rec->type], strlen(xsd_record_names[rec->type]));
+		xsd_text_add(&text, " {\n", 3);
+		}
+
+	while(1) {
+		if(xsd_get_varint(r, &id) != OK)
+			break;
+		if(id == 0) {
+			if(rec->type < XSDDEFAULT_CLEAR_COMMENTS && text.buf == NULL)
+				break;
+			rec->text = text.buf;
+			return OK;
+			}
+
+		/* a key we haven't seen before */
+		if(id == r->num_keys + 1) {
+			if(xsd_get_varint(r, &len) != OK || len > (unsigned long long)(r->end - r->p))
+				break;
+			if((keys = realloc(r->keys, sizeof(char *) * (r->num_keys + 1))) == NULL)
+				break;
+			r->keys = keys;
+			if((r->keys[r->num_keys] = strndup((const char *)r->p, len)) == NULL)
+				break;
+			r->num_keys++;
+			r->p += len;
+			}
+		else if(id > r->num_keys)
+			break;
+		key = r->keys[id - 1];
+
+		if(xsd_get_varint(r, &len) != OK || len > (unsigned long long)(r->end - r->p))
+			break;
+
+		if(!strcmp(key, "host_name") || !strcmp(key, "contact_name")) {
+			my_free(rec->name);
+			rec->name = strndup((const char *)r->p, len);
+			}
+		else if(!strcmp(key, "service_description")) {
+			my_free(rec->description);
+			rec->description = strndup((const char *)r->p, len);
+			}
+
+		/* the time of the last update is added back when we're done */
+		if((rec->type == XSDDEFAULT_HOSTSTATUS_DATA || rec->type == XSDDEFAULT_SERVICESTATUS_DATA) && !strcmp(key, "last_update")) {
+			r->p += len;
+			continue;
+			}
+
+		xsd_text_add(&text, "\t", 1);
+		xsd_text_add(&text, key, strlen(key));
+		xsd_text_add(&text, "=", 1);
+		xsd_text_add(&text, (const char *)r->p, len);
+		xsd_text_add(&text, "\n", 1);
+		r->p += len;
+		}
+
+	my_free(text.buf);
+	xsd_free_record(rec);
+	return ERROR;
+	}
+
+
+static void xsd_free_record_list(struct xsd_record_list *list) {
+	unsigned int i;
+
+	for(i = 0; i < list->num; i++)
+		xsd_free_record(&list->rec[i]);
+	list->num = 0;
+	}
+
+
+/* adds a record to a list, replacing the one for the same object, if any */
+static int xsd_store_record(struct xsd_record_list *list, struct xsd_record *rec) {
+	struct xsd_record *recs;
+	unsigned long pos = 0;
+
+	if(list->index && rec->name)
+		pos = (unsigned long)dkhash_get(list->index, rec->name, rec->description);
+	if(pos) {
+		/* the index still points to the names of the first record */
+		my_free(list->rec[pos - 1].text);
+		list->rec[pos - 1].text = rec->text;
+		rec->text = NULL;
+		xsd_free_record(rec);
+		return OK;
+		}
+
+	if(list->num == list->size) {
+		list->size = list->size ? list->size * 2 : 256;
+		if((recs = realloc(list->rec, sizeof(*recs) * list->size)) == NULL)
+			return ERROR;
+		list->rec = recs;
+		}
+	list->rec[list->num++] = *rec;
+	if(list->index && rec->name)
+		dkhash_insert(list->index, rec->name, rec->description, (void *)(unsigned long)list->num);
+	return OK;
+	}
+
+
+/* reads a binary status file into memory and checks its header */
+static unsigned char *xsd_read_binary_file(const char *path, const char *magic, size_t *len, unsigned long long *generation) {
+	unsigned char *buf;
+	struct stat st;
+	ssize_t ret;
+	size_t done = 0;
+	int fd, i;
+
+	if((fd = open(path, O_RDONLY)) < 0)
+		return NULL;
+	if(fstat(fd, &st) < 0 || st.st_size < 16 || (buf = malloc(st.st_size)) == NULL) {
+		close(fd);
+		return NULL;
+		}
+	while(done < (size_t)st.st_size) {
+		ret = read(fd, buf + done, st.st_size - done);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			break;
+		done += ret;
+		}
+	close(fd);
+
+	if(done < 16 || memcmp(buf, magic, 8)) {
+		free(buf);
+		return NULL;
+		}
+	for(*generation = 0, i = 0; i < 8; i++)
+		*generation |= (unsigned long long)buf[8 + i] << (i * 8);
+	*len = done;
+	return buf;
+	}
+
+
+/*
+ * Replays the records of a binary status file. Records only take
+ * effect once the end of the dump they belong to has been seen, so a
+ * dump the core is still writing is simply skipped.
+ * Returns the number of complete dumps.
+ */
+static int xsd_replay_binary_file(const unsigned char *buf, size_t len, struct xsd_record_list *lists) {
+	struct xsd_reader r = { buf + 16, buf + len, NULL, 0 };
+	struct xsd_record_list pending = { NULL, 0, 0, NULL };
+	struct xsd_record rec;
+	unsigned int i;
+	int dumps = 0, type;
+
+	while(xsd_read_record(&r, &rec) == OK) {
+		if(rec.type != XSDDEFAULT_END_OF_DUMP) {
+			if(xsd_store_record(&pending, &rec) != OK) {
+				xsd_free_record(&rec);
+				break;
+				}
+			continue;
+			}
+
+		for(i = 0; i < pending.num; i++) {
+			type = pending.rec[i].type;
+			if(type == XSDDEFAULT_CLEAR_COMMENTS || type == XSDDEFAULT_CLEAR_DOWNTIME) {
+				xsd_free_record_list(&lists[type == XSDDEFAULT_CLEAR_COMMENTS ? XSDDEFAULT_HOSTCOMMENT_DATA : XSDDEFAULT_HOSTDOWNTIME_DATA]);
+				xsd_free_record(&pending.rec[i]);
+				continue;
+				}
+			/* there's only ever one of these */
+			if(type == XSDDEFAULT_INFO_DATA || type == XSDDEFAULT_PROGRAMSTATUS_DATA)
+				xsd_free_record_list(&lists[type]);
+			/* comments and downtime of both kinds share a list, to keep their order */
+			if(type == XSDDEFAULT_SERVICECOMMENT_DATA || type == XSDDEFAULT_SERVICEDOWNTIME_DATA)
+				type--;
+			if(xsd_store_record(&lists[type], &pending.rec[i]) != OK)
+				xsd_free_record(&pending.rec[i]);
+			}
+		pending.num = 0;
+		dumps++;
+		}
+
+	xsd_free_record_list(&pending);
+	my_free(pending.rec);
+	for(i = 0; i < r.num_keys; i++)
+		my_free(r.keys[i]);
+	my_free(r.keys);
+	return dumps;
+	}
+
+
+/* replays the snapshot and its delta log, returning the result as status file text */
+static char *xsddefault_read_status_snapshot(const char *snapshot_file) {
+	struct xsd_record_list lists[XSDDEFAULT_SERVICEDOWNTIME_DATA + 1];
+	struct xsd_text text = { NULL, 0, 0 };
+	unsigned long long generation, delta_generation;
+	unsigned char *snapshot = NULL, *delta = NULL;
+	size_t snapshot_len = 0, delta_len = 0;
+	char *delta_file = NULL, *created = NULL, *p;
+	unsigned int i, type;
+	int attempt;
+
+	if(asprintf(&delta_file, "%s.delta", snapshot_file) < 0)
+		return NULL;
+
+	/*
+	 * The core writes a new snapshot before it starts a new delta
+	 * log, so if we get a delta log from another generation, we just
+	 * missed a compaction and should start over.
+	 */
+	for(attempt = 0; attempt < 3; attempt++) {
+		my_free(snapshot);
+		my_free(delta);
+		if((snapshot = xsd_read_binary_file(snapshot_file, XSDDEFAULT_SNAPSHOT_MAGIC, &snapshot_len, &generation)) == NULL)
+			break;
+		delta = xsd_read_binary_file(delta_file, XSDDEFAULT_DELTA_MAGIC, &delta_len, &delta_generation);
+		if(delta == NULL || delta_generation == generation)
+			break;
+		}
+	my_free(delta_file);
+	if(snapshot == NULL) {
+		my_free(delta);
+		return NULL;
+		}
+	if(delta && delta_generation != generation)
+		my_free(delta);
+
+	memset(lists, 0, sizeof(lists));
+	lists[XSDDEFAULT_HOSTSTATUS_DATA].index = dkhash_create_backend(1024, DKHASH_BACKEND_OPEN);
+	lists[XSDDEFAULT_SERVICESTATUS_DATA].index = dkhash_create_backend(1024, DKHASH_BACKEND_OPEN);
+	lists[XSDDEFAULT_CONTACTSTATUS_DATA].index = dkhash_create_backend(1024, DKHASH_BACKEND_OPEN);
+
+	if(xsd_replay_binary_file(snapshot, snapshot_len, lists) > 0) {
+		if(delta)
+			xsd_replay_binary_file(delta, delta_len, lists);
+
+		/* the creation time of the last dump is when everything was last updated */
+		if(lists[XSDDEFAULT_INFO_DATA].num && (p = strstr(lists[XSDDEFAULT_INFO_DATA].rec[0].text, "\tcreated=")))
+			created = strndup(p + 9, strcspn(p + 9, "\n"));
+
+		for(type = XSDDEFAULT_INFO_DATA; type <= XSDDEFAULT_SERVICEDOWNTIME_DATA; type++) {
+			for(i = 0; i < lists[type].num; i++) {
+				p = lists[type].rec[i].text;
+				xsd_text_add(&text, p, strlen(p));
+				if(created && (type == XSDDEFAULT_HOSTSTATUS_DATA || type == XSDDEFAULT_SERVICESTATUS_DATA)) {
+					xsd_text_add(&text, "\tlast_update=", 13);
+					xsd_text_add(&text, created, strlen(created));
+					xsd_text_add(&text, "\n", 1);
+					}
+				xsd_text_add(&text, "\t}\n", 3);
+				xsd_free_record(&lists[type].rec[i]);
+				}
+			}
+		}
+
+	for(type = 0; type <= XSDDEFAULT_SERVICEDOWNTIME_DATA; type++) {
+		xsd_free_record_list(&lists[type]);
+		my_free(lists[type].rec);
+		if(lists[type].index)
+			dkhash_destroy(lists[type].index);
+		}
+	my_free(created);
+	my_free(snapshot);
+	my_free(delta);
+	return text.buf;
+	}
+
+
+/* hands out the lines of a replayed snapshot, one at a time */
+static char *xsddefault_next_line(char **cursor) {
+	char *line = *cursor, *nl;
+
+	if(line == NULL || *line == 0)
+		return NULL;
+	if((nl = strchr(line, '\n'))) {
+		*nl = 0;
+		*cursor = nl + 1;
+		}
+	else
+		*cursor = line + strlen(line);
+	return line;
+	}
+
 /******************************************************************/
 /****************** DEFAULT DATA INPUT FUNCTIONS ******************/
 /******************************************************************/
@@ -494,6 +2153,9 @@ int xsddefault_read_status_data(const char *status_file_name, int options) {
 	char *input = NULL;
 	mmapfile *thefile = NULL;
 #endif
+	char *snapshot = NULL;
+	char *snapshot_cursor = NULL;
+	char *line = NULL;
 	int data_type = XSDDEFAULT_NO_DATA;
 	hoststatus *temp_hoststatus = NULL;
 	servicestatus *temp_servicestatus = NULL;
@@ -532,12 +2194,21 @@ int xsddefault_read_status_data(const char *status_file_name, int options) {
 		program_stats[x][2] = 0;
 		}
 
+	/* prefer the status segment or the binary snapshot, if the core writes them */
+	if(status_shm_file && xsddefault_read_status_shm(status_shm_file) == OK) {
+		if(sort_downtime() != OK || sort_comments() != OK)
+			return ERROR;
+		return OK;
+		}
+	if(status_snapshot_file && (snapshot = xsddefault_read_status_snapshot(status_snapshot_file)))
+		snapshot_cursor = snapshot;
+
 	/* open the status file for reading */
 #ifdef NO_MMAP
-	if((fp = fopen(status_file_name, "r")) == NULL)
+	else if((fp = fopen(status_file_name, "r")) == NULL)
 		return ERROR;
 #else
-	if((thefile = mmap_fopen(status_file_name)) == NULL)
+	else if((thefile = mmap_fopen(status_file_name)) == NULL)
 		return ERROR;
 #endif
 
@@ -548,17 +2219,32 @@ int xsddefault_read_status_data(const char *status_file_name, int options) {
 	/* read all lines in the status file */
 	while(1) {
 
+		if(snapshot) {
+			if((line = xsddefault_next_line(&snapshot_cursor)) == NULL)
+				break;
 #ifdef NO_MMAP
-		strcpy(input, "");
-		if(fgets(input, sizeof(input), fp) == NULL)
-			break;
+			strncpy(input, line, sizeof(input) - 1);
+			input[sizeof(input) - 1] = '\x0';
 #else
-		/* free memory */
-		my_free(input);
+			input = line;
+#endif
+			}
 
-		/* read the next line */
-		if((input = mmap_fgets(thefile)) == NULL)
-			break;
+#ifdef NO_MMAP
+		else {
+			strcpy(input, "");
+			if(fgets(input, sizeof(input), fp) == NULL)
+				break;
+			}
+#else
+		else {
+			/* free memory */
+			my_free(input);
+
+			/* read the next line */
+			if((input = mmap_fgets(thefile)) == NULL)
+				break;
+			}
 #endif
 
 		strip(input);
@@ -1025,11 +2711,16 @@ int xsddefault_read_status_data(const char *status_file_name, int options) {
 		}
 
 	/* free memory and close the file */
+	if(snapshot)
+		my_free(snapshot);
 #ifdef NO_MMAP
-	fclose(fp);
+	else
+		fclose(fp);
 #else
-	my_free(input);
-	mmap_fclose(thefile);
+	else {
+		my_free(input);
+		mmap_fclose(thefile);
+		}
 #endif
 
 	if(sort_downtime() != OK)
@@ -23,13 +23,7 @@
 #ifndef NAGIOS_XSDDEFAULT_H_INCLUDED
 #define NAGIOS_XSDDEFAULT_H_INCLUDED
 
-#ifdef NSCORE
-int xsddefault_initialize_status_data(const char *);
-int xsddefault_cleanup_status_data(int);
-int xsddefault_save_status_data(void);
-#endif
-
-#ifdef NSCGI
+#include <stdint.h>
 
 #define XSDDEFAULT_NO_DATA               0
 #define XSDDEFAULT_INFO_DATA             1
@@ -42,7 +36,166 @@ int xsddefault_save_status_data(void);
 #define XSDDEFAULT_HOSTDOWNTIME_DATA     8
 #define XSDDEFAULT_SERVICEDOWNTIME_DATA  9
 
+/* records only found in the binary snapshot and delta log */
+#define XSDDEFAULT_CLEAR_COMMENTS        10	/* comments that follow replace all earlier ones */
+#define XSDDEFAULT_CLEAR_DOWNTIME        11	/* same, for downtime */
+#define XSDDEFAULT_END_OF_DUMP           12	/* everything since the previous one is complete */
+
+#define XSDDEFAULT_SNAPSHOT_MAGIC "NSSNAP01"
+#define XSDDEFAULT_DELTA_MAGIC    "NSDELT01"
+#define XSDDEFAULT_SHM_MAGIC      "NSSHM002"
+
+/* room for plugin output, perfdata and long output in shared memory records */
+#define XSDDEFAULT_SHM_TEXT_SIZE  1024
+
+/*
+ * The shared memory status segment starts with this header. It's
+ * followed by one record per host and one per service, in object id
+ * order, then the table of host names and service descriptions and
+ * finally the misc area with the program status, comments and
+ * downtime.
+ * Readers must copy what they need and check that the sequence number
+ * of the record (or of the misc area) was even and didn't change while
+ * they did, or try again. The core sets "obsolete" when it replaces
+ * the segment with a new one.
+ */
+struct xsddefault_shm_header {
+	char magic[8];
+	uint32_t header_size;
+	uint32_t record_size;
+	uint32_t num_hosts;
+	uint32_t num_services;
+	uint64_t records;               /* offset of the first record */
+	uint64_t strings;               /* offset of the name table */
+	uint64_t strings_size;
+	uint64_t misc;                  /* offset of the misc area */
+	uint64_t misc_size;
+	volatile uint32_t obsolete;
+	volatile uint32_t misc_seq;
+	uint64_t misc_len;
+	int64_t last_update;
+	};
+
+struct xsddefault_shm_record {
+	volatile uint32_t seq;          /* odd while the core updates the record */
+	uint32_t name;                  /* host name, as an offset in the name table */
+	uint32_t description;           /* service description, 0 for hosts */
+	int32_t has_been_checked;
+	int32_t should_be_scheduled;
+	int32_t check_type;
+	int32_t current_state;
+	int32_t last_hard_state;
+	int32_t current_attempt;
+	int32_t max_attempts;
+	int32_t state_type;
+	int32_t check_options;
+	int32_t current_notification_number;
+	int32_t no_more_notifications;
+	int32_t notifications_enabled;
+	int32_t problem_has_been_acknowledged;
+	int32_t acknowledgement_type;
+	int32_t checks_enabled;
+	int32_t accept_passive_checks;
+	int32_t event_handler_enabled;
+	int32_t flap_detection_enabled;
+	int32_t process_performance_data;
+	int32_t obsess;
+	int32_t is_flapping;
+	int32_t scheduled_downtime_depth;
+	int64_t last_check;
+	int64_t next_check;
+	int64_t last_state_change;
+	int64_t last_hard_state_change;
+	int64_t last_time[4];           /* last time in each state, indexed by state */
+	int64_t last_notification;
+	int64_t next_notification;
+	double execution_time;
+	double latency;
+	double percent_state_change;
+	uint16_t plugin_output_len;
+	uint16_t perf_data_len;
+	uint16_t long_plugin_output_len;
+	char text[XSDDEFAULT_SHM_TEXT_SIZE]; /* the three of them, nul-terminated, in that order */
+	};
+
+/*
+ * The misc area starts with the program status, followed by the
+ * comments, the downtime and the strings those refer to. Strings
+ * are given as offsets from the start of the misc area, 0 meaning
+ * there's none.
+ */
+struct xsddefault_shm_program {
+	int64_t program_start;
+	int64_t last_log_rotation;
+	int32_t nagios_pid;
+	int32_t daemon_mode;
+	int32_t enable_notifications;
+	int32_t execute_service_checks;
+	int32_t accept_passive_service_checks;
+	int32_t execute_host_checks;
+	int32_t accept_passive_host_checks;
+	int32_t enable_event_handlers;
+	int32_t obsess_over_services;
+	int32_t obsess_over_hosts;
+	int32_t check_service_freshness;
+	int32_t check_host_freshness;
+	int32_t enable_flap_detection;
+	int32_t process_performance_data;
+	int32_t check_stats[MAX_CHECK_STATS_TYPES][3];
+	uint32_t num_comments;
+	uint32_t num_downtime;
+	uint32_t pad;
+	};
+
+struct xsddefault_shm_comment {
+	int32_t comment_type;
+	int32_t entry_type;
+	int32_t source;
+	int32_t persistent;
+	int32_t expires;
+	uint32_t host_name;
+	uint32_t service_description;
+	uint32_t author;
+	uint32_t comment_data;
+	uint32_t pad;
+	uint64_t comment_id;
+	int64_t entry_time;
+	int64_t expire_time;
+	};
+
+struct xsddefault_shm_downtime {
+	int32_t type;
+	int32_t fixed;
+	int32_t is_in_effect;
+	int32_t start_notification_sent;
+	uint32_t host_name;
+	uint32_t service_description;
+	uint32_t author;
+	uint32_t comment;
+	uint64_t downtime_id;
+	uint64_t comment_id;
+	uint64_t triggered_by;
+	uint64_t duration;
+	int64_t entry_time;
+	int64_t start_time;
+	int64_t flex_downtime_start;
+	int64_t end_time;
+	};
+
+#ifdef NSCORE
+int xsddefault_initialize_status_data(const char *);
+int xsddefault_cleanup_status_data(int);
+int xsddefault_reset_object_status_data(void);
+int xsddefault_save_status_data(void);
+void xsddefault_update_host_status(host *);
+void xsddefault_update_service_status(service *);
+void xsddefault_update_contact_status(contact *);
+#endif
+
+#ifdef NSCGI
 int xsddefault_read_status_data(const char *, int);
+int xsddefault_is_shm_status(const void *);
+void xsddefault_free_status_shm(void);
 #endif
 
 #endif